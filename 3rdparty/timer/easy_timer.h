@@ -1,7 +1,7 @@
 #ifndef _RKNN_DEMO_TIMER_H_
 #define _RKNN_DEMO_TIMER_H_
 
-#include <sys/time.h>
+#include <time.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -12,8 +12,9 @@
 class TIMER
 {
 private:
-    struct timeval start_time, stop_time;
-    double __get_us(struct timeval t) { return (t.tv_sec * 1000000 + t.tv_usec); }
+    // monotonic, intervals are not affected by wall clock changes
+    struct timespec start_time, stop_time;
+    double __get_us(struct timespec t) { return (t.tv_sec * 1000000.0 + t.tv_nsec / 1000.0); }
     char indent[40] = "-- ";
 
 public:
@@ -31,12 +32,12 @@ public:
 
     void tik()
     {
-        gettimeofday(&start_time, NULL);
+        clock_gettime(CLOCK_MONOTONIC, &start_time);
     }
 
     void tok()
     {
-        gettimeofday(&stop_time, NULL);
+        clock_gettime(CLOCK_MONOTONIC, &stop_time);
     }
 
 #ifdef TIMING_DISABLED
@@ -2,174 +2,43 @@
 #define _RKNN_APP_LAYOUT_CONVERT_H_
 
 #include "rknn_api.h"
-
-
-int _rknn_app_nchw_2_nhwc(rknn_tensor_attr *src, unsigned char* src_ptr, rknn_tensor_attr *dst, unsigned char* dst_ptr, int type_size){
-    // transpose nchw to nhwc, consider w align.
-    int ret = 0;
-    int N = src->dims[0];
-    int C = src->dims[1];
-    int H = src->dims[2];
-    int W = src->dims[3];
-
-    int dst_W;
-    if (dst->size != dst->size_with_stride){
-        int attr_dtype_size = dst->size / dst->n_elems;
-        dst_W = dst->size_with_stride / (attr_dtype_size * N * C * H);
-    }
-    else{
-        dst_W = W;
-    }
-
-    int src_HW = H * W;
-    int src_CHW = C * src_HW;
-    int dst_WC = dst_W * C;
-    int dst_HWC = H * dst_WC;
-
-    for (int n = 0; n < N; n++){
-        for (int h = 0; h < H; h++){
-            for (int w = 0; w < W; w++){
-                for (int c = 0; c < C; c++){
-                    int src_idx = n * src_CHW + c * src_HW + h * W + w;
-                    int dst_idx = n * dst_HWC + h * dst_WC + w * C + c;
-                    memcpy(dst_ptr + dst_idx * type_size, src_ptr + src_idx * type_size, type_size);
-                }
-            }
-        }
-    }
-    return ret;
-}
-
-
-int _rknn_app_nhwc_2_nchw(rknn_tensor_attr *src, unsigned char* src_ptr, rknn_tensor_attr *dst, unsigned char* dst_ptr, int type_size){
-    // transpose nhwc to nchw, consider w align.
-    int ret = 0;
-    int N = src->dims[0];
-    int H = src->dims[1];
-    int W = src->dims[2];
-    int C = src->dims[3];
-
-    int dst_W = dst->dims[3];
-
-    int src_WC = W * C;
-    int src_HWC = H * src_WC;
-    int dst_HW = H * dst_W;
-    int dst_CHW = C * dst_HW;
-
-    for (int n = 0; n < N; n++){
-        for (int c = 0; c < C; c++){
-            for (int h = 0; h < H; h++){
-                for (int w = 0; w < dst_W; w++){
-                    int src_idx = n * src_HWC + h * src_WC + w * C + c;
-                    int dst_idx = n * dst_CHW + c * dst_HW + h * dst_W + w;
-                    memcpy(dst_ptr + dst_idx * type_size, src_ptr + src_idx * type_size, type_size);
-                }
-            }
+#include "layout_utils.h"
+
+
+// buffer shape of attr, padded width or channels are fixed up against the other side
+int _rknn_app_layout_desc(rknn_tensor_attr *attr, tensor_layout_desc_t *desc){
+    int N = attr->dims[0];
+    switch (attr->fmt){
+    case RKNN_TENSOR_NCHW:
+        init_layout_desc(desc, TENSOR_LAYOUT_NCHW, N, attr->dims[1], attr->dims[2], attr->dims[3], 0);
+        break;
+    case RKNN_TENSOR_NHWC:
+        init_layout_desc(desc, TENSOR_LAYOUT_NHWC, N, attr->dims[3], attr->dims[1], attr->dims[2], 0);
+        // consider w align
+        if (attr->size != attr->size_with_stride){
+            int attr_dtype_size = attr->size / attr->n_elems;
+            desc->w_stride = attr->size_with_stride / (attr_dtype_size * N * desc->c * desc->h);
         }
+        break;
+    case RKNN_TENSOR_NC1HWC2:
+        init_layout_desc(desc, TENSOR_LAYOUT_NC1HWC2, N, attr->dims[1] * attr->dims[4], attr->dims[2], attr->dims[3], attr->dims[4]);
+        break;
+    default:
+        return -1;
     }
-    return ret;
-}
-
-
-int _rknn_app_nchw_2_nc1hwc2(rknn_tensor_attr *src, unsigned char* src_ptr, rknn_tensor_attr *dst, unsigned char* dst_ptr, int type_size){
-    // transpose nchw to nc1hwc2, consider c2 align
-    int ret = 0;
-    int N = src->dims[0];
-    int C = src->dims[1];
-    int H = src->dims[2];
-    int W = src->dims[3];
-
-    int C1 = dst->dims[1];
-    int C2 = dst->dims[4];
-
-    int src_HW = H * W;
-    int src_CHW = C * src_HW;
-    int dst_WC2 = W * C2;
-    int dst_HWC2 = H * dst_WC2;
-    int dst_C1HWC2 = C1 * dst_HWC2;
-
-    for (int n = 0; n < N; n++){
-        for (int c = 0; c < C; c++){
-            for (int h = 0; h < H; h++){
-                for (int w = 0; w < W; w++){
-                    int c1 = c / C2;
-                    int c2 = c % C2;
-                    int src_idx = n * src_CHW + c * src_HW + h * W + w;
-                    int dst_idx = n * dst_C1HWC2 + c1 * dst_HWC2 + h * dst_WC2 + w * C2 + c2;
-                    memcpy(dst_ptr + dst_idx * type_size, src_ptr + src_idx * type_size, type_size);
-                }
-            }
-        }
-    }    
-    return ret;
+    return 0;
 }
 
 
-int _rknn_app_nc1hwc2_2_nchw(rknn_tensor_attr *src, unsigned char* src_ptr, rknn_tensor_attr *dst, unsigned char* dst_ptr, int type_size){
-    int ret = 0;
-
-    int N = src->dims[0];
-    int C1 = src->dims[1];
-    int H = src->dims[2];
-    int W = src->dims[3];
-    int C2 = src->dims[4];
-
-    int C = dst->dims[1];
-
-    int src_WC2 = W * C2;
-    int src_HWC2 = H * src_WC2;
-    int src_C1HWC2 = C1 * src_HWC2;
-    int dst_HW = H * W;
-    int dst_CHW = C * dst_HW;
-
-    for (int n = 0; n < N; n++){
-        for (int c = 0; c < C; c++){
-            for (int h = 0; h < H; h++){
-                for (int w = 0; w < W; w++){
-                    int c1 = c / C2;
-                    int c2 = c % C2;
-                    int src_idx = n * src_C1HWC2 + c1 * src_HWC2 + h * src_WC2 + w * C2 + c2;
-                    int dst_idx = n * dst_CHW + c * dst_HW + h * W + w;
-                    memcpy(dst_ptr + dst_idx * type_size, src_ptr + src_idx * type_size, type_size);
-                }
-            }
-        }
+void _rknn_app_fit_layout_desc(tensor_layout_desc_t *desc, int c, int w){
+    if (desc->w_stride == 0){
+        desc->w_stride = desc->w;
     }
-
-    return ret;
-}
-
-int _rknn_app_nhwc_2_nc1hwc2(rknn_tensor_attr *src, unsigned char* src_ptr, rknn_tensor_attr *dst, unsigned char* dst_ptr, int type_size){
-    int ret = 0;
-    int N = src->dims[0];
-    int H = src->dims[1];
-    int W = src->dims[2];
-    int C = src->dims[3];
-
-    int C1 = dst->dims[1];
-    int C2 = dst->dims[4];
-
-    int src_WC = W * C;
-    int src_HWC = H * src_WC;
-    int dst_WC2 = W * C2;
-    int dst_HWC2 = H * dst_WC2;
-    int dst_C1HWC2 = C1 * dst_HWC2;
-
-    for (int n = 0; n < N; n++){
-        for (int c = 0; c < C; c++){
-            for (int h = 0; h < H; h++){
-                for (int w = 0; w < W; w++){
-                    int c1 = c / C2;
-                    int c2 = c % C2;
-                    int src_idx = n * src_HWC + h * src_WC + w * C + c;
-                    int dst_idx = n * dst_C1HWC2 + c1 * dst_HWC2 + h * dst_WC2 + w * C2 + c2;
-                    memcpy(dst_ptr + dst_idx * type_size, src_ptr + src_idx * type_size, type_size);
-                }
-            }
-        }
+    desc->w = w;
+    if (desc->layout == TENSOR_LAYOUT_NHWC && desc->c_stride == 0){
+        desc->c_stride = desc->c;
     }
-
-    return ret;
+    desc->c = c;
 }
 
 
@@ -202,22 +71,19 @@ int rknn_app_layout_convert(unsigned char* src_ptr,
         return 0;
     }
 
-    int ret = 0;
-    if (src->fmt == RKNN_TENSOR_NCHW && dst->fmt == RKNN_TENSOR_NHWC){
-        ret = _rknn_app_nchw_2_nhwc(src, src_ptr, dst, dst_ptr, type_size);
-    }else if (src->fmt == RKNN_TENSOR_NCHW && dst->fmt == RKNN_TENSOR_NC1HWC2){
-        ret = _rknn_app_nchw_2_nc1hwc2(src, src_ptr, dst, dst_ptr, type_size);
-    }else if (src->fmt == RKNN_TENSOR_NHWC && dst->fmt == RKNN_TENSOR_NC1HWC2){
-        ret = _rknn_app_nhwc_2_nc1hwc2(src, src_ptr, dst, dst_ptr, type_size);
-    }else if (src->fmt == RKNN_TENSOR_NHWC && dst->fmt == RKNN_TENSOR_NCHW){
-        ret = _rknn_app_nhwc_2_nchw(src, src_ptr, dst, dst_ptr, type_size);
-    }else if (src->fmt == RKNN_TENSOR_NC1HWC2 && dst->fmt == RKNN_TENSOR_NCHW){
-        ret = _rknn_app_nc1hwc2_2_nchw(src, src_ptr, dst, dst_ptr, type_size);
-    }else{
+    tensor_layout_desc_t src_desc;
+    tensor_layout_desc_t dst_desc;
+    if (_rknn_app_layout_desc(src, &src_desc) != 0 || _rknn_app_layout_desc(dst, &dst_desc) != 0){
         printf("    rknn_layout_convert: not support layout convert from %s to %s\n", get_format_string(src->fmt), get_format_string(dst->fmt));
-        ret = -1;
+        return -1;
     }
+    // native side may be padded in width (NHWC) or channels (NC1HWC2)
+    int C = src_desc.c < dst_desc.c ? src_desc.c : dst_desc.c;
+    int W = src_desc.w < dst_desc.w ? src_desc.w : dst_desc.w;
+    _rknn_app_fit_layout_desc(&src_desc, C, W);
+    _rknn_app_fit_layout_desc(&dst_desc, C, W);
 
+    int ret = convert_layout(src_ptr, &src_desc, dst_ptr, &dst_desc, type_size, 0);
     return ret;
 }
 
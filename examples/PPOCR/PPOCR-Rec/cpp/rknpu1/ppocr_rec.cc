@@ -5,7 +5,9 @@
 #include "ppocr_rec.h"
 #include "common.h"
 #include "file_utils.h"
+#include "model_registry.h"
 #include "image_utils.h"
+#include "trace_utils.h"
 
 static void dump_tensor_attr(rknn_tensor_attr* attr)
 {
@@ -19,21 +21,12 @@ static void dump_tensor_attr(rknn_tensor_attr* attr)
 int init_ppocr_rec_model(const char* model_path, rknn_app_context_t* app_ctx)
 {
     int ret;
-    int model_len = 0;
-    char* model;
     rknn_context ctx = 0;
 
     // Load RKNN Model
-    model_len = read_data_from_file(model_path, &model);
-    if (model == NULL) {
-        printf("load_model fail!\n");
-        return -1;
-    }
-
-    ret = rknn_init(&ctx, model, model_len, 0);
-    free(model);
+    ret = acquire_model_context(model_path, 0, &ctx);
     if (ret < 0) {
-        printf("rknn_init fail! ret=%d\n", ret);
+        printf("acquire_model_context fail! ret=%d\n", ret);
         return -1;
     }
 
@@ -110,7 +103,7 @@ int release_ppocr_rec_model(rknn_app_context_t* app_ctx)
         app_ctx->output_attrs = NULL;
     }
     if (app_ctx->rknn_ctx != 0) {
-        rknn_destroy(app_ctx->rknn_ctx);
+        release_model_context(app_ctx->rknn_ctx);
         app_ctx->rknn_ctx = 0;
     }
     return 0;
@@ -161,7 +154,7 @@ int inference_ppocr_rec_model(rknn_app_context_t* app_ctx, image_buffer_t* src_i
     }
 
     // Run
-    printf("rknn_run\n");
+    TRACE_LOG("rknn_run\n");
     ret = rknn_run(app_ctx->rknn_ctx, nullptr);
     if (ret < 0) {
         printf("rknn_run fail! ret=%d\n", ret);
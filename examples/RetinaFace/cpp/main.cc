@@ -30,6 +30,7 @@
 #include "retinaface.h"
 #include "image_utils.h"
 #include "image_drawing.h"
+#include "trace_utils.h"
 #include "file_utils.h"
 
 #ifdef USE_INOTIFY
@@ -74,9 +75,15 @@ int main(int argc, char **argv) {
 #endif
 
     int ret;
+    // set to write a trace for chrome://tracing or ui.perfetto.dev
+    const char *trace_path = getenv("RKNN_TRACE_JSON");
     rknn_app_context_t rknn_app_ctx;
     memset(&rknn_app_ctx, 0, sizeof(rknn_app_context_t));
 
+    if (trace_path != NULL) {
+        trace_set_event_capture(1);
+    }
+
     ret = init_retinaface_model(model_path, &rknn_app_ctx);
     if (ret != 0) {
         printf("init_retinaface_model fail! ret=%d model_path=%s\n", ret, model_path);
@@ -324,5 +331,10 @@ out:
         printf("release_retinaface_model fail! ret=%d\n", ret);
     }
 
+    trace_print_stats();
+    if (trace_path != NULL) {
+        trace_write_json(trace_path);
+    }
+
     return 0;
 }
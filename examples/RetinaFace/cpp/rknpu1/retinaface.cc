@@ -6,7 +6,9 @@
 #include "retinaface.h"
 #include "common.h"
 #include "file_utils.h"
+#include "model_registry.h"
 #include "image_utils.h"
+#include "trace_utils.h"
 #include "rknn_box_priors.h"
 
 #define NMS_THRESHOLD 0.4
@@ -204,21 +206,12 @@ static int post_process_retinaface(rknn_app_context_t *app_ctx, image_buffer_t *
 
 int init_retinaface_model(const char *model_path, rknn_app_context_t *app_ctx) {
     int ret;
-    int model_len = 0;
-    char *model;
     rknn_context ctx = 0;
 
     // Load RKNN Model
-    model_len = read_data_from_file(model_path, &model);
-    if (model == NULL) {
-        printf("load_model fail!\n");
-        return -1;
-    }
-
-    ret = rknn_init(&ctx, model, model_len, 0);
-    free(model);
+    ret = acquire_model_context(model_path, 0, &ctx);
     if (ret < 0) {
-        printf("rknn_init fail! ret=%d\n", ret);
+        printf("acquire_model_context fail! ret=%d\n", ret);
         return -1;
     }
 
@@ -294,7 +287,7 @@ int release_retinaface_model(rknn_app_context_t *app_ctx) {
         app_ctx->output_attrs = NULL;
     }
     if (app_ctx->rknn_ctx != 0) {
-        rknn_destroy(app_ctx->rknn_ctx);
+        release_model_context(app_ctx->rknn_ctx);
         app_ctx->rknn_ctx = 0;
     }
     return 0;
@@ -337,15 +330,21 @@ int inference_retinaface_model(rknn_app_context_t *app_ctx, image_buffer_t *src_
     inputs[0].size  = app_ctx->model_width * app_ctx->model_height * app_ctx->model_channel;
     inputs[0].buf   = img.virt_addr;
 
-    ret = rknn_inputs_set(app_ctx->rknn_ctx, 1, inputs);
+    {
+        TRACE_ZONE(TRACE_STAGE_INPUTS_SET, "rknn_inputs_set");
+        ret = rknn_inputs_set(app_ctx->rknn_ctx, 1, inputs);
+    }
     if (ret < 0) {
         printf("rknn_input_set fail! ret=%d\n", ret);
         return -1;
     }
 
     // Run
-    printf("rknn_run\n");
-    ret = rknn_run(app_ctx->rknn_ctx, nullptr);
+    TRACE_LOG("rknn_run\n");
+    {
+        TRACE_ZONE(TRACE_STAGE_RUN, "rknn_run");
+        ret = rknn_run(app_ctx->rknn_ctx, nullptr);
+    }
     if (ret < 0) {
         printf("rknn_run fail! ret=%d\n", ret);
         return -1;
@@ -356,13 +355,19 @@ int inference_retinaface_model(rknn_app_context_t *app_ctx, image_buffer_t *src_
         outputs[i].index = i;
         outputs[i].want_float = 1;
     }
-    ret = rknn_outputs_get(app_ctx->rknn_ctx, 3, outputs, NULL);
+    {
+        TRACE_ZONE(TRACE_STAGE_OUTPUTS_GET, "rknn_outputs_get");
+        ret = rknn_outputs_get(app_ctx->rknn_ctx, 3, outputs, NULL);
+    }
     if (ret < 0) {
         printf("rknn_outputs_get fail! ret=%d\n", ret);
         goto out;
     }
 
-    ret = post_process_retinaface(app_ctx, src_img, outputs, out_result, &letter_box);
+    {
+        TRACE_ZONE(TRACE_STAGE_POSTPROCESS, "post_process_retinaface");
+        ret = post_process_retinaface(app_ctx, src_img, outputs, out_result, &letter_box);
+    }
     if (ret < 0) {
         printf("post_process_retinaface fail! ret=%d\n", ret);
         return -1;
@@ -20,7 +20,9 @@
 #include "rknn_clip_utils.h"
 #include "common.h"
 #include "file_utils.h"
+#include "model_registry.h"
 #include "image_utils.h"
+#include "trace_utils.h"
 
 
 static void dump_tensor_attr(rknn_tensor_attr* attr)
@@ -43,10 +45,10 @@ int init_clip_model_utils(rknn_clip_context* clip_ctx, const char* model_path)
     rknn_context ctx = 0;
 
     // Load RKNN Model
-    ret = rknn_init(&ctx, (char*)model_path, 0, 0, NULL);
+    ret = acquire_model_context(model_path, 0, &ctx);
     if (ret < 0)
     {
-        printf("rknn_init fail ret=%d\n", ret);
+        printf("acquire_model_context fail! ret=%d\n", ret);
         return -1;
     }
 
@@ -144,7 +146,7 @@ int release_clip_model_utils(rknn_clip_context* clip_ctx)
     }
     if (clip_ctx->rknn_ctx != 0)
     {
-        rknn_destroy(clip_ctx->rknn_ctx);
+        release_model_context(clip_ctx->rknn_ctx);
         clip_ctx->rknn_ctx = 0;
     }
     return 0;
@@ -215,7 +217,7 @@ int inference_clip_image_model_utils(rknn_clip_context* clip_ctx, image_buffer_t
     }
 
     // Run
-    printf("rknn_run\n");
+    TRACE_LOG("rknn_run\n");
     ret = rknn_run(clip_ctx->rknn_ctx, nullptr);
     if (ret < 0)
     {
@@ -277,7 +279,7 @@ int inference_clip_text_model_utils(rknn_clip_context* clip_ctx, int* tokens, fl
     }
 
     // Run
-    printf("rknn_run\n");
+    TRACE_LOG("rknn_run\n");
     ret = rknn_run(clip_ctx->rknn_ctx, NULL);
     if (ret < 0)
     {
@@ -8,7 +8,9 @@
 #include "deeplabv3.h"
 #include "common.h"
 #include "file_utils.h"
+#include "model_registry.h"
 #include "image_utils.h"
+#include "trace_utils.h"
 
 #include "gpu_compose_impl.h"
 #include "cl_kernels/kernel_upsampleSoftmax.h"
@@ -199,24 +201,15 @@ int init_deeplabv3_model(const char* model_path, rknn_app_context_t* app_ctx)
     using namespace std;
     
     int ret;
-    int model_len = 0;
-    char* model;
     rknn_context ctx = 0;
 
     if (!Gpu_Impl)
         Gpu_Impl = make_shared<gpu_compose_impl>();     
 
     // Load RKNN Model
-    model_len = read_data_from_file(model_path, &model);
-    if (model == NULL) {
-        printf("load_model fail!\n");
-        return -1;
-    }
-
-    ret = rknn_init(&ctx, model, model_len, 0, NULL);
-    free(model);
+    ret = acquire_model_context(model_path, 0, &ctx);
     if (ret < 0) {
-        printf("rknn_init fail! ret=%d\n", ret);
+        printf("acquire_model_context fail! ret=%d\n", ret);
         return -1;
     }
 
@@ -293,7 +286,7 @@ int release_deeplabv3_model(rknn_app_context_t* app_ctx)
         app_ctx->output_attrs = NULL;
     }
     if (app_ctx->rknn_ctx != 0) {
-        rknn_destroy(app_ctx->rknn_ctx);
+        release_model_context(app_ctx->rknn_ctx);
         app_ctx->rknn_ctx = 0;
     }
     return 0;
@@ -431,7 +424,7 @@ int inference_deeplabv3_model(rknn_app_context_t* app_ctx, image_buffer_t* src_i
     float scale_h_inv = OUT_SIZE / (float)MASK_SIZE;
     
     // Run
-    printf("rknn_run\n");
+    TRACE_LOG("rknn_run\n");
     ret = rknn_run(app_ctx->rknn_ctx, nullptr);
     if (ret < 0) {
         printf("rknn_run fail! ret=%d\n", ret);
@@ -33,6 +33,7 @@
 // #include "cnpy.h"
 
 #include "easy_timer.h"
+#include "layout_utils.h"
 #include "bpe_tools.h"
 #include "rknn_demo_utils.h"
 #include "lite_transformer.h"
@@ -145,55 +146,29 @@ int decoder_token_2_word(int* output_token, char* strings, Bpe_Tools* bpe_tools)
     return 0;
 }
 
-// 1x4x16x64 -> 1x15x64x4
+// 1x4x16x64 -> 1x15x64x4, the first position is dropped
 int preprocess_prev_key_value(float *prev_data, float *save_data)
 {
-    float mid_data[MAX_SENTENCE_LEN * EMBEDDING_DIM];
-
-    // 1x4x16x64->1x16x64x4
-    for (int s = 0; s < MAX_SENTENCE_LEN * EMBEDDING_DIM / HEAD_NUM; s++)
-    {
-        for (int h = 0; h < HEAD_NUM; h++)
-        {
-            mid_data[s * HEAD_NUM + h] = save_data[h * MAX_SENTENCE_LEN * EMBEDDING_DIM / HEAD_NUM + s];
-        }
-    }
-
-    // 1x16x64x4->1x15x64x4
-    memcpy(prev_data, mid_data + EMBEDDING_DIM, (MAX_SENTENCE_LEN - 1) * EMBEDDING_DIM * sizeof(float));
-
-    return 0;
+    tensor_layout_desc_t src_desc;
+    tensor_layout_desc_t dst_desc;
+    // rows of EMBEDDING_DIM / HEAD_NUM values, one per sentence position, row 0 skipped
+    init_layout_desc(&src_desc, TENSOR_LAYOUT_NCHW, 1, HEAD_NUM, MAX_SENTENCE_LEN - 1, EMBEDDING_DIM / HEAD_NUM, 0);
+    src_desc.h_stride = MAX_SENTENCE_LEN;
+    init_layout_desc(&dst_desc, TENSOR_LAYOUT_NHWC, 1, HEAD_NUM, MAX_SENTENCE_LEN - 1, EMBEDDING_DIM / HEAD_NUM, 0);
+
+    return convert_layout(save_data + EMBEDDING_DIM / HEAD_NUM, &src_desc, prev_data, &dst_desc, sizeof(float), 0);
 }
 
-// 1x4x16x64 -> 1x15x64x4
+// 1x4x16x64 -> 1x4x15x64, zero-copy input keeps the head major layout
 int preprocess_prev_key_value_half(half *prev_data, half *save_data)
 {
-    half mid_data[MAX_SENTENCE_LEN * EMBEDDING_DIM];
+    tensor_layout_desc_t src_desc;
+    tensor_layout_desc_t dst_desc;
+    init_layout_desc(&src_desc, TENSOR_LAYOUT_NCHW, 1, HEAD_NUM, MAX_SENTENCE_LEN - 1, EMBEDDING_DIM / HEAD_NUM, 0);
+    src_desc.h_stride = MAX_SENTENCE_LEN;
+    init_layout_desc(&dst_desc, TENSOR_LAYOUT_NCHW, 1, HEAD_NUM, MAX_SENTENCE_LEN - 1, EMBEDDING_DIM / HEAD_NUM, 0);
 
-    // 1x4x16x64->1x16x64x4
-    for (int s = 0; s < MAX_SENTENCE_LEN * EMBEDDING_DIM / HEAD_NUM; s++)
-    {
-        for (int h = 0; h < HEAD_NUM; h++)
-        {
-            mid_data[s * HEAD_NUM + h] = save_data[h * MAX_SENTENCE_LEN * EMBEDDING_DIM / HEAD_NUM + s];
-        }
-    }
-
-    // 1x16x64x4->1x15x64x4
-    memcpy(prev_data, mid_data + EMBEDDING_DIM, (MAX_SENTENCE_LEN - 1) * EMBEDDING_DIM * sizeof(half));
-
-    half prev_mid_data[(MAX_SENTENCE_LEN - 1) * EMBEDDING_DIM];
-    memcpy(prev_mid_data, prev_data, (MAX_SENTENCE_LEN - 1) * EMBEDDING_DIM * sizeof(half));
-
-    // 1x1x64x4 -> 1x4x15x64
-    // zero-copy need layout [1,4,15,64]
-    for (int h = 0; h < HEAD_NUM; h++) {
-        for (int s = 0; s < (MAX_SENTENCE_LEN - 1) * EMBEDDING_DIM / HEAD_NUM; s++) {
-            prev_data[h * (MAX_SENTENCE_LEN - 1) * EMBEDDING_DIM / HEAD_NUM + s] = prev_mid_data[s  * HEAD_NUM + h];
-        }
-    }
-
-    return 0;
+    return convert_layout(save_data + EMBEDDING_DIM / HEAD_NUM, &src_desc, prev_data, &dst_desc, sizeof(half), 0);
 }
 
 int dump_float(const float *array, int count, bool is_in, int index)
@@ -33,6 +33,7 @@
 // #include "cnpy.h"
 
 #include "easy_timer.h"
+#include "layout_utils.h"
 #include "bpe_tools.h"
 #include "rknn_demo_utils.h"
 #include "lite_transformer.h"
@@ -54,44 +55,35 @@
 // }
 
 
-int token_embeding(float *token_embed, float *position_embed, int *tokens, int len, float *embedding){
+// fp16 embedding of tokens[begin, end): token_embed * sqrt(dim) + position_embed, fused into the conversion
+int token_embeding(float *token_embed, float *position_embed, int *tokens, int begin, int end, half *embedding){
     float scale = sqrt(EMBEDDING_DIM);
     int pad = 1;
-    for (int i = 0; i < len; i++){
-        for (int j = 0; j < EMBEDDING_DIM; j++){
-            embedding[i * EMBEDDING_DIM + j] = token_embed[tokens[i] * EMBEDDING_DIM + j] * scale;
-        }
-    }
-
-    for (int i = 0; i < len; i++){
+    for (int i = 0; i < end; i++){
         if (tokens[i] != 1){
             pad++;
         }
         else{
             pad = 1;
         }
-        for (int j = 0; j < EMBEDDING_DIM; j++){
-            embedding[i * EMBEDDING_DIM + j] += position_embed[EMBEDDING_DIM * pad + j];
+        if (i >= begin){
+            float_to_half_array_scaled(token_embed + tokens[i] * EMBEDDING_DIM, scale, position_embed + EMBEDDING_DIM * pad,
+                                       embedding + (i - begin) * EMBEDDING_DIM, EMBEDDING_DIM);
         }
     }
     return 0;
 }
 
 
-// 1x4x16x64 -> 1x15x64x4, nchw -> nhwc
+// 1x4x16x64 -> 1x15x64x4, nchw -> nhwc, the first position is dropped
 int preprocess_prev_key_value(float *prev_data, float *src_output_data, int decoder_len) {
-    float mid_data[decoder_len*EMBEDDING_DIM];
+    tensor_layout_desc_t src_desc;
+    tensor_layout_desc_t dst_desc;
+    init_layout_desc(&src_desc, TENSOR_LAYOUT_NCHW, 1, HEAD_NUM, decoder_len - 1, EMBEDDING_DIM / HEAD_NUM, 0);
+    src_desc.h_stride = decoder_len;
+    init_layout_desc(&dst_desc, TENSOR_LAYOUT_NHWC, 1, HEAD_NUM, decoder_len - 1, EMBEDDING_DIM / HEAD_NUM, 0);
 
-    // 1x4x16x64->1x16x64x4
-    for (int s=0; s<decoder_len*EMBEDDING_DIM/HEAD_NUM; s++) {
-        for (int h=0; h<HEAD_NUM; h++) {
-            mid_data[s*HEAD_NUM+h] = src_output_data[h*decoder_len*EMBEDDING_DIM/HEAD_NUM+s];
-        }
-    }
-
-    // 1x16x64x4->1x15x64x4
-    memcpy(prev_data, mid_data+EMBEDDING_DIM, (decoder_len-1)*EMBEDDING_DIM*sizeof(float));
-    return 0;
+    return convert_layout(src_output_data + EMBEDDING_DIM / HEAD_NUM, &src_desc, prev_data, &dst_desc, sizeof(float), 0);
 }
 
 
@@ -173,13 +165,9 @@ int rknn_nmt_process(
     TIMER timer_total;
 
     // share max buffer
-    float enc_embedding[app_ctx->enc_len * EMBEDDING_DIM];
-    float dec_embedding[app_ctx->dec_len * EMBEDDING_DIM];
     float enc_mask[app_ctx->enc_len];
     float dec_mask[app_ctx->dec_len];
     int input_token_sorted[app_ctx->enc_len];
-    memset(enc_embedding, 0x00, sizeof(enc_embedding));
-    memset(dec_embedding, 0x00, sizeof(dec_embedding));
     memset(enc_mask, 0x00, sizeof(enc_mask));
     memset(dec_mask, 0x00, sizeof(dec_mask));
 
@@ -234,8 +222,8 @@ int rknn_nmt_process(
         }
     }
 
-    token_embeding(app_ctx->nmt_tokens.enc_token_embed, app_ctx->nmt_tokens.enc_pos_embed, input_token_sorted, app_ctx->enc_len, enc_embedding);
-    float_to_half_array(enc_embedding, (half*)(app_ctx->enc.input_mem[0]->virt_addr), app_ctx->enc.in_attr[0].n_elems);
+    token_embeding(app_ctx->nmt_tokens.enc_token_embed, app_ctx->nmt_tokens.enc_pos_embed, input_token_sorted, 0, app_ctx->enc_len,
+                   (half*)(app_ctx->enc.input_mem[0]->virt_addr));
     float_to_half_array(enc_mask_expand, (half*)(app_ctx->enc.input_mem[1]->virt_addr), app_ctx->enc.in_attr[1].n_elems);
 
     // Run
@@ -267,8 +255,9 @@ int rknn_nmt_process(
     // decoder run
     timer_total.tik();
     for (int num_iter = 0; num_iter < app_ctx->dec_len; num_iter++){
-        token_embeding(app_ctx->nmt_tokens.dec_token_embed, app_ctx->nmt_tokens.dec_pos_embed, output_token, num_iter+1, dec_embedding);
-        float_to_half_array(dec_embedding + num_iter*EMBEDDING_DIM, (half*)(app_ctx->dec.input_mem[0]->virt_addr), app_ctx->dec.in_attr[0].n_elems);
+        // only the newest position is fed, earlier ones live in the key/value cache
+        token_embeding(app_ctx->nmt_tokens.dec_token_embed, app_ctx->nmt_tokens.dec_pos_embed, output_token, num_iter, num_iter+1,
+                       (half*)(app_ctx->dec.input_mem[0]->virt_addr));
 
         float mask;
         for (int j = 0; j < app_ctx->dec_len; j++){
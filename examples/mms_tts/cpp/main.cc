@@ -24,6 +24,27 @@
 #include <vector>
 #include <string>
 
+typedef struct
+{
+    audio_writer_t writer;
+    TIMER *timer;
+    float first_audio_time; // ms
+    int num_samples;
+} audio_output_t;
+
+// every sentence is appended to the wav file as soon as it is decoded
+static int write_sentence(void *userdata, const float *pcm, int num_samples)
+{
+    audio_output_t *output = (audio_output_t *)userdata;
+    if (output->num_samples == 0)
+    {
+        output->timer->tok();
+        output->first_audio_time = output->timer->get_time();
+    }
+    output->num_samples += num_samples;
+    return write_audio(&output->writer, pcm, num_samples);
+}
+
 /*-------------------------------------------
                   Main Function
 -------------------------------------------*/
@@ -44,14 +65,13 @@ int main(int argc, char **argv)
     TIMER timer;
     rknn_mms_tts_context_t rknn_app_ctx;
     std::map<char, int> vocab;
-    std::vector<int64_t> input_ids(MAX_LENGTH, 0);
-    std::vector<int64_t> attention_mask(MAX_LENGTH, 0);
+    audio_output_t output;
     float infer_time = 0.0;
-    int predicted_lengths_max_real = 0;
     float audio_length = 0.0;
-    float max_audio_length = (float)PREDICTED_LENGTHS_MAX * PREDICTED_BATCH / SAMPLE_RATE;
     float rtf = 0.0;
     memset(&rknn_app_ctx, 0, sizeof(rknn_mms_tts_context_t));
+    memset(&output, 0, sizeof(audio_output_t));
+    output.timer = &timer;
 
     timer.tik();
     ret = init_mms_tts_model(encoder_path, &rknn_app_ctx.encoder_context);
@@ -79,19 +99,27 @@ int main(int argc, char **argv)
     timer.tok();
     timer.print_time("read_vocab");
 
+    ret = open_audio_writer(audio_save_path, SAMPLE_RATE, 1, &output.writer);
+    if (ret != 0)
+    {
+        printf("open_audio_writer fail! ret=%d\n", ret);
+        goto out;
+    }
+
     timer.tik();
-    preprocess_input(input_text, vocab, VOCAB_NUM, MAX_LENGTH, input_ids, attention_mask);
-    ret = inference_mms_tts_model(&rknn_app_ctx, input_ids, attention_mask, predicted_lengths_max_real, audio_save_path);
+    ret = inference_mms_tts_stream(&rknn_app_ctx, vocab, input_text, write_sentence, &output);
+    close_audio_writer(&output.writer);
     if (ret != 0)
     {
-        printf("inference_mms_tts_model fail! ret=%d\n", ret);
+        printf("inference_mms_tts_stream fail! ret=%d\n", ret);
         goto out;
     }
     timer.tok();
     timer.print_time("inference_mms_tts_model");
+    printf("-- time to first audio: %f ms\n", output.first_audio_time);
 
-    infer_time = timer.get_time() / 1000.0; // sec
-    audio_length = max_audio_length;        // sec
+    infer_time = timer.get_time() / 1000.0;                   // sec
+    audio_length = (float)output.num_samples / SAMPLE_RATE;   // sec
     rtf = infer_time / audio_length;
     printf("\nReal Time Factor (RTF): %.3f / %.3f = %.3f\n", infer_time, audio_length, rtf);
     printf("\nThe output wav file is saved: %s\n", audio_save_path);
@@ -39,4 +39,30 @@ int init_mms_tts_model(const char *model_path, rknn_app_context_t *app_ctx);
 int release_mms_tts_model(rknn_app_context_t *app_ctx);
 int inference_mms_tts_model(rknn_mms_tts_context_t *app_ctx, std::vector<int64_t> &input_ids, std::vector<int64_t> &attention_mask, int &predicted_lengths_max_real, const char *audio_save_path);
 
+/**
+ * @brief Called with the waveform of each sentence as soon as it is decoded
+ *
+ * @param userdata [in] User data passed to inference_mms_tts_stream
+ * @param pcm [in] Mono SAMPLE_RATE samples, only valid during the call
+ * @param num_samples [in] Sample count
+ * @return int 0: continue; != 0: stop synthesis and return this value
+ */
+typedef int (*mms_tts_audio_callback)(void *userdata, const float *pcm, int num_samples);
+
+/**
+ * @brief Synthesize text of any length sentence by sentence
+ *
+ * The encoder of the next sentence runs while the current one is decoded, so the
+ * first audio arrives after one sentence whatever the text length.
+ *
+ * @param app_ctx [in] Encoder and decoder contexts
+ * @param vocab [in] Vocab from read_vocab
+ * @param text [in] Text
+ * @param callback [in] Receives the audio of every sentence in order
+ * @param userdata [in] User data for callback
+ * @return int 0: success; < 0: error; otherwise the callback return value
+ */
+int inference_mms_tts_stream(rknn_mms_tts_context_t *app_ctx, const std::map<char, int> &vocab, const char *text,
+                             mms_tts_audio_callback callback, void *userdata);
+
 #endif //_RKNN_DEMO_MMS_TTS_H_
\ No newline at end of file
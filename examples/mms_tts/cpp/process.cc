@@ -32,91 +32,28 @@ static int strlenarr(const char *arr)
     return count;
 }
 
-static void compute_output_padding_mask(std::vector<float> &output_padding_mask, int predicted_lengths_max_real, int predicted_lengths_max)
+static bool is_sentence_end(char c)
 {
-    std::transform(output_padding_mask.begin(), output_padding_mask.end(), output_padding_mask.begin(),
-                   [predicted_lengths_max_real](int i)
-                   {
-                       return (float)(i < predicted_lengths_max_real);
-                   });
+    return c == '.' || c == '!' || c == '?' || c == ';' || c == '\n';
 }
 
-static void compute_attn_mask(std::vector<float> &output_padding_mask, std::vector<float> &input_padding_mask,
-                              std::vector<int> &attn_mask, int predicted_lengths_max, int input_padding_mask_size)
+static void push_sentence(std::vector<std::string> &sentences, const std::string &sentence, const std::map<char, int> &vocab)
 {
-    std::transform(attn_mask.begin(), attn_mask.end(), attn_mask.begin(),
-                   [&output_padding_mask, &input_padding_mask, predicted_lengths_max, input_padding_mask_size](int index)
-                   {
-                       int i = index / input_padding_mask_size;
-                       int j = index % input_padding_mask_size;
-                       return int(output_padding_mask[i] * input_padding_mask[j]);
-                   });
-}
-
-static void compute_duration(const std::vector<float> &exp_log_duration, const std::vector<float> &input_padding_mask,
-                             std::vector<float> &duration, float length_scale)
-{
-    std::transform(exp_log_duration.begin(), exp_log_duration.end(), input_padding_mask.begin(), duration.begin(),
-                   [length_scale](float exp_log_val, float mask_val)
-                   {
-                       return ceil(exp_log_val * mask_val * length_scale);
-                   });
-}
-
-static void compute_valid_indices(const std::vector<float> &cum_duration, std::vector<int> &valid_indices, int input_padding_mask_size, int predicted_lengths_max)
-{
-    std::vector<int> indices(valid_indices.size());
-    std::iota(indices.begin(), indices.end(), 0);
-
-    std::for_each(indices.begin(), indices.end(),
-                  [cum_duration, &valid_indices, predicted_lengths_max](int index)
-                  {
-                      int i = index / predicted_lengths_max;
-                      int j = index % predicted_lengths_max;
-                      valid_indices[index] = j < cum_duration[i] ? 1 : 0;
-                  });
-}
-
-static std::vector<float> exp_vector(const std::vector<float> &vec)
-{
-    std::vector<float> result(vec.size());
-    std::transform(vec.begin(), vec.end(), result.begin(), [](float v)
-                   { return exp(v); });
-    return result;
-}
-
-static std::vector<float> cumsum(const std::vector<float> &vec)
-{
-    std::vector<float> result(vec.size());
-    std::partial_sum(vec.begin(), vec.end(), result.begin());
-    return result;
-}
-
-static void transpose_mul(const std::vector<int> &input, int input_rows, int input_cols, std::vector<int> attn_mask, std::vector<float> &output)
-{
-    std::vector<int> indices(input.size());
-    std::iota(indices.begin(), indices.end(), 0);
-
-    std::for_each(indices.begin(), indices.end(),
-                  [&input, &attn_mask, &output, input_rows, input_cols](int index)
-                  {
-                      int i = index / input_cols;
-                      int j = index % input_cols;
-                      output[j * input_rows + i] = (float)(input[index] * attn_mask[j * input_rows + i]);
-                  });
-}
-
-static void compute_pad_indices(const std::vector<int> &valid_indices, std::vector<int> &sliced_indices, int input_length, int output_length)
-{
-    int padded_length = input_length + 1;
-    std::vector<int> padded_indices(padded_length * output_length, 0);
-
-    std::copy(valid_indices.begin(), valid_indices.end(), padded_indices.begin() + output_length);
-
-    std::copy(padded_indices.begin(), padded_indices.begin() + input_length * output_length, sliced_indices.begin());
-
-    std::transform(valid_indices.begin(), valid_indices.end(), sliced_indices.begin(),
-                   sliced_indices.begin(), std::minus<int>());
+    size_t first = sentence.find_first_not_of(' ');
+    if (first == std::string::npos)
+    {
+        return;
+    }
+    size_t last = sentence.find_last_not_of(' ');
+    // sentences made only of punctuation would be decoded as silence
+    for (size_t i = first; i <= last; i++)
+    {
+        if (vocab.find(tolower((unsigned char)sentence[i])) != vocab.end())
+        {
+            sentences.push_back(sentence.substr(first, last - first + 1));
+            return;
+        }
+    }
 }
 
 void read_vocab(std::map<char, int> &vocab)
@@ -127,62 +64,110 @@ void read_vocab(std::map<char, int> &vocab)
         {'o', 22}, {'p', 13}, {'q', 34}, {'r', 25}, {'s', 8}, {'t', 33}, {'u', 4}, {'v', 32}, {'w', 9}, {'x', 31}, {'y', 3}, {'z', 2}, {u'\u2013', 10}};
 }
 
-void preprocess_input(const char *text, std::map<char, int> vocab, int vocab_size, int max_length, std::vector<int64_t> &input_ids,
+void preprocess_input(const char *text, const std::map<char, int> &vocab, int vocab_size, int max_length, std::vector<int64_t> &input_ids,
                       std::vector<int64_t> &attention_mask)
 {
     int text_len = strlenarr(text);
     int input_len = 0;
 
-    for (int i = 0; i < text_len; i++)
+    for (int i = 0; i < text_len && input_len < max_length - 2; i++)
     {
-        char token = tolower(text[i]);
-        int token_index = vocab[token];
-
-        if (input_len < max_length - 2)
-        {
-            input_ids[input_len++] = 0;
-            input_ids[input_len++] = token_index;
-        }
-        else
+        // characters outside the vocab are skipped, same as the python demo
+        std::map<char, int>::const_iterator token = vocab.find(tolower((unsigned char)text[i]));
+        if (token == vocab.end())
         {
-            break;
+            continue;
         }
+        input_ids[input_len++] = 0;
+        input_ids[input_len++] = token->second;
     }
 
     input_ids[input_len++] = 0;
 
-    for (int i = 0; i < input_len; i++)
+    // buffers are reused between sentences
+    std::fill(input_ids.begin() + input_len, input_ids.end(), 0);
+    std::fill(attention_mask.begin(), attention_mask.begin() + input_len, 1);
+    std::fill(attention_mask.begin() + input_len, attention_mask.end(), 0);
+}
+
+void split_sentences(const char *text, const std::map<char, int> &vocab, std::vector<std::string> &sentences)
+{
+    std::string sentence;
+    int chars = 0;       // characters of sentence in vocab
+    size_t split = 0;    // sentence length after its last ',' or ' ', 0: none
+    int split_chars = 0; // chars before split
+
+    sentences.clear();
+    for (const char *p = text;; p++)
     {
-        attention_mask[i] = 1;
+        char c = *p;
+        if (c == '\0' || is_sentence_end(c))
+        {
+            if (c != '\0' && c != '\n')
+            {
+                sentence += c;
+            }
+            push_sentence(sentences, sentence, vocab);
+            if (c == '\0')
+            {
+                break;
+            }
+            sentence.clear();
+            chars = 0;
+            split = 0;
+            continue;
+        }
+
+        bool in_vocab = vocab.find(tolower((unsigned char)c)) != vocab.end();
+        if (in_vocab && chars == SENTENCE_MAX_CHARS)
+        {
+            if (split > 0 && split_chars > 0)
+            {
+                push_sentence(sentences, sentence.substr(0, split), vocab);
+                sentence.erase(0, split);
+                chars -= split_chars;
+            }
+            else
+            {
+                // a single word longer than a sentence
+                push_sentence(sentences, sentence, vocab);
+                sentence.clear();
+                chars = 0;
+            }
+            split = 0;
+        }
+        sentence += c;
+        chars += in_vocab;
+        if (c == ',' || c == ' ')
+        {
+            split = sentence.size();
+            split_chars = chars;
+        }
     }
 }
 
-void middle_process(std::vector<float> log_duration, std::vector<float> input_padding_mask, std::vector<float> &attn,
+void middle_process(const std::vector<float> &log_duration, const std::vector<float> &input_padding_mask, std::vector<float> &attn,
                     std::vector<float> &output_padding_mask, int &predicted_lengths_max_real)
 {
-
     float speaking_rate = 1.0f;
     float length_scale = 1.0f / speaking_rate;
 
-    std::vector<float> duration(LOG_DURATION_SIZE);
-    std::vector<float> exp_log_duration = exp_vector(log_duration);
-    compute_duration(exp_log_duration, input_padding_mask, duration, length_scale);
-
-    float predicted_length_sum = std::accumulate(duration.begin(), duration.end(), 0.0f);
-    predicted_lengths_max_real = std::max(1.0f, predicted_length_sum);
-    int predicted_lengths_max = PREDICTED_LENGTHS_MAX;
-    compute_output_padding_mask(output_padding_mask, predicted_lengths_max_real, predicted_lengths_max);
-
-    int input_padding_mask_size = MAX_LENGTH;
-    std::vector<int> attn_mask(predicted_lengths_max * input_padding_mask_size);
-    compute_attn_mask(output_padding_mask, input_padding_mask, attn_mask, predicted_lengths_max, input_padding_mask_size);
-
-    std::vector<float> cum_duration = cumsum(duration);
-    std::vector<int> valid_indices(input_padding_mask_size * predicted_lengths_max, 0);
-    compute_valid_indices(cum_duration, valid_indices, input_padding_mask_size, predicted_lengths_max);
-
-    std::vector<int> padded_indices(input_padding_mask_size * predicted_lengths_max, 0);
-    compute_pad_indices(valid_indices, padded_indices, input_padding_mask_size, predicted_lengths_max);
+    // walk the cumulative durations once, token i fills frames [frame, frame + duration)
+    std::fill(attn.begin(), attn.end(), 0.0f);
+    int frame = 0;
+    for (int i = 0; i < MAX_LENGTH && frame < PREDICTED_LENGTHS_MAX; i++)
+    {
+        float duration = ceilf(expf(log_duration[i]) * input_padding_mask[i] * length_scale);
+        int end = duration < PREDICTED_LENGTHS_MAX - frame ? frame + (int)duration : PREDICTED_LENGTHS_MAX;
+        for (; frame < end; frame++)
+        {
+            attn[frame * MAX_LENGTH + i] = 1.0f;
+        }
+    }
 
-    transpose_mul(padded_indices, input_padding_mask_size, predicted_lengths_max, attn_mask, attn);
-}
\ No newline at end of file
+    predicted_lengths_max_real = std::max(1, frame);
+    for (int t = 0; t < PREDICTED_LENGTHS_MAX; t++)
+    {
+        output_padding_mask[t] = (float)(t < predicted_lengths_max_real);
+    }
+}
@@ -5,25 +5,55 @@
 #include "easy_timer.h"
 #include "audio_utils.h"
 #include <map>
+#include <string>
+#include <vector>
 
 #define VOCAB_NUM 38
 #define SAMPLE_RATE 16000
 
 #define MAX_LENGTH 200
-#define PREDICTED_LENGTHS_MAX MAX_LENGTH * 2
+#define PREDICTED_LENGTHS_MAX (MAX_LENGTH * 2)
 #define PREDICTED_BATCH 256
+// characters of one sentence, each takes two ids and the sequence ends with a 0 id
+#define SENTENCE_MAX_CHARS ((MAX_LENGTH - 1) / 2)
 
-#define INPUT_IDS_SIZE 1 * MAX_LENGTH
-#define ATTENTION_MASK_SIZE 1 * MAX_LENGTH
-#define LOG_DURATION_SIZE 1 * 1 * MAX_LENGTH
-#define INPUT_PADDING_MASK_SIZE 1 * 1 * MAX_LENGTH
-#define PRIOR_MEANS_SIZE 1 * MAX_LENGTH * 192
-#define PRIOR_LOG_VARIANCES_SIZE 1 * MAX_LENGTH * 192
-#define ATTN_SIZE 1 * 1 * PREDICTED_LENGTHS_MAX *MAX_LENGTH
-#define OUTPUT_PADDING_MASK_SIZE 1 * 1 * PREDICTED_LENGTHS_MAX
+#define INPUT_IDS_SIZE (1 * MAX_LENGTH)
+#define ATTENTION_MASK_SIZE (1 * MAX_LENGTH)
+#define LOG_DURATION_SIZE (1 * 1 * MAX_LENGTH)
+#define INPUT_PADDING_MASK_SIZE (1 * 1 * MAX_LENGTH)
+#define PRIOR_MEANS_SIZE (1 * MAX_LENGTH * 192)
+#define PRIOR_LOG_VARIANCES_SIZE (1 * MAX_LENGTH * 192)
+#define ATTN_SIZE (1 * 1 * PREDICTED_LENGTHS_MAX * MAX_LENGTH)
+#define OUTPUT_PADDING_MASK_SIZE (1 * 1 * PREDICTED_LENGTHS_MAX)
 
-void preprocess_input(const char *text, std::map<char, int> vocab, int vocab_size, int max_length, std::vector<int64_t> &input_id, std::vector<int64_t> &attention_mask);
+void preprocess_input(const char *text, const std::map<char, int> &vocab, int vocab_size, int max_length, std::vector<int64_t> &input_id, std::vector<int64_t> &attention_mask);
 void read_vocab(std::map<char, int> &vocab);
-void middle_process(std::vector<float> log_duration, std::vector<float> input_padding_mask, std::vector<float> &attn, std::vector<float> &output_padding_mask, int &predicted_lengths_max_real);
+
+/**
+ * @brief Split text into sentences that each fit into one encoder run
+ *
+ * Splits after '.', '!', '?', ';' and line breaks. Sentences longer than SENTENCE_MAX_CHARS
+ * are split again at the last ',' or ' ' that fits.
+ *
+ * @param text [in] Text of any length
+ * @param vocab [in] Vocab, characters outside it are not counted
+ * @param sentences [out] Sentences with at least one character in vocab
+ */
+void split_sentences(const char *text, const std::map<char, int> &vocab, std::vector<std::string> &sentences);
+
+/**
+ * @brief Build the decoder alignment from the encoder durations
+ *
+ * Token i covers output frames [cum_duration[i - 1], cum_duration[i]), attn row t holds a
+ * single 1 at the token covering frame t. Frames past PREDICTED_LENGTHS_MAX are dropped.
+ *
+ * @param log_duration [in] Encoder log durations, MAX_LENGTH
+ * @param input_padding_mask [in] Encoder padding mask, MAX_LENGTH
+ * @param attn [out] PREDICTED_LENGTHS_MAX * MAX_LENGTH
+ * @param output_padding_mask [out] PREDICTED_LENGTHS_MAX
+ * @param predicted_lengths_max_real [out] Output frames, each is PREDICTED_BATCH samples
+ */
+void middle_process(const std::vector<float> &log_duration, const std::vector<float> &input_padding_mask, std::vector<float> &attn,
+                    std::vector<float> &output_padding_mask, int &predicted_lengths_max_real);
 
 #endif //_RKNN_MMS_TTS_DEMO_PROCESS_H_
@@ -18,7 +18,9 @@
 #include <math.h>
 #include "mms_tts.h"
 #include "file_utils.h"
+#include "model_registry.h"
 #include <vector>
+#include <pthread.h>
 #include "process.h"
 
 static void dump_tensor_attr(rknn_tensor_attr *attr)
@@ -47,13 +49,12 @@ static void dump_tensor_attr(rknn_tensor_attr *attr)
 int init_mms_tts_model(const char *model_path, rknn_app_context_t *app_ctx)
 {
     int ret;
-    int model_len = 0;
     rknn_context ctx = 0;
 
-    ret = rknn_init(&ctx, (char *)model_path, model_len, 0, NULL);
+    ret = acquire_model_context(model_path, 0, &ctx);
     if (ret < 0)
     {
-        printf("rknn_init fail! ret=%d\n", ret);
+        printf("acquire_model_context fail! ret=%d\n", ret);
         return -1;
     }
 
@@ -124,13 +125,13 @@ int release_mms_tts_model(rknn_app_context_t *app_ctx)
     }
     if (app_ctx->rknn_ctx != 0)
     {
-        rknn_destroy(app_ctx->rknn_ctx);
+        release_model_context(app_ctx->rknn_ctx);
         app_ctx->rknn_ctx = 0;
     }
     return 0;
 }
 
-int inference_encoder_model(rknn_app_context_t *app_ctx, std::vector<int64_t> &input_ids, std::vector<int64_t> &attention_mask,
+int inference_encoder_model(rknn_app_context_t *app_ctx, const std::vector<int64_t> &input_ids, const std::vector<int64_t> &attention_mask,
                             std::vector<float> &log_duration, std::vector<float> &input_padding_mask, std::vector<float> &prior_means, std::vector<float> &prior_log_variances)
 {
     int ret;
@@ -142,24 +143,22 @@ int inference_encoder_model(rknn_app_context_t *app_ctx, std::vector<int64_t> &i
     memset(inputs, 0, sizeof(inputs));
     memset(outputs, 0, sizeof(outputs));
 
-    // Set Input Data
+    // Set Input Data, rknn_inputs_set copies the buffers
     inputs[0].index = 0;
     inputs[0].type = RKNN_TENSOR_INT64;
     inputs[0].size = INPUT_IDS_SIZE * sizeof(int64_t);
-    inputs[0].buf = (int64_t *)malloc(inputs[0].size);
-    memcpy(inputs[0].buf, input_ids.data(), inputs[0].size);
+    inputs[0].buf = (void *)input_ids.data();
 
     inputs[1].index = 1;
     inputs[1].type = RKNN_TENSOR_INT64;
     inputs[1].size = ATTENTION_MASK_SIZE * sizeof(int64_t);
-    inputs[1].buf = (int64_t *)malloc(inputs[1].size);
-    memcpy(inputs[1].buf, attention_mask.data(), inputs[1].size);
+    inputs[1].buf = (void *)attention_mask.data();
 
     ret = rknn_inputs_set(app_ctx->rknn_ctx, n_input, inputs);
     if (ret < 0)
     {
         printf("rknn_input_set fail! ret=%d\n", ret);
-        goto out;
+        return ret;
     }
 
     // Run
@@ -167,43 +166,38 @@ int inference_encoder_model(rknn_app_context_t *app_ctx, std::vector<int64_t> &i
     if (ret < 0)
     {
         printf("rknn_run fail! ret=%d\n", ret);
-        goto out;
+        return ret;
     }
 
-    // Get Output
+    // Get Output, written straight into the caller buffers
+    outputs[0].buf = log_duration.data();
+    outputs[0].size = LOG_DURATION_SIZE * sizeof(float);
+    outputs[1].buf = input_padding_mask.data();
+    outputs[1].size = INPUT_PADDING_MASK_SIZE * sizeof(float);
+    outputs[2].buf = prior_means.data();
+    outputs[2].size = PRIOR_MEANS_SIZE * sizeof(float);
+    outputs[3].buf = prior_log_variances.data();
+    outputs[3].size = PRIOR_LOG_VARIANCES_SIZE * sizeof(float);
     for (int i = 0; i < n_output; i++)
     {
         outputs[i].want_float = 1;
+        outputs[i].is_prealloc = 1;
     }
     ret = rknn_outputs_get(app_ctx->rknn_ctx, n_output, outputs, NULL);
     if (ret < 0)
     {
         printf("rknn_outputs_get fail! ret=%d\n", ret);
-        goto out;
+        return ret;
     }
 
-    memcpy(log_duration.data(), (float *)outputs[0].buf, LOG_DURATION_SIZE * sizeof(float));
-    memcpy(input_padding_mask.data(), (float *)outputs[1].buf, INPUT_PADDING_MASK_SIZE * sizeof(float));
-    memcpy(prior_means.data(), (float *)outputs[2].buf, PRIOR_MEANS_SIZE * sizeof(float));
-    memcpy(prior_log_variances.data(), (float *)outputs[3].buf, PRIOR_LOG_VARIANCES_SIZE * sizeof(float));
-
-out:
-
     // Remeber to release rknn output
     rknn_outputs_release(app_ctx->rknn_ctx, n_output, outputs);
-    for (int i = 0; i < n_input; i++)
-    {
-        if (inputs[i].buf != NULL)
-        {
-            free(inputs[i].buf);
-        }
-    }
 
     return ret;
 }
 
-int inference_decoder_model(rknn_app_context_t *app_ctx, std::vector<float> attn, std::vector<float> output_padding_mask,
-                            std::vector<float> prior_means, std::vector<float> prior_log_variances, std::vector<float> &output_wav_data)
+int inference_decoder_model(rknn_app_context_t *app_ctx, const std::vector<float> &attn, const std::vector<float> &output_padding_mask,
+                            const std::vector<float> &prior_means, const std::vector<float> &prior_log_variances, float *output_wav_data, int num_samples)
 {
     int ret;
     int n_input = 4;
@@ -214,37 +208,33 @@ int inference_decoder_model(rknn_app_context_t *app_ctx, std::vector<float> attn
     memset(inputs, 0, sizeof(inputs));
     memset(outputs, 0, sizeof(outputs));
 
-    // Set Input Data
+    // Set Input Data, rknn_inputs_set copies the buffers
     inputs[0].index = 0;
     inputs[0].type = RKNN_TENSOR_FLOAT32;
     inputs[0].size = ATTN_SIZE * sizeof(float);
-    inputs[0].buf = (float *)malloc(inputs[0].size);
+    inputs[0].buf = (void *)attn.data();
     inputs[0].fmt = RKNN_TENSOR_NHWC;
-    memcpy(inputs[0].buf, attn.data(), inputs[0].size);
 
     inputs[1].index = 1;
     inputs[1].type = RKNN_TENSOR_FLOAT32;
     inputs[1].size = OUTPUT_PADDING_MASK_SIZE * sizeof(float);
-    inputs[1].buf = (float *)malloc(inputs[1].size);
-    memcpy(inputs[1].buf, output_padding_mask.data(), inputs[1].size);
+    inputs[1].buf = (void *)output_padding_mask.data();
 
     inputs[2].index = 2;
     inputs[2].type = RKNN_TENSOR_FLOAT32;
     inputs[2].size = PRIOR_MEANS_SIZE * sizeof(float);
-    inputs[2].buf = (float *)malloc(inputs[2].size);
-    memcpy(inputs[2].buf, prior_means.data(), inputs[2].size);
+    inputs[2].buf = (void *)prior_means.data();
 
     inputs[3].index = 3;
     inputs[3].type = RKNN_TENSOR_FLOAT32;
     inputs[3].size = PRIOR_LOG_VARIANCES_SIZE * sizeof(float);
-    inputs[3].buf = (float *)malloc(inputs[3].size);
-    memcpy(inputs[3].buf, prior_log_variances.data(), inputs[3].size);
+    inputs[3].buf = (void *)prior_log_variances.data();
 
     ret = rknn_inputs_set(app_ctx->rknn_ctx, n_input, inputs);
     if (ret < 0)
     {
         printf("rknn_input_set fail! ret=%d\n", ret);
-        goto out;
+        return ret;
     }
 
     // Run
@@ -252,7 +242,7 @@ int inference_decoder_model(rknn_app_context_t *app_ctx, std::vector<float> attn
     if (ret < 0)
     {
         printf("rknn_run fail! ret=%d\n", ret);
-        goto out;
+        return ret;
     }
 
     // Get Output
@@ -261,22 +251,13 @@ int inference_decoder_model(rknn_app_context_t *app_ctx, std::vector<float> attn
     if (ret < 0)
     {
         printf("rknn_outputs_get fail! ret=%d\n", ret);
-        goto out;
+        return ret;
     }
 
-    memcpy(output_wav_data.data(), (float *)outputs[0].buf, output_wav_data.size() * sizeof(float));
-
-out:
+    memcpy(output_wav_data, (float *)outputs[0].buf, num_samples * sizeof(float));
 
     // Remeber to release rknn output
     rknn_outputs_release(app_ctx->rknn_ctx, n_output, outputs);
-    for (int i = 0; i < n_input; i++)
-    {
-        if (inputs[i].buf != NULL)
-        {
-            free(inputs[i].buf);
-        }
-    }
 
     return ret;
 }
@@ -310,7 +291,7 @@ int inference_mms_tts_model(rknn_mms_tts_context_t *app_ctx, std::vector<int64_t
 
     // timer.tik();
     output_wav_data.resize(predicted_lengths_max_real * PREDICTED_BATCH);
-    ret = inference_decoder_model(&app_ctx->decoder_context, attn, output_padding_mask, prior_means, prior_log_variances, output_wav_data);
+    ret = inference_decoder_model(&app_ctx->decoder_context, attn, output_padding_mask, prior_means, prior_log_variances, output_wav_data.data(), output_wav_data.size());
     if (ret != 0)
     {
         printf("inference_decoder_model fail! ret=%d\n", ret);
@@ -332,4 +313,120 @@ int inference_mms_tts_model(rknn_mms_tts_context_t *app_ctx, std::vector<int64_t
 out:
 
     return ret;
-}
\ No newline at end of file
+}
+
+// encoder input and output of one sentence
+typedef struct
+{
+    rknn_app_context_t *encoder_context;
+    std::vector<int64_t> input_ids;
+    std::vector<int64_t> attention_mask;
+    std::vector<float> log_duration;
+    std::vector<float> input_padding_mask;
+    std::vector<float> prior_means;
+    std::vector<float> prior_log_variances;
+    int ret;
+} encoder_job_t;
+
+static void init_encoder_job(encoder_job_t *job, rknn_app_context_t *encoder_context)
+{
+    job->encoder_context = encoder_context;
+    job->input_ids.resize(INPUT_IDS_SIZE);
+    job->attention_mask.resize(ATTENTION_MASK_SIZE);
+    job->log_duration.resize(LOG_DURATION_SIZE);
+    job->input_padding_mask.resize(INPUT_PADDING_MASK_SIZE);
+    job->prior_means.resize(PRIOR_MEANS_SIZE);
+    job->prior_log_variances.resize(PRIOR_LOG_VARIANCES_SIZE);
+    job->ret = 0;
+}
+
+static void *run_encoder_job(void *arg)
+{
+    encoder_job_t *job = (encoder_job_t *)arg;
+    job->ret = inference_encoder_model(job->encoder_context, job->input_ids, job->attention_mask, job->log_duration,
+                                       job->input_padding_mask, job->prior_means, job->prior_log_variances);
+    return NULL;
+}
+
+static int decode_sentence(rknn_app_context_t *decoder_context, const encoder_job_t *job, std::vector<float> &attn, std::vector<float> &output_padding_mask,
+                           std::vector<float> &output_wav_data, mms_tts_audio_callback callback, void *userdata)
+{
+    int predicted_lengths_max_real = 0;
+    middle_process(job->log_duration, job->input_padding_mask, attn, output_padding_mask, predicted_lengths_max_real);
+    if (predicted_lengths_max_real == PREDICTED_LENGTHS_MAX)
+    {
+        printf("sentence longer than %d frames, the rest is cut\n", PREDICTED_LENGTHS_MAX);
+    }
+
+    int num_samples = predicted_lengths_max_real * PREDICTED_BATCH;
+    int ret = inference_decoder_model(decoder_context, attn, output_padding_mask, job->prior_means, job->prior_log_variances,
+                                      output_wav_data.data(), num_samples);
+    if (ret != 0)
+    {
+        printf("inference_decoder_model fail! ret=%d\n", ret);
+        return ret;
+    }
+    return callback(userdata, output_wav_data.data(), num_samples);
+}
+
+int inference_mms_tts_stream(rknn_mms_tts_context_t *app_ctx, const std::map<char, int> &vocab, const char *text,
+                             mms_tts_audio_callback callback, void *userdata)
+{
+    int ret = 0;
+    std::vector<std::string> sentences;
+    split_sentences(text, vocab, sentences);
+    if (sentences.empty())
+    {
+        printf("no text to synthesize\n");
+        return -1;
+    }
+
+    // the decoder reads one job while the encoder fills the other
+    encoder_job_t jobs[2];
+    init_encoder_job(&jobs[0], &app_ctx->encoder_context);
+    init_encoder_job(&jobs[1], &app_ctx->encoder_context);
+    std::vector<float> attn(ATTN_SIZE);
+    std::vector<float> output_padding_mask(OUTPUT_PADDING_MASK_SIZE);
+    std::vector<float> output_wav_data(PREDICTED_LENGTHS_MAX * PREDICTED_BATCH);
+
+    preprocess_input(sentences[0].c_str(), vocab, VOCAB_NUM, MAX_LENGTH, jobs[0].input_ids, jobs[0].attention_mask);
+    run_encoder_job(&jobs[0]);
+
+    for (size_t k = 0; k < sentences.size(); k++)
+    {
+        encoder_job_t *cur = &jobs[k & 1];
+        encoder_job_t *next = &jobs[(k + 1) & 1];
+        if (cur->ret != 0)
+        {
+            printf("inference_encoder_model fail! ret=%d\n", cur->ret);
+            return cur->ret;
+        }
+
+        // encoder of sentence k + 1 runs on its own context while sentence k is decoded
+        bool has_next = k + 1 < sentences.size();
+        bool next_async = false;
+        pthread_t thread;
+        if (has_next)
+        {
+            preprocess_input(sentences[k + 1].c_str(), vocab, VOCAB_NUM, MAX_LENGTH, next->input_ids, next->attention_mask);
+            next_async = pthread_create(&thread, NULL, run_encoder_job, next) == 0;
+        }
+
+        ret = decode_sentence(&app_ctx->decoder_context, cur, attn, output_padding_mask, output_wav_data, callback, userdata);
+
+        if (next_async)
+        {
+            pthread_join(thread, NULL);
+        }
+        if (ret != 0)
+        {
+            return ret;
+        }
+        if (has_next && !next_async)
+        {
+            run_encoder_job(next);
+        }
+    }
+
+    return ret;
+}
@@ -19,24 +19,98 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 
 #include "mobilenet.h"
 #include "image_utils.h"
 #include "file_utils.h"
+#include "batch_utils.h"
 
 #if defined(RV1106_1103) 
-    #include "dma_alloc.cpp"
+    #include "dma_pool.h"
 #endif
 
 #define IMAGENET_CLASSES_FILE "./model/synset.txt"
 
+/*-------------------------------------------
+                  Batch Mode
+-------------------------------------------*/
+typedef struct {
+    rknn_app_context_t* app_ctx;
+    char** labels;
+    int label_count;
+} classify_batch_context;
+
+static int classify_batch_callback(void* userdata, const char* path, image_buffer_t* image, const image_decode_info_t* info,
+                                   char* result_json, int result_size)
+{
+    classify_batch_context* batch_ctx = (classify_batch_context*)userdata;
+    const int topk = 5;
+    mobilenet_result result[topk];
+
+    int ret = inference_mobilenet_model(batch_ctx->app_ctx, image, result, topk);
+    if (ret != 0) {
+        return ret;
+    }
+
+    int len = snprintf(result_json, result_size, "[");
+    for (int i = 0; i < topk && len < result_size; i++) {
+        const char* name = result[i].cls < batch_ctx->label_count ? batch_ctx->labels[result[i].cls] : "";
+        len += snprintf(result_json + len, result_size - len, "%s{\"class\":%d,\"score\":%.6f,\"name\":",
+                        i > 0 ? "," : "", result[i].cls, result[i].score);
+        len = json_append_string(result_json, result_size, len, name);
+        len += snprintf(result_json + len, result_size - len, "}");
+    }
+    if (len >= result_size - 1) {
+        printf("result of %s is too long\n", path);
+        return -1;
+    }
+    snprintf(result_json + len, result_size - len, "]");
+    return 0;
+}
+
+static bool is_batch_input(const char* path)
+{
+    struct stat st;
+    if (stat(path, &st) == 0 && S_ISDIR(st.st_mode)) {
+        return true;
+    }
+    const char* ext = strrchr(path, '.');
+    return ext != NULL && strcmp(ext, ".txt") == 0;
+}
+
+static int run_batch(classify_batch_context* batch_ctx, const char* input_path, const char* output_path)
+{
+    int count = 0;
+    char** files = list_image_files(input_path, &count);
+    if (files == NULL || count == 0) {
+        printf("no image found in %s\n", input_path);
+        return -1;
+    }
+
+    batch_config_t config;
+    memset(&config, 0, sizeof(batch_config_t));
+    config.model_width = batch_ctx->app_ctx->model_width;
+    config.model_height = batch_ctx->app_ctx->model_height;
+    config.output_path = output_path;
+
+    batch_stats_t stats;
+    int ret = run_image_batch(files, count, &config, classify_batch_callback, batch_ctx, &stats);
+    if (ret == 0) {
+        print_batch_stats(&stats);
+    }
+    free_lines(files, count);
+    return ret;
+}
+
 /*-------------------------------------------
                   Main Function
 -------------------------------------------*/
 int main(int argc, char** argv)
 {
-    if (argc != 3) {
+    if (argc != 3 && argc != 4) {
         printf("%s <model_path> <image_path>\n", argv[0]);
+        printf("%s <model_path> <image_dir|image_list.txt> [result.jsonl]\n", argv[0]);
         return -1;
     }
 
@@ -53,6 +127,10 @@ int main(int argc, char** argv)
     int ret;
     rknn_app_context_t rknn_app_ctx;
     memset(&rknn_app_ctx, 0, sizeof(rknn_app_context_t));
+#if defined(RV1106_1103) 
+    dma_pool_t* dma_pool = NULL;
+    dma_buffer_t* img_dma_buf = NULL;
+#endif
 
     ret = init_mobilenet_model(model_path, &rknn_app_ctx);
     if (ret != 0) {
@@ -60,6 +138,19 @@ int main(int argc, char** argv)
         return -1;
     }
 
+#if !defined(RV1106_1103)
+    if (is_batch_input(image_path)) {
+        classify_batch_context batch_ctx;
+        batch_ctx.app_ctx = &rknn_app_ctx;
+        batch_ctx.labels = lines;
+        batch_ctx.label_count = line_count;
+        run_batch(&batch_ctx, image_path, argc == 4 ? argv[3] : NULL);
+        release_mobilenet_model(&rknn_app_ctx);
+        free_lines(lines, line_count);
+        return 0;
+    }
+#endif
+
     image_buffer_t src_image;
     memset(&src_image, 0, sizeof(image_buffer_t));
     ret = read_image(image_path, &src_image);
@@ -68,20 +159,18 @@ int main(int argc, char** argv)
         return -1;
     }
 
+    int topk = 5;
+    mobilenet_result result[topk];
+
 #if defined(RV1106_1103) 
     //RV1106 rga requires that input and output bufs are memory allocated by dma
-    ret = dma_buf_alloc(RV1106_CMA_HEAP_PATH, src_image.size, &rknn_app_ctx.img_dma_buf.dma_buf_fd, 
-                       (void **) & (rknn_app_ctx.img_dma_buf.dma_buf_virt_addr));
-    memcpy(rknn_app_ctx.img_dma_buf.dma_buf_virt_addr, src_image.virt_addr, src_image.size);
-    dma_sync_cpu_to_device(rknn_app_ctx.img_dma_buf.dma_buf_fd);
-    free(src_image.virt_addr);
-    src_image.virt_addr = (unsigned char *)rknn_app_ctx.img_dma_buf.dma_buf_virt_addr;
-    src_image.fd = rknn_app_ctx.img_dma_buf.dma_buf_fd;
-    rknn_app_ctx.img_dma_buf.size = src_image.size;
+    dma_pool = create_dma_pool(NULL, 0);
+    img_dma_buf = dma_pool != NULL ? move_image_to_dma_buffer(dma_pool, &src_image) : NULL;
+    if (img_dma_buf == NULL) {
+        ret = -1;
+        goto out;
+    }
 #endif
-    
-    int topk = 5;
-    mobilenet_result result[topk];
 
     ret = inference_mobilenet_model(&rknn_app_ctx, &src_image, result, topk);
     if (ret != 0) {
@@ -102,12 +191,18 @@ out:
     if (src_image.virt_addr != NULL)
     {
 #if defined(RV1106_1103) 
-        dma_buf_free(rknn_app_ctx.img_dma_buf.size, &rknn_app_ctx.img_dma_buf.dma_buf_fd, 
-                rknn_app_ctx.img_dma_buf.dma_buf_virt_addr);
+        if (img_dma_buf != NULL) {
+            release_dma_buffer(img_dma_buf);
+        } else {
+            free(src_image.virt_addr);
+        }
 #else
         free(src_image.virt_addr);
 #endif
     }
+#if defined(RV1106_1103) 
+    destroy_dma_pool(dma_pool);
+#endif
     if (lines != NULL) {
         free_lines(lines, line_count);
     }
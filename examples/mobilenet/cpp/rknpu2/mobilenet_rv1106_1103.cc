@@ -6,7 +6,10 @@
 #include "mobilenet.h"
 #include "common.h"
 #include "file_utils.h"
+#include "model_registry.h"
+#include "layout_utils.h"
 #include "image_utils.h"
+#include "trace_utils.h"
 
 static void dump_tensor_attr(rknn_tensor_attr *attr) {
     printf("  index=%d, name=%s, n_dims=%d, dims=[%d, %d, %d, %d], n_elems=%d, size=%d, fmt=%s, type=%s, qnt_type=%s, "
@@ -98,43 +101,13 @@ static void get_topk_with_indices(float arr[], int size, int k, mobilenet_result
     free(elements);
 }
 
-// The npu output result of the quantization model is of int8 data type,
-// and the post-processing must be processed according to the int8 data type.
-// The following provides the nchw conversion code for converting NC1HWC2 arranged in int8 into float.
-static int NC1HWC2_int8_to_NCHW_float(const int8_t *src, float *dst, int *dims, int channel, int h, int w, int zp, float scale) {
-    int batch = dims[0];
-    int C1 = dims[1];
-    int C2 = dims[4];
-    int hw_src = dims[2] * dims[3];
-    int hw_dst = h * w;
-    for (int i = 0; i < batch; i++) {
-        src = src + i * C1 * hw_src * C2;
-        dst = dst + i * channel * hw_dst;
-        for (int c = 0; c < channel; ++c) {
-            int plane = c / C2;
-            const int8_t *src_c = plane * hw_src * C2 + src;
-            int offset = c % C2;
-            for (int cur_h = 0; cur_h < h; ++cur_h)
-                for (int cur_w = 0; cur_w < w; ++cur_w) {
-                    int cur_hw = cur_h * w + cur_w;
-                    dst[c * hw_dst + cur_h * w + cur_w] = (src_c[C2 * cur_hw + offset] - zp) * scale; // int8-->float
-                }
-        }
-    }
-
-    return 0;
-}
-
 int init_mobilenet_model(const char *model_path, rknn_app_context_t *app_ctx) {
     int ret;
-    int model_len = 0;
-    char *model;
     rknn_context ctx = 0;
 
-    ret = rknn_init(&ctx, (char *)model_path, 0, 0, NULL);
-
+    ret = acquire_model_context(model_path, 0, &ctx);
     if (ret < 0) {
-        printf("rknn_init fail! ret=%d\n", ret);
+        printf("acquire_model_context fail! ret=%d\n", ret);
         return -1;
     }
 
@@ -244,7 +217,7 @@ int release_mobilenet_model(rknn_app_context_t *app_ctx) {
         }
     }
     if (app_ctx->rknn_ctx != 0) {
-        rknn_destroy(app_ctx->rknn_ctx);
+        release_model_context(app_ctx->rknn_ctx);
         app_ctx->rknn_ctx = 0;
     }
     return 0;
@@ -273,7 +246,7 @@ int inference_mobilenet_model(rknn_app_context_t *app_ctx, image_buffer_t *src_i
     }
 
     // Run
-    printf("rknn_run\n");
+    TRACE_LOG("rknn_run\n");
     ret = rknn_run(app_ctx->rknn_ctx, nullptr);
     if (ret < 0) {
         printf("rknn_run fail! ret=%d\n", ret);
@@ -282,15 +255,21 @@ int inference_mobilenet_model(rknn_app_context_t *app_ctx, image_buffer_t *src_i
 
     float outputs_float[app_ctx->output_attrs[0].size_with_stride];
     if (app_ctx->output_attrs[0].fmt == RKNN_TENSOR_NC1HWC2) {
-        int size = app_ctx->output_attrs[0].size_with_stride;
-        int zp = app_ctx->output_attrs[0].zp;
-        float scale = app_ctx->output_attrs[0].scale;
-        int channel = app_ctx->output_attrs[0].dims[1];
-        int h = app_ctx->output_attrs[0].n_dims > 2 ? app_ctx->output_attrs[0].dims[2] : 1;
-        int w = app_ctx->output_attrs[0].n_dims > 3 ? app_ctx->output_attrs[0].dims[3] : 1;
-        if (app_ctx->output_attrs[0].type == RKNN_TENSOR_INT8) {
-            NC1HWC2_int8_to_NCHW_float((int8_t *)app_ctx->output_mems[0]->virt_addr, outputs_float,
-                                       (int *)app_ctx->output_attrs[0].dims, channel, h, w, zp, scale);
+        // The npu output of the quantization model is int8, it is reordered to NCHW
+        // and then dequantized
+        rknn_tensor_attr *attr = &app_ctx->output_attrs[0];
+        if (attr->type == RKNN_TENSOR_INT8) {
+            int8_t outputs_nchw[attr->n_elems];
+            tensor_layout_desc_t src_desc;
+            tensor_layout_desc_t dst_desc;
+            init_layout_desc(&src_desc, TENSOR_LAYOUT_NC1HWC2, attr->dims[0], attr->dims[1] * attr->dims[4],
+                             attr->dims[2], attr->dims[3], attr->dims[4]);
+            init_layout_desc(&dst_desc, TENSOR_LAYOUT_NCHW, attr->dims[0], attr->dims[1] * attr->dims[4],
+                             attr->dims[2], attr->dims[3], 0);
+            convert_layout(app_ctx->output_mems[0]->virt_addr, &src_desc, outputs_nchw, &dst_desc, sizeof(int8_t), 0);
+            for (int index = 0; index < attr->n_elems; index++) {
+                outputs_float[index] = ((float)outputs_nchw[index] - attr->zp) * attr->scale;
+            }
         } else {
             printf("dtype: %s cannot convert!", get_type_string(app_ctx->output_attrs[0].type));
         }
@@ -87,6 +87,7 @@ int main(int argc, char **argv)
     }
 
     mobilesam_res res;
+    memset(&res, 0, sizeof(mobilesam_res));
 
     ret = inference_mobilesam_model(&rknn_app_ctx, &src_image, cvt_point_coords, point_labels, &res);
     if (ret != 0)
@@ -96,7 +97,7 @@ int main(int argc, char **argv)
     }
 
     // draw mask
-    draw_mask(&src_image, res.mask);
+    draw_mask(&src_image, &res.rle);
 
     // draw point or box
     mobilesam_box box;
@@ -170,10 +171,7 @@ out:
         free(point_labels);
     }
 
-    if (res.mask != NULL)
-    {
-        free(res.mask);
-    }
+    release_mobilesam_res(&res);
 
     return 0;
 }
@@ -16,7 +16,6 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
-#include <opencv2/opencv.hpp>
 #include "preprocess.h"
 
 #include "mobilesam.h"
@@ -36,120 +35,271 @@ int argmax(float* arr, int size)
     return index;
 }
 
-void resize_by_opencv_fp(float *input_image, int input_height, int input_width, float *output_image, int target_height, int target_width)
+int clamp(float val, int min, int max)
+{
+    return val > min ? (val < max ? val : max) : min;
+}
+
+// original image pixel -> low res mask coordinate along one axis, the two bilinear
+// resizes of the reference (low res -> IMG_SIZE, slice, -> original) composed into one map
+typedef struct {
+    float scale1;   // original -> IMG_SIZE grid
+    float max1;
+    float scale2;   // IMG_SIZE grid -> low res
+    float max2;
+} axis_map_t;
+
+static void init_axis_map(axis_map_t* m, int ori_size, int new_size, int low_res_size)
 {
-    cv::Mat src_image(input_height, input_width, CV_32F, input_image);
-    cv::Mat dst_image;
-    cv::resize(src_image, dst_image, cv::Size(target_width, target_height), 0, 0, cv::INTER_LINEAR);
-    memcpy(output_image, dst_image.data, target_width * target_height * sizeof(float));
+    // extreme aspect ratios round the short side to 0
+    new_size = new_size > 0 ? new_size : 1;
+    m->scale1 = (float)new_size / ori_size;
+    m->max1 = new_size - 1;
+    m->scale2 = (float)low_res_size / IMG_SIZE;
+    m->max2 = low_res_size - 1;
 }
 
-void slice_mask(float* ori_mask, float* slice_mask, int ori_width, int slice_height, int slice_width)
+static inline float map_axis(const axis_map_t* m, int x)
 {
-    for (int i = 0; i < slice_height; i++)
+    float x1 = (x + 0.5f) * m->scale1 - 0.5f;
+    x1 = x1 < 0 ? 0 : (x1 > m->max1 ? m->max1 : x1);
+    float x2 = (x1 + 0.5f) * m->scale2 - 0.5f;
+    return x2 < 0 ? 0 : (x2 > m->max2 ? m->max2 : x2);
+}
+
+// first pixel in [0, size] mapped at or past cell
+static int first_pixel_of_cell(const axis_map_t* m, int size, float cell)
+{
+    int lo = 0;
+    int hi = size;
+    while (lo < hi)
     {
-        for (int j = 0; j < slice_width; j++)
+        int mid = (lo + hi) / 2;
+        if (map_axis(m, mid) >= cell)
+        {
+            hi = mid;
+        }
+        else
         {
-            slice_mask[i * slice_width + j] = ori_mask[i * ori_width + j];
+            lo = mid + 1;
         }
     }
+    return lo;
 }
 
-void crop_mask(float* ori_mask, int size, uint8_t* res_mask, float threshold)
+typedef struct {
+    mobilesam_rle* rle;
+    uint8_t* bitmap;
+    int stride;
+    int value;          // value of the open run
+    uint32_t length;    // length of the open run
+} rle_writer_t;
+
+static int push_run(rle_writer_t* w)
 {
-    for (int i = 0; i < size; i++)
+    mobilesam_rle* rle = w->rle;
+    if (rle->num_runs == rle->capacity)
     {
-        res_mask[i] = ori_mask[i] > threshold ? 1 : 0; 
+        int capacity = rle->capacity > 0 ? rle->capacity * 2 : 1024;
+        uint32_t* counts = (uint32_t*)realloc(rle->counts, capacity * sizeof(uint32_t));
+        if (counts == NULL)
+        {
+            return -1;
+        }
+        rle->counts = counts;
+        rle->capacity = capacity;
     }
+    rle->counts[rle->num_runs++] = w->length;
+    return 0;
 }
 
-int clamp(float val, int min, int max)
+static void set_bits(uint8_t* row, int x0, int x1)
 {
-    return val > min ? (val < max ? val : max) : min;
+    for (int x = x0; x < x1; x++)
+    {
+        row[x >> 3] |= 0x80 >> (x & 7);
+    }
 }
 
-int post_process(rknn_app_context_t* app_ctx, float* iou_predictions, float* low_res_masks, mobilesam_res* res, int ori_height, int ori_width)
+// append count pixels of value to row y starting at x
+static int emit(rle_writer_t* w, int value, int y, int x, int count)
 {
-    int masks_num = app_ctx->decoder.output_attrs[0].n_elems;
-    int index = argmax(iou_predictions, masks_num);
-
-    float* mask_img_size = (float*)malloc(IMG_SIZE * IMG_SIZE * sizeof(float));
-    int low_res_masks_height = app_ctx->decoder.output_attrs[1].dims[2];
-    int low_res_masks_width = app_ctx->decoder.output_attrs[1].dims[3];
-    resize_by_opencv_fp(low_res_masks + index * low_res_masks_height * low_res_masks_width, low_res_masks_height, low_res_masks_width, mask_img_size, IMG_SIZE, IMG_SIZE);
+    if (count <= 0)
+    {
+        return 0;
+    }
+    if (value != w->value)
+    {
+        if (push_run(w) != 0)
+        {
+            return -1;
+        }
+        w->value = value;
+        w->length = 0;
+    }
+    w->length += count;
+    if (value && w->bitmap != NULL)
+    {
+        set_bits(w->bitmap + (size_t)y * w->stride, x, x + count);
+    }
+    return 0;
+}
 
-    int* new_shape = (int*)malloc(2 * sizeof(int));
+static int encode_mask(const float* mask, int low_h, int low_w, int ori_height, int ori_width, float threshold, mobilesam_res* res)
+{
+    int new_shape[2];
     get_preprocess_shape(ori_height, ori_width, new_shape);
+    axis_map_t map_y, map_x;
+    init_axis_map(&map_y, ori_height, new_shape[0], low_h);
+    init_axis_map(&map_x, ori_width, new_shape[1], low_w);
 
-    float* mask_new_shape = (float*)malloc(new_shape[0] * new_shape[1] * sizeof(float));
-    float* mask_ori_img = (float*)malloc(ori_height * ori_width * sizeof(float));
-    slice_mask(mask_img_size, mask_new_shape, IMG_SIZE, new_shape[0], new_shape[1]);
-    resize_by_opencv_fp(mask_new_shape, new_shape[0], new_shape[1], mask_ori_img, ori_height, ori_width);
+    // the x mapping is the same for every row: pixels [cell_start[j], cell_start[j + 1]) lie between columns j and j + 1
+    int* cell_start = (int*)malloc((low_w + 1) * sizeof(int));
+    float* row = (float*)malloc(low_w * sizeof(float));
+    if (cell_start == NULL || row == NULL)
+    {
+        free(cell_start);
+        free(row);
+        return -1;
+    }
+    for (int j = 0; j < low_w; j++)
+    {
+        cell_start[j] = first_pixel_of_cell(&map_x, ori_width, (float)j);
+    }
+    cell_start[low_w] = ori_width;
 
-    uint8_t* res_mask = (uint8_t*)malloc(ori_height * ori_width * sizeof(uint8_t));
-    crop_mask(mask_ori_img, ori_height*ori_width, res_mask, MASK_THRESHOLD);
+    rle_writer_t w;
+    memset(&w, 0, sizeof(w));
+    w.rle = &res->rle;
+    w.bitmap = res->bitmap;
+    w.stride = res->bitmap_stride;
+    int ret = 0;
 
-    res->mask = res_mask;
-    res->score = iou_predictions[index];
+    for (int y = 0; y < ori_height && ret == 0; y++)
+    {
+        float y2 = map_axis(&map_y, y);
+        int y0 = (int)y2;
+        int y1 = y0 + 1 < low_h ? y0 + 1 : y0;
+        float wy = y2 - y0;
+        const float* r0 = mask + y0 * low_w;
+        const float* r1 = mask + y1 * low_w;
+        for (int j = 0; j < low_w; j++)
+        {
+            row[j] = r0[j] + wy * (r1[j] - r0[j]);
+        }
 
-    if (mask_img_size != NULL)
+        for (int j = 0; j < low_w && ret == 0; j++)
+        {
+            int x0 = cell_start[j];
+            int x1 = cell_start[j + 1];
+            float c0 = row[j];
+            float c1 = j + 1 < low_w ? row[j + 1] : c0;
+            bool in0 = c0 > threshold;
+            if (in0 == (c1 > threshold))
+            {
+                // the whole cell is on one side of the threshold
+                ret = emit(&w, in0, y, x0, x1 - x0);
+                continue;
+            }
+            // boundary cell, evaluate its pixels
+            for (int x = x0; x < x1 && ret == 0; x++)
+            {
+                float v = c0 + (map_axis(&map_x, x) - j) * (c1 - c0);
+                ret = emit(&w, v > threshold, y, x, 1);
+            }
+        }
+    }
+    if (ret == 0)
     {
-        free(mask_img_size);
+        ret = push_run(&w);
     }
 
-    if (mask_new_shape != NULL)
+    free(cell_start);
+    free(row);
+    return ret;
+}
+
+int post_process(rknn_app_context_t* app_ctx, float* iou_predictions, float* low_res_masks, mobilesam_res* res, int ori_height, int ori_width)
+{
+    int masks_num = app_ctx->decoder.output_attrs[0].n_elems;
+    int index = argmax(iou_predictions, masks_num);
+
+    int low_res_masks_height = app_ctx->decoder.output_attrs[1].dims[2];
+    int low_res_masks_width = app_ctx->decoder.output_attrs[1].dims[3];
+    const float* mask = low_res_masks + index * low_res_masks_height * low_res_masks_width;
+
+    // the bitmap of the previous inference is reused when its size is unchanged, like rle.counts
+    int bitmap_stride = res->want_bitmap ? (ori_width + 7) / 8 : 0;
+    size_t bitmap_size = (size_t)bitmap_stride * ori_height;
+    if (res->bitmap != NULL && (size_t)res->bitmap_stride * res->rle.height != bitmap_size)
     {
-        free(mask_new_shape);
+        free(res->bitmap);
+        res->bitmap = NULL;
     }
+    res->bitmap_stride = bitmap_stride;
 
-    if (mask_ori_img != NULL)
+    res->score = iou_predictions[index];
+    res->rle.height = ori_height;
+    res->rle.width = ori_width;
+    res->rle.num_runs = 0;
+    if (res->bitmap != NULL)
     {
-        free(mask_ori_img);
+        memset(res->bitmap, 0, bitmap_size);
+    }
+    else if (bitmap_size > 0)
+    {
+        res->bitmap = (uint8_t*)calloc(bitmap_size, 1);
+        if (res->bitmap == NULL)
+        {
+            printf("malloc mask bitmap fail!\n");
+            return -1;
+        }
     }
 
-    if (new_shape != NULL)
+    if (encode_mask(mask, low_res_masks_height, low_res_masks_width, ori_height, ori_width, MASK_THRESHOLD, res) != 0)
     {
-        free(new_shape);
+        printf("encode mask fail!\n");
+        return -1;
     }
 
     return 0;
 }
 
-void draw_mask(image_buffer_t* src_imag, uint8_t* mask)
+void release_mobilesam_res(mobilesam_res* res)
 {
-    int width = src_imag->width;
-    int height = src_imag->height;
+    if (res->rle.counts != NULL)
+    {
+        free(res->rle.counts);
+        res->rle.counts = NULL;
+    }
+    res->rle.num_runs = 0;
+    res->rle.capacity = 0;
+    if (res->bitmap != NULL)
+    {
+        free(res->bitmap);
+        res->bitmap = NULL;
+    }
+}
 
+void draw_mask(image_buffer_t* src_imag, const mobilesam_rle* rle)
+{
     char* ori_img = (char *)src_imag->virt_addr;
     float alpha = 0.5f;
-    for (int i = 0; i < height; i++)
+    size_t pos = 0;
+    for (int r = 0; r < rle->num_runs; r++)
     {
-        for (int j = 0; j < width; j++)
+        size_t end = pos + rle->counts[r];
+        // odd runs are the mask
+        if (r & 1)
         {
-            int pixel_offset = 3 * (i * width + j);
-            if (mask[i * width + j] != 0)
+            for (size_t p = pos; p < end; p++)
             {
+                size_t pixel_offset = 3 * p;
                 ori_img[pixel_offset + 0] = (unsigned char)clamp(COLOR[0] * (1 - alpha) + ori_img[pixel_offset + 0] * alpha, 0, 255);
                 ori_img[pixel_offset + 1] = (unsigned char)clamp(COLOR[1] * (1 - alpha) + ori_img[pixel_offset + 1] * alpha, 0, 255);
                 ori_img[pixel_offset + 2] = (unsigned char)clamp(COLOR[2] * (1 - alpha) + ori_img[pixel_offset + 2] * alpha, 0, 255);
             }
         }
+        pos = end;
     }
 }
-
-void rknn_nchw_2_nhwc(float* nchw, float* nhwc, int N, int C, int H, int W)
-{
-    for (int ni = 0; ni < N; ni++)
-    {
-        for (int hi = 0; hi < H; hi++)
-        {
-            for (int wi = 0; wi < W; wi++)
-            {
-                for (int ci = 0; ci < C; ci++)
-                {
-                    memcpy(nhwc + ni * H * W * C + hi * W * C + wi * C + ci, nchw + ni * C * H * W + ci * H * W + hi * W + wi, sizeof(float));
-                }
-            }
-        }
-    }
-}
\ No newline at end of file
@@ -15,8 +15,21 @@
 #ifndef _RKNN_DEMO_MOBILESAM_POSTPROCESS_H_
 #define _RKNN_DEMO_MOBILESAM_POSTPROCESS_H_
 
+// run-length encoded mask, row-major runs alternating between 0 and 1, starting with 0
 typedef struct {
-    uint8_t* mask;
+    int height;
+    int width;
+    int num_runs;
+    int capacity;
+    uint32_t* counts;   // num_runs run lengths, the first one is 0 when the mask starts with 1
+} mobilesam_rle;
+
+// zero before the first inference, rle.counts and a bitmap of the same size are reused by later ones
+typedef struct {
+    int want_bitmap;    // [in] also fill bitmap
+    mobilesam_rle rle;
+    uint8_t* bitmap;    // packed mask, 1 bit per pixel, MSB first, rows of bitmap_stride bytes
+    int bitmap_stride;
     float score;
 } mobilesam_res;
 
@@ -29,8 +42,8 @@ typedef struct {
 
 int post_process(rknn_app_context_t* app_ctx, float* iou_predictions, float* low_res_masks, mobilesam_res* res, int ori_height, int ori_width);
 
-void draw_mask(image_buffer_t* src_imag, uint8_t* mask);
+void draw_mask(image_buffer_t* src_imag, const mobilesam_rle* rle);
 
-void rknn_nchw_2_nhwc(float* nchw, float* nhwc, int N, int C, int H, int W);
+void release_mobilesam_res(mobilesam_res* res);
 
 #endif // _RKNN_DEMO_MOBILESAM_POSTPROCESS_H_
@@ -16,6 +16,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <opencv2/opencv.hpp>
 #include "preprocess.h"
 
 #define MAX_TEXT_LINE_LENGTH 1024
@@ -72,24 +73,6 @@ float* read_coords_from_file(const char* filename, int* line_count)
     return coords;
 }
 
-int max(int a, int b)
-{
-    return a > b ? a : b;
-}
-
-int get_preprocess_shape(int ori_heigth, int ori_width, int* new_shape)
-{
-    float scale = IMG_SIZE * 1.0 / max(ori_heigth, ori_width);
-
-    int new_height = ori_heigth * scale + 0.5;
-    int new_width = ori_width * scale + 0.5;
-
-    new_shape[0] = new_height;
-    new_shape[1] = new_width;
-
-    return 0;
-}
-
 int point_coords_preprocess(float* ori_point_coords, int coords_size, int ori_height, int ori_width, float* cvt_point_coords)
 {
     int* new_shape = (int*)malloc(2 * sizeof(int));
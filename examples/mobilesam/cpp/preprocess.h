@@ -16,13 +16,24 @@
 #define _RKNN_DEMO_MOBILESAM_PREPROCESS_H_
 
 #include "image_utils.h"
-#include <opencv2/opencv.hpp>
 
 #define IMG_SIZE 448
 
 float* read_coords_from_file(const char* path, int* line_count);
 
-int get_preprocess_shape(int ori_heigth, int ori_width, int* new_shape);
+// shape of the image inside the IMG_SIZE model input, shared by pre and post-processing
+inline int get_preprocess_shape(int ori_heigth, int ori_width, int* new_shape)
+{
+    float scale = IMG_SIZE * 1.0 / (ori_heigth > ori_width ? ori_heigth : ori_width);
+
+    int new_height = ori_heigth * scale + 0.5;
+    int new_width = ori_width * scale + 0.5;
+
+    new_shape[0] = new_height;
+    new_shape[1] = new_width;
+
+    return 0;
+}
 int point_coords_preprocess(float* ori_point_coords, int coords_size, int ori_height, int ori_width, float* cvt_point_coords);
 int pre_process(image_buffer_t* src_img, image_buffer_t* dst_img);
 
@@ -20,6 +20,7 @@
 #include "common.h"
 #include "file_utils.h"
 #include "image_utils.h"
+#include "layout_utils.h"
 
 
 int init_mobilesam_model(const char* encoder_model_path, const char* decoder_model_path, rknn_app_context_t* app_ctx)
@@ -75,7 +76,6 @@ int inference_mobilesam_model(rknn_app_context_t* app_ctx, image_buffer_t* img,
     memset(img_embeds_nhwc, 0, img_embeds_size * sizeof(float));
     memset(iou_predictions, 0, sizeof(iou_predictions));
     memset(low_res_masks, 0, sizeof(low_res_masks));
-    memset(res, 0, sizeof(mobilesam_res));
 
     printf("--> inference mobilesam encoder model\n");
     ret = inference_mobilesam_encoder_utils(&(app_ctx->encoder), img, img_embeds_nchw);
@@ -85,8 +85,17 @@ int inference_mobilesam_model(rknn_app_context_t* app_ctx, image_buffer_t* img,
         return -1;
     }
 
-    rknn_nchw_2_nhwc(img_embeds_nchw, img_embeds_nhwc, app_ctx->encoder.output_attrs[0].dims[0], app_ctx->encoder.output_attrs[0].dims[1],
-                                                       app_ctx->encoder.output_attrs[0].dims[2], app_ctx->encoder.output_attrs[0].dims[3]);
+    rknn_tensor_attr* embeds_attr = &(app_ctx->encoder.output_attrs[0]);
+    tensor_layout_desc_t nchw_desc;
+    tensor_layout_desc_t nhwc_desc;
+    init_layout_desc(&nchw_desc, TENSOR_LAYOUT_NCHW, embeds_attr->dims[0], embeds_attr->dims[1], embeds_attr->dims[2], embeds_attr->dims[3], 0);
+    init_layout_desc(&nhwc_desc, TENSOR_LAYOUT_NHWC, embeds_attr->dims[0], embeds_attr->dims[1], embeds_attr->dims[2], embeds_attr->dims[3], 0);
+    ret = convert_layout(img_embeds_nchw, &nchw_desc, img_embeds_nhwc, &nhwc_desc, sizeof(float), 0);
+    if (ret != 0)
+    {
+        printf("convert image embeddings to nhwc fail! ret=%d\n", ret);
+        return -1;
+    }
 
     printf("--> inference mobilesam decoder model\n");
     ret = inference_mobilesam_decoder_utils(&(app_ctx->decoder), img_embeds_nhwc, point_coords, point_labels, iou_predictions, low_res_masks);
@@ -97,7 +106,7 @@ int inference_mobilesam_model(rknn_app_context_t* app_ctx, image_buffer_t* img,
     }
 
     // Post Process
-    post_process(app_ctx, iou_predictions, low_res_masks, res, img->height, img->width);
+    ret = post_process(app_ctx, iou_predictions, low_res_masks, res, img->height, img->width);
 
     if (img_embeds_nchw != NULL)
     {
@@ -20,7 +20,9 @@
 #include "rknn_mobilesam_utils.h"
 #include "common.h"
 #include "file_utils.h"
+#include "model_registry.h"
 #include "image_utils.h"
+#include "trace_utils.h"
 #include "preprocess.h"
 
 
@@ -44,10 +46,10 @@ int init_mobilesam_model_utils(rknn_mobilesam_context* mobilesam_ctx, const char
     rknn_context ctx = 0;
 
     // Load RKNN Model
-    ret = rknn_init(&ctx, (char*)model_path, 0, 0, NULL);
+    ret = acquire_model_context(model_path, 0, &ctx);
     if (ret < 0)
     {
-        printf("rknn_init fail ret=%d\n", ret);
+        printf("acquire_model_context fail! ret=%d\n", ret);
         return -1;
     }
 
@@ -135,7 +137,7 @@ int release_mobilesam_model_utils(rknn_mobilesam_context* mobilesam_ctx)
     }
     if (mobilesam_ctx->rknn_ctx != 0)
     {
-        rknn_destroy(mobilesam_ctx->rknn_ctx);
+        release_model_context(mobilesam_ctx->rknn_ctx);
         mobilesam_ctx->rknn_ctx = 0;
     }
     return 0;
@@ -187,7 +189,7 @@ int inference_mobilesam_encoder_utils(rknn_mobilesam_context* mobilesam_ctx, ima
     }
 
     // Run
-    printf("rknn_run\n");
+    TRACE_LOG("rknn_run\n");
     ret = rknn_run(mobilesam_ctx->rknn_ctx, nullptr);
     if (ret < 0)
     {
@@ -278,7 +280,7 @@ int inference_mobilesam_decoder_utils(rknn_mobilesam_context* mobilesam_ctx, flo
     }
 
     // Run
-    printf("rknn_run\n");
+    TRACE_LOG("rknn_run\n");
     ret = rknn_run(mobilesam_ctx->rknn_ctx, NULL);
     if (ret < 0)
     {
@@ -0,0 +1,237 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <vector>
+
+#include "mobilesam.h"
+
+#define LOW_RES_SIZE 112
+#define NUM_MASKS 4
+
+static double now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// cv::resize INTER_LINEAR on float images
+static void resize_linear(const float *src, int sh, int sw, float *dst, int dh, int dw)
+{
+    for (int y = 0; y < dh; y++)
+    {
+        float fy = (y + 0.5f) * sh / (float)dh - 0.5f;
+        fy = fy < 0 ? 0 : fy;
+        int y0 = (int)fy;
+        float wy = fy - y0;
+        if (y0 >= sh - 1)
+        {
+            y0 = sh - 1;
+            wy = 0;
+        }
+        int y1 = y0 + 1 < sh ? y0 + 1 : sh - 1;
+        for (int x = 0; x < dw; x++)
+        {
+            float fx = (x + 0.5f) * sw / (float)dw - 0.5f;
+            fx = fx < 0 ? 0 : fx;
+            int x0 = (int)fx;
+            float wx = fx - x0;
+            if (x0 >= sw - 1)
+            {
+                x0 = sw - 1;
+                wx = 0;
+            }
+            int x1 = x0 + 1 < sw ? x0 + 1 : sw - 1;
+            dst[y * dw + x] = (1 - wy) * ((1 - wx) * src[y0 * sw + x0] + wx * src[y0 * sw + x1]) +
+                              wy * ((1 - wx) * src[y1 * sw + x0] + wx * src[y1 * sw + x1]);
+        }
+    }
+}
+
+// the post-process before run-length output: low res -> IMG_SIZE, slice the image, -> original, threshold at 0
+static void reference_mask(const float *mask, int ori_height, int ori_width, std::vector<uint8_t> &out)
+{
+    int new_shape[2];
+    get_preprocess_shape(ori_height, ori_width, new_shape);
+    std::vector<float> model(IMG_SIZE * IMG_SIZE);
+    std::vector<float> slice((size_t)new_shape[0] * new_shape[1]);
+    std::vector<float> full((size_t)ori_height * ori_width);
+    resize_linear(mask, LOW_RES_SIZE, LOW_RES_SIZE, model.data(), IMG_SIZE, IMG_SIZE);
+    for (int y = 0; y < new_shape[0]; y++)
+    {
+        memcpy(&slice[(size_t)y * new_shape[1]], &model[y * IMG_SIZE], new_shape[1] * sizeof(float));
+    }
+    resize_linear(slice.data(), new_shape[0], new_shape[1], full.data(), ori_height, ori_width);
+    out.resize(full.size());
+    for (size_t i = 0; i < full.size(); i++)
+    {
+        out[i] = full[i] > 0.f;
+    }
+}
+
+static int check_size(int height, int width, const float *masks, const float *iou)
+{
+    rknn_tensor_attr attrs[2];
+    memset(attrs, 0, sizeof(attrs));
+    attrs[0].n_elems = NUM_MASKS;
+    attrs[1].dims[2] = LOW_RES_SIZE;
+    attrs[1].dims[3] = LOW_RES_SIZE;
+    rknn_app_context_t app_ctx;
+    memset(&app_ctx, 0, sizeof(app_ctx));
+    app_ctx.decoder.output_attrs = attrs;
+
+    mobilesam_res res;
+    memset(&res, 0, sizeof(res));
+    res.want_bitmap = 1;
+    double t0 = now_ms();
+    if (post_process(&app_ctx, (float *)iou, (float *)masks, &res, height, width) != 0)
+    {
+        printf("%dx%d: post_process fail\n", width, height);
+        return -1;
+    }
+    double t1 = now_ms();
+
+    size_t pixels = (size_t)height * width;
+    std::vector<uint8_t> decoded(pixels);
+    size_t pos = 0;
+    for (int r = 0; r < res.rle.num_runs && pos <= pixels; r++)
+    {
+        if (pos + res.rle.counts[r] > pixels)
+        {
+            pos = pixels + 1;
+            break;
+        }
+        memset(&decoded[pos], r & 1, res.rle.counts[r]);
+        pos += res.rle.counts[r];
+    }
+    long bitmap_diff = 0;
+    for (int y = 0; y < height && pos == pixels; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            int bit = (res.bitmap[(size_t)y * res.bitmap_stride + x / 8] >> (7 - x % 8)) & 1;
+            bitmap_diff += bit != decoded[(size_t)y * width + x];
+        }
+    }
+
+    // the best mask by iou prediction is the second one
+    std::vector<uint8_t> ref;
+    double t2 = now_ms();
+    reference_mask(masks + LOW_RES_SIZE * LOW_RES_SIZE, height, width, ref);
+    double t3 = now_ms();
+    long diff = 0, ones = 0;
+    for (size_t i = 0; i < pixels && pos == pixels; i++)
+    {
+        ones += ref[i];
+        diff += ref[i] != decoded[i];
+    }
+    double diff_pct = 100.0 * diff / pixels;
+    printf("%4dx%-4d %6d runs, %5.1f%% set, %.4f%% differ from reference, bitmap %s, %7.2f ms (reference %7.2f ms)\n",
+           width, height, res.rle.num_runs, 100.0 * ones / pixels, diff_pct, bitmap_diff == 0 ? "matches" : "DIFFERS",
+           t1 - t0, t3 - t2);
+    int ret = pos == pixels && res.rle.height == height && res.rle.width == width && bitmap_diff == 0 && diff_pct < 0.05
+                  ? 0
+                  : -1;
+    if (pos != pixels)
+    {
+        printf("run lengths do not add up to %zu pixels\n", pixels);
+    }
+    release_mobilesam_res(&res);
+    return ret;
+}
+
+// 1 when every bit of the bitmap is the pixel of the run-length mask
+static int bitmap_matches(const mobilesam_res *res)
+{
+    size_t pos = 0;
+    for (int r = 0; r < res->rle.num_runs; r++)
+    {
+        for (uint32_t i = 0; i < res->rle.counts[r]; i++, pos++)
+        {
+            size_t y = pos / res->rle.width, x = pos % res->rle.width;
+            if (((res->bitmap[y * res->bitmap_stride + x / 8] >> (7 - x % 8)) & 1) != (r & 1))
+            {
+                return 0;
+            }
+        }
+    }
+    return pos == (size_t)res->rle.height * res->rle.width;
+}
+
+// one result through several inferences: the bitmap is kept for the same size and cleared,
+// replaced for another size, freed when no longer wanted (leaks show under ASan)
+static int check_reuse(const float *masks)
+{
+    rknn_tensor_attr attrs[2];
+    memset(attrs, 0, sizeof(attrs));
+    attrs[0].n_elems = NUM_MASKS;
+    attrs[1].dims[2] = LOW_RES_SIZE;
+    attrs[1].dims[3] = LOW_RES_SIZE;
+    rknn_app_context_t app_ctx;
+    memset(&app_ctx, 0, sizeof(app_ctx));
+    app_ctx.decoder.output_attrs = attrs;
+
+    // the best mask alternates between the smallest and the largest blob
+    const float iou[2][NUM_MASKS] = {{0.9f, 0.1f, 0.2f, 0.3f}, {0.1f, 0.2f, 0.3f, 0.9f}};
+    const int sizes[][3] = {{480, 640, 1}, {480, 640, 1}, {480, 640, 1}, {1080, 1920, 1}, {480, 640, 1}, {480, 640, 0}};
+    mobilesam_res res;
+    memset(&res, 0, sizeof(res));
+    int ret = 0, reused = 0;
+    for (int i = 0; i < (int)(sizeof(sizes) / sizeof(sizes[0])) && ret == 0; i++)
+    {
+        uint8_t *previous = res.bitmap;
+        int same_size = i > 0 && sizes[i][0] == sizes[i - 1][0] && sizes[i][1] == sizes[i - 1][1];
+        res.want_bitmap = sizes[i][2];
+        if (post_process(&app_ctx, (float *)iou[i % 2], (float *)masks, &res, sizes[i][0], sizes[i][1]) != 0)
+        {
+            return -1;
+        }
+        if (res.want_bitmap)
+        {
+            ret |= bitmap_matches(&res) ? 0 : -1;
+            ret |= !same_size || res.bitmap == previous ? 0 : -1;
+            reused += same_size;
+        }
+        else
+        {
+            ret |= res.bitmap == NULL && res.bitmap_stride == 0 ? 0 : -1;
+        }
+    }
+    printf("6 inferences on one result: bitmap reused %d times, matches the runs: %s\n", reused,
+           ret == 0 ? "ok" : "fail");
+    release_mobilesam_res(&res);
+    return ret;
+}
+
+int main()
+{
+    // a blob with a wavy boundary in every mask
+    std::vector<float> masks(NUM_MASKS * LOW_RES_SIZE * LOW_RES_SIZE);
+    for (int k = 0; k < NUM_MASKS; k++)
+    {
+        for (int y = 0; y < LOW_RES_SIZE; y++)
+        {
+            for (int x = 0; x < LOW_RES_SIZE; x++)
+            {
+                float dx = x - LOW_RES_SIZE * 0.4f;
+                float dy = y - LOW_RES_SIZE * 0.3f;
+                masks[(k * LOW_RES_SIZE + y) * LOW_RES_SIZE + x] =
+                    LOW_RES_SIZE * 0.25f - sqrtf(dx * dx + dy * dy) + 2 * sinf(x * 0.7f) * cosf(y * 0.3f) + k;
+            }
+        }
+    }
+    float iou[NUM_MASKS] = {0.1f, 0.9f, 0.2f, 0.3f};
+
+    const int sizes[][2] = {{480, 640}, {640, 480}, {1080, 1920}, {3000, 4000}, {2000, 600}, {17, 23}};
+    int ret = 0;
+    for (int i = 0; i < (int)(sizeof(sizes) / sizeof(sizes[0])); i++)
+    {
+        ret |= check_size(sizes[i][0], sizes[i][1], masks.data(), iou);
+    }
+    ret |= check_reuse(masks.data());
+    printf("%s\n", ret == 0 ? "PASS" : "FAIL");
+    return ret == 0 ? 0 : 1;
+}
@@ -7,7 +7,9 @@
 #include "ppseg.h"
 #include "common.h"
 #include "file_utils.h"
+#include "model_registry.h"
 #include "image_utils.h"
+#include "trace_utils.h"
 
 // Define the type of color
 using Color = std::tuple<int, int, int>;
@@ -95,21 +97,12 @@ int draw_segment_image(float* result, image_buffer_t* result_img)
 int init_ppseg_model(const char* model_path, rknn_app_context_t* app_ctx)
 {
     int ret;
-    int model_len = 0;
-    char* model;
     rknn_context ctx = 0;
 
     // Load RKNN Model
-    model_len = read_data_from_file(model_path, &model);
-    if (model == NULL) {
-        printf("load_model fail!\n");
-        return -1;
-    }
-
-    ret = rknn_init(&ctx, model, model_len, 0, NULL);
-    free(model);
+    ret = acquire_model_context(model_path, 0, &ctx);
     if (ret < 0) {
-        printf("rknn_init fail! ret=%d\n", ret);
+        printf("acquire_model_context fail! ret=%d\n", ret);
         return -1;
     }
 
@@ -186,7 +179,7 @@ int release_ppseg_model(rknn_app_context_t* app_ctx)
         app_ctx->output_attrs = NULL;
     }
     if (app_ctx->rknn_ctx != 0) {
-        rknn_destroy(app_ctx->rknn_ctx);
+        release_model_context(app_ctx->rknn_ctx);
         app_ctx->rknn_ctx = 0;
     }
     return 0;
@@ -235,7 +228,7 @@ int inference_ppseg_model(rknn_app_context_t* app_ctx, image_buffer_t* src_img,
     }
 
     // Run
-    printf("rknn_run\n");
+    TRACE_LOG("rknn_run\n");
     auto start = std::chrono::high_resolution_clock::now();
     ret = rknn_run(app_ctx->rknn_ctx, nullptr);
     if (ret < 0) {
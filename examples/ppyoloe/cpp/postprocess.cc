@@ -20,6 +20,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/time.h>
+#include "yolo_head.h"
 
 #include <set>
 #include <vector>
@@ -181,282 +182,29 @@ static float sigmoid(float x) { return 1.0 / (1.0 + expf(-x)); }
 
 static float unsigmoid(float y) { return -1.0 * logf((1.0 / y) - 1.0); }
 
-inline static int32_t __clip(float val, float min, float max)
-{
-    float f = val <= min ? min : (val >= max ? max : val);
-    return f;
-}
-
-static int8_t qnt_f32_to_affine(float f32, int32_t zp, float scale)
-{
-    float dst_val = (f32 / scale) + zp;
-    int8_t res = (int8_t)__clip(dst_val, -128, 127);
-    return res;
-}
-
-static uint8_t qnt_f32_to_affine_u8(float f32, int32_t zp, float scale)
-{
-    float dst_val = (f32 / scale) + zp;
-    uint8_t res = (uint8_t)__clip(dst_val, 0, 255);
-    return res;
-}
-
-static float deqnt_affine_to_f32(int8_t qnt, int32_t zp, float scale) { return ((float)qnt - (float)zp) * scale; }
-
-static float deqnt_affine_u8_to_f32(uint8_t qnt, int32_t zp, float scale) { return ((float)qnt - (float)zp) * scale; }
-
-static void compute_dfl(float* tensor, int dfl_len, float* box){
-    for (int b=0; b<4; b++){
-        float exp_t[dfl_len];
-        float exp_sum=0;
-        float acc_sum=0;
-        for (int i=0; i< dfl_len; i++){
-            exp_t[i] = exp(tensor[i+b*dfl_len]);
-            exp_sum += exp_t[i];
-        }
-        
-        for (int i=0; i< dfl_len; i++){
-            acc_sum += exp_t[i]/exp_sum *i;
-        }
-        box[b] = acc_sum;
-    }
-}
-
-static int process_u8(uint8_t *box_tensor, int32_t box_zp, float box_scale,
-                      uint8_t *score_tensor, int32_t score_zp, float score_scale,
-                      uint8_t *score_sum_tensor, int32_t score_sum_zp, float score_sum_scale,
-                      int grid_h, int grid_w, int stride, int dfl_len,
-                      std::vector<float> &boxes,
-                      std::vector<float> &objProbs,
-                      std::vector<int> &classId,
-                      float threshold)
-{
-    int validCount = 0;
-    int grid_len = grid_h * grid_w;
-    uint8_t score_thres_u8 = qnt_f32_to_affine_u8(threshold, score_zp, score_scale);
-    uint8_t score_sum_thres_u8 = qnt_f32_to_affine_u8(threshold, score_sum_zp, score_sum_scale);
-
-    for (int i = 0; i < grid_h; i++)
-    {
-        for (int j = 0; j < grid_w; j++)
-        {
-            int offset = i * grid_w + j;
-            int max_class_id = -1;
-
-            // Use score sum to quickly filter
-            if (score_sum_tensor != nullptr)
-            {
-                if (score_sum_tensor[offset] < score_sum_thres_u8)
-                {
-                    continue;
-                }
-            }
-
-            uint8_t max_score = -score_zp;
-            for (int c = 0; c < OBJ_CLASS_NUM; c++)
-            {
-                if ((score_tensor[offset] > score_thres_u8) && (score_tensor[offset] > max_score))
-                {
-                    max_score = score_tensor[offset];
-                    max_class_id = c;
-                }
-                offset += grid_len;
-            }
-
-            // compute box
-            if (max_score > score_thres_u8)
-            {
-                offset = i * grid_w + j;
-                float box[4];
-                float before_dfl[dfl_len * 4];
-                for (int k = 0; k < dfl_len * 4; k++)
-                {
-                    before_dfl[k] = deqnt_affine_u8_to_f32(box_tensor[offset], box_zp, box_scale);
-                    offset += grid_len;
-                }
-                compute_dfl(before_dfl, dfl_len, box);
-
-                float x1, y1, x2, y2, w, h;
-                x1 = (-box[0] + j + 0.5) * stride;
-                y1 = (-box[1] + i + 0.5) * stride;
-                x2 = (box[2] + j + 0.5) * stride;
-                y2 = (box[3] + i + 0.5) * stride;
-                w = x2 - x1;
-                h = y2 - y1;
-                boxes.push_back(x1);
-                boxes.push_back(y1);
-                boxes.push_back(w);
-                boxes.push_back(h);
-
-                objProbs.push_back(deqnt_affine_u8_to_f32(max_score, score_zp, score_scale));
-                classId.push_back(max_class_id);
-                validCount++;
-            }
-        }
-    }
-    return validCount;
-}
-
-static int process_i8(int8_t *box_tensor, int32_t box_zp, float box_scale,
-                      int8_t *score_tensor, int32_t score_zp, float score_scale,
-                      int8_t *score_sum_tensor, int32_t score_sum_zp, float score_sum_scale,
-                      int grid_h, int grid_w, int stride, int dfl_len,
-                      std::vector<float> &boxes, 
-                      std::vector<float> &objProbs, 
-                      std::vector<int> &classId, 
-                      float threshold)
-{
-    int validCount = 0;
-    int grid_len = grid_h * grid_w;
-    int8_t score_thres_i8 = qnt_f32_to_affine(threshold, score_zp, score_scale);
-    int8_t score_sum_thres_i8 = qnt_f32_to_affine(threshold, score_sum_zp, score_sum_scale);
-
-    for (int i = 0; i < grid_h; i++)
-    {
-        for (int j = 0; j < grid_w; j++)
-        {
-            int offset = i* grid_w + j;
-            int max_class_id = -1;
-
-            // 通过 score sum 起到快速过滤的作用
-            if (score_sum_tensor != nullptr){
-                if (score_sum_tensor[offset] < score_sum_thres_i8){
-                    continue;
-                }
-            }
-
-            int8_t max_score = -score_zp;
-            for (int c= 0; c< OBJ_CLASS_NUM; c++){
-                if ((score_tensor[offset] > score_thres_i8) && (score_tensor[offset] > max_score))
-                {
-                    max_score = score_tensor[offset];
-                    max_class_id = c;
-                }
-                offset += grid_len;
-            }
-
-            // compute box
-            if (max_score> score_thres_i8){
-                offset = i* grid_w + j;
-                float box[4];
-                float before_dfl[dfl_len*4];
-                for (int k=0; k< dfl_len*4; k++){
-                    before_dfl[k] = deqnt_affine_to_f32(box_tensor[offset], box_zp, box_scale);
-                    offset += grid_len;
-                }
-                compute_dfl(before_dfl, dfl_len, box);
-
-                float x1,y1,x2,y2,w,h;
-                x1 = (-box[0] + j + 0.5)*stride;
-                y1 = (-box[1] + i + 0.5)*stride;
-                x2 = (box[2] + j + 0.5)*stride;
-                y2 = (box[3] + i + 0.5)*stride;
-                w = x2 - x1;
-                h = y2 - y1;
-                boxes.push_back(x1);
-                boxes.push_back(y1);
-                boxes.push_back(w);
-                boxes.push_back(h);
-
-                objProbs.push_back(deqnt_affine_to_f32(max_score, score_zp, score_scale));
-                classId.push_back(max_class_id);
-                validCount ++;
-            }
-        }
-    }
-    return validCount;
-}
-
-static int process_fp32(float *box_tensor, float *score_tensor, float *score_sum_tensor, 
-                        int grid_h, int grid_w, int stride, int dfl_len,
-                        std::vector<float> &boxes, 
-                        std::vector<float> &objProbs, 
-                        std::vector<int> &classId, 
-                        float threshold)
-{
-    int validCount = 0;
-    int grid_len = grid_h * grid_w;
-    for (int i = 0; i < grid_h; i++)
-    {
-        for (int j = 0; j < grid_w; j++)
-        {
-            int offset = i* grid_w + j;
-            int max_class_id = -1;
-
-            // 通过 score sum 起到快速过滤的作用
-            if (score_sum_tensor != nullptr){
-                if (score_sum_tensor[offset] < threshold){
-                    continue;
-                }
-            }
-
-            float max_score = 0;
-            for (int c= 0; c< OBJ_CLASS_NUM; c++){
-                if ((score_tensor[offset] > threshold) && (score_tensor[offset] > max_score))
-                {
-                    max_score = score_tensor[offset];
-                    max_class_id = c;
-                }
-                offset += grid_len;
-            }
-
-            // compute box
-            if (max_score> threshold){
-                offset = i* grid_w + j;
-                float box[4];
-                float before_dfl[dfl_len*4];
-                for (int k=0; k< dfl_len*4; k++){
-                    before_dfl[k] = box_tensor[offset];
-                    offset += grid_len;
-                }
-                compute_dfl(before_dfl, dfl_len, box);
-
-                float x1,y1,x2,y2,w,h;
-                x1 = (-box[0] + j + 0.5)*stride;
-                y1 = (-box[1] + i + 0.5)*stride;
-                x2 = (box[2] + j + 0.5)*stride;
-                y2 = (box[3] + i + 0.5)*stride;
-                w = x2 - x1;
-                h = y2 - y1;
-                boxes.push_back(x1);
-                boxes.push_back(y1);
-                boxes.push_back(w);
-                boxes.push_back(h);
-
-                objProbs.push_back(max_score);
-                classId.push_back(max_class_id);
-                validCount ++;
-            }
-        }
-    }
-    return validCount;
-}
-
-
 int post_process(rknn_app_context_t *app_ctx, rknn_output *outputs, letterbox_t *letter_box, float conf_threshold, float nms_threshold, object_detect_result_list *od_results)
 {
     std::vector<float> filterBoxes;
     std::vector<float> objProbs;
     std::vector<int> classId;
     int validCount = 0;
-    int stride = 0;
-    int grid_h = 0;
-    int grid_w = 0;
     int model_in_w = app_ctx->model_width;
     int model_in_h = app_ctx->model_height;
+    yolo_head::grid_t grid;
 
     memset(od_results, 0, sizeof(object_detect_result_list));
 
     // default 3 branch
 #ifdef RKNPU1
+    // NCHW reversed: WHCN
     int dfl_len = app_ctx->output_attrs[0].dims[2] / 4;
 #else
-    int dfl_len = app_ctx->output_attrs[0].dims[1] /4;
+    int dfl_len = app_ctx->output_attrs[0].dims[1] / 4;
 #endif
+    yolo_head::dfl_scheme scheme(dfl_len);
     int output_per_branch = app_ctx->io_num.n_output / 3;
     for (int i = 0; i < 3; i++)
     {
-
         void *score_sum = nullptr;
         int32_t score_sum_zp = 0;
         float score_sum_scale = 1.0;
@@ -469,37 +217,37 @@ int post_process(rknn_app_context_t *app_ctx, rknn_output *outputs, letterbox_t
         int score_idx = i*output_per_branch + 1;
 
 #ifdef RKNPU1
-        grid_h = app_ctx->output_attrs[box_idx].dims[1];
-        grid_w = app_ctx->output_attrs[box_idx].dims[0];
+        // NCHW reversed: WHCN
+        grid.h = app_ctx->output_attrs[box_idx].dims[1];
+        grid.w = app_ctx->output_attrs[box_idx].dims[0];
 #else
-        grid_h = app_ctx->output_attrs[box_idx].dims[2];
-        grid_w = app_ctx->output_attrs[box_idx].dims[3];
+        grid.h = app_ctx->output_attrs[box_idx].dims[2];
+        grid.w = app_ctx->output_attrs[box_idx].dims[3];
 #endif
-        stride = model_in_h / grid_h;
+        grid.stride = model_in_h / grid.h;
 
         if (app_ctx->is_quant)
         {
 #ifdef RKNPU1
-            validCount += process_u8((uint8_t *)outputs[box_idx].buf, app_ctx->output_attrs[box_idx].zp, app_ctx->output_attrs[box_idx].scale,
-                                     (uint8_t *)outputs[score_idx].buf, app_ctx->output_attrs[score_idx].zp, app_ctx->output_attrs[score_idx].scale,
-                                     (uint8_t *)score_sum, score_sum_zp, score_sum_scale,
-                                     grid_h, grid_w, stride, dfl_len,
-                                     filterBoxes, objProbs, classId, conf_threshold);
+            yolo_head::tensor_t<uint8_t> box = {(uint8_t *)outputs[box_idx].buf, app_ctx->output_attrs[box_idx].zp, app_ctx->output_attrs[box_idx].scale};
+            yolo_head::tensor_t<uint8_t> score = {(uint8_t *)outputs[score_idx].buf, app_ctx->output_attrs[score_idx].zp, app_ctx->output_attrs[score_idx].scale};
+            yolo_head::tensor_t<uint8_t> sum = {(uint8_t *)score_sum, score_sum_zp, score_sum_scale};
 #else
-            validCount += process_i8((int8_t *)outputs[box_idx].buf, app_ctx->output_attrs[box_idx].zp, app_ctx->output_attrs[box_idx].scale,
-                                     (int8_t *)outputs[score_idx].buf, app_ctx->output_attrs[score_idx].zp, app_ctx->output_attrs[score_idx].scale,
-                                     (int8_t *)score_sum, score_sum_zp, score_sum_scale,
-                                     grid_h, grid_w, stride, dfl_len, 
-                                     filterBoxes, objProbs, classId, conf_threshold);
+            yolo_head::tensor_t<int8_t> box = {(int8_t *)outputs[box_idx].buf, app_ctx->output_attrs[box_idx].zp, app_ctx->output_attrs[box_idx].scale};
+            yolo_head::tensor_t<int8_t> score = {(int8_t *)outputs[score_idx].buf, app_ctx->output_attrs[score_idx].zp, app_ctx->output_attrs[score_idx].scale};
+            yolo_head::tensor_t<int8_t> sum = {(int8_t *)score_sum, score_sum_zp, score_sum_scale};
 #endif
+            validCount += yolo_head::decode_head<OBJ_CLASS_NUM, yolo_head::nchw_layout>(scheme, box, score, sum, grid, conf_threshold,
+                                                                                        filterBoxes, objProbs, classId);
         }
         else
         {
-            validCount += process_fp32((float *)outputs[box_idx].buf, (float *)outputs[score_idx].buf, (float *)score_sum,
-                                       grid_h, grid_w, stride, dfl_len, 
-                                       filterBoxes, objProbs, classId, conf_threshold);
+            yolo_head::tensor_t<float> box = {(float *)outputs[box_idx].buf, 0, 1.0f};
+            yolo_head::tensor_t<float> score = {(float *)outputs[score_idx].buf, 0, 1.0f};
+            yolo_head::tensor_t<float> sum = {(float *)score_sum, 0, 1.0f};
+            validCount += yolo_head::decode_head<OBJ_CLASS_NUM, yolo_head::nchw_layout>(scheme, box, score, sum, grid, conf_threshold,
+                                                                                        filterBoxes, objProbs, classId);
         }
-
     }
 
     // no object detect
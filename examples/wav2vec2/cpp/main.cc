@@ -43,62 +43,34 @@ int main(int argc, char **argv)
     float audio_length = 0.0;
     float rtf = 0.0;
     rknn_app_context_t rknn_app_ctx;
-    audio_buffer_t audio;
-    std::vector<float> audio_data(N_SAMPLES);
+    audio_source_t source;
     std::vector<std::string> recognized_text;
     memset(&rknn_app_ctx, 0, sizeof(rknn_app_context_t));
-    memset(&audio, 0, sizeof(audio_buffer_t));
+    memset(&source, 0, sizeof(audio_source_t));
 
     timer.tik();
-    ret = read_audio(audio_path, &audio);
+    ret = init_wav2vec2_model(model_path, &rknn_app_ctx);
     if (ret != 0)
     {
-        printf("read audio fail! ret=%d audio_path=%s\n", ret, audio_path);
+        printf("init_wav2vec2_model fail! ret=%d model_path=%s\n", ret, model_path);
         goto out;
     }
-
-    if (audio.num_channels == 2)
-    {
-        ret = convert_channels(&audio);
-        if (ret != 0)
-        {
-            printf("convert channels fail! ret=%d\n", ret, audio_path);
-            goto out;
-        }
-    }
-
-    if (audio.sample_rate != SAMPLE_RATE)
-    {
-        ret = resample_audio(&audio, audio.sample_rate, SAMPLE_RATE);
-        if (ret != 0)
-        {
-            printf("resample audio fail! ret=%d\n", ret, audio_path);
-            goto out;
-        }
-    }
     timer.tok();
-    timer.print_time("read_audio & convert_channels & resample_audio");
-
-    timer.tik();
-    audio_preprocess(&audio, audio_data);
-    timer.tok();
-    timer.print_time("audio_preprocess");
+    timer.print_time("init_wav2vec2_model");
 
-    timer.tik();
-    ret = init_wav2vec2_model(model_path, &rknn_app_ctx);
+    // decoded, downmixed and resampled in the background while the model runs
+    ret = open_audio_source(audio_path, SAMPLE_RATE, 1, &source);
     if (ret != 0)
     {
-        printf("init_wav2vec2_model fail! ret=%d model_path=%s\n", ret, model_path);
+        printf("open audio source fail! ret=%d audio_path=%s\n", ret, audio_path);
         goto out;
     }
-    timer.tok();
-    timer.print_time("init_wav2vec2_model");
 
     timer.tik();
-    ret = inference_wav2vec2_model(&rknn_app_ctx, audio_data, recognized_text);
+    ret = inference_wav2vec2_chunked(&rknn_app_ctx, &source, recognized_text);
     if (ret != 0)
     {
-        printf("inference_wav2vec2_model fail! ret=%d\n", ret);
+        printf("inference_wav2vec2_chunked fail! ret=%d\n", ret);
         goto out;
     }
     timer.tok();
@@ -113,7 +85,7 @@ int main(int argc, char **argv)
     std::cout << std::endl;
 
     infer_time = timer.get_time() / 1000.0; // sec
-    audio_length = (float)CHUNK_LENGTH;     // sec
+    audio_length = (float)source.num_read / SAMPLE_RATE; // sec
     rtf = infer_time / audio_length;
     printf("\nReal Time Factor (RTF): %.3f / %.3f = %.3f\n", infer_time, audio_length, rtf);
 
@@ -125,10 +97,7 @@ out:
         printf("release_wav2vec2_model encoder_context fail! ret=%d\n", ret);
     }
 
-    if (audio.data != NULL)
-    {
-        free(audio.data);
-    }
+    close_audio_source(&source);
 
     return 0;
 }
@@ -25,20 +25,7 @@ static TokenDictEntry tokenizer_dict[] = {
             {16, "U"}, {17, "M"}, {18, "W"}, {19, "C"}, {20, "F"}, {21, "G"}, {22, "Y"}, {23, "P"}, 
             {24, "B"}, {25, "V"}, {26, "K"}, {27, "'"}, {28, "X"}, {29, "J"}, {30, "Q"}, {31, "Z"}};
 
-static void pad_or_trim(const std::vector<float> &array, std::vector<float> &result, int array_shape, int length)
-{
-    if (array_shape > length)
-    {
-        std::copy(array.begin(), array.begin() + length, result.begin());
-    }
-    else
-    {
-        std::copy(array.begin(), array.end(), result.begin());
-        std::fill(result.begin() + array_shape, result.end(), 0.0f);
-    }
-}
-
-static int argmax(float *array, int size)
+static int argmax(const float *array, int size)
 {
     int max_index = 0;
     float max_value = array[0];
@@ -55,8 +42,12 @@ static int argmax(float *array, int size)
     return max_index;
 }
 
-static void compress_sequence(int *sequence, int num_rows, std::vector<int> &compressed_sequence)
+static void compress_sequence(const int *sequence, int num_rows, std::vector<int> &compressed_sequence)
 {
+    if (num_rows <= 0)
+    {
+        return;
+    }
     compressed_sequence.push_back(sequence[0]);
 
     for (size_t i = 1; i < num_rows; i++)
@@ -68,7 +59,7 @@ static void compress_sequence(int *sequence, int num_rows, std::vector<int> &com
     }
 }
 
-static void decode(int *token_ids, int num_rows, std::vector<std::string> &recognized_text)
+static void decode(const int *token_ids, int num_rows, std::vector<std::string> &recognized_text)
 {
     std::vector<int> compressed_token_ids;
     std::string token;
@@ -91,21 +82,50 @@ static void decode(int *token_ids, int num_rows, std::vector<std::string> &recog
 
 void audio_preprocess(audio_buffer_t *audio, std::vector<float> &audio_data)
 {
-    std::vector<float> ori_audio_data(audio->data, audio->data + audio->num_frames);
-    pad_or_trim(ori_audio_data, audio_data, audio->num_frames, N_SAMPLES);
+    int n = audio->num_frames < N_SAMPLES ? audio->num_frames : N_SAMPLES;
+    audio_data.resize(N_SAMPLES);
+    std::copy(audio->data, audio->data + n, audio_data.begin());
+    std::fill(audio_data.begin() + n, audio_data.end(), 0.0f);
 }
 
 void post_process(float *output, std::vector<std::string> &recognized_text)
 {
-    int num_rows = OUTPUT_SIZE;
-    int num_columns = VOCAB_NUM;
+    int predicted_ids[OUTPUT_SIZE];
+    ctc_frame_ids(output, OUTPUT_SIZE, predicted_ids);
+    decode(predicted_ids, OUTPUT_SIZE, recognized_text);
+}
 
-    int predicted_ids[num_rows];
-    for (int i = 0; i < num_rows; i++)
+void ctc_frame_ids(const float *output, int num_frames, int *ids)
+{
+    for (int i = 0; i < num_frames; i++)
     {
-        int maxIndex = argmax(&output[i * num_columns], num_columns);
-        predicted_ids[i] = maxIndex;
+        ids[i] = argmax(&output[i * VOCAB_NUM], VOCAB_NUM);
     }
+}
 
-    decode(predicted_ids, num_rows, recognized_text);
-}
\ No newline at end of file
+void ctc_stitch(std::vector<int> &ids, const int *chunk_ids, int chunk_start, int num_frames)
+{
+    int overlap_end = (int)ids.size() < chunk_start + num_frames ? (int)ids.size() : chunk_start + num_frames;
+    int middle = (chunk_start + overlap_end) / 2;
+    int cut = middle;
+    int best = -1;
+    for (int f = chunk_start; f < overlap_end; f++)
+    {
+        if (ids[f] == BLANK_ID && chunk_ids[f - chunk_start] == BLANK_ID)
+        {
+            int dist = abs(f - middle);
+            if (best < 0 || dist < best)
+            {
+                best = dist;
+                cut = f;
+            }
+        }
+    }
+    ids.resize(cut);
+    ids.insert(ids.end(), chunk_ids + (cut - chunk_start), chunk_ids + num_frames);
+}
+
+void ctc_decode(const std::vector<int> &ids, std::vector<std::string> &recognized_text)
+{
+    decode(ids.data(), (int)ids.size(), recognized_text);
+}
@@ -6,8 +6,11 @@
 #define VOCAB_NUM 32
 #define SAMPLE_RATE 16000
 #define CHUNK_LENGTH 20
-#define OUTPUT_SIZE CHUNK_LENGTH * 50 - 1
-#define N_SAMPLES CHUNK_LENGTH *SAMPLE_RATE // AUDIO_LENGTH
+#define OUTPUT_SIZE (CHUNK_LENGTH * 50 - 1)
+#define N_SAMPLES (CHUNK_LENGTH * SAMPLE_RATE) // AUDIO_LENGTH
+#define SAMPLES_PER_FRAME 320
+#define CHUNK_OVERLAP 2 // seconds shared by two consecutive chunks of long audio
+#define BLANK_ID 0
 
 typedef struct
 {
@@ -18,4 +21,34 @@ typedef struct
 void audio_preprocess(audio_buffer_t *audio, std::vector<float> &audio_data);
 void post_process(float *scores, std::vector<std::string> &recognized_text);
 
+/**
+ * @brief Greedy CTC ids of every output frame
+ *
+ * @param output [in] num_frames * VOCAB_NUM logits
+ * @param num_frames [in] Frame count
+ * @param ids [out] num_frames ids
+ */
+void ctc_frame_ids(const float *output, int num_frames, int *ids);
+
+/**
+ * @brief Append the frame ids of an overlapping chunk
+ *
+ * The chunks are joined at the blank frame closest to the middle of their overlap on which both
+ * chunks agree, so no token is cut or emitted twice. Without such a frame they are joined at the middle.
+ *
+ * @param ids [in/out] Frame ids from frame 0
+ * @param chunk_ids [in] Frame ids of the chunk
+ * @param chunk_start [in] First frame of the chunk, <= ids.size()
+ * @param num_frames [in] Frame count of the chunk
+ */
+void ctc_stitch(std::vector<int> &ids, const int *chunk_ids, int chunk_start, int num_frames);
+
+/**
+ * @brief Collapse frame ids into text
+ *
+ * @param ids [in] Frame ids
+ * @param recognized_text [out] Tokens
+ */
+void ctc_decode(const std::vector<int> &ids, std::vector<std::string> &recognized_text);
+
 #endif //_RKNN_WAV2VEC2_DEMO_PROCESS_H_
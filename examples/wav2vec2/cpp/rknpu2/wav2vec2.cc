@@ -18,6 +18,7 @@
 #include <math.h>
 #include "wav2vec2.h"
 #include "file_utils.h"
+#include "model_registry.h"
 #include "audio_utils.h"
 #include <vector>
 #include "process.h"
@@ -48,16 +49,13 @@ static void dump_tensor_attr(rknn_tensor_attr *attr)
 int init_wav2vec2_model(const char *model_path, rknn_app_context_t *app_ctx)
 {
     int ret;
-    int model_len = 0;
-    char *model;
     rknn_context ctx = 0;
 
     // Load RKNN Model
-    ret = rknn_init(&ctx, (char *)model_path, model_len, 0, NULL);
-    free(model);
+    ret = acquire_model_context(model_path, 0, &ctx);
     if (ret < 0)
     {
-        printf("rknn_init fail! ret=%d\n", ret);
+        printf("acquire_model_context fail! ret=%d\n", ret);
         return -1;
     }
 
@@ -111,6 +109,23 @@ int init_wav2vec2_model(const char *model_path, rknn_app_context_t *app_ctx)
     app_ctx->output_attrs = (rknn_tensor_attr *)malloc(io_num.n_output * sizeof(rknn_tensor_attr));
     memcpy(app_ctx->output_attrs, output_attrs, io_num.n_output * sizeof(rknn_tensor_attr));
 
+    // float input bound once, the runtime converts it on every rknn_run
+    app_ctx->input_attrs[0].type = RKNN_TENSOR_FLOAT32;
+    app_ctx->input_mem = rknn_create_mem(ctx, N_SAMPLES * sizeof(float));
+    app_ctx->output_buf = (float *)malloc(OUTPUT_SIZE * VOCAB_NUM * sizeof(float));
+    if (app_ctx->input_mem == NULL || app_ctx->output_buf == NULL)
+    {
+        printf("alloc input/output buffer fail!\n");
+        return -1;
+    }
+    ret = rknn_set_io_mem(ctx, app_ctx->input_mem, &app_ctx->input_attrs[0]);
+    if (ret < 0)
+    {
+        printf("rknn_set_io_mem fail! ret=%d\n", ret);
+        return -1;
+    }
+    app_ctx->input_buf = (float *)app_ctx->input_mem->virt_addr;
+
     return 0;
 }
 
@@ -126,68 +141,129 @@ int release_wav2vec2_model(rknn_app_context_t *app_ctx)
         free(app_ctx->output_attrs);
         app_ctx->output_attrs = NULL;
     }
+    if (app_ctx->input_mem != NULL)
+    {
+        rknn_destroy_mem(app_ctx->rknn_ctx, app_ctx->input_mem);
+        app_ctx->input_mem = NULL;
+        app_ctx->input_buf = NULL;
+    }
+    if (app_ctx->output_buf != NULL)
+    {
+        free(app_ctx->output_buf);
+        app_ctx->output_buf = NULL;
+    }
     if (app_ctx->rknn_ctx != 0)
     {
-        rknn_destroy(app_ctx->rknn_ctx);
+        release_model_context(app_ctx->rknn_ctx);
         app_ctx->rknn_ctx = 0;
     }
     return 0;
 }
 
-int inference_wav2vec2_model(rknn_app_context_t *app_ctx, std::vector<float> audio_data, std::vector<std::string> &recognized_text)
+// run app_ctx->input_buf, logits are written into app_ctx->output_buf
+static int run_chunk(rknn_app_context_t *app_ctx)
 {
     int ret;
 
-    recognized_text.clear();
-
-    rknn_input inputs[1];
     rknn_output outputs[1];
 
-    memset(inputs, 0, sizeof(inputs));
     memset(outputs, 0, sizeof(outputs));
 
-    // Set Input Data
-    inputs[0].index = 0;
-    inputs[0].type = RKNN_TENSOR_FLOAT32;
-    inputs[0].size = N_SAMPLES * sizeof(float);
-    inputs[0].buf = (float *)malloc(inputs[0].size);
-    memcpy(inputs[0].buf, audio_data.data(), inputs[0].size);
-
-    ret = rknn_inputs_set(app_ctx->rknn_ctx, 1, inputs);
-    if (ret < 0)
-    {
-        printf("rknn_input_set fail! ret=%d\n", ret);
-        goto out;
-    }
-
-    // Run
+    // Run, the input is bound to app_ctx->input_mem
     ret = rknn_run(app_ctx->rknn_ctx, nullptr);
     if (ret < 0)
     {
         printf("rknn_run fail! ret=%d\n", ret);
-        goto out;
+        return ret;
     }
 
     // Get Output
+    outputs[0].index = 0;
     outputs[0].want_float = 1;
+    outputs[0].is_prealloc = 1;
+    outputs[0].buf = app_ctx->output_buf;
+    outputs[0].size = OUTPUT_SIZE * VOCAB_NUM * sizeof(float);
     ret = rknn_outputs_get(app_ctx->rknn_ctx, 1, outputs, NULL);
     if (ret < 0)
     {
         printf("rknn_outputs_get fail! ret=%d\n", ret);
-        goto out;
+        return ret;
+    }
+    rknn_outputs_release(app_ctx->rknn_ctx, 1, outputs);
+
+    return 0;
+}
+
+int inference_wav2vec2_model(rknn_app_context_t *app_ctx, const std::vector<float> &audio_data, std::vector<std::string> &recognized_text)
+{
+    int ret;
+
+    recognized_text.clear();
+
+    memcpy(app_ctx->input_buf, audio_data.data(), N_SAMPLES * sizeof(float));
+    ret = run_chunk(app_ctx);
+    if (ret < 0)
+    {
+        return ret;
     }
 
     // post process
-    post_process((float *)outputs[0].buf, recognized_text);
+    post_process(app_ctx->output_buf, recognized_text);
 
-out:
+    return 0;
+}
 
-    // Remeber to release rknn output
-    rknn_outputs_release(app_ctx->rknn_ctx, 1, outputs);
-    if (inputs[0].buf != NULL)
+int inference_wav2vec2_chunked(rknn_app_context_t *app_ctx, audio_source_t *source, std::vector<std::string> &recognized_text)
+{
+    int ret;
+    // chunk starts stay on frame boundaries, frame i of a chunk is frame chunk_start / SAMPLES_PER_FRAME + i of the audio
+    int stride = N_SAMPLES - CHUNK_OVERLAP * SAMPLE_RATE;
+    int overlap = N_SAMPLES - stride;
+    int chunk_ids[OUTPUT_SIZE];
+    std::vector<int> ids;
+
+    recognized_text.clear();
+
+    int n = read_audio_source(source, app_ctx->input_buf, N_SAMPLES);
+    for (long long start = 0;; start += stride)
     {
-        free(inputs[0].buf);
+        if (n < 0)
+        {
+            return n;
+        }
+        memset(app_ctx->input_buf + n, 0, (N_SAMPLES - n) * sizeof(float));
+
+        ret = run_chunk(app_ctx);
+        if (ret < 0)
+        {
+            return ret;
+        }
+        ctc_frame_ids(app_ctx->output_buf, OUTPUT_SIZE, chunk_ids);
+        ctc_stitch(ids, chunk_ids, (int)(start / SAMPLES_PER_FRAME), OUTPUT_SIZE);
+
+        // the last output frame ends before the last input sample, a full chunk needs one more
+        if (n <= OUTPUT_SIZE * SAMPLES_PER_FRAME)
+        {
+            break;
+        }
+        // keep the overlap, pull the rest of the next chunk
+        memmove(app_ctx->input_buf, app_ctx->input_buf + stride, overlap * sizeof(float));
+        int m = read_audio_source(source, app_ctx->input_buf + overlap, stride);
+        n = m < 0 ? m : overlap + m;
     }
+    // the short read was the end of the audio or a decode error reported by the next read
+    if (read_audio_source(source, app_ctx->input_buf, 1) < 0)
+    {
+        return -1;
+    }
+
+    // frames of the zero padding after the audio
+    size_t num_frames = ((size_t)source->num_read + SAMPLES_PER_FRAME - 1) / SAMPLES_PER_FRAME;
+    if (ids.size() > num_frames)
+    {
+        ids.resize(num_frames);
+    }
+    ctc_decode(ids, recognized_text);
 
-    return ret;
+    return 0;
 }
@@ -28,10 +28,25 @@ typedef struct
     rknn_input_output_num io_num;
     rknn_tensor_attr *input_attrs;
     rknn_tensor_attr *output_attrs;
+    rknn_tensor_mem *input_mem; // N_SAMPLES floats, bound once as the model input
+    float *input_buf;  // input_mem->virt_addr, every chunk is written here
+    float *output_buf; // OUTPUT_SIZE * VOCAB_NUM, preallocated model output
 } rknn_app_context_t;
 
 int init_wav2vec2_model(const char *model_path, rknn_app_context_t *app_ctx);
 int release_wav2vec2_model(rknn_app_context_t *app_ctx);
-int inference_wav2vec2_model(rknn_app_context_t *app_ctx, std::vector<float> audio_data, std::vector<std::string> &recognized_text);
+int inference_wav2vec2_model(rknn_app_context_t *app_ctx, const std::vector<float> &audio_data, std::vector<std::string> &recognized_text);
+
+/**
+ * @brief Recognize audio of any length in chunks of N_SAMPLES overlapping by CHUNK_OVERLAP seconds
+ *
+ * Only the current chunk is held in memory, the next samples are pulled from the source as needed.
+ *
+ * @param app_ctx [in] Model context
+ * @param source [in] Mono audio source at SAMPLE_RATE
+ * @param recognized_text [out] Tokens
+ * @return int 0: success; < 0: error
+ */
+int inference_wav2vec2_chunked(rknn_app_context_t *app_ctx, audio_source_t *source, std::vector<std::string> &recognized_text);
 
 #endif //_RKNN_DEMO_WAV2VEC2_H_
\ No newline at end of file
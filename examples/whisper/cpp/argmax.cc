@@ -0,0 +1,116 @@
+// Copyright (c) 2024 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdint.h>
+#include <algorithm>
+#include "whisper.h"
+
+#if defined(__ARM_NEON)
+#define ENABLE_NEON 1
+#include "arm_neon.h"
+#else
+#define ENABLE_NEON 0
+#endif
+
+// fp16 bits -> int16 with the same order as the fp16 values, no fp16 arithmetic needed,
+// -0 and +0 get the same key so that they tie like the float compare
+static inline int16_t fp16_key(uint16_t h)
+{
+    int16_t v = (int16_t)h;
+    int16_t sign = v >> 15;
+    return (v ^ (sign & 0x7fff)) - sign;
+}
+
+// index of the first largest key in [begin, end), returns -1 for an empty range
+static int argmax_fp16_range(const uint16_t *logits, int begin, int end, int16_t *max_key)
+{
+    if (begin >= end)
+    {
+        return -1;
+    }
+    int i = begin;
+    int16_t best = fp16_key(logits[i]);
+#if ENABLE_NEON
+    if (end - begin >= 8)
+    {
+        const int16x8_t sign_mask = vdupq_n_s16(0x7fff);
+        int16x8_t vmax = vdupq_n_s16(INT16_MIN);
+        for (; i + 8 <= end; i += 8)
+        {
+            int16x8_t v = vreinterpretq_s16_u16(vld1q_u16(logits + i));
+            int16x8_t sign = vshrq_n_s16(v, 15);
+            v = vsubq_s16(veorq_s16(v, vandq_s16(sign, sign_mask)), sign);
+            vmax = vmaxq_s16(vmax, v);
+        }
+        int16x4_t m = vpmax_s16(vget_low_s16(vmax), vget_high_s16(vmax));
+        m = vpmax_s16(m, m);
+        m = vpmax_s16(m, m);
+        int16_t vbest = vget_lane_s16(m, 0);
+        best = vbest > best ? vbest : best;
+    }
+#endif
+    for (; i < end; i++)
+    {
+        int16_t k = fp16_key(logits[i]);
+        best = k > best ? k : best;
+    }
+    *max_key = best;
+    // first position of the maximum, stops as soon as it is found
+    for (i = begin; fp16_key(logits[i]) != best; i++)
+    {
+    }
+    return i;
+}
+
+int argmax_logits_fp16(const uint16_t *logits, int n, const int *suppress, int n_suppress)
+{
+    int index = -1;
+    int16_t best = INT16_MIN;
+    int begin = 0;
+    // the tokens between two suppressed ones are scanned as one range
+    for (int s = 0; s <= n_suppress; s++)
+    {
+        int end = s < n_suppress ? std::min(suppress[s], n) : n;
+        int16_t key;
+        int i = argmax_fp16_range(logits, begin, end, &key);
+        if (i >= 0 && (index < 0 || key > best))
+        {
+            index = i;
+            best = key;
+        }
+        begin = std::max(begin, end + 1);
+    }
+    return index;
+}
+
+int argmax_logits(const float *logits, int n, const int *suppress, int n_suppress)
+{
+    int index = -1;
+    float best = 0;
+    int begin = 0;
+    for (int s = 0; s <= n_suppress; s++)
+    {
+        int end = s < n_suppress ? std::min(suppress[s], n) : n;
+        for (int i = begin; i < end; i++)
+        {
+            if (index < 0 || logits[i] > best)
+            {
+                index = i;
+                best = logits[i];
+            }
+        }
+        begin = std::max(begin, end + 1);
+    }
+    return index;
+}
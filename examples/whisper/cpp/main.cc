@@ -67,60 +67,45 @@ int main(int argc, char **argv)
     rknn_whisper_context_t rknn_app_ctx;
     std::vector<float> audio_data(N_MELS * MAX_AUDIO_LENGTH / HOP_LENGTH, 0.0f);
     std::vector<std::string> recognized_text;
-    float *mel_filters = (float *)malloc(N_MELS * MELS_FILTERS_SIZE * sizeof(float));
-    VocabEntry vocab[VOCAB_NUM];
+    asset_t mel_asset;
+    const float *mel_filters = NULL;
+    asset_t vocab;
     audio_buffer_t audio;
 
     memset(&rknn_app_ctx, 0, sizeof(rknn_whisper_context_t));
-    memset(vocab, 0, sizeof(vocab));
+    memset(&mel_asset, 0, sizeof(asset_t));
+    memset(&vocab, 0, sizeof(asset_t));
     memset(&audio, 0, sizeof(audio_buffer_t));
 
     timer.tik();
-    ret = read_audio(audio_path, &audio);
+    // the model sees at most MAX_AUDIO_LENGTH samples, the rest of the file is never decoded
+    ret = read_audio_head(audio_path, SAMPLE_RATE, MAX_AUDIO_LENGTH, &audio);
     if (ret != 0)
     {
         printf("read audio fail! ret=%d audio_path=%s\n", ret, audio_path);
         goto out;
     }
-
-    if (audio.num_channels == 2)
-    {
-        ret = convert_channels(&audio);
-        if (ret != 0)
-        {
-            printf("convert channels fail! ret=%d\n", ret, audio_path);
-            goto out;
-        }
-    }
-
-    if (audio.sample_rate != SAMPLE_RATE)
-    {
-        ret = resample_audio(&audio, audio.sample_rate, SAMPLE_RATE);
-        if (ret != 0)
-        {
-            printf("resample audio fail! ret=%d\n", ret, audio_path);
-            goto out;
-        }
-    }
     timer.tok();
-    timer.print_time("read_audio & convert_channels & resample_audio");
+    timer.print_time("read_audio_head");
 
     timer.tik();
-    ret = read_mel_filters(MEL_FILTERS_PATH, mel_filters, N_MELS * MELS_FILTERS_SIZE);
-    if (ret != 0)
+    ret = load_mel_filters(MEL_FILTERS_PATH, &mel_asset);
+    mel_filters = ret == 0 ? get_asset_floats(&mel_asset) : NULL;
+    if (mel_filters == NULL)
     {
-        printf("read mel_filters fail! ret=%d mel_filters_path=%s\n", ret, MEL_FILTERS_PATH);
+        printf("load mel_filters fail! ret=%d mel_filters_path=%s\n", ret, MEL_FILTERS_PATH);
+        ret = -1;
         goto out;
     }
 
-    ret = read_vocab(vocab_path, vocab);
+    ret = load_vocab(vocab_path, &vocab);
     if (ret != 0)
     {
-        printf("read vocab fail! ret=%d vocab_path=%s\n", ret, vocab_path);
+        printf("load vocab fail! ret=%d vocab_path=%s\n", ret, vocab_path);
         goto out;
     }
     timer.tok();
-    timer.print_time("read_mel_filters & read_vocab");
+    timer.print_time("load_mel_filters & load_vocab");
 
     timer.tik();
     ret = init_whisper_model(encoder_path, &rknn_app_ctx.encoder_context);
@@ -145,7 +130,7 @@ int main(int argc, char **argv)
     timer.tik();
     audio_preprocess(&audio, mel_filters, audio_data);
 
-    ret = inference_whisper_model(&rknn_app_ctx, audio_data, mel_filters, vocab, task_code, recognized_text);
+    ret = inference_whisper_model(&rknn_app_ctx, audio_data, mel_filters, &vocab, task_code, recognized_text);
     if (ret != 0)
     {
         printf("inference_whisper_model fail! ret=%d\n", ret);
@@ -186,19 +171,8 @@ out:
         free(audio.data);
     }
 
-    for (int i = 0; i < VOCAB_NUM; ++i)
-    {
-        if (vocab[i].token != NULL)
-        {
-            free(vocab[i].token);
-            vocab[i].token = NULL;
-        }
-    }
-
-    if (mel_filters != NULL)
-    {
-        free(mel_filters);
-    }
+    close_asset(&vocab);
+    close_asset(&mel_asset);
 
     return 0;
 }
@@ -28,10 +28,24 @@
 #include "arm_neon.h"
 #endif
 
-int read_mel_filters(const char *fileName, float *data, int max_lines)
+int load_mel_filters(const char *fileName, asset_t *mel_filters)
 {
+    int ret = open_text_asset(fileName, 0, mel_filters);
+    if (ret <= 0)
+    {
+        if (ret == 0 && (mel_filters->count != N_MELS * MELS_FILTERS_SIZE ||
+                         (mel_filters->type != ASSET_FLOAT32 && mel_filters->type != ASSET_FLOAT16)))
+        {
+            printf("binary asset of %s is not a %d x %d filter bank\n", fileName, N_MELS, MELS_FILTERS_SIZE);
+            close_asset(mel_filters);
+            return -1;
+        }
+        return ret;
+    }
+
     FILE *file;
     int line_count = 0;
+    std::vector<float> data(N_MELS * MELS_FILTERS_SIZE);
 
     file = fopen(fileName, "r");
     if (file == NULL)
@@ -40,14 +54,19 @@ int read_mel_filters(const char *fileName, float *data, int max_lines)
         return -1;
     }
 
-    while (line_count < max_lines && fscanf(file, "%f", &data[line_count]) == 1)
+    while (line_count < N_MELS * MELS_FILTERS_SIZE && fscanf(file, "%f", &data[line_count]) == 1)
     {
         line_count++;
     }
 
     fclose(file);
 
-    return 0;
+    ret = create_float_asset(data.data(), N_MELS, MELS_FILTERS_SIZE, mel_filters);
+    if (ret == 0)
+    {
+        save_text_asset(mel_filters, fileName); // mapped on the next start
+    }
+    return ret;
 }
 
 static void pad_x_mel(const std::vector<float> input, int rows_input, int cols_input, std::vector<float> &output, int cols_output)
@@ -211,7 +230,7 @@ void transpose(fftwf_complex *input, int input_rows, int input_cols, fftwf_compl
 }
 
 #if ENABLE_NEON
-void matmul_by_neon(float *A, float *B, std::vector<float> &C, int ROWS_A, int COLS_A, int COLS_B)
+void matmul_by_neon(const float *A, float *B, std::vector<float> &C, int ROWS_A, int COLS_A, int COLS_B)
 {
     int k_start = COLS_A, k_end = 0;
     for (auto i = 0; i < ROWS_A; i++)
@@ -259,9 +278,9 @@ void matmul_by_neon(float *A, float *B, std::vector<float> &C, int ROWS_A, int C
     }
 }
 #else
-void matmul_by_opencv(float *A, float *B, std::vector<float> &C, int ROWS_A, int COLS_A, int COLS_B)
+void matmul_by_opencv(const float *A, float *B, std::vector<float> &C, int ROWS_A, int COLS_A, int COLS_B)
 {
-    cv::Mat mat_A(ROWS_A, COLS_A, CV_32F, A);
+    cv::Mat mat_A(ROWS_A, COLS_A, CV_32F, (void *)A);
     cv::Mat mat_B(COLS_A, COLS_B, CV_32F, B);
     cv::Mat mat_C(ROWS_A, COLS_B, CV_32F);
     cv::gemm(mat_A, mat_B, 1.0, cv::Mat(), 0.0, mat_C);
@@ -269,7 +288,7 @@ void matmul_by_opencv(float *A, float *B, std::vector<float> &C, int ROWS_A, int
 }
 #endif
 
-static void log_mel_spectrogram(float *audio_data, int audio_length, int cur_num_frames_of_stfts, float *filters, std::vector<float> &mel_spec)
+static void log_mel_spectrogram(float *audio_data, int audio_length, int cur_num_frames_of_stfts, const float *filters, std::vector<float> &mel_spec)
 {
     std::vector<float> window(N_FFT);
     hann_window(window, N_FFT);
@@ -307,7 +326,7 @@ static void log_mel_spectrogram(float *audio_data, int audio_length, int cur_num
     fftwf_free(stfts_result_t);
 }
 
-void audio_preprocess(audio_buffer_t *audio, float *mel_filters, std::vector<float> &x_mel)
+void audio_preprocess(audio_buffer_t *audio, const float *mel_filters, std::vector<float> &x_mel)
 {
     int ret;
     int audio_length = audio->num_frames;
@@ -332,8 +351,14 @@ void audio_preprocess(audio_buffer_t *audio, float *mel_filters, std::vector<flo
     }
 }
 
-int read_vocab(const char *fileName, VocabEntry *vocab)
+int load_vocab(const char *fileName, asset_t *vocab)
 {
+    int ret = open_text_asset(fileName, ASSET_STRINGS, vocab);
+    if (ret <= 0)
+    {
+        return ret;
+    }
+
     FILE *fp;
     char line[512];
 
@@ -344,17 +369,32 @@ int read_vocab(const char *fileName, VocabEntry *vocab)
         return -1;
     }
 
-    int count = 0;
+    std::vector<std::string> tokens(VOCAB_NUM);
     while (fgets(line, sizeof(line), fp))
     {
-        vocab[count].token = strdup(strchr(line, ' ') + 1); // Get token after the first space
-        vocab[count].index = atoi(line);                    // Get index before the first space
-        count++;
+        char *space = strchr(line, ' ');
+        int index = atoi(line); // Get index before the first space
+        if (space == NULL || index < 0 || index >= VOCAB_NUM)
+        {
+            continue;
+        }
+        tokens[index] = space + 1; // Get token after the first space
+        tokens[index].erase(tokens[index].find_last_not_of("\r\n") + 1);
     }
 
     fclose(fp);
 
-    return 0;
+    std::vector<const char *> strings(VOCAB_NUM);
+    for (int i = 0; i < VOCAB_NUM; i++)
+    {
+        strings[i] = tokens[i].c_str();
+    }
+    ret = create_string_asset(strings.data(), VOCAB_NUM, vocab);
+    if (ret == 0)
+    {
+        save_text_asset(vocab, fileName); // mapped on the next start
+    }
+    return ret;
 }
 
 void replace_substr(std::string &str, const std::string &from, const std::string &to)
@@ -369,23 +409,6 @@ void replace_substr(std::string &str, const std::string &from, const std::string
     }
 }
 
-int argmax(float *array)
-{
-    int start_index = (MAX_TOKENS - 1) * 1 * VOCAB_NUM;
-    int max_index = 0;
-    float max_value = array[start_index];
-    for (int i = start_index + 1; i < start_index + VOCAB_NUM; i++)
-    {
-        if (array[i] > max_value)
-        {
-            max_value = array[i];
-            max_index = i;
-        }
-    }
-    int relative_index = max_index - start_index;
-    return relative_index;
-}
-
 static int32_t get_char_index(char c)
 {
     if (c >= 'A' && c <= 'Z')
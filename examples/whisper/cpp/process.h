@@ -5,6 +5,7 @@
 
 #include "rknn_api.h"
 #include "easy_timer.h"
+#include "asset_utils.h"
 
 #define VOCAB_NUM 51865
 #define MAX_TOKENS 12
@@ -22,17 +23,45 @@
 #define MEL_FILTERS_PATH "./model/mel_80_filters.txt"
 #define PI 3.14159265358979323846
 
-typedef struct
-{
-    int index;
-    char *token;
-} VocabEntry;
-
 void replace_substr(std::string &str, const std::string &from, const std::string &to);
-int read_vocab(const char *fileName, VocabEntry *vocab);
-int read_mel_filters(const char *fileName, float *data, int max_lines);
-void audio_preprocess(audio_buffer_t *audio, float *mel_filters, std::vector<float> &x_mel);
-int argmax(float *array);
+
+/**
+ * @brief Load vocabulary, "<name>.bin" is memory mapped unless "<name>.txt" changed since it was converted,
+ * else the text is parsed and "<name>.bin" rebuilt from it
+ *
+ * @param fileName [in] Text vocabulary path, "<id> <token>" lines
+ * @param vocab [out] String asset, tokens indexed by id
+ * @return int 0: success; -1: error
+ */
+int load_vocab(const char *fileName, asset_t *vocab);
+
+/**
+ * @brief Load mel filters, "<name>.bin" is memory mapped unless "<name>.txt" changed since it was converted,
+ * else the text is parsed and "<name>.bin" rebuilt from it
+ *
+ * @param fileName [in] Text filter path, N_MELS * MELS_FILTERS_SIZE values
+ * @param mel_filters [out] Float asset
+ * @return int 0: success; -1: error
+ */
+int load_mel_filters(const char *fileName, asset_t *mel_filters);
+void audio_preprocess(audio_buffer_t *audio, const float *mel_filters, std::vector<float> &x_mel);
+
+/**
+ * @brief Token with the largest fp16 logit, suppressed tokens are skipped in the same pass
+ *
+ * @param logits [in] Raw fp16 logits of one position
+ * @param n [in] Tokens considered, [0, n), tokens from n on (timestamps) are never picked
+ * @param suppress [in] Suppressed tokens, ascending
+ * @param n_suppress [in] Suppressed token count
+ * @return int Token, -1 if every token is suppressed
+ */
+int argmax_logits_fp16(const uint16_t *logits, int n, const int *suppress, int n_suppress);
+
+/**
+ * @brief Float version of argmax_logits_fp16
+ *
+ */
+int argmax_logits(const float *logits, int n, const int *suppress, int n_suppress);
 std::string base64_decode(const std::string &s);
 
 #endif //_RKNN_WHISPER_DEMO_PROCESS_H_
@@ -18,6 +18,7 @@
 #include <math.h>
 #include "whisper.h"
 #include "file_utils.h"
+#include "model_registry.h"
 #include "audio_utils.h"
 #include <vector>
 #include "process.h"
@@ -48,14 +49,13 @@ static void dump_tensor_attr(rknn_tensor_attr *attr)
 int init_whisper_model(const char *model_path, rknn_app_context_t *app_ctx)
 {
     int ret;
-    int model_len = 0;
     rknn_context ctx = 0;
 
     // Load RKNN Model
-    ret = rknn_init(&ctx, (void *)model_path, model_len, 0, NULL);
+    ret = acquire_model_context(model_path, 0, &ctx);
     if (ret < 0)
     {
-        printf("rknn_init fail! ret=%d\n", ret);
+        printf("acquire_model_context fail! ret=%d\n", ret);
         return -1;
     }
 
@@ -124,15 +124,20 @@ int release_whisper_model(rknn_app_context_t *app_ctx)
         free(app_ctx->output_attrs);
         app_ctx->output_attrs = NULL;
     }
+    if (app_ctx->output_buf != NULL)
+    {
+        free(app_ctx->output_buf);
+        app_ctx->output_buf = NULL;
+    }
     if (app_ctx->rknn_ctx != 0)
     {
-        rknn_destroy(app_ctx->rknn_ctx);
+        release_model_context(app_ctx->rknn_ctx);
         app_ctx->rknn_ctx = 0;
     }
     return 0;
 }
 
-int inference_encoder_model(rknn_app_context_t *app_ctx, std::vector<float> audio_data, float *mel_filters, float *encoder_output)
+int inference_encoder_model(rknn_app_context_t *app_ctx, std::vector<float> audio_data, const float *mel_filters, float *encoder_output)
 {
     int ret;
 
@@ -187,7 +192,7 @@ out:
     return ret;
 }
 
-int inference_decoder_model(rknn_app_context_t *app_ctx, float *encoder_output, VocabEntry *vocab, int task_code, std::vector<std::string> &recognized_text)
+int inference_decoder_model(rknn_app_context_t *app_ctx, float *encoder_output, const asset_t *vocab, int task_code, std::vector<std::string> &recognized_text)
 {
     int ret;
     rknn_input inputs[2];
@@ -213,6 +218,11 @@ int inference_decoder_model(rknn_app_context_t *app_ctx, float *encoder_output,
     int next_token = 50258;                                            // tokenizer.sot
     int end_token = 50257;                                             // tokenizer.eot
     int pop_id = MAX_TOKENS;
+    // sot, translate, transcribe, sot_lm, sot_prev, no_speech, no_timestamps, ascending
+    static const int suppress_tokens[] = {50258, 50358, 50359, 50360, 50361, 50362, 50363};
+    int n_suppress = sizeof(suppress_tokens) / sizeof(suppress_tokens[0]);
+    // only the last position is decoded
+    size_t last_row = (size_t)(MAX_TOKENS - 1) * VOCAB_NUM;
 
     int count = 0; // Avoid getting stuck in a decode loop
     std::string all_token_str = "";
@@ -222,6 +232,25 @@ int inference_decoder_model(rknn_app_context_t *app_ctx, float *encoder_output,
         memcpy(&tokens[i * 4], tokens, 4 * sizeof(int64_t));
     }
 
+    // logits are read as the model produces them, fp16 is not converted to float
+    rknn_tensor_attr *logits_attr = &app_ctx->output_attrs[0];
+    bool fp16_logits = logits_attr->type == RKNN_TENSOR_FLOAT16;
+    outputs[0].index = 0;
+    outputs[0].is_prealloc = 1;
+    outputs[0].want_float = !fp16_logits;
+    outputs[0].size = logits_attr->n_elems * (fp16_logits ? sizeof(uint16_t) : sizeof(float));
+    if (app_ctx->output_buf == NULL)
+    {
+        app_ctx->output_buf = malloc(outputs[0].size);
+    }
+    outputs[0].buf = app_ctx->output_buf;
+    if (inputs[0].buf == NULL || inputs[1].buf == NULL || outputs[0].buf == NULL)
+    {
+        printf("malloc decoder buffers fail!\n");
+        ret = -1;
+        goto out;
+    }
+
     while (next_token != end_token && count < 1000)
     {
         count++;
@@ -244,7 +273,6 @@ int inference_decoder_model(rknn_app_context_t *app_ctx, float *encoder_output,
         }
 
         // Get Output
-        outputs[0].want_float = 1;
         ret = rknn_outputs_get(app_ctx->rknn_ctx, 1, outputs, NULL);
         if (ret < 0)
         {
@@ -252,15 +280,22 @@ int inference_decoder_model(rknn_app_context_t *app_ctx, float *encoder_output,
             goto out;
         }
 
-        next_token = argmax((float *)outputs[0].buf);
+        // timestamp tokens are never picked
+        if (fp16_logits)
+        {
+            next_token = argmax_logits_fp16((uint16_t *)outputs[0].buf + last_row, timestamp_begin, suppress_tokens, n_suppress);
+        }
+        else
+        {
+            next_token = argmax_logits((float *)outputs[0].buf + last_row, timestamp_begin, suppress_tokens, n_suppress);
+        }
+
+        // Remeber to release rknn output
+        rknn_outputs_release(app_ctx->rknn_ctx, 1, outputs);
 
-        std::string next_token_str = vocab[next_token].token;
+        std::string next_token_str = get_asset_string(vocab, next_token);
         all_token_str += next_token_str;
 
-        if (next_token > timestamp_begin)
-        {
-            continue;
-        }
         if (pop_id > 4)
         {
             pop_id--;
@@ -272,9 +307,6 @@ int inference_decoder_model(rknn_app_context_t *app_ctx, float *encoder_output,
         {
             tokens[j] = tokens[j + 1];
         }
-
-        // Remeber to release rknn output
-        rknn_outputs_release(app_ctx->rknn_ctx, 1, outputs);
     }
 
     replace_substr(all_token_str, "\u0120", " ");
@@ -303,7 +335,7 @@ out:
     return ret;
 }
 
-int inference_whisper_model(rknn_whisper_context_t *app_ctx, std::vector<float> audio_data, float *mel_filters, VocabEntry *vocab, int task_code, std::vector<std::string> &recognized_text)
+int inference_whisper_model(rknn_whisper_context_t *app_ctx, std::vector<float> audio_data, const float *mel_filters, const asset_t *vocab, int task_code, std::vector<std::string> &recognized_text)
 {
     int ret;
     // TIMER timer;
@@ -28,6 +28,7 @@ typedef struct
     rknn_input_output_num io_num;
     rknn_tensor_attr *input_attrs;
     rknn_tensor_attr *output_attrs;
+    void *output_buf; // decoder logits as the model writes them, allocated by the first decode
 } rknn_app_context_t;
 
 typedef struct
@@ -38,6 +39,6 @@ typedef struct
 
 int init_whisper_model(const char *model_path, rknn_app_context_t *app_ctx);
 int release_whisper_model(rknn_app_context_t *app_ctx);
-int inference_whisper_model(rknn_whisper_context_t *app_ctx, std::vector<float> audio_data, float *mel_filters, VocabEntry *vocab, int task_code, std::vector<std::string> &recognized_text);
+int inference_whisper_model(rknn_whisper_context_t *app_ctx, std::vector<float> audio_data, const float *mel_filters, const asset_t *vocab, int task_code, std::vector<std::string> &recognized_text);
 
 #endif //_RKNN_DEMO_WHISPER_H_
\ No newline at end of file
@@ -20,21 +20,38 @@
 #include <stdlib.h>
 #include <string.h>
 #include "yamnet.h"
+#include "yamnet_stream.h"
 #include "audio_utils.h"
 
+// samples pushed at a time, like a 100ms capture period
+#define STREAM_BLOCK (SAMPLE_RATE / 10)
+
+static void print_event(void *userdata, const sound_event_t *event)
+{
+    LabelEntry *label = (LabelEntry *)userdata;
+    printf("[%8.2fs - %8.2fs] %s (peak %.3f), top:", event->start, event->end, label[event->index].token, event->peak);
+    for (int i = 0; i < STREAM_TOP_K; i++)
+    {
+        printf(" %s(%.3f)", label[event->top[i]].token, event->top_score[i]);
+    }
+    printf("\n");
+}
+
 /*-------------------------------------------
                   Main Function
 -------------------------------------------*/
 int main(int argc, char **argv)
 {
-    if (argc != 3)
+    if (argc != 3 && argc != 4)
     {
-        printf("%s <model_path> <audio_path>\n", argv[0]);
+        printf("%s <model_path> <audio_path> [hop_seconds]\n", argv[0]);
+        printf("  hop_seconds: detect sound events over the whole audio with windows every hop_seconds\n");
         return -1;
     }
 
     const char *model_path = argv[1];
     const char *audio_path = argv[2];
+    float hop_seconds = argc == 4 ? atof(argv[3]) : 0.0f;
 
     int ret;
     TIMER timer;
@@ -58,37 +75,79 @@ int main(int argc, char **argv)
         goto out;
     }
 
-    ret = read_audio(audio_path, &audio);
+    if (argc == 3)
+    {
+        // only the first window is classified, the rest of the file is never decoded
+        ret = read_audio_head(audio_path, SAMPLE_RATE, N_SAMPLES, &audio);
+        if (ret != 0)
+        {
+            printf("read audio fail! ret=%d audio_path=%s\n", ret, audio_path);
+            goto out;
+        }
+    }
+
+    ret = init_yamnet_model(model_path, &rknn_app_ctx);
     if (ret != 0)
     {
-        printf("read audio fail! ret=%d audio_path=%s\n", ret, audio_path);
+        printf("init_yamnet_model fail! ret=%d model_path=%s\n", ret, model_path);
         goto out;
     }
 
-    if (audio.num_channels == 2)
+    if (argc == 4)
     {
-        ret = convert_channels(&audio);
+        sound_stream_t stream;
+        sound_stream_config_t config;
+        audio_source_t source;
+        float block[STREAM_BLOCK];
+        memset(&config, 0, sizeof(config));
+        config.hop_seconds = hop_seconds;
+        config.smoothing = 0.5f;
+        config.on_threshold = 0.4f;
+        config.off_threshold = 0.25f;
+        ret = init_sound_stream(&stream, &rknn_app_ctx, &config, print_event, label);
         if (ret != 0)
         {
-            printf("convert channels fail! ret=%d\n", ret, audio_path);
             goto out;
         }
-    }
+        // decoded in the background, only the ring buffer and one window are in memory
+        ret = open_audio_source(audio_path, SAMPLE_RATE, 1, &source);
+        if (ret != 0)
+        {
+            printf("open audio source fail! ret=%d audio_path=%s\n", ret, audio_path);
+            release_sound_stream(&stream);
+            goto out;
+        }
 
-    if (audio.sample_rate != SAMPLE_RATE)
-    {
-        ret = resample_audio(&audio, audio.sample_rate, SAMPLE_RATE);
+        timer.tik();
+        while (ret == 0)
+        {
+            int n = read_audio_source(&source, block, STREAM_BLOCK);
+            if (n <= 0)
+            {
+                ret = n;
+                break;
+            }
+            ret = sound_stream_push(&stream, block, n);
+        }
+        if (ret == 0)
+        {
+            ret = sound_stream_flush(&stream);
+        }
+        timer.tok();
+        timer.print_time("sound_stream");
+        printf("windows: %d\n", stream.windows);
+        audio_length = (float)source.num_read / SAMPLE_RATE; // sec
+        close_audio_source(&source);
+        release_sound_stream(&stream);
         if (ret != 0)
         {
-            printf("resample audio fail! ret=%d\n", ret, audio_path);
+            printf("sound stream fail! ret=%d\n", ret);
             goto out;
         }
-    }
 
-    ret = init_yamnet_model(model_path, &rknn_app_ctx);
-    if (ret != 0)
-    {
-        printf("init_yamnet_model fail! ret=%d model_path=%s\n", ret, model_path);
+        infer_time = timer.get_time() / 1000.0; // sec
+        rtf = infer_time / audio_length;
+        printf("Real Time Factor (RTF): %.3f / %.3f = %.3f\n", infer_time, audio_length, rtf);
         goto out;
     }
 
@@ -19,19 +19,6 @@
 #include <stdlib.h>
 #include <string.h>
 
-static void pad_or_trim(const std::vector<float> &array, std::vector<float> &result, int array_shape, int length)
-{
-    if (array_shape > length)
-    {
-        std::copy(array.begin(), array.begin() + length, result.begin());
-    }
-    else
-    {
-        std::copy(array.begin(), array.end(), result.begin());
-        std::fill(result.begin() + array_shape, result.end(), 0.0f);
-    }
-}
-
 static int argmax(float array[], int size)
 {
     int max_index = 0;
@@ -64,6 +51,7 @@ int read_label(LabelEntry *label)
     int count = 0;
     while (fgets(line, sizeof(line), fp))
     {
+        line[strcspn(line, "\r\n")] = '\0';
         label[count].token = strdup(strchr(line, ' ') + 1); // Get token after the first space
         label[count].index = atoi(line);                    // Get index before the first space
         count++;
@@ -76,32 +64,32 @@ int read_label(LabelEntry *label)
 
 int audio_preprocess(audio_buffer_t *audio, float *audio_pad_or_trim)
 {
-    std::vector<float> ori_audio_data(audio->data, audio->data + audio->num_frames);
-    std::vector<float> audio_data(N_SAMPLES);
-
-    pad_or_trim(ori_audio_data, audio_data, audio->num_frames, N_SAMPLES);
-    memcpy(audio_pad_or_trim, audio_data.data(), N_SAMPLES * sizeof(float));
+    int n = audio->num_frames < N_SAMPLES ? audio->num_frames : N_SAMPLES;
+    memcpy(audio_pad_or_trim, audio->data, n * sizeof(float));
+    memset(audio_pad_or_trim + n, 0, (N_SAMPLES - n) * sizeof(float));
     return 0;
 }
 
-int post_process(float *scores, LabelEntry *label, ResultEntry *result)
+void average_scores(const float *scores, float *mean_scores)
 {
-    int num_rows = N_ROWS;
-    int num_columns = LABEL_NUM;
-
-    float mean_scores[LABEL_NUM] = {0};
-
-    for (int j = 0; j < num_columns; j++)
+    memset(mean_scores, 0, LABEL_NUM * sizeof(float));
+    for (int i = 0; i < N_ROWS; i++)
     {
-        float sum = 0;
-        for (int i = 0; i < num_rows; i++)
+        const float *row = scores + i * LABEL_NUM;
+        for (int j = 0; j < LABEL_NUM; j++)
         {
-            sum += scores[i * num_columns + j];
+            mean_scores[j] += row[j];
         }
-        mean_scores[j] = sum / num_rows;
     }
+    for (int j = 0; j < LABEL_NUM; j++)
+    {
+        mean_scores[j] /= N_ROWS;
+    }
+}
 
-    int top_class_index = argmax(mean_scores, num_columns);
+int post_process(float *mean_scores, LabelEntry *label, ResultEntry *result)
+{
+    int top_class_index = argmax(mean_scores, LABEL_NUM);
 
     result[0].index = top_class_index;
     result[0].token = label[top_class_index].token;
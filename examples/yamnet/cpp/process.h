@@ -7,8 +7,8 @@
 #define LABEL_NUM 521
 #define SAMPLE_RATE 16000
 #define CHUNK_LENGTH 3
-#define N_SAMPLES CHUNK_LENGTH *SAMPLE_RATE // AUDIO_LENGTH
-#define N_ROWS CHUNK_LENGTH * 2
+#define N_SAMPLES (CHUNK_LENGTH * SAMPLE_RATE) // AUDIO_LENGTH
+#define N_ROWS (CHUNK_LENGTH * 2)
 #define LABEL_PATH "./model/yamnet_class_map.txt"
 
 typedef struct
@@ -24,7 +24,8 @@ typedef struct
 } LabelEntry;
 
 int audio_preprocess(audio_buffer_t *audio, float *audio_pad_or_trim);
-int post_process(float *scores, LabelEntry *label, ResultEntry *result);
+void average_scores(const float *scores, float *mean_scores);
+int post_process(float *mean_scores, LabelEntry *label, ResultEntry *result);
 int read_label(LabelEntry *label);
 
 #endif //_RKNN_YAMNET_DEMO_PROCESS_H_
@@ -18,6 +18,7 @@
 #include <math.h>
 #include "yamnet.h"
 #include "file_utils.h"
+#include "model_registry.h"
 #include "audio_utils.h"
 #include "process.h"
 
@@ -47,23 +48,13 @@ static void dump_tensor_attr(rknn_tensor_attr *attr)
 int init_yamnet_model(const char *model_path, rknn_app_context_t *app_ctx)
 {
     int ret;
-    int model_len = 0;
-    char *model;
     rknn_context ctx = 0;
 
     // Load RKNN Model
-    model_len = read_data_from_file(model_path, &model);
-    if (model == NULL)
-    {
-        printf("load_model fail!\n");
-        return -1;
-    }
-
-    ret = rknn_init(&ctx, model, model_len, 0);
-    free(model);
+    ret = acquire_model_context(model_path, 0, &ctx);
     if (ret < 0)
     {
-        printf("rknn_init fail! ret=%d\n", ret);
+        printf("acquire_model_context fail! ret=%d\n", ret);
         return -1;
     }
 
@@ -134,13 +125,13 @@ int release_yamnet_model(rknn_app_context_t *app_ctx)
     }
     if (app_ctx->rknn_ctx != 0)
     {
-        rknn_destroy(app_ctx->rknn_ctx);
+        release_model_context(app_ctx->rknn_ctx);
         app_ctx->rknn_ctx = 0;
     }
     return 0;
 }
 
-int inference_yamnet_model(rknn_app_context_t *app_ctx, audio_buffer_t *audio, LabelEntry *label, ResultEntry *result)
+int run_yamnet_window(rknn_app_context_t *app_ctx, float *window, float *mean_scores)
 {
     int ret;
 
@@ -154,21 +145,13 @@ int inference_yamnet_model(rknn_app_context_t *app_ctx, audio_buffer_t *audio, L
     inputs[0].index = 0;
     inputs[0].type = RKNN_TENSOR_FLOAT32;
     inputs[0].size = N_SAMPLES * sizeof(float);
-    inputs[0].buf = (float *)malloc(inputs[0].size);
-
-    // Audio Pre Process
-    ret = audio_preprocess(audio, (float *)inputs[0].buf);
-    if (ret < 0)
-    {
-        printf("audio_preprocess fail! ret=%d\n", ret);
-        goto out;
-    }
+    inputs[0].buf = window;
 
     ret = rknn_inputs_set(app_ctx->rknn_ctx, 1, inputs);
     if (ret < 0)
     {
         printf("rknn_input_set fail! ret=%d\n", ret);
-        goto out;
+        return ret;
     }
 
     // Run
@@ -176,7 +159,7 @@ int inference_yamnet_model(rknn_app_context_t *app_ctx, audio_buffer_t *audio, L
     if (ret < 0)
     {
         printf("rknn_run fail! ret=%d\n", ret);
-        goto out;
+        return ret;
     }
 
     // Get Output
@@ -185,20 +168,47 @@ int inference_yamnet_model(rknn_app_context_t *app_ctx, audio_buffer_t *audio, L
     if (ret < 0)
     {
         printf("rknn_outputs_get fail! ret=%d\n", ret);
-        goto out;
+        return ret;
     }
 
-    // post process
-    post_process((float *)outputs[2].buf, label, result);
-
-out:
+    average_scores((float *)outputs[2].buf, mean_scores);
 
     // Remeber to release rknn output
     rknn_outputs_release(app_ctx->rknn_ctx, 3, outputs);
-    if (inputs[0].buf != NULL)
+
+    return 0;
+}
+
+int inference_yamnet_model(rknn_app_context_t *app_ctx, audio_buffer_t *audio, LabelEntry *label, ResultEntry *result)
+{
+    int ret;
+    float mean_scores[LABEL_NUM];
+    float *window = (float *)malloc(N_SAMPLES * sizeof(float));
+    if (window == NULL)
     {
-        free(inputs[0].buf);
+        printf("malloc window fail!\n");
+        return -1;
     }
 
+    // Audio Pre Process
+    ret = audio_preprocess(audio, window);
+    if (ret < 0)
+    {
+        printf("audio_preprocess fail! ret=%d\n", ret);
+        goto out;
+    }
+
+    ret = run_yamnet_window(app_ctx, window, mean_scores);
+    if (ret < 0)
+    {
+        goto out;
+    }
+
+    // post process
+    post_process(mean_scores, label, result);
+
+out:
+    free(window);
+
     return ret;
 }
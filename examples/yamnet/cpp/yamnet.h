@@ -33,4 +33,14 @@ int init_yamnet_model(const char *model_path, rknn_app_context_t *app_ctx);
 int release_yamnet_model(rknn_app_context_t *app_ctx);
 int inference_yamnet_model(rknn_app_context_t *app_ctx, audio_buffer_t *audio, LabelEntry *label, ResultEntry *result);
 
+/**
+ * @brief Run one window of N_SAMPLES samples
+ *
+ * @param app_ctx [in] Model context
+ * @param window [in] N_SAMPLES mono samples at SAMPLE_RATE
+ * @param mean_scores [out] LABEL_NUM class scores averaged over the window
+ * @return int 0: success; < 0: error
+ */
+int run_yamnet_window(rknn_app_context_t *app_ctx, float *window, float *mean_scores);
+
 #endif //_RKNN_DEMO_YAMNET_H_
\ No newline at end of file
@@ -0,0 +1,234 @@
+// Copyright (c) 2024 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "yamnet_stream.h"
+
+static void top_k(const float *scores, int n, int *index, float *score, int k)
+{
+    int count = 0;
+    for (int c = 0; c < n; c++)
+    {
+        if (count == k && scores[c] <= score[k - 1])
+        {
+            continue;
+        }
+        int pos = count < k ? count++ : k - 1;
+        while (pos > 0 && score[pos - 1] < scores[c])
+        {
+            score[pos] = score[pos - 1];
+            index[pos] = index[pos - 1];
+            pos--;
+        }
+        score[pos] = scores[c];
+        index[pos] = c;
+    }
+}
+
+// copy the last N_SAMPLES samples from ring into window, oldest first
+static void copy_window(sound_stream_t *stream)
+{
+    int pos = (int)(stream->total % N_SAMPLES);
+    memcpy(stream->window, stream->ring + pos, (N_SAMPLES - pos) * sizeof(float));
+    memcpy(stream->window + N_SAMPLES - pos, stream->ring, pos * sizeof(float));
+}
+
+static void end_event(sound_stream_t *stream, int c)
+{
+    stream->active[c] = false;
+    if (stream->callback != NULL)
+    {
+        stream->callback(stream->userdata, &stream->events[c]);
+    }
+}
+
+// window covers [end - CHUNK_LENGTH, end] seconds
+static int process_window(sound_stream_t *stream, float end)
+{
+    int ret = run_yamnet_window(stream->app_ctx, stream->window, stream->mean_scores);
+    if (ret < 0)
+    {
+        return ret;
+    }
+
+    float alpha = stream->windows == 0 ? 1.0f : stream->config.smoothing;
+    for (int c = 0; c < LABEL_NUM; c++)
+    {
+        stream->scores[c] = alpha * stream->mean_scores[c] + (1.0f - alpha) * stream->scores[c];
+    }
+    stream->windows++;
+
+    int top[STREAM_TOP_K];
+    float top_score[STREAM_TOP_K];
+    bool top_valid = false;
+    float start = end - CHUNK_LENGTH > 0 ? end - CHUNK_LENGTH : 0;
+    for (int c = 0; c < LABEL_NUM; c++)
+    {
+        float s = stream->scores[c];
+        sound_event_t *event = &stream->events[c];
+        if (!stream->active[c])
+        {
+            if (s < stream->config.on_threshold)
+            {
+                continue;
+            }
+            stream->active[c] = true;
+            event->index = c;
+            event->start = start;
+            event->peak = -1.0f;
+        }
+        else if (s < stream->config.off_threshold)
+        {
+            end_event(stream, c);
+            continue;
+        }
+        event->end = end;
+        if (s > event->peak)
+        {
+            if (!top_valid)
+            {
+                top_k(stream->scores, LABEL_NUM, top, top_score, STREAM_TOP_K);
+                top_valid = true;
+            }
+            event->peak = s;
+            memcpy(event->top, top, sizeof(top));
+            memcpy(event->top_score, top_score, sizeof(top_score));
+        }
+    }
+    return 0;
+}
+
+int init_sound_stream(sound_stream_t *stream, rknn_app_context_t *app_ctx, const sound_stream_config_t *config,
+                      sound_event_callback callback, void *userdata)
+{
+    memset(stream, 0, sizeof(sound_stream_t));
+    stream->app_ctx = app_ctx;
+    stream->callback = callback;
+    stream->userdata = userdata;
+    if (config != NULL)
+    {
+        stream->config = *config;
+    }
+    else
+    {
+        stream->config.smoothing = 0.5f;
+        stream->config.on_threshold = 0.4f;
+        stream->config.off_threshold = 0.25f;
+    }
+    if (stream->config.hop_seconds <= 0)
+    {
+        stream->config.hop_seconds = CHUNK_LENGTH / 2.0f;
+    }
+    stream->hop = (int)(stream->config.hop_seconds * SAMPLE_RATE);
+    if (stream->hop <= 0 || stream->hop > N_SAMPLES || stream->config.smoothing <= 0 || stream->config.smoothing > 1 ||
+        stream->config.off_threshold > stream->config.on_threshold)
+    {
+        printf("invalid sound stream config\n");
+        return -1;
+    }
+    stream->next_window_end = N_SAMPLES;
+
+    stream->ring = (float *)calloc(N_SAMPLES, sizeof(float));
+    stream->window = (float *)malloc(N_SAMPLES * sizeof(float));
+    if (stream->ring == NULL || stream->window == NULL)
+    {
+        printf("malloc sound stream buffer fail!\n");
+        release_sound_stream(stream);
+        return -1;
+    }
+    return 0;
+}
+
+void release_sound_stream(sound_stream_t *stream)
+{
+    if (stream->ring != NULL)
+    {
+        free(stream->ring);
+        stream->ring = NULL;
+    }
+    if (stream->window != NULL)
+    {
+        free(stream->window);
+        stream->window = NULL;
+    }
+}
+
+int sound_stream_push(sound_stream_t *stream, const float *pcm, int n)
+{
+    while (n > 0)
+    {
+        // never write past the end of the next window, its samples would be overwritten
+        long long room = stream->next_window_end - stream->total;
+        int m = n < room ? n : (int)room;
+        int pos = (int)(stream->total % N_SAMPLES);
+        int first = m < N_SAMPLES - pos ? m : N_SAMPLES - pos;
+        memcpy(stream->ring + pos, pcm, first * sizeof(float));
+        memcpy(stream->ring, pcm + first, (m - first) * sizeof(float));
+        stream->total += m;
+        pcm += m;
+        n -= m;
+
+        if (stream->total == stream->next_window_end)
+        {
+            copy_window(stream);
+            int ret = process_window(stream, (float)stream->total / SAMPLE_RATE);
+            if (ret < 0)
+            {
+                return ret;
+            }
+            stream->next_window_end += stream->hop;
+        }
+    }
+    return 0;
+}
+
+int sound_stream_flush(sound_stream_t *stream)
+{
+    float end = (float)stream->total / SAMPLE_RATE;
+    long long last_window_end = stream->next_window_end - stream->hop;
+    if (stream->total > last_window_end || (stream->windows == 0 && stream->total > 0))
+    {
+        if (stream->total < N_SAMPLES)
+        {
+            // short stream, zero padded like audio_preprocess
+            memcpy(stream->window, stream->ring, stream->total * sizeof(float));
+            memset(stream->window + stream->total, 0, (N_SAMPLES - stream->total) * sizeof(float));
+        }
+        else
+        {
+            copy_window(stream);
+        }
+        int ret = process_window(stream, end);
+        if (ret < 0)
+        {
+            return ret;
+        }
+    }
+    for (int c = 0; c < LABEL_NUM; c++)
+    {
+        if (stream->active[c])
+        {
+            stream->events[c].end = end;
+            end_event(stream, c);
+        }
+    }
+    return 0;
+}
+
+void sound_stream_top_k(const sound_stream_t *stream, int *index, float *score, int k)
+{
+    top_k(stream->scores, LABEL_NUM, index, score, k);
+}
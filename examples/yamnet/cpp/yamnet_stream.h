@@ -0,0 +1,112 @@
+#ifndef _RKNN_DEMO_YAMNET_STREAM_H_
+#define _RKNN_DEMO_YAMNET_STREAM_H_
+
+#include "yamnet.h"
+
+#define STREAM_TOP_K 3
+
+/**
+ * @brief Streaming classifier config
+ *
+ */
+typedef struct
+{
+    float hop_seconds;   // time between two windows, (0, CHUNK_LENGTH], <= 0: CHUNK_LENGTH / 2
+    float smoothing;     // weight of the newest window in the running class scores, (0, 1]
+    float on_threshold;  // running score at which a class becomes active
+    float off_threshold; // running score below which an active class ends, <= on_threshold
+} sound_stream_config_t;
+
+/**
+ * @brief Sound event, one class being active over a time range
+ *
+ */
+typedef struct
+{
+    int index;                     // class
+    float start;                   // seconds from stream start
+    float end;                     // seconds from stream start
+    float peak;                    // highest running score of the class
+    int top[STREAM_TOP_K];         // top classes when the peak was reached
+    float top_score[STREAM_TOP_K];
+} sound_event_t;
+
+/**
+ * @brief Called when a sound event ends
+ *
+ * @param userdata [in] User data passed to init_sound_stream
+ * @param event [in] Finished event
+ */
+typedef void (*sound_event_callback)(void *userdata, const sound_event_t *event);
+
+/**
+ * @brief Streaming classifier, memory does not grow with stream length
+ *
+ */
+typedef struct
+{
+    rknn_app_context_t *app_ctx;
+    sound_stream_config_t config;
+    sound_event_callback callback;
+    void *userdata;
+    float *ring;              // last N_SAMPLES samples
+    float *window;            // model input
+    long long total;          // samples pushed
+    long long next_window_end;
+    int hop;
+    int windows;              // windows run
+    float mean_scores[LABEL_NUM];
+    float scores[LABEL_NUM];  // running class scores
+    bool active[LABEL_NUM];
+    sound_event_t events[LABEL_NUM]; // event in progress of each active class
+} sound_stream_t;
+
+/**
+ * @brief Create streaming classifier
+ *
+ * @param stream [out] Stream
+ * @param app_ctx [in] Model context, must outlive the stream
+ * @param config [in] Config, NULL: defaults
+ * @param callback [in] Event callback
+ * @param userdata [in] User data for callback
+ * @return int 0: success; -1: error
+ */
+int init_sound_stream(sound_stream_t *stream, rknn_app_context_t *app_ctx, const sound_stream_config_t *config,
+                      sound_event_callback callback, void *userdata);
+
+/**
+ * @brief Release streaming classifier
+ *
+ * @param stream [in] Stream
+ */
+void release_sound_stream(sound_stream_t *stream);
+
+/**
+ * @brief Push mono SAMPLE_RATE samples, runs the model for every hop completed by them
+ *
+ * @param stream [in] Stream
+ * @param pcm [in] Samples
+ * @param n [in] Sample count, any size
+ * @return int 0: success; < 0: error
+ */
+int sound_stream_push(sound_stream_t *stream, const float *pcm, int n);
+
+/**
+ * @brief Classify the samples after the last window and end all active events
+ *
+ * @param stream [in] Stream
+ * @return int 0: success; < 0: error
+ */
+int sound_stream_flush(sound_stream_t *stream);
+
+/**
+ * @brief Current top classes by running score
+ *
+ * @param stream [in] Stream
+ * @param index [out] k classes, highest first
+ * @param score [out] k running scores
+ * @param k [in] Class count, <= LABEL_NUM
+ */
+void sound_stream_top_k(const sound_stream_t *stream, int *index, float *score, int k);
+
+#endif //_RKNN_DEMO_YAMNET_STREAM_H_
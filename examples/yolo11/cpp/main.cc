@@ -24,9 +24,10 @@
 #include "image_utils.h"
 #include "file_utils.h"
 #include "image_drawing.h"
+#include "trace_utils.h"
 
 #if defined(RV1106_1103) 
-    #include "dma_alloc.hpp"
+    #include "dma_pool.h"
 #endif
 
 /*-------------------------------------------
@@ -44,9 +45,19 @@ int main(int argc, char **argv)
     const char *image_path = argv[2];
 
     int ret;
+    // set to write a trace for chrome://tracing or ui.perfetto.dev
+    const char *trace_path = getenv("RKNN_TRACE_JSON");
     rknn_app_context_t rknn_app_ctx;
     memset(&rknn_app_ctx, 0, sizeof(rknn_app_context_t));
+#if defined(RV1106_1103) 
+    dma_pool_t* dma_pool = NULL;
+    dma_buffer_t* img_dma_buf = NULL;
+#endif
 
+    if (trace_path != NULL)
+    {
+        trace_set_event_capture(1);
+    }
     init_post_process();
 
     ret = init_yolo11_model(model_path, &rknn_app_ctx);
@@ -60,24 +71,23 @@ int main(int argc, char **argv)
     memset(&src_image, 0, sizeof(image_buffer_t));
     ret = read_image(image_path, &src_image);
 
-#if defined(RV1106_1103) 
-    //RV1106 rga requires that input and output bufs are memory allocated by dma
-    ret = dma_buf_alloc(RV1106_CMA_HEAP_PATH, src_image.size, &rknn_app_ctx.img_dma_buf.dma_buf_fd, 
-                       (void **) & (rknn_app_ctx.img_dma_buf.dma_buf_virt_addr));
-    memcpy(rknn_app_ctx.img_dma_buf.dma_buf_virt_addr, src_image.virt_addr, src_image.size);
-    dma_sync_cpu_to_device(rknn_app_ctx.img_dma_buf.dma_buf_fd);
-    free(src_image.virt_addr);
-    src_image.virt_addr = (unsigned char *)rknn_app_ctx.img_dma_buf.dma_buf_virt_addr;
-    src_image.fd = rknn_app_ctx.img_dma_buf.dma_buf_fd;
-    rknn_app_ctx.img_dma_buf.size = src_image.size;
-#endif
-    
     if (ret != 0)
     {
         printf("read image fail! ret=%d image_path=%s\n", ret, image_path);
         goto out;
     }
 
+#if defined(RV1106_1103) 
+    //RV1106 rga requires that input and output bufs are memory allocated by dma
+    dma_pool = create_dma_pool(NULL, 0);
+    img_dma_buf = dma_pool != NULL ? move_image_to_dma_buffer(dma_pool, &src_image) : NULL;
+    if (img_dma_buf == NULL)
+    {
+        ret = -1;
+        goto out;
+    }
+#endif
+
     object_detect_result_list od_results;
 
     ret = inference_yolo11_model(&rknn_app_ctx, &src_image, &od_results);
@@ -121,12 +131,27 @@ out:
     if (src_image.virt_addr != NULL)
     {
 #if defined(RV1106_1103) 
-        dma_buf_free(rknn_app_ctx.img_dma_buf.size, &rknn_app_ctx.img_dma_buf.dma_buf_fd, 
-                rknn_app_ctx.img_dma_buf.dma_buf_virt_addr);
+        if (img_dma_buf != NULL)
+        {
+            release_dma_buffer(img_dma_buf);
+        }
+        else
+        {
+            free(src_image.virt_addr);
+        }
 #else
         free(src_image.virt_addr);
 #endif
     }
+#if defined(RV1106_1103) 
+    destroy_dma_pool(dma_pool);
+#endif
+
+    trace_print_stats();
+    if (trace_path != NULL)
+    {
+        trace_write_json(trace_path);
+    }
 
     return 0;
 }
@@ -20,7 +20,9 @@
 #include "yolo11.h"
 #include "common.h"
 #include "file_utils.h"
+#include "model_registry.h"
 #include "image_utils.h"
+#include "trace_utils.h"
 
 static void dump_tensor_attr(rknn_tensor_attr *attr)
 {
@@ -34,23 +36,13 @@ static void dump_tensor_attr(rknn_tensor_attr *attr)
 int init_yolo11_model(const char *model_path, rknn_app_context_t *app_ctx)
 {
     int ret;
-    int model_len = 0;
-    char *model;
     rknn_context ctx = 0;
 
     // Load RKNN Model
-    model_len = read_data_from_file(model_path, &model);
-    if (model == NULL)
-    {
-        printf("load_model fail!\n");
-        return -1;
-    }
-
-    ret = rknn_init(&ctx, model, model_len, 0);
-    free(model);
+    ret = acquire_model_context(model_path, 0, &ctx);
     if (ret < 0)
     {
-        printf("rknn_init fail! ret=%d\n", ret);
+        printf("acquire_model_context fail! ret=%d\n", ret);
         return -1;
     }
 
@@ -149,7 +141,7 @@ int release_yolo11_model(rknn_app_context_t *app_ctx)
     }
     if (app_ctx->rknn_ctx != 0)
     {
-        rknn_destroy(app_ctx->rknn_ctx);
+        release_model_context(app_ctx->rknn_ctx);
         app_ctx->rknn_ctx = 0;
     }
     return 0;
@@ -204,7 +196,10 @@ int inference_yolo11_model(rknn_app_context_t *app_ctx, image_buffer_t *img, obj
     inputs[0].size = app_ctx->model_width * app_ctx->model_height * app_ctx->model_channel;
     inputs[0].buf = dst_img.virt_addr;
 
-    ret = rknn_inputs_set(app_ctx->rknn_ctx, app_ctx->io_num.n_input, inputs);
+    {
+        TRACE_ZONE(TRACE_STAGE_INPUTS_SET, "rknn_inputs_set");
+        ret = rknn_inputs_set(app_ctx->rknn_ctx, app_ctx->io_num.n_input, inputs);
+    }
     if (ret < 0)
     {
         printf("rknn_input_set fail! ret=%d\n", ret);
@@ -212,8 +207,11 @@ int inference_yolo11_model(rknn_app_context_t *app_ctx, image_buffer_t *img, obj
     }
 
     // Run
-    printf("rknn_run\n");
-    ret = rknn_run(app_ctx->rknn_ctx, nullptr);
+    TRACE_LOG("rknn_run\n");
+    {
+        TRACE_ZONE(TRACE_STAGE_RUN, "rknn_run");
+        ret = rknn_run(app_ctx->rknn_ctx, nullptr);
+    }
     if (ret < 0)
     {
         printf("rknn_run fail! ret=%d\n", ret);
@@ -227,7 +225,10 @@ int inference_yolo11_model(rknn_app_context_t *app_ctx, image_buffer_t *img, obj
         outputs[i].index = i;
         outputs[i].want_float = (!app_ctx->is_quant);
     }
-    ret = rknn_outputs_get(app_ctx->rknn_ctx, app_ctx->io_num.n_output, outputs, NULL);
+    {
+        TRACE_ZONE(TRACE_STAGE_OUTPUTS_GET, "rknn_outputs_get");
+        ret = rknn_outputs_get(app_ctx->rknn_ctx, app_ctx->io_num.n_output, outputs, NULL);
+    }
     if (ret < 0)
     {
         printf("rknn_outputs_get fail! ret=%d\n", ret);
@@ -235,7 +236,10 @@ int inference_yolo11_model(rknn_app_context_t *app_ctx, image_buffer_t *img, obj
     }
 
     // Post Process
-    post_process(app_ctx, outputs, &letter_box, box_conf_threshold, nms_threshold, od_results);
+    {
+        TRACE_ZONE(TRACE_STAGE_POSTPROCESS, "post_process");
+        post_process(app_ctx, outputs, &letter_box, box_conf_threshold, nms_threshold, od_results);
+    }
 
     // Remeber to release rknn output
     rknn_outputs_release(app_ctx->rknn_ctx, app_ctx->io_num.n_output, outputs);
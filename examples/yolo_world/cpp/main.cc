@@ -24,6 +24,7 @@
 #include "file_utils.h"
 #include "image_utils.h"
 #include "image_drawing.h"
+#include "trace_utils.h"
 
 
 /*-------------------------------------------
@@ -43,11 +44,17 @@ int main(int argc, char **argv)
     const char *img_path = argv[4];
 
     int ret;
+    // set to write a trace for chrome://tracing or ui.perfetto.dev
+    const char *trace_path = getenv("RKNN_TRACE_JSON");
     rknn_clip_context rknn_clip_ctx;
     rknn_app_context_t rknn_yolo_world_ctx;
     memset(&rknn_clip_ctx, 0, sizeof(rknn_clip_context));
     memset(&rknn_yolo_world_ctx, 0, sizeof(rknn_app_context_t));
 
+    if (trace_path != NULL)
+    {
+        trace_set_event_capture(1);
+    }
     printf("--> init clip text model\n");
     ret = init_clip_text_model(&rknn_clip_ctx, text_model_path);
     if (ret != 0)
@@ -154,5 +161,11 @@ out:
     }
 
 
+    trace_print_stats();
+    if (trace_path != NULL)
+    {
+        trace_write_json(trace_path);
+    }
+
     return 0;
 }
@@ -20,6 +20,7 @@
 #include "clip_text.h"
 #include "common.h"
 #include "file_utils.h"
+#include "model_registry.h"
 #include "clip_tokenizer.h"
 
 
@@ -43,10 +44,10 @@ int init_clip_text_model(rknn_clip_context* clip_ctx, const char* model_path)
     rknn_context ctx = 0;
 
     // Load RKNN Model
-    ret = rknn_init(&ctx, (char*)model_path, 0, 0, NULL);
+    ret = acquire_model_context(model_path, 0, &ctx);
     if (ret < 0)
     {
-        printf("rknn_init fail ret=%d\n", ret);
+        printf("acquire_model_context fail! ret=%d\n", ret);
         return -1;
     }
 
@@ -117,7 +118,7 @@ int release_clip_text_model(rknn_clip_context* clip_ctx)
     }
     if (clip_ctx->rknn_ctx != 0)
     {
-        rknn_destroy(clip_ctx->rknn_ctx);
+        release_model_context(clip_ctx->rknn_ctx);
         clip_ctx->rknn_ctx = 0;
     }
     return 0;
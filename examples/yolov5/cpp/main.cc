@@ -24,29 +24,86 @@
 #include "image_utils.h"
 #include "file_utils.h"
 #include "image_drawing.h"
+#include "trace_utils.h"
+#include "model_registry.h"
+
+#include <thread>
+#include <vector>
 
 #if defined(RV1106_1103) 
-    #include "dma_alloc.hpp"
+    #include "dma_pool.h"
 #endif
 
+// N contexts of the model without running it: dup contexts, shared weight contexts, private contexts
+static int print_footprints(const char *model_path, int instances)
+{
+    struct
+    {
+        const char *name;
+        uint32_t flag;
+        int shared;
+    } modes[] = {
+        {"rknn_dup_context", 0, 1},
+#ifdef RKNN_FLAG_SHARE_WEIGHT_MEM
+        {"RKNN_FLAG_SHARE_WEIGHT_MEM", RKNN_FLAG_SHARE_WEIGHT_MEM, 1},
+#endif
+        {"private rknn_init", 0, 0},
+    };
+    int ret = 0;
+    for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); i++)
+    {
+        model_footprint_t footprint;
+        printf("%d contexts, %s:\n", instances, modes[i].name);
+        if (measure_model_footprint(model_path, instances, modes[i].flag, modes[i].shared, &footprint) != 0)
+        {
+            ret = -1;
+            continue;
+        }
+        print_model_footprint(&footprint);
+    }
+    return ret;
+}
+
 /*-------------------------------------------
                   Main Function
 -------------------------------------------*/
 int main(int argc, char **argv)
 {
-    if (argc != 3)
+    if (argc == 4 && strcmp(argv[2], "--footprint") == 0)
     {
-        printf("%s <model_path> <image_path>\n", argv[0]);
+        return print_footprints(argv[1], atoi(argv[3]));
+    }
+    if (argc != 3 && argc != 4)
+    {
+        printf("%s <model_path> <image_path> [instances]\n", argv[0]);
+        printf("%s <model_path> --footprint <instances>\n", argv[0]);
         return -1;
     }
 
     const char *model_path = argv[1];
     const char *image_path = argv[2];
+    // extra contexts of the same model share its weights, one inference thread each
+    int instances = argc == 4 ? atoi(argv[3]) : 1;
 
     int ret;
+    // set to write a trace for chrome://tracing or ui.perfetto.dev
+    const char *trace_path = getenv("RKNN_TRACE_JSON");
     rknn_app_context_t rknn_app_ctx;
     memset(&rknn_app_ctx, 0, sizeof(rknn_app_context_t));
+#if defined(RV1106_1103) 
+    dma_pool_t* dma_pool = NULL;
+    dma_buffer_t* img_dma_buf = NULL;
+#endif
+    std::vector<rknn_app_context_t> extra_ctx(instances > 1 ? instances - 1 : 0);
+    for (size_t i = 0; i < extra_ctx.size(); i++)
+    {
+        memset(&extra_ctx[i], 0, sizeof(rknn_app_context_t));
+    }
 
+    if (trace_path != NULL)
+    {
+        trace_set_event_capture(1);
+    }
     init_post_process();
 
     ret = init_yolov5_model(model_path, &rknn_app_ctx);
@@ -55,32 +112,66 @@ int main(int argc, char **argv)
         printf("init_yolov5_model fail! ret=%d model_path=%s\n", ret, model_path);
         goto out;
     }
+    for (size_t i = 0; i < extra_ctx.size(); i++)
+    {
+        ret = init_yolov5_model(model_path, &extra_ctx[i]);
+        if (ret != 0)
+        {
+            printf("init_yolov5_model fail! ret=%d instance=%d\n", ret, (int)i + 1);
+            goto out;
+        }
+    }
+    if (instances > 1)
+    {
+        model_footprint_t footprint;
+        if (get_model_footprint(rknn_app_ctx.rknn_ctx, &footprint) == 0)
+        {
+            print_model_footprint(&footprint);
+        }
+    }
 
     image_buffer_t src_image;
     memset(&src_image, 0, sizeof(image_buffer_t));
     ret = read_image(image_path, &src_image);
 
-#if defined(RV1106_1103) 
-    //RV1106 rga requires that input and output bufs are memory allocated by dma
-    ret = dma_buf_alloc(RV1106_CMA_HEAP_PATH, src_image.size, &rknn_app_ctx.img_dma_buf.dma_buf_fd, 
-                       (void **) & (rknn_app_ctx.img_dma_buf.dma_buf_virt_addr));
-    memcpy(rknn_app_ctx.img_dma_buf.dma_buf_virt_addr, src_image.virt_addr, src_image.size);
-    dma_sync_cpu_to_device(rknn_app_ctx.img_dma_buf.dma_buf_fd);
-    free(src_image.virt_addr);
-    src_image.virt_addr = (unsigned char *)rknn_app_ctx.img_dma_buf.dma_buf_virt_addr;
-    src_image.fd = rknn_app_ctx.img_dma_buf.dma_buf_fd;
-    rknn_app_ctx.img_dma_buf.size = src_image.size;
-#endif
-
     if (ret != 0)
     {
         printf("read image fail! ret=%d image_path=%s\n", ret, image_path);
         goto out;
     }
 
+#if defined(RV1106_1103) 
+    //RV1106 rga requires that input and output bufs are memory allocated by dma
+    dma_pool = create_dma_pool(NULL, 0);
+    img_dma_buf = dma_pool != NULL ? move_image_to_dma_buffer(dma_pool, &src_image) : NULL;
+    if (img_dma_buf == NULL)
+    {
+        ret = -1;
+        goto out;
+    }
+#endif
+
     object_detect_result_list od_results;
 
-    ret = inference_yolov5_model(&rknn_app_ctx, &src_image, &od_results);
+    if (!extra_ctx.empty())
+    {
+        std::vector<std::thread> threads;
+        std::vector<object_detect_result_list> extra_results(extra_ctx.size());
+        for (size_t i = 0; i < extra_ctx.size(); i++)
+        {
+            threads.push_back(std::thread(inference_yolov5_model, &extra_ctx[i], &src_image, &extra_results[i]));
+        }
+        ret = inference_yolov5_model(&rknn_app_ctx, &src_image, &od_results);
+        for (size_t i = 0; i < threads.size(); i++)
+        {
+            threads[i].join();
+            printf("instance %d: %d objects\n", (int)i + 1, extra_results[i].count);
+        }
+    }
+    else
+    {
+        ret = inference_yolov5_model(&rknn_app_ctx, &src_image, &od_results);
+    }
     if (ret != 0)
     {
         printf("init_yolov5_model fail! ret=%d\n", ret);
@@ -112,6 +203,11 @@ int main(int argc, char **argv)
 out:
     deinit_post_process();
 
+    for (size_t i = 0; i < extra_ctx.size(); i++)
+    {
+        release_yolov5_model(&extra_ctx[i]);
+    }
+
     ret = release_yolov5_model(&rknn_app_ctx);
     if (ret != 0)
     {
@@ -121,12 +217,27 @@ out:
     if (src_image.virt_addr != NULL)
     {
 #if defined(RV1106_1103) 
-        dma_buf_free(rknn_app_ctx.img_dma_buf.size, &rknn_app_ctx.img_dma_buf.dma_buf_fd, 
-                rknn_app_ctx.img_dma_buf.dma_buf_virt_addr);
+        if (img_dma_buf != NULL)
+        {
+            release_dma_buffer(img_dma_buf);
+        }
+        else
+        {
+            free(src_image.virt_addr);
+        }
 #else
         free(src_image.virt_addr);
 #endif
     }
+#if defined(RV1106_1103) 
+    destroy_dma_pool(dma_pool);
+#endif
+
+    trace_print_stats();
+    if (trace_path != NULL)
+    {
+        trace_write_json(trace_path);
+    }
 
     return 0;
 }
@@ -20,6 +20,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/time.h>
+#include "yolo_head.h"
 
 #include <set>
 #include <vector>
@@ -185,266 +186,6 @@ static float sigmoid(float x) { return 1.0 / (1.0 + expf(-x)); }
 
 static float unsigmoid(float y) { return -1.0 * logf((1.0 / y) - 1.0); }
 
-inline static int32_t __clip(float val, float min, float max)
-{
-    float f = val <= min ? min : (val >= max ? max : val);
-    return f;
-}
-
-static int8_t qnt_f32_to_affine(float f32, int32_t zp, float scale)
-{
-    float dst_val = (f32 / scale) + zp;
-    int8_t res = (int8_t)__clip(dst_val, -128, 127);
-    return res;
-}
-
-static uint8_t qnt_f32_to_affine_u8(float f32, int32_t zp, float scale)
-{
-    float dst_val = (f32 / scale) + zp;
-    uint8_t res = (uint8_t)__clip(dst_val, 0, 255);
-    return res;
-}
-
-static float deqnt_affine_to_f32(int8_t qnt, int32_t zp, float scale) { return ((float)qnt - (float)zp) * scale; }
-static float deqnt_affine_u8_to_f32(uint8_t qnt, int32_t zp, float scale) { return ((float)qnt - (float)zp) * scale; }
-
-static int process_u8(uint8_t *input, int *anchor, int grid_h, int grid_w, int height, int width, int stride,
-                      std::vector<float> &boxes, std::vector<float> &objProbs, std::vector<int> &classId, float threshold,
-                      int32_t zp, float scale)
-{
-    int validCount = 0;
-    int grid_len = grid_h * grid_w;
-    uint8_t thres_u8 = qnt_f32_to_affine_u8(threshold, zp, scale);
-    for (int a = 0; a < 3; a++)
-    {
-        for (int i = 0; i < grid_h; i++)
-        {
-            for (int j = 0; j < grid_w; j++)
-            {
-                uint8_t box_confidence = input[(PROP_BOX_SIZE * a + 4) * grid_len + i * grid_w + j];
-                if (box_confidence >= thres_u8)
-                {
-                    int offset = (PROP_BOX_SIZE * a) * grid_len + i * grid_w + j;
-                    uint8_t *in_ptr = input + offset;
-                    float box_x = (deqnt_affine_u8_to_f32(*in_ptr, zp, scale)) * 2.0 - 0.5;
-                    float box_y = (deqnt_affine_u8_to_f32(in_ptr[grid_len], zp, scale)) * 2.0 - 0.5;
-                    float box_w = (deqnt_affine_u8_to_f32(in_ptr[2 * grid_len], zp, scale)) * 2.0;
-                    float box_h = (deqnt_affine_u8_to_f32(in_ptr[3 * grid_len], zp, scale)) * 2.0;
-                    box_x = (box_x + j) * (float)stride;
-                    box_y = (box_y + i) * (float)stride;
-                    box_w = box_w * box_w * (float)anchor[a * 2];
-                    box_h = box_h * box_h * (float)anchor[a * 2 + 1];
-                    box_x -= (box_w / 2.0);
-                    box_y -= (box_h / 2.0);
-
-                    uint8_t maxClassProbs = in_ptr[5 * grid_len];
-                    int maxClassId = 0;
-                    for (int k = 1; k < OBJ_CLASS_NUM; ++k)
-                    {
-                        uint8_t prob = in_ptr[(5 + k) * grid_len];
-                        if (prob > maxClassProbs)
-                        {
-                            maxClassId = k;
-                            maxClassProbs = prob;
-                        }
-                    }
-                    float limit_score = (deqnt_affine_u8_to_f32(maxClassProbs, zp, scale)) * (deqnt_affine_u8_to_f32(box_confidence, zp, scale));
-                    if (limit_score >= threshold)
-                    {
-                        objProbs.push_back(limit_score);
-                        classId.push_back(maxClassId);
-                        validCount++;
-                        boxes.push_back(box_x);
-                        boxes.push_back(box_y);
-                        boxes.push_back(box_w);
-                        boxes.push_back(box_h);
-                    }
-                }
-            }
-        }
-    }
-    return validCount;
-}
-
-static int process_i8(int8_t *input, int *anchor, int grid_h, int grid_w, int height, int width, int stride,
-                      std::vector<float> &boxes, std::vector<float> &objProbs, std::vector<int> &classId, float threshold,
-                      int32_t zp, float scale)
-{
-    int validCount = 0;
-    int grid_len = grid_h * grid_w;
-    int8_t thres_i8 = qnt_f32_to_affine(threshold, zp, scale);
-    for (int a = 0; a < 3; a++)
-    {
-        for (int i = 0; i < grid_h; i++)
-        {
-            for (int j = 0; j < grid_w; j++)
-            {
-                int8_t box_confidence = input[(PROP_BOX_SIZE * a + 4) * grid_len + i * grid_w + j];
-                if (box_confidence >= thres_i8)
-                {
-                    int offset = (PROP_BOX_SIZE * a) * grid_len + i * grid_w + j;
-                    int8_t *in_ptr = input + offset;
-                    float box_x = (deqnt_affine_to_f32(*in_ptr, zp, scale)) * 2.0 - 0.5;
-                    float box_y = (deqnt_affine_to_f32(in_ptr[grid_len], zp, scale)) * 2.0 - 0.5;
-                    float box_w = (deqnt_affine_to_f32(in_ptr[2 * grid_len], zp, scale)) * 2.0;
-                    float box_h = (deqnt_affine_to_f32(in_ptr[3 * grid_len], zp, scale)) * 2.0;
-                    box_x = (box_x + j) * (float)stride;
-                    box_y = (box_y + i) * (float)stride;
-                    box_w = box_w * box_w * (float)anchor[a * 2];
-                    box_h = box_h * box_h * (float)anchor[a * 2 + 1];
-                    box_x -= (box_w / 2.0);
-                    box_y -= (box_h / 2.0);
-
-                    int8_t maxClassProbs = in_ptr[5 * grid_len];
-                    int maxClassId = 0;
-                    for (int k = 1; k < OBJ_CLASS_NUM; ++k)
-                    {
-                        int8_t prob = in_ptr[(5 + k) * grid_len];
-                        if (prob > maxClassProbs)
-                        {
-                            maxClassId = k;
-                            maxClassProbs = prob;
-                        }
-                    }
-                    float limit_score = (deqnt_affine_to_f32(maxClassProbs, zp, scale)) * (deqnt_affine_to_f32(box_confidence, zp, scale));
-                    if (limit_score >= threshold)
-                    {
-                        objProbs.push_back(limit_score);
-                        classId.push_back(maxClassId);
-                        validCount++;
-                        boxes.push_back(box_x);
-                        boxes.push_back(box_y);
-                        boxes.push_back(box_w);
-                        boxes.push_back(box_h);
-                    }
-                }
-            }
-        }
-    }
-    return validCount;
-}
-
-static int process_i8_rv1106(int8_t *input, int *anchor, int grid_h, int grid_w, int height, int width, int stride,
-                      std::vector<float> &boxes, std::vector<float> &boxScores, std::vector<int> &classId, float threshold,
-                      int32_t zp, float scale) {
-    int validCount = 0;
-    int8_t thres_i8 = qnt_f32_to_affine(threshold, zp, scale);
-
-    int anchor_per_branch = 3;
-    int align_c = PROP_BOX_SIZE * anchor_per_branch;
-
-    for (int h = 0; h < grid_h; h++) {
-        for (int w = 0; w < grid_w; w++) {
-            for (int a = 0; a < anchor_per_branch; a++) {
-                int hw_offset = h * grid_w * align_c + w * align_c + a * PROP_BOX_SIZE;
-                int8_t *hw_ptr = input + hw_offset;
-                int8_t box_confidence = hw_ptr[4];
-
-                if (box_confidence >= thres_i8) {
-                    int8_t maxClassProbs = hw_ptr[5];
-                    int maxClassId = 0;
-                    for (int k = 1; k < OBJ_CLASS_NUM; ++k) {
-                        int8_t prob = hw_ptr[5 + k];
-                        if (prob > maxClassProbs) {
-                            maxClassId = k;
-                            maxClassProbs = prob;
-                        }
-                    }
-
-                    float box_conf_f32 = deqnt_affine_to_f32(box_confidence, zp, scale);
-                    float class_prob_f32 = deqnt_affine_to_f32(maxClassProbs, zp, scale);
-                    float limit_score = box_conf_f32 * class_prob_f32;
-
-                    if (limit_score > threshold) {
-                        float box_x, box_y, box_w, box_h;
-
-                        box_x = deqnt_affine_to_f32(hw_ptr[0], zp, scale) * 2.0 - 0.5;
-                        box_y = deqnt_affine_to_f32(hw_ptr[1], zp, scale) * 2.0 - 0.5;
-                        box_w = deqnt_affine_to_f32(hw_ptr[2], zp, scale) * 2.0;
-                        box_h = deqnt_affine_to_f32(hw_ptr[3], zp, scale) * 2.0;
-                        box_w = box_w * box_w;
-                        box_h = box_h * box_h;
-
-
-                        box_x = (box_x + w) * (float)stride;
-                        box_y = (box_y + h) * (float)stride;
-                        box_w *= (float)anchor[a * 2];
-                        box_h *= (float)anchor[a * 2 + 1];
-
-                        box_x -= (box_w / 2.0);
-                        box_y -= (box_h / 2.0);
-
-                        boxes.push_back(box_x);
-                        boxes.push_back(box_y);
-                        boxes.push_back(box_w);
-                        boxes.push_back(box_h);
-                        boxScores.push_back(limit_score);
-                        classId.push_back(maxClassId);
-                        validCount++;
-                    }
-                }
-            }
-        }
-    }
-    return validCount;
-}
-
-static int process_fp32(float *input, int *anchor, int grid_h, int grid_w, int height, int width, int stride,
-                        std::vector<float> &boxes, std::vector<float> &objProbs, std::vector<int> &classId, float threshold)
-{
-    int validCount = 0;
-    int grid_len = grid_h * grid_w;
-
-    for (int a = 0; a < 3; a++)
-    {
-        for (int i = 0; i < grid_h; i++)
-        {
-            for (int j = 0; j < grid_w; j++)
-            {
-                float box_confidence = input[(PROP_BOX_SIZE * a + 4) * grid_len + i * grid_w + j];
-                if (box_confidence >= threshold)
-                {
-                    int offset = (PROP_BOX_SIZE * a) * grid_len + i * grid_w + j;
-                    float *in_ptr = input + offset;
-                    float box_x = *in_ptr * 2.0 - 0.5;
-                    float box_y = in_ptr[grid_len] * 2.0 - 0.5;
-                    float box_w = in_ptr[2 * grid_len] * 2.0;
-                    float box_h = in_ptr[3 * grid_len] * 2.0;
-                    box_x = (box_x + j) * (float)stride;
-                    box_y = (box_y + i) * (float)stride;
-                    box_w = box_w * box_w * (float)anchor[a * 2];
-                    box_h = box_h * box_h * (float)anchor[a * 2 + 1];
-                    box_x -= (box_w / 2.0);
-                    box_y -= (box_h / 2.0);
-
-                    float maxClassProbs = in_ptr[5 * grid_len];
-                    int maxClassId = 0;
-                    for (int k = 1; k < OBJ_CLASS_NUM; ++k)
-                    {
-                        float prob = in_ptr[(5 + k) * grid_len];
-                        if (prob > maxClassProbs)
-                        {
-                            maxClassId = k;
-                            maxClassProbs = prob;
-                        }
-                    }
-                    if (maxClassProbs > threshold)
-                    {
-                        objProbs.push_back(maxClassProbs * box_confidence);
-                        classId.push_back(maxClassId);
-                        validCount++;
-                        boxes.push_back(box_x);
-                        boxes.push_back(box_y);
-                        boxes.push_back(box_w);
-                        boxes.push_back(box_h);
-                    }
-                }
-            }
-        }
-    }
-    return validCount;
-}
-
 int post_process(rknn_app_context_t *app_ctx, void *outputs, letterbox_t *letter_box, float conf_threshold, float nms_threshold, object_detect_result_list *od_results)
 {
 #if defined(RV1106_1103) 
@@ -456,54 +197,57 @@ int post_process(rknn_app_context_t *app_ctx, void *outputs, letterbox_t *letter
     std::vector<float> objProbs;
     std::vector<int> classId;
     int validCount = 0;
-    int stride = 0;
-    int grid_h = 0;
-    int grid_w = 0;
     int model_in_w = app_ctx->model_width;
     int model_in_h = app_ctx->model_height;
+    yolo_head::grid_t grid;
 
     memset(od_results, 0, sizeof(object_detect_result_list));
 
     for (int i = 0; i < 3; i++)
     {
-
+        yolo_head::anchor_scheme<3> scheme(anchor[i]);
 #if defined(RV1106_1103) 
-        grid_h = app_ctx->output_attrs[i].dims[2];
-        grid_w = app_ctx->output_attrs[i].dims[3];
-        stride = model_in_h / grid_h;
+        grid.h = app_ctx->output_attrs[i].dims[2];
+        grid.w = app_ctx->output_attrs[i].dims[3];
+        grid.stride = model_in_h / grid.h;
         //RV1106 only support i8
         if (app_ctx->is_quant) {
-            validCount += process_i8((int8_t *)(_outputs[i]->virt_addr), (int *)anchor[i], grid_h, grid_w, model_in_h, model_in_w, stride, filterBoxes, objProbs,
-                                     classId, conf_threshold, app_ctx->output_attrs[i].zp, app_ctx->output_attrs[i].scale);
+            yolo_head::tensor_t<int8_t> output = {(int8_t *)_outputs[i]->virt_addr, app_ctx->output_attrs[i].zp, app_ctx->output_attrs[i].scale};
+            validCount += yolo_head::decode_head<OBJ_CLASS_NUM, yolo_head::nchw_layout>(scheme, output, grid, conf_threshold,
+                                                                                        filterBoxes, objProbs, classId);
         }
 #elif defined(RKNPU1)
         // NCHW reversed: WHCN
-        grid_h = app_ctx->output_attrs[i].dims[1];
-        grid_w = app_ctx->output_attrs[i].dims[0];
-        stride = model_in_h / grid_h;
+        grid.h = app_ctx->output_attrs[i].dims[1];
+        grid.w = app_ctx->output_attrs[i].dims[0];
+        grid.stride = model_in_h / grid.h;
         if (app_ctx->is_quant)
         {
-            validCount += process_u8((uint8_t *)_outputs[i].buf, (int *)anchor[i], grid_h, grid_w, model_in_h, model_in_w, stride, filterBoxes, objProbs,
-                                     classId, conf_threshold, app_ctx->output_attrs[i].zp, app_ctx->output_attrs[i].scale);
+            yolo_head::tensor_t<uint8_t> output = {(uint8_t *)_outputs[i].buf, app_ctx->output_attrs[i].zp, app_ctx->output_attrs[i].scale};
+            validCount += yolo_head::decode_head<OBJ_CLASS_NUM, yolo_head::nchw_layout>(scheme, output, grid, conf_threshold,
+                                                                                        filterBoxes, objProbs, classId);
         }
         else
         {
-            validCount += process_fp32((float *)_outputs[i].buf, (int *)anchor[i], grid_h, grid_w, model_in_h, model_in_w, stride, filterBoxes, objProbs,
-                                       classId, conf_threshold);
+            yolo_head::tensor_t<float> output = {(float *)_outputs[i].buf, 0, 1.0f};
+            validCount += yolo_head::decode_head<OBJ_CLASS_NUM, yolo_head::nchw_layout>(scheme, output, grid, conf_threshold,
+                                                                                        filterBoxes, objProbs, classId);
         }
 #else
-        grid_h = app_ctx->output_attrs[i].dims[2];
-        grid_w = app_ctx->output_attrs[i].dims[3];
-        stride = model_in_h / grid_h;
+        grid.h = app_ctx->output_attrs[i].dims[2];
+        grid.w = app_ctx->output_attrs[i].dims[3];
+        grid.stride = model_in_h / grid.h;
         if (app_ctx->is_quant)
         {
-            validCount += process_i8((int8_t *)_outputs[i].buf, (int *)anchor[i], grid_h, grid_w, model_in_h, model_in_w, stride, filterBoxes, objProbs,
-                                     classId, conf_threshold, app_ctx->output_attrs[i].zp, app_ctx->output_attrs[i].scale);
+            yolo_head::tensor_t<int8_t> output = {(int8_t *)_outputs[i].buf, app_ctx->output_attrs[i].zp, app_ctx->output_attrs[i].scale};
+            validCount += yolo_head::decode_head<OBJ_CLASS_NUM, yolo_head::nchw_layout>(scheme, output, grid, conf_threshold,
+                                                                                        filterBoxes, objProbs, classId);
         }
         else
         {
-            validCount += process_fp32((float *)_outputs[i].buf, (int *)anchor[i], grid_h, grid_w, model_in_h, model_in_w, stride, filterBoxes, objProbs,
-                                       classId, conf_threshold);
+            yolo_head::tensor_t<float> output = {(float *)_outputs[i].buf, 0, 1.0f};
+            validCount += yolo_head::decode_head<OBJ_CLASS_NUM, yolo_head::nchw_layout>(scheme, output, grid, conf_threshold,
+                                                                                        filterBoxes, objProbs, classId);
         }
 #endif
     }
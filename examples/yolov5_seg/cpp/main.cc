@@ -24,6 +24,7 @@
 #include "image_utils.h"
 #include "file_utils.h"
 #include "image_drawing.h"
+#include "trace_utils.h"
 #include <opencv2/opencv.hpp>
 
 /*-------------------------------------------
@@ -64,9 +65,15 @@ int main(int argc, char **argv)
     };
 
     int ret;
+    // set to write a trace for chrome://tracing or ui.perfetto.dev
+    const char *trace_path = getenv("RKNN_TRACE_JSON");
     rknn_app_context_t rknn_app_ctx;
     memset(&rknn_app_ctx, 0, sizeof(rknn_app_context_t));
 
+    if (trace_path != NULL)
+    {
+        trace_set_event_capture(1);
+    }
     init_post_process();
 
     ret = init_yolov5_seg_model(model_path, &rknn_app_ctx);
@@ -153,5 +160,11 @@ out:
         free(src_image.virt_addr);
     }
 
+    trace_print_stats();
+    if (trace_path != NULL)
+    {
+        trace_write_json(trace_path);
+    }
+
     return 0;
 }
@@ -30,6 +30,7 @@ typedef struct {
     int input_image_width;
     int input_image_height;
     bool is_quant;
+    struct seg_mask_engine* mask_engine;    // instance masks of this context, see mask_utils.h
 } rknn_app_context_t;
 
 #include "postprocess.h"
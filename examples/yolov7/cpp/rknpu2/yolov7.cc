@@ -20,8 +20,9 @@
 #include "yolov7.h"
 #include "common.h"
 #include "file_utils.h"
+#include "model_registry.h"
 #include "image_utils.h"
-#include "easy_timer.h"
+#include "trace_utils.h"
 
 static void dump_tensor_attr(rknn_tensor_attr *attr)
 {
@@ -35,23 +36,13 @@ static void dump_tensor_attr(rknn_tensor_attr *attr)
 int init_yolov7_model(const char *model_path, rknn_app_context_t *app_ctx)
 {
     int ret;
-    int model_len = 0;
-    char *model;
     rknn_context ctx = 0;
 
     // Load RKNN Model
-    model_len = read_data_from_file(model_path, &model);
-    if (model == NULL)
-    {
-        printf("load_model fail!\n");
-        return -1;
-    }
-
-    ret = rknn_init(&ctx, model, model_len, 0, NULL);
-    free(model);
+    ret = acquire_model_context(model_path, 0, &ctx);
     if (ret < 0)
     {
-        printf("rknn_init fail! ret=%d\n", ret);
+        printf("acquire_model_context fail! ret=%d\n", ret);
         return -1;
     }
 
@@ -150,7 +141,7 @@ int release_yolov7_model(rknn_app_context_t *app_ctx)
     }
     if (app_ctx->rknn_ctx != 0)
     {
-        rknn_destroy(app_ctx->rknn_ctx);
+        release_model_context(app_ctx->rknn_ctx);
         app_ctx->rknn_ctx = 0;
     }
     return 0;
@@ -166,8 +157,6 @@ int inference_yolov7_model(rknn_app_context_t *app_ctx, image_buffer_t *img, obj
     const float nms_threshold = NMS_THRESH;      // 默认的NMS阈值
     const float box_conf_threshold = BOX_THRESH; // 默认的置信度阈值
     int bg_color = 114;
-    TIMER timer;
-    timer.indent_set("");
 
     if ((!app_ctx) || !(img) || (!od_results))
     {
@@ -193,15 +182,12 @@ int inference_yolov7_model(rknn_app_context_t *app_ctx, image_buffer_t *img, obj
     }
 
     // letterbox
-    timer.tik();
     ret = convert_image_with_letterbox(img, &dst_img, &letter_box, bg_color);
     if (ret < 0)
     {
         printf("convert_image_with_letterbox fail! ret=%d\n", ret);
         return -1;
     }
-    timer.tok();
-    timer.print_time("convert_image_with_letterbox");
 
     // Set Input Data
     inputs[0].index = 0;
@@ -210,26 +196,26 @@ int inference_yolov7_model(rknn_app_context_t *app_ctx, image_buffer_t *img, obj
     inputs[0].size = app_ctx->model_width * app_ctx->model_height * app_ctx->model_channel;
     inputs[0].buf = dst_img.virt_addr;
 
-    timer.tik();
-    ret = rknn_inputs_set(app_ctx->rknn_ctx, app_ctx->io_num.n_input, inputs);
+    {
+        TRACE_ZONE(TRACE_STAGE_INPUTS_SET, "rknn_inputs_set");
+        ret = rknn_inputs_set(app_ctx->rknn_ctx, app_ctx->io_num.n_input, inputs);
+    }
     if (ret < 0)
     {
         printf("rknn_input_set fail! ret=%d\n", ret);
         return -1;
     }
-    timer.tok();
-    timer.print_time("rknn_inputs_set");
 
     // Run
-    timer.tik();
-    ret = rknn_run(app_ctx->rknn_ctx, nullptr);
+    {
+        TRACE_ZONE(TRACE_STAGE_RUN, "rknn_run");
+        ret = rknn_run(app_ctx->rknn_ctx, nullptr);
+    }
     if (ret < 0)
     {
         printf("rknn_run fail! ret=%d\n", ret);
         return -1;
     }
-    timer.tok();
-    timer.print_time("rknn_run");
 
     // Get Output
     memset(outputs, 0, sizeof(outputs));
@@ -239,21 +225,21 @@ int inference_yolov7_model(rknn_app_context_t *app_ctx, image_buffer_t *img, obj
         outputs[i].want_float = (!app_ctx->is_quant);
     }
 
-    timer.tik();
-    ret = rknn_outputs_get(app_ctx->rknn_ctx, app_ctx->io_num.n_output, outputs, NULL);
+    {
+        TRACE_ZONE(TRACE_STAGE_OUTPUTS_GET, "rknn_outputs_get");
+        ret = rknn_outputs_get(app_ctx->rknn_ctx, app_ctx->io_num.n_output, outputs, NULL);
+    }
     if (ret < 0)
     {
         printf("rknn_outputs_get fail! ret=%d\n", ret);
         goto out;
     }
-    timer.tok();
-    timer.print_time("rknn_outputs_get");
 
     // Post Process
-    timer.tik();
-    post_process(app_ctx, outputs, &letter_box, box_conf_threshold, nms_threshold, od_results);
-    timer.tok();
-    timer.print_time("post_process");
+    {
+        TRACE_ZONE(TRACE_STAGE_POSTPROCESS, "post_process");
+        post_process(app_ctx, outputs, &letter_box, box_conf_threshold, nms_threshold, od_results);
+    }
 
     // Remeber to release rknn output
     rknn_outputs_release(app_ctx->rknn_ctx, app_ctx->io_num.n_output, outputs);
@@ -20,8 +20,9 @@
 #include "yolov7.h"
 #include "common.h"
 #include "file_utils.h"
+#include "model_registry.h"
 #include "image_utils.h"
-#include "easy_timer.h"
+#include "trace_utils.h"
 
 static void dump_tensor_attr(rknn_tensor_attr *attr)
 {
@@ -35,14 +36,12 @@ static void dump_tensor_attr(rknn_tensor_attr *attr)
 int init_yolov7_model(const char *model_path, rknn_app_context_t *app_ctx)
 {
     int ret;
-    int model_len = 0;
-    char *model;
     rknn_context ctx = 0;
 
-    ret = rknn_init(&ctx, (char *)model_path, 0, 0, NULL);
+    ret = acquire_model_context(model_path, 0, &ctx);
     if (ret < 0)
     {
-        printf("rknn_init fail! ret=%d\n", ret);
+        printf("acquire_model_context fail! ret=%d\n", ret);
         return -1;
     }
 
@@ -177,7 +176,7 @@ int release_yolov7_model(rknn_app_context_t *app_ctx)
     }
     if (app_ctx->rknn_ctx != 0)
     {
-        rknn_destroy(app_ctx->rknn_ctx);
+        release_model_context(app_ctx->rknn_ctx);
         app_ctx->rknn_ctx = 0;
     }
     return 0;
@@ -191,8 +190,6 @@ int inference_yolov7_model(rknn_app_context_t *app_ctx, image_buffer_t *img, obj
     const float nms_threshold = NMS_THRESH;      // 默认的NMS阈值
     const float box_conf_threshold = BOX_THRESH; // 默认的置信度阈值
     int bg_color = 114;
-    TIMER timer;
-    timer.indent_set("");
 
     if ((!app_ctx) || !(img) || (!od_results))
     {
@@ -216,32 +213,29 @@ int inference_yolov7_model(rknn_app_context_t *app_ctx, image_buffer_t *img, obj
     }
 
     // letterbox
-    timer.tik();
     ret = convert_image_with_letterbox(img, &dst_img, &letter_box, bg_color);
     if (ret < 0)
     {
         printf("convert_image_with_letterbox fail! ret=%d\n", ret);
         return -1;
     }
-    timer.tok();
-    timer.print_time("convert_image_with_letterbox");
 
     // Run
-    timer.tik();
-    ret = rknn_run(app_ctx->rknn_ctx, nullptr);
+    {
+        TRACE_ZONE(TRACE_STAGE_RUN, "rknn_run");
+        ret = rknn_run(app_ctx->rknn_ctx, nullptr);
+    }
     if (ret < 0)
     {
         printf("rknn_run fail! ret=%d\n", ret);
         return -1;
     }
-    timer.tok();
-    timer.print_time("rknn_run");
 
     // Post Process
-    timer.tik();
-    post_process(app_ctx, app_ctx->output_mems, &letter_box, box_conf_threshold, nms_threshold, od_results);
-    timer.tok();
-    timer.print_time("post_process");
+    {
+        TRACE_ZONE(TRACE_STAGE_POSTPROCESS, "post_process");
+        post_process(app_ctx, app_ctx->output_mems, &letter_box, box_conf_threshold, nms_threshold, od_results);
+    }
 
 out:
     return ret;
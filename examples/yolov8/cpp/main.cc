@@ -19,34 +19,127 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 
 #include "yolov8.h"
 #include "image_utils.h"
 #include "file_utils.h"
 #include "image_drawing.h"
+#include "trace_utils.h"
+#include "batch_utils.h"
 
 #if defined(RV1106_1103) 
-    #include "dma_alloc.hpp"
+    #include "dma_pool.h"
 #endif
 
+/*-------------------------------------------
+                  Batch Mode
+-------------------------------------------*/
+static int detect_batch_callback(void *userdata, const char *path, image_buffer_t *image, const image_decode_info_t *info,
+                                 char *result_json, int result_size)
+{
+    rknn_app_context_t *app_ctx = (rknn_app_context_t *)userdata;
+    object_detect_result_list od_results;
+
+    int ret = inference_yolov8_model(app_ctx, image, &od_results);
+    if (ret != 0)
+    {
+        return ret;
+    }
+
+    // boxes are on the decoded image, which is smaller when the jpeg was DCT scaled
+    float scale_x = (float)info->orig_width / image->width;
+    float scale_y = (float)info->orig_height / image->height;
+
+    int len = snprintf(result_json, result_size, "[");
+    for (int i = 0; i < od_results.count && len < result_size; i++)
+    {
+        object_detect_result *det_result = &(od_results.results[i]);
+        len += snprintf(result_json + len, result_size - len, "%s{\"class\":\"%s\",\"box\":[%d,%d,%d,%d],\"score\":%.4f}",
+                        i > 0 ? "," : "", coco_cls_to_name(det_result->cls_id),
+                        (int)(det_result->box.left * scale_x + 0.5f), (int)(det_result->box.top * scale_y + 0.5f),
+                        (int)(det_result->box.right * scale_x + 0.5f), (int)(det_result->box.bottom * scale_y + 0.5f),
+                        det_result->prop);
+    }
+    if (len >= result_size - 1)
+    {
+        printf("result of %s is too long\n", path);
+        return -1;
+    }
+    snprintf(result_json + len, result_size - len, "]");
+    return 0;
+}
+
+static bool is_batch_input(const char *path)
+{
+    struct stat st;
+    if (stat(path, &st) == 0 && S_ISDIR(st.st_mode))
+    {
+        return true;
+    }
+    const char *ext = strrchr(path, '.');
+    return ext != NULL && strcmp(ext, ".txt") == 0;
+}
+
+static int run_batch(rknn_app_context_t *app_ctx, const char *input_path, const char *output_path)
+{
+    int count = 0;
+    char **files = list_image_files(input_path, &count);
+    if (files == NULL || count == 0)
+    {
+        printf("no image found in %s\n", input_path);
+        return -1;
+    }
+
+    batch_config_t config;
+    memset(&config, 0, sizeof(batch_config_t));
+    config.model_width = app_ctx->model_width;
+    config.model_height = app_ctx->model_height;
+    config.output_path = output_path;
+
+    batch_stats_t stats;
+    int ret = run_image_batch(files, count, &config, detect_batch_callback, app_ctx, &stats);
+    if (ret == 0)
+    {
+        print_batch_stats(&stats);
+    }
+    free_lines(files, count);
+    return ret;
+}
+
 /*-------------------------------------------
                   Main Function
 -------------------------------------------*/
 int main(int argc, char **argv)
 {
-    if (argc != 3)
+    if (argc != 3 && argc != 4)
     {
         printf("%s <model_path> <image_path>\n", argv[0]);
+        printf("%s <model_path> <image_dir|image_list.txt> [result.jsonl]\n", argv[0]);
         return -1;
     }
 
     const char *model_path = argv[1];
     const char *image_path = argv[2];
+    bool batch_mode = is_batch_input(image_path);
 
     int ret;
+    // set to write a trace for chrome://tracing or ui.perfetto.dev
+    const char *trace_path = getenv("RKNN_TRACE_JSON");
     rknn_app_context_t rknn_app_ctx;
     memset(&rknn_app_ctx, 0, sizeof(rknn_app_context_t));
+#if defined(RV1106_1103) 
+    dma_pool_t* dma_pool = NULL;
+    dma_buffer_t* img_dma_buf = NULL;
+#endif
 
+    image_buffer_t src_image;
+    memset(&src_image, 0, sizeof(image_buffer_t));
+
+    if (trace_path != NULL)
+    {
+        trace_set_event_capture(1);
+    }
     init_post_process();
 
     ret = init_yolov8_model(model_path, &rknn_app_ctx);
@@ -56,28 +149,33 @@ int main(int argc, char **argv)
         goto out;
     }
 
-    image_buffer_t src_image;
-    memset(&src_image, 0, sizeof(image_buffer_t));
+#if !defined(RV1106_1103)
+    if (batch_mode)
+    {
+        ret = run_batch(&rknn_app_ctx, image_path, argc == 4 ? argv[3] : NULL);
+        goto out;
+    }
+#endif
+
     ret = read_image(image_path, &src_image);
 
-#if defined(RV1106_1103) 
-    //RV1106 rga requires that input and output bufs are memory allocated by dma
-    ret = dma_buf_alloc(RV1106_CMA_HEAP_PATH, src_image.size, &rknn_app_ctx.img_dma_buf.dma_buf_fd, 
-                       (void **) & (rknn_app_ctx.img_dma_buf.dma_buf_virt_addr));
-    memcpy(rknn_app_ctx.img_dma_buf.dma_buf_virt_addr, src_image.virt_addr, src_image.size);
-    dma_sync_cpu_to_device(rknn_app_ctx.img_dma_buf.dma_buf_fd);
-    free(src_image.virt_addr);
-    src_image.virt_addr = (unsigned char *)rknn_app_ctx.img_dma_buf.dma_buf_virt_addr;
-    src_image.fd = rknn_app_ctx.img_dma_buf.dma_buf_fd;
-    rknn_app_ctx.img_dma_buf.size = src_image.size;
-#endif
-    
     if (ret != 0)
     {
         printf("read image fail! ret=%d image_path=%s\n", ret, image_path);
         goto out;
     }
 
+#if defined(RV1106_1103) 
+    //RV1106 rga requires that input and output bufs are memory allocated by dma
+    dma_pool = create_dma_pool(NULL, 0);
+    img_dma_buf = dma_pool != NULL ? move_image_to_dma_buffer(dma_pool, &src_image) : NULL;
+    if (img_dma_buf == NULL)
+    {
+        ret = -1;
+        goto out;
+    }
+#endif
+
     object_detect_result_list od_results;
 
     ret = inference_yolov8_model(&rknn_app_ctx, &src_image, &od_results);
@@ -88,7 +186,8 @@ int main(int argc, char **argv)
     }
 
     // 画框和概率
-    char text[256];
+    char text[OBJ_NUMB_MAX_SIZE][64];
+    draw_detection_t draw_dets[OBJ_NUMB_MAX_SIZE];
     for (int i = 0; i < od_results.count; i++)
     {
         object_detect_result *det_result = &(od_results.results[i]);
@@ -96,16 +195,14 @@ int main(int argc, char **argv)
                det_result->box.left, det_result->box.top,
                det_result->box.right, det_result->box.bottom,
                det_result->prop);
-        int x1 = det_result->box.left;
-        int y1 = det_result->box.top;
-        int x2 = det_result->box.right;
-        int y2 = det_result->box.bottom;
 
-        draw_rectangle(&src_image, x1, y1, x2 - x1, y2 - y1, COLOR_BLUE, 3);
-
-        sprintf(text, "%s %.1f%%", coco_cls_to_name(det_result->cls_id), det_result->prop * 100);
-        draw_text(&src_image, text, x1, y1 - 20, COLOR_RED, 10);
+        snprintf(text[i], sizeof(text[i]), "%s %.1f%%", coco_cls_to_name(det_result->cls_id), det_result->prop * 100);
+        draw_dets[i].box = det_result->box;
+        draw_dets[i].box_color = COLOR_BLUE;
+        draw_dets[i].text = text[i];
+        draw_dets[i].text_color = COLOR_RED;
     }
+    draw_detections(&src_image, draw_dets, od_results.count, 3, 10);
 
     write_image("out.png", &src_image);
 
@@ -121,12 +218,27 @@ out:
     if (src_image.virt_addr != NULL)
     {
 #if defined(RV1106_1103) 
-        dma_buf_free(rknn_app_ctx.img_dma_buf.size, &rknn_app_ctx.img_dma_buf.dma_buf_fd, 
-                rknn_app_ctx.img_dma_buf.dma_buf_virt_addr);
+        if (img_dma_buf != NULL)
+        {
+            release_dma_buffer(img_dma_buf);
+        }
+        else
+        {
+            free(src_image.virt_addr);
+        }
 #else
         free(src_image.virt_addr);
 #endif
     }
+#if defined(RV1106_1103) 
+    destroy_dma_pool(dma_pool);
+#endif
+
+    trace_print_stats();
+    if (trace_path != NULL)
+    {
+        trace_write_json(trace_path);
+    }
 
     return 0;
 }
@@ -20,7 +20,10 @@
 #include "yolov8.h"
 #include "common.h"
 #include "file_utils.h"
+#include "model_registry.h"
+#include "layout_utils.h"
 #include "image_utils.h"
+#include "trace_utils.h"
 
 static void dump_tensor_attr(rknn_tensor_attr *attr) {
     char dims[128] = {0};
@@ -38,21 +41,12 @@ static void dump_tensor_attr(rknn_tensor_attr *attr) {
 
 int init_yolov8_model(const char *model_path, rknn_app_context_t *app_ctx) {
     int ret;
-    int model_len = 0;
-    char *model;
     rknn_context ctx = 0;
 
     // Load RKNN Model
-    model_len = read_data_from_file(model_path, &model);
-    if (model == NULL) {
-        printf("load_model fail!\n");
-        return -1;
-    }
-
-    ret = rknn_init(&ctx, model, model_len, 0, NULL);
-    free(model);
+    ret = acquire_model_context(model_path, 0, &ctx);
     if (ret < 0) {
-        printf("rknn_init fail! ret=%d\n", ret);
+        printf("acquire_model_context fail! ret=%d\n", ret);
         return -1;
     }
 
@@ -176,30 +170,6 @@ int init_yolov8_model(const char *model_path, rknn_app_context_t *app_ctx) {
     return 0;
 }
 
-int NC1HWC2_i8_to_NCHW_i8(const int8_t *src, int8_t *dst, int *dims, int channel, int h, int w, int zp, float scale) {
-    int batch  = dims[0];
-    int C1     = dims[1];
-    int C2     = dims[4];
-    int hw_src = dims[2] * dims[3];
-    int hw_dst = h * w;
-    for (int i = 0; i < batch; i++) {
-        const int8_t *src_b = src + i * C1 * hw_src * C2;
-        int8_t        *dst_b = dst + i * channel * hw_dst;
-        for (int c = 0; c < channel; ++c) {
-            int           plane  = c / C2;
-            const int8_t *src_bc = plane * hw_src * C2 + src_b;
-            int           offset = c % C2;
-            for (int cur_h = 0; cur_h < h; ++cur_h)
-                for (int cur_w = 0; cur_w < w; ++cur_w) {
-                    int cur_hw                 = cur_h * w + cur_w;
-                    dst_b[c * hw_dst + cur_hw] = src_bc[C2 * cur_hw + offset] ; // int8-->int8
-                }
-        }
-    }
-
-    return 0;
-}
-
 int release_yolov8_model(rknn_app_context_t *app_ctx) {
     int ret;
     if (app_ctx->input_attrs != NULL) {
@@ -238,9 +208,9 @@ int release_yolov8_model(rknn_app_context_t *app_ctx) {
         }
     }
     if (app_ctx->rknn_ctx != 0) {
-        ret = rknn_destroy(app_ctx->rknn_ctx);
+        ret = release_model_context(app_ctx->rknn_ctx);
         if (ret != RKNN_SUCC) {
-            printf("rknn_destroy fail! ret=%d\n", ret);
+            printf("release_model_context fail! ret=%d\n", ret);
             return -1;
         }
         app_ctx->rknn_ctx = 0;
@@ -286,8 +256,11 @@ int inference_yolov8_model(rknn_app_context_t *app_ctx, image_buffer_t *img, obj
     }
 
     // Run
-    printf("rknn_run\n");
-    ret = rknn_run(app_ctx->rknn_ctx, nullptr);
+    TRACE_LOG("rknn_run\n");
+    {
+        TRACE_ZONE(TRACE_STAGE_RUN, "rknn_run");
+        ret = rknn_run(app_ctx->rknn_ctx, nullptr);
+    }
     if (ret < 0) {
         printf("rknn_run fail! ret=%d\n", ret);
         return -1;
@@ -296,30 +269,39 @@ int inference_yolov8_model(rknn_app_context_t *app_ctx, image_buffer_t *img, obj
     //NC1HWC2 to NCHW
     rknn_output outputs[app_ctx->io_num.n_output];
     memset(outputs, 0, sizeof(outputs));
-    for (uint32_t i = 0; i < app_ctx->io_num.n_output; i++) {
-        int   channel = app_ctx->output_attrs[i].dims[1];
-        int   h       = app_ctx->output_attrs[i].n_dims > 2 ? app_ctx->output_attrs[i].dims[2] : 1;
-        int   w       = app_ctx->output_attrs[i].n_dims > 3 ? app_ctx->output_attrs[i].dims[3] : 1;
-        int   hw      = h * w;
-        int   zp      = app_ctx->output_native_attrs[i].zp;
-        float scale   = app_ctx->output_native_attrs[i].scale;
-        if (app_ctx->is_quant) {
-            outputs[i].size = app_ctx->output_native_attrs[i].n_elems * sizeof(int8_t);
-            outputs[i].buf = (int8_t *)malloc(outputs[i].size);
-            if (app_ctx->output_native_attrs[i].fmt == RKNN_TENSOR_NC1HWC2) {
-                NC1HWC2_i8_to_NCHW_i8((int8_t *)app_ctx->output_mems[i]->virt_addr, (int8_t *)outputs[i].buf,
-                                      (int *)app_ctx->output_native_attrs[i].dims, channel, h, w, zp, scale);
+    {
+        TRACE_ZONE(TRACE_STAGE_OUTPUTS_GET, "convert_layout");
+        for (uint32_t i = 0; i < app_ctx->io_num.n_output; i++) {
+            rknn_tensor_attr *native_attr = &app_ctx->output_native_attrs[i];
+            int channel = app_ctx->output_attrs[i].dims[1];
+            int h       = app_ctx->output_attrs[i].n_dims > 2 ? app_ctx->output_attrs[i].dims[2] : 1;
+            int w       = app_ctx->output_attrs[i].n_dims > 3 ? app_ctx->output_attrs[i].dims[3] : 1;
+            if (app_ctx->is_quant) {
+                outputs[i].size = native_attr->n_elems * sizeof(int8_t);
+                outputs[i].buf = (int8_t *)malloc(outputs[i].size);
+                if (native_attr->fmt == RKNN_TENSOR_NC1HWC2) {
+                    tensor_layout_desc_t src_desc;
+                    tensor_layout_desc_t dst_desc;
+                    init_layout_desc(&src_desc, TENSOR_LAYOUT_NC1HWC2, native_attr->dims[0], channel, h, w, native_attr->dims[4]);
+                    src_desc.w_stride = native_attr->dims[3];
+                    src_desc.h_stride = native_attr->dims[2];
+                    init_layout_desc(&dst_desc, TENSOR_LAYOUT_NCHW, native_attr->dims[0], channel, h, w, 0);
+                    convert_layout(app_ctx->output_mems[i]->virt_addr, &src_desc, outputs[i].buf, &dst_desc, sizeof(int8_t), 0);
+                } else {
+                    memcpy(outputs[i].buf, app_ctx->output_mems[i]->virt_addr, outputs[i].size);
+                }
             } else {
-                memcpy(outputs[i].buf, app_ctx->output_mems[i]->virt_addr, outputs[i].size);
+                printf("Currently zero copy does not support fp16!\n");
+                goto out;
             }
-        } else {
-            printf("Currently zero copy does not support fp16!\n");
-            goto out;
         }
     }
 
     // Post Process
-    post_process(app_ctx, outputs, &letter_box, box_conf_threshold, nms_threshold, od_results);
+    {
+        TRACE_ZONE(TRACE_STAGE_POSTPROCESS, "post_process");
+        post_process(app_ctx, outputs, &letter_box, box_conf_threshold, nms_threshold, od_results);
+    }
 
     for (int i = 0; i < app_ctx->io_num.n_output; i++) {
         free(outputs[i].buf);
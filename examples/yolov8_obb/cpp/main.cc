@@ -24,6 +24,7 @@
 #include "image_utils.h"
 #include "file_utils.h"
 #include "image_drawing.h"
+#include "trace_utils.h"
 
 
 /*-------------------------------------------
@@ -41,9 +42,15 @@ int main(int argc, char **argv)
     const char *image_path = argv[2];
 
     int ret;
+    // set to write a trace for chrome://tracing or ui.perfetto.dev
+    const char *trace_path = getenv("RKNN_TRACE_JSON");
     rknn_app_context_t rknn_app_ctx;
     memset(&rknn_app_ctx, 0, sizeof(rknn_app_context_t));
 
+    if (trace_path != NULL)
+    {
+        trace_set_event_capture(1);
+    }
     init_post_process();
 
     ret = init_yolov8_obb_model(model_path, &rknn_app_ctx);
@@ -110,5 +117,11 @@ out:
         free(src_image.virt_addr);
     }
 
+    trace_print_stats();
+    if (trace_path != NULL)
+    {
+        trace_write_json(trace_path);
+    }
+
     return 0;
 }
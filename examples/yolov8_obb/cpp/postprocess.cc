@@ -20,12 +20,12 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/time.h>
+#include "dfl_utils.h"
 
 #include <iostream>
 #include <cmath>
 #include <algorithm>
 
-#include <set>
 #include <vector>
 #define LABEL_NALE_TXT_PATH "./model/yolov8_obb_labels_list.txt"
 
@@ -109,236 +109,148 @@ static float CalculateOverlap(float xmin0, float ymin0, float xmax0, float ymax0
 }
 
 
-// box转化为角点
-std::vector<float> rbbox_to_corners(const std::vector<float> &rbbox) {
-    // generate clockwise corners and rotate it clockwise
-    // 顺时针方向返回角点位置
-    float cx = rbbox[0] + rbbox[2] / 2;
-    float cy = rbbox[1] + rbbox[3] / 2;
-    float x_d = rbbox[2];
-    float y_d = rbbox[3];
-    float angle = rbbox[4];
-    float a_cos = std::cos(angle);
-    float a_sin = std::sin(angle);
-    std::vector<float> corners(8, 0.0);
-    float corners_x[4] = {-x_d / 2, -x_d / 2, x_d / 2, x_d / 2};
-    float corners_y[4] = {-y_d / 2, y_d / 2, y_d / 2, -y_d / 2};
+// rotated box, corners in the same winding for every box so clipping needs no orientation test
+typedef struct {
+    float pts[8];
+    float cx;
+    float cy;
+    float radius;   // bounding circle
+    float area;
+} rotated_box_t;
+
+// loc: xmin, ymin, w, h, angle, rotated around the center
+static void make_rotated_box(const float *loc, rotated_box_t *box) {
+    float w = loc[2];
+    float h = loc[3];
+    float a_cos = cosf(loc[4]);
+    float a_sin = sinf(loc[4]);
+    const float dx[4] = {-w / 2, w / 2, w / 2, -w / 2};
+    const float dy[4] = {-h / 2, -h / 2, h / 2, h / 2};
+    box->cx = loc[0] + w / 2;
+    box->cy = loc[1] + h / 2;
     for (int i = 0; i < 4; ++i) {
-        corners[2 * i] = a_cos * corners_x[i] - a_sin * corners_y[i] + cx;
-        corners[2 * i + 1] = a_sin * corners_x[i] + a_cos * corners_y[i] + cy;
+        box->pts[2 * i] = a_cos * dx[i] - a_sin * dy[i] + box->cx;
+        box->pts[2 * i + 1] = a_sin * dx[i] + a_cos * dy[i] + box->cy;
     }
-    return corners;
+    box->radius = 0.5f * sqrtf(w * w + h * h);
+    box->area = w * h;
 }
 
-// 检测点是否在四边形内的函数
-bool point_in_quadrilateral(float pt_x, float pt_y, const std::vector<float> &corners) {
-    float ab0 = corners[2] - corners[0];
-    float ab1 = corners[3] - corners[1];
-
-    float ad0 = corners[6] - corners[0];
-    float ad1 = corners[7] - corners[1];
-
-    float ap0 = pt_x - corners[0];
-    float ap1 = pt_y - corners[1];
-
-    float abab = ab0 * ab0 + ab1 * ab1;
-    float abap = ab0 * ap0 + ab1 * ap1;
-    float adad = ad0 * ad0 + ad1 * ad1;
-    float adap = ad0 * ap0 + ad1 * ap1;
-
-    return abab >= abap && abap >= 0 && adad >= adap && adap >= 0;
-}
-
-
-// 检测线段相交并计算交点的函数
-int line_segment_intersection(const std::vector<float> &pts1, const std::vector<float> &pts2, int i, int j
-                              , bool &ret1, float &point_x, float &point_y) {
-    // pts1, pts2 分别为 corners
-    // i j 分别表示第几个交点，取其和其后一个点构成的线段
-    // 返回 tuple(bool, pts) bool=true pts为交点
-    std::vector<float> A(2), B(2), C(2), D(2), ret(2);
-    A[0] = pts1[2 * i];
-    A[1] = pts1[2 * i + 1];
-
-    B[0] = pts1[2 * ((i + 1) % 4)];
-    B[1] = pts1[2 * ((i + 1) % 4) + 1];
-
-    C[0] = pts2[2 * j];
-    C[1] = pts2[2 * j + 1];
-
-    D[0] = pts2[2 * ((j + 1) % 4)];
-    D[1] = pts2[2 * ((j + 1) % 4) + 1];
-
-    float BA0 = B[0] - A[0];
-    float BA1 = B[1] - A[1];
-    float DA0 = D[0] - A[0];
-    float CA0 = C[0] - A[0];
-    float DA1 = D[1] - A[1];
-    float CA1 = C[1] - A[1];
-
-    // 叉乘判断方向
-    bool acd = DA1 * CA0 > CA1 * DA0;
-    bool bcd = (D[1] - B[1]) * (C[0] - B[0]) > (C[1] - B[1]) * (D[0] - B[0]);
-
-    if (acd != bcd) {
-        bool abc = CA1 * BA0 > BA1 * CA0;
-        bool abd = DA1 * BA0 > BA1 * DA0;
-
-        // 判断方向
-        if (abc != abd) {
-            float DC0 = D[0] - C[0];
-            float DC1 = D[1] - C[1];
-            float ABBA = A[0] * B[1] - B[0] * A[1];
-            float CDDC = C[0] * D[1] - D[0] * C[1];
-            float DH = BA1 * DC0 - BA0 * DC1;
-            float Dx = ABBA * DC0 - BA0 * CDDC;
-            float Dy = ABBA * DC1 - BA1 * CDDC;
-            ret[0] = Dx / DH;
-            ret[1] = Dy / DH;
-            ret1 = true;
-            point_x = ret[0] ;
-            point_y = ret[1] ;
-            return 0;
+// Sutherland-Hodgman clip of box a by the 4 edges of box b, at most 8 vertices, no allocation
+static float rotated_box_iou(const rotated_box_t *a, const rotated_box_t *b) {
+    float poly[16];
+    float clip[16];
+    int n = 4;
+    memcpy(poly, a->pts, sizeof(a->pts));
+    for (int e = 0; e < 4 && n > 0; ++e) {
+        float x0 = b->pts[2 * e];
+        float y0 = b->pts[2 * e + 1];
+        float ex = b->pts[2 * ((e + 1) & 3)] - x0;
+        float ey = b->pts[2 * ((e + 1) & 3) + 1] - y0;
+        int m = 0;
+        for (int i = 0; i < n; ++i) {
+            int k = i + 1 < n ? i + 1 : 0;
+            float px = poly[2 * i];
+            float py = poly[2 * i + 1];
+            float qx = poly[2 * k];
+            float qy = poly[2 * k + 1];
+            float dp = ex * (py - y0) - ey * (px - x0);
+            float dq = ex * (qy - y0) - ey * (qx - x0);
+            if (dp >= 0) {
+                clip[2 * m] = px;
+                clip[2 * m + 1] = py;
+                m++;
+            }
+            if ((dp >= 0) != (dq >= 0)) {
+                float t = dp / (dp - dq);
+                clip[2 * m] = px + t * (qx - px);
+                clip[2 * m + 1] = py + t * (qy - py);
+                m++;
+            }
         }
+        n = m;
+        memcpy(poly, clip, sizeof(float) * 2 * n);
     }
-    ret1 = false;
-    point_x = ret[0] ;
-    point_y = ret[1] ;
-    return 0;
-}
-
-
-
-// 比较函数，用于排序
-bool compare_points(const std::vector<float> &pt1, const std::vector<float> &pt2, const std::vector<float> &center) {
-    float vx1 = pt1[0] - center[0];
-    float vy1 = pt1[1] - center[1];
-    float vx2 = pt2[0] - center[0];
-    float vy2 = pt2[1] - center[1];
-    float d1 = std::sqrt(vx1 * vx1 + vy1 * vy1);
-    float d2 = std::sqrt(vx2 * vx2 + vy2 * vy2);
-    vx1 /= d1;
-    vy1 /= d1;
-    vx2 /= d2;
-    vy2 /= d2;
-    if (vy1 < 0) {
-        vx1 = -2 - vx1;
+    if (n < 3) {
+        return 0.f;
     }
-    if (vy2 < 0) {
-        vx2 = -2 - vx2;
+    float inter = 0.f;
+    for (int i = 0; i < n; ++i) {
+        int k = i + 1 < n ? i + 1 : 0;
+        inter += poly[2 * i] * poly[2 * k + 1] - poly[2 * k] * poly[2 * i + 1];
     }
-    return vx1 < vx2;
+    inter = fabsf(inter) * 0.5f;
+    float area_union = a->area + b->area - inter;
+    return area_union <= 0.f ? 0.f : inter / area_union;
 }
 
-// 对凸多边形的顶点进行排序
-void sort_vertex_in_convex_polygon(std::vector<std::vector<float>> &int_pts, int num_of_inter) {
-    if (num_of_inter > 0) {
-        std::vector<float> center(2, 0);
-        for (int i = 0; i < num_of_inter; ++i) {
-            center[0] += int_pts[i][0];
-            center[1] += int_pts[i][1];
-        }
-        center[0] /= num_of_inter;
-        center[1] /= num_of_inter;
-        std::sort(int_pts.begin(), int_pts.end(), [&center](const std::vector<float> &pt1, const std::vector<float> &pt2) {
-            return compare_points(pt1, pt2, center);
-        });
-    }
-}
-
-// 计算三角形的面积
-float triangle_area(const std::vector<float> &a, const std::vector<float> &b, const std::vector<float> &c) {
-    return std::abs((a[0] - c[0]) * (b[1] - c[1]) - (a[1] - c[1]) * (b[0] - c[0])) / 2.0;
+float Cal_IOU(float x1, float y1, float w1, float h1, float angle1, float x2, float y2, float w2, float h2, float angle2) {
+    float loc1[5] = {x1, y1, w1, h1, angle1};
+    float loc2[5] = {x2, y2, w2, h2, angle2};
+    rotated_box_t box1, box2;
+    make_rotated_box(loc1, &box1);
+    make_rotated_box(loc2, &box2);
+    return rotated_box_iou(&box1, &box2);
 }
 
-// 计算多边形转化为多个三角形面积之和
-float polygon_area(const std::vector<std::vector<float>> &int_pts, int num_of_inter) {
-    float area_val = 0.0;
-    for (int i = 1; i < num_of_inter - 1; ++i) {
-        area_val += triangle_area(int_pts[0], int_pts[i], int_pts[i + 1]);
+// class-aware rotated nms, order holds candidate indices sorted by score, suppressed ones are set to -1
+static int nms(int validCount, std::vector<float> &outputLocations, std::vector<int> &classIds, std::vector<int> &order,
+               float threshold) {
+    std::vector<rotated_box_t> boxes(validCount);
+    for (int i = 0; i < validCount; ++i) {
+        make_rotated_box(&outputLocations[i * 5], &boxes[i]);
     }
-    return area_val;
-}
 
-float Cal_IOU(float x1, float y1, float w1, float h1, float angle1, float x2, float y2, float w2, float h2, float angle2) {
-    // 定义两个box的数据
-    std::vector<float> rbbox1 = {x1, y1, w1, h1, angle1};
-    std::vector<float> rbbox2 = {x2, y2, w2, h2, angle2};
-
-    // 调用函数得到角点数据
-    std::vector<float> corners1 = rbbox_to_corners(rbbox1);
-    std::vector<float> corners2 = rbbox_to_corners(rbbox2);
-
-    std::vector<std::vector<float>> pts;
-    int num_pts = 0;
-    // 检测角点是否在对方的四边形内
-    for (int i = 0; i < 4; ++i) {
-        float point_x = corners1[2 * i];
-        float point_y = corners1[2 * i + 1];
-        if (point_in_quadrilateral(point_x, point_y, corners2)) {
-            num_pts++;
-            pts.push_back({point_x, point_y});
-        }
+    // sorted positions grouped by class, score order kept inside each class
+    int class_start[OBJ_CLASS_NUM + 1] = {0};
+    for (int i = 0; i < validCount; ++i) {
+        class_start[classIds[i] + 1]++;
     }
-    for (int i = 0; i < 4; ++i) {
-        float point_x = corners2[2 * i];
-        float point_y = corners2[2 * i + 1];
-        if (point_in_quadrilateral(point_x, point_y, corners1)) {
-            num_pts++;
-            pts.push_back({point_x, point_y});
-        }
+    for (int c = 0; c < OBJ_CLASS_NUM; ++c) {
+        class_start[c + 1] += class_start[c];
     }
-
-
-    for (int i = 0; i < 4; ++i) {
-        for (int j = 0; j < 4; ++j) {
-            float point_x, point_y;
-            bool ret;
-            line_segment_intersection(corners1, corners2, i, j, ret, point_x, point_y);
-            if (ret) {
-                num_pts++;
-                pts.push_back({point_x, point_y});
-            }
+    std::vector<int> pos(validCount);
+    {
+        int fill[OBJ_CLASS_NUM];
+        memcpy(fill, class_start, sizeof(fill));
+        for (int i = 0; i < validCount; ++i) {
+            pos[fill[classIds[order[i]]]++] = i;
         }
     }
 
-    sort_vertex_in_convex_polygon(pts, num_pts);
-
-    float polygon_area_val = polygon_area(pts, num_pts);
-
-    // 计算 area_union
-    float area_union = rbbox1[2] * rbbox1[3] + rbbox2[2] * rbbox2[3] - polygon_area_val;
-    return polygon_area_val / area_union;
-}
-
-
-static int nms(int validCount, std::vector<float> &outputLocations, std::vector<int> classIds, std::vector<int> &order,
-               int filterId, float threshold) {
-    for (int i = 0; i < validCount; ++i) {
-        if (order[i] == -1 || classIds[i] != filterId) {
-            continue;
+    // SoA bounding circles so the prefilter runs over a whole batch of candidates
+    std::vector<float> cx(validCount), cy(validCount), radius(validCount);
+    std::vector<uint8_t> close_by(validCount);
+    for (int c = 0; c < OBJ_CLASS_NUM; ++c) {
+        int start = class_start[c];
+        int count = class_start[c + 1] - start;
+        for (int i = 0; i < count; ++i) {
+            const rotated_box_t &box = boxes[order[pos[start + i]]];
+            cx[i] = box.cx;
+            cy[i] = box.cy;
+            radius[i] = box.radius;
         }
-        int n = order[i];
-        for (int j = i + 1; j < validCount; ++j) {
-            int m = order[j];
-            if (m == -1 || classIds[i] != filterId) {
+        for (int i = 0; i < count; ++i) {
+            int pi = pos[start + i];
+            if (order[pi] == -1) {
                 continue;
             }
-            float xmin0 = outputLocations[n * 5 + 0];
-            float ymin0 = outputLocations[n * 5 + 1];
-            float w0 = outputLocations[n * 5 + 2];
-            float h0 = outputLocations[n * 5 + 3];
-            float angle0 = outputLocations[n * 5 + 4];
-
-            float xmin1 = outputLocations[m * 5 + 0];
-            float ymin1 = outputLocations[m * 5 + 1];
-            float w1 = outputLocations[m * 5 + 2];
-            float h1 = outputLocations[m * 5 + 3];
-            float angle1 = outputLocations[n * 5 + 4];
-
-            float iou = Cal_IOU(xmin0, ymin0, w0, h0, angle0, xmin1, ymin1, w1, h1, angle1);
-            if (iou > threshold) {
-                order[j] = -1;
+            const rotated_box_t &kept = boxes[order[pi]];
+            float x = cx[i], y = cy[i], r = radius[i];
+            for (int j = i + 1; j < count; ++j) {
+                float dx = cx[j] - x;
+                float dy = cy[j] - y;
+                float rr = radius[j] + r;
+                close_by[j] = dx * dx + dy * dy < rr * rr;
+            }
+            for (int j = i + 1; j < count; ++j) {
+                int pj = pos[start + j];
+                if (!close_by[j] || order[pj] == -1) {
+                    continue;
+                }
+                if (rotated_box_iou(&kept, &boxes[order[pj]]) > threshold) {
+                    order[pj] = -1;
+                }
             }
         }
     }
@@ -407,24 +319,6 @@ static float deqnt_affine_u8_to_f32(uint8_t qnt, int32_t zp, float scale) {
 
 
 
-void softmax(float *input, int size) {
-    float max_val = input[0];
-    for (int i = 1; i < size; ++i) {
-        if (input[i] > max_val) {
-            max_val = input[i];
-        }
-    }
-
-    float sum_exp = 0.0;
-    for (int i = 0; i < size; ++i) {
-        sum_exp += expf(input[i] - max_val);
-    }
-
-    for (int i = 0; i < size; ++i) {
-        input[i] = expf(input[i] - max_val) / sum_exp;
-    }
-}
-
 static int process_i8(int8_t *input, int8_t *angle_feature, int grid_h, int grid_w, int stride,
                       std::vector<float> &boxes, std::vector<float> &boxScores, std::vector<int> &classId, float threshold,
                       int32_t zp, float scale, int32_t angle_feature_zp, float angle_feature_scale, int index) {
@@ -433,28 +327,17 @@ static int process_i8(int8_t *input, int8_t *angle_feature, int grid_h, int grid
     int validCount = 0;
 
     int8_t thres_i8 = qnt_f32_to_affine(unsigmoid(threshold), zp, scale);
+    dfl_exp_table_t dfl_table;
+    init_dfl_exp_table_i8(&dfl_table, zp, scale);
     for (int h = 0; h < grid_h; h++) {
         for (int w = 0; w < grid_w; w++) {
             for (int a = 0; a < OBJ_CLASS_NUM; a++) {
                 if(input[(input_loc_len + a)*grid_w * grid_h + h * grid_w + w ] >= thres_i8) { //[1,tensor_len,grid_h,grid_w]
                     float box_conf_f32 = sigmoid(deqnt_affine_to_f32(input[(input_loc_len + a) * grid_w * grid_h + h * grid_w + w ],
                                                  zp, scale));
-                    float loc[input_loc_len];
-                    for (int i = 0; i < input_loc_len; ++i) {
-                        loc[i] = deqnt_affine_to_f32(input[i * grid_w * grid_h + h * grid_w + w], zp, scale);
-                    }
-
-                    for (int i = 0; i < input_loc_len / 16; ++i) {
-                        softmax(&loc[i * 16], 16);
-                    }
-                    float xywh_[4] = {0, 0, 0, 0};
+                    float xywh_[4];
                     float xywh[4] = {0, 0, 0, 0};
-                    for (int dfl = 0; dfl < 16; ++dfl) {
-                        xywh_[0] += loc[dfl] * dfl;
-                        xywh_[1] += loc[1 * 16 + dfl] * dfl;
-                        xywh_[2] += loc[2 * 16 + dfl] * dfl;
-                        xywh_[3] += loc[3 * 16 + dfl] * dfl;
-                    }
+                    dfl_decode_i8(input + h * grid_w + w, grid_w * grid_h, 16, &dfl_table, xywh_);
 
                     float xywh_add[2], xywh_sub[2];
                     xywh_add[0] = xywh_[0] + xywh_[2];
@@ -501,28 +384,17 @@ static int process_u8(uint8_t *input, uint8_t *angle_feature, int grid_h, int gr
     int validCount = 0;
 
     uint8_t thres_i8 = qnt_f32_to_affine_u8(unsigmoid(threshold), zp, scale);
+    dfl_exp_table_t dfl_table;
+    init_dfl_exp_table_u8(&dfl_table, zp, scale);
     for (int h = 0; h < grid_h; h++) {
         for (int w = 0; w < grid_w; w++) {
             for (int a = 0; a < OBJ_CLASS_NUM; a++) {
                 if(input[(input_loc_len + a)*grid_w * grid_h + h * grid_w + w ] >= thres_i8) { //[1,tensor_len,grid_h,grid_w]
                     float box_conf_f32 = sigmoid(deqnt_affine_u8_to_f32(input[(input_loc_len + a) * grid_w * grid_h + h * grid_w + w ],
                                                  zp, scale));
-                    float loc[input_loc_len];
-                    for (int i = 0; i < input_loc_len; ++i) {
-                        loc[i] = deqnt_affine_u8_to_f32(input[i * grid_w * grid_h + h * grid_w + w], zp, scale);
-                    }
-
-                    for (int i = 0; i < input_loc_len / 16; ++i) {
-                        softmax(&loc[i * 16], 16);
-                    }
-                    float xywh_[4] = {0, 0, 0, 0};
+                    float xywh_[4];
                     float xywh[4] = {0, 0, 0, 0};
-                    for (int dfl = 0; dfl < 16; ++dfl) {
-                        xywh_[0] += loc[dfl] * dfl;
-                        xywh_[1] += loc[1 * 16 + dfl] * dfl;
-                        xywh_[2] += loc[2 * 16 + dfl] * dfl;
-                        xywh_[3] += loc[3 * 16 + dfl] * dfl;
-                    }
+                    dfl_decode_u8(input + h * grid_w + w, grid_w * grid_h, 16, &dfl_table, xywh_);
 
                     float xywh_add[2], xywh_sub[2];
                     xywh_add[0] = xywh_[0] + xywh_[2];
@@ -573,22 +445,9 @@ static int process_fp32(float *input, float *angle_feature, int grid_h, int grid
             for (int a = 0; a < OBJ_CLASS_NUM; a++) {
                 if(input[(input_loc_len + a)*grid_w * grid_h + h * grid_w + w ] >= thres_fp32) { //[1,tensor_len,grid_h,grid_w]
                     float box_conf_f32 = sigmoid(input[(input_loc_len + a) * grid_w * grid_h + h * grid_w + w ]);
-                    float loc[input_loc_len];
-                    for (int i = 0; i < input_loc_len; ++i) {
-                        loc[i] = input[i * grid_w * grid_h + h * grid_w + w];
-                    }
-
-                    for (int i = 0; i < input_loc_len / 16; ++i) {
-                        softmax(&loc[i * 16], 16);
-                    }
-                    float xywh_[4] = {0, 0, 0, 0};
+                    float xywh_[4];
                     float xywh[4] = {0, 0, 0, 0};
-                    for (int dfl = 0; dfl < 16; ++dfl) {
-                        xywh_[0] += loc[dfl] * dfl;
-                        xywh_[1] += loc[1 * 16 + dfl] * dfl;
-                        xywh_[2] += loc[2 * 16 + dfl] * dfl;
-                        xywh_[3] += loc[3 * 16 + dfl] * dfl;
-                    }
+                    dfl_decode_f32(input + h * grid_w + w, grid_w * grid_h, 16, xywh_);
 
                     float xywh_add[2], xywh_sub[2];
                     xywh_add[0] = xywh_[0] + xywh_[2];
@@ -686,11 +545,7 @@ int post_process(rknn_app_context_t *app_ctx, void *outputs, letterbox_t *letter
     }
     quick_sort_indice_inverse(objProbs, 0, validCount - 1, indexArray);
 
-    std::set<int> class_set(std::begin(classId), std::end(classId));
-
-    for (auto c : class_set) {
-        nms(validCount, filterBoxes, classId, indexArray, c, nms_threshold);
-    }
+    nms(validCount, filterBoxes, classId, indexArray, nms_threshold);
 
     int last_count = 0;
     od_results->count = 0;
@@ -20,7 +20,9 @@
 #include "yolov8-obb.h"
 #include "common.h"
 #include "file_utils.h"
+#include "model_registry.h"
 #include "image_utils.h"
+#include "trace_utils.h"
 
 #include <sys/time.h>
 
@@ -43,14 +45,12 @@ static void dump_tensor_attr(rknn_tensor_attr *attr)
 int init_yolov8_obb_model(const char *model_path, rknn_app_context_t *app_ctx)
 {
     int ret;
-    int model_len = 0;
-    char *model;
     rknn_context ctx = 0;
 
-    ret = rknn_init(&ctx, (char *)model_path, 0, 0, NULL);
+    ret = acquire_model_context(model_path, 0, &ctx);
     if (ret < 0)
     {
-        printf("rknn_init fail! ret=%d\n", ret);
+        printf("acquire_model_context fail! ret=%d\n", ret);
         return -1;
     }
     
@@ -149,7 +149,7 @@ int release_yolov8_obb_model(rknn_app_context_t *app_ctx)
     }
     if (app_ctx->rknn_ctx != 0)
     {
-        rknn_destroy(app_ctx->rknn_ctx);
+        release_model_context(app_ctx->rknn_ctx);
         app_ctx->rknn_ctx = 0;
     }
     return 0;
@@ -204,7 +204,10 @@ int inference_yolov8_obb_model(rknn_app_context_t *app_ctx, image_buffer_t *img,
     inputs[0].size = app_ctx->model_width * app_ctx->model_height * app_ctx->model_channel;
     inputs[0].buf = dst_img.virt_addr;
 
-    ret = rknn_inputs_set(app_ctx->rknn_ctx, app_ctx->io_num.n_input, inputs);
+    {
+        TRACE_ZONE(TRACE_STAGE_INPUTS_SET, "rknn_inputs_set");
+        ret = rknn_inputs_set(app_ctx->rknn_ctx, app_ctx->io_num.n_input, inputs);
+    }
     if (ret < 0)
     {
         printf("rknn_input_set fail! ret=%d\n", ret);
@@ -212,10 +215,13 @@ int inference_yolov8_obb_model(rknn_app_context_t *app_ctx, image_buffer_t *img,
     }
 
     // Run
-    printf("rknn_run\n");
+    TRACE_LOG("rknn_run\n");
     int start_us,end_us;
     start_us = getCurrentTimeUs();
-    ret = rknn_run(app_ctx->rknn_ctx, nullptr);
+    {
+        TRACE_ZONE(TRACE_STAGE_RUN, "rknn_run");
+        ret = rknn_run(app_ctx->rknn_ctx, nullptr);
+    }
     end_us = getCurrentTimeUs() - start_us;
     printf("rknn_run time=%.2fms, FPS = %.2f\n",end_us / 1000.f, 
             1000.f * 1000.f / end_us);
@@ -233,7 +239,10 @@ int inference_yolov8_obb_model(rknn_app_context_t *app_ctx, image_buffer_t *img,
         outputs[i].index = i;
         outputs[i].want_float = (!app_ctx->is_quant);
     }
-    ret = rknn_outputs_get(app_ctx->rknn_ctx, app_ctx->io_num.n_output, outputs, NULL);
+    {
+        TRACE_ZONE(TRACE_STAGE_OUTPUTS_GET, "rknn_outputs_get");
+        ret = rknn_outputs_get(app_ctx->rknn_ctx, app_ctx->io_num.n_output, outputs, NULL);
+    }
     if (ret < 0)
     {
         printf("rknn_outputs_get fail! ret=%d\n", ret);
@@ -241,7 +250,10 @@ int inference_yolov8_obb_model(rknn_app_context_t *app_ctx, image_buffer_t *img,
     }
     // Post Process
     start_us = getCurrentTimeUs();
-    post_process(app_ctx, outputs, &letter_box, box_conf_threshold, nms_threshold, od_results);
+    {
+        TRACE_ZONE(TRACE_STAGE_POSTPROCESS, "post_process");
+        post_process(app_ctx, outputs, &letter_box, box_conf_threshold, nms_threshold, od_results);
+    }
     end_us = getCurrentTimeUs() - start_us;
     printf("post_process time=%.2fms, FPS = %.2f\n",end_us / 1000.f, 
             1000.f * 1000.f / end_us);
@@ -0,0 +1,199 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// nms and make_rotated_box are file static, the test builds the post-process source itself
+#include "postprocess.cc"
+
+static double now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static float rand_float(float lo, float hi)
+{
+    return lo + (hi - lo) * (float)rand() / (float)RAND_MAX;
+}
+
+static bool inside_box(double px, double py, const float *loc)
+{
+    double cx = loc[0] + loc[2] / 2.0;
+    double cy = loc[1] + loc[3] / 2.0;
+    double dx = px - cx;
+    double dy = py - cy;
+    double u = cos(loc[4]) * dx + sin(loc[4]) * dy;
+    double v = -sin(loc[4]) * dx + cos(loc[4]) * dy;
+    return fabs(u) <= loc[2] / 2.0 && fabs(v) <= loc[3] / 2.0;
+}
+
+// IoU from point samples on a grid covering both boxes
+static double sampled_iou(const float *a, const float *b)
+{
+    const int samples = 512;
+    double r = sqrt(a[2] * a[2] + a[3] * a[3]) / 2 + sqrt(b[2] * b[2] + b[3] * b[3]) / 2;
+    double cx = (a[0] + a[2] / 2.0 + b[0] + b[2] / 2.0) / 2;
+    double cy = (a[1] + a[3] / 2.0 + b[1] + b[3] / 2.0) / 2;
+    double half = r + fabs(a[0] + a[2] / 2.0 - cx) + fabs(a[1] + a[3] / 2.0 - cy);
+    int in_a = 0, in_b = 0, both = 0;
+    for (int i = 0; i < samples; i++)
+    {
+        for (int j = 0; j < samples; j++)
+        {
+            double px = cx - half + 2 * half * (i + 0.5) / samples;
+            double py = cy - half + 2 * half * (j + 0.5) / samples;
+            bool ia = inside_box(px, py, a);
+            bool ib = inside_box(px, py, b);
+            in_a += ia;
+            in_b += ib;
+            both += ia && ib;
+        }
+    }
+    int uni = in_a + in_b - both;
+    return uni > 0 ? (double)both / uni : 0;
+}
+
+static float box_iou(const float *a, const float *b)
+{
+    return Cal_IOU(a[0], a[1], a[2], a[3], a[4], b[0], b[1], b[2], b[3], b[4]);
+}
+
+static int check_iou()
+{
+    srand(3);
+    int ret = 0;
+
+    // axis aligned, and rotated by a quarter turn with w/h swapped, have an exact overlap
+    double max_exact = 0;
+    for (int t = 0; t < 100000; t++)
+    {
+        float a[5] = {rand_float(0, 100), rand_float(0, 100), rand_float(1, 60), rand_float(1, 60), 0};
+        float b[5] = {a[0] + rand_float(-50, 50), a[1] + rand_float(-50, 50), rand_float(1, 60), rand_float(1, 60), 0};
+        double w = fmax(0.0, fmin(a[0] + a[2], b[0] + b[2]) - fmax(a[0], b[0]));
+        double h = fmax(0.0, fmin(a[1] + a[3], b[1] + b[3]) - fmax(a[1], b[1]));
+        double exact = w * h / ((double)a[2] * a[3] + (double)b[2] * b[3] - w * h);
+        if (t % 2 == 1)
+        {
+            // same box turned 90 degrees about its center
+            float cx = b[0] + b[2] / 2, cy = b[1] + b[3] / 2;
+            float bw = b[2];
+            b[2] = b[3];
+            b[3] = bw;
+            b[0] = cx - b[2] / 2;
+            b[1] = cy - b[3] / 2;
+            b[4] = (float)M_PI / 2;
+        }
+        max_exact = fmax(max_exact, fabs(box_iou(a, b) - exact));
+    }
+    printf("Cal_IOU axis aligned: max abs err %.2e\n", max_exact);
+    ret |= max_exact < 1e-4 ? 0 : -1;
+
+    // arbitrary angles, every tenth pair is a near identical box
+    double max_sampled = 0, max_sym = 0;
+    for (int t = 0; t < 2000; t++)
+    {
+        float a[5] = {rand_float(0, 100), rand_float(0, 100), rand_float(4, 60), rand_float(4, 60), rand_float(-3.2f, 3.2f)};
+        float b[5] = {a[0] + rand_float(-40, 40), a[1] + rand_float(-40, 40), rand_float(4, 60), rand_float(4, 60),
+                      rand_float(-3.2f, 3.2f)};
+        if (t % 10 == 0)
+        {
+            b[0] = a[0];
+            b[1] = a[1];
+            b[2] = a[2];
+            b[3] = a[3];
+            b[4] = a[4] + rand_float(-0.01f, 0.01f);
+        }
+        float iou = box_iou(a, b);
+        max_sampled = fmax(max_sampled, fabs(iou - sampled_iou(a, b)));
+        max_sym = fmax(max_sym, fabs(iou - box_iou(b, a)));
+        if (iou < 0 || iou > 1.0001f)
+        {
+            printf("Cal_IOU out of range: %f\n", iou);
+            ret = -1;
+        }
+    }
+    printf("Cal_IOU rotated: max abs diff to sampled area %.2e, asymmetry %.2e\n", max_sampled, max_sym);
+    ret |= max_sampled < 0.02 && max_sym < 1e-4 ? 0 : -1;
+    return ret;
+}
+
+// every kept box suppresses the later candidates of its class above threshold, one pair at a time
+static void reference_nms(int count, std::vector<float> &loc, std::vector<int> &cls, std::vector<int> &order, float threshold)
+{
+    for (int i = 0; i < count; i++)
+    {
+        int a = order[i];
+        if (a == -1)
+        {
+            continue;
+        }
+        for (int j = i + 1; j < count; j++)
+        {
+            int b = order[j];
+            if (b == -1 || cls[b] != cls[a])
+            {
+                continue;
+            }
+            if (box_iou(&loc[a * 5], &loc[b * 5]) > threshold)
+            {
+                order[j] = -1;
+            }
+        }
+    }
+}
+
+static int check_nms()
+{
+    srand(5);
+    const int scenes = 50;
+    const int count = 2000;
+    int mismatch = 0;
+    double ref_ms = 0, nms_ms = 0;
+    for (int t = 0; t < scenes; t++)
+    {
+        std::vector<float> loc(count * 5);
+        std::vector<int> cls(count), ref_order(count), order(count);
+        for (int i = 0; i < count; i++)
+        {
+            loc[i * 5 + 0] = rand_float(0, 1000);
+            loc[i * 5 + 1] = rand_float(0, 1000);
+            loc[i * 5 + 2] = rand_float(5, 40);
+            loc[i * 5 + 3] = rand_float(5, 40);
+            loc[i * 5 + 4] = rand_float(-1.6f, 1.6f);
+            cls[i] = rand() % OBJ_CLASS_NUM;
+            ref_order[i] = i;
+        }
+        // random score order
+        for (int i = count - 1; i > 0; i--)
+        {
+            std::swap(ref_order[i], ref_order[rand() % (i + 1)]);
+        }
+        order = ref_order;
+
+        double t0 = now_ms();
+        reference_nms(count, loc, cls, ref_order, NMS_THRESH);
+        double t1 = now_ms();
+        nms(count, loc, cls, order, NMS_THRESH);
+        double t2 = now_ms();
+        ref_ms += t1 - t0;
+        nms_ms += t2 - t1;
+        for (int i = 0; i < count; i++)
+        {
+            mismatch += ref_order[i] != order[i];
+        }
+    }
+    printf("nms: %d scenes of %d boxes, reference %.2f ms, nms %.2f ms, %d mismatches\n", scenes, count,
+           ref_ms / scenes, nms_ms / scenes, mismatch);
+    return mismatch == 0 ? 0 : -1;
+}
+
+int main()
+{
+    int ret = 0;
+    ret |= check_iou();
+    ret |= check_nms();
+    printf("%s\n", ret == 0 ? "PASS" : "FAIL");
+    return ret == 0 ? 0 : 1;
+}
@@ -20,6 +20,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/time.h>
+#include "dfl_utils.h"
 
 #ifndef RKNPU1
 #include <Float16.h>
@@ -206,24 +207,6 @@ static float deqnt_affine_u8_to_f32(uint8_t qnt, int32_t zp, float scale) {
 
 
 
-void softmax(float *input, int size) {
-    float max_val = input[0];
-    for (int i = 1; i < size; ++i) {
-        if (input[i] > max_val) {
-            max_val = input[i];
-        }
-    }
-
-    float sum_exp = 0.0;
-    for (int i = 0; i < size; ++i) {
-        sum_exp += expf(input[i] - max_val);
-    }
-
-    for (int i = 0; i < size; ++i) {
-        input[i] = expf(input[i] - max_val) / sum_exp;
-    }
-}
-
 static int process_i8(int8_t *input, int grid_h, int grid_w, int stride,
                       std::vector<float> &boxes, std::vector<float> &boxScores, std::vector<int> &classId, float threshold,
                       int32_t zp, float scale, int index) {
@@ -232,28 +215,17 @@ static int process_i8(int8_t *input, int grid_h, int grid_w, int stride,
     int validCount = 0;
 
     int8_t thres_i8 = qnt_f32_to_affine(unsigmoid(threshold), zp, scale);
+    dfl_exp_table_t dfl_table;
+    init_dfl_exp_table_i8(&dfl_table, zp, scale);
     for (int h = 0; h < grid_h; h++) {
         for (int w = 0; w < grid_w; w++) {
             for (int a = 0; a < OBJ_CLASS_NUM; a++) {
                 if(input[(input_loc_len + a)*grid_w * grid_h + h * grid_w + w ] >= thres_i8) { //[1,tensor_len,grid_h,grid_w]
                     float box_conf_f32 = sigmoid(deqnt_affine_to_f32(input[(input_loc_len + a) * grid_w * grid_h + h * grid_w + w ],
                                                  zp, scale));
-                    float loc[input_loc_len];
-                    for (int i = 0; i < input_loc_len; ++i) {
-                        loc[i] = deqnt_affine_to_f32(input[i * grid_w * grid_h + h * grid_w + w], zp, scale);
-                    }
-
-                    for (int i = 0; i < input_loc_len / 16; ++i) {
-                        softmax(&loc[i * 16], 16);
-                    }
-                    float xywh_[4] = {0, 0, 0, 0};
+                    float xywh_[4];
                     float xywh[4] = {0, 0, 0, 0};
-                    for (int dfl = 0; dfl < 16; ++dfl) {
-                        xywh_[0] += loc[dfl] * dfl;
-                        xywh_[1] += loc[1 * 16 + dfl] * dfl;
-                        xywh_[2] += loc[2 * 16 + dfl] * dfl;
-                        xywh_[3] += loc[3 * 16 + dfl] * dfl;
-                    }
+                    dfl_decode_i8(input + h * grid_w + w, grid_w * grid_h, 16, &dfl_table, xywh_);
                     xywh_[0]=(w+0.5)-xywh_[0];
                     xywh_[1]=(h+0.5)-xywh_[1];
                     xywh_[2]=(w+0.5)+xywh_[2];
@@ -288,28 +260,17 @@ static int process_u8(uint8_t *input, int grid_h, int grid_w, int stride,
     int validCount = 0;
 
     uint8_t thres_i8 = qnt_f32_to_affine_u8(unsigmoid(threshold), zp, scale);
+    dfl_exp_table_t dfl_table;
+    init_dfl_exp_table_u8(&dfl_table, zp, scale);
     for (int h = 0; h < grid_h; h++) {
         for (int w = 0; w < grid_w; w++) {
             for (int a = 0; a < OBJ_CLASS_NUM; a++) {
                 if(input[(input_loc_len + a)*grid_w * grid_h + h * grid_w + w ] >= thres_i8) { //[1,tensor_len,grid_h,grid_w]
                     float box_conf_f32 = sigmoid(deqnt_affine_u8_to_f32(input[(input_loc_len + a) * grid_w * grid_h + h * grid_w + w ],
                                                  zp, scale));
-                    float loc[input_loc_len];
-                    for (int i = 0; i < input_loc_len; ++i) {
-                        loc[i] = deqnt_affine_u8_to_f32(input[i * grid_w * grid_h + h * grid_w + w], zp, scale);
-                    }
-
-                    for (int i = 0; i < input_loc_len / 16; ++i) {
-                        softmax(&loc[i * 16], 16);
-                    }
-                    float xywh_[4] = {0, 0, 0, 0};
+                    float xywh_[4];
                     float xywh[4] = {0, 0, 0, 0};
-                    for (int dfl = 0; dfl < 16; ++dfl) {
-                        xywh_[0] += loc[dfl] * dfl;
-                        xywh_[1] += loc[1 * 16 + dfl] * dfl;
-                        xywh_[2] += loc[2 * 16 + dfl] * dfl;
-                        xywh_[3] += loc[3 * 16 + dfl] * dfl;
-                    }
+                    dfl_decode_u8(input + h * grid_w + w, grid_w * grid_h, 16, &dfl_table, xywh_);
                     xywh_[0]=(w+0.5)-xywh_[0];
                     xywh_[1]=(h+0.5)-xywh_[1];
                     xywh_[2]=(w+0.5)+xywh_[2];
@@ -347,22 +308,9 @@ static int process_fp32(float *input, int grid_h, int grid_w, int stride,
             for (int a = 0; a < OBJ_CLASS_NUM; a++) {
                 if(input[(input_loc_len + a)*grid_w * grid_h + h * grid_w + w ] >= thres_fp) { //[1,tensor_len,grid_h,grid_w]
                     float box_conf_f32 = sigmoid(input[(input_loc_len + a) * grid_w * grid_h + h * grid_w + w ]);
-                    float loc[input_loc_len];
-                    for (int i = 0; i < input_loc_len; ++i) {
-                        loc[i] = input[i * grid_w * grid_h + h * grid_w + w];
-                    }
-
-                    for (int i = 0; i < input_loc_len / 16; ++i) {
-                        softmax(&loc[i * 16], 16);
-                    }
-                    float xywh_[4] = {0, 0, 0, 0};
+                    float xywh_[4];
                     float xywh[4] = {0, 0, 0, 0};
-                    for (int dfl = 0; dfl < 16; ++dfl) {
-                        xywh_[0] += loc[dfl] * dfl;
-                        xywh_[1] += loc[1 * 16 + dfl] * dfl;
-                        xywh_[2] += loc[2 * 16 + dfl] * dfl;
-                        xywh_[3] += loc[3 * 16 + dfl] * dfl;
-                    }
+                    dfl_decode_f32(input + h * grid_w + w, grid_w * grid_h, 16, xywh_);
                     xywh_[0]=(w+0.5)-xywh_[0];
                     xywh_[1]=(h+0.5)-xywh_[1];
                     xywh_[2]=(w+0.5)+xywh_[2];
@@ -388,6 +336,153 @@ static int process_fp32(float *input, int grid_h, int grid_w, int stride,
     return validCount;
 }
 
+// keypoints of one anchor, read from the [17 * 3, anchors] keypoint output
+static void decode_keypoints(const void *kpt, rknn_tensor_type type, int32_t zp, float scale, int anchors, int anchor,
+                             const letterbox_t *letter_box, float keypoints[17][3]) {
+    float v[17 * 3];
+    switch (type) {
+    case RKNN_TENSOR_INT8: {
+        const int8_t *p = (const int8_t *)kpt + anchor;
+        for (int k = 0; k < 17 * 3; k++) {
+            v[k] = deqnt_affine_to_f32(p[k * anchors], zp, scale);
+        }
+        break;
+    }
+    case RKNN_TENSOR_UINT8: {
+        const uint8_t *p = (const uint8_t *)kpt + anchor;
+        for (int k = 0; k < 17 * 3; k++) {
+            v[k] = deqnt_affine_u8_to_f32(p[k * anchors], zp, scale);
+        }
+        break;
+    }
+#ifndef RKNPU1
+    case RKNN_TENSOR_FLOAT16: {
+        const rknpu2::float16 *p = (const rknpu2::float16 *)kpt + anchor;
+        for (int k = 0; k < 17 * 3; k++) {
+            v[k] = (float)p[k * anchors];
+        }
+        break;
+    }
+#endif
+    default: {
+        const float *p = (const float *)kpt + anchor;
+        for (int k = 0; k < 17 * 3; k++) {
+            v[k] = p[k * anchors];
+        }
+        break;
+    }
+    }
+    for (int j = 0; j < 17; j++) {
+        keypoints[j][0] = (v[j * 3 + 0] - letter_box->x_pad) / letter_box->scale;
+        keypoints[j][1] = (v[j * 3 + 1] - letter_box->y_pad) / letter_box->scale;
+        keypoints[j][2] = v[j * 3 + 2];
+    }
+}
+
+pose_workspace_t *create_pose_workspace() {
+    pose_workspace_t *workspace = new pose_workspace_t();
+    workspace->tracking = false;
+    workspace->keypoint_smooth = 0.f;
+    workspace->next_track_id = 0;
+    workspace->track_count = 0;
+    return workspace;
+}
+
+void destroy_pose_workspace(pose_workspace_t *workspace) {
+    delete workspace;
+}
+
+void set_pose_tracking(rknn_app_context_t *app_ctx, bool enable, float keypoint_smooth) {
+    pose_workspace_t *workspace = app_ctx->post_workspace;
+    if (workspace == NULL) {
+        return;
+    }
+    if (keypoint_smooth < 0.f || keypoint_smooth >= 1.f) {
+        keypoint_smooth = 0.f;
+    }
+    workspace->tracking = enable;
+    workspace->keypoint_smooth = keypoint_smooth;
+    workspace->track_count = 0;
+}
+
+static float rect_iou(const image_rect_t *a, const image_rect_t *b) {
+    float w = fmax(0.f, fmin(a->right, b->right) - fmax(a->left, b->left));
+    float h = fmax(0.f, fmin(a->bottom, b->bottom) - fmax(a->top, b->top));
+    float i = w * h;
+    float u = (float)(a->right - a->left) * (a->bottom - a->top) + (float)(b->right - b->left) * (b->bottom - b->top) - i;
+    return u <= 0.f ? 0.f : (i / u);
+}
+
+// greedy IoU matching in score order against the tracks of the previous frames, tracks live in the workspace
+static void track_poses(pose_workspace_t *workspace, object_detect_result_list *od_results) {
+    bool matched[OBJ_NUMB_MAX_SIZE] = {false};
+    bool is_new[OBJ_NUMB_MAX_SIZE] = {false};
+    float smooth = workspace->keypoint_smooth;
+    for (int d = 0; d < od_results->count; d++) {
+        object_detect_result *det = &od_results->results[d];
+        int best = -1;
+        float best_iou = POSE_TRACK_IOU_THRESH;
+        for (int t = 0; t < workspace->track_count; t++) {
+            pose_track_t *track = &workspace->tracks[t];
+            if (matched[t] || track->cls_id != det->cls_id) {
+                continue;
+            }
+            float iou = rect_iou(&track->box, &det->box);
+            if (iou >= best_iou) {
+                best_iou = iou;
+                best = t;
+            }
+        }
+        if (best < 0) {
+            is_new[d] = true;
+            continue;
+        }
+        pose_track_t *track = &workspace->tracks[best];
+        matched[best] = true;
+        if (smooth > 0.f) {
+            for (int j = 0; j < 17; j++) {
+                det->keypoints[j][0] = smooth * track->keypoints[j][0] + (1.f - smooth) * det->keypoints[j][0];
+                det->keypoints[j][1] = smooth * track->keypoints[j][1] + (1.f - smooth) * det->keypoints[j][1];
+            }
+        }
+        det->track_id = track->id;
+        track->missed = 0;
+        track->box = det->box;
+        memcpy(track->keypoints, det->keypoints, sizeof(track->keypoints));
+    }
+
+    // age the unmatched tracks, drop the ones lost for too long
+    int count = 0;
+    for (int t = 0; t < workspace->track_count; t++) {
+        pose_track_t *track = &workspace->tracks[t];
+        if (!matched[t] && ++track->missed > POSE_TRACK_MAX_MISSED) {
+            continue;
+        }
+        if (count != t) {
+            workspace->tracks[count] = *track;
+        }
+        count++;
+    }
+    workspace->track_count = count;
+
+    for (int d = 0; d < od_results->count; d++) {
+        if (!is_new[d]) {
+            continue;
+        }
+        object_detect_result *det = &od_results->results[d];
+        det->track_id = workspace->next_track_id++;
+        if (workspace->track_count >= OBJ_NUMB_MAX_SIZE) {
+            continue;
+        }
+        pose_track_t *track = &workspace->tracks[workspace->track_count++];
+        track->id = det->track_id;
+        track->cls_id = det->cls_id;
+        track->missed = 0;
+        track->box = det->box;
+        memcpy(track->keypoints, det->keypoints, sizeof(track->keypoints));
+    }
+}
+
 int post_process(rknn_app_context_t *app_ctx, void *outputs, letterbox_t *letter_box, float conf_threshold, float nms_threshold,
                  object_detect_result_list *od_results) {
 #if defined(RV1106_1103)
@@ -395,9 +490,18 @@ int post_process(rknn_app_context_t *app_ctx, void *outputs, letterbox_t *letter
 #else
     rknn_output *_outputs = (rknn_output *)outputs;
 #endif
-    std::vector<float> filterBoxes;
-    std::vector<float> objProbs;
-    std::vector<int> classId;
+    pose_workspace_t *workspace = app_ctx->post_workspace;
+    if (workspace == NULL) {
+        printf("pose post-process workspace not created\n");
+        return -1;
+    }
+    std::vector<float> &filterBoxes = workspace->filterBoxes;
+    std::vector<float> &objProbs = workspace->objProbs;
+    std::vector<int> &classId = workspace->classId;
+    std::vector<int> &indexArray = workspace->indexArray;
+    filterBoxes.clear();
+    objProbs.clear();
+    classId.clear();
     int validCount = 0;
     int stride = 0;
     int grid_h = 0;
@@ -441,9 +545,12 @@ int post_process(rknn_app_context_t *app_ctx, void *outputs, letterbox_t *letter
 #endif
     // no object detect
     if (validCount <= 0) {
+        if (workspace->tracking) {
+            track_poses(workspace, od_results);
+        }
         return 0;
     }
-    std::vector<int> indexArray;
+    indexArray.clear();
     for (int i = 0; i < validCount; ++i) {
         indexArray.push_back(i);
     }
@@ -458,6 +565,11 @@ int post_process(rknn_app_context_t *app_ctx, void *outputs, letterbox_t *letter
     int last_count = 0;
     od_results->count = 0;
 
+    // keypoints are only gathered for the candidates that survive NMS
+    const void *kpt = _outputs[3].buf;
+    rknn_tensor_type kpt_type = app_ctx->is_quant ? app_ctx->output_attrs[3].type : RKNN_TENSOR_FLOAT32;
+    int kpt_anchors = app_ctx->output_attrs[3].n_elems / (17 * 3);
+
     /* box valid detect target */
     for (int i = 0; i < validCount; ++i) {
         if (indexArray[i] == -1 || last_count >= OBJ_NUMB_MAX_SIZE) {
@@ -470,32 +582,8 @@ int post_process(rknn_app_context_t *app_ctx, void *outputs, letterbox_t *letter
         float h = filterBoxes[n * 5 + 3];
         int keypoints_index = (int)filterBoxes[n * 5 + 4];
 
-        for (int j = 0; j < 17; ++j) {
-            if (app_ctx->is_quant) {
-                #ifdef RKNPU1
-                        od_results->results[last_count].keypoints[j][0] = (deqnt_affine_u8_to_f32(((uint8_t *)_outputs[3].buf)[j * 3 * 8400 + 0 * 8400 + keypoints_index],
-                                app_ctx->output_attrs[3].zp, app_ctx->output_attrs[3].scale)- letter_box->x_pad)/ letter_box->scale;
-                        od_results->results[last_count].keypoints[j][1] = (deqnt_affine_u8_to_f32(((uint8_t *)_outputs[3].buf)[j * 3 * 8400 + 1 * 8400 + keypoints_index],
-                                app_ctx->output_attrs[3].zp, app_ctx->output_attrs[3].scale)- letter_box->y_pad)/ letter_box->scale;
-                        od_results->results[last_count].keypoints[j][2] = deqnt_affine_u8_to_f32(((uint8_t *)_outputs[3].buf)[j * 3 * 8400 + 2 * 8400 + keypoints_index],
-                                app_ctx->output_attrs[3].zp, app_ctx->output_attrs[3].scale);       
-                #else
-                        od_results->results[last_count].keypoints[j][0] = ((float)((rknpu2::float16 *)_outputs[3].buf)[j*3*8400+0*8400+keypoints_index] 
-                                                                        - letter_box->x_pad)/ letter_box->scale;
-                        od_results->results[last_count].keypoints[j][1] = ((float)((rknpu2::float16 *)_outputs[3].buf)[j*3*8400+1*8400+keypoints_index] 
-                                                                            - letter_box->y_pad)/ letter_box->scale;
-                        od_results->results[last_count].keypoints[j][2] = (float)((rknpu2::float16 *)_outputs[3].buf)[j*3*8400+2*8400+keypoints_index];
-                #endif
-            }
-            else
-            {
-                od_results->results[last_count].keypoints[j][0] = (((float *)_outputs[3].buf)[j*3*8400+0*8400+keypoints_index] 
-                                                                - letter_box->x_pad)/ letter_box->scale;
-                od_results->results[last_count].keypoints[j][1] = (((float *)_outputs[3].buf)[j*3*8400+1*8400+keypoints_index] 
-                                                                    - letter_box->y_pad)/ letter_box->scale;
-                od_results->results[last_count].keypoints[j][2] = ((float *)_outputs[3].buf)[j*3*8400+2*8400+keypoints_index];
-            }
-        }
+        decode_keypoints(kpt, kpt_type, app_ctx->output_attrs[3].zp, app_ctx->output_attrs[3].scale, kpt_anchors,
+                         keypoints_index, letter_box, od_results->results[last_count].keypoints);
 
         int id = classId[n];
         float obj_conf = objProbs[i];
@@ -506,9 +594,13 @@ int post_process(rknn_app_context_t *app_ctx, void *outputs, letterbox_t *letter
         // od_results->results[last_count].box.angle = angle;
         od_results->results[last_count].prop = obj_conf;
         od_results->results[last_count].cls_id = id;
+        od_results->results[last_count].track_id = -1;
         last_count++;
     }
     od_results->count = last_count;
+    if (workspace->tracking) {
+        track_poses(workspace, od_results);
+    }
     return 0;
 }
 
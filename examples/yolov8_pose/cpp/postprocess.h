@@ -13,6 +13,9 @@
 #define NMS_THRESH 0.4
 #define BOX_THRESH 0.5
 #define PROP_BOX_SIZE (5 + OBJ_CLASS_NUM)
+// tracking: IoU a detection needs with a track of the previous frames, frames a track survives unmatched
+#define POSE_TRACK_IOU_THRESH 0.3
+#define POSE_TRACK_MAX_MISSED 10
 
 // class rknn_app_context_t;
 
@@ -21,6 +24,7 @@ typedef struct {
     float keypoints[17][3];//keypoints x,y,conf
     float prop;
     int cls_id;
+    int track_id;   // tracking mode: identity kept across frames, else -1
 } object_detect_result;
 
 typedef struct {
@@ -29,6 +33,43 @@ typedef struct {
     object_detect_result results[OBJ_NUMB_MAX_SIZE];
 } object_detect_result_list;
 
+typedef struct {
+    int id;
+    int cls_id;
+    int missed;     // frames since it was last matched
+    image_rect_t box;
+    float keypoints[17][3];
+} pose_track_t;
+
+/**
+ * @brief Post-process state of one model context, buffers keep their capacity between frames
+ *
+ */
+typedef struct pose_workspace {
+    std::vector<float> filterBoxes;
+    std::vector<float> objProbs;
+    std::vector<int> classId;
+    std::vector<int> indexArray;
+
+    bool tracking;
+    float keypoint_smooth;
+    int next_track_id;
+    int track_count;
+    pose_track_t tracks[OBJ_NUMB_MAX_SIZE];
+} pose_workspace_t;
+
+pose_workspace_t *create_pose_workspace();
+void destroy_pose_workspace(pose_workspace_t *workspace);
+
+/**
+ * @brief Multi-person tracking mode, detections get a track_id and their keypoints are smoothed with the matched track
+ *
+ * @param app_ctx [in] Model context
+ * @param enable [in] Enable tracking, disabling forgets all tracks
+ * @param keypoint_smooth [in] Weight of the previous frame keypoints, 0: no smoothing, < 1
+ */
+void set_pose_tracking(rknn_app_context_t *app_ctx, bool enable, float keypoint_smooth);
+
 int init_post_process();
 void deinit_post_process();
 char *coco_cls_to_name(int cls_id);
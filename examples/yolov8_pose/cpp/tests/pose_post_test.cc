@@ -0,0 +1,277 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "yolov8-pose.h"
+
+// float outputs of a 640x640 model: 3 heads [1, 64 + 1, h, w] and keypoints [1, 17 * 3, 8400]
+#define MODEL_SIZE 640
+#define NUM_HEADS 3
+#define TENSOR_LEN (64 + OBJ_CLASS_NUM)
+
+static const int g_grids[NUM_HEADS] = {80, 40, 20};
+
+typedef struct {
+    float cx, cy, w, h;
+    float kpt_shift;
+} person_t;
+
+typedef struct {
+    rknn_app_context_t app_ctx;
+    rknn_tensor_attr attrs[NUM_HEADS + 1];
+    float *heads[NUM_HEADS];
+    float *kpt;
+    int anchors;
+} fake_model_t;
+
+static void init_fake_model(fake_model_t *m)
+{
+    memset(m, 0, sizeof(fake_model_t));
+    m->anchors = 0;
+    for (int i = 0; i < NUM_HEADS; i++)
+    {
+        int g = g_grids[i];
+        m->attrs[i].n_dims = 4;
+        m->attrs[i].dims[0] = 1;
+        m->attrs[i].dims[1] = TENSOR_LEN;
+        m->attrs[i].dims[2] = g;
+        m->attrs[i].dims[3] = g;
+        m->attrs[i].n_elems = TENSOR_LEN * g * g;
+        m->heads[i] = (float *)malloc(m->attrs[i].n_elems * sizeof(float));
+        m->anchors += g * g;
+    }
+    m->attrs[NUM_HEADS].n_elems = 17 * 3 * m->anchors;
+    m->kpt = (float *)calloc(m->attrs[NUM_HEADS].n_elems, sizeof(float));
+    m->app_ctx.output_attrs = m->attrs;
+    m->app_ctx.model_width = MODEL_SIZE;
+    m->app_ctx.model_height = MODEL_SIZE;
+    m->app_ctx.is_quant = false;
+    m->app_ctx.post_workspace = create_pose_workspace();
+}
+
+static void release_fake_model(fake_model_t *m)
+{
+    for (int i = 0; i < NUM_HEADS; i++)
+    {
+        free(m->heads[i]);
+    }
+    free(m->kpt);
+    destroy_pose_workspace(m->app_ctx.post_workspace);
+}
+
+// distribution over 16 bins whose expectation is d
+static void write_distance(float *side, int step, float d)
+{
+    int lo = (int)d;
+    float frac = d - lo;
+    for (int i = 0; i < 16; i++)
+    {
+        side[i * step] = -50.f;
+    }
+    side[lo * step] = frac < 1.f ? logf(1.f - frac) : -50.f;
+    if (lo + 1 < 16 && frac > 0.f)
+    {
+        side[(lo + 1) * step] = logf(frac);
+    }
+}
+
+// every person is predicted by one cell of the stride 8 head
+static void render_frame(fake_model_t *m, const person_t *persons, int count)
+{
+    for (int i = 0; i < NUM_HEADS; i++)
+    {
+        int cells = g_grids[i] * g_grids[i];
+        memset(m->heads[i], 0, 64 * cells * sizeof(float));
+        for (int c = 0; c < cells; c++)
+        {
+            m->heads[i][64 * cells + c] = -10.f;
+        }
+    }
+    int g = g_grids[0];
+    int cells = g * g;
+    for (int p = 0; p < count; p++)
+    {
+        const person_t *person = &persons[p];
+        int w = (int)(person->cx / 8);
+        int h = (int)(person->cy / 8);
+        float ax = (w + 0.5f) * 8;
+        float ay = (h + 0.5f) * 8;
+        float *cell = m->heads[0] + h * g + w;
+        write_distance(cell + 0 * 16 * cells, cells, (ax - (person->cx - person->w / 2)) / 8);
+        write_distance(cell + 1 * 16 * cells, cells, (ay - (person->cy - person->h / 2)) / 8);
+        write_distance(cell + 2 * 16 * cells, cells, (person->cx + person->w / 2 - ax) / 8);
+        write_distance(cell + 3 * 16 * cells, cells, (person->cy + person->h / 2 - ay) / 8);
+        cell[64 * cells] = 5.f;
+        int anchor = h * g + w;
+        for (int j = 0; j < 17; j++)
+        {
+            m->kpt[(j * 3 + 0) * m->anchors + anchor] = person->cx + j + person->kpt_shift;
+            m->kpt[(j * 3 + 1) * m->anchors + anchor] = person->cy + j;
+            m->kpt[(j * 3 + 2) * m->anchors + anchor] = 0.9f;
+        }
+    }
+}
+
+static int run_frame(fake_model_t *m, object_detect_result_list *od_results)
+{
+    rknn_output outputs[NUM_HEADS + 1];
+    memset(outputs, 0, sizeof(outputs));
+    for (int i = 0; i < NUM_HEADS; i++)
+    {
+        outputs[i].buf = m->heads[i];
+    }
+    outputs[NUM_HEADS].buf = m->kpt;
+    letterbox_t letter_box = {0, 0, 1.f};
+    return post_process(&m->app_ctx, outputs, &letter_box, BOX_THRESH, NMS_THRESH, od_results);
+}
+
+static int find_track(const object_detect_result_list *od_results, float cx)
+{
+    for (int i = 0; i < od_results->count; i++)
+    {
+        const image_rect_t *box = &od_results->results[i].box;
+        if (fabsf((box->left + box->right) / 2.f - cx) < 8.f)
+        {
+            return od_results->results[i].track_id;
+        }
+    }
+    return -2;
+}
+
+// two people walking towards each other, the second one hidden for three frames
+static int check_tracking()
+{
+    fake_model_t m;
+    init_fake_model(&m);
+    set_pose_tracking(&m.app_ctx, true, 0.f);
+    int id_a = -1, id_b = -1;
+    int ret = 0;
+    for (int f = 0; f < 20; f++)
+    {
+        person_t persons[2] = {{100.f + 4 * f, 200.f, 100.f, 160.f, 0.f}, {400.f - 4 * f, 300.f, 100.f, 160.f, 0.f}};
+        bool hide_b = f >= 8 && f <= 10;
+        render_frame(&m, persons, hide_b ? 1 : 2);
+        object_detect_result_list od_results;
+        if (run_frame(&m, &od_results) != 0 || od_results.count != (hide_b ? 1 : 2))
+        {
+            printf("frame %d: %d detections\n", f, od_results.count);
+            ret = -1;
+            break;
+        }
+        int a = find_track(&od_results, persons[0].cx);
+        int b = hide_b ? id_b : find_track(&od_results, persons[1].cx);
+        if (f == 0)
+        {
+            id_a = a;
+            id_b = b;
+        }
+        if (a != id_a || b != id_b || a < 0 || b < 0 || a == b)
+        {
+            printf("frame %d: track ids %d %d, expected %d %d\n", f, a, b, id_a, id_b);
+            ret = -1;
+        }
+    }
+    release_fake_model(&m);
+
+    // keypoints move by 10 between two frames, half of it shows with smoothing 0.5
+    init_fake_model(&m);
+    set_pose_tracking(&m.app_ctx, true, 0.5f);
+    person_t person = {200.f, 200.f, 100.f, 160.f, 0.f};
+    object_detect_result_list od_results;
+    render_frame(&m, &person, 1);
+    run_frame(&m, &od_results);
+    float x0 = od_results.results[0].keypoints[0][0];
+    person.kpt_shift = 10.f;
+    render_frame(&m, &person, 1);
+    run_frame(&m, &od_results);
+    float x1 = od_results.results[0].keypoints[0][0];
+    if (fabsf(x1 - x0 - 5.f) > 1e-3f)
+    {
+        printf("smoothing: keypoint moved %.3f, expected 5\n", x1 - x0);
+        ret = -1;
+    }
+    release_fake_model(&m);
+    printf("tracking: %s\n", ret == 0 ? "ok" : "fail");
+    return ret;
+}
+
+#define NUM_CONTEXTS 4
+#define NUM_FRAMES 200
+
+typedef struct {
+    int seed;
+    int counts[NUM_FRAMES];
+    object_detect_result results[NUM_FRAMES][8];
+} run_record_t;
+
+// crowded scene of one context, up to 8 people drifting from a seeded start
+static void *run_context(void *arg)
+{
+    run_record_t *record = (run_record_t *)arg;
+    fake_model_t m;
+    init_fake_model(&m);
+    set_pose_tracking(&m.app_ctx, true, 0.3f);
+    unsigned int seed = record->seed;
+    person_t persons[8];
+    for (int p = 0; p < 8; p++)
+    {
+        persons[p].cx = 80.f + 60.f * p;
+        persons[p].cy = 120.f + (rand_r(&seed) % 400);
+        persons[p].w = 40.f + rand_r(&seed) % 60;
+        persons[p].h = 80.f + rand_r(&seed) % 80;
+        persons[p].kpt_shift = 0.f;
+    }
+    for (int f = 0; f < NUM_FRAMES; f++)
+    {
+        int count = 3 + rand_r(&seed) % 6;
+        for (int p = 0; p < count; p++)
+        {
+            persons[p].cy += (int)(rand_r(&seed) % 5) - 2;
+            persons[p].kpt_shift = (float)(rand_r(&seed) % 7);
+        }
+        render_frame(&m, persons, count);
+        object_detect_result_list od_results;
+        run_frame(&m, &od_results);
+        record->counts[f] = od_results.count;
+        memcpy(record->results[f], od_results.results, od_results.count * sizeof(object_detect_result));
+    }
+    release_fake_model(&m);
+    return NULL;
+}
+
+static int check_concurrent_contexts()
+{
+    static run_record_t serial[NUM_CONTEXTS];
+    static run_record_t threaded[NUM_CONTEXTS];
+    memset(serial, 0, sizeof(serial));
+    memset(threaded, 0, sizeof(threaded));
+    for (int i = 0; i < NUM_CONTEXTS; i++)
+    {
+        serial[i].seed = threaded[i].seed = 100 + i;
+        run_context(&serial[i]);
+    }
+    pthread_t threads[NUM_CONTEXTS];
+    for (int i = 0; i < NUM_CONTEXTS; i++)
+    {
+        pthread_create(&threads[i], NULL, run_context, &threaded[i]);
+    }
+    for (int i = 0; i < NUM_CONTEXTS; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    int ret = memcmp(serial, threaded, sizeof(serial)) == 0 ? 0 : -1;
+    printf("%d contexts x %d frames on threads: %s serial results\n", NUM_CONTEXTS, NUM_FRAMES,
+           ret == 0 ? "same as" : "differ from");
+    return ret;
+}
+
+int main()
+{
+    int ret = 0;
+    ret |= check_tracking();
+    ret |= check_concurrent_contexts();
+    printf("%s\n", ret == 0 ? "PASS" : "FAIL");
+    return ret == 0 ? 0 : 1;
+}
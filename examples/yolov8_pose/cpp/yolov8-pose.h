@@ -30,6 +30,7 @@ typedef struct {
     int model_width;
     int model_height;
     bool is_quant;
+    struct pose_workspace* post_workspace;
 } rknn_app_context_t;
 
 #include "postprocess.h"
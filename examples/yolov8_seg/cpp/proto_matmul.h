@@ -0,0 +1,97 @@
+#ifndef _RKNN_YOLOV8_SEG_DEMO_PROTO_MATMUL_H_
+#define _RKNN_YOLOV8_SEG_DEMO_PROTO_MATMUL_H_
+
+#include <stdint.h>
+
+// instances per NPU matmul run, A is padded to this many rows
+#define PROTO_MATMUL_MAX_M 32
+// below this many multiply-accumulates the box-restricted CPU path beats an NPU launch
+#define PROTO_MATMUL_NPU_MIN_MACS (6 * 1024 * 1024)
+
+/**
+ * @brief Where the coefficient x prototype product of a frame is computed
+ *
+ */
+typedef enum {
+    PROTO_MATMUL_BOX = 0,   // only inside each box, by the mask engine
+    PROTO_MATMUL_NPU,       // full plane logits on the NPU
+    PROTO_MATMUL_CPU,       // full plane logits with proto_matmul_cpu, NPU unavailable
+} proto_matmul_backend_t;
+
+/**
+ * @brief Mask coefficient x prototype matmul, created once for the prototype shape
+ *
+ */
+typedef struct {
+    int max_m;
+    int k;
+    int n;
+    bool is_quant;
+    int32_t proto_zp;
+    float proto_scale;
+    long npu_min_macs;
+    float *logits;      // max_m * n, result of the last run
+    void *npu;          // NULL: NPU unavailable, runs the CPU reference
+} proto_matmul_t;
+
+/**
+ * @brief Create matmul for prototypes of shape k * n
+ *
+ * @param pm [out] Matmul
+ * @param k [in] Prototype channels
+ * @param n [in] Prototype height * width
+ * @param is_quant [in] Prototype is int8 with proto_zp/proto_scale, else float
+ * @param proto_zp [in] Prototype zero point
+ * @param proto_scale [in] Prototype scale
+ * @return int 0: success; -1: error
+ */
+int init_proto_matmul(proto_matmul_t *pm, int k, int n, bool is_quant, int32_t proto_zp, float proto_scale);
+
+/**
+ * @brief Release matmul
+ *
+ * @param pm [in] Matmul
+ */
+void release_proto_matmul(proto_matmul_t *pm);
+
+/**
+ * @brief NPU memory of the prototype operand, the model prototype output can be written straight into it
+ *
+ * @param pm [in] Matmul
+ * @param size [in] Size of the model prototype output
+ * @return void* NULL: not available for this model, pass prototypes to proto_matmul_run; int8 prototypes of another
+ *         size release the NPU, proto_matmul_select then only picks the CPU paths
+ */
+void *proto_matmul_proto_buffer(proto_matmul_t *pm, uint32_t size);
+
+/**
+ * @brief Choose the backend of a frame, proto_matmul_run computes the full plane for NPU and CPU
+ *
+ * @param pm [in] Matmul
+ * @param m [in] Instance count, <= pm->max_m
+ * @param roi_macs [in] Multiply-accumulates of the box-restricted path for these m instances
+ * @return proto_matmul_backend_t
+ */
+proto_matmul_backend_t proto_matmul_select(const proto_matmul_t *pm, int m, long roi_macs);
+
+/**
+ * @brief Compute logits = coeff x proto into pm->logits, on the NPU when available, else on the CPU
+ *
+ * @param pm [in] Matmul
+ * @param coeff [in] Coefficients, m * k
+ * @param m [in] Instance count, <= pm->max_m
+ * @param proto [in] Float prototypes k * n, unused when the model output is bound by proto_matmul_proto_buffer
+ * @return int 0: success; -1: error
+ */
+int proto_matmul_run(proto_matmul_t *pm, const float *coeff, int m, const float *proto);
+
+/**
+ * @brief CPU reference, C = A x B
+ *
+ * @param A [in] m * k
+ * @param B [in] k * n
+ * @param C [out] m * n
+ */
+void proto_matmul_cpu(const float *A, const float *B, float *C, int m, int k, int n);
+
+#endif //_RKNN_YOLOV8_SEG_DEMO_PROTO_MATMUL_H_
@@ -20,13 +20,13 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/time.h>
-#include <opencv2/opencv.hpp>
 #include "easy_timer.h"
+#include "mask_utils.h"
+#include "dfl_utils.h"
 
 #include <set>
 #include <vector>
 #define LABEL_NALE_TXT_PATH "./model/coco_80_labels_list.txt"
-// #define USE_FP_RESIZE
 
 static char *labels[OBJ_CLASS_NUM];
 
@@ -183,161 +183,6 @@ static int quick_sort_indice_inverse(std::vector<float> &input, int left, int ri
     return low;
 }
 
-void resize_by_opencv_fp(float *input_image, int input_width, int input_height, int boxes_num, float *output_image, int target_width, int target_height)
-{
-    for (int b = 0; b < boxes_num; b++)
-    {
-        cv::Mat src_image(input_height, input_width, CV_32F, &input_image[b * input_width * input_height]);
-        cv::Mat dst_image;
-        cv::resize(src_image, dst_image, cv::Size(target_width, target_height), 0, 0, cv::INTER_LINEAR);
-        memcpy(&output_image[b * target_width * target_height], dst_image.data, target_width * target_height * sizeof(float));
-    }
-}
-
-void resize_by_opencv_uint8(uint8_t *input_image, int input_width, int input_height, int boxes_num, uint8_t *output_image, int target_width, int target_height)
-{
-    for (int b = 0; b < boxes_num; b++)
-    {
-        cv::Mat src_image(input_height, input_width, CV_8U, &input_image[b * input_width * input_height]);
-        cv::Mat dst_image;
-        cv::resize(src_image, dst_image, cv::Size(target_width, target_height), 0, 0, cv::INTER_LINEAR);
-        memcpy(&output_image[b * target_width * target_height], dst_image.data, target_width * target_height * sizeof(uint8_t));
-    }
-}
-
-void crop_mask_fp(float *seg_mask, uint8_t *all_mask_in_one, float *boxes, int boxes_num, int *cls_id, int height, int width)
-{
-    for (int b = 0; b < boxes_num; b++)
-    {
-        float x1 = boxes[b * 4 + 0];
-        float y1 = boxes[b * 4 + 1];
-        float x2 = boxes[b * 4 + 2];
-        float y2 = boxes[b * 4 + 3];
-
-        for (int i = 0; i < height; i++)
-        {
-            for (int j = 0; j < width; j++)
-            {
-                if (j >= x1 && j < x2 && i >= y1 && i < y2)
-                {
-                    if (all_mask_in_one[i * width + j] == 0)
-                    {
-                        if (seg_mask[b * width * height + i * width + j] > 0)
-                        {
-                            all_mask_in_one[i * width + j] = (cls_id[b] + 1);
-                        }
-                        else
-                        {
-                            all_mask_in_one[i * width + j] = 0;
-                        }
-                    }
-                }
-            }
-        }
-    }
-}
-
-void crop_mask_uint8(uint8_t *seg_mask, uint8_t *all_mask_in_one, float *boxes, int boxes_num, int *cls_id, int height, int width)
-{
-    for (int b = 0; b < boxes_num; b++)
-    {
-        float x1 = boxes[b * 4 + 0];
-        float y1 = boxes[b * 4 + 1];
-        float x2 = boxes[b * 4 + 2];
-        float y2 = boxes[b * 4 + 3];
-
-        for (int i = 0; i < height; i++)
-        {
-            for (int j = 0; j < width; j++)
-            {
-                if (j >= x1 && j < x2 && i >= y1 && i < y2)
-                {
-                    if (all_mask_in_one[i * width + j] == 0)
-                    {
-                        if (seg_mask[b * width * height + i * width + j] > 0)
-                        {
-                            all_mask_in_one[i * width + j] = (cls_id[b] + 1);
-                        }
-                        else
-                        {
-                            all_mask_in_one[i * width + j] = 0;
-                        }
-                    }
-                }
-            }
-        }
-    }
-}
-
-void matmul_by_cpu_fp(std::vector<float> &A, float *B, float *C, int ROWS_A, int COLS_A, int COLS_B)
-{
-
-    float temp = 0;
-    for (int i = 0; i < ROWS_A; i++)
-    {
-        for (int j = 0; j < COLS_B; j++)
-        {
-            temp = 0;
-            for (int k = 0; k < COLS_A; k++)
-            {
-                temp += A[i * COLS_A + k] * B[k * COLS_B + j];
-            }
-            C[i * COLS_B + j] = temp;
-        }
-    }
-}
-
-void matmul_by_cpu_uint8(std::vector<float> &A, float *B, uint8_t *C, int ROWS_A, int COLS_A, int COLS_B)
-{
-
-    float temp = 0;
-    for (int i = 0; i < ROWS_A; i++)
-    {
-        for (int j = 0; j < COLS_B; j++)
-        {
-            temp = 0;
-            for (int k = 0; k < COLS_A; k++)
-            {
-                temp += A[i * COLS_A + k] * B[k * COLS_B + j];
-            }
-            if (temp > 0)
-            {
-                C[i * COLS_B + j] = 4;
-            }
-            else
-            {
-                C[i * COLS_B + j] = 0;
-            }
-        }
-    }
-}
-
-void seg_reverse(uint8_t *seg_mask, uint8_t *cropped_seg, uint8_t *seg_mask_real,
-                 int model_in_height, int model_in_width, int cropped_height, int cropped_width, int ori_in_height, int ori_in_width, int y_pad, int x_pad)
-{
-
-    if (y_pad == 0 && x_pad == 0 && ori_in_height == model_in_height && ori_in_width == model_in_width)
-    {
-        memcpy(seg_mask_real, seg_mask, ori_in_height * ori_in_width);
-        return;
-    }
-
-    int cropped_index = 0;
-    for (int i = 0; i < model_in_height; i++)
-    {
-        for (int j = 0; j < model_in_width; j++)
-        {
-            if (i >= y_pad && i < model_in_height - y_pad && j >= x_pad && j < model_in_width - x_pad)
-            {
-                int seg_index = i * model_in_width + j;
-                cropped_seg[cropped_index] = seg_mask[seg_index];
-                cropped_index++;
-            }
-        }
-    }
-    resize_by_opencv_uint8(cropped_seg, cropped_width, cropped_height, 1, seg_mask_real, ori_in_width, ori_in_height);
-}
-
 static int box_reverse(int position, int boundary, int pad, float scale)
 {
     return (int)((clamp(position, 0, boundary) - pad) / scale);
@@ -365,27 +210,6 @@ static uint8_t qnt_f32_to_affine(float f32, uint8_t zp, float scale)
     return res;
 }
 
-static void compute_dfl(float *tensor, int dfl_len, float *box)
-{
-    for (int b = 0; b < 4; b++)
-    {
-        float exp_t[dfl_len];
-        float exp_sum = 0;
-        float acc_sum = 0;
-        for (int i = 0; i < dfl_len; i++)
-        {
-            exp_t[i] = exp(tensor[i + b * dfl_len]);
-            exp_sum += exp_t[i];
-        }
-
-        for (int i = 0; i < dfl_len; i++)
-        {
-            acc_sum += exp_t[i] / exp_sum * i;
-        }
-        box[b] = acc_sum;
-    }
-}
-
 static int process_u8(rknn_output *all_input, int input_id, int grid_h, int grid_w, int height, int width, int stride, int dfl_len,
                       std::vector<float> &boxes, std::vector<float> &segments, float *proto, std::vector<float> &objProbs, std::vector<int> &classId, float threshold,
                       rknn_app_context_t *app_ctx)
@@ -433,6 +257,9 @@ static int process_u8(rknn_output *all_input, int input_id, int grid_h, int grid
     uint8_t score_thres_u8 = qnt_f32_to_affine(threshold, score_zp, score_scale);
     uint8_t score_sum_thres_u8 = qnt_f32_to_affine(threshold, score_sum_zp, score_sum_scale);
 
+    dfl_exp_table_t dfl_table;
+    init_dfl_exp_table_u8(&dfl_table, box_zp, box_scale);
+
     for (int i = 0; i < grid_h; i++)
     {
         for (int j = 0; j < grid_w; j++)
@@ -475,13 +302,7 @@ static int process_u8(rknn_output *all_input, int input_id, int grid_h, int grid
 
                 offset = i * grid_w + j;
                 float box[4];
-                float before_dfl[dfl_len * 4];
-                for (int k = 0; k < dfl_len * 4; k++)
-                {
-                    before_dfl[k] = deqnt_affine_to_f32(box_tensor[offset], box_zp, box_scale);
-                    offset += grid_len;
-                }
-                compute_dfl(before_dfl, dfl_len, box);
+                dfl_decode_u8(box_tensor + offset, grid_len, dfl_len, &dfl_table, box);
 
                 float x1, y1, x2, y2, w, h;
                 x1 = (-box[0] + j + 0.5) * stride;
@@ -573,13 +394,7 @@ static int process_fp32(rknn_output *all_input, int input_id, int grid_h, int gr
 
                 offset = i * grid_w + j;
                 float box[4];
-                float before_dfl[dfl_len * 4];
-                for (int k = 0; k < dfl_len * 4; k++)
-                {
-                    before_dfl[k] = box_tensor[offset];
-                    offset += grid_len;
-                }
-                compute_dfl(before_dfl, dfl_len, box);
+                dfl_decode_f32(box_tensor + offset, grid_len, dfl_len, box);
 
                 float x1, y1, x2, y2, w, h;
                 x1 = (-box[0] + j + 0.5) * stride;
@@ -700,16 +515,17 @@ int post_process(rknn_app_context_t *app_ctx, rknn_output *outputs, letterbox_t
     od_results->count = last_count;
     int boxes_num = od_results->count;
 
-    float filterBoxes_by_nms[boxes_num * 4];
-    int cls_id[boxes_num];
+    seg_instance_t instances[OBJ_NUMB_MAX_SIZE];
     for (int i = 0; i < boxes_num; i++)
     {
-        // for crop_mask
-        filterBoxes_by_nms[i * 4 + 0] = od_results->results[i].box.left;   // x1;
-        filterBoxes_by_nms[i * 4 + 1] = od_results->results[i].box.top;    // y1;
-        filterBoxes_by_nms[i * 4 + 2] = od_results->results[i].box.right;  // x2;
-        filterBoxes_by_nms[i * 4 + 3] = od_results->results[i].box.bottom; // y2;
-        cls_id[i] = od_results->results[i].cls_id;
+        // mask is cropped by the box in model input coordinates
+        instances[i].box[0] = od_results->results[i].box.left;   // x1;
+        instances[i].box[1] = od_results->results[i].box.top;    // y1;
+        instances[i].box[2] = od_results->results[i].box.right;  // x2;
+        instances[i].box[3] = od_results->results[i].box.bottom; // y2;
+        instances[i].coeff = &filterSegments_by_nms[i * PROTO_CHANNEL];
+        instances[i].logits = nullptr;
+        instances[i].label = od_results->results[i].cls_id + 1;
 
         // get real box
         od_results->results[i].box.left = box_reverse(od_results->results[i].box.left, model_in_width, letter_box->x_pad, letter_box->scale);
@@ -719,76 +535,19 @@ int post_process(rknn_app_context_t *app_ctx, rknn_output *outputs, letterbox_t
     }
 
     TIMER timer;
-#ifdef USE_FP_RESIZE
-    timer.tik();
-    // compute the mask through Matmul
-    int ROWS_A = boxes_num;
-    int COLS_A = PROTO_CHANNEL;
-    int COLS_B = PROTO_HEIGHT * PROTO_WEIGHT;
-    float *matmul_out = (float *)malloc(boxes_num * PROTO_HEIGHT * PROTO_WEIGHT * sizeof(float));
-    matmul_by_cpu_fp(filterSegments_by_nms, proto, matmul_out, ROWS_A, COLS_A, COLS_B);
-    timer.tok();
-    timer.print_time("matmul_by_cpu_fp");
-
-    timer.tik();
-    // resize to (boxes_num, model_in_width, model_in_height)
-    float *seg_mask = (float *)malloc(boxes_num * model_in_height * model_in_width * sizeof(float));
-    resize_by_opencv_fp(matmul_out, PROTO_WEIGHT, PROTO_HEIGHT, boxes_num, seg_mask, model_in_width, model_in_height);
-    timer.tok();
-    timer.print_time("resize_by_opencv_fp");
-
     timer.tik();
-    // crop mask
-    uint8_t *all_mask_in_one = (uint8_t *)malloc(model_in_height * model_in_width * sizeof(uint8_t));
-    memset(all_mask_in_one, 0, model_in_height * model_in_width * sizeof(uint8_t));
-    crop_mask_fp(seg_mask, all_mask_in_one, filterBoxes_by_nms, boxes_num, cls_id, model_in_height, model_in_width);
-    timer.tok();
-    timer.print_time("crop_mask_fp");
-#else
-    timer.tik();
-    // compute the mask through Matmul
-    int ROWS_A = boxes_num;
-    int COLS_A = PROTO_CHANNEL;
-    int COLS_B = PROTO_HEIGHT * PROTO_WEIGHT;
-    uint8_t *matmul_out = (uint8_t *)malloc(boxes_num * PROTO_HEIGHT * PROTO_WEIGHT * sizeof(uint8_t));
-    matmul_by_cpu_uint8(filterSegments_by_nms, proto, matmul_out, ROWS_A, COLS_A, COLS_B);
-    timer.tok();
-    timer.print_time("matmul_by_cpu_uint8");
-
-    timer.tik();
-    uint8_t *seg_mask = (uint8_t *)malloc(boxes_num * model_in_height * model_in_width * sizeof(uint8_t));
-    resize_by_opencv_uint8(matmul_out, PROTO_WEIGHT, PROTO_HEIGHT, boxes_num, seg_mask, model_in_width, model_in_height);
-    timer.tok();
-    timer.print_time("resize_by_opencv_uint8");
-
-    timer.tik();
-    // crop mask
-    uint8_t *all_mask_in_one = (uint8_t *)malloc(model_in_height * model_in_width * sizeof(uint8_t));
-    memset(all_mask_in_one, 0, model_in_height * model_in_width * sizeof(uint8_t));
-    crop_mask_uint8(seg_mask, all_mask_in_one, filterBoxes_by_nms, boxes_num, cls_id, model_in_height, model_in_width);
-    timer.tok();
-    timer.print_time("crop_mask_uint8");
-#endif
-
-    timer.tik();
-    // get real mask
-    int cropped_height = model_in_height - letter_box->y_pad * 2;
-    int cropped_width = model_in_width - letter_box->x_pad * 2;
+    // coeff x proto, upsampling and compositing only inside each box, straight into the original image label map
     int ori_in_height = app_ctx->input_image_height;
     int ori_in_width = app_ctx->input_image_width;
-    int y_pad = letter_box->y_pad;
-    int x_pad = letter_box->x_pad;
-    uint8_t *cropped_seg_mask = (uint8_t *)malloc(cropped_height * cropped_width * sizeof(uint8_t));
     uint8_t *real_seg_mask = (uint8_t *)malloc(ori_in_height * ori_in_width * sizeof(uint8_t));
-    seg_reverse(all_mask_in_one, cropped_seg_mask, real_seg_mask,
-                model_in_height, model_in_width, cropped_height, cropped_width, ori_in_height, ori_in_width, y_pad, x_pad);
+    if (seg_mask_compose(app_ctx->mask_engine, proto, PROTO_CHANNEL, PROTO_HEIGHT, PROTO_WEIGHT, model_in_width, model_in_height, letter_box,
+                         instances, boxes_num, real_seg_mask, ori_in_width, ori_in_height) != 0)
+    {
+        printf("seg_mask_compose fail!\n");
+    }
     od_results->results_seg[0].seg_mask = real_seg_mask;
-    free(all_mask_in_one);
-    free(cropped_seg_mask);
-    free(seg_mask);
-    free(matmul_out);
     timer.tok();
-    timer.print_time("seg_reverse");
+    timer.print_time("seg_mask_compose");
 
     return 0;
 }
@@ -20,18 +20,13 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/time.h>
-#include <opencv2/opencv.hpp>
-#include "rknn_matmul_api.h"
-#include "im2d.hpp"
-#include "dma_alloc.hpp"
-#include "drm_alloc.hpp"
-#include "Float16.h"
 #include "easy_timer.h"
+#include "mask_utils.h"
+#include "dfl_utils.h"
 
 #include <set>
 #include <vector>
 #define LABEL_NALE_TXT_PATH "./model/coco_80_labels_list.txt"
-// #define USE_FP_RESIZE
 
 static char *labels[OBJ_CLASS_NUM];
 
@@ -188,344 +183,6 @@ static int quick_sort_indice_inverse(std::vector<float> &input, int left, int ri
     return low;
 }
 
-void resize_by_opencv_fp(float *input_image, int input_width, int input_height, int boxes_num, float *output_image, int target_width, int target_height)
-{
-    for (int b = 0; b < boxes_num; b++)
-    {
-        cv::Mat src_image(input_height, input_width, CV_32F, &input_image[b * input_width * input_height]);
-        cv::Mat dst_image;
-        cv::resize(src_image, dst_image, cv::Size(target_width, target_height), 0, 0, cv::INTER_LINEAR);
-        memcpy(&output_image[b * target_width * target_height], dst_image.data, target_width * target_height * sizeof(float));
-    }
-}
-
-void resize_by_opencv_uint8(uint8_t *input_image, int input_width, int input_height, int boxes_num, uint8_t *output_image, int target_width, int target_height)
-{
-    for (int b = 0; b < boxes_num; b++)
-    {
-        cv::Mat src_image(input_height, input_width, CV_8U, &input_image[b * input_width * input_height]);
-        cv::Mat dst_image;
-        cv::resize(src_image, dst_image, cv::Size(target_width, target_height), 0, 0, cv::INTER_LINEAR);
-        memcpy(&output_image[b * target_width * target_height], dst_image.data, target_width * target_height * sizeof(uint8_t));
-    }
-}
-
-void resize_by_rga_rk3588(uint8_t *input_image, int input_width, int input_height, uint8_t *output_image, int target_width, int target_height)
-{
-    char *src_buf, *dst_buf;
-    int src_buf_size, dst_buf_size;
-    rga_buffer_handle_t src_handle, dst_handle;
-    int src_width = input_width;
-    int src_height = input_height;
-    int src_format = RK_FORMAT_YCbCr_400;
-    int dst_width = target_width;
-    int dst_height = target_height;
-    int dst_format = RK_FORMAT_YCbCr_400;
-    int dst_dma_fd, src_dma_fd;
-    rga_buffer_t dst = {};
-    rga_buffer_t src = {};
-
-    dst_buf_size = dst_width * dst_height * get_bpp_from_format(dst_format);
-    src_buf_size = src_width * src_height * get_bpp_from_format(src_format);
-
-    /*
-     * Allocate dma_buf within 4G from dma32_heap,
-     * return dma_fd and virtual address.
-     */
-    dma_buf_alloc(DMA_HEAP_DMA32_UNCACHE_PATCH, dst_buf_size, &dst_dma_fd, (void **)&dst_buf);
-    dma_buf_alloc(DMA_HEAP_DMA32_UNCACHE_PATCH, src_buf_size, &src_dma_fd, (void **)&src_buf);
-    memcpy(src_buf, input_image, src_buf_size);
-
-    dst_handle = importbuffer_fd(dst_dma_fd, dst_buf_size);
-    src_handle = importbuffer_fd(src_dma_fd, src_buf_size);
-
-    dst = wrapbuffer_handle(dst_handle, dst_width, dst_height, dst_format);
-    src = wrapbuffer_handle(src_handle, src_width, src_height, src_format);
-
-    int ret = imresize(src, dst);
-    if (ret == IM_STATUS_SUCCESS)
-    {
-        printf("%s running success!\n", "rga_resize");
-    }
-    else
-    {
-        printf("%s running failed, %s\n", "rga_resize", imStrError((IM_STATUS)ret));
-    }
-
-    memcpy(output_image, dst_buf, target_width * target_height);
-
-    releasebuffer_handle(src_handle);
-    releasebuffer_handle(dst_handle);
-    dma_buf_free(src_buf_size, &src_dma_fd, src_buf);
-    dma_buf_free(dst_buf_size, &dst_dma_fd, dst_buf);
-}
-
-class DrmObject
-{
-public:
-    int drm_buffer_fd;
-    int drm_buffer_handle;
-    size_t actual_size;
-    uint8_t *drm_buf;
-};
-
-void resize_by_rga_rk356x(uint8_t *input_image, int input_width, int input_height, uint8_t *output_image, int target_width, int target_height)
-{
-    rga_buffer_handle_t src_handle, dst_handle;
-    int src_width = input_width;
-    int src_height = input_height;
-    int src_format = RK_FORMAT_YCbCr_400;
-    int dst_width = target_width;
-    int dst_height = target_height;
-    int dst_format = RK_FORMAT_YCbCr_400;
-    rga_buffer_t dst = {};
-    rga_buffer_t src = {};
-    DrmObject drm_src;
-    DrmObject drm_dst;
-    int src_alloc_flags = 0, dst_alloc_flags = 0;
-
-    /* Allocate drm_buf, return dma_fd and virtual address. */
-    drm_src.drm_buf = (uint8_t *)drm_buf_alloc(src_width, src_height,
-                                               get_bpp_from_format(src_format) * 8,
-                                               &drm_src.drm_buffer_fd,
-                                               &drm_src.drm_buffer_handle,
-                                               &drm_src.actual_size,
-                                               src_alloc_flags);
-
-    drm_dst.drm_buf = (uint8_t *)drm_buf_alloc(dst_width, dst_height,
-                                               get_bpp_from_format(dst_format) * 8,
-                                               &drm_dst.drm_buffer_fd,
-                                               &drm_dst.drm_buffer_handle,
-                                               &drm_dst.actual_size,
-                                               dst_alloc_flags);
-    memcpy(drm_src.drm_buf, input_image, drm_src.actual_size);
-
-    src_handle = importbuffer_fd(drm_src.drm_buffer_fd, drm_src.actual_size);
-    dst_handle = importbuffer_fd(drm_dst.drm_buffer_fd, drm_dst.actual_size);
-
-    dst = wrapbuffer_handle(dst_handle, dst_width, dst_height, dst_format);
-    src = wrapbuffer_handle(src_handle, src_width, src_height, src_format);
-
-    int ret = imresize(src, dst);
-    if (ret == IM_STATUS_SUCCESS)
-    {
-        printf("%s running success!\n", "rga_resize");
-    }
-    else
-    {
-        printf("%s running failed, %s\n", "rga_resize", imStrError((IM_STATUS)ret));
-    }
-
-    memcpy(output_image, drm_dst.drm_buf, target_width * target_height);
-
-    releasebuffer_handle(src_handle);
-    releasebuffer_handle(dst_handle);
-    drm_buf_destroy(drm_src.drm_buffer_fd, drm_src.drm_buffer_handle, drm_src.drm_buf, drm_src.actual_size);
-    drm_buf_destroy(drm_dst.drm_buffer_fd, drm_dst.drm_buffer_handle, drm_dst.drm_buf, drm_dst.actual_size);
-}
-
-void crop_mask_fp(float *seg_mask, uint8_t *all_mask_in_one, float *boxes, int boxes_num, int *cls_id, int height, int width)
-{
-    for (int b = 0; b < boxes_num; b++)
-    {
-        float x1 = boxes[b * 4 + 0];
-        float y1 = boxes[b * 4 + 1];
-        float x2 = boxes[b * 4 + 2];
-        float y2 = boxes[b * 4 + 3];
-
-        for (int i = 0; i < height; i++)
-        {
-            for (int j = 0; j < width; j++)
-            {
-                if (j >= x1 && j < x2 && i >= y1 && i < y2)
-                {
-                    if (all_mask_in_one[i * width + j] == 0)
-                    {
-                        if (seg_mask[b * width * height + i * width + j] > 0)
-                        {
-                            all_mask_in_one[i * width + j] = (cls_id[b] + 1);
-                        }
-                        else
-                        {
-                            all_mask_in_one[i * width + j] = 0;
-                        }
-                    }
-                }
-            }
-        }
-    }
-}
-
-void crop_mask_uint8(uint8_t *seg_mask, uint8_t *all_mask_in_one, float *boxes, int boxes_num, int *cls_id, int height, int width)
-{
-    for (int b = 0; b < boxes_num; b++)
-    {
-        float x1 = boxes[b * 4 + 0];
-        float y1 = boxes[b * 4 + 1];
-        float x2 = boxes[b * 4 + 2];
-        float y2 = boxes[b * 4 + 3];
-
-        for (int i = 0; i < height; i++)
-        {
-            for (int j = 0; j < width; j++)
-            {
-                if (j >= x1 && j < x2 && i >= y1 && i < y2)
-                {
-                    if (all_mask_in_one[i * width + j] == 0)
-                    {
-                        if (seg_mask[b * width * height + i * width + j] > 0)
-                        {
-                            all_mask_in_one[i * width + j] = (cls_id[b] + 1);
-                        }
-                        else
-                        {
-                            all_mask_in_one[i * width + j] = 0;
-                        }
-                    }
-                }
-            }
-        }
-    }
-}
-
-void matmul_by_cpu_fp(std::vector<float> &A, float *B, float *C, int ROWS_A, int COLS_A, int COLS_B)
-{
-
-    float temp = 0;
-    for (int i = 0; i < ROWS_A; i++)
-    {
-        for (int j = 0; j < COLS_B; j++)
-        {
-            temp = 0;
-            for (int k = 0; k < COLS_A; k++)
-            {
-                temp += A[i * COLS_A + k] * B[k * COLS_B + j];
-            }
-            C[i * COLS_B + j] = temp;
-        }
-    }
-}
-
-void matmul_by_cpu_uint8(std::vector<float> &A, float *B, uint8_t *C, int ROWS_A, int COLS_A, int COLS_B)
-{
-
-    float temp = 0;
-    for (int i = 0; i < ROWS_A; i++)
-    {
-        for (int j = 0; j < COLS_B; j++)
-        {
-            temp = 0;
-            for (int k = 0; k < COLS_A; k++)
-            {
-                temp += A[i * COLS_A + k] * B[k * COLS_B + j];
-            }
-            if (temp > 0)
-            {
-                C[i * COLS_B + j] = 4;
-            }
-            else
-            {
-                C[i * COLS_B + j] = 0;
-            }
-        }
-    }
-}
-
-void matmul_by_npu_fp(std::vector<float> &A_input, float *B_input, float *C_input, int ROWS_A, int COLS_A, int COLS_B, rknn_app_context_t *app_ctx)
-{
-    int B_layout = 0;
-    int AC_layout = 0;
-    int32_t M = ROWS_A;
-    int32_t K = COLS_A;
-    int32_t N = COLS_B;
-
-    rknn_matmul_ctx ctx;
-    rknn_matmul_info info;
-    memset(&info, 0, sizeof(rknn_matmul_info));
-    info.M = M;
-    info.K = K;
-    info.N = N;
-    info.type = RKNN_FLOAT16_MM_FLOAT16_TO_FLOAT32;
-    info.B_layout = B_layout;
-    info.AC_layout = AC_layout;
-
-    rknn_matmul_io_attr io_attr;
-    memset(&io_attr, 0, sizeof(rknn_matmul_io_attr));
-
-    rknpu2::float16 int8Vector_A[ROWS_A * COLS_A];
-    for (int i = 0; i < ROWS_A * COLS_A; ++i)
-    {
-        int8Vector_A[i] = (rknpu2::float16)A_input[i];
-    }
-
-    rknpu2::float16 int8Vector_B[COLS_A * COLS_B];
-    for (int i = 0; i < COLS_A * COLS_B; ++i)
-    {
-        int8Vector_B[i] = (rknpu2::float16)B_input[i];
-    }
-
-    int ret = rknn_matmul_create(&ctx, &info, &io_attr);
-    // Create A
-    rknn_tensor_mem *A = rknn_create_mem(ctx, io_attr.A.size);
-    // Create B
-    rknn_tensor_mem *B = rknn_create_mem(ctx, io_attr.B.size);
-    // Create C
-    rknn_tensor_mem *C = rknn_create_mem(ctx, io_attr.C.size);
-
-    memcpy(A->virt_addr, int8Vector_A, A->size);
-    memcpy(B->virt_addr, int8Vector_B, B->size);
-
-    // Set A
-    ret = rknn_matmul_set_io_mem(ctx, A, &io_attr.A);
-    // Set B
-    ret = rknn_matmul_set_io_mem(ctx, B, &io_attr.B);
-    // Set C
-    ret = rknn_matmul_set_io_mem(ctx, C, &io_attr.C);
-
-    // Run
-    ret = rknn_matmul_run(ctx);
-    for (int i = 0; i < ROWS_A * COLS_B; ++i)
-    {
-        C_input[i] = ((float *)C->virt_addr)[i];
-    }
-
-    // destroy
-    rknn_destroy_mem(ctx, A);
-    rknn_destroy_mem(ctx, B);
-    rknn_destroy_mem(ctx, C);
-    rknn_matmul_destroy(ctx);
-}
-
-void seg_reverse(uint8_t *seg_mask, uint8_t *cropped_seg, uint8_t *seg_mask_real,
-                 int model_in_height, int model_in_width, int cropped_height, int cropped_width, int ori_in_height, int ori_in_width, int y_pad, int x_pad)
-{
-
-    if (y_pad == 0 && x_pad == 0 && ori_in_height == model_in_height && ori_in_width == model_in_width)
-    {
-        memcpy(seg_mask_real, seg_mask, ori_in_height * ori_in_width);
-        return;
-    }
-
-    int cropped_index = 0;
-    for (int i = 0; i < model_in_height; i++)
-    {
-        for (int j = 0; j < model_in_width; j++)
-        {
-            if (i >= y_pad && i < model_in_height - y_pad && j >= x_pad && j < model_in_width - x_pad)
-            {
-                int seg_index = i * model_in_width + j;
-                cropped_seg[cropped_index] = seg_mask[seg_index];
-                cropped_index++;
-            }
-        }
-    }
-    // Note: Here are different methods provided for implementing single-channel image scaling.
-    //       The method of using rga to resize the image requires that the image size is 2 aligned.
-    resize_by_opencv_uint8(cropped_seg, cropped_width, cropped_height, 1, seg_mask_real, ori_in_width, ori_in_height);
-    // resize_by_rga_rk356x(cropped_seg, cropped_width, cropped_height, seg_mask_real, ori_in_width, ori_in_height);
-    // resize_by_rga_rk3588(cropped_seg, cropped_width, cropped_height, seg_mask_real, ori_in_width, ori_in_height);
-}
-
 static int box_reverse(int position, int boundary, int pad, float scale)
 {
     return (int)((clamp(position, 0, boundary) - pad) / scale);
@@ -550,27 +207,6 @@ static int8_t qnt_f32_to_affine(float f32, int32_t zp, float scale)
 
 static float deqnt_affine_to_f32(int8_t qnt, int32_t zp, float scale) { return ((float)qnt - (float)zp) * scale; }
 
-static void compute_dfl(float *tensor, int dfl_len, float *box)
-{
-    for (int b = 0; b < 4; b++)
-    {
-        float exp_t[dfl_len];
-        float exp_sum = 0;
-        float acc_sum = 0;
-        for (int i = 0; i < dfl_len; i++)
-        {
-            exp_t[i] = exp(tensor[i + b * dfl_len]);
-            exp_sum += exp_t[i];
-        }
-
-        for (int i = 0; i < dfl_len; i++)
-        {
-            acc_sum += exp_t[i] / exp_sum * i;
-        }
-        box[b] = acc_sum;
-    }
-}
-
 static int process_i8(rknn_output *all_input, int input_id, int grid_h, int grid_w, int height, int width, int stride, int dfl_len,
                       std::vector<float> &boxes, std::vector<float> &segments, float *proto, std::vector<float> &objProbs, std::vector<int> &classId, float threshold,
                       rknn_app_context_t *app_ctx)
@@ -618,6 +254,9 @@ static int process_i8(rknn_output *all_input, int input_id, int grid_h, int grid
     int8_t score_thres_i8 = qnt_f32_to_affine(threshold, score_zp, score_scale);
     int8_t score_sum_thres_i8 = qnt_f32_to_affine(threshold, score_sum_zp, score_sum_scale);
 
+    dfl_exp_table_t dfl_table;
+    init_dfl_exp_table_i8(&dfl_table, box_zp, box_scale);
+
     for (int i = 0; i < grid_h; i++)
     {
         for (int j = 0; j < grid_w; j++)
@@ -660,13 +299,7 @@ static int process_i8(rknn_output *all_input, int input_id, int grid_h, int grid
 
                 offset = i * grid_w + j;
                 float box[4];
-                float before_dfl[dfl_len * 4];
-                for (int k = 0; k < dfl_len * 4; k++)
-                {
-                    before_dfl[k] = deqnt_affine_to_f32(box_tensor[offset], box_zp, box_scale);
-                    offset += grid_len;
-                }
-                compute_dfl(before_dfl, dfl_len, box);
+                dfl_decode_i8(box_tensor + offset, grid_len, dfl_len, &dfl_table, box);
 
                 float x1, y1, x2, y2, w, h;
                 x1 = (-box[0] + j + 0.5) * stride;
@@ -758,13 +391,7 @@ static int process_fp32(rknn_output *all_input, int input_id, int grid_h, int gr
 
                 offset = i * grid_w + j;
                 float box[4];
-                float before_dfl[dfl_len * 4];
-                for (int k = 0; k < dfl_len * 4; k++)
-                {
-                    before_dfl[k] = box_tensor[offset];
-                    offset += grid_len;
-                }
-                compute_dfl(before_dfl, dfl_len, box);
+                dfl_decode_f32(box_tensor + offset, grid_len, dfl_len, box);
 
                 float x1, y1, x2, y2, w, h;
                 x1 = (-box[0] + j + 0.5) * stride;
@@ -885,16 +512,17 @@ int post_process(rknn_app_context_t *app_ctx, rknn_output *outputs, letterbox_t
     od_results->count = last_count;
     int boxes_num = od_results->count;
 
-    float filterBoxes_by_nms[boxes_num * 4];
-    int cls_id[boxes_num];
+    seg_instance_t instances[OBJ_NUMB_MAX_SIZE];
     for (int i = 0; i < boxes_num; i++)
     {
-        // for crop_mask
-        filterBoxes_by_nms[i * 4 + 0] = od_results->results[i].box.left;   // x1;
-        filterBoxes_by_nms[i * 4 + 1] = od_results->results[i].box.top;    // y1;
-        filterBoxes_by_nms[i * 4 + 2] = od_results->results[i].box.right;  // x2;
-        filterBoxes_by_nms[i * 4 + 3] = od_results->results[i].box.bottom; // y2;
-        cls_id[i] = od_results->results[i].cls_id;
+        // mask is cropped by the box in model input coordinates
+        instances[i].box[0] = od_results->results[i].box.left;   // x1;
+        instances[i].box[1] = od_results->results[i].box.top;    // y1;
+        instances[i].box[2] = od_results->results[i].box.right;  // x2;
+        instances[i].box[3] = od_results->results[i].box.bottom; // y2;
+        instances[i].coeff = &filterSegments_by_nms[i * PROTO_CHANNEL];
+        instances[i].logits = nullptr;
+        instances[i].label = od_results->results[i].cls_id + 1;
 
         // get real box
         od_results->results[i].box.left = box_reverse(od_results->results[i].box.left, model_in_width, letter_box->x_pad, letter_box->scale);
@@ -904,78 +532,39 @@ int post_process(rknn_app_context_t *app_ctx, rknn_output *outputs, letterbox_t
     }
 
     TIMER timer;
-#ifdef USE_FP_RESIZE
-    timer.tik();
-    // compute the mask through Matmul
-    int ROWS_A = boxes_num;
-    int COLS_A = PROTO_CHANNEL;
-    int COLS_B = PROTO_HEIGHT * PROTO_WEIGHT;
-    float *matmul_out = (float *)malloc(boxes_num * PROTO_HEIGHT * PROTO_WEIGHT * sizeof(float));
-    matmul_by_cpu_fp(filterSegments_by_nms, proto, matmul_out, ROWS_A, COLS_A, COLS_B);
-    // matmul_by_npu_fp(filterSegments_by_nms, proto, matmul_out, ROWS_A, COLS_A, COLS_B, app_ctx);
-    timer.tok();
-    timer.print_time("matmul_by_cpu_fp");
-
-    timer.tik();
-    // resize to (boxes_num, model_in_width, model_in_height)
-    float *seg_mask = (float *)malloc(boxes_num * model_in_height * model_in_width * sizeof(float));
-    resize_by_opencv_fp(matmul_out, PROTO_WEIGHT, PROTO_HEIGHT, boxes_num, seg_mask, model_in_width, model_in_height);
-    timer.tok();
-    timer.print_time("resize_by_opencv_fp");
-
-    timer.tik();
-    // crop mask
-    uint8_t *all_mask_in_one = (uint8_t *)malloc(model_in_height * model_in_width * sizeof(uint8_t));
-    memset(all_mask_in_one, 0, model_in_height * model_in_width * sizeof(uint8_t));
-    crop_mask_fp(seg_mask, all_mask_in_one, filterBoxes_by_nms, boxes_num, cls_id, model_in_height, model_in_width);
-    timer.tok();
-    timer.print_time("crop_mask_fp");
-#else
     timer.tik();
-    // compute the mask through Matmul
-    int ROWS_A = boxes_num;
-    int COLS_A = PROTO_CHANNEL;
-    int COLS_B = PROTO_HEIGHT * PROTO_WEIGHT;
-    uint8_t *matmul_out = (uint8_t *)malloc(boxes_num * PROTO_HEIGHT * PROTO_WEIGHT * sizeof(uint8_t));
-    matmul_by_cpu_uint8(filterSegments_by_nms, proto, matmul_out, ROWS_A, COLS_A, COLS_B);
-
-    timer.tok();
-    timer.print_time("matmul_by_cpu_uint8");
-
-    timer.tik();
-    uint8_t *seg_mask = (uint8_t *)malloc(boxes_num * model_in_height * model_in_width * sizeof(uint8_t));
-    resize_by_opencv_uint8(matmul_out, PROTO_WEIGHT, PROTO_HEIGHT, boxes_num, seg_mask, model_in_width, model_in_height);
-    timer.tok();
-    timer.print_time("resize_by_opencv_uint8");
-
-    timer.tik();
-    // crop mask
-    uint8_t *all_mask_in_one = (uint8_t *)malloc(model_in_height * model_in_width * sizeof(uint8_t));
-    memset(all_mask_in_one, 0, model_in_height * model_in_width * sizeof(uint8_t));
-    crop_mask_uint8(seg_mask, all_mask_in_one, filterBoxes_by_nms, boxes_num, cls_id, model_in_height, model_in_width);
-    timer.tok();
-    timer.print_time("crop_mask_uint8");
-#endif
+    // many or large boxes: full plane logits on the NPU, or on the CPU when the boxes overlap more than the plane;
+    // instances past max_m and small frames take the box-restricted path
+    int plane_boxes = boxes_num < app_ctx->proto_matmul.max_m ? boxes_num : app_ctx->proto_matmul.max_m;
+    long roi_macs = 0;
+    float proto_per_model = (float)PROTO_WEIGHT / model_in_width;
+    for (int i = 0; i < plane_boxes; i++)
+    {
+        float w = (instances[i].box[2] - instances[i].box[0]) * proto_per_model + 2;
+        float h = (instances[i].box[3] - instances[i].box[1]) * proto_per_model + 2;
+        roi_macs += (long)(w * h) * PROTO_CHANNEL;
+    }
+    if (proto_matmul_select(&app_ctx->proto_matmul, plane_boxes, roi_macs) != PROTO_MATMUL_BOX &&
+        proto_matmul_run(&app_ctx->proto_matmul, filterSegments_by_nms.data(), plane_boxes, proto) == 0)
+    {
+        for (int i = 0; i < plane_boxes; i++)
+        {
+            instances[i].logits = app_ctx->proto_matmul.logits + i * app_ctx->proto_matmul.n;
+        }
+    }
 
-    timer.tik();
-    // get real mask
-    int cropped_height = model_in_height - letter_box->y_pad * 2;
-    int cropped_width = model_in_width - letter_box->x_pad * 2;
+    // coeff x proto, upsampling and compositing only inside each box, straight into the original image label map
     int ori_in_height = app_ctx->input_image_height;
     int ori_in_width = app_ctx->input_image_width;
-    int y_pad = letter_box->y_pad;
-    int x_pad = letter_box->x_pad;
-    uint8_t *cropped_seg_mask = (uint8_t *)malloc(cropped_height * cropped_width * sizeof(uint8_t));
     uint8_t *real_seg_mask = (uint8_t *)malloc(ori_in_height * ori_in_width * sizeof(uint8_t));
-    seg_reverse(all_mask_in_one, cropped_seg_mask, real_seg_mask,
-                model_in_height, model_in_width, cropped_height, cropped_width, ori_in_height, ori_in_width, y_pad, x_pad);
+    if (seg_mask_compose(app_ctx->mask_engine, proto, PROTO_CHANNEL, PROTO_HEIGHT, PROTO_WEIGHT, model_in_width, model_in_height, letter_box,
+                         instances, boxes_num, real_seg_mask, ori_in_width, ori_in_height) != 0)
+    {
+        printf("seg_mask_compose fail!\n");
+    }
     od_results->results_seg[0].seg_mask = real_seg_mask;
-    free(all_mask_in_one);
-    free(cropped_seg_mask);
-    free(seg_mask);
-    free(matmul_out);
     timer.tok();
-    timer.print_time("seg_reverse");
+    timer.print_time("seg_mask_compose");
 
     return 0;
 }
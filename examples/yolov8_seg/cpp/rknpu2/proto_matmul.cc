@@ -0,0 +1,298 @@
+// Copyright (c) 2024 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "proto_matmul.h"
+
+#ifndef DISABLE_RKNN_MATMUL
+#include "rknn_matmul_api.h"
+#include "Float16.h"
+
+typedef struct
+{
+    rknn_matmul_ctx ctx;
+    rknn_matmul_info info;
+    rknn_matmul_io_attr io_attr;
+    rknn_tensor_mem *A;
+    rknn_tensor_mem *B;
+    rknn_tensor_mem *C;
+    bool proto_bound; // model output is written into B
+} proto_matmul_npu_t;
+
+static void destroy_npu(proto_matmul_npu_t *npu)
+{
+    if (npu->A != NULL)
+    {
+        rknn_destroy_mem(npu->ctx, npu->A);
+    }
+    if (npu->B != NULL)
+    {
+        rknn_destroy_mem(npu->ctx, npu->B);
+    }
+    if (npu->C != NULL)
+    {
+        rknn_destroy_mem(npu->ctx, npu->C);
+    }
+    if (npu->ctx != 0)
+    {
+        rknn_matmul_destroy(npu->ctx);
+    }
+    free(npu);
+}
+
+static proto_matmul_npu_t *create_npu(int m, int k, int n, bool is_quant)
+{
+    proto_matmul_npu_t *npu = (proto_matmul_npu_t *)calloc(1, sizeof(proto_matmul_npu_t));
+    if (npu == NULL)
+    {
+        return NULL;
+    }
+    npu->info.M = m;
+    npu->info.K = k;
+    npu->info.N = n;
+    // int8 prototypes are consumed as they come out of the model, float ones are converted to fp16
+    npu->info.type = is_quant ? RKNN_INT8_MM_INT8_TO_INT32 : RKNN_FLOAT16_MM_FLOAT16_TO_FLOAT32;
+    npu->info.B_layout = RKNN_MM_LAYOUT_NORM;
+    npu->info.AC_layout = RKNN_MM_LAYOUT_NORM;
+
+    int ret = rknn_matmul_create(&npu->ctx, &npu->info, &npu->io_attr);
+    if (ret < 0)
+    {
+        printf("rknn_matmul_create fail! ret=%d\n", ret);
+        npu->ctx = 0;
+        destroy_npu(npu);
+        return NULL;
+    }
+    npu->A = rknn_create_mem(npu->ctx, npu->io_attr.A.size);
+    npu->B = rknn_create_mem(npu->ctx, npu->io_attr.B.size);
+    npu->C = rknn_create_mem(npu->ctx, npu->io_attr.C.size);
+    if (npu->A == NULL || npu->B == NULL || npu->C == NULL)
+    {
+        printf("rknn_create_mem for matmul fail!\n");
+        destroy_npu(npu);
+        return NULL;
+    }
+    // padded rows of A stay zero
+    memset(npu->A->virt_addr, 0, npu->A->size);
+    if (rknn_matmul_set_io_mem(npu->ctx, npu->A, &npu->io_attr.A) < 0 ||
+        rknn_matmul_set_io_mem(npu->ctx, npu->B, &npu->io_attr.B) < 0 ||
+        rknn_matmul_set_io_mem(npu->ctx, npu->C, &npu->io_attr.C) < 0)
+    {
+        printf("rknn_matmul_set_io_mem fail!\n");
+        destroy_npu(npu);
+        return NULL;
+    }
+    return npu;
+}
+
+static int run_npu(proto_matmul_t *pm, proto_matmul_npu_t *npu, const float *coeff, int m, const float *proto)
+{
+    int k = pm->k;
+    int n = pm->n;
+    float a_scale = 1.0f;
+    int32_t a_sum[PROTO_MATMUL_MAX_M];
+
+    if (pm->is_quant)
+    {
+        // A is quantized per layer, symmetric
+        float a_max = 0;
+        for (int i = 0; i < m * k; i++)
+        {
+            a_max = fmaxf(a_max, fabsf(coeff[i]));
+        }
+        a_scale = a_max > 0 ? a_max / 127.0f : 1.0f;
+        int8_t *A = (int8_t *)npu->A->virt_addr;
+        for (int i = 0; i < m; i++)
+        {
+            a_sum[i] = 0;
+            for (int j = 0; j < k; j++)
+            {
+                int8_t q = (int8_t)roundf(coeff[i * k + j] / a_scale);
+                A[i * k + j] = q;
+                a_sum[i] += q;
+            }
+        }
+        memset(A + m * k, 0, (pm->max_m - m) * k);
+        if (!npu->proto_bound)
+        {
+            printf("int8 prototypes must be bound with proto_matmul_proto_buffer\n");
+            return -1;
+        }
+    }
+    else
+    {
+        rknpu2::float16 *A = (rknpu2::float16 *)npu->A->virt_addr;
+        for (int i = 0; i < m * k; i++)
+        {
+            A[i] = (rknpu2::float16)coeff[i];
+        }
+        memset((void *)(A + m * k), 0, (pm->max_m - m) * k * sizeof(rknpu2::float16));
+        rknpu2::float16 *B = (rknpu2::float16 *)npu->B->virt_addr;
+        for (int i = 0; i < k * n; i++)
+        {
+            B[i] = (rknpu2::float16)proto[i];
+        }
+    }
+
+    int ret = rknn_matmul_run(npu->ctx);
+    if (ret < 0)
+    {
+        printf("rknn_matmul_run fail! ret=%d\n", ret);
+        return -1;
+    }
+
+    if (pm->is_quant)
+    {
+        // (A_q x (B_q - zp)) * scale_a * scale_b
+        const int32_t *C = (const int32_t *)npu->C->virt_addr;
+        float scale = a_scale * pm->proto_scale;
+        for (int i = 0; i < m; i++)
+        {
+            int32_t bias = pm->proto_zp * a_sum[i];
+            const int32_t *src = C + i * n;
+            float *dst = pm->logits + i * n;
+            for (int j = 0; j < n; j++)
+            {
+                dst[j] = (src[j] - bias) * scale;
+            }
+        }
+    }
+    else
+    {
+        memcpy(pm->logits, npu->C->virt_addr, m * n * sizeof(float));
+    }
+    return 0;
+}
+#endif
+
+int init_proto_matmul(proto_matmul_t *pm, int k, int n, bool is_quant, int32_t proto_zp, float proto_scale)
+{
+    memset(pm, 0, sizeof(proto_matmul_t));
+    pm->max_m = PROTO_MATMUL_MAX_M;
+    pm->k = k;
+    pm->n = n;
+    pm->is_quant = is_quant;
+    pm->proto_zp = proto_zp;
+    pm->proto_scale = proto_scale;
+    pm->npu_min_macs = PROTO_MATMUL_NPU_MIN_MACS;
+    pm->logits = (float *)malloc(pm->max_m * n * sizeof(float));
+    if (pm->logits == NULL)
+    {
+        printf("malloc proto matmul logits fail!\n");
+        return -1;
+    }
+#ifndef DISABLE_RKNN_MATMUL
+    pm->npu = create_npu(pm->max_m, k, n, is_quant);
+    if (pm->npu == NULL)
+    {
+        printf("proto matmul runs on cpu\n");
+    }
+#endif
+    return 0;
+}
+
+void release_proto_matmul(proto_matmul_t *pm)
+{
+#ifndef DISABLE_RKNN_MATMUL
+    if (pm->npu != NULL)
+    {
+        destroy_npu((proto_matmul_npu_t *)pm->npu);
+    }
+#endif
+    pm->npu = NULL;
+    if (pm->logits != NULL)
+    {
+        free(pm->logits);
+        pm->logits = NULL;
+    }
+}
+
+void *proto_matmul_proto_buffer(proto_matmul_t *pm, uint32_t size)
+{
+#ifndef DISABLE_RKNN_MATMUL
+    proto_matmul_npu_t *npu = (proto_matmul_npu_t *)pm->npu;
+    // only int8 prototypes in normal layout can be used as they are
+    if (npu == NULL || !pm->is_quant)
+    {
+        return NULL;
+    }
+    if (npu->io_attr.B.size != size)
+    {
+        // int8 A x B needs the prototypes bound, drop the NPU so every frame takes the CPU paths
+        printf("prototype output %u bytes, matmul operand %u bytes, proto matmul runs on cpu\n", size,
+               npu->io_attr.B.size);
+        destroy_npu(npu);
+        pm->npu = NULL;
+        return NULL;
+    }
+    npu->proto_bound = true;
+    return npu->B->virt_addr;
+#else
+    return NULL;
+#endif
+}
+
+proto_matmul_backend_t proto_matmul_select(const proto_matmul_t *pm, int m, long roi_macs)
+{
+    if (m <= 0 || m > pm->max_m)
+    {
+        return PROTO_MATMUL_BOX;
+    }
+    if (pm->npu != NULL)
+    {
+        // the NPU always computes the padded full plane, worth it once the boxes cover enough of it
+        return roi_macs >= pm->npu_min_macs ? PROTO_MATMUL_NPU : PROTO_MATMUL_BOX;
+    }
+    // on the CPU the full plane only pays off once overlapping boxes add up to more than it
+    long plane_macs = (long)m * pm->k * pm->n;
+    return roi_macs >= plane_macs ? PROTO_MATMUL_CPU : PROTO_MATMUL_BOX;
+}
+
+void proto_matmul_cpu(const float *A, const float *B, float *C, int m, int k, int n)
+{
+    for (int i = 0; i < m; i++)
+    {
+        float *c = C + i * n;
+        memset(c, 0, n * sizeof(float));
+        for (int p = 0; p < k; p++)
+        {
+            float a = A[i * k + p];
+            const float *b = B + p * n;
+            for (int j = 0; j < n; j++)
+            {
+                c[j] += a * b[j];
+            }
+        }
+    }
+}
+
+int proto_matmul_run(proto_matmul_t *pm, const float *coeff, int m, const float *proto)
+{
+    if (m <= 0 || m > pm->max_m)
+    {
+        return -1;
+    }
+#ifndef DISABLE_RKNN_MATMUL
+    if (pm->npu != NULL)
+    {
+        return run_npu(pm, (proto_matmul_npu_t *)pm->npu, coeff, m, proto);
+    }
+#endif
+    proto_matmul_cpu(coeff, proto, pm->logits, m, pm->k, pm->n);
+    return 0;
+}
@@ -6,7 +6,10 @@
 #include "yolov8_seg.h"
 #include "common.h"
 #include "file_utils.h"
+#include "model_registry.h"
 #include "image_utils.h"
+#include "mask_utils.h"
+#include "trace_utils.h"
 
 static void dump_tensor_attr(rknn_tensor_attr *attr)
 {
@@ -21,23 +24,13 @@ int init_yolov8_seg_model(const char *model_path, rknn_app_context_t *app_ctx)
 {
 
     int ret;
-    int model_len = 0;
-    char *model;
     rknn_context ctx = 0;
 
     // Load RKNN Model
-    model_len = read_data_from_file(model_path, &model);
-    if (model == NULL)
-    {
-        printf("load_model fail!\n");
-        return -1;
-    }
-
-    ret = rknn_init(&ctx, model, model_len, 0, NULL);
-    free(model);
+    ret = acquire_model_context(model_path, 0, &ctx);
     if (ret < 0)
     {
-        printf("rknn_init fail! ret=%d\n", ret);
+        printf("acquire_model_context fail! ret=%d\n", ret);
         return -1;
     }
 
@@ -120,11 +113,32 @@ int init_yolov8_seg_model(const char *model_path, rknn_app_context_t *app_ctx)
     printf("model input height=%d, width=%d, channel=%d\n",
            app_ctx->model_height, app_ctx->model_width, app_ctx->model_channel);
 
+    // prototypes are the last output
+    rknn_tensor_attr *proto_attr = &app_ctx->output_attrs[io_num.n_output - 1];
+    ret = init_proto_matmul(&app_ctx->proto_matmul, PROTO_CHANNEL, PROTO_HEIGHT * PROTO_WEIGHT, app_ctx->is_quant,
+                            proto_attr->zp, proto_attr->scale);
+    if (ret < 0)
+    {
+        return -1;
+    }
+
+    app_ctx->mask_engine = create_seg_mask_engine(0);
+    if (app_ctx->mask_engine == NULL)
+    {
+        return -1;
+    }
+
     return 0;
 }
 
 int release_yolov8_seg_model(rknn_app_context_t *app_ctx)
 {
+    if (app_ctx->mask_engine != NULL)
+    {
+        destroy_seg_mask_engine(app_ctx->mask_engine);
+        app_ctx->mask_engine = NULL;
+    }
+    release_proto_matmul(&app_ctx->proto_matmul);
     if (app_ctx->input_attrs != NULL)
     {
         free(app_ctx->input_attrs);
@@ -137,7 +151,7 @@ int release_yolov8_seg_model(rknn_app_context_t *app_ctx)
     }
     if (app_ctx->rknn_ctx != 0)
     {
-        rknn_destroy(app_ctx->rknn_ctx);
+        release_model_context(app_ctx->rknn_ctx);
         app_ctx->rknn_ctx = 0;
     }
     return 0;
@@ -194,7 +208,10 @@ int inference_yolov8_seg_model(rknn_app_context_t *app_ctx, image_buffer_t *img,
     inputs[0].size = app_ctx->model_width * app_ctx->model_height * app_ctx->model_channel;
     inputs[0].buf = dst_img.virt_addr;
 
-    ret = rknn_inputs_set(app_ctx->rknn_ctx, app_ctx->io_num.n_input, inputs);
+    {
+        TRACE_ZONE(TRACE_STAGE_INPUTS_SET, "rknn_inputs_set");
+        ret = rknn_inputs_set(app_ctx->rknn_ctx, app_ctx->io_num.n_input, inputs);
+    }
     if (ret < 0)
     {
         printf("rknn_input_set fail! ret=%d\n", ret);
@@ -202,8 +219,11 @@ int inference_yolov8_seg_model(rknn_app_context_t *app_ctx, image_buffer_t *img,
     }
 
     // Run
-    printf("rknn_run\n");
-    ret = rknn_run(app_ctx->rknn_ctx, nullptr);
+    TRACE_LOG("rknn_run\n");
+    {
+        TRACE_ZONE(TRACE_STAGE_RUN, "rknn_run");
+        ret = rknn_run(app_ctx->rknn_ctx, nullptr);
+    }
     if (ret < 0)
     {
         printf("rknn_run fail! ret=%d\n", ret);
@@ -217,7 +237,21 @@ int inference_yolov8_seg_model(rknn_app_context_t *app_ctx, image_buffer_t *img,
         outputs[i].index = i;
         outputs[i].want_float = (!app_ctx->is_quant);
     }
-    ret = rknn_outputs_get(app_ctx->rknn_ctx, app_ctx->io_num.n_output, outputs, NULL);
+    // int8 prototypes are written straight into the matmul operand
+    {
+        int proto_index = app_ctx->io_num.n_output - 1;
+        void *proto_buf = proto_matmul_proto_buffer(&app_ctx->proto_matmul, app_ctx->output_attrs[proto_index].size);
+        if (proto_buf != NULL)
+        {
+            outputs[proto_index].is_prealloc = 1;
+            outputs[proto_index].buf = proto_buf;
+            outputs[proto_index].size = app_ctx->output_attrs[proto_index].size;
+        }
+    }
+    {
+        TRACE_ZONE(TRACE_STAGE_OUTPUTS_GET, "rknn_outputs_get");
+        ret = rknn_outputs_get(app_ctx->rknn_ctx, app_ctx->io_num.n_output, outputs, NULL);
+    }
     if (ret < 0)
     {
         printf("rknn_outputs_get fail! ret=%d\n", ret);
@@ -225,7 +259,10 @@ int inference_yolov8_seg_model(rknn_app_context_t *app_ctx, image_buffer_t *img,
     }
 
     // Post Process
-    post_process(app_ctx, outputs, &letter_box, box_conf_threshold, nms_threshold, od_results);
+    {
+        TRACE_ZONE(TRACE_STAGE_POSTPROCESS, "post_process");
+        post_process(app_ctx, outputs, &letter_box, box_conf_threshold, nms_threshold, od_results);
+    }
 
     // Remeber to release rknn output
     rknn_outputs_release(app_ctx->rknn_ctx, app_ctx->io_num.n_output, outputs);
@@ -0,0 +1,221 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rknn_matmul_api.h"
+#include "Float16.h"
+#include "proto_matmul.h"
+
+// The NPU path of proto_matmul against a stand-in for the librknnrt matmul that computes on the CPU:
+// int8 prototypes bound to the B operand, a model whose prototypes do not fit the operand, fp16.
+//   proto_matmul_npu_test
+
+#define PROTO_C 32
+#define PROTO_N (160 * 160)
+
+static rknn_matmul_info g_info;
+static rknn_tensor_mem *g_mems[3];
+static int g_num_mems = 0;
+static int g_runs = 0;
+
+int rknn_matmul_create(rknn_matmul_ctx *ctx, rknn_matmul_info *info, rknn_matmul_io_attr *io_attr)
+{
+    g_info = *info;
+    int ab = info->type == RKNN_INT8_MM_INT8_TO_INT32 ? 1 : 2;
+    memset(io_attr, 0, sizeof(rknn_matmul_io_attr));
+    io_attr->A.size = info->M * info->K * ab;
+    io_attr->B.size = info->K * info->N * ab;
+    io_attr->C.size = info->M * info->N * 4;
+    *ctx = 1;
+    g_num_mems = 0;
+    return 0;
+}
+
+rknn_tensor_mem *rknn_create_mem(rknn_context ctx, uint32_t size)
+{
+    rknn_tensor_mem *mem = (rknn_tensor_mem *)calloc(1, sizeof(rknn_tensor_mem));
+    mem->virt_addr = calloc(1, size);
+    mem->size = size;
+    return mem;
+}
+
+int rknn_destroy_mem(rknn_context ctx, rknn_tensor_mem *mem)
+{
+    free(mem->virt_addr);
+    free(mem);
+    return 0;
+}
+
+// bound in the order A, B, C
+int rknn_matmul_set_io_mem(rknn_matmul_ctx ctx, rknn_tensor_mem *mem, rknn_matmul_tensor_attr *attr)
+{
+    g_mems[g_num_mems++ % 3] = mem;
+    return 0;
+}
+
+int rknn_matmul_run(rknn_matmul_ctx ctx)
+{
+    int m = g_info.M, k = g_info.K, n = g_info.N;
+    for (int i = 0; i < m; i++)
+    {
+        for (int j = 0; j < n; j++)
+        {
+            if (g_info.type == RKNN_INT8_MM_INT8_TO_INT32)
+            {
+                const int8_t *A = (const int8_t *)g_mems[0]->virt_addr;
+                const int8_t *B = (const int8_t *)g_mems[1]->virt_addr;
+                int32_t sum = 0;
+                for (int p = 0; p < k; p++)
+                {
+                    sum += A[i * k + p] * B[p * n + j];
+                }
+                ((int32_t *)g_mems[2]->virt_addr)[i * n + j] = sum;
+            }
+            else
+            {
+                const rknpu2::float16 *A = (const rknpu2::float16 *)g_mems[0]->virt_addr;
+                const rknpu2::float16 *B = (const rknpu2::float16 *)g_mems[1]->virt_addr;
+                float sum = 0;
+                for (int p = 0; p < k; p++)
+                {
+                    sum += (float)A[i * k + p] * (float)B[p * n + j];
+                }
+                ((float *)g_mems[2]->virt_addr)[i * n + j] = sum;
+            }
+        }
+    }
+    g_runs++;
+    return 0;
+}
+
+int rknn_matmul_destroy(rknn_matmul_ctx ctx)
+{
+    return 0;
+}
+
+static float rand_float(float lo, float hi)
+{
+    return lo + (hi - lo) * (float)rand() / (float)RAND_MAX;
+}
+
+// largest |logits - coeff x proto| relative to the largest |coeff x proto|
+static double max_rel_err(const float *logits, const float *coeff, const float *proto, int m)
+{
+    float *ref = (float *)malloc(m * PROTO_N * sizeof(float));
+    proto_matmul_cpu(coeff, proto, ref, m, PROTO_C, PROTO_N);
+    double err = 0, peak = 0;
+    for (int i = 0; i < m * PROTO_N; i++)
+    {
+        err = fmax(err, fabs(logits[i] - ref[i]));
+        peak = fmax(peak, fabs(ref[i]));
+    }
+    free(ref);
+    return err / peak;
+}
+
+// int8 prototypes written into the operand: NPU selected and dequantized correctly
+static int check_bound(const float *coeff, int m)
+{
+    const int32_t zp = -3;
+    const float scale = 0.02f;
+    proto_matmul_t pm;
+    if (init_proto_matmul(&pm, PROTO_C, PROTO_N, true, zp, scale) != 0 || pm.npu == NULL)
+    {
+        return -1;
+    }
+    int8_t *q = (int8_t *)proto_matmul_proto_buffer(&pm, PROTO_C * PROTO_N);
+    float *proto = (float *)malloc(PROTO_C * PROTO_N * sizeof(float));
+    int ret = q != NULL ? 0 : -1;
+    if (q != NULL)
+    {
+        for (int i = 0; i < PROTO_C * PROTO_N; i++)
+        {
+            q[i] = (int8_t)(rand() % 255 - 127);
+            proto[i] = (q[i] - zp) * scale;
+        }
+        int runs = g_runs;
+        ret |= proto_matmul_select(&pm, m, pm.npu_min_macs) == PROTO_MATMUL_NPU ? 0 : -1;
+        ret |= proto_matmul_run(&pm, coeff, m, NULL);
+        double err = max_rel_err(pm.logits, coeff, proto, m);
+        printf("int8 prototypes bound: %d npu run, max relative error %.4f\n", g_runs - runs, err);
+        ret |= g_runs - runs == 1 && err < 0.01 ? 0 : -1;
+    }
+    free(proto);
+    release_proto_matmul(&pm);
+    return ret;
+}
+
+// int8 prototypes of another size: the NPU is dropped once, frames run on the CPU paths without errors
+static int check_unbound(const float *coeff, const float *proto, int m)
+{
+    proto_matmul_t pm;
+    if (init_proto_matmul(&pm, PROTO_C, PROTO_N, true, 0, 0.02f) != 0 || pm.npu == NULL)
+    {
+        return -1;
+    }
+    int ret = proto_matmul_proto_buffer(&pm, PROTO_C * PROTO_N + 64) == NULL && pm.npu == NULL ? 0 : -1;
+    int runs = g_runs;
+    int frames = 0, cpu_frames = 0;
+    for (int f = 0; f < 20; f++)
+    {
+        long plane = (long)m * PROTO_C * PROTO_N;
+        long roi_macs = f % 2 ? plane : pm.npu_min_macs;
+        proto_matmul_backend_t backend = proto_matmul_select(&pm, m, roi_macs);
+        ret |= backend != PROTO_MATMUL_NPU ? 0 : -1;
+        if (backend == PROTO_MATMUL_CPU)
+        {
+            ret |= proto_matmul_run(&pm, coeff, m, proto);
+            cpu_frames++;
+        }
+        frames++;
+    }
+    double err = max_rel_err(pm.logits, coeff, proto, m);
+    printf("int8 prototypes not bound: %d frames, %d cpu plane, %d npu runs, max relative error %.2e\n", frames,
+           cpu_frames, g_runs - runs, err);
+    ret |= g_runs == runs && cpu_frames > 0 && err < 1e-5 ? 0 : -1;
+    release_proto_matmul(&pm);
+    return ret;
+}
+
+// float prototypes are never bound, converted to fp16 every run
+static int check_float(const float *coeff, const float *proto, int m)
+{
+    proto_matmul_t pm;
+    if (init_proto_matmul(&pm, PROTO_C, PROTO_N, false, 0, 1.0f) != 0 || pm.npu == NULL)
+    {
+        return -1;
+    }
+    int ret = proto_matmul_proto_buffer(&pm, PROTO_C * PROTO_N * 4) == NULL && pm.npu != NULL ? 0 : -1;
+    ret |= proto_matmul_select(&pm, m, pm.npu_min_macs) == PROTO_MATMUL_NPU ? 0 : -1;
+    ret |= proto_matmul_run(&pm, coeff, m, proto);
+    double err = max_rel_err(pm.logits, coeff, proto, m);
+    printf("float prototypes: fp16 npu run, max relative error %.4f\n", err);
+    ret |= err < 0.01 ? 0 : -1;
+    release_proto_matmul(&pm);
+    return ret;
+}
+
+int main()
+{
+    srand(11);
+    int m = 12;
+    float *coeff = (float *)malloc(PROTO_MATMUL_MAX_M * PROTO_C * sizeof(float));
+    float *proto = (float *)malloc(PROTO_C * PROTO_N * sizeof(float));
+    for (int i = 0; i < PROTO_MATMUL_MAX_M * PROTO_C; i++)
+    {
+        coeff[i] = rand_float(-1, 1);
+    }
+    for (int i = 0; i < PROTO_C * PROTO_N; i++)
+    {
+        proto[i] = rand_float(-1, 1);
+    }
+    int ret = 0;
+    ret |= check_bound(coeff, m);
+    ret |= check_unbound(coeff, proto, m);
+    ret |= check_float(coeff, proto, m);
+    free(proto);
+    free(coeff);
+    printf("%s\n", ret == 0 ? "PASS" : "FAIL");
+    return ret == 0 ? 0 : 1;
+}
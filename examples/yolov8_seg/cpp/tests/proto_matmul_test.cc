@@ -0,0 +1,253 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "proto_matmul.h"
+#include "mask_utils.h"
+
+#define PROTO_C 32
+#define PROTO_H 160
+#define PROTO_W 160
+#define MODEL_W 640
+#define MODEL_H 640
+
+static double now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static float rand_float(float lo, float hi)
+{
+    return lo + (hi - lo) * (float)rand() / (float)RAND_MAX;
+}
+
+static int check_cpu_reference(const float *coeff, const float *proto, int m)
+{
+    int n = PROTO_H * PROTO_W;
+    float *C = (float *)malloc(m * n * sizeof(float));
+    proto_matmul_cpu(coeff, proto, C, m, PROTO_C, n);
+    double max_err = 0;
+    for (int i = 0; i < m; i++)
+    {
+        for (int j = 0; j < n; j++)
+        {
+            double ref = 0;
+            for (int p = 0; p < PROTO_C; p++)
+            {
+                ref += (double)coeff[i * PROTO_C + p] * proto[p * n + j];
+            }
+            double err = fabs(ref - C[i * n + j]);
+            max_err = err > max_err ? err : max_err;
+        }
+    }
+    free(C);
+    printf("proto_matmul_cpu: m=%d k=%d n=%d max abs err %.2e\n", m, PROTO_C, n, max_err);
+    return max_err < 1e-4 ? 0 : -1;
+}
+
+static int expect_backend(const proto_matmul_t *pm, int m, long roi_macs, proto_matmul_backend_t expected, const char *what)
+{
+    proto_matmul_backend_t backend = proto_matmul_select(pm, m, roi_macs);
+    if (backend != expected)
+    {
+        printf("select %s: m=%d roi_macs=%ld got %d, expected %d\n", what, m, roi_macs, backend, expected);
+        return -1;
+    }
+    return 0;
+}
+
+static int check_select(proto_matmul_t *pm)
+{
+    long plane = (long)PROTO_C * PROTO_H * PROTO_W;
+    int ret = 0;
+    // no NPU: the CPU full plane once the boxes add up to more than it
+    ret |= expect_backend(pm, 0, 0, PROTO_MATMUL_BOX, "no instances");
+    ret |= expect_backend(pm, 4, plane, PROTO_MATMUL_BOX, "cpu small boxes");
+    ret |= expect_backend(pm, 4, 4 * plane, PROTO_MATMUL_CPU, "cpu overlapping boxes");
+    ret |= expect_backend(pm, pm->max_m + 1, 100 * plane, PROTO_MATMUL_BOX, "more than max_m");
+    // any non-NULL handle selects the NPU above npu_min_macs, proto_matmul_run is not called with it
+    void *npu = pm->npu;
+    pm->npu = pm;
+    ret |= expect_backend(pm, 4, pm->npu_min_macs - 1, PROTO_MATMUL_BOX, "npu small boxes");
+    ret |= expect_backend(pm, 4, pm->npu_min_macs, PROTO_MATMUL_NPU, "npu large boxes");
+    pm->npu = npu;
+    printf("proto_matmul_select: %s\n", ret == 0 ? "ok" : "fail");
+    return ret;
+}
+
+// same label map from full plane logits and from the box-restricted path
+static int check_compose(proto_matmul_t *pm, const float *coeff, const float *proto, int m)
+{
+    letterbox_t letter_box = {0, 80, 0.5f};
+    int map_w = (int)(MODEL_W / letter_box.scale);
+    int map_h = (int)((MODEL_H - 2 * letter_box.y_pad) / letter_box.scale);
+    seg_instance_t *instances = (seg_instance_t *)calloc(m, sizeof(seg_instance_t));
+    for (int i = 0; i < m; i++)
+    {
+        float w = rand_float(64, 400);
+        float h = rand_float(64, 400);
+        instances[i].box[0] = rand_float(0, MODEL_W - w);
+        instances[i].box[1] = rand_float(letter_box.y_pad, MODEL_H - letter_box.y_pad - h);
+        instances[i].box[2] = instances[i].box[0] + w;
+        instances[i].box[3] = instances[i].box[1] + h;
+        instances[i].coeff = coeff + i * PROTO_C;
+        instances[i].label = i + 1;
+    }
+
+    seg_mask_engine_t *engine = create_seg_mask_engine(1);
+    uint8_t *box_map = (uint8_t *)malloc(map_w * map_h);
+    uint8_t *plane_map = (uint8_t *)malloc(map_w * map_h);
+    int ret = -1;
+    if (engine == NULL || box_map == NULL || plane_map == NULL)
+    {
+        goto out;
+    }
+
+    {
+        double t0 = now_ms();
+        if (seg_mask_compose(engine, proto, PROTO_C, PROTO_H, PROTO_W, MODEL_W, MODEL_H, &letter_box, instances, m,
+                             box_map, map_w, map_h) != 0)
+        {
+            goto out;
+        }
+        double t1 = now_ms();
+        if (proto_matmul_run(pm, coeff, m, proto) != 0)
+        {
+            goto out;
+        }
+        for (int i = 0; i < m; i++)
+        {
+            instances[i].logits = pm->logits + i * pm->n;
+        }
+        if (seg_mask_compose(engine, proto, PROTO_C, PROTO_H, PROTO_W, MODEL_W, MODEL_H, &letter_box, instances, m,
+                             plane_map, map_w, map_h) != 0)
+        {
+            goto out;
+        }
+        double t2 = now_ms();
+
+        // the sums differ only in accumulation order, a pixel may flip where the logit is ~0
+        int diff = 0;
+        for (int i = 0; i < map_w * map_h; i++)
+        {
+            diff += box_map[i] != plane_map[i];
+        }
+        printf("seg_mask_compose: %d instances, box %.2f ms, cpu plane %.2f ms, %d/%d pixels differ\n", m, t1 - t0,
+               t2 - t1, diff, map_w * map_h);
+        ret = diff <= map_w * map_h / 10000 ? 0 : -1;
+    }
+
+out:
+    free(plane_map);
+    free(box_map);
+    if (engine != NULL)
+    {
+        destroy_seg_mask_engine(engine);
+    }
+    free(instances);
+    return ret;
+}
+
+// boxes that cover no label map pixel (in the letterbox padding, zero width) leave the others unchanged
+static int check_empty_boxes(const float *coeff, const float *proto, int m)
+{
+    letterbox_t letter_box = {0, 80, 0.5f};
+    int map_w = (int)(MODEL_W / letter_box.scale);
+    int map_h = (int)((MODEL_H - 2 * letter_box.y_pad) / letter_box.scale);
+    seg_instance_t *mixed = (seg_instance_t *)calloc(2 * m, sizeof(seg_instance_t));
+    seg_instance_t *plain = (seg_instance_t *)calloc(m, sizeof(seg_instance_t));
+    for (int i = 0; i < m; i++)
+    {
+        seg_instance_t *inst = &plain[i];
+        inst->box[0] = rand_float(0, MODEL_W - 200);
+        inst->box[1] = rand_float(letter_box.y_pad, MODEL_H - letter_box.y_pad - 200);
+        inst->box[2] = inst->box[0] + 200;
+        inst->box[3] = inst->box[1] + 200;
+        inst->coeff = coeff + i * PROTO_C;
+        inst->label = i + 1;
+        mixed[2 * i] = *inst;
+        seg_instance_t *empty = &mixed[2 * i + 1];
+        *empty = *inst;
+        if (i % 2 == 0)
+        {
+            empty->box[1] = 0;
+            empty->box[3] = letter_box.y_pad - 1;
+        }
+        else
+        {
+            empty->box[2] = empty->box[0];
+        }
+    }
+
+    seg_mask_engine_t *engine = create_seg_mask_engine(2);
+    uint8_t *mixed_map = (uint8_t *)malloc(map_w * map_h);
+    uint8_t *plain_map = (uint8_t *)malloc(map_w * map_h);
+    int ret = -1;
+    if (engine != NULL && mixed_map != NULL && plain_map != NULL &&
+        seg_mask_compose(engine, proto, PROTO_C, PROTO_H, PROTO_W, MODEL_W, MODEL_H, &letter_box, plain, m, plain_map,
+                         map_w, map_h) == 0 &&
+        seg_mask_compose(engine, proto, PROTO_C, PROTO_H, PROTO_W, MODEL_W, MODEL_H, &letter_box, mixed, 2 * m,
+                         mixed_map, map_w, map_h) == 0)
+    {
+        int diff = 0;
+        for (int i = 0; i < map_w * map_h; i++)
+        {
+            diff += mixed_map[i] != plain_map[i];
+        }
+        printf("seg_mask_compose: %d instances and %d empty boxes, %d pixels differ\n", m, m, diff);
+        ret = diff == 0 ? 0 : -1;
+    }
+
+    free(plain_map);
+    free(mixed_map);
+    if (engine != NULL)
+    {
+        destroy_seg_mask_engine(engine);
+    }
+    free(plain);
+    free(mixed);
+    return ret;
+}
+
+int main()
+{
+    srand(7);
+    int n = PROTO_H * PROTO_W;
+    int m = 12;
+    float *proto = (float *)malloc(PROTO_C * n * sizeof(float));
+    float *coeff = (float *)malloc(PROTO_MATMUL_MAX_M * PROTO_C * sizeof(float));
+    for (int i = 0; i < PROTO_C * n; i++)
+    {
+        proto[i] = rand_float(-1, 1);
+    }
+    for (int i = 0; i < PROTO_MATMUL_MAX_M * PROTO_C; i++)
+    {
+        coeff[i] = rand_float(-1, 1);
+    }
+
+    proto_matmul_t pm;
+    if (init_proto_matmul(&pm, PROTO_C, n, false, 0, 1.0f) != 0)
+    {
+        return 1;
+    }
+    int ret = 0;
+    if (pm.npu != NULL)
+    {
+        printf("built without DISABLE_RKNN_MATMUL, the CPU backend is not checked\n");
+        ret = -1;
+    }
+    ret |= check_cpu_reference(coeff, proto, m);
+    ret |= check_select(&pm);
+    ret |= check_compose(&pm, coeff, proto, m);
+    ret |= check_empty_boxes(coeff, proto, m);
+    release_proto_matmul(&pm);
+
+    free(coeff);
+    free(proto);
+    printf("%s\n", ret == 0 ? "PASS" : "FAIL");
+    return ret == 0 ? 0 : 1;
+}
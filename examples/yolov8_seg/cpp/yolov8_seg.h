@@ -18,6 +18,7 @@
 
 #include "rknn_api.h"
 #include "common.h"
+#include "proto_matmul.h"
 
 typedef struct {
     rknn_context rknn_ctx;
@@ -30,6 +31,8 @@ typedef struct {
     int input_image_width;
     int input_image_height;
     bool is_quant;
+    struct seg_mask_engine* mask_engine;    // instance masks of this context, see mask_utils.h
+    proto_matmul_t proto_matmul;    // mask coefficients x prototypes, rknpu2 only
 } rknn_app_context_t;
 
 #include "postprocess.h"
@@ -55,48 +55,29 @@ int main(int argc, char **argv)
     std::vector<std::string> recognized_text;
     std::vector<float> timestamp;
     rknn_zipformer_context_t rknn_app_ctx;
-    VocabEntry vocab[VOCAB_NUM];
-    audio_buffer_t audio;
+    asset_t vocab;
+    audio_source_t source;
     memset(&rknn_app_ctx, 0, sizeof(rknn_zipformer_context_t));
-    memset(vocab, 0, sizeof(vocab));
-    memset(&audio, 0, sizeof(audio_buffer_t));
+    memset(&vocab, 0, sizeof(asset_t));
+    memset(&source, 0, sizeof(audio_source_t));
 
     timer.tik();
-    ret = read_audio(audio_path, &audio);
+    // decoded, downmixed and resampled in the background while the model runs
+    ret = open_audio_source(audio_path, SAMPLE_RATE, 1, &source);
     if (ret != 0)
     {
-        printf("read audio fail! ret=%d audio_path=%s\n", ret, audio_path);
+        printf("open audio source fail! ret=%d audio_path=%s\n", ret, audio_path);
         goto out;
     }
 
-    if (audio.num_channels == 2)
-    {
-        ret = convert_channels(&audio);
-        if (ret != 0)
-        {
-            printf("convert channels fail! ret=%d\n", ret, audio_path);
-            goto out;
-        }
-    }
-
-    if (audio.sample_rate != SAMPLE_RATE)
-    {
-        ret = resample_audio(&audio, audio.sample_rate, SAMPLE_RATE);
-        if (ret != 0)
-        {
-            printf("resample audio fail! ret=%d\n", ret, audio_path);
-            goto out;
-        }
-    }
-
-    ret = read_vocab(VOCAB_PATH, vocab);
+    ret = load_vocab(VOCAB_PATH, &vocab);
     if (ret != 0)
     {
-        printf("read vocab fail! ret=%d vocab_path=%s\n", ret, VOCAB_PATH);
+        printf("load vocab fail! ret=%d vocab_path=%s\n", ret, VOCAB_PATH);
         goto out;
     }
     timer.tok();
-    timer.print_time("read_audio & convert_channels & resample_audio & read_vocab");
+    timer.print_time("open_audio_source & load_vocab");
 
     timer.tik();
     ret = init_zipformer_model(encoder_path, &rknn_app_ctx.encoder_context);
@@ -105,7 +86,12 @@ int main(int argc, char **argv)
         printf("init_zipformer_model fail! ret=%d encoder_path=%s\n", ret, encoder_path);
         goto out;
     }
-    build_input_output(&rknn_app_ctx.encoder_context);
+    ret = build_encoder_io(&rknn_app_ctx.encoder_context, &rknn_app_ctx.encoder_io);
+    if (ret != 0)
+    {
+        printf("build_encoder_io fail! ret=%d\n", ret);
+        goto out;
+    }
     timer.tok();
     timer.print_time("init_zipformer_encoder_model");
 
@@ -132,7 +118,7 @@ int main(int argc, char **argv)
     timer.print_time("init_zipformer_joiner_model");
 
     timer.tik();
-    ret = inference_zipformer_model(&rknn_app_ctx, audio, vocab, recognized_text, timestamp, audio_length);
+    ret = inference_zipformer_model(&rknn_app_ctx, &source, &vocab, recognized_text, timestamp, audio_length);
     if (ret != 0)
     {
         printf("inference_zipformer_model fail! ret=%d\n", ret);
@@ -144,6 +130,10 @@ int main(int argc, char **argv)
     infer_time = timer.get_time() / 1000.0; // sec
     rtf = infer_time / audio_length;
     printf("\nReal Time Factor (RTF): %.3f / %.3f = %.3f\n", infer_time, audio_length, rtf);
+    if (rknn_app_ctx.encoder_chunks > 0)
+    {
+        printf("Encoder: %d chunks, %.3f ms per chunk\n", rknn_app_ctx.encoder_chunks, rknn_app_ctx.encoder_time / rknn_app_ctx.encoder_chunks);
+    }
 
     // print result
     std::cout << "\nTimestamp (s): ";
@@ -167,20 +157,11 @@ int main(int argc, char **argv)
 
 out:
 
-    if (audio.data)
-    {
-        free(audio.data);
-    }
+    close_audio_source(&source);
 
-    for (int i = 0; i < VOCAB_NUM; i++)
-    {
-        if (vocab[i].token)
-        {
-            free(vocab[i].token);
-            vocab[i].token = NULL;
-        }
-    }
+    close_asset(&vocab);
 
+    release_encoder_io(&rknn_app_ctx.encoder_context, &rknn_app_ctx.encoder_io);
     ret = release_zipformer_model(&rknn_app_ctx.encoder_context);
     if (ret != 0)
     {
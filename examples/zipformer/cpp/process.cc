@@ -19,23 +19,6 @@
 #include <stdlib.h>
 #include <string.h>
 
-void convert_nchw_to_nhwc(float *src, float *dst, int N, int channels, int height, int width)
-{
-    for (int n = 0; n < N; ++n)
-    {
-        for (int c = 0; c < channels; ++c)
-        {
-            for (int h = 0; h < height; ++h)
-            {
-                for (int w = 0; w < width; ++w)
-                {
-                    dst[n * height * width * channels + h * width * channels + w * channels + c] = src[n * channels * height * width + c * height * width + h * width + w];
-                }
-            }
-        }
-    }
-}
-
 int get_kbank_frames(knf::OnlineFbank *fbank, int frame_index, int segment, float *frames)
 {
     if (frame_index + segment > fbank->NumFramesReady())
@@ -81,8 +64,14 @@ void replace_substr(std::string &str, const std::string &from, const std::string
     }
 }
 
-int read_vocab(const char *fileName, VocabEntry *vocab)
+int load_vocab(const char *fileName, asset_t *vocab)
 {
+    int ret = open_text_asset(fileName, ASSET_STRINGS, vocab);
+    if (ret <= 0)
+    {
+        return ret;
+    }
+
     FILE *fp;
     char line[512];
 
@@ -93,17 +82,32 @@ int read_vocab(const char *fileName, VocabEntry *vocab)
         return -1;
     }
 
-    int count = 0;
+    std::vector<std::string> tokens(VOCAB_NUM);
     while (fgets(line, sizeof(line), fp))
     {
-        vocab[count].index = atoi(strchr(line, ' ') + 1); // get token before the first space
-        char *token = strtok(line, " ");
-        vocab[count].token = strdup(token); // Get index after the first space
-
-        count++;
+        char *space = strchr(line, ' ');
+        if (space == NULL)
+        {
+            continue;
+        }
+        int index = atoi(space + 1); // get index after the first space
+        if (index >= 0 && index < VOCAB_NUM)
+        {
+            tokens[index].assign(line, space - line); // get token before the first space
+        }
     }
 
     fclose(fp);
 
-    return 0;
+    std::vector<const char *> strings(VOCAB_NUM);
+    for (int i = 0; i < VOCAB_NUM; i++)
+    {
+        strings[i] = tokens[i].c_str();
+    }
+    ret = create_string_asset(strings.data(), VOCAB_NUM, vocab);
+    if (ret == 0)
+    {
+        save_text_asset(vocab, fileName); // mapped on the next start
+    }
+    return ret;
 }
\ No newline at end of file
@@ -5,6 +5,7 @@
 
 #include "rknn_api.h"
 #include "easy_timer.h"
+#include "asset_utils.h"
 #include "kaldi-native-fbank/csrc/online-feature.h"
 
 #define VOCAB_NUM 6257
@@ -21,16 +22,18 @@
 
 #define VOCAB_PATH "./model/vocab.txt"
 
-typedef struct
-{
-    int index;
-    char *token;
-} VocabEntry;
-
 int get_kbank_frames(knf::OnlineFbank *fbank, int frame_index, int segment, float *frames);
-void convert_nchw_to_nhwc(float *src, float *dst, int N, int channels, int height, int width);
 int argmax(float *array);
 void replace_substr(std::string &str, const std::string &from, const std::string &to);
-int read_vocab(const char *fileName, VocabEntry *vocab);
+
+/**
+ * @brief Load vocabulary, "<name>.bin" is memory mapped unless "<name>.txt" changed since it was converted,
+ * else the text is parsed and "<name>.bin" rebuilt from it
+ *
+ * @param fileName [in] Text vocabulary path, "<token> <id>" lines
+ * @param vocab [out] String asset, tokens indexed by id
+ * @return int 0: success; -1: error
+ */
+int load_vocab(const char *fileName, asset_t *vocab);
 
 #endif //_RKNN_ZIPFORMER_DEMO_PROCESS_H_
@@ -0,0 +1,255 @@
+// Copyright (c) 2024 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "zipformer.h"
+#include "layout_utils.h"
+
+static bool same_layout(const rknn_tensor_attr *a, const rknn_tensor_attr *b)
+{
+    if (a->type != b->type || a->fmt != b->fmt || a->n_dims != b->n_dims || a->size_with_stride != b->size_with_stride)
+    {
+        return false;
+    }
+    for (int i = 0; i < a->n_dims; i++)
+    {
+        if (a->dims[i] != b->dims[i])
+        {
+            return false;
+        }
+    }
+    // a quantized state is only fed back unchanged when both ends share its quantization
+    if (a->qnt_type != b->qnt_type)
+    {
+        return false;
+    }
+    if (a->qnt_type == RKNN_TENSOR_QNT_AFFINE_ASYMMETRIC && (a->zp != b->zp || a->scale != b->scale))
+    {
+        return false;
+    }
+    if (a->qnt_type == RKNN_TENSOR_QNT_DFP && a->fl != b->fl)
+    {
+        return false;
+    }
+    return true;
+}
+
+// float32 in the normal layout, the runtime converts to and from the native one
+static uint32_t float_io_attr(rknn_tensor_attr *attr)
+{
+    attr->pass_through = 0;
+    if (attr->type == RKNN_TENSOR_INT64)
+    {
+        return attr->n_elems * sizeof(int64_t);
+    }
+    attr->type = RKNN_TENSOR_FLOAT32;
+    return attr->n_elems * sizeof(float);
+}
+
+static int bind_encoder_states(rknn_app_context_t *app_ctx, rknn_encoder_io_t *io, bool copied)
+{
+    for (int i = 0; i < io->n_state; i++)
+    {
+        if (io->state_copy[i] != copied)
+        {
+            continue;
+        }
+        int cur = copied ? 0 : io->cur;
+        int ret = rknn_set_io_mem(app_ctx->rknn_ctx, io->state_mems[2 * i + cur], &io->state_in_attrs[i]);
+        if (ret < 0)
+        {
+            printf("rknn_set_io_mem state input %d fail! ret=%d\n", i + 1, ret);
+            return ret;
+        }
+        ret = rknn_set_io_mem(app_ctx->rknn_ctx, io->state_mems[2 * i + 1 - cur], &io->state_out_attrs[i]);
+        if (ret < 0)
+        {
+            printf("rknn_set_io_mem state output %d fail! ret=%d\n", i + 1, ret);
+            return ret;
+        }
+    }
+    return 0;
+}
+
+int build_encoder_io(rknn_app_context_t *app_ctx, rknn_encoder_io_t *io)
+{
+    int ret;
+    int n_copy = 0;
+    rknn_context ctx = app_ctx->rknn_ctx;
+    memset(io, 0, sizeof(rknn_encoder_io_t));
+    if (app_ctx->io_num.n_input != app_ctx->io_num.n_output)
+    {
+        printf("encoder inputs and outputs do not pair up\n");
+        return -1;
+    }
+
+    io->input_attr = app_ctx->input_attrs[0];
+    io->output_attr = app_ctx->output_attrs[0];
+    io->input_mem = rknn_create_mem(ctx, float_io_attr(&io->input_attr));
+    io->output_mem = rknn_create_mem(ctx, float_io_attr(&io->output_attr));
+    if (io->input_mem == NULL || io->output_mem == NULL)
+    {
+        printf("rknn_create_mem fail!\n");
+        goto fail;
+    }
+    if (rknn_set_io_mem(ctx, io->input_mem, &io->input_attr) < 0 || rknn_set_io_mem(ctx, io->output_mem, &io->output_attr) < 0)
+    {
+        printf("rknn_set_io_mem fail!\n");
+        goto fail;
+    }
+
+    io->n_state = app_ctx->io_num.n_input - 1;
+    io->state_in_attrs = (rknn_tensor_attr *)calloc(io->n_state, sizeof(rknn_tensor_attr));
+    io->state_out_attrs = (rknn_tensor_attr *)calloc(io->n_state, sizeof(rknn_tensor_attr));
+    io->state_mems = (rknn_tensor_mem **)calloc(2 * io->n_state, sizeof(rknn_tensor_mem *));
+    io->state_copy = (bool *)calloc(io->n_state, sizeof(bool));
+    if (io->state_in_attrs == NULL || io->state_out_attrs == NULL || io->state_mems == NULL || io->state_copy == NULL)
+    {
+        printf("malloc encoder states fail!\n");
+        goto fail;
+    }
+
+    for (int i = 0; i < io->n_state; i++)
+    {
+        rknn_tensor_attr *in_attr = &io->state_in_attrs[i];
+        rknn_tensor_attr *out_attr = &io->state_out_attrs[i];
+        in_attr->index = i + 1;
+        out_attr->index = i + 1;
+        ret = rknn_query(ctx, RKNN_QUERY_NATIVE_INPUT_ATTR, in_attr, sizeof(rknn_tensor_attr));
+        if (ret == RKNN_SUCC)
+        {
+            ret = rknn_query(ctx, RKNN_QUERY_NATIVE_OUTPUT_ATTR, out_attr, sizeof(rknn_tensor_attr));
+        }
+#ifdef ZIPFORMER_COPY_STATES
+        io->state_copy[i] = true;
+#else
+        io->state_copy[i] = ret != RKNN_SUCC || !same_layout(in_attr, out_attr);
+#endif
+
+        uint32_t in_size, out_size;
+        if (io->state_copy[i])
+        {
+            *in_attr = app_ctx->input_attrs[i + 1];
+            *out_attr = app_ctx->output_attrs[i + 1];
+            in_size = float_io_attr(in_attr);
+            out_size = float_io_attr(out_attr);
+        }
+        else
+        {
+            // the output is fed back as it is
+            in_attr->pass_through = 1;
+            in_size = in_attr->size_with_stride;
+            out_size = in_size;
+        }
+        io->state_mems[2 * i] = rknn_create_mem(ctx, in_size);
+        io->state_mems[2 * i + 1] = rknn_create_mem(ctx, out_size);
+        if (io->state_mems[2 * i] == NULL || io->state_mems[2 * i + 1] == NULL)
+        {
+            printf("rknn_create_mem fail!\n");
+            goto fail;
+        }
+        // initial states are zero, in any layout
+        memset(io->state_mems[2 * i]->virt_addr, 0, in_size);
+        memset(io->state_mems[2 * i + 1]->virt_addr, 0, out_size);
+    }
+
+    if (bind_encoder_states(app_ctx, io, true) < 0 || bind_encoder_states(app_ctx, io, false) < 0)
+    {
+        goto fail;
+    }
+
+    for (int i = 0; i < io->n_state; i++)
+    {
+        n_copy += io->state_copy[i];
+    }
+    printf("encoder states: %d swapped, %d copied\n", io->n_state - n_copy, n_copy);
+    return 0;
+
+fail:
+    release_encoder_io(app_ctx, io);
+    return -1;
+}
+
+void release_encoder_io(rknn_app_context_t *app_ctx, rknn_encoder_io_t *io)
+{
+    if (io->input_mem != NULL)
+    {
+        rknn_destroy_mem(app_ctx->rknn_ctx, io->input_mem);
+        io->input_mem = NULL;
+    }
+    if (io->output_mem != NULL)
+    {
+        rknn_destroy_mem(app_ctx->rknn_ctx, io->output_mem);
+        io->output_mem = NULL;
+    }
+    if (io->state_mems != NULL)
+    {
+        for (int i = 0; i < 2 * io->n_state; i++)
+        {
+            if (io->state_mems[i] != NULL)
+            {
+                rknn_destroy_mem(app_ctx->rknn_ctx, io->state_mems[i]);
+            }
+        }
+        free(io->state_mems);
+        io->state_mems = NULL;
+    }
+    if (io->state_in_attrs != NULL)
+    {
+        free(io->state_in_attrs);
+        io->state_in_attrs = NULL;
+    }
+    if (io->state_out_attrs != NULL)
+    {
+        free(io->state_out_attrs);
+        io->state_out_attrs = NULL;
+    }
+    if (io->state_copy != NULL)
+    {
+        free(io->state_copy);
+        io->state_copy = NULL;
+    }
+    io->n_state = 0;
+}
+
+int update_encoder_states(rknn_app_context_t *app_ctx, rknn_encoder_io_t *io)
+{
+    // copied states go from the output buffer to the input buffer, the others swap buffers
+    for (int i = 0; i < io->n_state; i++)
+    {
+        if (!io->state_copy[i])
+        {
+            continue;
+        }
+        rknn_tensor_attr *attr = &io->state_in_attrs[i];
+        void *src = io->state_mems[2 * i + 1]->virt_addr;
+        void *dst = io->state_mems[2 * i]->virt_addr;
+        if (attr->fmt == RKNN_TENSOR_NHWC && attr->type == RKNN_TENSOR_FLOAT32)
+        {
+            tensor_layout_desc_t src_desc;
+            tensor_layout_desc_t dst_desc;
+            init_layout_desc(&src_desc, TENSOR_LAYOUT_NCHW, attr->dims[0], attr->dims[3], attr->dims[1], attr->dims[2], 0);
+            init_layout_desc(&dst_desc, TENSOR_LAYOUT_NHWC, attr->dims[0], attr->dims[3], attr->dims[1], attr->dims[2], 0);
+            convert_layout(src, &src_desc, dst, &dst_desc, sizeof(float), 0);
+        }
+        else
+        {
+            memcpy(dst, src, io->state_mems[2 * i]->size);
+        }
+    }
+    io->cur ^= 1;
+    return bind_encoder_states(app_ctx, io, false);
+}
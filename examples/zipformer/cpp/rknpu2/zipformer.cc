@@ -18,6 +18,8 @@
 #include <math.h>
 #include "zipformer.h"
 #include "process.h"
+#include "file_utils.h"
+#include "model_registry.h"
 
 static void dump_tensor_attr(rknn_tensor_attr *attr)
 {
@@ -98,15 +100,13 @@ void build_input_output(rknn_app_context_t *app_ctx)
 int init_zipformer_model(const char *model_path, rknn_app_context_t *app_ctx)
 {
     int ret;
-    int model_len = 0;
-    char *model;
     rknn_context ctx = 0;
 
     // Load RKNN Model
-    ret = rknn_init(&ctx, (void *)model_path, model_len, 0, NULL);
+    ret = acquire_model_context(model_path, 0, &ctx);
     if (ret < 0)
     {
-        printf("rknn_init fail! ret=%d\n", ret);
+        printf("acquire_model_context fail! ret=%d\n", ret);
         return -1;
     }
 
@@ -165,7 +165,8 @@ int init_zipformer_model(const char *model_path, rknn_app_context_t *app_ctx)
 
 static void release_input_output(rknn_app_context_t *app_ctx)
 {
-    for (int i = 0; i < app_ctx->io_num.n_input; i++)
+    // the encoder is bound with build_encoder_io instead
+    for (int i = 0; app_ctx->inputs != NULL && i < app_ctx->io_num.n_input; i++)
     {
         if (app_ctx->inputs[i].buf != NULL)
         {
@@ -174,7 +175,7 @@ static void release_input_output(rknn_app_context_t *app_ctx)
         }
     }
 
-    for (int i = 0; i < app_ctx->io_num.n_output; i++)
+    for (int i = 0; app_ctx->outputs != NULL && i < app_ctx->io_num.n_output; i++)
     {
         if (app_ctx->outputs[i].buf != NULL)
         {
@@ -212,7 +213,7 @@ int release_zipformer_model(rknn_app_context_t *app_ctx)
 
     if (app_ctx->rknn_ctx != 0)
     {
-        rknn_destroy(app_ctx->rknn_ctx);
+        release_model_context(app_ctx->rknn_ctx);
         app_ctx->rknn_ctx = 0;
     }
 
@@ -225,53 +226,19 @@ int release_zipformer_model(rknn_app_context_t *app_ctx)
     return 0;
 }
 
-static int inference_encoder_model(rknn_app_context_t *app_ctx)
+static int inference_encoder_model(rknn_app_context_t *app_ctx, rknn_encoder_io_t *io)
 {
     int ret = 0;
 
-    // Set Input Data
-    ret = rknn_inputs_set(app_ctx->rknn_ctx, app_ctx->io_num.n_input, app_ctx->inputs);
-    if (ret < 0)
-    {
-        printf("rknn_input_set fail! ret=%d\n", ret);
-        goto out;
-    }
-
-    // Run
+    // Run, every input and output is bound to io
     ret = rknn_run(app_ctx->rknn_ctx, nullptr);
     if (ret < 0)
     {
         printf("rknn_run fail! ret=%d\n", ret);
-        goto out;
-    }
-
-    // Get Output
-    ret = rknn_outputs_get(app_ctx->rknn_ctx, app_ctx->io_num.n_output, app_ctx->outputs, NULL);
-    if (ret < 0)
-    {
-        printf("rknn_outputs_get fail! ret=%d\n", ret);
-        goto out;
-    }
-
-    for (int i = 1; i < app_ctx->io_num.n_input; i++)
-    {
-        if (app_ctx->input_attrs[i].fmt == RKNN_TENSOR_NHWC)
-        {
-            int N = app_ctx->input_attrs[i].dims[0];
-            int H = app_ctx->input_attrs[i].dims[1];
-            int W = app_ctx->input_attrs[i].dims[2];
-            int C = app_ctx->input_attrs[i].dims[3];
-            convert_nchw_to_nhwc((float *)app_ctx->outputs[i].buf, (float *)app_ctx->inputs[i].buf, N, C, H, W);
-        }
-        else
-        {
-            memcpy(app_ctx->inputs[i].buf, app_ctx->outputs[i].buf, app_ctx->inputs[i].size);
-        }
+        return ret;
     }
 
-out:
-
-    return ret;
+    return update_encoder_states(app_ctx, io);
 }
 
 static int inference_decoder_model(rknn_app_context_t *app_ctx)
@@ -343,16 +310,21 @@ out:
 }
 
 static int greedy_search(rknn_zipformer_context_t *app_ctx, float *encoder_input, float *encoder_output, float *decoder_output, int64_t *hyp,
-                         float *joiner_output, VocabEntry *vocab, std::vector<std::string> &recognized_text, std::vector<float> &timestamp, int num_processed_frames, int &frame_offset)
+                         float *joiner_output, const asset_t *vocab, std::vector<std::string> &recognized_text, std::vector<float> &timestamp, int num_processed_frames, int &frame_offset)
 {
     int ret = 0;
 
-    ret = inference_encoder_model(&app_ctx->encoder_context);
+    TIMER timer;
+    timer.tik();
+    ret = inference_encoder_model(&app_ctx->encoder_context, &app_ctx->encoder_io);
     if (ret < 0)
     {
         printf("inference_encoder_model fail! ret=%d\n", ret);
         return ret;
     }
+    timer.tok();
+    app_ctx->encoder_chunks++;
+    app_ctx->encoder_time += timer.get_time();
 
     if (num_processed_frames == 0)
     {
@@ -385,7 +357,7 @@ static int greedy_search(rknn_zipformer_context_t *app_ctx, float *encoder_input
             }
 
             hyp[CONTEXT_SIZE - 1] = (int64_t)next_token;
-            std::string next_token_str = vocab[next_token].token;
+            std::string next_token_str = get_asset_string(vocab, next_token);
             replace_substr(next_token_str, "▁", " ");
             recognized_text.push_back(next_token_str);
             ret = inference_decoder_model(&app_ctx->decoder_context);
@@ -402,15 +374,15 @@ static int greedy_search(rknn_zipformer_context_t *app_ctx, float *encoder_input
     return ret;
 }
 
-int inference_zipformer_model(rknn_zipformer_context_t *app_ctx, audio_buffer_t audio, VocabEntry *vocab, std::vector<std::string> &recognized_text,
+int inference_zipformer_model(rknn_zipformer_context_t *app_ctx, audio_source_t *source, const asset_t *vocab, std::vector<std::string> &recognized_text,
                               std::vector<float> &timestamp, float &audio_length)
 {
-    int ret;
+    int ret = 0;
     recognized_text.clear();
     timestamp.clear();
 
-    float *encoder_input = (float *)app_ctx->encoder_context.inputs[0].buf;
-    float *encoder_output = (float *)app_ctx->encoder_context.outputs[0].buf;
+    float *encoder_input = (float *)app_ctx->encoder_io.input_mem->virt_addr;
+    float *encoder_output = (float *)app_ctx->encoder_io.output_mem->virt_addr;
     int64_t *hyp = (int64_t *)app_ctx->decoder_context.inputs[0].buf;
     float *decoder_output = (float *)app_ctx->decoder_context.outputs[0].buf;
     float *joiner_output = (float *)app_ctx->joiner_context.outputs[0].buf;
@@ -425,13 +397,50 @@ int inference_zipformer_model(rknn_zipformer_context_t *app_ctx, audio_buffer_t
 
     int num_frames = 0;
     int num_processed_frames = 0;
+    int num_popped_frames = 0;
     int offset = N_OFFSET;
     int segment = N_SEGMENT;
     float tail_pad_length = 0.0; // sec
-    fbank.AcceptWaveform(SAMPLE_RATE, audio.data, audio.num_frames);
-    num_frames = fbank.NumFramesReady();
     int frame_offset = 0;
+    std::vector<float> block(AUDIO_SOURCE_BLOCK);
+
+    // full segments are decoded while the audio is still being read, only the features
+    // of the current segment are kept
+    while (true)
+    {
+        int n = read_audio_source(source, block.data(), block.size());
+        if (n < 0)
+        {
+            printf("read_audio_source fail! ret=%d\n", n);
+            return n;
+        }
+        if (n == 0)
+        {
+            break;
+        }
+        fbank.AcceptWaveform(SAMPLE_RATE, block.data(), n);
+        num_frames = fbank.NumFramesReady();
 
+        while (num_frames - num_processed_frames >= segment)
+        {
+            ret = get_kbank_frames(&fbank, num_processed_frames, segment, encoder_input);
+            if (ret < 0)
+            {
+                return ret;
+            }
+            ret = greedy_search(app_ctx, encoder_input, encoder_output, decoder_output, hyp, joiner_output, vocab, recognized_text, timestamp, num_processed_frames, frame_offset);
+            if (ret < 0)
+            {
+                printf("greedy_search fail! ret=%d\n", ret);
+                return ret;
+            }
+            num_processed_frames += offset;
+        }
+        fbank.Pop(num_processed_frames - num_popped_frames);
+        num_popped_frames = num_processed_frames;
+    }
+
+    num_frames = fbank.NumFramesReady();
     while ((num_frames - num_processed_frames) > 0)
     {
         if ((num_frames - num_processed_frames) < segment)
@@ -456,9 +465,9 @@ int inference_zipformer_model(rknn_zipformer_context_t *app_ctx, audio_buffer_t
         num_processed_frames += offset;
     }
 
-    audio_length = (float)audio.num_frames / audio.sample_rate + tail_pad_length;
+    audio_length = (float)source->num_read / source->sample_rate + tail_pad_length;
 
 out:
 
     return ret;
-}
\ No newline at end of file
+}
@@ -35,17 +35,48 @@ typedef struct
     rknn_output *outputs;
 } rknn_app_context_t;
 
+// define to copy every encoder state after each chunk instead of swapping buffers, for comparison
+// #define ZIPFORMER_COPY_STATES
+
+/**
+ * @brief Encoder tensors bound with rknn_set_io_mem
+ *
+ * Inputs/outputs 1..n_state are the cached states, output i is input i of the next chunk.
+ * A state whose native input and output layouts match has two buffers that swap roles
+ * after every chunk, the others are copied.
+ */
+typedef struct
+{
+    rknn_tensor_mem *input_mem;     // features, float
+    rknn_tensor_mem *output_mem;    // encoder_out, float
+    rknn_tensor_attr input_attr;
+    rknn_tensor_attr output_attr;
+    int n_state;
+    rknn_tensor_attr *state_in_attrs;
+    rknn_tensor_attr *state_out_attrs;
+    rknn_tensor_mem **state_mems;   // 2 * n_state, state i reads state_mems[2 * i + cur] and writes the other one
+    bool *state_copy;               // state i is copied from state_mems[2 * i + 1] to state_mems[2 * i]
+    int cur;
+} rknn_encoder_io_t;
+
 typedef struct
 {
     rknn_app_context_t encoder_context;
     rknn_app_context_t decoder_context;
     rknn_app_context_t joiner_context;
+    rknn_encoder_io_t encoder_io;
+    int encoder_chunks;
+    float encoder_time;             // ms, summed over chunks
 } rknn_zipformer_context_t;
 
 int init_zipformer_model(const char *model_path, rknn_app_context_t *app_ctx);
-int inference_zipformer_model(rknn_zipformer_context_t *app_ctx, audio_buffer_t audio, VocabEntry *vocab, std::vector<std::string> &recognized_text,
+int inference_zipformer_model(rknn_zipformer_context_t *app_ctx, audio_source_t *source, const asset_t *vocab, std::vector<std::string> &recognized_text,
                               std::vector<float> &timestamp, float &audio_length);
 int release_zipformer_model(rknn_app_context_t *app_ctx);
 void build_input_output(rknn_app_context_t *app_ctx);
+int build_encoder_io(rknn_app_context_t *app_ctx, rknn_encoder_io_t *io);
+void release_encoder_io(rknn_app_context_t *app_ctx, rknn_encoder_io_t *io);
+// after rknn_run of a chunk: the output states become the input states of the next one
+int update_encoder_states(rknn_app_context_t *app_ctx, rknn_encoder_io_t *io);
 
 #endif //_RKNN_DEMO_ZIPFORMER_H_
\ No newline at end of file
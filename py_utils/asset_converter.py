@@ -0,0 +1,119 @@
+"""Convert text vocabularies and filter banks to the binary asset format of utils/asset_utils.h.
+
+The C demos memory map the result instead of parsing the text file at every start.
+
+    python3 asset_converter.py vocab  vocab_en.txt vocab_en.bin                  # "<id> <token>" lines (whisper)
+    python3 asset_converter.py vocab  vocab.txt vocab.bin --token-first          # "<token> <id>" lines (zipformer)
+    python3 asset_converter.py floats mel_80_filters.txt mel_80_filters.bin --rows 80 --cols 201 [--fp16]
+"""
+import argparse
+import struct
+import sys
+
+ASSET_MAGIC = b'RKAS'
+ASSET_VERSION = 2
+ASSET_STRINGS = 1
+ASSET_FLOAT32 = 2
+ASSET_FLOAT16 = 3
+
+# magic, version, type, count, rows, cols, data_offset, data_size, chars_offset, chars_size,
+# source_size, source_hash
+HEADER = struct.Struct('<4s5I6Q')
+ALIGN = 16
+FNV_BASIS = 0xcbf29ce484222325
+FNV_PRIME = 0x100000001b3
+
+
+def align(n):
+    return (n + ALIGN - 1) // ALIGN * ALIGN
+
+
+def source_stamp(path):
+    """Size and 64-bit FNV-1a hash of the text file, the C loader rejects the asset when the text changes."""
+    with open(path, 'rb') as f:
+        data = f.read()
+    h = FNV_BASIS
+    for b in bytearray(data):
+        h = ((h ^ b) * FNV_PRIME) & 0xffffffffffffffff
+    return len(data), h
+
+
+def read_lines(path):
+    with open(path, 'rb') as f:
+        lines = f.read().split(b'\n')
+    if lines and lines[-1] == b'':
+        lines.pop()
+    return [line.rstrip(b'\r') for line in lines]
+
+
+def parse_vocab(path, token_first):
+    tokens = {}
+    for n, line in enumerate(read_lines(path)):
+        first, sep, rest = line.partition(b' ')
+        if not sep:
+            raise ValueError('{}:{}: expected two fields'.format(path, n + 1))
+        token, index = (first, rest) if token_first else (rest, first)
+        tokens[int(index)] = token
+    return tokens
+
+
+def write_strings(path, tokens, source):
+    count = max(tokens) + 1 if tokens else 0
+    chars = bytearray()
+    offsets = []
+    for i in range(count):
+        offsets.append(len(chars))
+        chars += tokens.get(i, b'') + b'\0'
+    offsets.append(len(chars))
+
+    data_offset = align(HEADER.size)
+    data_size = 4 * (count + 1)
+    chars_offset = align(data_offset + data_size)
+    with open(path, 'wb') as f:
+        f.write(HEADER.pack(ASSET_MAGIC, ASSET_VERSION, ASSET_STRINGS, count, count, 1,
+                            data_offset, data_size, chars_offset, len(chars), *source))
+        f.write(b'\0' * (data_offset - HEADER.size))
+        f.write(struct.pack('<{}I'.format(count + 1), *offsets))
+        f.write(b'\0' * (chars_offset - data_offset - data_size))
+        f.write(chars)
+    return count
+
+
+def write_floats(path, values, rows, cols, fp16, source):
+    if rows * cols != len(values):
+        raise ValueError('{} values do not make {} x {}'.format(len(values), rows, cols))
+    fmt = 'e' if fp16 else 'f'
+    data = struct.pack('<{}{}'.format(len(values), fmt), *values)
+    data_offset = align(HEADER.size)
+    with open(path, 'wb') as f:
+        f.write(HEADER.pack(ASSET_MAGIC, ASSET_VERSION, ASSET_FLOAT16 if fp16 else ASSET_FLOAT32,
+                            len(values), rows, cols, data_offset, len(data), 0, 0, *source))
+        f.write(b'\0' * (data_offset - HEADER.size))
+        f.write(data)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Convert text assets to mmap-able binary assets')
+    parser.add_argument('kind', choices=['vocab', 'floats'])
+    parser.add_argument('input')
+    parser.add_argument('output')
+    parser.add_argument('--token-first', action='store_true', help='vocab lines are "<token> <id>"')
+    parser.add_argument('--rows', type=int, help='float rows')
+    parser.add_argument('--cols', type=int, help='float columns')
+    parser.add_argument('--fp16', action='store_true', help='store floats as IEEE half')
+    args = parser.parse_args()
+
+    if args.kind == 'vocab':
+        count = write_strings(args.output, parse_vocab(args.input, args.token_first), source_stamp(args.input))
+        print('{}: {} strings'.format(args.output, count))
+    else:
+        values = [float(v) for v in open(args.input).read().split()]
+        rows = args.rows if args.rows else 1
+        cols = args.cols if args.cols else len(values) // rows
+        write_floats(args.output, values, rows, cols, args.fp16, source_stamp(args.input))
+        print('{}: {} x {} {}'.format(args.output, rows, cols, 'fp16' if args.fp16 else 'fp32'))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
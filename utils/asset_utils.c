@@ -0,0 +1,326 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "asset_utils.h"
+#include "half_utils.h"
+
+#define ASSET_ALIGN 16
+// version 1 headers end before the text source fields
+#define ASSET_V1_HEADER_SIZE offsetof(asset_header_t, source_size)
+
+static int check_header(const asset_header_t* h, uint64_t size, int type, const char* path)
+{
+    if (size < ASSET_V1_HEADER_SIZE || memcmp(h->magic, ASSET_MAGIC, 4) != 0) {
+        printf("%s is not an asset file\n", path);
+        return -1;
+    }
+    if (h->version < 1 || h->version > ASSET_VERSION) {
+        printf("%s asset version %u not supported\n", path, h->version);
+        return -1;
+    }
+    uint64_t header_size = h->version == 1 ? ASSET_V1_HEADER_SIZE : sizeof(asset_header_t);
+    if (size < header_size) {
+        printf("%s is not an asset file\n", path);
+        return -1;
+    }
+    if (type != 0 && h->type != (uint32_t)type) {
+        printf("%s asset type %u, expected %d\n", path, h->type, type);
+        return -1;
+    }
+    if (h->data_offset % ASSET_ALIGN != 0 || h->data_offset < header_size || h->data_offset > size ||
+        h->data_size > size - h->data_offset) {
+        printf("%s asset data out of range\n", path);
+        return -1;
+    }
+    switch (h->type) {
+    case ASSET_STRINGS:
+        if (h->data_size != ((uint64_t)h->count + 1) * sizeof(uint32_t) ||
+            h->chars_offset > size || h->chars_size > size - h->chars_offset) {
+            printf("%s string table out of range\n", path);
+            return -1;
+        }
+        break;
+    case ASSET_FLOAT32:
+    case ASSET_FLOAT16:
+        if ((uint64_t)h->rows * h->cols != h->count ||
+            h->data_size != (uint64_t)h->count * (h->type == ASSET_FLOAT32 ? 4 : 2)) {
+            printf("%s values out of range\n", path);
+            return -1;
+        }
+        break;
+    default:
+        printf("%s asset type %u unknown\n", path, h->type);
+        return -1;
+    }
+    return 0;
+}
+
+int open_asset(const char* path, int type, asset_t* asset)
+{
+    memset(asset, 0, sizeof(asset_t));
+    if (map_model_file(path, &asset->file) != 0) {
+        return -1;
+    }
+    const asset_header_t* h = (const asset_header_t*)asset->file.data;
+    if (check_header(h, asset->file.size, type, path) != 0) {
+        close_asset(asset);
+        return -1;
+    }
+    const char* base = (const char*)asset->file.data;
+    asset->type = h->type;
+    asset->count = h->count;
+    asset->rows = h->type == ASSET_STRINGS ? h->count : h->rows;
+    asset->cols = h->type == ASSET_STRINGS ? 1 : h->cols;
+    asset->data = base + h->data_offset;
+    if (h->version >= 2) {
+        asset->source_size = h->source_size;
+        asset->source_hash = h->source_hash;
+    }
+    if (h->type == ASSET_STRINGS) {
+        asset->offsets = (const uint32_t*)asset->data;
+        asset->chars = base + h->chars_offset;
+        // every string is NUL-terminated inside chars
+        if (asset->offsets[h->count] != h->chars_size || (h->chars_size > 0 && asset->chars[h->chars_size - 1] != '\0')) {
+            printf("%s string table is corrupt\n", path);
+            close_asset(asset);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+uint64_t asset_source_hash(const void* data, size_t size, uint64_t hash)
+{
+    const unsigned char* p = (const unsigned char*)data;
+    hash = hash != 0 ? hash : 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ p[i]) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static int hash_file(const char* path, uint64_t* size, uint64_t* hash)
+{
+    FILE* fp = fopen(path, "rb");
+    if (fp == NULL) {
+        return -1;
+    }
+    unsigned char buf[65536];
+    size_t n;
+    *size = 0;
+    *hash = asset_source_hash(NULL, 0, 0);
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+        *hash = asset_source_hash(buf, n, *hash);
+        *size += n;
+    }
+    int ret = ferror(fp) ? -1 : 0;
+    fclose(fp);
+    return ret;
+}
+
+int binary_asset_path(const char* text_path, char* bin_path, size_t size)
+{
+    const char* dot = strrchr(text_path, '.');
+    const char* slash = strrchr(text_path, '/');
+    size_t stem = dot != NULL && (slash == NULL || dot > slash) ? (size_t)(dot - text_path) : strlen(text_path);
+    if (stem + sizeof(".bin") > size) {
+        return -1;
+    }
+    memcpy(bin_path, text_path, stem);
+    memcpy(bin_path + stem, ".bin", sizeof(".bin"));
+    return 0;
+}
+
+int open_text_asset(const char* text_path, int type, asset_t* asset)
+{
+    char bin_path[4096];
+    struct stat text_st, bin_st;
+    memset(asset, 0, sizeof(asset_t));
+    if (binary_asset_path(text_path, bin_path, sizeof(bin_path)) != 0 || stat(bin_path, &bin_st) != 0) {
+        return 1;
+    }
+    if (open_asset(bin_path, type, asset) != 0) {
+        return -1;
+    }
+    // no text to compare with, or the binary was written after it
+    if (stat(text_path, &text_st) != 0 || bin_st.st_mtime > text_st.st_mtime) {
+        return 0;
+    }
+    uint64_t size, hash;
+    if (asset->source_size == (uint64_t)text_st.st_size && hash_file(text_path, &size, &hash) == 0 &&
+        size == asset->source_size && hash == asset->source_hash) {
+        return 0;
+    }
+    printf("%s was converted from another %s, parsing the text\n", bin_path, text_path);
+    close_asset(asset);
+    return 1;
+}
+
+static int write_padding(FILE* fp, uint64_t from, uint64_t to)
+{
+    static const char zeros[ASSET_ALIGN] = {0};
+    return to > from && fwrite(zeros, 1, to - from, fp) != to - from ? -1 : 0;
+}
+
+static uint64_t align_offset(uint64_t offset)
+{
+    return (offset + ASSET_ALIGN - 1) / ASSET_ALIGN * ASSET_ALIGN;
+}
+
+int save_text_asset(const asset_t* asset, const char* text_path)
+{
+    char bin_path[4096];
+    char tmp_path[4096 + 32];
+    asset_header_t h;
+    memset(&h, 0, sizeof(h));
+    if (binary_asset_path(text_path, bin_path, sizeof(bin_path)) != 0 ||
+        hash_file(text_path, &h.source_size, &h.source_hash) != 0) {
+        return -1;
+    }
+    memcpy(h.magic, ASSET_MAGIC, 4);
+    h.version = ASSET_VERSION;
+    h.type = asset->type;
+    h.count = asset->count;
+    h.rows = asset->rows;
+    h.cols = asset->cols;
+    h.data_offset = align_offset(sizeof(asset_header_t));
+    if (asset->type == ASSET_STRINGS) {
+        h.data_size = ((uint64_t)asset->count + 1) * sizeof(uint32_t);
+        h.chars_offset = align_offset(h.data_offset + h.data_size);
+        h.chars_size = asset->offsets[asset->count];
+    } else if (asset->type == ASSET_FLOAT32 || asset->type == ASSET_FLOAT16) {
+        h.data_size = (uint64_t)asset->count * (asset->type == ASSET_FLOAT32 ? 4 : 2);
+    } else {
+        return -1;
+    }
+
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%d.tmp", bin_path, (int)getpid());
+    FILE* fp = fopen(tmp_path, "wb");
+    if (fp == NULL) {
+        printf("cannot write %s, %s is parsed again next time\n", bin_path, text_path);
+        return -1;
+    }
+    int ret = fwrite(&h, 1, sizeof(h), fp) == sizeof(h) ? 0 : -1;
+    ret |= write_padding(fp, sizeof(h), h.data_offset);
+    ret |= fwrite(asset->data, 1, h.data_size, fp) == h.data_size ? 0 : -1;
+    if (asset->type == ASSET_STRINGS) {
+        ret |= write_padding(fp, h.data_offset + h.data_size, h.chars_offset);
+        ret |= fwrite(asset->chars, 1, h.chars_size, fp) == h.chars_size ? 0 : -1;
+    }
+    ret |= fclose(fp) == 0 ? 0 : -1;
+    if (ret != 0 || rename(tmp_path, bin_path) != 0) {
+        printf("cannot write %s, %s is parsed again next time\n", bin_path, text_path);
+        remove(tmp_path);
+        return -1;
+    }
+    printf("%s rebuilt from %s\n", bin_path, text_path);
+    return 0;
+}
+
+int create_string_asset(const char* const* strings, int count, asset_t* asset)
+{
+    memset(asset, 0, sizeof(asset_t));
+    size_t offsets_size = ((size_t)count + 1) * sizeof(uint32_t);
+    size_t chars_size = 0;
+    for (int i = 0; i < count; i++) {
+        chars_size += (strings[i] != NULL ? strlen(strings[i]) : 0) + 1;
+    }
+    if (chars_size > UINT32_MAX) {
+        return -1;
+    }
+    char* buffer = (char*)malloc(offsets_size + chars_size);
+    if (buffer == NULL) {
+        printf("malloc string asset fail!\n");
+        return -1;
+    }
+    uint32_t* offsets = (uint32_t*)buffer;
+    char* chars = buffer + offsets_size;
+    uint32_t pos = 0;
+    for (int i = 0; i < count; i++) {
+        const char* s = strings[i] != NULL ? strings[i] : "";
+        size_t len = strlen(s) + 1;
+        offsets[i] = pos;
+        memcpy(chars + pos, s, len);
+        pos += len;
+    }
+    offsets[count] = pos;
+
+    asset->type = ASSET_STRINGS;
+    asset->count = count;
+    asset->rows = count;
+    asset->cols = 1;
+    asset->offsets = offsets;
+    asset->chars = chars;
+    asset->data = offsets;
+    asset->buffer = buffer;
+    return 0;
+}
+
+int create_float_asset(const float* values, int rows, int cols, asset_t* asset)
+{
+    memset(asset, 0, sizeof(asset_t));
+    size_t size = (size_t)rows * cols * sizeof(float);
+    float* buffer = (float*)malloc(size);
+    if (buffer == NULL) {
+        printf("malloc float asset fail!\n");
+        return -1;
+    }
+    memcpy(buffer, values, size);
+    asset->type = ASSET_FLOAT32;
+    asset->count = rows * cols;
+    asset->rows = rows;
+    asset->cols = cols;
+    asset->data = buffer;
+    asset->buffer = buffer;
+    return 0;
+}
+
+void close_asset(asset_t* asset)
+{
+    if (asset->values != NULL) {
+        free(asset->values);
+    }
+    if (asset->buffer != NULL) {
+        free(asset->buffer);
+    }
+    unmap_model_file(&asset->file);
+    memset(asset, 0, sizeof(asset_t));
+}
+
+const char* get_asset_string(const asset_t* asset, int index)
+{
+    if (asset->type != ASSET_STRINGS || index < 0 || index >= asset->count) {
+        return "";
+    }
+    uint32_t begin = asset->offsets[index];
+    uint32_t end = asset->offsets[index + 1];
+    // a string must end inside its own slot
+    if (begin >= end || end > asset->offsets[asset->count] || asset->chars[end - 1] != '\0') {
+        return "";
+    }
+    return asset->chars + begin;
+}
+
+const float* get_asset_floats(asset_t* asset)
+{
+    if (asset->type == ASSET_FLOAT32) {
+        return (const float*)asset->data;
+    }
+    if (asset->type != ASSET_FLOAT16) {
+        return NULL;
+    }
+    if (asset->values == NULL) {
+        float* values = (float*)malloc((size_t)asset->count * sizeof(float));
+        if (values == NULL) {
+            printf("malloc asset values fail!\n");
+            return NULL;
+        }
+        half_to_float_array((const uint16_t*)asset->data, values, asset->count);
+        asset->values = values;
+    }
+    return asset->values;
+}
@@ -0,0 +1,167 @@
+#ifndef _RKNN_MODEL_ZOO_ASSET_UTILS_H_
+#define _RKNN_MODEL_ZOO_ASSET_UTILS_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include "file_utils.h"
+
+#define ASSET_MAGIC "RKAS"
+#define ASSET_VERSION 2
+
+typedef enum {
+    ASSET_STRINGS = 1,  // string table, strings indexed by id
+    ASSET_FLOAT32 = 2,  // rows x cols float32
+    ASSET_FLOAT16 = 3,  // rows x cols IEEE half
+} asset_type_t;
+
+/**
+ * @brief Asset file header, little-endian, followed by the payload
+ *
+ * Strings: data holds count + 1 uint32 offsets into chars, string i is the NUL-terminated
+ * chars[offsets[i]], offsets[i + 1] - offsets[i] - 1 bytes long.
+ * Floats: data holds rows * cols values, row-major.
+ */
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t type;
+    uint32_t count;         // strings, or rows * cols
+    uint32_t rows;
+    uint32_t cols;
+    uint64_t data_offset;   // from file start, 16-byte aligned
+    uint64_t data_size;
+    uint64_t chars_offset;  // strings only
+    uint64_t chars_size;
+    uint64_t source_size;   // text file the asset was converted from, version 2 on
+    uint64_t source_hash;   // asset_source_hash of that file
+} asset_header_t;
+
+/**
+ * @brief Binary asset, memory mapped from file or built in memory
+ *
+ */
+typedef struct {
+    int type;
+    int count;
+    int rows;
+    int cols;
+    const uint32_t* offsets;    // strings
+    const char* chars;          // strings
+    const void* data;           // values
+    float* values;              // float32 copy of fp16 values, made by get_asset_floats
+    uint64_t source_size;       // text source size and hash, 0 when unknown
+    uint64_t source_hash;
+    mapped_file_t file;         // file.data is NULL for in-memory assets
+    void* buffer;               // in-memory payload
+} asset_t;
+
+/**
+ * @brief Memory map asset file, nothing is parsed and pages are shared with other processes
+ *
+ * @param path [in] Asset path, written by py_utils/asset_converter.py
+ * @param type [in] Expected asset_type_t, 0: any
+ * @param asset [out] Asset
+ * @return int 0: success; -1: error
+ */
+int open_asset(const char* path, int type, asset_t* asset);
+
+/**
+ * @brief "<name>.bin" of the text asset "<name>.txt", where py_utils/asset_converter.py writes it
+ *
+ * @param text_path [in] Text file path
+ * @param bin_path [out] Binary asset path
+ * @param size [in] bin_path capacity
+ * @return int 0: success; -1: path too long
+ */
+int binary_asset_path(const char* text_path, char* bin_path, size_t size);
+
+/**
+ * @brief Memory map the binary asset of a text file, unless the text changed since it was converted
+ *
+ * A binary newer than the text is used as is. Otherwise (text edited, or copied after the binary)
+ * only when the text still has the size and hash stored at conversion.
+ *
+ * @param text_path [in] Text file path, the binary is binary_asset_path of it
+ * @param type [in] Expected asset_type_t, 0: any
+ * @param asset [out] Asset
+ * @return int 0: binary opened; 1: no binary or a stale one, parse the text; -1: binary is corrupt
+ */
+int open_text_asset(const char* text_path, int type, asset_t* asset);
+
+/**
+ * @brief Write an asset parsed from a text file as its binary asset, so that the next start maps it
+ *
+ * Written to a temporary file and renamed, processes starting at the same time never see half a file.
+ *
+ * @param asset [in] Asset
+ * @param text_path [in] Text file the asset was parsed from, its size and hash are stored
+ * @return int 0: success; -1: error, the text is parsed again next time
+ */
+int save_text_asset(const asset_t* asset, const char* text_path);
+
+/**
+ * @brief 64-bit FNV-1a hash, the text source check of binary assets
+ *
+ * @param data [in] Bytes
+ * @param size [in] Byte count
+ * @param hash [in] 0 to start, the previous result to continue
+ * @return uint64_t Hash
+ */
+uint64_t asset_source_hash(const void* data, size_t size, uint64_t hash);
+
+/**
+ * @brief Build string asset in memory, for text files without a converted asset
+ *
+ * @param strings [in] count strings, NULL entries become empty strings
+ * @param count [in] String count
+ * @param asset [out] Asset
+ * @return int 0: success; -1: error
+ */
+int create_string_asset(const char* const* strings, int count, asset_t* asset);
+
+/**
+ * @brief Build float32 asset in memory, for text files without a converted asset
+ *
+ * @param values [in] rows * cols values, copied
+ * @param rows [in] Rows
+ * @param cols [in] Columns
+ * @param asset [out] Asset
+ * @return int 0: success; -1: error
+ */
+int create_float_asset(const float* values, int rows, int cols, asset_t* asset);
+
+/**
+ * @brief Release asset
+ *
+ * @param asset [in] Asset, may be zeroed
+ */
+void close_asset(asset_t* asset);
+
+/**
+ * @brief String of a string asset
+ *
+ * @param asset [in] Asset
+ * @param index [in] String id
+ * @return const char* String, "" for an id out of range
+ */
+const char* get_asset_string(const asset_t* asset, int index);
+
+/**
+ * @brief Values of a float asset as float32
+ *
+ * float32 assets return the mapping itself, fp16 ones are converted once on the first call.
+ *
+ * @param asset [in] Asset
+ * @return const float* rows * cols values, NULL on error
+ */
+const float* get_asset_floats(asset_t* asset);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif // _RKNN_MODEL_ZOO_ASSET_UTILS_H_
@@ -2,8 +2,25 @@
 #include <stdlib.h>
 #include <sndfile.h>
 #include <math.h>
+#include <string.h>
+#include <limits.h>
+#include <pthread.h>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 #include "audio_utils.h"
 
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// passband edge relative to the lower Nyquist frequency
+#define AUDIO_RESAMPLER_ROLLOFF 0.92
+// Kaiser window shape, about 80 dB stopband
+#define AUDIO_RESAMPLER_KAISER_BETA 8.0
+
 int read_audio(const char *path, audio_buffer_t *audio)
 {
     SNDFILE *infile;
@@ -71,56 +88,650 @@ int save_audio(const char *path, float *data, int num_frames, int sample_rate, i
     return 0;
 }
 
+int open_audio_writer(const char *path, int sample_rate, int num_channels, audio_writer_t *writer)
+{
+    SF_INFO sfinfo = {0};
+
+    sfinfo.samplerate = sample_rate;
+    sfinfo.channels = num_channels;
+    sfinfo.format = SF_FORMAT_WAV | SF_FORMAT_FLOAT;
+
+    writer->num_channels = num_channels;
+    writer->num_frames = 0;
+    writer->file = sf_open(path, SFM_WRITE, &sfinfo);
+    if (!writer->file)
+    {
+        fprintf(stderr, "Error: failed to open file '%s' for writing: %s\n", path, sf_strerror(NULL));
+        return -1;
+    }
+    sf_command((SNDFILE *)writer->file, SFC_SET_UPDATE_HEADER_AUTO, NULL, SF_TRUE);
+
+    return 0;
+}
+
+int write_audio(audio_writer_t *writer, const float *data, int num_frames)
+{
+    sf_count_t num_written_frames = sf_writef_float((SNDFILE *)writer->file, data, num_frames);
+    if (num_written_frames != num_frames)
+    {
+        fprintf(stderr, "Error: failed to write all frames. Expected %ld, wrote %ld.\n", (long)num_frames, (long)num_written_frames);
+        return -1;
+    }
+    writer->num_frames += num_frames;
+
+    return 0;
+}
+
+void close_audio_writer(audio_writer_t *writer)
+{
+    if (writer->file)
+    {
+        sf_close((SNDFILE *)writer->file);
+        writer->file = NULL;
+    }
+}
+
+static double bessel_i0(double x)
+{
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 64 && term > sum * 1e-12; k++)
+    {
+        term *= (x * x) / (4.0 * k * k);
+        sum += term;
+    }
+    return sum;
+}
+
+static int gcd(int a, int b)
+{
+    while (b != 0)
+    {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+static inline float dot_product(const float *a, const float *b, int n)
+{
+#if defined(__ARM_NEON)
+    float32x4_t acc = vdupq_n_f32(0.0f);
+    for (int i = 0; i < n; i += 4)
+    {
+        acc = vmlaq_f32(acc, vld1q_f32(a + i), vld1q_f32(b + i));
+    }
+#if defined(__aarch64__)
+    return vaddvq_f32(acc);
+#else
+    float32x2_t sum = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+    return vget_lane_f32(vpadd_f32(sum, sum), 0);
+#endif
+#else
+    float acc[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    for (int i = 0; i < n; i += 4)
+    {
+        for (int k = 0; k < 4; k++)
+        {
+            acc[k] += a[i + k] * b[i + k];
+        }
+    }
+    return (acc[0] + acc[1]) + (acc[2] + acc[3]);
+#endif
+}
+
+static void build_filter_bank(audio_resampler_t *resampler, double scale)
+{
+    int half = resampler->taps / 2;
+    double cutoff = 0.5 * scale * AUDIO_RESAMPLER_ROLLOFF; // cycles per input sample
+    double i0_beta = bessel_i0(AUDIO_RESAMPLER_KAISER_BETA);
+
+    for (int p = 0; p < resampler->num_phases; p++)
+    {
+        float *filter = resampler->bank + (long)p * resampler->taps;
+        double offset = (double)p / resampler->num_phases;
+        double sum = 0.0;
+        for (int j = 0; j < resampler->taps; j++)
+        {
+            // distance from the output position to input sample j
+            double d = offset + half - 1 - j;
+            double x = 2.0 * cutoff * d;
+            double sinc = fabs(x) < 1e-9 ? 1.0 : sin(M_PI * x) / (M_PI * x);
+            double r = d / half;
+            double w = r * r < 1.0 ? bessel_i0(AUDIO_RESAMPLER_KAISER_BETA * sqrt(1.0 - r * r)) / i0_beta : 0.0;
+            filter[j] = (float)(sinc * w);
+            sum += filter[j];
+        }
+        // unity gain at DC for every phase
+        for (int j = 0; j < resampler->taps; j++)
+        {
+            filter[j] = (float)(filter[j] / sum);
+        }
+    }
+}
+
+static void reset_audio_resampler(audio_resampler_t *resampler)
+{
+    // the first output sits on the first input sample, the filter sees zeros before it
+    resampler->buf_len = resampler->taps / 2 - 1;
+    memset(resampler->buf, 0, resampler->buf_len * sizeof(float));
+    resampler->start = 0;
+    resampler->frac = 0;
+    resampler->num_in = 0;
+    resampler->num_out = 0;
+}
+
+static int run_filter(audio_resampler_t *resampler, float *output, long long max_output)
+{
+    int n = 0;
+    int taps = resampler->taps;
+    while (resampler->start + taps <= resampler->buf_len && n < max_output)
+    {
+        int phase = resampler->num_phases == resampler->up ? (int)resampler->frac
+                                                           : (int)(resampler->frac * resampler->num_phases / resampler->up);
+        output[n++] = dot_product(resampler->buf + resampler->start, resampler->bank + (long)phase * taps, taps);
+        resampler->frac += resampler->down;
+        resampler->start += (int)(resampler->frac / resampler->up);
+        resampler->frac %= resampler->up;
+    }
+    return n;
+}
+
+// drop consumed input, less than taps samples stay
+static void compact_buffer(audio_resampler_t *resampler)
+{
+    resampler->buf_len -= resampler->start;
+    memmove(resampler->buf, resampler->buf + resampler->start, resampler->buf_len * sizeof(float));
+    resampler->start = 0;
+}
+
+int init_audio_resampler(audio_resampler_t *resampler, int in_rate, int out_rate)
+{
+    memset(resampler, 0, sizeof(audio_resampler_t));
+    if (in_rate <= 0 || out_rate <= 0)
+    {
+        fprintf(stderr, "Error: invalid resample rates %d -> %d.\n", in_rate, out_rate);
+        return -1;
+    }
+
+    int g = gcd(in_rate, out_rate);
+    resampler->in_rate = in_rate;
+    resampler->out_rate = out_rate;
+    resampler->up = out_rate / g;
+    resampler->down = in_rate / g;
+    resampler->num_phases = resampler->up <= AUDIO_RESAMPLER_MAX_PHASES ? resampler->up : AUDIO_RESAMPLER_MAX_PHASES;
+
+    // the filter is as long in time as AUDIO_RESAMPLER_HALF_TAPS samples at the lower rate
+    double scale = resampler->up < resampler->down ? (double)resampler->up / resampler->down : 1.0;
+    int half = (int)ceil(AUDIO_RESAMPLER_HALF_TAPS / scale);
+    half = (half + 1) & ~1;
+    resampler->taps = half * 2;
+
+    resampler->bank = (float *)malloc((long)resampler->num_phases * resampler->taps * sizeof(float));
+    resampler->buf = (float *)malloc((resampler->taps + AUDIO_RESAMPLER_BLOCK) * sizeof(float));
+    if (!resampler->bank || !resampler->buf)
+    {
+        fprintf(stderr, "Error: failed to allocate memory.\n");
+        release_audio_resampler(resampler);
+        return -1;
+    }
+    build_filter_bank(resampler, scale);
+    reset_audio_resampler(resampler);
+
+    return 0;
+}
+
+void release_audio_resampler(audio_resampler_t *resampler)
+{
+    if (resampler->bank)
+    {
+        free(resampler->bank);
+        resampler->bank = NULL;
+    }
+    if (resampler->buf)
+    {
+        free(resampler->buf);
+        resampler->buf = NULL;
+    }
+}
+
+int audio_resampler_output_size(const audio_resampler_t *resampler, int num_input)
+{
+    return (int)(((long long)num_input + 2 * resampler->taps) * resampler->up / resampler->down) + 1;
+}
+
+int resample_chunk(audio_resampler_t *resampler, const float *input, int num_input, float *output)
+{
+    int capacity = resampler->taps + AUDIO_RESAMPLER_BLOCK;
+    int n = 0;
+
+    if (num_input < 0)
+    {
+        return -1;
+    }
+    resampler->num_in += num_input;
+    while (num_input > 0)
+    {
+        int m = capacity - resampler->buf_len;
+        m = m < num_input ? m : num_input;
+        memcpy(resampler->buf + resampler->buf_len, input, m * sizeof(float));
+        resampler->buf_len += m;
+        input += m;
+        num_input -= m;
+
+        n += run_filter(resampler, output + n, LLONG_MAX);
+        compact_buffer(resampler);
+    }
+    resampler->num_out += n;
+
+    return n;
+}
+
+int resample_flush(audio_resampler_t *resampler, float *output)
+{
+    int capacity = resampler->taps + AUDIO_RESAMPLER_BLOCK;
+    long long total = (resampler->num_in * resampler->up + resampler->down - 1) / resampler->down;
+    int zeros = resampler->taps / 2;
+    int n = 0;
+
+    // zeros after the end let the filter reach the last input samples
+    while (zeros > 0)
+    {
+        int m = capacity - resampler->buf_len;
+        m = m < zeros ? m : zeros;
+        memset(resampler->buf + resampler->buf_len, 0, m * sizeof(float));
+        resampler->buf_len += m;
+        zeros -= m;
+
+        n += run_filter(resampler, output + n, total - resampler->num_out - n);
+        compact_buffer(resampler);
+    }
+    reset_audio_resampler(resampler);
+
+    return n;
+}
+
 int resample_audio(audio_buffer_t *audio, int original_sample_rate, int desired_sample_rate)
 {
-    int original_length = audio->num_frames;
-    int out_length = round(original_length * (double)desired_sample_rate / (double)original_sample_rate);
     printf("resample_audio: %d HZ -> %d HZ \n", original_sample_rate, desired_sample_rate);
+    if (audio->num_channels != 1)
+    {
+        fprintf(stderr, "Error: resample_audio needs mono audio, got %d channels.\n", audio->num_channels);
+        return -1;
+    }
+    if (original_sample_rate == desired_sample_rate)
+    {
+        return 0;
+    }
 
-    float *resampled_data = (float *)malloc(out_length * sizeof(float));
-    if (!resampled_data)
+    audio_resampler_t resampler;
+    if (init_audio_resampler(&resampler, original_sample_rate, desired_sample_rate) != 0)
     {
         return -1;
     }
 
-    for (int i = 0; i < out_length; ++i)
+    float *resampled_data = (float *)malloc(((long)audio_resampler_output_size(&resampler, audio->num_frames) +
+                                             audio_resampler_output_size(&resampler, 0)) * sizeof(float));
+    if (!resampled_data)
     {
-        double src_index = i * (double)original_sample_rate / (double)desired_sample_rate;
-        int left_index = (int)floor(src_index);
-        int right_index = (left_index + 1 < original_length) ? left_index + 1 : left_index;
-        double fraction = src_index - left_index;
-        resampled_data[i] = (1.0f - fraction) * audio->data[left_index] + fraction * audio->data[right_index];
+        release_audio_resampler(&resampler);
+        return -1;
     }
 
+    int out_length = resample_chunk(&resampler, audio->data, audio->num_frames, resampled_data);
+    out_length += resample_flush(&resampler, resampled_data + out_length);
+    release_audio_resampler(&resampler);
+
     audio->num_frames = out_length;
+    audio->sample_rate = desired_sample_rate;
     free(audio->data);
     audio->data = resampled_data;
 
     return 0;
 }
 
+void downmix_audio(const float *input, int num_frames, int num_channels, float *output)
+{
+    float scale = 1.0f / num_channels;
+    int i = 0;
+
+#if defined(__ARM_NEON)
+    if (num_channels == 2)
+    {
+        for (; i + 4 <= num_frames; i += 4)
+        {
+            float32x4x2_t v = vld2q_f32(input + i * 2);
+            vst1q_f32(output + i, vmulq_n_f32(vaddq_f32(v.val[0], v.val[1]), 0.5f));
+        }
+    }
+#endif
+    // frame i is read before output[i] is written, so output may alias input
+    for (; i < num_frames; i++)
+    {
+        const float *frame = input + (long)i * num_channels;
+        float sum = 0.0f;
+        for (int c = 0; c < num_channels; c++)
+        {
+            sum += frame[c];
+        }
+        output[i] = sum * scale;
+    }
+}
+
 int convert_channels(audio_buffer_t *audio)
 {
 
     int original_num_channels = audio->num_channels;
     printf("convert_channels: %d -> %d \n", original_num_channels, 1);
 
-    float *converted_data = (float *)malloc(audio->num_frames * sizeof(float));
-    if (!converted_data)
+    if (original_num_channels < 1)
     {
         return -1;
     }
+    downmix_audio(audio->data, audio->num_frames, original_num_channels, audio->data);
+    audio->num_channels = 1;
+
+    if (original_num_channels > 1 && audio->num_frames > 0)
+    {
+        float *shrunk_data = (float *)realloc(audio->data, audio->num_frames * sizeof(float));
+        if (shrunk_data)
+        {
+            audio->data = shrunk_data;
+        }
+    }
+
+    return 0;
+}
+
+typedef struct
+{
+    SNDFILE *file;
+    int file_channels;
+    int mono;
+    int resampling;
+    audio_resampler_t resampler;
+    float *block;           // AUDIO_SOURCE_BLOCK file frames
+    float *resampled;       // resampler output of one block
+    float *ring;            // AUDIO_SOURCE_RING_FRAMES * num_channels
+    int ring_size;          // samples
+    long long written;      // samples written to ring
+    long long read;         // samples read from ring
+    int finished;           // file fully decoded
+    int error;
+    int stop;
+    pthread_mutex_t lock;
+    pthread_cond_t not_full;
+    pthread_cond_t not_empty;
+    pthread_t thread;
+} audio_source_impl_t;
+
+// copy samples into the ring, waits for the reader when it is full; returns -1 when stopped
+static int push_ring(audio_source_impl_t *impl, const float *data, int n)
+{
+    while (n > 0)
+    {
+        pthread_mutex_lock(&impl->lock);
+        while (!impl->stop && impl->written - impl->read == impl->ring_size)
+        {
+            pthread_cond_wait(&impl->not_full, &impl->lock);
+        }
+        if (impl->stop)
+        {
+            pthread_mutex_unlock(&impl->lock);
+            return -1;
+        }
+        int room = impl->ring_size - (int)(impl->written - impl->read);
+        pthread_mutex_unlock(&impl->lock);
+
+        // only this thread moves written, the reader never touches [written, read + ring_size)
+        int m = n < room ? n : room;
+        int pos = (int)(impl->written % impl->ring_size);
+        int first = m < impl->ring_size - pos ? m : impl->ring_size - pos;
+        memcpy(impl->ring + pos, data, first * sizeof(float));
+        memcpy(impl->ring, data + first, (m - first) * sizeof(float));
+        data += m;
+        n -= m;
+
+        pthread_mutex_lock(&impl->lock);
+        impl->written += m;
+        pthread_cond_signal(&impl->not_empty);
+        pthread_mutex_unlock(&impl->lock);
+    }
+    return 0;
+}
+
+static void *audio_source_worker(void *arg)
+{
+    audio_source_impl_t *impl = (audio_source_impl_t *)arg;
+    int error = 0;
+
+    while (1)
+    {
+        sf_count_t frames = sf_readf_float(impl->file, impl->block, AUDIO_SOURCE_BLOCK);
+        if (frames <= 0)
+        {
+            error = sf_error(impl->file) != SF_ERR_NO_ERROR;
+            break;
+        }
+        const float *out = impl->block;
+        int n = (int)frames * impl->file_channels;
+        if (impl->mono && impl->file_channels > 1)
+        {
+            downmix_audio(impl->block, (int)frames, impl->file_channels, impl->block);
+            n = (int)frames;
+        }
+        if (impl->resampling)
+        {
+            n = resample_chunk(&impl->resampler, impl->block, n, impl->resampled);
+            out = impl->resampled;
+        }
+        if (push_ring(impl, out, n) != 0)
+        {
+            return NULL;
+        }
+    }
+    if (!error && impl->resampling)
+    {
+        int n = resample_flush(&impl->resampler, impl->resampled);
+        if (push_ring(impl, impl->resampled, n) != 0)
+        {
+            return NULL;
+        }
+    }
 
-    for (int i = 0; i < audio->num_frames; ++i)
+    pthread_mutex_lock(&impl->lock);
+    impl->finished = 1;
+    impl->error = error;
+    pthread_cond_broadcast(&impl->not_empty);
+    pthread_mutex_unlock(&impl->lock);
+    return NULL;
+}
+
+static void free_audio_source_impl(audio_source_impl_t *impl)
+{
+    if (impl->file)
+    {
+        sf_close(impl->file);
+    }
+    release_audio_resampler(&impl->resampler);
+    free(impl->block);
+    free(impl->resampled);
+    free(impl->ring);
+    free(impl);
+}
+
+int open_audio_source(const char *path, int sample_rate, int mono, audio_source_t *source)
+{
+    SF_INFO sfinfo = {0};
+
+    memset(source, 0, sizeof(audio_source_t));
+    audio_source_impl_t *impl = (audio_source_impl_t *)calloc(1, sizeof(audio_source_impl_t));
+    if (!impl)
     {
-        float left = audio->data[i * 2];
-        float right = audio->data[i * 2 + 1];
-        converted_data[i] = (left + right) / 2.0f;
+        fprintf(stderr, "Error: failed to allocate memory.\n");
+        return -1;
     }
 
+    impl->file = sf_open(path, SFM_READ, &sfinfo);
+    if (!impl->file)
+    {
+        fprintf(stderr, "Error: failed to open file '%s': %s\n", path, sf_strerror(NULL));
+        free_audio_source_impl(impl);
+        return -1;
+    }
+    impl->file_channels = sfinfo.channels;
+    impl->mono = mono || sfinfo.channels == 1;
+    source->num_channels = impl->mono ? 1 : sfinfo.channels;
+    source->sample_rate = sample_rate > 0 ? sample_rate : sfinfo.samplerate;
+    impl->resampling = source->sample_rate != sfinfo.samplerate;
+    if (impl->resampling && !impl->mono)
+    {
+        fprintf(stderr, "Error: resampling '%s' needs mono output.\n", path);
+        free_audio_source_impl(impl);
+        return -1;
+    }
+
+    impl->block = (float *)malloc(AUDIO_SOURCE_BLOCK * sfinfo.channels * sizeof(float));
+    impl->ring_size = AUDIO_SOURCE_RING_FRAMES * source->num_channels;
+    impl->ring = (float *)malloc(impl->ring_size * sizeof(float));
+    if (impl->resampling)
+    {
+        if (init_audio_resampler(&impl->resampler, sfinfo.samplerate, source->sample_rate) != 0)
+        {
+            free_audio_source_impl(impl);
+            return -1;
+        }
+        int size = audio_resampler_output_size(&impl->resampler, AUDIO_SOURCE_BLOCK);
+        impl->resampled = (float *)malloc(size * sizeof(float));
+    }
+    if (!impl->block || !impl->ring || (impl->resampling && !impl->resampled))
+    {
+        fprintf(stderr, "Error: failed to allocate memory.\n");
+        free_audio_source_impl(impl);
+        return -1;
+    }
+
+    pthread_mutex_init(&impl->lock, NULL);
+    pthread_cond_init(&impl->not_full, NULL);
+    pthread_cond_init(&impl->not_empty, NULL);
+    if (pthread_create(&impl->thread, NULL, audio_source_worker, impl) != 0)
+    {
+        fprintf(stderr, "Error: failed to start audio decode thread.\n");
+        pthread_mutex_destroy(&impl->lock);
+        pthread_cond_destroy(&impl->not_full);
+        pthread_cond_destroy(&impl->not_empty);
+        free_audio_source_impl(impl);
+        return -1;
+    }
+    source->impl = impl;
+
+    return 0;
+}
+
+int read_audio_source(audio_source_t *source, float *data, int num_frames)
+{
+    audio_source_impl_t *impl = (audio_source_impl_t *)source->impl;
+    int n = num_frames * source->num_channels;
+    int done = 0;
+
+    while (done < n)
+    {
+        pthread_mutex_lock(&impl->lock);
+        while (impl->written == impl->read && !impl->finished)
+        {
+            pthread_cond_wait(&impl->not_empty, &impl->lock);
+        }
+        int available = (int)(impl->written - impl->read);
+        int error = impl->error;
+        pthread_mutex_unlock(&impl->lock);
+        if (available == 0)
+        {
+            // frames decoded before the error go out first, the error with the next call
+            if (error && done == 0)
+            {
+                fprintf(stderr, "Error: failed to decode audio.\n");
+                return -1;
+            }
+            break;
+        }
+
+        int m = n - done < available ? n - done : available;
+        int pos = (int)(impl->read % impl->ring_size);
+        int first = m < impl->ring_size - pos ? m : impl->ring_size - pos;
+        memcpy(data + done, impl->ring + pos, first * sizeof(float));
+        memcpy(data + done + first, impl->ring, (m - first) * sizeof(float));
+        done += m;
+
+        pthread_mutex_lock(&impl->lock);
+        impl->read += m;
+        pthread_cond_signal(&impl->not_full);
+        pthread_mutex_unlock(&impl->lock);
+    }
+
+    source->num_read += done / source->num_channels;
+    return done / source->num_channels;
+}
+
+void close_audio_source(audio_source_t *source)
+{
+    audio_source_impl_t *impl = (audio_source_impl_t *)source->impl;
+    if (!impl)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&impl->lock);
+    impl->stop = 1;
+    pthread_cond_broadcast(&impl->not_full);
+    pthread_mutex_unlock(&impl->lock);
+    pthread_join(impl->thread, NULL);
+
+    pthread_mutex_destroy(&impl->lock);
+    pthread_cond_destroy(&impl->not_full);
+    pthread_cond_destroy(&impl->not_empty);
+    free_audio_source_impl(impl);
+    source->impl = NULL;
+}
+
+int read_audio_head(const char *path, int sample_rate, int max_frames, audio_buffer_t *audio)
+{
+    audio_source_t source;
+
+    memset(audio, 0, sizeof(audio_buffer_t));
+    if (open_audio_source(path, sample_rate, 1, &source) != 0)
+    {
+        return -1;
+    }
+
+    audio->data = (float *)malloc(max_frames * sizeof(float));
+    if (!audio->data)
+    {
+        fprintf(stderr, "Error: failed to allocate memory.\n");
+        close_audio_source(&source);
+        return -1;
+    }
+    int num_frames = read_audio_source(&source, audio->data, max_frames);
+    if (num_frames >= 0 && num_frames < max_frames)
+    {
+        // end of the file or a decode error after num_frames
+        float sample;
+        if (read_audio_source(&source, &sample, 1) < 0)
+        {
+            num_frames = -1;
+        }
+    }
+    close_audio_source(&source);
+    if (num_frames < 0)
+    {
+        free(audio->data);
+        audio->data = NULL;
+        return -1;
+    }
+
+    audio->num_frames = num_frames;
     audio->num_channels = 1;
-    free(audio->data);
-    audio->data = converted_data;
+    audio->sample_rate = sample_rate;
 
     return 0;
 }
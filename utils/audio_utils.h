@@ -35,12 +35,127 @@ int read_audio(const char *path, audio_buffer_t *audio);
  */
 int save_audio(const char *path, float *data, int num_frames, int sample_rate, int num_channels);
 
+typedef struct
+{
+    void *file;
+    int num_channels;
+    long num_frames;
+} audio_writer_t;
+
+/**
+ * @brief Opens a WAV file for writing audio in pieces.
+ *
+ * The header is kept up to date after every write, the file can be played
+ * while it is still being written.
+ *
+ * @param path [in] Path to the output WAV file.
+ * @param sample_rate [in] Sampling rate of the audio data.
+ * @param num_channels [in] Number of channels in the audio data.
+ * @param writer [out] Writer.
+ * @return int 0 on success, -1 on error.
+ */
+int open_audio_writer(const char *path, int sample_rate, int num_channels, audio_writer_t *writer);
+
+/**
+ * @brief Appends audio data to a WAV file opened by open_audio_writer.
+ *
+ * @param writer [in] Writer.
+ * @param data [in] Interleaved audio data.
+ * @param num_frames [in] Number of frames in the audio data.
+ * @return int 0 on success, -1 on error.
+ */
+int write_audio(audio_writer_t *writer, const float *data, int num_frames);
+
+/**
+ * @brief Closes a WAV file opened by open_audio_writer.
+ *
+ * @param writer [in] Writer.
+ */
+void close_audio_writer(audio_writer_t *writer);
+
+// half length of the resampling filter, counted at the lower of the two rates
+#define AUDIO_RESAMPLER_HALF_TAPS 24
+// ratios needing more phases use the nearest of this many
+#define AUDIO_RESAMPLER_MAX_PHASES 1024
+// input samples buffered per filter pass
+#define AUDIO_RESAMPLER_BLOCK 4096
+
+/**
+ * @brief Streaming polyphase resampler for mono audio.
+ *
+ * The Kaiser windowed sinc filter bank is built once for the rate pair, every
+ * output sample is one dot product with a precomputed phase.
+ */
+typedef struct
+{
+    int in_rate;
+    int out_rate;
+    int up;             // out_rate / in_rate reduced to up / down
+    int down;
+    int num_phases;     // up, or AUDIO_RESAMPLER_MAX_PHASES when up is larger
+    int taps;           // filter length, multiple of 4
+    float *bank;        // num_phases * taps
+    float *buf;         // unconsumed input, taps + AUDIO_RESAMPLER_BLOCK
+    int buf_len;
+    int start;          // first input sample of the next output
+    long long frac;     // position of the next output past buf[start + taps / 2 - 1], in 1 / up samples
+    long long num_in;   // samples pushed since the stream started
+    long long num_out;  // samples produced since the stream started
+} audio_resampler_t;
+
+/**
+ * @brief Creates a resampler.
+ *
+ * @param resampler [out] Resampler.
+ * @param in_rate [in] Input sample rate.
+ * @param out_rate [in] Output sample rate.
+ * @return int 0 on success, -1 on error.
+ */
+int init_audio_resampler(audio_resampler_t *resampler, int in_rate, int out_rate);
+
+/**
+ * @brief Releases a resampler.
+ *
+ * @param resampler [in] Resampler.
+ */
+void release_audio_resampler(audio_resampler_t *resampler);
+
+/**
+ * @brief Output buffer size that is always enough for one resample_chunk or resample_flush call.
+ *
+ * @param resampler [in] Resampler.
+ * @param num_input [in] Input samples of the call, 0 for resample_flush.
+ * @return int Sample count.
+ */
+int audio_resampler_output_size(const audio_resampler_t *resampler, int num_input);
+
+/**
+ * @brief Resamples the next chunk of a stream.
+ *
+ * Outputs are produced as soon as the filter has seen enough input, the last
+ * few are held back until more input or resample_flush.
+ *
+ * @param resampler [in] Resampler.
+ * @param input [in] Mono input samples.
+ * @param num_input [in] Input sample count, any size.
+ * @param output [out] Output samples, audio_resampler_output_size(resampler, num_input).
+ * @return int Number of output samples, -1 on error.
+ */
+int resample_chunk(audio_resampler_t *resampler, const float *input, int num_input, float *output);
+
+/**
+ * @brief Ends the stream, produces the held back outputs and resets the resampler for a new stream.
+ *
+ * @param resampler [in] Resampler.
+ * @param output [out] Output samples, audio_resampler_output_size(resampler, 0).
+ * @return int Number of output samples.
+ */
+int resample_flush(audio_resampler_t *resampler, float *output);
+
 /**
  * @brief Resamples audio data to a desired sample rate.
  *
- * This function adjusts the sample rate of the provided audio data from 
- * the original sample rate to the desired sample rate. The audio data 
- * is assumed to be in a format compatible with the processing logic.
+ * Runs the polyphase resampler over the whole buffer, the audio must be mono.
  *
  * @param audio [in/out] Pointer to the audio buffer structure containing 
  *                       the audio data to be resampled.
@@ -50,12 +165,20 @@ int save_audio(const char *path, float *data, int num_frames, int sample_rate, i
  */
 int resample_audio(audio_buffer_t *audio, int original_sample_rate, int desired_sample_rate);
 
+/**
+ * @brief Averages interleaved channels into mono.
+ *
+ * @param input [in] num_frames * num_channels interleaved samples.
+ * @param num_frames [in] Number of frames.
+ * @param num_channels [in] Number of channels.
+ * @param output [out] num_frames samples, may be the same buffer as input.
+ */
+void downmix_audio(const float *input, int num_frames, int num_channels, float *output);
+
 /**
  * @brief Converts audio data to a single channel (mono).
  *
- * This function takes two-channel audio data and converts it to single 
- * channel (mono) by averaging the channels or using another merging strategy.
- * The audio data will be modified in place.
+ * Averages any number of interleaved channels, the audio data is modified in place.
  *
  * @param audio [in/out] Pointer to the audio buffer structure containing 
  *                       the audio data to be converted.
@@ -63,6 +186,65 @@ int resample_audio(audio_buffer_t *audio, int original_sample_rate, int desired_
  */
 int convert_channels(audio_buffer_t *audio);
 
+// file frames decoded per read on the source thread
+#define AUDIO_SOURCE_BLOCK 4096
+// output frames buffered between the source thread and the reader
+#define AUDIO_SOURCE_RING_FRAMES 65536
+
+/**
+ * @brief Pull-based audio file reader.
+ *
+ * A background thread decodes the file block by block into a ring buffer,
+ * downmixing and resampling on the way, so memory does not depend on the file length.
+ */
+typedef struct
+{
+    int sample_rate;    // rate of the frames returned by read_audio_source
+    int num_channels;   // channels of the frames returned by read_audio_source
+    long long num_read; // frames returned so far
+    void *impl;
+} audio_source_t;
+
+/**
+ * @brief Opens an audio file and starts decoding it in the background.
+ *
+ * @param path [in] Path to the audio file.
+ * @param sample_rate [in] Output sample rate, 0 keeps the file rate. Resampling needs mono output.
+ * @param mono [in] Non-zero to average all channels into one.
+ * @param source [out] Source.
+ * @return int 0 on success, -1 on error.
+ */
+int open_audio_source(const char *path, int sample_rate, int mono, audio_source_t *source);
+
+/**
+ * @brief Reads the next frames, waits until num_frames are decoded or the file ends.
+ *
+ * @param source [in] Source.
+ * @param data [out] num_frames * source->num_channels interleaved samples.
+ * @param num_frames [in] Number of frames wanted.
+ * @return int Frames read, less than num_frames only at the end of the file or before a decode error;
+ *             -1 on decode error, once the frames decoded before it were read.
+ */
+int read_audio_source(audio_source_t *source, float *data, int num_frames);
+
+/**
+ * @brief Stops the decode thread and closes the file.
+ *
+ * @param source [in] Source.
+ */
+void close_audio_source(audio_source_t *source);
+
+/**
+ * @brief Reads the beginning of an audio file as mono, only that part is decoded.
+ *
+ * @param path [in] Path to the audio file.
+ * @param sample_rate [in] Output sample rate.
+ * @param max_frames [in] Frames to read at most.
+ * @param audio [out] Audio buffer, data must be freed by the caller.
+ * @return int 0 on success, -1 on error.
+ */
+int read_audio_head(const char *path, int sample_rate, int max_frames, audio_buffer_t *audio);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -0,0 +1,317 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "batch_utils.h"
+#include "image_utils.h"
+
+#define DEFAULT_RESULT_SIZE (64 * 1024)
+
+typedef struct {
+    int index;
+    int ret;
+    double decode_ms;
+    image_buffer_t image;
+    image_decode_info_t info;
+} batch_item_t;
+
+typedef struct {
+    // input
+    char** files;
+    int count;
+    const batch_config_t* config;
+    int next_index;
+
+    // bounded queue of decoded images
+    batch_item_t* slots;
+    int capacity;
+    int head;
+    int size;
+    int active_workers;
+
+    pthread_mutex_t lock;
+    pthread_cond_t not_full;
+    pthread_cond_t not_empty;
+} batch_runner_t;
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static void* batch_decode_worker(void* arg)
+{
+    batch_runner_t* runner = (batch_runner_t*)arg;
+    const batch_config_t* config = runner->config;
+
+    while (1) {
+        pthread_mutex_lock(&runner->lock);
+        int index = runner->next_index < runner->count ? runner->next_index++ : -1;
+        pthread_mutex_unlock(&runner->lock);
+        if (index < 0) {
+            break;
+        }
+
+        batch_item_t item;
+        memset(&item, 0, sizeof(item));
+        item.index = index;
+        double start = now_ms();
+        if (config->model_width > 0 && config->model_height > 0) {
+            item.ret = read_image_for_model(runner->files[index], config->model_width, config->model_height, &item.image,
+                                            &item.info);
+        } else {
+            item.ret = read_image(runner->files[index], &item.image);
+            item.info.orig_width = item.image.width;
+            item.info.orig_height = item.image.height;
+            item.info.scale_denom = 1;
+        }
+        item.decode_ms = now_ms() - start;
+
+        pthread_mutex_lock(&runner->lock);
+        while (runner->size == runner->capacity) {
+            pthread_cond_wait(&runner->not_full, &runner->lock);
+        }
+        runner->slots[(runner->head + runner->size) % runner->capacity] = item;
+        runner->size++;
+        pthread_cond_signal(&runner->not_empty);
+        pthread_mutex_unlock(&runner->lock);
+    }
+
+    pthread_mutex_lock(&runner->lock);
+    runner->active_workers--;
+    pthread_cond_broadcast(&runner->not_empty);
+    pthread_mutex_unlock(&runner->lock);
+    return NULL;
+}
+
+// return 0: got item; -1: all workers finished and queue drained
+static int batch_pop(batch_runner_t* runner, batch_item_t* item)
+{
+    pthread_mutex_lock(&runner->lock);
+    while (runner->size == 0 && runner->active_workers > 0) {
+        pthread_cond_wait(&runner->not_empty, &runner->lock);
+    }
+    if (runner->size == 0) {
+        pthread_mutex_unlock(&runner->lock);
+        return -1;
+    }
+    *item = runner->slots[runner->head];
+    runner->head = (runner->head + 1) % runner->capacity;
+    runner->size--;
+    pthread_cond_signal(&runner->not_full);
+    pthread_mutex_unlock(&runner->lock);
+    return 0;
+}
+
+static int cmp_double(const void* a, const void* b)
+{
+    double da = *(const double*)a;
+    double db = *(const double*)b;
+    return da < db ? -1 : (da > db ? 1 : 0);
+}
+
+static void compute_latency(double* values, int n, batch_latency_t* latency)
+{
+    memset(latency, 0, sizeof(*latency));
+    if (n <= 0) {
+        return;
+    }
+    double sum = 0;
+    for (int i = 0; i < n; i++) {
+        sum += values[i];
+    }
+    qsort(values, n, sizeof(double), cmp_double);
+    latency->mean = sum / n;
+    latency->p50 = values[(int)(0.50 * (n - 1))];
+    latency->p90 = values[(int)(0.90 * (n - 1))];
+    latency->p99 = values[(int)(0.99 * (n - 1))];
+    latency->max = values[n - 1];
+}
+
+int json_append_string(char* buf, int size, int offset, const char* str)
+{
+    if (offset >= size - 1) {
+        return offset;
+    }
+    buf[offset++] = '"';
+    for (const char* p = str; *p != '\0' && offset < size - 3; p++) {
+        unsigned char c = (unsigned char)*p;
+        if (c == '"' || c == '\\') {
+            buf[offset++] = '\\';
+            buf[offset++] = c;
+        } else if (c < 0x20) {
+            offset += snprintf(buf + offset, size - offset, "\\u%04x", c);
+            if (offset >= size - 2) {
+                offset = size - 2;
+                break;
+            }
+        } else {
+            buf[offset++] = c;
+        }
+    }
+    buf[offset++] = '"';
+    buf[offset] = '\0';
+    return offset;
+}
+
+int run_image_batch(char** files, int count, const batch_config_t* config,
+                    batch_infer_callback callback, void* userdata, batch_stats_t* stats)
+{
+    int ret = 0;
+    batch_runner_t runner;
+    memset(&runner, 0, sizeof(runner));
+
+    if (files == NULL || count <= 0 || config == NULL || callback == NULL) {
+        return -1;
+    }
+
+    int num_workers = config->num_workers;
+    if (num_workers <= 0) {
+        long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        num_workers = ncpu > 1 ? (int)ncpu - 1 : 1;
+    }
+    if (num_workers > count) {
+        num_workers = count;
+    }
+    int capacity = config->queue_depth > 0 ? config->queue_depth : num_workers * 2;
+    int result_size = config->result_size > 0 ? config->result_size : DEFAULT_RESULT_SIZE;
+
+    FILE* out = stdout;
+    if (config->output_path != NULL) {
+        out = fopen(config->output_path, "w");
+        if (out == NULL) {
+            printf("open %s fail\n", config->output_path);
+            return -1;
+        }
+    }
+
+    char* result_json = (char*)malloc(result_size);
+    char* path_json = (char*)malloc(4096);
+    double* decode_ms = (double*)malloc(sizeof(double) * count);
+    double* wait_ms = (double*)malloc(sizeof(double) * count);
+    double* infer_ms = (double*)malloc(sizeof(double) * count);
+    pthread_t* threads = (pthread_t*)malloc(sizeof(pthread_t) * num_workers);
+    runner.slots = (batch_item_t*)malloc(sizeof(batch_item_t) * capacity);
+    if (result_json == NULL || path_json == NULL || decode_ms == NULL || wait_ms == NULL || infer_ms == NULL ||
+        threads == NULL || runner.slots == NULL) {
+        printf("batch runner malloc fail\n");
+        ret = -1;
+        goto out;
+    }
+
+    runner.files = files;
+    runner.count = count;
+    runner.config = config;
+    runner.capacity = capacity;
+    pthread_mutex_init(&runner.lock, NULL);
+    pthread_cond_init(&runner.not_full, NULL);
+    pthread_cond_init(&runner.not_empty, NULL);
+
+    printf("batch run %d images, decode workers=%d queue depth=%d\n", count, num_workers, capacity);
+
+    double start = now_ms();
+    int started = 0;
+    for (int i = 0; i < num_workers; i++) {
+        pthread_mutex_lock(&runner.lock);
+        runner.active_workers++;
+        pthread_mutex_unlock(&runner.lock);
+        if (pthread_create(&threads[i], NULL, batch_decode_worker, &runner) != 0) {
+            pthread_mutex_lock(&runner.lock);
+            runner.active_workers--;
+            pthread_mutex_unlock(&runner.lock);
+            break;
+        }
+        started++;
+    }
+    if (started == 0) {
+        printf("create decode worker fail\n");
+        ret = -1;
+        goto destroy;
+    }
+
+    int done = 0;
+    int failed = 0;
+    batch_item_t item;
+    while (1) {
+        double wait_start = now_ms();
+        if (batch_pop(&runner, &item) != 0) {
+            break;
+        }
+        double infer_start = now_ms();
+        int cb_ret = -1;
+        result_json[0] = '\0';
+        if (item.ret == 0) {
+            cb_ret = callback(userdata, files[item.index], &item.image, &item.info, result_json, result_size);
+        }
+        double infer_end = now_ms();
+
+        decode_ms[done] = item.decode_ms;
+        wait_ms[done] = infer_start - wait_start;
+        infer_ms[done] = infer_end - infer_start;
+        done++;
+
+        json_append_string(path_json, 4096, 0, files[item.index]);
+        if (item.ret != 0 || cb_ret != 0 || result_json[0] == '\0') {
+            failed++;
+            fprintf(out, "{\"image\":%s,\"error\":\"%s\"}\n", path_json,
+                    item.ret != 0 ? "read image fail" : "inference fail");
+        } else {
+            fprintf(out, "{\"image\":%s,\"orig_width\":%d,\"orig_height\":%d,\"scale_denom\":%d,"
+                    "\"decode_ms\":%.3f,\"infer_ms\":%.3f,\"result\":%s}\n", path_json, item.info.orig_width,
+                    item.info.orig_height, item.info.scale_denom, decode_ms[done - 1], infer_ms[done - 1], result_json);
+        }
+        if (item.image.virt_addr != NULL) {
+            free(item.image.virt_addr);
+        }
+    }
+    double elapsed = now_ms() - start;
+
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    if (stats != NULL) {
+        memset(stats, 0, sizeof(*stats));
+        stats->total = done;
+        stats->failed = failed;
+        stats->elapsed_ms = elapsed;
+        stats->images_per_sec = elapsed > 0 ? done * 1000.0 / elapsed : 0;
+        compute_latency(decode_ms, done, &stats->decode);
+        compute_latency(wait_ms, done, &stats->wait);
+        compute_latency(infer_ms, done, &stats->infer);
+    }
+
+destroy:
+    pthread_mutex_destroy(&runner.lock);
+    pthread_cond_destroy(&runner.not_full);
+    pthread_cond_destroy(&runner.not_empty);
+out:
+    if (out != stdout) {
+        fclose(out);
+    }
+    free(result_json);
+    free(path_json);
+    free(decode_ms);
+    free(wait_ms);
+    free(infer_ms);
+    free(threads);
+    free(runner.slots);
+    return ret;
+}
+
+void print_batch_stats(const batch_stats_t* stats)
+{
+    printf("batch images=%d failed=%d elapsed=%.1fms throughput=%.2f images/s\n",
+           stats->total, stats->failed, stats->elapsed_ms, stats->images_per_sec);
+    const char* names[] = {"decode", "wait", "infer"};
+    const batch_latency_t* stages[] = {&stats->decode, &stats->wait, &stats->infer};
+    for (int i = 0; i < 3; i++) {
+        printf("  %-6s mean=%.2fms p50=%.2fms p90=%.2fms p99=%.2fms max=%.2fms\n", names[i],
+               stages[i]->mean, stages[i]->p50, stages[i]->p90, stages[i]->p99, stages[i]->max);
+    }
+}
@@ -0,0 +1,102 @@
+#ifndef _RKNN_MODEL_ZOO_BATCH_UTILS_H_
+#define _RKNN_MODEL_ZOO_BATCH_UTILS_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include "common.h"
+#include "image_utils.h"
+
+/**
+ * @brief Inference callback of batch runner, called on the runner thread in image order of arrival
+ *
+ * @param userdata [in] User data passed to run_image_batch
+ * @param path [in] Image path
+ * @param image [in] Decoded image, released by the runner after the callback returns
+ * @param info [in] Original size of the image file, results should be scaled to it when the
+ *                  jpeg was decoded at reduced size (info->scale_denom > 1)
+ * @param result_json [out] JSON value describing the result (object/array), written as "result" field
+ * @param result_size [in] Size of result_json buffer
+ * @return int 0: success; other: error, the image is reported with "error" field
+ */
+typedef int (*batch_infer_callback)(void* userdata, const char* path, image_buffer_t* image,
+                                    const image_decode_info_t* info, char* result_json, int result_size);
+
+/**
+ * @brief Batch runner config
+ *
+ */
+typedef struct {
+    int num_workers;        // decode threads, <= 0: cpu count - 1
+    int queue_depth;        // decoded images kept ahead of inference, <= 0: 2 * num_workers
+    int model_width;        // > 0: decode jpeg at reduced size with read_image_for_model
+    int model_height;
+    int result_size;        // result_json buffer size, <= 0: 64KB
+    const char* output_path; // JSONL result file, NULL: stdout
+} batch_config_t;
+
+/**
+ * @brief Latency statistics of one stage in milliseconds
+ *
+ */
+typedef struct {
+    double mean;
+    double p50;
+    double p90;
+    double p99;
+    double max;
+} batch_latency_t;
+
+/**
+ * @brief Batch runner statistics
+ *
+ */
+typedef struct {
+    int total;
+    int failed;
+    double elapsed_ms;
+    double images_per_sec;
+    batch_latency_t decode;     // read and decode on worker thread
+    batch_latency_t wait;       // runner waiting for a decoded image
+    batch_latency_t infer;      // callback
+} batch_stats_t;
+
+/**
+ * @brief Decode images on a worker pool and feed them to callback
+ *
+ * @param files [in] Image paths
+ * @param count [in] Image count
+ * @param config [in] Batch config
+ * @param callback [in] Inference callback
+ * @param userdata [in] User data for callback
+ * @param stats [out] Statistics, can be NULL
+ * @return int 0: success; -1: error
+ */
+int run_image_batch(char** files, int count, const batch_config_t* config,
+                    batch_infer_callback callback, void* userdata, batch_stats_t* stats);
+
+/**
+ * @brief Print batch statistics
+ *
+ * @param stats [in] Statistics
+ */
+void print_batch_stats(const batch_stats_t* stats);
+
+/**
+ * @brief Append string to json buffer with escaping
+ *
+ * @param buf [in/out] Json buffer
+ * @param size [in] Buffer size
+ * @param offset [in] Current length of buf
+ * @param str [in] String
+ * @return int New length of buf
+ */
+int json_append_string(char* buf, int size, int offset, const char* str);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif // _RKNN_MODEL_ZOO_BATCH_UTILS_H_
@@ -0,0 +1,166 @@
+#include <math.h>
+#include <string.h>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "dfl_utils.h"
+
+// table entries more than this below the largest logit are flushed to 0, their weight is below exp(-80)
+#define DFL_EXP_FLOOR 80.0f
+
+// sum(e_i) and sum(e_i * i) of the four sides, one lane per side
+typedef struct {
+#if defined(__ARM_NEON)
+    float32x4_t sum;
+    float32x4_t acc;
+#else
+    float sum[4];
+    float acc[4];
+#endif
+} dfl_acc_t;
+
+static inline void dfl_acc_init(dfl_acc_t* a)
+{
+#if defined(__ARM_NEON)
+    a->sum = vdupq_n_f32(0.0f);
+    a->acc = vdupq_n_f32(0.0f);
+#else
+    memset(a, 0, sizeof(dfl_acc_t));
+#endif
+}
+
+static inline void dfl_acc_add(dfl_acc_t* a, const float e[4], float i)
+{
+#if defined(__ARM_NEON)
+    float32x4_t v = vld1q_f32(e);
+    a->sum = vaddq_f32(a->sum, v);
+    a->acc = vmlaq_n_f32(a->acc, v, i);
+#else
+    for (int b = 0; b < 4; b++) {
+        a->sum[b] += e[b];
+        a->acc[b] += e[b] * i;
+    }
+#endif
+}
+
+static inline void dfl_acc_finish(const dfl_acc_t* a, float box[4])
+{
+#if defined(__ARM_NEON) && defined(__aarch64__)
+    vst1q_f32(box, vdivq_f32(a->acc, a->sum));
+#elif defined(__ARM_NEON)
+    float32x4_t r = vrecpeq_f32(a->sum);
+    r = vmulq_f32(vrecpsq_f32(a->sum, r), r);
+    r = vmulq_f32(vrecpsq_f32(a->sum, r), r);
+    vst1q_f32(box, vmulq_f32(a->acc, r));
+#else
+    for (int b = 0; b < 4; b++) {
+        box[b] = a->acc[b] / a->sum[b];
+    }
+#endif
+}
+
+static void init_table(dfl_exp_table_t* table, int32_t zp, float scale, int is_signed)
+{
+    table->zp = zp;
+    table->scale = scale;
+    float logit[256];
+    float max_logit = -INFINITY;
+    for (int i = 0; i < 256; i++) {
+        int q = is_signed ? (int)(int8_t)i : i;
+        logit[i] = ((float)q - (float)zp) * scale;
+        max_logit = fmaxf(max_logit, logit[i]);
+    }
+    for (int i = 0; i < 256; i++) {
+        float x = logit[i] - max_logit;
+        table->value[i] = x < -DFL_EXP_FLOOR ? 0.0f : expf(x);
+    }
+}
+
+void init_dfl_exp_table_i8(dfl_exp_table_t* table, int32_t zp, float scale)
+{
+    init_table(table, zp, scale, 1);
+}
+
+void init_dfl_exp_table_u8(dfl_exp_table_t* table, int32_t zp, float scale)
+{
+    init_table(table, zp, scale, 0);
+}
+
+// exact softmax expectation of one side, shifted by its own largest logit
+static float decode_side_exact(const uint8_t* side, int step, int dfl_len, const dfl_exp_table_t* table, int is_signed)
+{
+    float logit[256];
+    float max_logit = -INFINITY;
+    for (int i = 0, off = 0; i < dfl_len; i++, off += step) {
+        int q = is_signed ? (int)(int8_t)side[off] : side[off];
+        logit[i] = ((float)q - (float)table->zp) * table->scale;
+        max_logit = fmaxf(max_logit, logit[i]);
+    }
+    float sum = 0.0f;
+    float acc = 0.0f;
+    for (int i = 0; i < dfl_len; i++) {
+        float e = expf(logit[i] - max_logit);
+        sum += e;
+        acc += e * (float)i;
+    }
+    return acc / sum;
+}
+
+// int8 and uint8 tensors both index the table with their raw byte
+static void decode_bytes(const uint8_t* tensor, int step, int dfl_len, const dfl_exp_table_t* table, int is_signed,
+                         float box[4])
+{
+    const float* value = table->value;
+    const uint8_t* side0 = tensor;
+    const uint8_t* side1 = side0 + dfl_len * step;
+    const uint8_t* side2 = side1 + dfl_len * step;
+    const uint8_t* side3 = side2 + dfl_len * step;
+    dfl_acc_t a;
+    dfl_acc_init(&a);
+    for (int i = 0, off = 0; i < dfl_len; i++, off += step) {
+        float e[4] = {value[side0[off]], value[side1[off]], value[side2[off]], value[side3[off]]};
+        dfl_acc_add(&a, e, (float)i);
+    }
+    dfl_acc_finish(&a, box);
+    // 0/0 only when the tensor range exceeds DFL_EXP_FLOOR and a whole side sits below the floor
+    for (int b = 0; b < 4; b++) {
+        if (isnan(box[b])) {
+            box[b] = decode_side_exact(tensor + b * dfl_len * step, step, dfl_len, table, is_signed);
+        }
+    }
+}
+
+void dfl_decode_i8(const int8_t* tensor, int step, int dfl_len, const dfl_exp_table_t* table, float box[4])
+{
+    decode_bytes((const uint8_t*)tensor, step, dfl_len, table, 1, box);
+}
+
+void dfl_decode_u8(const uint8_t* tensor, int step, int dfl_len, const dfl_exp_table_t* table, float box[4])
+{
+    decode_bytes(tensor, step, dfl_len, table, 0, box);
+}
+
+void dfl_decode_f32(const float* tensor, int step, int dfl_len, float box[4])
+{
+    const float* side[4];
+    float max_v[4];
+    for (int b = 0; b < 4; b++) {
+        side[b] = tensor + b * dfl_len * step;
+        max_v[b] = side[b][0];
+        for (int i = 1, off = step; i < dfl_len; i++, off += step) {
+            max_v[b] = fmaxf(max_v[b], side[b][off]);
+        }
+    }
+    dfl_acc_t a;
+    dfl_acc_init(&a);
+    for (int i = 0, off = 0; i < dfl_len; i++, off += step) {
+        float e[4];
+        for (int b = 0; b < 4; b++) {
+            e[b] = expf(side[b][off] - max_v[b]);
+        }
+        dfl_acc_add(&a, e, (float)i);
+    }
+    dfl_acc_finish(&a, box);
+}
@@ -0,0 +1,70 @@
+#ifndef _RKNN_MODEL_ZOO_DFL_UTILS_H_
+#define _RKNN_MODEL_ZOO_DFL_UTILS_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/**
+ * @brief exp() of every value a quantized box tensor can hold
+ *
+ * Entries are shifted by the largest representable logit, the softmax is unchanged
+ * and the sums cannot overflow. Entries more than 80 below it are 0.
+ */
+typedef struct {
+    float value[256];   // indexed by the raw byte of the quantized value
+    int32_t zp;
+    float scale;
+} dfl_exp_table_t;
+
+/**
+ * @brief Build exp table for an int8 box tensor
+ *
+ * @param table [out] Table
+ * @param zp [in] Box tensor zero point
+ * @param scale [in] Box tensor scale
+ */
+void init_dfl_exp_table_i8(dfl_exp_table_t* table, int32_t zp, float scale);
+
+/**
+ * @brief Build exp table for an uint8 box tensor (RKNPU1)
+ *
+ * @param table [out] Table
+ * @param zp [in] Box tensor zero point
+ * @param scale [in] Box tensor scale
+ */
+void init_dfl_exp_table_u8(dfl_exp_table_t* table, int32_t zp, float scale);
+
+/**
+ * @brief Softmax expectation of the four box side distributions (left, top, right, bottom)
+ *
+ * Value i of side b is read from tensor[(b * dfl_len + i) * step], step is the grid
+ * size for NCHW outputs and 1 for NHWC outputs.
+ *
+ * @param tensor [in] First value of the box distributions of one grid cell
+ * @param step [in] Distance between two distribution values
+ * @param dfl_len [in] Distribution length, 16 for YOLOv8/YOLO11
+ * @param table [in] Exp table of the tensor
+ * @param box [out] Distances from the anchor point in grid units
+ */
+void dfl_decode_i8(const int8_t* tensor, int step, int dfl_len, const dfl_exp_table_t* table, float box[4]);
+
+/**
+ * @brief uint8 version of dfl_decode_i8
+ *
+ */
+void dfl_decode_u8(const uint8_t* tensor, int step, int dfl_len, const dfl_exp_table_t* table, float box[4]);
+
+/**
+ * @brief Float version of dfl_decode_i8
+ *
+ */
+void dfl_decode_f32(const float* tensor, int step, int dfl_len, float box[4]);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif // _RKNN_MODEL_ZOO_DFL_UTILS_H_
@@ -0,0 +1,355 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "dma_pool.h"
+#include "image_utils.h"
+
+#define DMA_POOL_MAX_CACHED_BYTES (16 * 1024 * 1024)
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+
+// same as linux/dma-heap.h and linux/dma-buf.h, not every toolchain ships them
+struct dma_heap_allocation_data {
+    uint64_t len;
+    uint32_t fd;
+    uint32_t fd_flags;
+    uint64_t heap_flags;
+};
+
+struct dma_buf_sync {
+    uint64_t flags;
+};
+
+#define DMA_HEAP_IOCTL_ALLOC    _IOWR('H', 0x0, struct dma_heap_allocation_data)
+#define DMA_BUF_IOCTL_SYNC      _IOW('b', 0, struct dma_buf_sync)
+#define DMA_BUF_SYNC_RW         (1 | 2)
+#define DMA_BUF_SYNC_START      (0 << 2)
+#define DMA_BUF_SYNC_END        (1 << 2)
+
+// tried in order when no heap is given; rga on rv1106 needs cma, rga2 on rk3588 below 4GB
+static const char* g_default_heaps[] = {
+    "/dev/rk_dma_heap/rk-dma-heap-cma",
+    "/dev/dma_heap/system-dma32",
+    "/dev/dma_heap/system",
+};
+
+struct dma_pool {
+    pthread_mutex_t lock;
+    int heap_fd;                // -1: memfd / anonymous fallback
+    size_t max_cached_bytes;
+    dma_buffer_t* cached;       // released buffers, most recent first
+    dma_pool_stats_t stats;
+};
+
+// page aligned, then 4 classes per power of two so a class wastes at most 1/4
+static size_t get_size_class(size_t size)
+{
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size = (size + page - 1) / page * page;
+    size_t step = page;
+    while (step * 8 <= size) {
+        step *= 2;
+    }
+    return (size + step - 1) / step * step;
+}
+
+static int alloc_heap_memory(dma_pool_t* pool, size_t size, dma_buffer_t* buf)
+{
+    struct dma_heap_allocation_data data;
+    memset(&data, 0, sizeof(data));
+    data.len = size;
+    data.fd_flags = O_CLOEXEC | O_RDWR;
+    if (ioctl(pool->heap_fd, DMA_HEAP_IOCTL_ALLOC, &data) < 0) {
+        return -1;
+    }
+    void* va = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, (int)data.fd, 0);
+    if (va == MAP_FAILED) {
+        printf("mmap dma buffer fail! %s\n", strerror(errno));
+        close((int)data.fd);
+        return -1;
+    }
+    buf->fd = (int)data.fd;
+    buf->virt_addr = va;
+    return 0;
+}
+
+static int alloc_fallback_memory(size_t size, dma_buffer_t* buf)
+{
+    int fd = -1;
+#if defined(SYS_memfd_create)
+    fd = (int)syscall(SYS_memfd_create, "dma_pool", MFD_CLOEXEC);
+    if (fd >= 0 && ftruncate(fd, (off_t)size) != 0) {
+        close(fd);
+        fd = -1;
+    }
+#endif
+    void* va;
+    if (fd >= 0) {
+        va = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    } else {
+        va = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+    if (va == MAP_FAILED) {
+        printf("mmap fallback buffer fail! %s\n", strerror(errno));
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    buf->fd = fd;
+    buf->virt_addr = va;
+    return 0;
+}
+
+static void free_buffer(dma_buffer_t* buf)
+{
+    munmap(buf->virt_addr, buf->size);
+    if (buf->fd >= 0) {
+        close(buf->fd);
+    }
+    free(buf);
+}
+
+// called with the lock held
+static void trim_cache(dma_pool_t* pool, size_t keep_bytes)
+{
+    dma_buffer_t** link = &pool->cached;
+    size_t kept = 0;
+    while (*link != NULL) {
+        dma_buffer_t* buf = *link;
+        if (kept + buf->size <= keep_bytes) {
+            kept += buf->size;
+            link = &buf->next;
+            continue;
+        }
+        *link = buf->next;
+        pool->stats.cached_bytes -= buf->size;
+        free_buffer(buf);
+    }
+}
+
+static int sync_buffer(dma_buffer_t* buf, uint64_t flags)
+{
+    dma_pool_t* pool = buf->pool;
+    pthread_mutex_lock(&pool->lock);
+    pool->stats.syncs++;
+    pthread_mutex_unlock(&pool->lock);
+    if (pool->heap_fd < 0) {
+        // memfd and anonymous memory are coherent
+        return 0;
+    }
+    struct dma_buf_sync sync;
+    sync.flags = flags;
+    if (ioctl(buf->fd, DMA_BUF_IOCTL_SYNC, &sync) < 0) {
+        printf("DMA_BUF_IOCTL_SYNC fail! %s\n", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+dma_pool_t* create_dma_pool(const char* heap_path, size_t max_cached_bytes)
+{
+    dma_pool_t* pool = (dma_pool_t*)calloc(1, sizeof(dma_pool_t));
+    if (pool == NULL) {
+        printf("malloc dma pool fail!\n");
+        return NULL;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pool->max_cached_bytes = max_cached_bytes > 0 ? max_cached_bytes : DMA_POOL_MAX_CACHED_BYTES;
+    pool->heap_fd = -1;
+    if (heap_path != NULL) {
+        pool->heap_fd = open(heap_path, O_RDWR | O_CLOEXEC);
+        if (pool->heap_fd < 0) {
+            printf("open %s fail!\n", heap_path);
+        }
+    } else {
+        int num_heaps = (int)(sizeof(g_default_heaps) / sizeof(g_default_heaps[0]));
+        for (int i = 0; i < num_heaps && pool->heap_fd < 0; i++) {
+            pool->heap_fd = open(g_default_heaps[i], O_RDWR | O_CLOEXEC);
+        }
+    }
+    if (pool->heap_fd < 0) {
+        printf("no dma heap, dma pool uses memfd memory\n");
+        pool->stats.fallback = 1;
+    }
+    return pool;
+}
+
+void destroy_dma_pool(dma_pool_t* pool)
+{
+    if (pool == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&pool->lock);
+    trim_cache(pool, 0);
+    if (pool->stats.in_use_bytes > 0) {
+        printf("destroy_dma_pool: %zu bytes still in use\n", pool->stats.in_use_bytes);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    if (pool->heap_fd >= 0) {
+        close(pool->heap_fd);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    free(pool);
+}
+
+dma_buffer_t* acquire_dma_buffer(dma_pool_t* pool, size_t size)
+{
+    size_t class_size = get_size_class(size > 0 ? size : 1);
+
+    pthread_mutex_lock(&pool->lock);
+    for (dma_buffer_t** link = &pool->cached; *link != NULL; link = &(*link)->next) {
+        dma_buffer_t* buf = *link;
+        if (buf->size == class_size) {
+            *link = buf->next;
+            buf->next = NULL;
+            buf->dirty = 0;
+            pool->stats.reuses++;
+            pool->stats.cached_bytes -= class_size;
+            pool->stats.in_use_bytes += class_size;
+            pthread_mutex_unlock(&pool->lock);
+            return buf;
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    dma_buffer_t* buf = (dma_buffer_t*)calloc(1, sizeof(dma_buffer_t));
+    if (buf == NULL) {
+        printf("malloc dma buffer fail!\n");
+        return NULL;
+    }
+    buf->size = class_size;
+    buf->pool = pool;
+    int ret;
+    if (pool->heap_fd >= 0) {
+        ret = alloc_heap_memory(pool, class_size, buf);
+        if (ret != 0) {
+            // cma is small, give back buffers of other classes and retry once
+            pthread_mutex_lock(&pool->lock);
+            trim_cache(pool, 0);
+            pthread_mutex_unlock(&pool->lock);
+            ret = alloc_heap_memory(pool, class_size, buf);
+        }
+        if (ret != 0) {
+            printf("DMA_HEAP_IOCTL_ALLOC fail! size=%zu %s\n", class_size, strerror(errno));
+        }
+    } else {
+        ret = alloc_fallback_memory(class_size, buf);
+    }
+    if (ret != 0) {
+        free(buf);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stats.allocs++;
+    pool->stats.in_use_bytes += class_size;
+    pthread_mutex_unlock(&pool->lock);
+    return buf;
+}
+
+dma_buffer_t* acquire_dma_image(dma_pool_t* pool, int width, int height, image_format_t format, image_buffer_t* image)
+{
+    memset(image, 0, sizeof(image_buffer_t));
+    image->width = width;
+    image->height = height;
+    image->width_stride = width;
+    image->height_stride = height;
+    image->format = format;
+    int size = get_image_size(image);
+    if (size <= 0) {
+        printf("acquire_dma_image: unsupported image %dx%d format %d\n", width, height, format);
+        return NULL;
+    }
+    dma_buffer_t* buf = acquire_dma_buffer(pool, size);
+    if (buf == NULL) {
+        return NULL;
+    }
+    image->virt_addr = (unsigned char*)buf->virt_addr;
+    image->size = size;
+    image->fd = buf->fd;
+    return buf;
+}
+
+dma_buffer_t* move_image_to_dma_buffer(dma_pool_t* pool, image_buffer_t* image)
+{
+    dma_buffer_t* buf = acquire_dma_buffer(pool, image->size);
+    if (buf == NULL) {
+        return NULL;
+    }
+    memcpy(buf->virt_addr, image->virt_addr, image->size);
+    mark_dma_buffer_dirty(buf);
+    if (sync_dma_buffer_to_device(buf) != 0) {
+        release_dma_buffer(buf);
+        return NULL;
+    }
+    free(image->virt_addr);
+    image->virt_addr = (unsigned char*)buf->virt_addr;
+    image->fd = buf->fd;
+    return buf;
+}
+
+void release_dma_buffer(dma_buffer_t* buf)
+{
+    if (buf == NULL) {
+        return;
+    }
+    dma_pool_t* pool = buf->pool;
+    pthread_mutex_lock(&pool->lock);
+    pool->stats.in_use_bytes -= buf->size;
+    if (buf->size > pool->max_cached_bytes) {
+        pthread_mutex_unlock(&pool->lock);
+        free_buffer(buf);
+        return;
+    }
+    // the oldest released buffers go first
+    trim_cache(pool, pool->max_cached_bytes - buf->size);
+    buf->next = pool->cached;
+    pool->cached = buf;
+    pool->stats.cached_bytes += buf->size;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void mark_dma_buffer_dirty(dma_buffer_t* buf)
+{
+    buf->dirty = 1;
+}
+
+int sync_dma_buffer_to_device(dma_buffer_t* buf)
+{
+    if (!buf->dirty) {
+        dma_pool_t* pool = buf->pool;
+        pthread_mutex_lock(&pool->lock);
+        pool->stats.skipped_syncs++;
+        pthread_mutex_unlock(&pool->lock);
+        return 0;
+    }
+    int ret = sync_buffer(buf, DMA_BUF_SYNC_END | DMA_BUF_SYNC_RW);
+    if (ret == 0) {
+        buf->dirty = 0;
+    }
+    return ret;
+}
+
+int sync_dma_buffer_to_cpu(dma_buffer_t* buf)
+{
+    return sync_buffer(buf, DMA_BUF_SYNC_START | DMA_BUF_SYNC_RW);
+}
+
+void get_dma_pool_stats(dma_pool_t* pool, dma_pool_stats_t* stats)
+{
+    pthread_mutex_lock(&pool->lock);
+    *stats = pool->stats;
+    pthread_mutex_unlock(&pool->lock);
+}
@@ -0,0 +1,138 @@
+#ifndef _RKNN_MODEL_ZOO_DMA_POOL_H_
+#define _RKNN_MODEL_ZOO_DMA_POOL_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include "common.h"
+
+/**
+ * DMA-buf pool
+ *
+ * Buffers come from a dma heap (/dev/rk_dma_heap or /dev/dma_heap) that is opened once,
+ * sizes are rounded up to classes (page aligned, at most 1/4 over the request) and
+ * released buffers are kept for the next acquire of the same class. Without a dma heap,
+ * e.g. on a development host, buffers are memfd (or anonymous) memory with the same API,
+ * so zero-copy code paths run and can be measured anywhere.
+ *
+ * The cpu cache is only synced to the device when the buffer was marked dirty.
+ */
+
+typedef struct dma_pool dma_pool_t;
+
+typedef struct dma_buffer {
+    int fd;                     // dma-buf fd, memfd fd, or -1 for anonymous memory
+    void* virt_addr;
+    size_t size;                // capacity, the size class
+    int dirty;                  // written by cpu since the last sync to device
+    dma_pool_t* pool;
+    struct dma_buffer* next;    // pool internal
+} dma_buffer_t;
+
+/**
+ * @brief Pool statistics
+ *
+ */
+typedef struct {
+    int fallback;               // 1: no dma heap, memfd or anonymous memory
+    int allocs;                 // buffers allocated
+    int reuses;                 // acquires served from released buffers
+    int syncs;                  // cache syncs issued
+    int skipped_syncs;          // syncs to device skipped, buffer not dirty
+    size_t in_use_bytes;
+    size_t cached_bytes;
+} dma_pool_stats_t;
+
+/**
+ * @brief Create DMA-buf pool
+ *
+ * @param heap_path [in] Heap device, NULL: first available of rk-dma-heap-cma, system-dma32, system
+ * @param max_cached_bytes [in] Released buffers kept beyond this are freed, 0: 16MB
+ * @return dma_pool_t* Pool, NULL: error
+ */
+dma_pool_t* create_dma_pool(const char* heap_path, size_t max_cached_bytes);
+
+/**
+ * @brief Destroy pool, all buffers must have been released
+ *
+ * @param pool [in] Pool, can be NULL
+ */
+void destroy_dma_pool(dma_pool_t* pool);
+
+/**
+ * @brief Get a buffer of at least size bytes, clean (not dirty)
+ *
+ * @param pool [in] Pool
+ * @param size [in] Size in bytes
+ * @return dma_buffer_t* Buffer, release with release_dma_buffer; NULL: error
+ */
+dma_buffer_t* acquire_dma_buffer(dma_pool_t* pool, size_t size);
+
+/**
+ * @brief Get a buffer for an image and fill an image_buffer_t view of it
+ *
+ * @param pool [in] Pool
+ * @param width [in] Width
+ * @param height [in] Height
+ * @param format [in] Format
+ * @param image [out] View with virt_addr, fd and size of the image set
+ * @return dma_buffer_t* Buffer, release with release_dma_buffer; NULL: error
+ */
+dma_buffer_t* acquire_dma_image(dma_pool_t* pool, int width, int height, image_format_t format, image_buffer_t* image);
+
+/**
+ * @brief Copy a malloc'ed image into a pool buffer and make it the image memory
+ *
+ * The buffer is synced to device and the old memory freed. On error the image is unchanged.
+ *
+ * @param pool [in] Pool
+ * @param image [in/out] Image, virt_addr and fd point to the buffer afterwards
+ * @return dma_buffer_t* Buffer, release with release_dma_buffer; NULL: error
+ */
+dma_buffer_t* move_image_to_dma_buffer(dma_pool_t* pool, image_buffer_t* image);
+
+/**
+ * @brief Return buffer to its pool
+ *
+ * @param buf [in] Buffer, can be NULL
+ */
+void release_dma_buffer(dma_buffer_t* buf);
+
+/**
+ * @brief Mark buffer written by cpu, the next sync_dma_buffer_to_device flushes the cache
+ *
+ * @param buf [in] Buffer
+ */
+void mark_dma_buffer_dirty(dma_buffer_t* buf);
+
+/**
+ * @brief Flush cpu writes for the device (npu/rga), only when the buffer is dirty
+ *
+ * @param buf [in] Buffer
+ * @return int 0: success; -1: error
+ */
+int sync_dma_buffer_to_device(dma_buffer_t* buf);
+
+/**
+ * @brief Make device writes visible to cpu before reading the buffer
+ *
+ * @param buf [in] Buffer
+ * @return int 0: success; -1: error
+ */
+int sync_dma_buffer_to_cpu(dma_buffer_t* buf);
+
+/**
+ * @brief Get pool statistics
+ *
+ * @param pool [in] Pool
+ * @param stats [out] Statistics
+ */
+void get_dma_pool_stats(dma_pool_t* pool, dma_pool_stats_t* stats);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif // _RKNN_MODEL_ZOO_DMA_POOL_H_
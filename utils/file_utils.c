@@ -1,6 +1,16 @@
+// 64-bit file offsets on 32-bit targets
+#define _FILE_OFFSET_BITS 64
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "file_utils.h"
 
 #define MAX_TEXT_LINE_LENGTH 1024
 
@@ -11,8 +21,14 @@ unsigned char* load_model(const char* filename, int* model_size)
         printf("fopen %s fail!\n", filename);
         return NULL;
     }
-    fseek(fp, 0, SEEK_END);
-    int model_len = ftell(fp);
+    fseeko(fp, 0, SEEK_END);
+    off_t file_len = ftello(fp);
+    if (file_len <= 0 || file_len > INT_MAX) {
+        printf("%s size %lld not supported, use map_model_file\n", filename, (long long)file_len);
+        fclose(fp);
+        return NULL;
+    }
+    int model_len = (int)file_len;
     unsigned char* model = (unsigned char*)malloc(model_len);
     fseek(fp, 0, SEEK_SET);
     if (model_len != fread(model, 1, model_len, fp)) {
@@ -33,8 +49,14 @@ int read_data_from_file(const char *path, char **out_data)
         printf("fopen %s fail!\n", path);
         return -1;
     }
-    fseek(fp, 0, SEEK_END);
-    int file_size = ftell(fp);
+    fseeko(fp, 0, SEEK_END);
+    off_t file_len = ftello(fp);
+    if (file_len < 0 || file_len >= INT_MAX) {
+        printf("%s size %lld not supported, use map_model_file\n", path, (long long)file_len);
+        fclose(fp);
+        return -1;
+    }
+    int file_size = (int)file_len;
     char *data = (char *)malloc(file_size+1);
     data[file_size] = 0;
     fseek(fp, 0, SEEK_SET);
@@ -51,6 +73,100 @@ int read_data_from_file(const char *path, char **out_data)
     return file_size;
 }
 
+static uint32_t crc32_table[256];
+static pthread_once_t crc32_table_once = PTHREAD_ONCE_INIT;
+
+static void init_crc32_table(void)
+{
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        crc32_table[i] = c;
+    }
+}
+
+static void* verify_model_file(void* arg)
+{
+    mapped_file_t* file = (mapped_file_t*)arg;
+    const unsigned char* p = (const unsigned char*)file->data;
+    uint32_t crc = 0xFFFFFFFFu;
+    for (uint64_t i = 0; i < file->size; i++) {
+        crc = crc32_table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    }
+    file->crc = crc ^ 0xFFFFFFFFu;
+    return NULL;
+}
+
+int map_model_file(const char* path, mapped_file_t* file)
+{
+    memset(file, 0, sizeof(mapped_file_t));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        printf("open %s fail!\n", path);
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        printf("stat %s fail!\n", path);
+        close(fd);
+        return -1;
+    }
+    // rknn_init takes a 32-bit model size
+    if ((uint64_t)st.st_size > UINT32_MAX) {
+        printf("%s size %llu exceeds 4GB\n", path, (unsigned long long)st.st_size);
+        close(fd);
+        return -1;
+    }
+    void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        printf("mmap %s fail!\n", path);
+        return -1;
+    }
+    madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+    file->data = data;
+    file->size = (uint64_t)st.st_size;
+
+    char crc_path[PATH_MAX];
+    snprintf(crc_path, sizeof(crc_path), "%s.crc32", path);
+    FILE* fp = fopen(crc_path, "r");
+    if (fp != NULL) {
+        unsigned int expected = 0;
+        if (fscanf(fp, "%x", &expected) == 1) {
+            pthread_once(&crc32_table_once, init_crc32_table);
+            file->expected_crc = expected;
+            if (pthread_create(&file->verify_thread, NULL, verify_model_file, file) == 0) {
+                file->verify = 1;
+            }
+        }
+        fclose(fp);
+    }
+    return 0;
+}
+
+int unmap_model_file(mapped_file_t* file)
+{
+    int ret = 0;
+    if (file->data == NULL) {
+        return 0;
+    }
+    if (file->verify) {
+        pthread_join(file->verify_thread, NULL);
+        file->verify = 0;
+        if (file->crc != file->expected_crc) {
+            printf("model checksum mismatch: crc32=%08x expected=%08x\n", file->crc, file->expected_crc);
+            ret = -1;
+        }
+    }
+    munmap(file->data, (size_t)file->size);
+    file->data = NULL;
+    file->size = 0;
+    return ret;
+}
+
 int write_data_to_file(const char *path, const char *data, unsigned int size)
 {
     FILE *fp;
@@ -5,6 +5,23 @@
 extern "C" {
 #endif
 
+#include <stdint.h>
+#include <pthread.h>
+
+/**
+ * @brief Read-only memory mapped model file
+ * 
+ */
+typedef struct {
+    void* data;
+    uint64_t size;
+    // background checksum, only started when "<path>.crc32" exists
+    int verify;
+    uint32_t expected_crc;
+    uint32_t crc;
+    pthread_t verify_thread;
+} mapped_file_t;
+
 /**
  * @brief Read data from file
  * 
@@ -14,6 +31,26 @@ extern "C" {
  */
 int read_data_from_file(const char *path, char **out_data);
 
+/**
+ * @brief Memory map model file read-only, pages are shared with other processes through page cache
+ * 
+ * If "<path>.crc32" exists (CRC-32 as hex text), the mapping is verified on a background
+ * thread while the caller goes on with rknn_init, and the result is checked by unmap_model_file.
+ * 
+ * @param path [in] Model path
+ * @param file [out] Mapped file
+ * @return int 0: success; -1: error
+ */
+int map_model_file(const char* path, mapped_file_t* file);
+
+/**
+ * @brief Unmap model file mapped by map_model_file
+ * 
+ * @param file [in] Mapped file
+ * @return int 0: success; -1: checksum mismatch
+ */
+int unmap_model_file(mapped_file_t* file);
+
 /**
  * @brief Write data to file
  * 
@@ -0,0 +1,262 @@
+#include <string.h>
+#include <pthread.h>
+
+#include "half_utils.h"
+
+#if defined(__ARM_NEON) && (defined(__aarch64__) || (defined(__ARM_FP) && (__ARM_FP & 2)))
+#include <arm_neon.h>
+#define HALF_UTILS_NEON
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HALF_UTILS_F16C
+#define HALF_UTILS_F16C_TARGET __attribute__((target("avx,f16c")))
+#endif
+
+// dst = src * scale + add, add may be NULL; dst = src when scale is 1 and add is NULL
+typedef void (*float_to_half_func)(const float* src, float scale, const float* add, uint16_t* dst, int n);
+// dst = src * scale + offset; dst = src when scale is 1 and offset is 0
+typedef void (*half_to_float_func)(const uint16_t* src, float scale, float offset, float* dst, int n);
+
+typedef struct {
+    const char* name;
+    float_to_half_func to_half;
+    half_to_float_func to_float;
+} half_backend_t;
+
+static inline uint32_t float_bits(float f)
+{
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    return u;
+}
+
+static inline float bits_float(uint32_t u)
+{
+    float f;
+    memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+// mask select instead of ?: keeps the loops free of branches gcc would not if-convert
+static inline uint32_t select_bits(uint32_t cond, uint32_t a, uint32_t b)
+{
+    uint32_t mask = 0u - cond;
+    return (a & mask) | (b & ~mask);
+}
+
+// rounding and nan handling follow vcvt
+static inline uint16_t float_to_half_c(float f)
+{
+    uint32_t u = float_bits(f);
+    uint32_t sign = (u >> 16) & 0x8000;
+    uint32_t a = u & 0x7fffffff;
+    // subnormal half: adding 0.5 makes the fpu round at 2^-24
+    uint32_t sub = float_bits(bits_float(a) + 0.5f) - 0x3f000000;
+    // normal half: rebias exponent and round to nearest even at bit 13
+    uint32_t norm = (a + 0xc8000fff + ((a >> 13) & 1)) >> 13;
+    // overflow to inf, nan is quieted and keeps the top of its payload;
+    // a has no sign bit, signed compares are cheaper to vectorize
+    int32_t sa = (int32_t)a;
+    uint32_t big = select_bits(sa > 0x7f800000, 0x7e00 | ((a >> 13) & 0x3ff), 0x7c00);
+    uint32_t h = select_bits(sa < 0x38800000, sub, norm);
+    h = select_bits(sa >= 0x47800000, big, h);
+    return (uint16_t)(h | sign);
+}
+
+static inline float half_to_float_c(uint16_t h)
+{
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    uint32_t o = (uint32_t)(h & 0x7fff) << 13;
+    uint32_t exp = o & 0x0f800000;
+    uint32_t norm = o + 0x38000000;
+    // subnormal: 2^-14 * (1 + m / 1024) - 2^-14
+    uint32_t sub = float_bits(bits_float(o + 0x38800000) - bits_float(0x38800000));
+    uint32_t special = (o + 0x70000000) | ((uint32_t)((o & 0x007fe000) != 0) << 22);
+    uint32_t f = select_bits(exp == 0x0f800000, special, select_bits(exp == 0, sub, norm));
+    return bits_float(f | sign);
+}
+
+static void float_to_half_array_c(const float* src, float scale, const float* add, uint16_t* dst, int n)
+{
+    if (add != NULL) {
+        for (int i = 0; i < n; i++) {
+            dst[i] = float_to_half_c(src[i] * scale + add[i]);
+        }
+    } else if (scale != 1.0f) {
+        for (int i = 0; i < n; i++) {
+            dst[i] = float_to_half_c(src[i] * scale);
+        }
+    } else {
+        for (int i = 0; i < n; i++) {
+            dst[i] = float_to_half_c(src[i]);
+        }
+    }
+}
+
+static void half_to_float_array_c(const uint16_t* src, float scale, float offset, float* dst, int n)
+{
+    if (scale != 1.0f || offset != 0.0f) {
+        for (int i = 0; i < n; i++) {
+            dst[i] = half_to_float_c(src[i]) * scale + offset;
+        }
+    } else {
+        for (int i = 0; i < n; i++) {
+            dst[i] = half_to_float_c(src[i]);
+        }
+    }
+}
+
+#if defined(HALF_UTILS_NEON)
+static void float_to_half_array_neon(const float* src, float scale, const float* add, uint16_t* dst, int n)
+{
+    int i = 0;
+    if (add != NULL) {
+        for (; i + 8 <= n; i += 8) {
+            float32x4_t a = vmlaq_n_f32(vld1q_f32(add + i), vld1q_f32(src + i), scale);
+            float32x4_t b = vmlaq_n_f32(vld1q_f32(add + i + 4), vld1q_f32(src + i + 4), scale);
+            vst1_u16(dst + i, vreinterpret_u16_f16(vcvt_f16_f32(a)));
+            vst1_u16(dst + i + 4, vreinterpret_u16_f16(vcvt_f16_f32(b)));
+        }
+    } else if (scale != 1.0f) {
+        for (; i + 8 <= n; i += 8) {
+            float32x4_t a = vmulq_n_f32(vld1q_f32(src + i), scale);
+            float32x4_t b = vmulq_n_f32(vld1q_f32(src + i + 4), scale);
+            vst1_u16(dst + i, vreinterpret_u16_f16(vcvt_f16_f32(a)));
+            vst1_u16(dst + i + 4, vreinterpret_u16_f16(vcvt_f16_f32(b)));
+        }
+    } else {
+        for (; i + 8 <= n; i += 8) {
+            vst1_u16(dst + i, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(src + i))));
+            vst1_u16(dst + i + 4, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(src + i + 4))));
+        }
+    }
+    float_to_half_array_c(src + i, scale, add != NULL ? add + i : NULL, dst + i, n - i);
+}
+
+static void half_to_float_array_neon(const uint16_t* src, float scale, float offset, float* dst, int n)
+{
+    int i = 0;
+    if (scale != 1.0f || offset != 0.0f) {
+        float32x4_t voffset = vdupq_n_f32(offset);
+        for (; i + 8 <= n; i += 8) {
+            float32x4_t a = vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(src + i)));
+            float32x4_t b = vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(src + i + 4)));
+            vst1q_f32(dst + i, vmlaq_n_f32(voffset, a, scale));
+            vst1q_f32(dst + i + 4, vmlaq_n_f32(voffset, b, scale));
+        }
+    } else {
+        for (; i + 8 <= n; i += 8) {
+            vst1q_f32(dst + i, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(src + i))));
+            vst1q_f32(dst + i + 4, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(src + i + 4))));
+        }
+    }
+    half_to_float_array_c(src + i, scale, offset, dst + i, n - i);
+}
+#endif
+
+#if defined(HALF_UTILS_F16C)
+HALF_UTILS_F16C_TARGET
+static void float_to_half_array_f16c(const float* src, float scale, const float* add, uint16_t* dst, int n)
+{
+    int i = 0;
+    __m256 vscale = _mm256_set1_ps(scale);
+    if (add != NULL) {
+        for (; i + 8 <= n; i += 8) {
+            __m256 v = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i), vscale), _mm256_loadu_ps(add + i));
+            _mm_storeu_si128((__m128i*)(dst + i), _mm256_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT));
+        }
+    } else if (scale != 1.0f) {
+        for (; i + 8 <= n; i += 8) {
+            __m256 v = _mm256_mul_ps(_mm256_loadu_ps(src + i), vscale);
+            _mm_storeu_si128((__m128i*)(dst + i), _mm256_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT));
+        }
+    } else {
+        for (; i + 8 <= n; i += 8) {
+            _mm_storeu_si128((__m128i*)(dst + i), _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT));
+        }
+    }
+    float_to_half_array_c(src + i, scale, add != NULL ? add + i : NULL, dst + i, n - i);
+}
+
+HALF_UTILS_F16C_TARGET
+static void half_to_float_array_f16c(const uint16_t* src, float scale, float offset, float* dst, int n)
+{
+    int i = 0;
+    if (scale != 1.0f || offset != 0.0f) {
+        __m256 vscale = _mm256_set1_ps(scale);
+        __m256 voffset = _mm256_set1_ps(offset);
+        for (; i + 8 <= n; i += 8) {
+            __m256 v = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(src + i)));
+            _mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_mul_ps(v, vscale), voffset));
+        }
+    } else {
+        for (; i + 8 <= n; i += 8) {
+            _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(src + i))));
+        }
+    }
+    half_to_float_array_c(src + i, scale, offset, dst + i, n - i);
+}
+#endif
+
+static half_backend_t g_backend = {"c", float_to_half_array_c, half_to_float_array_c};
+static pthread_once_t g_backend_once = PTHREAD_ONCE_INIT;
+
+static void select_backend(void)
+{
+#if defined(HALF_UTILS_NEON)
+    // part of the baseline the library was built for, no runtime check needed
+    g_backend.name = "neon";
+    g_backend.to_half = float_to_half_array_neon;
+    g_backend.to_float = half_to_float_array_neon;
+#elif defined(HALF_UTILS_F16C)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c")) {
+        g_backend.name = "f16c";
+        g_backend.to_half = float_to_half_array_f16c;
+        g_backend.to_float = half_to_float_array_f16c;
+    }
+#endif
+}
+
+static const half_backend_t* get_backend(void)
+{
+    pthread_once(&g_backend_once, select_backend);
+    return &g_backend;
+}
+
+uint16_t float_to_half(float f)
+{
+    return float_to_half_c(f);
+}
+
+float half_to_float(uint16_t h)
+{
+    return half_to_float_c(h);
+}
+
+void float_to_half_array(const float* src, uint16_t* dst, int n)
+{
+    get_backend()->to_half(src, 1.0f, NULL, dst, n);
+}
+
+void half_to_float_array(const uint16_t* src, float* dst, int n)
+{
+    get_backend()->to_float(src, 1.0f, 0.0f, dst, n);
+}
+
+void float_to_half_array_scaled(const float* src, float scale, const float* add, uint16_t* dst, int n)
+{
+    get_backend()->to_half(src, scale, add, dst, n);
+}
+
+void half_to_float_array_scaled(const uint16_t* src, float scale, float offset, float* dst, int n)
+{
+    get_backend()->to_float(src, scale, offset, dst, n);
+}
+
+const char* get_half_convert_backend(void)
+{
+    return get_backend()->name;
+}
@@ -0,0 +1,89 @@
+#ifndef _RKNN_MODEL_ZOO_HALF_UTILS_H_
+#define _RKNN_MODEL_ZOO_HALF_UTILS_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/**
+ * IEEE-754 half precision <-> float conversion
+ *
+ * The array functions pick a backend once per process:
+ * - neon: vcvt on aarch64 and on armv7 built with fp16 support (-mfpu=neon-fp16)
+ * - f16c: x86 cpus reporting F16C, e.g. when the demos are built for the host
+ * - c: branchless bit manipulation the compiler can vectorize
+ * All backends round to nearest even and keep inf/nan, results are bit identical.
+ */
+
+/**
+ * @brief Convert one float to half, round to nearest even
+ *
+ * @param f [in] Value
+ * @return uint16_t Half bits
+ */
+uint16_t float_to_half(float f);
+
+/**
+ * @brief Convert one half to float, exact
+ *
+ * @param h [in] Half bits
+ * @return float Value
+ */
+float half_to_float(uint16_t h);
+
+/**
+ * @brief Convert float array to half
+ *
+ * @param src [in] Source values
+ * @param dst [out] Half bits
+ * @param n [in] Number of elements
+ */
+void float_to_half_array(const float* src, uint16_t* dst, int n);
+
+/**
+ * @brief Convert half array to float
+ *
+ * @param src [in] Half bits
+ * @param dst [out] Values
+ * @param n [in] Number of elements
+ */
+void half_to_float_array(const uint16_t* src, float* dst, int n);
+
+/**
+ * @brief Convert float array to half with a fused dst = src * scale + add
+ *
+ * e.g. token embedding * sqrt(dim) + position embedding written straight to an fp16 input
+ *
+ * @param src [in] Source values
+ * @param scale [in] Scale of src
+ * @param add [in] Values added after scaling, NULL: none
+ * @param dst [out] Half bits
+ * @param n [in] Number of elements
+ */
+void float_to_half_array_scaled(const float* src, float scale, const float* add, uint16_t* dst, int n);
+
+/**
+ * @brief Convert half array to float with a fused dst = src * scale + offset
+ *
+ * @param src [in] Half bits
+ * @param scale [in] Scale
+ * @param offset [in] Offset added after scaling
+ * @param dst [out] Values
+ * @param n [in] Number of elements
+ */
+void half_to_float_array_scaled(const uint16_t* src, float scale, float offset, float* dst, int n);
+
+/**
+ * @brief Name of the backend used by the array functions
+ *
+ * @return const char* "neon", "f16c" or "c"
+ */
+const char* get_half_convert_backend(void);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif // _RKNN_MODEL_ZOO_HALF_UTILS_H_
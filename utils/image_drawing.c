@@ -2,6 +2,11 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <pthread.h>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 #include "image_drawing.h"
 #include "font.h"
@@ -1174,129 +1179,147 @@ static int resize_bilinear_c1(const unsigned char* src_pixels, int w, int h, uns
     return 0;
 }
 
-static void draw_text_c1(unsigned char* pixels, int w, int h, const char* text, int x, int y, int fontpixelsize,
-                         unsigned int color)
-{
-    const unsigned char* pen_color = (const unsigned char*)&color;
-    int stride = w;
-
-    unsigned char* resized_font_bitmap = (unsigned char*)malloc(fontpixelsize * fontpixelsize * 2);
-
-    const int n = strlen(text);
-
-    int cursor_x = x;
-    int cursor_y = y;
-    for (int i = 0; i < n; i++) {
-        char ch = text[i];
-
-        if (ch == '\n') {
-            // newline
-            cursor_x = x;
-            cursor_y += fontpixelsize * 2;
-        }
-
-        if (isprint(ch) != 0) {
-            const unsigned char* font_bitmap = mono_font_data[ch - ' '];
-
-            // draw resized character
-            resize_bilinear_c1(font_bitmap, 20, 40, resized_font_bitmap, fontpixelsize, fontpixelsize * 2);
-
-            for (int j = cursor_y; j < cursor_y + fontpixelsize * 2; j++) {
-                if (j < 0)
-                    continue;
-
-                if (j >= h)
-                    break;
+/*
+ * Glyph atlas: the 95 printable glyphs resized to fontpixelsize x (fontpixelsize * 2),
+ * built once per font size and kept for the process lifetime.
+ */
+#define GLYPH_ATLAS_CACHE_SIZE 8
+#define GLYPH_COUNT 95
 
-                const unsigned char* palpha = resized_font_bitmap + (j - cursor_y) * fontpixelsize;
-                unsigned char* p = pixels + stride * j;
+typedef struct {
+    int fontpixelsize;
+    unsigned char* bitmaps;
+} glyph_atlas_t;
 
-                for (int k = cursor_x; k < cursor_x + fontpixelsize; k++) {
-                    if (k < 0)
-                        continue;
+static glyph_atlas_t glyph_atlas_cache[GLYPH_ATLAS_CACHE_SIZE];
+static pthread_mutex_t glyph_atlas_lock = PTHREAD_MUTEX_INITIALIZER;
 
-                    if (k >= w)
-                        break;
+static unsigned char* build_glyph_atlas(int fontpixelsize)
+{
+    int glyph_size = fontpixelsize * fontpixelsize * 2;
+    unsigned char* bitmaps = (unsigned char*)malloc(glyph_size * GLYPH_COUNT);
+    if (bitmaps == NULL) {
+        return NULL;
+    }
+    for (int i = 0; i < GLYPH_COUNT; i++) {
+        resize_bilinear_c1(mono_font_data[i], 20, 40, bitmaps + i * glyph_size, fontpixelsize, fontpixelsize * 2);
+    }
+    return bitmaps;
+}
 
-                    unsigned char alpha = palpha[k - cursor_x];
+// *owned is set when the cache is full, caller must free it
+static const unsigned char* get_glyph_atlas(int fontpixelsize, unsigned char** owned)
+{
+    const unsigned char* bitmaps = NULL;
+    *owned = NULL;
 
-                    p[k] = (p[k] * (255 - alpha) + pen_color[0] * alpha) / 255;
-                }
+    pthread_mutex_lock(&glyph_atlas_lock);
+    for (int i = 0; i < GLYPH_ATLAS_CACHE_SIZE; i++) {
+        if (glyph_atlas_cache[i].fontpixelsize == fontpixelsize) {
+            bitmaps = glyph_atlas_cache[i].bitmaps;
+            break;
+        }
+        if (glyph_atlas_cache[i].bitmaps == NULL) {
+            glyph_atlas_cache[i].bitmaps = build_glyph_atlas(fontpixelsize);
+            if (glyph_atlas_cache[i].bitmaps != NULL) {
+                glyph_atlas_cache[i].fontpixelsize = fontpixelsize;
             }
-
-            cursor_x += fontpixelsize;
+            bitmaps = glyph_atlas_cache[i].bitmaps;
+            break;
         }
     }
+    pthread_mutex_unlock(&glyph_atlas_lock);
 
-    free(resized_font_bitmap);
+    if (bitmaps == NULL) {
+        *owned = build_glyph_atlas(fontpixelsize);
+        bitmaps = *owned;
+    }
+    return bitmaps;
 }
 
-static void draw_text_c2(unsigned char* pixels, int w, int h, const char* text, int x, int y, int fontpixelsize,
-                         unsigned int color)
+static inline const unsigned char* get_glyph(const unsigned char* atlas, int fontpixelsize, char ch)
 {
-    const unsigned char* pen_color = (const unsigned char*)&color;
-    int stride = w * 2;
-
-    unsigned char* resized_font_bitmap = (unsigned char*)malloc(fontpixelsize * fontpixelsize * 2);
+    return atlas + (ch - ' ') * fontpixelsize * fontpixelsize * 2;
+}
 
-    const int n = strlen(text);
+// x / 255 for x in [0, 255 * 255], same result as integer division
+#define DIV255(x) (((x) + 1 + ((x) >> 8)) >> 8)
 
-    int cursor_x = x;
-    int cursor_y = y;
-    for (int i = 0; i < n; i++) {
-        char ch = text[i];
-
-        if (ch == '\n') {
-            // newline
-            cursor_x = x;
-            cursor_y += fontpixelsize * 2;
+static void blend_row(unsigned char* p, const unsigned char* alpha, int n, int channels, const unsigned char* pen_color)
+{
+    int i = 0;
+#if defined(__ARM_NEON)
+    uint16x8_t one = vdupq_n_u16(1);
+    if (channels == 1) {
+        uint8x8_t c0 = vdup_n_u8(pen_color[0]);
+        for (; i + 8 <= n; i += 8) {
+            uint8x8_t a = vld1_u8(alpha + i);
+            uint16x8_t t = vmlal_u8(vmull_u8(vld1_u8(p + i), vmvn_u8(a)), c0, a);
+            vst1_u8(p + i, vshrn_n_u16(vaddq_u16(t, vsraq_n_u16(one, t, 8)), 8));
         }
-
-        if (isprint(ch) != 0) {
-            int font_bitmap_index = ch - ' ';
-            const unsigned char* font_bitmap = mono_font_data[font_bitmap_index];
-
-            // draw resized character
-            resize_bilinear_c1(font_bitmap, 20, 40, resized_font_bitmap, fontpixelsize, fontpixelsize * 2);
-
-            for (int j = cursor_y; j < cursor_y + fontpixelsize * 2; j++) {
-                if (j < 0)
-                    continue;
-
-                if (j >= h)
-                    break;
-
-                const unsigned char* palpha = resized_font_bitmap + (j - cursor_y) * fontpixelsize;
-                unsigned char* p = pixels + stride * j;
-
-                for (int k = cursor_x; k < cursor_x + fontpixelsize; k++) {
-                    if (k < 0)
-                        continue;
-
-                    if (k >= w)
-                        break;
-
-                    unsigned char alpha = palpha[k - cursor_x];
-
-                    p[k * 2 + 0] = (p[k * 2 + 0] * (255 - alpha) + pen_color[0] * alpha) / 255;
-                    p[k * 2 + 1] = (p[k * 2 + 1] * (255 - alpha) + pen_color[1] * alpha) / 255;
-                }
+    } else if (channels == 3) {
+        uint8x8_t c[3] = {vdup_n_u8(pen_color[0]), vdup_n_u8(pen_color[1]), vdup_n_u8(pen_color[2])};
+        for (; i + 8 <= n; i += 8) {
+            uint8x8_t a = vld1_u8(alpha + i);
+            uint8x8_t ia = vmvn_u8(a);
+            uint8x8x3_t px = vld3_u8(p + i * 3);
+            for (int k = 0; k < 3; k++) {
+                uint16x8_t t = vmlal_u8(vmull_u8(px.val[k], ia), c[k], a);
+                px.val[k] = vshrn_n_u16(vaddq_u16(t, vsraq_n_u16(one, t, 8)), 8);
             }
-
-            cursor_x += fontpixelsize;
+            vst3_u8(p + i * 3, px);
+        }
+    } else if (channels == 4) {
+        uint8x8_t c[4] = {vdup_n_u8(pen_color[0]), vdup_n_u8(pen_color[1]), vdup_n_u8(pen_color[2]),
+                          vdup_n_u8(pen_color[3])};
+        for (; i + 8 <= n; i += 8) {
+            uint8x8_t a = vld1_u8(alpha + i);
+            uint8x8_t ia = vmvn_u8(a);
+            uint8x8x4_t px = vld4_u8(p + i * 4);
+            for (int k = 0; k < 4; k++) {
+                uint16x8_t t = vmlal_u8(vmull_u8(px.val[k], ia), c[k], a);
+                px.val[k] = vshrn_n_u16(vaddq_u16(t, vsraq_n_u16(one, t, 8)), 8);
+            }
+            vst4_u8(p + i * 4, px);
         }
     }
+#endif
+    for (; i < n; i++) {
+        unsigned int a = alpha[i];
+        if (a == 0) {
+            continue;
+        }
+        for (int k = 0; k < channels; k++) {
+            unsigned int t = p[i * channels + k] * (255 - a) + pen_color[k] * a;
+            p[i * channels + k] = DIV255(t);
+        }
+    }
+}
 
-    free(resized_font_bitmap);
+static void fill_row(unsigned char* p, int n, int channels, const unsigned char* pen_color)
+{
+    if (channels == 1) {
+        memset(p, pen_color[0], n);
+        return;
+    }
+    for (int i = 0; i < n; i++) {
+        for (int k = 0; k < channels; k++) {
+            p[i * channels + k] = pen_color[k];
+        }
+    }
 }
 
-static void draw_text_c3(unsigned char* pixels, int w, int h, const char* text, int x, int y, int fontpixelsize,
-                         unsigned int color)
+static void draw_text_cn(unsigned char* pixels, int w, int h, int channels, const char* text, int x, int y,
+                         int fontpixelsize, unsigned int color)
 {
     const unsigned char* pen_color = (const unsigned char*)&color;
-    int stride = w * 3;
+    int stride = w * channels;
 
-    unsigned char* resized_font_bitmap = (unsigned char*)malloc(fontpixelsize * fontpixelsize * 2);
+    unsigned char* owned_atlas = NULL;
+    const unsigned char* atlas = get_glyph_atlas(fontpixelsize, &owned_atlas);
+    if (atlas == NULL) {
+        return;
+    }
 
     const int n = strlen(text);
 
@@ -1312,102 +1335,46 @@ static void draw_text_c3(unsigned char* pixels, int w, int h, const char* text,
         }
 
         if (isprint(ch) != 0) {
-            int font_bitmap_index = ch - ' ';
-            const unsigned char* font_bitmap = mono_font_data[font_bitmap_index];
-
-            // draw resized character
-            resize_bilinear_c1(font_bitmap, 20, 40, resized_font_bitmap, fontpixelsize, fontpixelsize * 2);
-
-            for (int j = cursor_y; j < cursor_y + fontpixelsize * 2; j++) {
-                if (j < 0)
-                    continue;
-
-                if (j >= h)
-                    break;
-
-                const unsigned char* palpha = resized_font_bitmap + (j - cursor_y) * fontpixelsize;
-                unsigned char* p = pixels + stride * j;
-
-                for (int k = cursor_x; k < cursor_x + fontpixelsize; k++) {
-                    if (k < 0)
-                        continue;
+            const unsigned char* glyph = get_glyph(atlas, fontpixelsize, ch);
+            int k0 = max(cursor_x, 0);
+            int k1 = min(cursor_x + fontpixelsize, w);
 
-                    if (k >= w)
-                        break;
-
-                    unsigned char alpha = palpha[k - cursor_x];
-
-                    p[k * 3 + 0] = (p[k * 3 + 0] * (255 - alpha) + pen_color[0] * alpha) / 255;
-                    p[k * 3 + 1] = (p[k * 3 + 1] * (255 - alpha) + pen_color[1] * alpha) / 255;
-                    p[k * 3 + 2] = (p[k * 3 + 2] * (255 - alpha) + pen_color[2] * alpha) / 255;
-                }
+            for (int j = max(cursor_y, 0); j < min(cursor_y + fontpixelsize * 2, h) && k0 < k1; j++) {
+                const unsigned char* palpha = glyph + (j - cursor_y) * fontpixelsize + (k0 - cursor_x);
+                blend_row(pixels + stride * j + k0 * channels, palpha, k1 - k0, channels, pen_color);
             }
 
             cursor_x += fontpixelsize;
         }
     }
 
-    free(resized_font_bitmap);
+    if (owned_atlas != NULL) {
+        free(owned_atlas);
+    }
 }
 
-static void draw_text_c4(unsigned char* pixels, int w, int h, const char* text, int x, int y, int fontpixelsize,
+static void draw_text_c1(unsigned char* pixels, int w, int h, const char* text, int x, int y, int fontpixelsize,
                          unsigned int color)
 {
-    const unsigned char* pen_color = (const unsigned char*)&color;
-    int stride = w * 4;
-
-    unsigned char* resized_font_bitmap = (unsigned char*)malloc(fontpixelsize * fontpixelsize * 2);
-
-    const int n = strlen(text);
-
-    int cursor_x = x;
-    int cursor_y = y;
-    for (int i = 0; i < n; i++) {
-        char ch = text[i];
-
-        if (ch == '\n') {
-            // newline
-            cursor_x = x;
-            cursor_y += fontpixelsize * 2;
-        }
-
-        if (isprint(ch) != 0) {
-            const unsigned char* font_bitmap = mono_font_data[ch - ' '];
-
-            // draw resized character
-            resize_bilinear_c1(font_bitmap, 20, 40, resized_font_bitmap, fontpixelsize, fontpixelsize * 2);
-
-            for (int j = cursor_y; j < cursor_y + fontpixelsize * 2; j++) {
-                if (j < 0)
-                    continue;
-
-                if (j >= h)
-                    break;
-
-                const unsigned char* palpha = resized_font_bitmap + (j - cursor_y) * fontpixelsize;
-                unsigned char* p = pixels + stride * j;
-
-                for (int k = cursor_x; k < cursor_x + fontpixelsize; k++) {
-                    if (k < 0)
-                        continue;
-
-                    if (k >= w)
-                        break;
-
-                    unsigned char alpha = palpha[k - cursor_x];
+    draw_text_cn(pixels, w, h, 1, text, x, y, fontpixelsize, color);
+}
 
-                    p[k * 4 + 0] = (p[k * 4 + 0] * (255 - alpha) + pen_color[0] * alpha) / 255;
-                    p[k * 4 + 1] = (p[k * 4 + 1] * (255 - alpha) + pen_color[1] * alpha) / 255;
-                    p[k * 4 + 2] = (p[k * 4 + 2] * (255 - alpha) + pen_color[2] * alpha) / 255;
-                    p[k * 4 + 3] = (p[k * 4 + 3] * (255 - alpha) + pen_color[3] * alpha) / 255;
-                }
-            }
+static void draw_text_c2(unsigned char* pixels, int w, int h, const char* text, int x, int y, int fontpixelsize,
+                         unsigned int color)
+{
+    draw_text_cn(pixels, w, h, 2, text, x, y, fontpixelsize, color);
+}
 
-            cursor_x += fontpixelsize;
-        }
-    }
+static void draw_text_c3(unsigned char* pixels, int w, int h, const char* text, int x, int y, int fontpixelsize,
+                         unsigned int color)
+{
+    draw_text_cn(pixels, w, h, 3, text, x, y, fontpixelsize, color);
+}
 
-    free(resized_font_bitmap);
+static void draw_text_c4(unsigned char* pixels, int w, int h, const char* text, int x, int y, int fontpixelsize,
+                         unsigned int color)
+{
+    draw_text_cn(pixels, w, h, 4, text, x, y, fontpixelsize, color);
 }
 
 static void draw_text_yuv420sp(unsigned char* yuv420sp, int w, int h, const char* text, int x, int y, int fontpixelsize,
@@ -1639,3 +1606,184 @@ void draw_image(image_buffer_t* image, unsigned char* draw_img, int x, int y, in
         break;
     }
 }
+
+typedef struct {
+    int index;
+    int x0;
+    int y0;
+    int x1;
+    int y1;
+    int gx;
+    int gy;
+    int glyph_w;
+    const unsigned char* glyph;  // NULL: solid fill
+    unsigned int color;
+} draw_span_t;
+
+static int add_fill_span(draw_span_t* spans, int n, int w, int h, int x0, int y0, int x1, int y1, unsigned int color)
+{
+    x0 = max(x0, 0);
+    y0 = max(y0, 0);
+    x1 = min(x1, w);
+    y1 = min(y1, h);
+    if (x0 >= x1 || y0 >= y1) {
+        return n;
+    }
+    draw_span_t* s = &spans[n];
+    s->index = n;
+    s->x0 = x0;
+    s->y0 = y0;
+    s->x1 = x1;
+    s->y1 = y1;
+    s->glyph = NULL;
+    s->color = color;
+    return n + 1;
+}
+
+static int cmp_span_start(const void* a, const void* b)
+{
+    const draw_span_t* sa = *(const draw_span_t* const*)a;
+    const draw_span_t* sb = *(const draw_span_t* const*)b;
+    if (sa->y0 != sb->y0) {
+        return sa->y0 - sb->y0;
+    }
+    return sa->index - sb->index;
+}
+
+void draw_detections(image_buffer_t* image, const draw_detection_t* dets, int count, int thickness, int fontsize)
+{
+    image_format_t format = image->format;
+    unsigned char* pixels = image->virt_addr;
+    int w = image->width;
+    int h = image->height;
+    int channels;
+
+    if (format == IMAGE_FORMAT_RGB888) {
+        channels = 3;
+    } else if (format == IMAGE_FORMAT_RGBA8888) {
+        channels = 4;
+    } else {
+        for (int i = 0; i < count; i++) {
+            const image_rect_t* box = &dets[i].box;
+            draw_rectangle(image, box->left, box->top, box->right - box->left, box->bottom - box->top,
+                           dets[i].box_color, thickness);
+            if (dets[i].text != NULL) {
+                draw_text(image, dets[i].text, box->left, box->top - fontsize * 2, dets[i].text_color, fontsize);
+            }
+        }
+        return;
+    }
+
+    unsigned char* owned_atlas = NULL;
+    const unsigned char* atlas = get_glyph_atlas(fontsize, &owned_atlas);
+
+    // split every box edge and every glyph into a rectangle span, in drawing order
+    int max_spans = 0;
+    for (int i = 0; i < count; i++) {
+        max_spans += 4 + (dets[i].text != NULL ? (int)strlen(dets[i].text) : 0);
+    }
+    draw_span_t* spans = (draw_span_t*)malloc(sizeof(draw_span_t) * (max_spans > 0 ? max_spans : 1));
+    draw_span_t** order = (draw_span_t**)malloc(sizeof(draw_span_t*) * (max_spans > 0 ? max_spans : 1));
+    draw_span_t** active = (draw_span_t**)malloc(sizeof(draw_span_t*) * (max_spans > 0 ? max_spans : 1));
+    if (spans == NULL || order == NULL || active == NULL) {
+        printf("draw_detections malloc fail\n");
+        goto out;
+    }
+
+    int n = 0;
+    const int t0 = thickness / 2;
+    const int t1 = thickness - t0;
+    for (int i = 0; i < count; i++) {
+        int rx = dets[i].box.left;
+        int ry = dets[i].box.top;
+        int rw = dets[i].box.right - rx;
+        int rh = dets[i].box.bottom - ry;
+        unsigned int box_color = convert_color(dets[i].box_color, format);
+
+        if (thickness == -1) {
+            n = add_fill_span(spans, n, w, h, rx, ry, rx + rw, ry + rh, box_color);
+        } else {
+            n = add_fill_span(spans, n, w, h, rx - t0, ry - t0, rx + rw + t1, ry + t1, box_color);
+            n = add_fill_span(spans, n, w, h, rx - t0, ry + rh - t0, rx + rw + t1, ry + rh + t1, box_color);
+            n = add_fill_span(spans, n, w, h, rx - t0, ry + t1, rx + t1, ry + rh - t0, box_color);
+            n = add_fill_span(spans, n, w, h, rx + rw - t0, ry + t1, rx + rw + t1, ry + rh - t0, box_color);
+        }
+
+        if (dets[i].text == NULL || atlas == NULL) {
+            continue;
+        }
+        unsigned int text_color = convert_color(dets[i].text_color, format);
+        int cursor_x = rx;
+        int cursor_y = ry - fontsize * 2;
+        for (const char* p = dets[i].text; *p != '\0'; p++) {
+            if (*p == '\n') {
+                cursor_x = rx;
+                cursor_y += fontsize * 2;
+            }
+            if (isprint(*p) == 0) {
+                continue;
+            }
+            int m = add_fill_span(spans, n, w, h, cursor_x, cursor_y, cursor_x + fontsize, cursor_y + fontsize * 2,
+                                  text_color);
+            if (m > n) {
+                spans[n].gx = cursor_x;
+                spans[n].gy = cursor_y;
+                spans[n].glyph_w = fontsize;
+                spans[n].glyph = get_glyph(atlas, fontsize, *p);
+                n = m;
+            }
+            cursor_x += fontsize;
+        }
+    }
+
+    for (int i = 0; i < n; i++) {
+        order[i] = &spans[i];
+    }
+    qsort(order, n, sizeof(draw_span_t*), cmp_span_start);
+
+    // sweep rows top to bottom, each row visits its active spans in drawing order
+    int next = 0;
+    int num_active = 0;
+    int y = n > 0 ? order[0]->y0 : h;
+    while (y < h && (next < n || num_active > 0)) {
+        while (next < n && order[next]->y0 <= y) {
+            draw_span_t* s = order[next++];
+            int pos = num_active++;
+            while (pos > 0 && active[pos - 1]->index > s->index) {
+                active[pos] = active[pos - 1];
+                pos--;
+            }
+            active[pos] = s;
+        }
+
+        unsigned char* row = pixels + (size_t)y * w * channels;
+        int kept = 0;
+        for (int i = 0; i < num_active; i++) {
+            draw_span_t* s = active[i];
+            if (s->y1 <= y) {
+                continue;
+            }
+            active[kept++] = s;
+            if (s->glyph == NULL) {
+                fill_row(row + s->x0 * channels, s->x1 - s->x0, channels, (const unsigned char*)&s->color);
+            } else {
+                const unsigned char* palpha = s->glyph + (y - s->gy) * s->glyph_w + (s->x0 - s->gx);
+                blend_row(row + s->x0 * channels, palpha, s->x1 - s->x0, channels, (const unsigned char*)&s->color);
+            }
+        }
+        num_active = kept;
+
+        y++;
+        if (num_active == 0 && next < n && order[next]->y0 > y) {
+            y = order[next]->y0;
+        }
+    }
+
+out:
+    free(spans);
+    free(order);
+    free(active);
+    if (owned_atlas != NULL) {
+        free(owned_atlas);
+    }
+}
@@ -16,6 +16,17 @@ extern "C" {
 #define COLOR_BLACK     0xFF000000
 #define COLOR_WHITE     0xFFFFFFFF
 
+/**
+ * @brief Detection box and label for draw_detections
+ * 
+ */
+typedef struct {
+    image_rect_t box;
+    unsigned int box_color;
+    const char* text;
+    unsigned int text_color;
+} draw_detection_t;
+
 /**
  * @brief Draw rectangle
  * 
@@ -97,6 +108,20 @@ void draw_circle(image_buffer_t* image, int cx, int cy, int radius, unsigned int
  */
 void draw_image(image_buffer_t* image, unsigned char* draw_img, int x, int y, int rw, int rh);
 
+/**
+ * @brief Draw boxes and labels of all detections in one row-ordered pass
+ * 
+ * Same result as draw_rectangle + draw_text (label at box top - fontsize * 2) for each
+ * detection in order, but every image row is visited once for RGB888/RGBA8888.
+ * 
+ * @param image [in] Image buffer
+ * @param dets [in] Detections
+ * @param count [in] Detection count
+ * @param thickness [in] Rectangle line thickness
+ * @param fontsize [in] Text fontsize
+ */
+void draw_detections(image_buffer_t* image, const draw_detection_t* dets, int count, int thickness, int fontsize);
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif
@@ -2,8 +2,18 @@
 #include <stdlib.h>
 #include <dirent.h>
 #include <math.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/time.h>
 
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 #include "im2d.h"
 #include "drmrga.h"
 
@@ -18,6 +28,8 @@
 
 #include "image_utils.h"
 #include "file_utils.h"
+#include "half_utils.h"
+#include "trace_utils.h"
 
 static const char* filter_image_names[] = {
     "jpg",
@@ -35,104 +47,165 @@ static const char* filter_image_names[] = {
 static const char* subsampName[TJ_NUMSAMP] = {"4:4:4", "4:2:2", "4:2:0", "Grayscale", "4:4:0", "4:1:1"};
 static const char* colorspaceName[TJ_NUMCS] = {"RGB", "YCbCr", "GRAY", "CMYK", "YCCK"};
 
-static int read_image_jpeg(const char* path, image_buffer_t* image)
-{
-    FILE* jpegFile = NULL;
-    unsigned long jpegSize;
-    int flags = 0;
-    int width, height;
-    int origin_width, origin_height;
-    unsigned char* imgBuf = NULL;
-    unsigned char* jpegBuf = NULL;
-    unsigned long size;
-    unsigned short orientation = 1;
-    struct timeval tv1, tv2;
+static pthread_key_t tj_decompress_key;
+static pthread_once_t tj_decompress_once = PTHREAD_ONCE_INIT;
 
-    if ((jpegFile = fopen(path, "rb")) == NULL) {
-        printf("open input file failure\n");
-    }
-    if (fseek(jpegFile, 0, SEEK_END) < 0 || (size = ftell(jpegFile)) < 0 || fseek(jpegFile, 0, SEEK_SET) < 0) {
-        printf("determining input file size failure\n");
-    }
-    if (size == 0) {
-        printf("determining input file size, Input file contains no data\n");
-    }
-    jpegSize = (unsigned long)size;
-    if ((jpegBuf = (unsigned char*)malloc(jpegSize * sizeof(unsigned char))) == NULL) {
-        printf("allocating JPEG buffer\n");
+static void destroy_tj_decompressor(void* handle)
+{
+    if (handle != NULL) {
+        tjDestroy((tjhandle)handle);
     }
-    if (fread(jpegBuf, jpegSize, 1, jpegFile) < 1) {
-        printf("reading input file");
+}
+
+static void create_tj_decompress_key(void)
+{
+    pthread_key_create(&tj_decompress_key, destroy_tj_decompressor);
+}
+
+// one decompressor per thread, released when the thread exits
+static tjhandle get_tj_decompressor(void)
+{
+    pthread_once(&tj_decompress_once, create_tj_decompress_key);
+    tjhandle handle = (tjhandle)pthread_getspecific(tj_decompress_key);
+    if (handle == NULL) {
+        handle = tjInitDecompress();
+        if (handle == NULL) {
+            printf("tjInitDecompress fail: %s\n", tjGetErrorStr());
+            return NULL;
+        }
+        pthread_setspecific(tj_decompress_key, handle);
     }
-    fclose(jpegFile);
-    jpegFile = NULL;
+    return handle;
+}
 
-    tjhandle handle = NULL;
+/*
+ * Decode jpeg data to RGB888 with the smallest DCT scaling factor (1/1, 1/2, 1/4, 1/8)
+ * that still covers the letterbox of model_width x model_height, so the following
+ * resize never upscales. Pass 0 to decode at full size.
+ */
+static int decode_image_jpeg(const unsigned char* jpeg_buf, unsigned long jpeg_size, int model_width, int model_height,
+                             image_buffer_t* image, image_decode_info_t* info)
+{
+    int width, height;
     int subsample, colorspace;
-    int padding = 1;
-    int ret = 0;
+    int flags = 0;
+    int ret;
 
-    handle = tjInitDecompress();
-    ret = tjDecompressHeader3(handle, jpegBuf, size, &origin_width, &origin_height, &subsample, &colorspace);
-    if (ret < 0) {
-        printf("header file error, errorStr:%s, errorCode:%d\n", tjGetErrorStr(), tjGetErrorCode(handle));
+    tjhandle handle = get_tj_decompressor();
+    if (handle == NULL) {
         return -1;
     }
 
-    // 对图像做裁剪16对齐，利于后续rga操作
-    int crop_width = origin_width / 16 * 16;
-    int crop_height = origin_height / 16 * 16;
-
-    printf("origin size=%dx%d crop size=%dx%d\n", origin_width, origin_height, crop_width, crop_height);
-
-    // gettimeofday(&tv1, NULL);
-    ret = tjDecompressHeader3(handle, jpegBuf, size, &width, &height, &subsample, &colorspace);
+    ret = tjDecompressHeader3(handle, jpeg_buf, jpeg_size, &width, &height, &subsample, &colorspace);
     if (ret < 0) {
         printf("header file error, errorStr:%s, errorCode:%d\n", tjGetErrorStr(), tjGetErrorCode(handle));
         return -1;
     }
-    printf("input image: %d x %d, subsampling: %s, colorspace: %s, orientation: %d\n", 
-            width, height, subsampName[subsample], colorspaceName[colorspace], orientation);
-    int sw_out_size = width * height * 3;
-    unsigned char* sw_out_buf = image->virt_addr;
-    if (sw_out_buf == NULL) {
-        sw_out_buf = (unsigned char*)malloc(sw_out_size * sizeof(unsigned char));
+
+    int min_width = width;
+    int min_height = height;
+    if (model_width > 0 && model_height > 0) {
+        float scale_w = (float)model_width / width;
+        float scale_h = (float)model_height / height;
+        float scale = scale_w < scale_h ? scale_w : scale_h;
+        if (scale < 1.0f) {
+            min_width = (int)(width * scale);
+            min_height = (int)(height * scale);
+        }
     }
-    if (sw_out_buf == NULL) {
-        printf("sw_out_buf is NULL\n");
-        goto out;
+
+    int out_width = width;
+    int out_height = height;
+    int out_denom = 1;
+    int num_factors = 0;
+    tjscalingfactor* factors = tjGetScalingFactors(&num_factors);
+    for (int i = 0; factors != NULL && i < num_factors; i++) {
+        if (factors[i].num != 1 || (factors[i].denom != 2 && factors[i].denom != 4 && factors[i].denom != 8)) {
+            continue;
+        }
+        int w = TJSCALED(width, factors[i]);
+        int h = TJSCALED(height, factors[i]);
+        if (w >= min_width && h >= min_height && w < out_width) {
+            out_width = w;
+            out_height = h;
+            out_denom = factors[i].denom;
+        }
     }
+    TRACE_LOG("input image: %d x %d, decode size: %d x %d, subsampling: %s, colorspace: %s\n",
+            width, height, out_width, out_height, subsampName[subsample], colorspaceName[colorspace]);
 
-    flags |= 0;
+    int out_size = out_width * out_height * 3;
+    unsigned char* out_buf = image->virt_addr;
+    if (out_buf != NULL && image->size > 0 && image->size < out_size) {
+        printf("image buffer too small %d < %d\n", image->size, out_size);
+        return -1;
+    }
+    if (out_buf == NULL) {
+        out_buf = (unsigned char*)malloc(out_size);
+        if (out_buf == NULL) {
+            printf("malloc size %d fail\n", out_size);
+            return -1;
+        }
+    }
 
     // 错误码为0时，表示警告，错误码为-1时表示错误
-    int pixelFormat = TJPF_RGB;
-    ret = tjDecompress2(handle, jpegBuf, size, sw_out_buf, width, 0, height, pixelFormat, flags);
-    // ret = tjDecompressToYUV2(handle, jpeg_buf, size, dst_buf, *width, padding, *height, flags);
-    if ((0 != tjGetErrorCode(handle)) && (ret < 0)) {
-        printf("error : decompress to yuv failed, errorStr:%s, errorCode:%d\n", tjGetErrorStr(),
-               tjGetErrorCode(handle));
-        goto out;
-    }
-    if ((0 == tjGetErrorCode(handle)) && (ret < 0)) {
+    ret = tjDecompress2(handle, jpeg_buf, jpeg_size, out_buf, out_width, 0, out_height, TJPF_RGB, flags);
+    if (ret < 0) {
+        if (tjGetErrorCode(handle) != TJERR_WARNING) {
+            printf("error : decompress failed, errorStr:%s, errorCode:%d\n", tjGetErrorStr(),
+                   tjGetErrorCode(handle));
+            if (out_buf != image->virt_addr) {
+                free(out_buf);
+            }
+            return -1;
+        }
         printf("warning : errorStr:%s, errorCode:%d\n", tjGetErrorStr(), tjGetErrorCode(handle));
     }
-    tjDestroy(handle);
-    // gettimeofday(&tv2, NULL);
-    // printf("decode time %ld ms\n", (tv2.tv_sec-tv1.tv_sec)*1000 + (tv2.tv_usec-tv1.tv_usec)/1000);
 
-    image->width = width;
-    image->height = height;
+    image->width = out_width;
+    image->height = out_height;
     image->format = IMAGE_FORMAT_RGB888;
-    image->virt_addr = sw_out_buf;
-    image->size = sw_out_size;
-out:
-    if (jpegBuf) {
-        free(jpegBuf);
+    image->virt_addr = out_buf;
+    image->size = out_size;
+    if (info != NULL) {
+        info->orig_width = width;
+        info->orig_height = height;
+        info->scale_denom = out_denom;
     }
     return 0;
 }
 
+static int read_image_jpeg_scaled(const char* path, int model_width, int model_height, image_buffer_t* image,
+                                  image_decode_info_t* info)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        printf("open %s fail\n", path);
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        printf("determining input file size failure, %s\n", path);
+        close(fd);
+        return -1;
+    }
+    void* jpeg_buf = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (jpeg_buf == MAP_FAILED) {
+        printf("mmap %s fail\n", path);
+        return -1;
+    }
+
+    int ret = decode_image_jpeg((const unsigned char*)jpeg_buf, (unsigned long)st.st_size, model_width, model_height, image, info);
+    munmap(jpeg_buf, st.st_size);
+    return ret;
+}
+
+static int read_image_jpeg(const char* path, image_buffer_t* image)
+{
+    return read_image_jpeg_scaled(path, 0, 0, image, NULL);
+}
+
 static int write_image_jpeg(const char* path, int quality, const image_buffer_t* image)
 {
     int ret;
@@ -178,6 +251,60 @@ static int image_file_filter(const struct dirent *entry)
     return 0;
 }
 
+static int cmp_image_names(const struct dirent** a, const struct dirent** b)
+{
+    return strcmp((*a)->d_name, (*b)->d_name);
+}
+
+char** list_image_files(const char* path, int* count)
+{
+    struct stat st;
+    char** files = NULL;
+    int num = 0;
+
+    *count = 0;
+    if (stat(path, &st) != 0) {
+        printf("stat %s fail\n", path);
+        return NULL;
+    }
+
+    if (S_ISDIR(st.st_mode)) {
+        struct dirent** entries = NULL;
+        int n = scandir(path, &entries, image_file_filter, cmp_image_names);
+        if (n < 0) {
+            printf("scandir %s fail\n", path);
+            return NULL;
+        }
+        files = (char**)malloc(sizeof(char*) * (n > 0 ? n : 1));
+        for (int i = 0; i < n; i++) {
+            if (files != NULL) {
+                size_t len = strlen(path) + strlen(entries[i]->d_name) + 2;
+                files[num] = (char*)malloc(len);
+                snprintf(files[num], len, "%s/%s", path, entries[i]->d_name);
+                num++;
+            }
+            free(entries[i]);
+        }
+        free(entries);
+    } else {
+        // list file, one image path per line
+        int line_count = 0;
+        files = read_lines_from_file(path, &line_count);
+        for (int i = 0; files != NULL && i < line_count; i++) {
+            if (files[i] != NULL && files[i][0] != '\0') {
+                files[num++] = files[i];
+            } else if (files[i] != NULL) {
+                free(files[i]);
+            }
+        }
+    }
+    if (files == NULL) {
+        return NULL;
+    }
+    *count = num;
+    return files;
+}
+
 static int read_image_raw(const char* path, image_buffer_t* image)
 {
     FILE *fp = fopen(path, "rb");
@@ -240,7 +367,13 @@ static int read_image_stb(const char* path, image_buffer_t* image)
     return 0;
 }
 
-int read_image(const char* path, image_buffer_t* image)
+static int is_jpeg_ext(const char* ext)
+{
+    return strcmp(ext, ".jpg") == 0 || strcmp(ext, ".jpeg") == 0 || strcmp(ext, ".JPG") == 0 ||
+        strcmp(ext, ".JPEG") == 0;
+}
+
+static int read_image_by_ext(const char* path, image_buffer_t* image)
 {
     const char* _ext = strrchr(path, '.');
     if (!_ext) {
@@ -250,8 +383,7 @@ int read_image(const char* path, image_buffer_t* image)
     if (strcmp(_ext, ".data") == 0) {
         return read_image_raw(path, image);
 #ifndef DISABLE_LIBJPEG
-    } else if (strcmp(_ext, ".jpg") == 0 || strcmp(_ext, ".jpeg") == 0 || strcmp(_ext, ".JPG") == 0 ||
-        strcmp(_ext, ".JPEG") == 0) {
+    } else if (is_jpeg_ext(_ext)) {
         return read_image_jpeg(path, image);
 #endif
     } else {
@@ -259,6 +391,41 @@ int read_image(const char* path, image_buffer_t* image)
     }
 }
 
+int read_image(const char* path, image_buffer_t* image)
+{
+    uint64_t begin = TRACE_BEGIN();
+    int ret = read_image_by_ext(path, image);
+    TRACE_END(TRACE_STAGE_DECODE, "read_image", begin);
+    return ret;
+}
+
+int read_image_for_model(const char* path, int model_width, int model_height, image_buffer_t* image,
+                         image_decode_info_t* info)
+{
+    const char* _ext = strrchr(path, '.');
+    if (!_ext) {
+        // missing extension
+        return -1;
+    }
+    uint64_t begin = TRACE_BEGIN();
+    int ret;
+#ifndef DISABLE_LIBJPEG
+    if (is_jpeg_ext(_ext)) {
+        ret = read_image_jpeg_scaled(path, model_width, model_height, image, info);
+    } else
+#endif
+    {
+        ret = read_image_by_ext(path, image);
+        if (ret == 0 && info != NULL) {
+            info->orig_width = image->width;
+            info->orig_height = image->height;
+            info->scale_denom = 1;
+        }
+    }
+    TRACE_END(TRACE_STAGE_DECODE, "read_image", begin);
+    return ret;
+}
+
 int write_image(const char* path, const image_buffer_t* img)
 {
     int ret;
@@ -386,6 +553,495 @@ static int crop_and_scale_image_yuv420sp(unsigned char *src, int src_width, int
     return 0;
 }
 
+/*
+ * Fused YUV420SP -> RGB/BGR tensor conversion on cpu
+ *
+ * Each thread owns a band of destination rows. Source rows are first resized
+ * horizontally into int16 buffers (7 fractional bits), cached two at a time,
+ * then blended vertically, color converted (BT.601 limited range) and written
+ * to the target layout/type directly.
+ */
+#define YUV_RESIZE_BITS 7
+#define YUV_RESIZE_ONE (1 << YUV_RESIZE_BITS)
+#define YUV_MAX_THREADS 8
+// fp16 rows are converted in chunks of this many pixels
+#define YUV_HALF_CHUNK 256
+
+typedef struct {
+    const unsigned char* y_plane;
+    const unsigned char* uv_plane;
+    int stride;
+    int uv_swap;
+    int crop_x;
+    int crop_y;
+    int crop_w;
+    int crop_h;
+
+    void* dst;
+    int dst_w;
+    int dst_h;
+    int box_x;
+    int box_y;
+    int box_w;
+    int box_h;
+    image_tensor_layout_t layout;
+    image_tensor_type_t type;
+    int bgr;
+    float scale[3];
+    float offset[3];
+    float pad[3];
+
+    // horizontal resize tables, box_w entries each
+    int* x_ofs0;
+    int* x_ofs1;
+    short* x_wt;
+    int* cx_ofs0;
+    int* cx_ofs1;
+    short* cx_wt;
+} yuv_convert_job_t;
+
+typedef struct {
+    const yuv_convert_job_t* job;
+    int row_begin;
+    int row_end;
+    int ret;
+} yuv_convert_task_t;
+
+typedef struct {
+    short* buf[2];
+    int idx[2];
+} yuv_row_cache_t;
+
+// Map destination index to the two source taps and the weight of the second one
+static void build_resize_table(int dst_len, int src_len, float ratio, int src_base,
+                               int* ofs0, int* ofs1, short* wt)
+{
+    for (int i = 0; i < dst_len; i++) {
+        float fx = (i + 0.5f) * ratio - 0.5f;
+        if (fx < 0) {
+            fx = 0;
+        }
+        int x0 = (int)fx;
+        float w = fx - x0;
+        if (x0 >= src_len - 1) {
+            x0 = src_len - 1;
+            w = 0;
+        }
+        ofs0[i] = src_base + x0;
+        ofs1[i] = src_base + (x0 + 1 < src_len ? x0 + 1 : x0);
+        wt[i] = (short)(w * YUV_RESIZE_ONE + 0.5f);
+    }
+}
+
+static void yuv_resize_luma_row(const yuv_convert_job_t* job, int row, short* out)
+{
+    const unsigned char* src = job->y_plane + (size_t)row * job->stride;
+    for (int i = 0; i < job->box_w; i++) {
+        int a = src[job->x_ofs0[i]];
+        int b = src[job->x_ofs1[i]];
+        out[i] = (short)((a << YUV_RESIZE_BITS) + (b - a) * job->x_wt[i]);
+    }
+}
+
+// output is interleaved U, V whatever the source order is
+static void yuv_resize_chroma_row(const yuv_convert_job_t* job, int row, short* out)
+{
+    const unsigned char* src = job->uv_plane + (size_t)row * job->stride;
+    int u_idx = job->uv_swap ? 1 : 0;
+    int v_idx = 1 - u_idx;
+    for (int i = 0; i < job->box_w; i++) {
+        const unsigned char* p0 = src + job->cx_ofs0[i] * 2;
+        const unsigned char* p1 = src + job->cx_ofs1[i] * 2;
+        int w = job->cx_wt[i];
+        out[i * 2] = (short)((p0[u_idx] << YUV_RESIZE_BITS) + (p1[u_idx] - p0[u_idx]) * w);
+        out[i * 2 + 1] = (short)((p0[v_idx] << YUV_RESIZE_BITS) + (p1[v_idx] - p0[v_idx]) * w);
+    }
+}
+
+static const short* yuv_fetch_row(const yuv_convert_job_t* job, yuv_row_cache_t* cache, int row, int keep, int chroma)
+{
+    if (cache->idx[0] == row) {
+        return cache->buf[0];
+    }
+    if (cache->idx[1] == row) {
+        return cache->buf[1];
+    }
+    int slot = (cache->idx[0] == keep) ? 1 : 0;
+    if (chroma) {
+        yuv_resize_chroma_row(job, row, cache->buf[slot]);
+    } else {
+        yuv_resize_luma_row(job, row, cache->buf[slot]);
+    }
+    cache->idx[slot] = row;
+    return cache->buf[slot];
+}
+
+// vertical blend and BT.601 limited range color conversion into planar r/g/b rows (0~255)
+static void yuv_blend_to_rgb_row(const short* ya, const short* yb, float fy,
+                                 const short* uva, const short* uvb, float fc,
+                                 int n, float* r, float* g, float* b)
+{
+    const float ky = 1.164383f / YUV_RESIZE_ONE;
+    const float kc = 1.0f / YUV_RESIZE_ONE;
+    int i = 0;
+#if defined(__ARM_NEON)
+    float32x4_t vfy = vdupq_n_f32(fy);
+    float32x4_t vfc = vdupq_n_f32(fc);
+    float32x4_t vky = vdupq_n_f32(ky);
+    float32x4_t vkc = vdupq_n_f32(kc);
+    float32x4_t vyoff = vdupq_n_f32(-16.0f * 1.164383f);
+    float32x4_t vcoff = vdupq_n_f32(-128.0f);
+    float32x4_t vzero = vdupq_n_f32(0.0f);
+    float32x4_t vmax = vdupq_n_f32(255.0f);
+    for (; i + 4 <= n; i += 4) {
+        float32x4_t y0 = vcvtq_f32_s32(vmovl_s16(vld1_s16(ya + i)));
+        float32x4_t y1 = vcvtq_f32_s32(vmovl_s16(vld1_s16(yb + i)));
+        int16x4x2_t c0 = vld2_s16(uva + i * 2);
+        int16x4x2_t c1 = vld2_s16(uvb + i * 2);
+        float32x4_t u0 = vcvtq_f32_s32(vmovl_s16(c0.val[0]));
+        float32x4_t v0 = vcvtq_f32_s32(vmovl_s16(c0.val[1]));
+        float32x4_t u1 = vcvtq_f32_s32(vmovl_s16(c1.val[0]));
+        float32x4_t v1 = vcvtq_f32_s32(vmovl_s16(c1.val[1]));
+
+        float32x4_t yy = vmlaq_f32(vyoff, vmlaq_f32(y0, vsubq_f32(y1, y0), vfy), vky);
+        float32x4_t uu = vmlaq_f32(vcoff, vmlaq_f32(u0, vsubq_f32(u1, u0), vfc), vkc);
+        float32x4_t vv = vmlaq_f32(vcoff, vmlaq_f32(v0, vsubq_f32(v1, v0), vfc), vkc);
+
+        float32x4_t rr = vmlaq_n_f32(yy, vv, 1.596027f);
+        float32x4_t gg = vmlsq_n_f32(vmlsq_n_f32(yy, uu, 0.391762f), vv, 0.812968f);
+        float32x4_t bb = vmlaq_n_f32(yy, uu, 2.017232f);
+
+        vst1q_f32(r + i, vminq_f32(vmaxq_f32(rr, vzero), vmax));
+        vst1q_f32(g + i, vminq_f32(vmaxq_f32(gg, vzero), vmax));
+        vst1q_f32(b + i, vminq_f32(vmaxq_f32(bb, vzero), vmax));
+    }
+#endif
+    for (; i < n; i++) {
+        float yy = (ya[i] + (yb[i] - ya[i]) * fy) * ky - 16.0f * 1.164383f;
+        float uu = (uva[i * 2] + (uvb[i * 2] - uva[i * 2]) * fc) * kc - 128.0f;
+        float vv = (uva[i * 2 + 1] + (uvb[i * 2 + 1] - uva[i * 2 + 1]) * fc) * kc - 128.0f;
+        float rr = yy + 1.596027f * vv;
+        float gg = yy - 0.391762f * uu - 0.812968f * vv;
+        float bb = yy + 2.017232f * uu;
+        r[i] = rr < 0 ? 0 : (rr > 255.0f ? 255.0f : rr);
+        g[i] = gg < 0 ? 0 : (gg > 255.0f ? 255.0f : gg);
+        b[i] = bb < 0 ? 0 : (bb > 255.0f ? 255.0f : bb);
+    }
+}
+
+static void yuv_store_span(const yuv_convert_job_t* job, int y, int x, int n, const float* const* ch)
+{
+    size_t plane = (size_t)job->dst_w * job->dst_h;
+    size_t pix = (size_t)y * job->dst_w + x;
+    if (n <= 0) {
+        return;
+    }
+    for (int c = 0; c < 3; c++) {
+        const float* src = ch ? ch[c] : NULL;
+        float scale = job->scale[c];
+        float offset = job->offset[c];
+        float pad = job->pad[c];
+        size_t base = job->layout == IMAGE_TENSOR_LAYOUT_NCHW ? c * plane + pix : pix * 3 + c;
+        size_t step = job->layout == IMAGE_TENSOR_LAYOUT_NCHW ? 1 : 3;
+        if (job->type == IMAGE_TENSOR_TYPE_UINT8) {
+            unsigned char* out = (unsigned char*)job->dst + base;
+            if (src == NULL) {
+                for (int i = 0; i < n; i++) {
+                    out[i * step] = (unsigned char)pad;
+                }
+            } else {
+                for (int i = 0; i < n; i++) {
+                    out[i * step] = (unsigned char)(src[i] + 0.5f);
+                }
+            }
+        } else if (job->type == IMAGE_TENSOR_TYPE_FLOAT32) {
+            float* out = (float*)job->dst + base;
+            if (src == NULL) {
+                for (int i = 0; i < n; i++) {
+                    out[i * step] = pad;
+                }
+            } else {
+                for (int i = 0; i < n; i++) {
+                    out[i * step] = src[i] * scale + offset;
+                }
+            }
+        } else {
+            unsigned short* out = (unsigned short*)job->dst + base;
+            if (src == NULL) {
+                unsigned short pad_bits = float_to_half(pad);
+                for (int i = 0; i < n; i++) {
+                    out[i * step] = pad_bits;
+                }
+                continue;
+            }
+            // scaled in chunks and converted by the half_utils array backend
+            float values[YUV_HALF_CHUNK];
+            uint16_t bits[YUV_HALF_CHUNK];
+            for (int i0 = 0; i0 < n; i0 += YUV_HALF_CHUNK) {
+                int m = n - i0 < YUV_HALF_CHUNK ? n - i0 : YUV_HALF_CHUNK;
+                for (int i = 0; i < m; i++) {
+                    values[i] = src[i0 + i] * scale + offset;
+                }
+                if (step == 1) {
+                    float_to_half_array(values, out + i0, m);
+                    continue;
+                }
+                float_to_half_array(values, bits, m);
+                for (int i = 0; i < m; i++) {
+                    out[(i0 + i) * step] = bits[i];
+                }
+            }
+        }
+    }
+}
+
+#if defined(__ARM_NEON)
+// common case: uint8 NHWC, interleave 8 pixels per store
+static int yuv_store_u8_nhwc_neon(const yuv_convert_job_t* job, int y, const float* const* ch)
+{
+    unsigned char* out = (unsigned char*)job->dst + ((size_t)y * job->dst_w + job->box_x) * 3;
+    float32x4_t half = vdupq_n_f32(0.5f);
+    int i = 0;
+    for (; i + 8 <= job->box_w; i += 8) {
+        uint8x8x3_t px;
+        for (int c = 0; c < 3; c++) {
+            uint32x4_t lo = vcvtq_u32_f32(vaddq_f32(vld1q_f32(ch[c] + i), half));
+            uint32x4_t hi = vcvtq_u32_f32(vaddq_f32(vld1q_f32(ch[c] + i + 4), half));
+            px.val[c] = vmovn_u16(vcombine_u16(vmovn_u32(lo), vmovn_u32(hi)));
+        }
+        vst3_u8(out + i * 3, px);
+    }
+    return i;
+}
+#endif
+
+static void yuv_store_row(const yuv_convert_job_t* job, int y, const float* const* ch)
+{
+    if (ch == NULL) {
+        yuv_store_span(job, y, 0, job->dst_w, NULL);
+        return;
+    }
+    yuv_store_span(job, y, 0, job->box_x, NULL);
+    int done = 0;
+#if defined(__ARM_NEON)
+    if (job->type == IMAGE_TENSOR_TYPE_UINT8 && job->layout == IMAGE_TENSOR_LAYOUT_NHWC) {
+        done = yuv_store_u8_nhwc_neon(job, y, ch);
+    }
+#endif
+    const float* rest[3] = {ch[0] + done, ch[1] + done, ch[2] + done};
+    yuv_store_span(job, y, job->box_x + done, job->box_w - done, rest);
+    yuv_store_span(job, y, job->box_x + job->box_w, job->dst_w - job->box_x - job->box_w, NULL);
+}
+
+static void* yuv_convert_worker(void* arg)
+{
+    yuv_convert_task_t* task = (yuv_convert_task_t*)arg;
+    const yuv_convert_job_t* job = task->job;
+    int n = job->box_w;
+
+    short* row_buf = (short*)malloc(sizeof(short) * n * 6);
+    float* rgb_buf = (float*)malloc(sizeof(float) * n * 3);
+    if (row_buf == NULL || rgb_buf == NULL) {
+        printf("yuv convert malloc fail\n");
+        free(row_buf);
+        free(rgb_buf);
+        task->ret = -1;
+        return NULL;
+    }
+    yuv_row_cache_t luma = {{row_buf, row_buf + n}, {-1, -1}};
+    yuv_row_cache_t chroma = {{row_buf + n * 2, row_buf + n * 4}, {-1, -1}};
+
+    float* ch[3];
+    ch[0] = rgb_buf + (job->bgr ? 2 : 0) * n;
+    ch[1] = rgb_buf + n;
+    ch[2] = rgb_buf + (job->bgr ? 0 : 2) * n;
+
+    float ratio_y = (float)job->crop_h / job->box_h;
+    int chroma_h = (job->crop_h + 1) / 2;
+    for (int y = task->row_begin; y < task->row_end; y++) {
+        int dy = y - job->box_y;
+        if (dy < 0 || dy >= job->box_h) {
+            yuv_store_row(job, y, NULL);
+            continue;
+        }
+        float fy = (dy + 0.5f) * ratio_y - 0.5f;
+        if (fy < 0) {
+            fy = 0;
+        }
+        int y0 = (int)fy;
+        fy -= y0;
+        int y1 = y0 + 1;
+        if (y0 >= job->crop_h - 1) {
+            y0 = y1 = job->crop_h - 1;
+            fy = 0;
+        }
+        float fc = (dy + 0.5f) * ratio_y * 0.5f - 0.5f;
+        if (fc < 0) {
+            fc = 0;
+        }
+        int c0 = (int)fc;
+        fc -= c0;
+        int c1 = c0 + 1;
+        if (c0 >= chroma_h - 1) {
+            c0 = c1 = chroma_h - 1;
+            fc = 0;
+        }
+        y0 += job->crop_y;
+        y1 += job->crop_y;
+        c0 += job->crop_y / 2;
+        c1 += job->crop_y / 2;
+
+        const short* ya = yuv_fetch_row(job, &luma, y0, y1, 0);
+        const short* yb = yuv_fetch_row(job, &luma, y1, y0, 0);
+        const short* uva = yuv_fetch_row(job, &chroma, c0, c1, 1);
+        const short* uvb = yuv_fetch_row(job, &chroma, c1, c0, 1);
+
+        yuv_blend_to_rgb_row(ya, yb, fy, uva, uvb, fc, n, rgb_buf, rgb_buf + n, rgb_buf + n * 2);
+        yuv_store_row(job, y, (const float* const*)ch);
+    }
+
+    free(row_buf);
+    free(rgb_buf);
+    task->ret = 0;
+    return NULL;
+}
+
+static int run_yuv_convert_job(yuv_convert_job_t* job, int num_threads)
+{
+    int ret = 0;
+    if (job->crop_w < 2 || job->crop_h < 2 || job->box_w <= 0 || job->box_h <= 0) {
+        printf("yuv convert invalid size crop=%dx%d box=%dx%d\n", job->crop_w, job->crop_h, job->box_w, job->box_h);
+        return -1;
+    }
+
+    int n = job->box_w;
+    int* ofs = (int*)malloc(sizeof(int) * n * 4);
+    short* wt = (short*)malloc(sizeof(short) * n * 2);
+    if (ofs == NULL || wt == NULL) {
+        printf("yuv convert malloc fail\n");
+        free(ofs);
+        free(wt);
+        return -1;
+    }
+    job->x_ofs0 = ofs;
+    job->x_ofs1 = ofs + n;
+    job->cx_ofs0 = ofs + n * 2;
+    job->cx_ofs1 = ofs + n * 3;
+    job->x_wt = wt;
+    job->cx_wt = wt + n;
+
+    float ratio_x = (float)job->crop_w / job->box_w;
+    build_resize_table(n, job->crop_w, ratio_x, job->crop_x, job->x_ofs0, job->x_ofs1, job->x_wt);
+    build_resize_table(n, (job->crop_w + 1) / 2, ratio_x * 0.5f, job->crop_x / 2, job->cx_ofs0, job->cx_ofs1, job->cx_wt);
+
+    if (num_threads <= 0) {
+        long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        num_threads = ncpu > 0 ? (int)ncpu : 1;
+        if (num_threads > job->dst_h / 64) {
+            num_threads = job->dst_h / 64;
+        }
+    }
+    if (num_threads > YUV_MAX_THREADS) {
+        num_threads = YUV_MAX_THREADS;
+    }
+    if (num_threads < 1) {
+        num_threads = 1;
+    }
+
+    yuv_convert_task_t tasks[YUV_MAX_THREADS];
+    pthread_t threads[YUV_MAX_THREADS];
+    int started[YUV_MAX_THREADS] = {0};
+    int rows = (job->dst_h + num_threads - 1) / num_threads;
+    for (int t = 0; t < num_threads; t++) {
+        tasks[t].job = job;
+        tasks[t].row_begin = t * rows;
+        tasks[t].row_end = (t + 1) * rows < job->dst_h ? (t + 1) * rows : job->dst_h;
+        tasks[t].ret = 0;
+        if (t > 0 && pthread_create(&threads[t], NULL, yuv_convert_worker, &tasks[t]) == 0) {
+            started[t] = 1;
+        }
+    }
+    // calling thread takes the first band and any band whose thread failed to start
+    for (int t = 0; t < num_threads; t++) {
+        if (!started[t]) {
+            yuv_convert_worker(&tasks[t]);
+        }
+    }
+    for (int t = 0; t < num_threads; t++) {
+        if (started[t]) {
+            pthread_join(threads[t], NULL);
+        }
+        if (tasks[t].ret != 0) {
+            ret = -1;
+        }
+    }
+
+    free(ofs);
+    free(wt);
+    return ret;
+}
+
+static int init_yuv_convert_job(yuv_convert_job_t* job, image_buffer_t* src, image_rect_t* src_box)
+{
+    memset(job, 0, sizeof(*job));
+    if (src->format != IMAGE_FORMAT_YUV420SP_NV12 && src->format != IMAGE_FORMAT_YUV420SP_NV21) {
+        printf("yuv convert no support format %d\n", src->format);
+        return -1;
+    }
+    int stride = src->width_stride > src->width ? src->width_stride : src->width;
+    int rows = src->height_stride > src->height ? src->height_stride : src->height;
+    job->y_plane = src->virt_addr;
+    job->uv_plane = src->virt_addr + (size_t)stride * rows;
+    job->stride = stride;
+    job->uv_swap = src->format == IMAGE_FORMAT_YUV420SP_NV21;
+
+    job->crop_x = 0;
+    job->crop_y = 0;
+    job->crop_w = src->width;
+    job->crop_h = src->height;
+    if (src_box != NULL) {
+        // keep crop aligned to the chroma grid
+        job->crop_x = src_box->left & ~1;
+        job->crop_y = src_box->top & ~1;
+        job->crop_w = src_box->right - job->crop_x + 1;
+        job->crop_h = src_box->bottom - job->crop_y + 1;
+    }
+    for (int c = 0; c < 3; c++) {
+        job->scale[c] = 1.0f;
+        job->offset[c] = 0.0f;
+    }
+    return 0;
+}
+
+static int convert_image_yuv420sp_to_rgb_cpu(image_buffer_t* src, image_buffer_t* dst, image_rect_t* src_box,
+                                             image_rect_t* dst_box, char color)
+{
+    yuv_convert_job_t job;
+    if (init_yuv_convert_job(&job, src, src_box) != 0) {
+        return -1;
+    }
+    job.dst = dst->virt_addr;
+    job.dst_w = dst->width;
+    job.dst_h = dst->height;
+    job.box_x = 0;
+    job.box_y = 0;
+    job.box_w = dst->width;
+    job.box_h = dst->height;
+    if (dst_box != NULL) {
+        job.box_x = dst_box->left;
+        job.box_y = dst_box->top;
+        job.box_w = dst_box->right - dst_box->left + 1;
+        job.box_h = dst_box->bottom - dst_box->top + 1;
+    }
+    job.layout = IMAGE_TENSOR_LAYOUT_NHWC;
+    job.type = IMAGE_TENSOR_TYPE_UINT8;
+    job.bgr = 0;
+    for (int c = 0; c < 3; c++) {
+        job.pad[c] = (float)(unsigned char)color;
+    }
+    return run_yuv_convert_job(&job, 0);
+}
+
 static int convert_image_cpu(image_buffer_t *src, image_buffer_t *dst, image_rect_t *src_box, image_rect_t *dst_box, char color) {
     int ret;
     if (dst->virt_addr == NULL) {
@@ -394,7 +1050,9 @@ static int convert_image_cpu(image_buffer_t *src, image_buffer_t *dst, image_rec
     if (src->virt_addr == NULL) {
         return -1;
     }
-    if (src->format != dst->format) {
+    if (src->format != dst->format &&
+        !((src->format == IMAGE_FORMAT_YUV420SP_NV12 || src->format == IMAGE_FORMAT_YUV420SP_NV21) &&
+          dst->format == IMAGE_FORMAT_RGB888)) {
         return -1;
     }
 
@@ -419,6 +1077,12 @@ static int convert_image_cpu(image_buffer_t *src, image_buffer_t *dst, image_rec
         dst_box_h = dst_box->bottom - dst_box->top + 1;
     }
 
+    // yuv420sp -> rgb888 is fused (color convert, resize and padding in one pass)
+    if ((src->format == IMAGE_FORMAT_YUV420SP_NV12 || src->format == IMAGE_FORMAT_YUV420SP_NV21) &&
+        dst->format == IMAGE_FORMAT_RGB888) {
+        return convert_image_yuv420sp_to_rgb_cpu(src, dst, src_box, dst_box, color);
+    }
+
     // fill pad color
     if (dst_box_w != dst->width || dst_box_h != dst->height) {
         int dst_size = get_image_size(dst);
@@ -454,7 +1118,7 @@ static int convert_image_cpu(image_buffer_t *src, image_buffer_t *dst, image_rec
         printf("convert_image_cpu fail %d\n", reti);
         return -1;
     }
-    printf("finish\n");
+    TRACE_LOG("finish\n");
     return 0;
 }
 
@@ -636,7 +1300,7 @@ static int convert_image_rga(image_buffer_t* src_img, image_buffer_t* dst_img, i
         p_imcolor[1] = color;
         p_imcolor[2] = color;
         p_imcolor[3] = color;
-        printf("fill dst image (x y w h)=(%d %d %d %d) with color=0x%x\n",
+        TRACE_LOG("fill dst image (x y w h)=(%d %d %d %d) with color=0x%x\n",
             dst_whole_rect.x, dst_whole_rect.y, dst_whole_rect.width, dst_whole_rect.height, imcolor);
         ret_rga = imfill(rga_buf_dst, dst_whole_rect, imcolor);
         if (ret_rga <= 0) {
@@ -673,8 +1337,9 @@ err:
 int convert_image(image_buffer_t* src_img, image_buffer_t* dst_img, image_rect_t* src_box, image_rect_t* dst_box, char color)
 {
     int ret;
+    uint64_t begin = TRACE_BEGIN();
 #if defined(DISABLE_RGA) 
-    printf("convert image use cpu\n");
+    TRACE_LOG("convert image use cpu\n");
     ret = convert_image_cpu(src_img, dst_img, src_box, dst_box, color);
 #else
 
@@ -689,21 +1354,17 @@ int convert_image(image_buffer_t* src_img, image_buffer_t* dst_img, image_rect_t
             ret = convert_image_cpu(src_img, dst_img, src_box, dst_box, color);
         }
     } else {
-        printf("src width is not 4/16-aligned, convert image use cpu\n");
+        TRACE_LOG("src width is not 4/16-aligned, convert image use cpu\n");
         ret = convert_image_cpu(src_img, dst_img, src_box, dst_box, color);
     }
 #endif
+    TRACE_END(TRACE_STAGE_PREPROCESS, "convert_image", begin);
     return ret;
 }
 
-int convert_image_with_letterbox(image_buffer_t* src_image, image_buffer_t* dst_image, letterbox_t* letterbox, char color)
+static float compute_letterbox(int src_w, int src_h, int dst_w, int dst_h, image_rect_t* dst_box, letterbox_t* letterbox)
 {
-    int ret = 0;
     int allow_slight_change = 1;
-    int src_w = src_image->width;
-    int src_h = src_image->height;
-    int dst_w = dst_image->width;
-    int dst_h = dst_image->height;
     int resize_w = dst_w;
     int resize_h = dst_h;
 
@@ -714,17 +1375,10 @@ int convert_image_with_letterbox(image_buffer_t* src_image, image_buffer_t* dst_
     int _top_offset = 0;
     float scale = 1.0;
 
-    image_rect_t src_box;
-    src_box.left = 0;
-    src_box.top = 0;
-    src_box.right = src_image->width - 1;
-    src_box.bottom = src_image->height - 1;
-
-    image_rect_t dst_box;
-    dst_box.left = 0;
-    dst_box.top = 0;
-    dst_box.right = dst_image->width - 1;
-    dst_box.bottom = dst_image->height - 1;
+    dst_box->left = 0;
+    dst_box->top = 0;
+    dst_box->right = dst_w - 1;
+    dst_box->bottom = dst_h - 1;
 
     float _scale_w = (float)dst_w / src_w;
     float _scale_h = (float)dst_h / src_h;
@@ -747,28 +1401,28 @@ int convert_image_with_letterbox(image_buffer_t* src_image, image_buffer_t* dst_
     padding_w = dst_w - resize_w;
     // center
     if (_scale_w < _scale_h) {
-        dst_box.top = padding_h / 2;
-        if (dst_box.top % 2 != 0) {
-            dst_box.top -= dst_box.top % 2;
-            if (dst_box.top < 0) {
-                dst_box.top = 0;
+        dst_box->top = padding_h / 2;
+        if (dst_box->top % 2 != 0) {
+            dst_box->top -= dst_box->top % 2;
+            if (dst_box->top < 0) {
+                dst_box->top = 0;
             }
         }
-        dst_box.bottom = dst_box.top + resize_h - 1;
-        _top_offset = dst_box.top;
+        dst_box->bottom = dst_box->top + resize_h - 1;
+        _top_offset = dst_box->top;
     } else {
-        dst_box.left = padding_w / 2;
-        if (dst_box.left % 2 != 0) {
-            dst_box.left -= dst_box.left % 2;
-            if (dst_box.left < 0) {
-                dst_box.left = 0;
+        dst_box->left = padding_w / 2;
+        if (dst_box->left % 2 != 0) {
+            dst_box->left -= dst_box->left % 2;
+            if (dst_box->left < 0) {
+                dst_box->left = 0;
             }
         }
-        dst_box.right = dst_box.left + resize_w - 1;
-        _left_offset = dst_box.left;
+        dst_box->right = dst_box->left + resize_w - 1;
+        _left_offset = dst_box->left;
     }
-    printf("scale=%f dst_box=(%d %d %d %d) allow_slight_change=%d _left_offset=%d _top_offset=%d padding_w=%d padding_h=%d\n",
-        scale, dst_box.left, dst_box.top, dst_box.right, dst_box.bottom, allow_slight_change,
+    TRACE_LOG("scale=%f dst_box=(%d %d %d %d) allow_slight_change=%d _left_offset=%d _top_offset=%d padding_w=%d padding_h=%d\n",
+        scale, dst_box->left, dst_box->top, dst_box->right, dst_box->bottom, allow_slight_change,
         _left_offset, _top_offset, padding_w, padding_h);
 
     //set offset and scale
@@ -777,6 +1431,22 @@ int convert_image_with_letterbox(image_buffer_t* src_image, image_buffer_t* dst_
         letterbox->x_pad = _left_offset;
         letterbox->y_pad = _top_offset;
     }
+    return scale;
+}
+
+int convert_image_with_letterbox(image_buffer_t* src_image, image_buffer_t* dst_image, letterbox_t* letterbox, char color)
+{
+    int ret = 0;
+
+    image_rect_t src_box;
+    src_box.left = 0;
+    src_box.top = 0;
+    src_box.right = src_image->width - 1;
+    src_box.bottom = src_image->height - 1;
+
+    image_rect_t dst_box;
+    compute_letterbox(src_image->width, src_image->height, dst_image->width, dst_image->height, &dst_box, letterbox);
+
     // alloc memory buffer for dst image,
     // remember to free
     if (dst_image->virt_addr == NULL && dst_image->fd <= 0) {
@@ -789,4 +1459,46 @@ int convert_image_with_letterbox(image_buffer_t* src_image, image_buffer_t* dst_
     }
     ret = convert_image(src_image, dst_image, &src_box, &dst_box, color);
     return ret;
-}
\ No newline at end of file
+}
+
+int convert_yuv420sp_to_tensor(image_buffer_t* src_image, void* dst, const image_tensor_param_t* param,
+                               letterbox_t* letterbox, char color)
+{
+    if (src_image == NULL || src_image->virt_addr == NULL || dst == NULL || param == NULL) {
+        return -1;
+    }
+
+    uint64_t begin = TRACE_BEGIN();
+    yuv_convert_job_t job;
+    if (init_yuv_convert_job(&job, src_image, NULL) != 0) {
+        return -1;
+    }
+
+    image_rect_t dst_box;
+    compute_letterbox(src_image->width, src_image->height, param->width, param->height, &dst_box, letterbox);
+
+    job.dst = dst;
+    job.dst_w = param->width;
+    job.dst_h = param->height;
+    job.box_x = dst_box.left;
+    job.box_y = dst_box.top;
+    job.box_w = dst_box.right - dst_box.left + 1;
+    job.box_h = dst_box.bottom - dst_box.top + 1;
+    job.layout = param->layout;
+    job.type = param->type;
+    job.bgr = param->bgr;
+    for (int c = 0; c < 3; c++) {
+        if (param->type == IMAGE_TENSOR_TYPE_UINT8) {
+            job.scale[c] = 1.0f;
+            job.offset[c] = 0.0f;
+        } else {
+            float std = param->std[c] != 0.0f ? param->std[c] : 1.0f;
+            job.scale[c] = 1.0f / std;
+            job.offset[c] = -param->mean[c] / std;
+        }
+        job.pad[c] = (unsigned char)color * job.scale[c] + job.offset[c];
+    }
+    int ret = run_yuv_convert_job(&job, param->num_threads);
+    TRACE_END(TRACE_STAGE_PREPROCESS, "convert_yuv420sp_to_tensor", begin);
+    return ret;
+}
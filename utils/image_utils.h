@@ -17,6 +17,52 @@ typedef struct {
     float scale;
 } letterbox_t;
 
+/**
+ * @brief Size of the image file before reduced-resolution decoding
+ * 
+ * The decoded image is orig / scale_denom in each dimension, rounded up, so a
+ * coordinate x on it is x * orig_width / image.width on the original image.
+ */
+typedef struct {
+    int orig_width;
+    int orig_height;
+    int scale_denom;    // 1, 2, 4 or 8; 1: decoded at full size
+} image_decode_info_t;
+
+/**
+ * @brief Tensor layout for convert_yuv420sp_to_tensor
+ * 
+ */
+typedef enum {
+    IMAGE_TENSOR_LAYOUT_NHWC,
+    IMAGE_TENSOR_LAYOUT_NCHW,
+} image_tensor_layout_t;
+
+/**
+ * @brief Tensor data type for convert_yuv420sp_to_tensor
+ * 
+ */
+typedef enum {
+    IMAGE_TENSOR_TYPE_UINT8,
+    IMAGE_TENSOR_TYPE_FLOAT32,
+    IMAGE_TENSOR_TYPE_FLOAT16,
+} image_tensor_type_t;
+
+/**
+ * @brief Model input tensor description for convert_yuv420sp_to_tensor
+ * 
+ */
+typedef struct {
+    int width;
+    int height;
+    image_tensor_layout_t layout;
+    image_tensor_type_t type;
+    int bgr;            // 0: RGB channel order; 1: BGR channel order
+    float mean[3];      // only used by float types, in output channel order
+    float std[3];       // only used by float types, 0 means 1.0
+    int num_threads;    // <= 0: decided by image size and cpu count
+} image_tensor_param_t;
+
 /**
  * @brief Read image file (support png/jpeg/bmp)
  * 
@@ -26,6 +72,32 @@ typedef struct {
  */
 int read_image(const char* path, image_buffer_t* image);
 
+/**
+ * @brief Read image file at the smallest resolution that still covers the model input
+ * 
+ * JPEG files are mmap'ed and decoded with libjpeg-turbo DCT scaling (1/2, 1/4, 1/8)
+ * chosen from the letterbox size, other formats fall back to read_image.
+ * 
+ * @param path [in] Image path
+ * @param model_width [in] Model input width
+ * @param model_height [in] Model input height
+ * @param image [out] Read image, if image->virt_addr is set the image is decoded into it
+ *                    (image->size is the buffer capacity, 0 means unchecked)
+ * @param info [out] Original size and scale of the decode, to map results back; can be NULL
+ * @return int 0: success; -1: error
+ */
+int read_image_for_model(const char* path, int model_width, int model_height, image_buffer_t* image,
+                         image_decode_info_t* info);
+
+/**
+ * @brief List image files (jpg/jpeg/png/data) from a directory or a text file with one path per line
+ *
+ * @param path [in] Directory or list file
+ * @param count [out] File count
+ * @return char** Path array, remember call free_lines() to release after used
+ */
+char** list_image_files(const char* path, int* count);
+
 /**
  * @brief Write image file (support jpg/png)
  * 
@@ -58,6 +130,22 @@ int convert_image(image_buffer_t* src_image, image_buffer_t* dst_image, image_re
  */
 int convert_image_with_letterbox(image_buffer_t* src_image, image_buffer_t* dst_image, letterbox_t* letterbox, char color);
 
+/**
+ * @brief Convert NV12/NV21 image to letterboxed model input tensor in one pass (cpu)
+ * 
+ * Color conversion (BT.601), bilinear resize, padding, normalization and
+ * layout transform are fused, so the source frame is read only once.
+ * 
+ * @param src_image [in] Source Image (IMAGE_FORMAT_YUV420SP_NV12/IMAGE_FORMAT_YUV420SP_NV21)
+ * @param dst [out] Tensor buffer, width * height * 3 elements of param->type
+ * @param param [in] Tensor description
+ * @param letterbox [out] Letterbox, can be NULL
+ * @param color [in] Fill color before normalization
+ * @return int 0: success; -1: error
+ */
+int convert_yuv420sp_to_tensor(image_buffer_t* src_image, void* dst, const image_tensor_param_t* param,
+                               letterbox_t* letterbox, char color);
+
 /**
  * @brief Get the image size
  * 
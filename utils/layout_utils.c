@@ -0,0 +1,402 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "layout_utils.h"
+
+#define LAYOUT_MAX_THREADS 8
+// below this a thread costs more to start than it saves
+#define LAYOUT_THREAD_BYTES (256 * 1024)
+// transposes run on TILE x TILE elements so both sides stay in L1
+#define LAYOUT_TILE 32
+
+/**
+ * Every supported layout is a blocked channel layout, element (n, c, h, w) is at
+ *   n * image_stride + (c / block) * block_stride + h * row_stride + w * block + c % block
+ * with block 1 for NCHW, c_stride for NHWC and c2 for NC1HWC2.
+ */
+typedef struct {
+    int block;
+    size_t block_stride;
+    size_t row_stride;
+    size_t image_stride;
+    int dense_rows;     // no row padding, the rows of a plane are one run of pixels
+} layout_addr_t;
+
+typedef struct {
+    const uint8_t* src;
+    uint8_t* dst;
+    layout_addr_t s;
+    layout_addr_t d;
+    int elem_size;
+    int c;
+    int rows;           // rows per image, 1 when the rows are merged
+    int pixels;         // pixels per row
+    int chunk;          // pixels per work unit
+    int chunks_per_row;
+} layout_job_t;
+
+typedef struct {
+    const layout_job_t* job;
+    size_t unit_begin;
+    size_t unit_end;
+} layout_task_t;
+
+#if defined(__ARM_NEON)
+static inline void transpose_8x8_u8(const uint8_t* src, size_t ss, uint8_t* dst, size_t ds)
+{
+    uint8x8x2_t t01 = vtrn_u8(vld1_u8(src), vld1_u8(src + ss));
+    uint8x8x2_t t23 = vtrn_u8(vld1_u8(src + 2 * ss), vld1_u8(src + 3 * ss));
+    uint8x8x2_t t45 = vtrn_u8(vld1_u8(src + 4 * ss), vld1_u8(src + 5 * ss));
+    uint8x8x2_t t67 = vtrn_u8(vld1_u8(src + 6 * ss), vld1_u8(src + 7 * ss));
+
+    uint16x4x2_t u02 = vtrn_u16(vreinterpret_u16_u8(t01.val[0]), vreinterpret_u16_u8(t23.val[0]));
+    uint16x4x2_t u13 = vtrn_u16(vreinterpret_u16_u8(t01.val[1]), vreinterpret_u16_u8(t23.val[1]));
+    uint16x4x2_t v02 = vtrn_u16(vreinterpret_u16_u8(t45.val[0]), vreinterpret_u16_u8(t67.val[0]));
+    uint16x4x2_t v13 = vtrn_u16(vreinterpret_u16_u8(t45.val[1]), vreinterpret_u16_u8(t67.val[1]));
+
+    uint32x2x2_t w0 = vtrn_u32(vreinterpret_u32_u16(u02.val[0]), vreinterpret_u32_u16(v02.val[0]));
+    uint32x2x2_t w1 = vtrn_u32(vreinterpret_u32_u16(u13.val[0]), vreinterpret_u32_u16(v13.val[0]));
+    uint32x2x2_t w2 = vtrn_u32(vreinterpret_u32_u16(u02.val[1]), vreinterpret_u32_u16(v02.val[1]));
+    uint32x2x2_t w3 = vtrn_u32(vreinterpret_u32_u16(u13.val[1]), vreinterpret_u32_u16(v13.val[1]));
+
+    vst1_u8(dst, vreinterpret_u8_u32(w0.val[0]));
+    vst1_u8(dst + ds, vreinterpret_u8_u32(w1.val[0]));
+    vst1_u8(dst + 2 * ds, vreinterpret_u8_u32(w2.val[0]));
+    vst1_u8(dst + 3 * ds, vreinterpret_u8_u32(w3.val[0]));
+    vst1_u8(dst + 4 * ds, vreinterpret_u8_u32(w0.val[1]));
+    vst1_u8(dst + 5 * ds, vreinterpret_u8_u32(w1.val[1]));
+    vst1_u8(dst + 6 * ds, vreinterpret_u8_u32(w2.val[1]));
+    vst1_u8(dst + 7 * ds, vreinterpret_u8_u32(w3.val[1]));
+}
+
+static inline void transpose_8x8_u16(const uint16_t* src, size_t ss, uint16_t* dst, size_t ds)
+{
+    uint16x8x2_t t01 = vtrnq_u16(vld1q_u16(src), vld1q_u16(src + ss));
+    uint16x8x2_t t23 = vtrnq_u16(vld1q_u16(src + 2 * ss), vld1q_u16(src + 3 * ss));
+    uint16x8x2_t t45 = vtrnq_u16(vld1q_u16(src + 4 * ss), vld1q_u16(src + 5 * ss));
+    uint16x8x2_t t67 = vtrnq_u16(vld1q_u16(src + 6 * ss), vld1q_u16(src + 7 * ss));
+
+    uint32x4x2_t u02 = vtrnq_u32(vreinterpretq_u32_u16(t01.val[0]), vreinterpretq_u32_u16(t23.val[0]));
+    uint32x4x2_t u13 = vtrnq_u32(vreinterpretq_u32_u16(t01.val[1]), vreinterpretq_u32_u16(t23.val[1]));
+    uint32x4x2_t v02 = vtrnq_u32(vreinterpretq_u32_u16(t45.val[0]), vreinterpretq_u32_u16(t67.val[0]));
+    uint32x4x2_t v13 = vtrnq_u32(vreinterpretq_u32_u16(t45.val[1]), vreinterpretq_u32_u16(t67.val[1]));
+
+    vst1q_u16(dst, vreinterpretq_u16_u32(vcombine_u32(vget_low_u32(u02.val[0]), vget_low_u32(v02.val[0]))));
+    vst1q_u16(dst + ds, vreinterpretq_u16_u32(vcombine_u32(vget_low_u32(u13.val[0]), vget_low_u32(v13.val[0]))));
+    vst1q_u16(dst + 2 * ds, vreinterpretq_u16_u32(vcombine_u32(vget_low_u32(u02.val[1]), vget_low_u32(v02.val[1]))));
+    vst1q_u16(dst + 3 * ds, vreinterpretq_u16_u32(vcombine_u32(vget_low_u32(u13.val[1]), vget_low_u32(v13.val[1]))));
+    vst1q_u16(dst + 4 * ds, vreinterpretq_u16_u32(vcombine_u32(vget_high_u32(u02.val[0]), vget_high_u32(v02.val[0]))));
+    vst1q_u16(dst + 5 * ds, vreinterpretq_u16_u32(vcombine_u32(vget_high_u32(u13.val[0]), vget_high_u32(v13.val[0]))));
+    vst1q_u16(dst + 6 * ds, vreinterpretq_u16_u32(vcombine_u32(vget_high_u32(u02.val[1]), vget_high_u32(v02.val[1]))));
+    vst1q_u16(dst + 7 * ds, vreinterpretq_u16_u32(vcombine_u32(vget_high_u32(u13.val[1]), vget_high_u32(v13.val[1]))));
+}
+
+static inline void transpose_4x4_u32(const uint32_t* src, size_t ss, uint32_t* dst, size_t ds)
+{
+    uint32x4x2_t t01 = vtrnq_u32(vld1q_u32(src), vld1q_u32(src + ss));
+    uint32x4x2_t t23 = vtrnq_u32(vld1q_u32(src + 2 * ss), vld1q_u32(src + 3 * ss));
+
+    vst1q_u32(dst, vcombine_u32(vget_low_u32(t01.val[0]), vget_low_u32(t23.val[0])));
+    vst1q_u32(dst + ds, vcombine_u32(vget_low_u32(t01.val[1]), vget_low_u32(t23.val[1])));
+    vst1q_u32(dst + 2 * ds, vcombine_u32(vget_high_u32(t01.val[0]), vget_high_u32(t23.val[0])));
+    vst1q_u32(dst + 3 * ds, vcombine_u32(vget_high_u32(t01.val[1]), vget_high_u32(t23.val[1])));
+}
+#else
+#define DEFINE_TRANSPOSE_TILE(name, type, M)                                          \
+    static inline void name(const type* src, size_t ss, type* dst, size_t ds)         \
+    {                                                                                 \
+        for (int j = 0; j < M; j++) {                                                 \
+            for (int i = 0; i < M; i++) {                                             \
+                dst[j * ds + i] = src[i * ss + j];                                    \
+            }                                                                         \
+        }                                                                             \
+    }
+
+DEFINE_TRANSPOSE_TILE(transpose_8x8_u8, uint8_t, 8)
+DEFINE_TRANSPOSE_TILE(transpose_8x8_u16, uint16_t, 8)
+DEFINE_TRANSPOSE_TILE(transpose_4x4_u32, uint32_t, 4)
+#endif
+
+// dst[j * ds + i] = src[i * ss + j] for a rows x cols matrix, strides in elements,
+// tiles walk the destination rows in order
+#define DEFINE_TRANSPOSE(name, type, M, tile)                                         \
+    static void name(const type* src, size_t ss, type* dst, size_t ds, int rows, int cols) \
+    {                                                                                 \
+        for (int j0 = 0; j0 < cols; j0 += LAYOUT_TILE) {                              \
+            int j1 = j0 + LAYOUT_TILE < cols ? j0 + LAYOUT_TILE : cols;               \
+            for (int i0 = 0; i0 < rows; i0 += LAYOUT_TILE) {                          \
+                int i1 = i0 + LAYOUT_TILE < rows ? i0 + LAYOUT_TILE : rows;           \
+                int i = i0;                                                           \
+                for (; i + M <= i1; i += M) {                                         \
+                    int j = j0;                                                       \
+                    for (; j + M <= j1; j += M) {                                     \
+                        tile(src + i * ss + j, ss, dst + j * ds + i, ds);             \
+                    }                                                                 \
+                    for (; j < j1; j++) {                                             \
+                        for (int k = 0; k < M; k++) {                                 \
+                            dst[j * ds + i + k] = src[(i + k) * ss + j];              \
+                        }                                                             \
+                    }                                                                 \
+                }                                                                     \
+                for (int j = j0; i < i1 && j < j1; j++) {                             \
+                    for (int k = i; k < i1; k++) {                                    \
+                        dst[j * ds + k] = src[k * ss + j];                            \
+                    }                                                                 \
+                }                                                                     \
+            }                                                                         \
+        }                                                                             \
+    }
+
+DEFINE_TRANSPOSE(transpose_u8, uint8_t, 8, transpose_8x8_u8)
+DEFINE_TRANSPOSE(transpose_u16, uint16_t, 8, transpose_8x8_u16)
+DEFINE_TRANSPOSE(transpose_u32, uint32_t, 4, transpose_4x4_u32)
+
+static void transpose(const uint8_t* src, size_t ss, uint8_t* dst, size_t ds, int rows, int cols, int elem_size)
+{
+    switch (elem_size) {
+    case 1:
+        transpose_u8(src, ss, dst, ds, rows, cols);
+        break;
+    case 2:
+        transpose_u16((const uint16_t*)src, ss, (uint16_t*)dst, ds, rows, cols);
+        break;
+    default:
+        transpose_u32((const uint32_t*)src, ss, (uint32_t*)dst, ds, rows, cols);
+        break;
+    }
+}
+
+/**
+ * Copy L channels x P pixels where both sides are affine: element (l, p) is at
+ * l * cs + p * ps. A side in a channel block has cs 1, a channel plane has ps 1.
+ */
+static void copy_channels(const uint8_t* src, size_t s_cs, size_t s_ps,
+                          uint8_t* dst, size_t d_cs, size_t d_ps,
+                          int L, int P, int elem_size)
+{
+    if (s_ps == 1 && d_ps == 1) {
+        for (int l = 0; l < L; l++) {
+            memcpy(dst + l * d_cs * elem_size, src + l * s_cs * elem_size, (size_t)P * elem_size);
+        }
+    } else if (s_cs == 1 && d_cs == 1) {
+        if (s_ps == (size_t)L && d_ps == (size_t)L) {
+            memcpy(dst, src, (size_t)L * P * elem_size);
+            return;
+        }
+        for (int p = 0; p < P; p++) {
+            memcpy(dst + p * d_ps * elem_size, src + p * s_ps * elem_size, (size_t)L * elem_size);
+        }
+    } else if (s_ps == 1) {
+        // channel planes to pixels
+        transpose(src, s_cs, dst, d_ps, L, P, elem_size);
+    } else {
+        // pixels to channel planes
+        transpose(src, s_ps, dst, d_cs, P, L, elem_size);
+    }
+}
+
+static inline size_t element_offset(const layout_addr_t* a, int n, int c, int h, int p)
+{
+    return n * a->image_stride + (size_t)(c / a->block) * a->block_stride + h * a->row_stride +
+           (size_t)p * a->block + c % a->block;
+}
+
+static void convert_unit(const layout_job_t* job, size_t unit)
+{
+    const layout_addr_t* s = &job->s;
+    const layout_addr_t* d = &job->d;
+    int esz = job->elem_size;
+    int k = unit % job->chunks_per_row;
+    int h = (unit / job->chunks_per_row) % job->rows;
+    int n = unit / job->chunks_per_row / job->rows;
+    int p0 = k * job->chunk;
+    int P = job->pixels - p0 < job->chunk ? job->pixels - p0 : job->chunk;
+
+    // channels where neither side crosses a block boundary
+    for (int c = 0, end; c < job->c; c = end) {
+        end = job->c;
+        if (s->block > 1 && (c / s->block + 1) * s->block < end) {
+            end = (c / s->block + 1) * s->block;
+        }
+        if (d->block > 1 && (c / d->block + 1) * d->block < end) {
+            end = (c / d->block + 1) * d->block;
+        }
+        copy_channels(job->src + element_offset(s, n, c, h, p0) * esz, s->block > 1 ? 1 : s->block_stride, s->block,
+                      job->dst + element_offset(d, n, c, h, p0) * esz, d->block > 1 ? 1 : d->block_stride, d->block,
+                      end - c, P, esz);
+    }
+
+    int pad = d->block > 1 ? (d->block - job->c % d->block) % d->block : 0;
+    if (pad > 0) {
+        uint8_t* lanes = job->dst + element_offset(d, n, job->c, h, p0) * esz;
+        for (int p = 0; p < P; p++) {
+            memset(lanes + (size_t)p * d->block * esz, 0, (size_t)pad * esz);
+        }
+    }
+}
+
+static void* convert_layout_worker(void* arg)
+{
+    layout_task_t* task = (layout_task_t*)arg;
+    for (size_t u = task->unit_begin; u < task->unit_end; u++) {
+        convert_unit(task->job, u);
+    }
+    return NULL;
+}
+
+static int init_layout_addr(const tensor_layout_desc_t* desc, layout_addr_t* addr)
+{
+    int w_stride = desc->w_stride > 0 ? desc->w_stride : desc->w;
+    int h_stride = desc->h_stride > 0 ? desc->h_stride : desc->h;
+    if (desc->n <= 0 || desc->c <= 0 || desc->h <= 0 || desc->w <= 0 || w_stride < desc->w || h_stride < desc->h) {
+        printf("layout invalid shape n=%d c=%d h=%d w=%d stride h=%d w=%d\n",
+               desc->n, desc->c, desc->h, desc->w, h_stride, w_stride);
+        return -1;
+    }
+    addr->dense_rows = w_stride == desc->w;
+
+    switch (desc->layout) {
+    case TENSOR_LAYOUT_NCHW:
+        addr->block = 1;
+        addr->row_stride = w_stride;
+        addr->block_stride = (size_t)h_stride * w_stride;
+        addr->image_stride = desc->c * addr->block_stride;
+        break;
+    case TENSOR_LAYOUT_NHWC: {
+        int c_stride = desc->c_stride > 0 ? desc->c_stride : desc->c;
+        if (c_stride < desc->c) {
+            printf("layout invalid c_stride %d < c %d\n", c_stride, desc->c);
+            return -1;
+        }
+        addr->block = c_stride;
+        addr->row_stride = (size_t)w_stride * c_stride;
+        addr->block_stride = 0;
+        addr->image_stride = h_stride * addr->row_stride;
+        break;
+    }
+    case TENSOR_LAYOUT_NC1HWC2:
+        if (desc->c2 <= 0) {
+            printf("layout invalid c2 %d\n", desc->c2);
+            return -1;
+        }
+        addr->block = desc->c2;
+        addr->row_stride = (size_t)w_stride * desc->c2;
+        addr->block_stride = h_stride * addr->row_stride;
+        addr->image_stride = (size_t)((desc->c + desc->c2 - 1) / desc->c2) * addr->block_stride;
+        break;
+    default:
+        printf("layout no support %d\n", desc->layout);
+        return -1;
+    }
+    return 0;
+}
+
+void init_layout_desc(tensor_layout_desc_t* desc, tensor_layout_t layout, int n, int c, int h, int w, int c2)
+{
+    memset(desc, 0, sizeof(tensor_layout_desc_t));
+    desc->layout = layout;
+    desc->n = n;
+    desc->c = c;
+    desc->h = h;
+    desc->w = w;
+    desc->c2 = c2;
+}
+
+int convert_layout(const void* src, const tensor_layout_desc_t* src_desc,
+                   void* dst, const tensor_layout_desc_t* dst_desc,
+                   int elem_size, int num_threads)
+{
+    if (src == NULL || dst == NULL) {
+        printf("convert_layout null buffer\n");
+        return -1;
+    }
+    if (elem_size != 1 && elem_size != 2 && elem_size != 4) {
+        printf("convert_layout no support elem_size %d\n", elem_size);
+        return -1;
+    }
+    if (src_desc->n != dst_desc->n || src_desc->c != dst_desc->c ||
+        src_desc->h != dst_desc->h || src_desc->w != dst_desc->w) {
+        printf("convert_layout shape mismatch src=%dx%dx%dx%d dst=%dx%dx%dx%d\n",
+               src_desc->n, src_desc->c, src_desc->h, src_desc->w,
+               dst_desc->n, dst_desc->c, dst_desc->h, dst_desc->w);
+        return -1;
+    }
+
+    layout_job_t job;
+    memset(&job, 0, sizeof(job));
+    if (init_layout_addr(src_desc, &job.s) != 0 || init_layout_addr(dst_desc, &job.d) != 0) {
+        return -1;
+    }
+    job.src = (const uint8_t*)src;
+    job.dst = (uint8_t*)dst;
+    job.elem_size = elem_size;
+    job.c = src_desc->c;
+    if (job.s.dense_rows && job.d.dense_rows) {
+        // one long row per plane, transposes get full tiles even for narrow tensors
+        job.rows = 1;
+        job.pixels = src_desc->h * src_desc->w;
+    } else {
+        job.rows = src_desc->h;
+        job.pixels = src_desc->w;
+    }
+
+    size_t bytes = (size_t)src_desc->n * src_desc->c * src_desc->h * src_desc->w * elem_size;
+    if (num_threads <= 0 && bytes < 2 * LAYOUT_THREAD_BYTES) {
+        // small tensors (decoder states, heads) skip the cpu count query
+        num_threads = 1;
+    } else if (num_threads <= 0) {
+        long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        num_threads = ncpu > 0 ? (int)ncpu : 1;
+        if ((size_t)num_threads > bytes / LAYOUT_THREAD_BYTES) {
+            num_threads = (int)(bytes / LAYOUT_THREAD_BYTES);
+        }
+    }
+    if (num_threads > LAYOUT_MAX_THREADS) {
+        num_threads = LAYOUT_MAX_THREADS;
+    }
+    if (num_threads < 1) {
+        num_threads = 1;
+    }
+
+    // split rows into chunks when there are fewer rows than threads
+    int row_count = src_desc->n * job.rows;
+    job.chunks_per_row = row_count < num_threads ? (num_threads + row_count - 1) / row_count : 1;
+    job.chunk = (job.pixels + job.chunks_per_row - 1) / job.chunks_per_row;
+    job.chunk = (job.chunk + 15) & ~15;
+    job.chunks_per_row = (job.pixels + job.chunk - 1) / job.chunk;
+    size_t units = (size_t)row_count * job.chunks_per_row;
+    if ((size_t)num_threads > units) {
+        num_threads = (int)units;
+    }
+
+    layout_task_t tasks[LAYOUT_MAX_THREADS];
+    pthread_t threads[LAYOUT_MAX_THREADS];
+    int started[LAYOUT_MAX_THREADS] = {0};
+    for (int t = 0; t < num_threads; t++) {
+        tasks[t].job = &job;
+        tasks[t].unit_begin = units * t / num_threads;
+        tasks[t].unit_end = units * (t + 1) / num_threads;
+        if (t > 0 && pthread_create(&threads[t], NULL, convert_layout_worker, &tasks[t]) == 0) {
+            started[t] = 1;
+        }
+    }
+    // calling thread takes the first range and any range whose thread failed to start
+    for (int t = 0; t < num_threads; t++) {
+        if (!started[t]) {
+            convert_layout_worker(&tasks[t]);
+        }
+    }
+    for (int t = 0; t < num_threads; t++) {
+        if (started[t]) {
+            pthread_join(threads[t], NULL);
+        }
+    }
+    return 0;
+}
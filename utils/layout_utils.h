@@ -0,0 +1,72 @@
+#ifndef _RKNN_MODEL_ZOO_LAYOUT_UTILS_H_
+#define _RKNN_MODEL_ZOO_LAYOUT_UTILS_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+typedef enum {
+    TENSOR_LAYOUT_NCHW = 0,
+    TENSOR_LAYOUT_NHWC,
+    TENSOR_LAYOUT_NC1HWC2,      // native layout of RKNPU2, channels in blocks of c2
+} tensor_layout_t;
+
+/**
+ * @brief Shape and memory layout of a 4-D tensor
+ *
+ * n, c, h, w are always the logical sizes. The strides describe padding of the buffer,
+ * 0 means no padding, e.g. w_stride of an NHWC input whose size_with_stride is larger
+ * than its size, or h_stride when only a window of rows of a larger tensor is read.
+ */
+typedef struct {
+    tensor_layout_t layout;
+    int n;
+    int c;
+    int h;
+    int w;
+    int c2;             // NC1HWC2 channel block, dims[4] of the native attr
+    int w_stride;       // pixels per row, 0: w
+    int h_stride;       // rows per channel plane (NCHW, NC1HWC2) or image (NHWC), 0: h
+    int c_stride;       // NHWC channels per pixel, 0: c
+} tensor_layout_desc_t;
+
+/**
+ * @brief Init layout description without padding
+ *
+ * @param desc [out] Layout description
+ * @param layout [in] Layout
+ * @param n [in] Batch
+ * @param c [in] Channels
+ * @param h [in] Height
+ * @param w [in] Width
+ * @param c2 [in] NC1HWC2 channel block, ignored by the other layouts
+ */
+void init_layout_desc(tensor_layout_desc_t* desc, tensor_layout_t layout, int n, int c, int h, int w, int c2);
+
+/**
+ * @brief Convert a tensor between NCHW, NHWC and NC1HWC2
+ *
+ * Any pair of layouts is supported, including the same layout with different padding.
+ * Pixels are transposed in cache sized tiles with NEON when available, large tensors
+ * are split over several threads. Channel padding of an NHWC or NC1HWC2 destination is
+ * zeroed, row and plane padding is left untouched.
+ *
+ * @param src [in] Source data
+ * @param src_desc [in] Source layout
+ * @param dst [out] Destination data, must not overlap src
+ * @param dst_desc [in] Destination layout, same n, c, h, w as src_desc
+ * @param elem_size [in] Element size in bytes: 1 (int8/uint8), 2 (fp16) or 4 (fp32)
+ * @param num_threads [in] Threads, <= 0: by tensor size and cpu count
+ * @return int 0: success; -1: error
+ */
+int convert_layout(const void* src, const tensor_layout_desc_t* src_desc,
+                   void* dst, const tensor_layout_desc_t* dst_desc,
+                   int elem_size, int num_threads);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif // _RKNN_MODEL_ZOO_LAYOUT_UTILS_H_
@@ -0,0 +1,386 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "mask_utils.h"
+
+#define MASK_MAX_THREADS 8
+
+typedef struct {
+    // output region [x0, x1) x [y0, y1) in label map
+    int x0, y0, x1, y1;
+    // prototype region [px0, px1] x [py0, py1]
+    int px0, py0, px1, py1;
+    // offset of the binary instance mask in arena
+    size_t mask_offset;
+} mask_roi_t;
+
+typedef struct {
+    const float* proto;
+    int proto_c, proto_h, proto_w;
+    float model_to_proto_x, model_to_proto_y;
+    const letterbox_t* letter_box;
+    const seg_instance_t* instances;
+    mask_roi_t* rois;
+    int count;
+    int next;
+} mask_job_t;
+
+struct seg_mask_engine {
+    int num_threads;
+    int num_workers;
+    pthread_t threads[MASK_MAX_THREADS];
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond;
+    pthread_cond_t done_cond;
+    unsigned int generation;
+    int pending;
+    int quit;
+    mask_job_t* job;
+
+    // reused between frames: per thread scratch, rois, instance masks
+    unsigned char* arena;
+    size_t arena_size;
+    size_t scratch_size;
+};
+
+static void axpy_row(float* dst, const float* src, float a, int n)
+{
+    int i = 0;
+#if defined(__ARM_NEON)
+    for (; i + 4 <= n; i += 4) {
+        vst1q_f32(dst + i, vmlaq_n_f32(vld1q_f32(dst + i), vld1q_f32(src + i), a));
+    }
+#endif
+    for (; i < n; i++) {
+        dst[i] += a * src[i];
+    }
+}
+
+// source coordinate of cv::resize INTER_LINEAR, clamped at the borders
+static void linear_coord(float src, int size, int* i0, int* i1, float* w)
+{
+    int i = (int)floorf(src);
+    float f = src - i;
+    if (i < 0) {
+        i = 0;
+        f = 0;
+    }
+    if (i >= size - 1) {
+        i = size - 1;
+        f = 0;
+    }
+    *i0 = i;
+    *i1 = i + 1 < size ? i + 1 : size - 1;
+    *w = f;
+}
+
+static void build_instance_mask(mask_job_t* job, int index, float* scratch, unsigned char* arena)
+{
+    const seg_instance_t* inst = &job->instances[index];
+    const mask_roi_t* roi = &job->rois[index];
+    const letterbox_t* lb = job->letter_box;
+    int out_w = roi->x1 - roi->x0;
+    int out_h = roi->y1 - roi->y0;
+    if (out_w <= 0 || out_h <= 0) {
+        return;
+    }
+    int roi_w = roi->px1 - roi->px0 + 1;
+    int roi_h = roi->py1 - roi->py0 + 1;
+    int plane = job->proto_h * job->proto_w;
+
+    // scratch: logits [roi_h * roi_w], blended row [roi_w], column table [out_w * 2] + weights [out_w]
+    float* logits = scratch;
+    float* row = logits + roi_h * roi_w;
+    float* wx = row + roi_w;
+    int* xi = (int*)(wx + out_w);
+
+    // coeff x proto restricted to the prototype region of the box
+    const float* region = logits;
+    int stride = roi_w;
+    if (inst->logits != NULL) {
+        region = inst->logits + roi->py0 * job->proto_w + roi->px0;
+        stride = job->proto_w;
+    } else {
+        memset(logits, 0, sizeof(float) * roi_h * roi_w);
+        for (int r = 0; r < roi_h; r++) {
+            float* dst = logits + r * roi_w;
+            const float* src = job->proto + (roi->py0 + r) * job->proto_w + roi->px0;
+            for (int k = 0; k < job->proto_c; k++) {
+                axpy_row(dst, src + k * plane, inst->coeff[k], roi_w);
+            }
+        }
+    }
+
+    for (int x = 0; x < out_w; x++) {
+        float sx = ((roi->x0 + x + 0.5f) * lb->scale + lb->x_pad) * job->model_to_proto_x - 0.5f;
+        int i0, i1;
+        linear_coord(sx, job->proto_w, &i0, &i1, &wx[x]);
+        xi[x * 2 + 0] = i0 - roi->px0;
+        xi[x * 2 + 1] = i1 - roi->px0;
+    }
+
+    unsigned char* mask = arena + roi->mask_offset;
+    for (int y = 0; y < out_h; y++) {
+        float sy = ((roi->y0 + y + 0.5f) * lb->scale + lb->y_pad) * job->model_to_proto_y - 0.5f;
+        int j0, j1;
+        float wy;
+        linear_coord(sy, job->proto_h, &j0, &j1, &wy);
+        const float* r0 = region + (j0 - roi->py0) * stride;
+        const float* r1 = region + (j1 - roi->py0) * stride;
+        for (int i = 0; i < roi_w; i++) {
+            row[i] = r0[i] + wy * (r1[i] - r0[i]);
+        }
+        unsigned char* dst = mask + y * out_w;
+        for (int x = 0; x < out_w; x++) {
+            float a = row[xi[x * 2 + 0]];
+            float b = row[xi[x * 2 + 1]];
+            dst[x] = (a + wx[x] * (b - a)) > 0;
+        }
+    }
+}
+
+static void run_mask_job(seg_mask_engine_t* engine, mask_job_t* job, int thread_index)
+{
+    float* scratch = (float*)(engine->arena + engine->scratch_size * thread_index);
+    while (1) {
+        int index = __sync_fetch_and_add(&job->next, 1);
+        if (index >= job->count) {
+            break;
+        }
+        build_instance_mask(job, index, scratch, engine->arena);
+    }
+}
+
+static void* mask_worker(void* arg)
+{
+    seg_mask_engine_t* engine = (seg_mask_engine_t*)arg;
+    pthread_mutex_lock(&engine->lock);
+    int thread_index = ++engine->num_workers;
+    unsigned int seen = engine->generation;
+    pthread_cond_signal(&engine->done_cond);
+    while (1) {
+        while (!engine->quit && engine->generation == seen) {
+            pthread_cond_wait(&engine->work_cond, &engine->lock);
+        }
+        if (engine->quit) {
+            break;
+        }
+        seen = engine->generation;
+        mask_job_t* job = engine->job;
+        pthread_mutex_unlock(&engine->lock);
+
+        run_mask_job(engine, job, thread_index);
+
+        pthread_mutex_lock(&engine->lock);
+        if (--engine->pending == 0) {
+            pthread_cond_signal(&engine->done_cond);
+        }
+    }
+    pthread_mutex_unlock(&engine->lock);
+    return NULL;
+}
+
+seg_mask_engine_t* create_seg_mask_engine(int num_threads)
+{
+    seg_mask_engine_t* engine = (seg_mask_engine_t*)calloc(1, sizeof(seg_mask_engine_t));
+    if (engine == NULL) {
+        printf("create mask engine fail\n");
+        return NULL;
+    }
+    if (num_threads <= 0) {
+        long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        num_threads = ncpu < 4 ? (ncpu > 0 ? (int)ncpu : 1) : 4;
+    }
+    if (num_threads > MASK_MAX_THREADS) {
+        num_threads = MASK_MAX_THREADS;
+    }
+    pthread_mutex_init(&engine->lock, NULL);
+    pthread_cond_init(&engine->work_cond, NULL);
+    pthread_cond_init(&engine->done_cond, NULL);
+
+    // the calling thread works too
+    int started = 0;
+    for (int i = 0; i < num_threads - 1; i++) {
+        if (pthread_create(&engine->threads[i], NULL, mask_worker, engine) != 0) {
+            break;
+        }
+        started++;
+    }
+    // workers must be waiting before the first job is published
+    pthread_mutex_lock(&engine->lock);
+    while (engine->num_workers < started) {
+        pthread_cond_wait(&engine->done_cond, &engine->lock);
+    }
+    pthread_mutex_unlock(&engine->lock);
+    engine->num_threads = started + 1;
+    return engine;
+}
+
+void destroy_seg_mask_engine(seg_mask_engine_t* engine)
+{
+    if (engine == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&engine->lock);
+    engine->quit = 1;
+    pthread_cond_broadcast(&engine->work_cond);
+    pthread_mutex_unlock(&engine->lock);
+    for (int i = 0; i < engine->num_threads - 1; i++) {
+        pthread_join(engine->threads[i], NULL);
+    }
+    pthread_mutex_destroy(&engine->lock);
+    pthread_cond_destroy(&engine->work_cond);
+    pthread_cond_destroy(&engine->done_cond);
+    free(engine->arena);
+    free(engine);
+}
+
+static int clamp_int(int v, int lo, int hi)
+{
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+int seg_mask_compose(seg_mask_engine_t* engine, const float* proto, int proto_c, int proto_h, int proto_w,
+                     int model_w, int model_h, const letterbox_t* letter_box,
+                     const seg_instance_t* instances, int count, uint8_t* label_map, int map_w, int map_h)
+{
+    if (label_map == NULL) {
+        return -1;
+    }
+    memset(label_map, 0, (size_t)map_w * map_h);
+    if (engine == NULL || proto == NULL || letter_box == NULL || letter_box->scale <= 0) {
+        return -1;
+    }
+    if (count <= 0 || instances == NULL) {
+        return 0;
+    }
+
+    mask_job_t job;
+    memset(&job, 0, sizeof(job));
+    job.proto = proto;
+    job.proto_c = proto_c;
+    job.proto_h = proto_h;
+    job.proto_w = proto_w;
+    job.model_to_proto_x = (float)proto_w / model_w;
+    job.model_to_proto_y = (float)proto_h / model_h;
+    job.letter_box = letter_box;
+    job.instances = instances;
+    job.count = count;
+
+    // label map pixel x covers model pixel j = (x + 0.5) * scale + pad - 0.5, inside the box when x1 <= j < x2
+    mask_roi_t stack_rois[128];
+    mask_roi_t* rois = count <= 128 ? stack_rois : (mask_roi_t*)malloc(sizeof(mask_roi_t) * count);
+    if (rois == NULL) {
+        return -1;
+    }
+    job.rois = rois;
+    float scale = letter_box->scale;
+    size_t masks_size = 0;
+    int max_out_w = 0;
+    for (int i = 0; i < count; i++) {
+        const float* box = instances[i].box;
+        mask_roi_t* roi = &rois[i];
+        roi->x0 = clamp_int((int)ceilf((box[0] - letter_box->x_pad + 0.5f) / scale - 0.5f), 0, map_w);
+        roi->x1 = clamp_int((int)ceilf((box[2] - letter_box->x_pad + 0.5f) / scale - 0.5f), 0, map_w);
+        roi->y0 = clamp_int((int)ceilf((box[1] - letter_box->y_pad + 0.5f) / scale - 0.5f), 0, map_h);
+        roi->y1 = clamp_int((int)ceilf((box[3] - letter_box->y_pad + 0.5f) / scale - 0.5f), 0, map_h);
+        if (roi->x1 <= roi->x0 || roi->y1 <= roi->y0) {
+            // empty, no instance mask in the arena
+            roi->x1 = roi->x0;
+            roi->y1 = roi->y0;
+            roi->mask_offset = 0;
+            continue;
+        }
+        float px0 = ((roi->x0 + 0.5f) * scale + letter_box->x_pad) * job.model_to_proto_x - 0.5f;
+        float px1 = ((roi->x1 - 0.5f) * scale + letter_box->x_pad) * job.model_to_proto_x - 0.5f;
+        float py0 = ((roi->y0 + 0.5f) * scale + letter_box->y_pad) * job.model_to_proto_y - 0.5f;
+        float py1 = ((roi->y1 - 0.5f) * scale + letter_box->y_pad) * job.model_to_proto_y - 0.5f;
+        roi->px0 = clamp_int((int)floorf(px0), 0, proto_w - 1);
+        roi->px1 = clamp_int((int)floorf(px1) + 1, 0, proto_w - 1);
+        roi->py0 = clamp_int((int)floorf(py0), 0, proto_h - 1);
+        roi->py1 = clamp_int((int)floorf(py1) + 1, 0, proto_h - 1);
+        roi->mask_offset = masks_size;
+        masks_size += (size_t)(roi->x1 - roi->x0) * (roi->y1 - roi->y0);
+        if (roi->x1 - roi->x0 > max_out_w) {
+            max_out_w = roi->x1 - roi->x0;
+        }
+    }
+
+    // arena: [scratch of each thread][instance masks], only grows
+    size_t scratch_size = sizeof(float) * ((size_t)proto_h * proto_w + proto_w + (size_t)max_out_w * 3);
+    scratch_size = (scratch_size + 63) & ~(size_t)63;
+    size_t masks_base = scratch_size * engine->num_threads;
+    size_t need = masks_base + masks_size;
+    if (need > engine->arena_size) {
+        free(engine->arena);
+        engine->arena = (unsigned char*)malloc(need);
+        if (engine->arena == NULL) {
+            printf("mask engine malloc %zu fail\n", need);
+            engine->arena_size = 0;
+            if (rois != stack_rois) {
+                free(rois);
+            }
+            return -1;
+        }
+        engine->arena_size = need;
+    }
+    engine->scratch_size = scratch_size;
+    for (int i = 0; i < count; i++) {
+        if (rois[i].x1 > rois[i].x0) {
+            rois[i].mask_offset += masks_base;
+        }
+    }
+
+    int workers = engine->num_threads - 1;
+    if (workers > count - 1) {
+        workers = count - 1;
+    }
+    if (workers > 0) {
+        pthread_mutex_lock(&engine->lock);
+        engine->job = &job;
+        engine->pending = engine->num_threads - 1;
+        engine->generation++;
+        pthread_cond_broadcast(&engine->work_cond);
+        pthread_mutex_unlock(&engine->lock);
+    }
+    run_mask_job(engine, &job, 0);
+    if (workers > 0) {
+        pthread_mutex_lock(&engine->lock);
+        while (engine->pending > 0) {
+            pthread_cond_wait(&engine->done_cond, &engine->lock);
+        }
+        engine->job = NULL;
+        pthread_mutex_unlock(&engine->lock);
+    }
+
+    // composite in priority order, a pixel keeps the first label
+    for (int i = 0; i < count; i++) {
+        const mask_roi_t* roi = &rois[i];
+        int out_w = roi->x1 - roi->x0;
+        int out_h = roi->y1 - roi->y0;
+        const unsigned char* mask = engine->arena + roi->mask_offset;
+        uint8_t label = instances[i].label;
+        for (int y = 0; y < out_h; y++) {
+            uint8_t* dst = label_map + (size_t)(roi->y0 + y) * map_w + roi->x0;
+            const unsigned char* src = mask + y * out_w;
+            for (int x = 0; x < out_w; x++) {
+                if (dst[x] == 0 && src[x]) {
+                    dst[x] = label;
+                }
+            }
+        }
+    }
+
+    if (rois != stack_rois) {
+        free(rois);
+    }
+    return 0;
+}
@@ -0,0 +1,74 @@
+#ifndef _RKNN_MODEL_ZOO_MASK_UTILS_H_
+#define _RKNN_MODEL_ZOO_MASK_UTILS_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "image_utils.h"
+
+/**
+ * @brief Instance of a prototype based segmentation model (YOLOv5-seg/YOLOv8-seg)
+ *
+ */
+typedef struct {
+    float box[4];           // x1, y1, x2, y2 in model input coordinates
+    const float* coeff;     // mask coefficients, one per prototype channel
+    const float* logits;    // optional coeff x proto over the whole prototype plane, NULL: computed inside the box
+    uint8_t label;          // value written into label map, must be > 0
+} seg_instance_t;
+
+/**
+ * @brief Mask engine, keeps worker threads and scratch memory between frames
+ *
+ */
+typedef struct seg_mask_engine seg_mask_engine_t;
+
+/**
+ * @brief Create mask engine
+ *
+ * @param num_threads [in] Threads assembling instances, <= 0: min(4, cpu count)
+ * @return seg_mask_engine_t* NULL: error
+ */
+seg_mask_engine_t* create_seg_mask_engine(int num_threads);
+
+/**
+ * @brief Destroy mask engine
+ *
+ * @param engine [in] Mask engine
+ */
+void destroy_seg_mask_engine(seg_mask_engine_t* engine);
+
+/**
+ * @brief Assemble instance masks into a label map of the original image
+ *
+ * Each instance evaluates coeff x proto (unless logits are given) only inside the prototype region covered by its box, upsamples
+ * that region bilinearly straight to original image pixels through the letterbox, and is thresholded
+ * at logit 0. Instances are composited in the given order, a pixel keeps the label of the first
+ * instance that covers it.
+ *
+ * @param engine [in] Mask engine
+ * @param proto [in] Prototypes, CHW float
+ * @param proto_c [in] Prototype channels
+ * @param proto_h [in] Prototype height
+ * @param proto_w [in] Prototype width
+ * @param model_w [in] Model input width
+ * @param model_h [in] Model input height
+ * @param letter_box [in] Letterbox of model input
+ * @param instances [in] Instances, highest priority first
+ * @param count [in] Instance count
+ * @param label_map [out] Label map, map_w * map_h bytes, 0: background
+ * @param map_w [in] Original image width
+ * @param map_h [in] Original image height
+ * @return int 0: success; -1: error
+ */
+int seg_mask_compose(seg_mask_engine_t* engine, const float* proto, int proto_c, int proto_h, int proto_w,
+                     int model_w, int model_h, const letterbox_t* letter_box,
+                     const seg_instance_t* instances, int count, uint8_t* label_map, int map_w, int map_h);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif // _RKNN_MODEL_ZOO_MASK_UTILS_H_
@@ -0,0 +1,306 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "model_registry.h"
+#include "file_utils.h"
+
+#if defined(RKNPU1) || defined(RV1106_1103)
+// no rknn_dup_context or RKNN_FLAG_SHARE_WEIGHT_MEM in these runtimes
+#define MODEL_REGISTRY_PRIVATE_CONTEXTS
+#endif
+
+typedef struct model_entry {
+    struct model_entry* next;
+    // a model file loaded with different flags is a separate entry
+    dev_t dev;
+    ino_t ino;
+    uint32_t flag;
+    // first context, owns the weights and lives until the last instance is released
+    rknn_context base;
+    int base_in_use;
+    // contexts handed out, base included while in use
+    rknn_context* instances;
+    int num_instances;
+    int capacity;
+} model_entry_t;
+
+static model_entry_t* g_models = NULL;
+static pthread_mutex_t g_models_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int init_context(const char* model_path, uint32_t flag, rknn_context* src, rknn_context* ctx)
+{
+    mapped_file_t model;
+    int ret = map_model_file(model_path, &model);
+    if (ret != 0) {
+        printf("load_model fail!\n");
+        return -1;
+    }
+
+#if defined(RKNPU1)
+    ret = rknn_init(ctx, model.data, model.size, flag);
+#else
+    rknn_init_extend extend;
+    memset(&extend, 0, sizeof(extend));
+    if (src != NULL) {
+        extend.ctx = *src;
+    } else {
+        // only the contexts taking their weights from src share, the source itself is a plain init
+        flag &= ~RKNN_FLAG_SHARE_WEIGHT_MEM;
+    }
+    ret = rknn_init(ctx, model.data, model.size, flag, src != NULL ? &extend : NULL);
+#endif
+    if (unmap_model_file(&model) != 0 && ret >= 0) {
+        rknn_destroy(*ctx);
+        ret = -1;
+    }
+    if (ret < 0) {
+        printf("rknn_init fail! ret=%d\n", ret);
+        return -1;
+    }
+    return 0;
+}
+
+static int new_instance(const char* model_path, model_entry_t* entry, rknn_context* ctx)
+{
+    if (!entry->base_in_use) {
+        *ctx = entry->base;
+        entry->base_in_use = 1;
+        return 0;
+    }
+#if defined(MODEL_REGISTRY_PRIVATE_CONTEXTS)
+    return init_context(model_path, entry->flag, NULL, ctx);
+#else
+    if (entry->flag & RKNN_FLAG_SHARE_WEIGHT_MEM) {
+        return init_context(model_path, entry->flag, &entry->base, ctx);
+    }
+    int ret = rknn_dup_context(&entry->base, ctx);
+    if (ret < 0) {
+        printf("rknn_dup_context fail! ret=%d\n", ret);
+        return -1;
+    }
+    return 0;
+#endif
+}
+
+static model_entry_t* find_context(rknn_context ctx, model_entry_t*** link, int* index)
+{
+    for (model_entry_t** l = &g_models; *l != NULL; l = &(*l)->next) {
+        model_entry_t* entry = *l;
+        for (int i = 0; i < entry->num_instances; i++) {
+            if (entry->instances[i] == ctx) {
+                if (link != NULL) {
+                    *link = l;
+                }
+                if (index != NULL) {
+                    *index = i;
+                }
+                return entry;
+            }
+        }
+    }
+    return NULL;
+}
+
+int acquire_model_context(const char* model_path, uint32_t flag, rknn_context* ctx)
+{
+    struct stat st;
+    if (stat(model_path, &st) != 0) {
+        printf("stat %s fail!\n", model_path);
+        return -1;
+    }
+
+    pthread_mutex_lock(&g_models_lock);
+    model_entry_t* entry = g_models;
+    while (entry != NULL && !(entry->dev == st.st_dev && entry->ino == st.st_ino && entry->flag == flag)) {
+        entry = entry->next;
+    }
+    model_entry_t* created = NULL;
+    if (entry == NULL) {
+        created = (model_entry_t*)calloc(1, sizeof(model_entry_t));
+        if (created == NULL || init_context(model_path, flag, NULL, &created->base) != 0) {
+            free(created);
+            pthread_mutex_unlock(&g_models_lock);
+            return -1;
+        }
+        created->dev = st.st_dev;
+        created->ino = st.st_ino;
+        created->flag = flag;
+        entry = created;
+    }
+
+    int ret = 0;
+    if (entry->num_instances == entry->capacity) {
+        int capacity = entry->capacity > 0 ? entry->capacity * 2 : 4;
+        rknn_context* instances = (rknn_context*)realloc(entry->instances, capacity * sizeof(rknn_context));
+        if (instances == NULL) {
+            printf("malloc instances fail!\n");
+            ret = -1;
+        } else {
+            entry->instances = instances;
+            entry->capacity = capacity;
+        }
+    }
+    if (ret == 0) {
+        ret = new_instance(model_path, entry, ctx);
+    }
+    if (ret == 0) {
+        entry->instances[entry->num_instances++] = *ctx;
+        if (created != NULL) {
+            created->next = g_models;
+            g_models = created;
+        }
+    } else if (created != NULL) {
+        rknn_destroy(created->base);
+        free(created->instances);
+        free(created);
+    }
+    pthread_mutex_unlock(&g_models_lock);
+    return ret;
+}
+
+int release_model_context(rknn_context ctx)
+{
+    pthread_mutex_lock(&g_models_lock);
+    model_entry_t** link;
+    int index;
+    model_entry_t* entry = find_context(ctx, &link, &index);
+    if (entry == NULL) {
+        pthread_mutex_unlock(&g_models_lock);
+        printf("release_model_context: unknown context\n");
+        return -1;
+    }
+    entry->instances[index] = entry->instances[--entry->num_instances];
+    if (ctx == entry->base) {
+        entry->base_in_use = 0;
+    } else {
+        rknn_destroy(ctx);
+    }
+
+    if (entry->num_instances == 0) {
+        *link = entry->next;
+        rknn_destroy(entry->base);
+        free(entry->instances);
+        free(entry);
+    }
+    pthread_mutex_unlock(&g_models_lock);
+    return 0;
+}
+
+int get_model_footprint(rknn_context ctx, model_footprint_t* footprint)
+{
+    memset(footprint, 0, sizeof(model_footprint_t));
+#if defined(RKNPU1)
+    printf("RKNN_QUERY_MEM_SIZE not supported on RKNPU1\n");
+    return -1;
+#else
+    pthread_mutex_lock(&g_models_lock);
+    model_entry_t* entry = find_context(ctx, NULL, NULL);
+    if (entry == NULL) {
+        pthread_mutex_unlock(&g_models_lock);
+        printf("get_model_footprint: unknown context\n");
+        return -1;
+    }
+
+    rknn_mem_size mem;
+    memset(&mem, 0, sizeof(mem));
+    int ret = rknn_query(entry->base, RKNN_QUERY_MEM_SIZE, &mem, sizeof(mem));
+    if (ret == RKNN_SUCC) {
+        footprint->instances = entry->num_instances;
+#if defined(MODEL_REGISTRY_PRIVATE_CONTEXTS)
+        footprint->shared = 0;
+#else
+        footprint->shared = 1;
+#endif
+        footprint->weight_size = mem.total_weight_size;
+        footprint->internal_size = mem.total_internal_size;
+        footprint->dma_size = mem.total_dma_allocated_size;
+        // the base is counted above, idle or not
+        for (int i = 0; i < entry->num_instances && ret == RKNN_SUCC; i++) {
+            if (entry->instances[i] == entry->base) {
+                continue;
+            }
+            ret = rknn_query(entry->instances[i], RKNN_QUERY_MEM_SIZE, &mem, sizeof(mem));
+            footprint->dma_size += mem.total_dma_allocated_size;
+        }
+    }
+    pthread_mutex_unlock(&g_models_lock);
+    if (ret != RKNN_SUCC) {
+        printf("rknn_query RKNN_QUERY_MEM_SIZE fail! ret=%d\n", ret);
+        return -1;
+    }
+    return 0;
+#endif
+}
+
+int measure_model_footprint(const char* model_path, int instances, uint32_t flag, int shared,
+                            model_footprint_t* footprint)
+{
+    memset(footprint, 0, sizeof(model_footprint_t));
+#if defined(RKNPU1)
+    printf("RKNN_QUERY_MEM_SIZE not supported on RKNPU1\n");
+    return -1;
+#else
+    if (instances < 1) {
+        printf("measure_model_footprint: %d instances\n", instances);
+        return -1;
+    }
+    rknn_context* ctx = (rknn_context*)calloc(instances, sizeof(rknn_context));
+    if (ctx == NULL) {
+        printf("malloc contexts fail!\n");
+        return -1;
+    }
+    int created = 0;
+    int ret = 0;
+    while (created < instances && ret == 0) {
+        ret = shared ? acquire_model_context(model_path, flag, &ctx[created])
+                     : init_context(model_path, flag, NULL, &ctx[created]);
+        created += ret == 0;
+    }
+
+    if (ret == 0 && shared) {
+        ret = get_model_footprint(ctx[0], footprint);
+    } else if (ret == 0) {
+        // every context holds its own weights, the footprint is the sum of N models
+        rknn_mem_size mem;
+        for (int i = 0; i < instances && ret == 0; i++) {
+            memset(&mem, 0, sizeof(mem));
+            ret = rknn_query(ctx[i], RKNN_QUERY_MEM_SIZE, &mem, sizeof(mem));
+            footprint->dma_size += mem.total_dma_allocated_size;
+        }
+        if (ret != RKNN_SUCC) {
+            printf("rknn_query RKNN_QUERY_MEM_SIZE fail! ret=%d\n", ret);
+            ret = -1;
+        }
+        footprint->instances = instances;
+        footprint->shared = 0;
+        footprint->weight_size = mem.total_weight_size;
+        footprint->internal_size = mem.total_internal_size;
+    }
+
+    for (int i = 0; i < created; i++) {
+        if (shared) {
+            release_model_context(ctx[i]);
+        } else {
+            rknn_destroy(ctx[i]);
+        }
+    }
+    free(ctx);
+    return ret;
+#endif
+}
+
+void print_model_footprint(const model_footprint_t* footprint)
+{
+    const double mb = 1024.0 * 1024.0;
+    int n = footprint->instances;
+    double weight = footprint->weight_size / mb;
+    double internal = footprint->internal_size / mb;
+    double expected = footprint->shared ? weight + n * internal : n * (weight + internal);
+    printf("model footprint: %d instance(s), weight %.2f MB %s, internal %.2f MB each\n",
+           n, weight, footprint->shared ? "shared" : "per instance", internal);
+    printf("  weight + internal: %.2f MB (private copies: %.2f MB), dma allocated: %.2f MB\n",
+           expected, n * (weight + internal), footprint->dma_size / mb);
+}
@@ -0,0 +1,91 @@
+#ifndef _RKNN_MODEL_ZOO_MODEL_REGISTRY_H_
+#define _RKNN_MODEL_ZOO_MODEL_REGISTRY_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "rknn_api.h"
+
+/**
+ * Process-wide model registry
+ *
+ * The weights of a model file are loaded once, every further context of the same file
+ * (same device and inode) and flag shares them and only adds its own internal and I/O memory:
+ * - default: rknn_dup_context of the first context
+ * - RKNN_FLAG_SHARE_WEIGHT_MEM in flag: the first context is a plain rknn_init without it,
+ *   the others rknn_init with RKNN_FLAG_SHARE_WEIGHT_MEM and the first context as weight source
+ * RKNPU1 and RV1106/RV1103 have neither, each context there is a private rknn_init
+ * and the registry only keeps the reference count.
+ *
+ * Contexts are not thread safe, use one context per thread. The weights are freed
+ * when the last context of the model is released.
+ */
+
+/**
+ * @brief Memory of one registered model as reported by RKNN_QUERY_MEM_SIZE
+ *
+ */
+typedef struct {
+    int instances;              // contexts handed out
+    int shared;                 // 1: instances share the weights
+    uint64_t weight_size;       // weights of one context
+    uint64_t internal_size;     // internal memory of one context, excluding inputs/outputs
+    uint64_t dma_size;          // dma memory allocated by all contexts of the model
+} model_footprint_t;
+
+/**
+ * @brief Get a context of model, loading it on first use
+ *
+ * @param model_path [in] Model path
+ * @param flag [in] rknn_init flag, RKNN_FLAG_SHARE_WEIGHT_MEM selects shared weight init
+ *                  instead of rknn_dup_context. Contexts of the same model with another flag
+ *                  get their own weights
+ * @param ctx [out] Context, release with release_model_context
+ * @return int 0: success; -1: error
+ */
+int acquire_model_context(const char* model_path, uint32_t flag, rknn_context* ctx);
+
+/**
+ * @brief Release a context from acquire_model_context, the model is unloaded with its last context
+ *
+ * @param ctx [in] Context
+ * @return int 0: success; -1: not a registry context
+ */
+int release_model_context(rknn_context ctx);
+
+/**
+ * @brief Query memory of the model a context belongs to
+ *
+ * @param ctx [in] Context from acquire_model_context
+ * @param footprint [out] Footprint
+ * @return int 0: success; -1: error or not supported by the runtime
+ */
+int get_model_footprint(rknn_context ctx, model_footprint_t* footprint);
+
+/**
+ * @brief Footprint of N contexts of a model, created for the measurement and released again
+ *
+ * @param model_path [in] Model path
+ * @param instances [in] Contexts
+ * @param flag [in] rknn_init flag, as for acquire_model_context
+ * @param shared [in] 1: contexts from acquire_model_context; 0: N private rknn_init, nothing shared
+ * @param footprint [out] Footprint, dma_size summed over the N contexts
+ * @return int 0: success; -1: error or not supported by the runtime
+ */
+int measure_model_footprint(const char* model_path, int instances, uint32_t flag, int shared,
+                            model_footprint_t* footprint);
+
+/**
+ * @brief Print footprint and the memory N private copies would take
+ *
+ * @param footprint [in] Footprint
+ */
+void print_model_footprint(const model_footprint_t* footprint);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif // _RKNN_MODEL_ZOO_MODEL_REGISTRY_H_
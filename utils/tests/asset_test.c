@@ -0,0 +1,321 @@
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <utime.h>
+
+#include "asset_utils.h"
+
+// Binary assets against the text files they were converted from, malformed files, and binaries
+// whose text changed after conversion.
+//   asset_test vocab <vocab.txt> <vocab.bin> [--token-first]
+//   asset_test floats <values.txt> <values.bin> <max relative error>
+//   asset_test
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// size and hash written by asset_converter.py are the ones the C loader computes
+static int check_source_stamp(const asset_t* asset, const char* txt_path)
+{
+    char* data = NULL;
+    int size = read_data_from_file(txt_path, &data);
+    if (size < 0) {
+        return -1;
+    }
+    uint64_t hash = asset_source_hash(data, size, 0);
+    free(data);
+    return asset->source_size == (uint64_t)size && asset->source_hash == hash ? 0 : -1;
+}
+
+// every "<id> <token>" (or "<token> <id>") line must come back as string id
+static int check_vocab(const char* txt_path, const char* bin_path, int token_first)
+{
+    asset_t asset;
+    double t0 = now_ms();
+    if (open_asset(bin_path, ASSET_STRINGS, &asset) != 0) {
+        return -1;
+    }
+    double t1 = now_ms();
+    FILE* fp = fopen(txt_path, "r");
+    if (fp == NULL) {
+        printf("fopen %s fail!\n", txt_path);
+        close_asset(&asset);
+        return -1;
+    }
+    char line[1024];
+    int lines = 0, mismatch = 0;
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        line[strcspn(line, "\r\n")] = '\0';
+        char* sep = strchr(line, ' ');
+        if (sep == NULL) {
+            continue;
+        }
+        const char* token;
+        int id;
+        if (token_first) {
+            // the id follows the last space, tokens may contain spaces
+            sep = strrchr(line, ' ');
+            *sep = '\0';
+            id = atoi(sep + 1);
+            token = line;
+        } else {
+            *sep = '\0';
+            id = atoi(line);
+            token = sep + 1;
+        }
+        if (strcmp(get_asset_string(&asset, id), token) != 0 && mismatch++ < 3) {
+            printf("id %d: [%s] in text, [%s] in asset\n", id, token, get_asset_string(&asset, id));
+        }
+        lines++;
+    }
+    fclose(fp);
+    int out_of_range = get_asset_string(&asset, asset.count)[0] == '\0' && get_asset_string(&asset, -1)[0] == '\0';
+    int stamped = check_source_stamp(&asset, txt_path);
+    printf("%s: %d strings, %d lines, %d mismatches, open %.3f ms, source stamp %s\n", bin_path, asset.count, lines,
+           mismatch, t1 - t0, stamped == 0 ? "ok" : "fail");
+    close_asset(&asset);
+    return lines > 0 && mismatch == 0 && out_of_range && stamped == 0 ? 0 : -1;
+}
+
+static int check_floats(const char* txt_path, const char* bin_path, double max_rel_err)
+{
+    asset_t asset;
+    if (open_asset(bin_path, 0, &asset) != 0) {
+        return -1;
+    }
+    const float* values = get_asset_floats(&asset);
+    FILE* fp = fopen(txt_path, "r");
+    if (values == NULL || fp == NULL) {
+        printf("read %s fail!\n", values == NULL ? bin_path : txt_path);
+        if (fp != NULL) {
+            fclose(fp);
+        }
+        close_asset(&asset);
+        return -1;
+    }
+    int n = 0;
+    float ref;
+    double max_err = 0.0;
+    while (n < asset.count && fscanf(fp, "%f", &ref) == 1) {
+        max_err = fmax(max_err, fabs(values[n] - ref) / (fabs(ref) + 1e-6));
+        n++;
+    }
+    fclose(fp);
+    int stamped = check_source_stamp(&asset, txt_path);
+    printf("%s: %dx%d %s, %d values, max relative error %.2e, source stamp %s\n", bin_path, asset.rows, asset.cols,
+           asset.type == ASSET_FLOAT16 ? "fp16" : "fp32", n, max_err, stamped == 0 ? "ok" : "fail");
+    int ret = n == asset.count && max_err <= max_rel_err && stamped == 0 ? 0 : -1;
+    close_asset(&asset);
+    return ret;
+}
+
+static int write_file(const char* path, const void* data, size_t size)
+{
+    FILE* fp = fopen(path, "wb");
+    if (fp == NULL) {
+        return -1;
+    }
+    size_t written = fwrite(data, 1, size, fp);
+    fclose(fp);
+    return written == size ? 0 : -1;
+}
+
+// open_asset must reject each of these without reading outside the file
+static int check_malformed(void)
+{
+    const char* path = "asset_test_malformed.bin";
+    unsigned char file[256];
+    memset(file, 0, sizeof(file));
+    asset_header_t* h = (asset_header_t*)file;
+    memcpy(h->magic, ASSET_MAGIC, 4);
+    h->version = ASSET_VERSION;
+    h->type = ASSET_STRINGS;
+    h->count = 2;
+    h->data_offset = 80;
+    h->data_size = 3 * sizeof(uint32_t);
+    h->chars_offset = 96;
+    h->chars_size = 4;
+    uint32_t offsets[3] = {0, 2, 4};
+    memcpy(file + 80, offsets, sizeof(offsets));
+    memcpy(file + 96, "a\0b\0", 4);
+    size_t size = 100;
+
+    int ret = 0;
+    asset_t asset;
+    if (write_file(path, file, size) != 0 || open_asset(path, ASSET_STRINGS, &asset) != 0) {
+        printf("valid string asset rejected\n");
+        return -1;
+    }
+    ret |= strcmp(get_asset_string(&asset, 0), "a") == 0 && strcmp(get_asset_string(&asset, 1), "b") == 0 ? 0 : -1;
+    close_asset(&asset);
+
+    struct {
+        const char* what;
+        size_t offset;
+        uint32_t value;
+        size_t size;
+    } cases[] = {
+        {"truncated header", 0, 0, 16},
+        {"truncated version 2 header", 0, 0, 64},
+        {"bad magic", 0, 0x58585858, 100},
+        {"newer version", offsetof(asset_header_t, version), ASSET_VERSION + 1, 100},
+        {"wrong type", offsetof(asset_header_t, type), ASSET_FLOAT32, 100},
+        {"data in the header", offsetof(asset_header_t, data_offset), 64, 100},
+        {"data past end", offsetof(asset_header_t, data_offset), 208, 100},
+        {"chars past end", offsetof(asset_header_t, chars_size), 100, 100},
+        {"offset past chars", 80 + 2 * sizeof(uint32_t), 9, 100},
+        {"truncated payload", 0, 0, 98},
+    };
+    for (int i = 0; i < (int)(sizeof(cases) / sizeof(cases[0])); i++) {
+        unsigned char bad[256];
+        memcpy(bad, file, sizeof(bad));
+        if (cases[i].value != 0) {
+            memcpy(bad + cases[i].offset, &cases[i].value, sizeof(uint32_t));
+        }
+        if (write_file(path, bad, cases[i].size) != 0) {
+            return -1;
+        }
+        if (open_asset(path, ASSET_STRINGS, &asset) == 0) {
+            printf("%s: accepted\n", cases[i].what);
+            close_asset(&asset);
+            ret = -1;
+        }
+    }
+    remove(path);
+
+    // in-memory assets share the accessors, a zeroed asset can be closed
+    const char* strings[3] = {"a", NULL, "ccc"};
+    const float values[6] = {1, 2, 3, 4, 5, 6};
+    asset_t s, f;
+    if (create_string_asset(strings, 3, &s) != 0 || create_float_asset(values, 2, 3, &f) != 0) {
+        return -1;
+    }
+    ret |= strcmp(get_asset_string(&s, 0), "a") == 0 && get_asset_string(&s, 1)[0] == '\0' &&
+                   strcmp(get_asset_string(&s, 2), "ccc") == 0
+               ? 0
+               : -1;
+    ret |= f.rows == 2 && f.cols == 3 && memcmp(get_asset_floats(&f), values, sizeof(values)) == 0 ? 0 : -1;
+    close_asset(&s);
+    close_asset(&f);
+    asset_t zero;
+    memset(&zero, 0, sizeof(zero));
+    close_asset(&zero);
+    printf("malformed and in-memory assets: %s\n", ret == 0 ? "ok" : "fail");
+    return ret;
+}
+
+static int write_text(const char* path, const char* text, time_t mtime)
+{
+    struct utimbuf times = {mtime, mtime};
+    return write_file(path, text, strlen(text)) == 0 && utime(path, &times) == 0 ? 0 : -1;
+}
+
+static int set_mtime(const char* path, time_t mtime)
+{
+    struct utimbuf times = {mtime, mtime};
+    return utime(path, &times);
+}
+
+// open_text_asset on a text whose values are expected, 0 / 1 / -1 as returned
+static int open_values(const char* txt_path, const float* expected, int count)
+{
+    asset_t asset;
+    int ret = open_text_asset(txt_path, 0, &asset);
+    if (ret == 0) {
+        const float* values = get_asset_floats(&asset);
+        ret = values != NULL && asset.count == count && memcmp(values, expected, count * sizeof(float)) == 0 ? 0 : 2;
+        close_asset(&asset);
+    }
+    return ret;
+}
+
+// a binary is used while its text is unchanged, even after a copy or touch, and not once the text changes
+static int check_stale(void)
+{
+    const char* txt = "asset_test_stale.txt";
+    const char* bin = "asset_test_stale.bin";
+    const float first[6] = {1, 2, 3, 4, 5, 6};
+    const float second[6] = {1, 2, 3, 4, 5, 7};
+    time_t now = time(NULL);
+    remove(bin);
+    int ret = 0;
+
+    char path[64];
+    ret |= binary_asset_path("model/vocab_en.txt", path, sizeof(path)) == 0 && strcmp(path, "model/vocab_en.bin") == 0 &&
+                   binary_asset_path("a.b/vocab", path, sizeof(path)) == 0 && strcmp(path, "a.b/vocab.bin") == 0 &&
+                   binary_asset_path("model/vocab_en.txt", path, 18) == -1
+               ? 0
+               : -1;
+
+    asset_t asset;
+    ret |= write_text(txt, "1 2 3\n4 5 6\n", now - 100) == 0 && open_values(txt, first, 6) == 1 ? 0 : -1;
+    ret |= create_float_asset(first, 2, 3, &asset) == 0 && save_text_asset(&asset, txt) == 0 ? 0 : -1;
+    close_asset(&asset);
+    ret |= open_values(txt, first, 6) == 0 ? 0 : -1;
+    // same text, touched or copied after the binary
+    ret |= set_mtime(txt, now + 100) == 0 && open_values(txt, first, 6) == 0 ? 0 : -1;
+    // edited, same size and bigger
+    ret |= write_text(txt, "1 2 3\n4 5 7\n", now + 100) == 0 && open_values(txt, first, 6) == 1 ? 0 : -1;
+    ret |= write_text(txt, "1 2 3\n4 5 6 \n", now + 100) == 0 && open_values(txt, first, 6) == 1 ? 0 : -1;
+    // rebuilt from the edited text
+    ret |= write_text(txt, "1 2 3\n4 5 7\n", now - 100) == 0 ? 0 : -1;
+    ret |= create_float_asset(second, 2, 3, &asset) == 0 && save_text_asset(&asset, txt) == 0 ? 0 : -1;
+    close_asset(&asset);
+    ret |= open_values(txt, second, 6) == 0 ? 0 : -1;
+
+    // version 1 binaries carry no source stamp, only trusted when newer than the text
+    char* data = NULL;
+    int size = read_data_from_file(bin, &data);
+    uint32_t v1 = 1;
+    ret |= size > 0 ? 0 : -1;
+    if (size > 0) {
+        memcpy(data + offsetof(asset_header_t, version), &v1, sizeof(v1));
+        memset(data + offsetof(asset_header_t, source_size), 0, 2 * sizeof(uint64_t));
+        ret |= write_file(bin, data, size) == 0 && set_mtime(bin, now) == 0 ? 0 : -1;
+        ret |= open_values(txt, second, 6) == 0 ? 0 : -1;
+        ret |= set_mtime(txt, now + 100) == 0 && open_values(txt, second, 6) == 1 ? 0 : -1;
+        // a corrupt binary is an error, not a reason to parse the text
+        ret |= write_file(bin, data, 40) == 0 && open_values(txt, second, 6) == -1 ? 0 : -1;
+    }
+    free(data);
+
+    // strings
+    const char* strings[3] = {"a", "", "c c"};
+    ret |= write_text(txt, "0 a\n2 c c\n", now - 100) == 0 && create_string_asset(strings, 3, &asset) == 0 &&
+                   save_text_asset(&asset, txt) == 0
+               ? 0
+               : -1;
+    close_asset(&asset);
+    ret |= open_text_asset(txt, ASSET_STRINGS, &asset) == 0 && strcmp(get_asset_string(&asset, 2), "c c") == 0 ? 0 : -1;
+    close_asset(&asset);
+    ret |= open_text_asset(txt, ASSET_FLOAT32, &asset) == -1 ? 0 : -1;
+    remove(txt);
+    remove(bin);
+    printf("stale binary assets: %s\n", ret == 0 ? "ok" : "fail");
+    return ret;
+}
+
+int main(int argc, char** argv)
+{
+    int ret;
+    if (argc >= 4 && strcmp(argv[1], "vocab") == 0) {
+        ret = check_vocab(argv[2], argv[3], argc > 4 && strcmp(argv[4], "--token-first") == 0);
+    } else if (argc >= 5 && strcmp(argv[1], "floats") == 0) {
+        ret = check_floats(argv[2], argv[3], atof(argv[4]));
+    } else if (argc == 1) {
+        ret = check_malformed();
+        ret |= check_stale();
+    } else {
+        printf("%s [vocab <txt> <bin> [--token-first] | floats <txt> <bin> <max relative error>]\n", argv[0]);
+        return 1;
+    }
+    printf("%s\n", ret == 0 ? "PASS" : "FAIL");
+    return ret == 0 ? 0 : 1;
+}
@@ -0,0 +1,147 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "audio_utils.h"
+#include "sndfile_synth.h"
+
+// Streaming audio source on generated files against the whole-file path (read_audio,
+// convert_channels, resample_audio): bit-exact samples for every read size, as is, downmixed
+// and resampled; frames decoded before a decode error are returned, the error on the next read.
+//   audio_source_test [seconds]
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// all samples of the source in reads of block frames, -2 when a read fails
+static long long read_all(audio_source_t* source, float* data, long long capacity, int block)
+{
+    long long total = 0;
+    while (1) {
+        int n = block < capacity - total ? block : (int)(capacity - total);
+        int m = read_audio_source(source, data + total * source->num_channels, n);
+        if (m < 0) {
+            return -2;
+        }
+        total += m;
+        if (m < n || total == capacity) {
+            return total;
+        }
+    }
+}
+
+// the source against the whole-file path, for several read sizes
+static int check_exact(const char* path, int sample_rate, int mono)
+{
+    audio_buffer_t audio;
+    memset(&audio, 0, sizeof(audio));
+    double t0 = now_ms();
+    if (read_audio(path, &audio) != 0) {
+        return -1;
+    }
+    int file_rate = audio.sample_rate;
+    if (mono && audio.num_channels > 1 && convert_channels(&audio) != 0) {
+        free(audio.data);
+        return -1;
+    }
+    if (sample_rate != file_rate && resample_audio(&audio, file_rate, sample_rate) != 0) {
+        free(audio.data);
+        return -1;
+    }
+    double whole_ms = now_ms() - t0;
+    long long num_samples = (long long)audio.num_frames * audio.num_channels;
+
+    const int blocks[] = {1, 160, 4095, AUDIO_SOURCE_BLOCK, AUDIO_SOURCE_RING_FRAMES + 1, 1 << 22};
+    float* data = (float*)malloc((num_samples + 1) * sizeof(float));
+    int ret = 0;
+    double stream_ms = 0;
+    for (int b = 0; b < (int)(sizeof(blocks) / sizeof(blocks[0])); b++) {
+        audio_source_t source;
+        double t1 = now_ms();
+        if (open_audio_source(path, sample_rate, mono, &source) != 0) {
+            ret = -1;
+            break;
+        }
+        long long frames = read_all(&source, data, audio.num_frames + 1, blocks[b]);
+        int channels = source.num_channels;
+        close_audio_source(&source);
+        stream_ms = blocks[b] == AUDIO_SOURCE_BLOCK ? now_ms() - t1 : stream_ms;
+        int same = frames == audio.num_frames && channels == audio.num_channels &&
+                   memcmp(data, audio.data, num_samples * sizeof(float)) == 0;
+        if (!same) {
+            printf("%s, %d Hz, mono %d, reads of %d frames: %lld frames, %lld expected, samples differ\n", path,
+                   sample_rate, mono, blocks[b], frames, (long long)audio.num_frames);
+            ret = -1;
+        }
+    }
+    printf("%s -> %d Hz x %d: %d frames bit-exact for %d read sizes: %s (whole file %.1f ms, stream %.1f ms)\n",
+           path, sample_rate, audio.num_channels, audio.num_frames, (int)(sizeof(blocks) / sizeof(blocks[0])),
+           ret == 0 ? "ok" : "fail", whole_ms, stream_ms);
+    free(data);
+    free(audio.data);
+    return ret;
+}
+
+// a decode error at error_frame: every frame before it, then -1 on the next read and the ones after
+static int check_error(int error_frame, int block)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "synth:%d:16000:1:%d", error_frame + 50000, error_frame);
+    audio_source_t source;
+    if (open_audio_source(path, 0, 1, &source) != 0) {
+        return -1;
+    }
+    float* data = (float*)malloc((error_frame + block) * sizeof(float));
+    long long total = 0;
+    int last = 0, reads = 0;
+    while (1) {
+        last = read_audio_source(&source, data + total, block);
+        reads++;
+        if (last <= 0) {
+            break;
+        }
+        total += last;
+    }
+    int again = read_audio_source(&source, data, block);
+    close_audio_source(&source);
+    int bad = 0;
+    for (long long i = 0; i < total; i++) {
+        bad += data[i] != default_synth_signal(i, 0);
+    }
+    free(data);
+
+    audio_buffer_t head;
+    int head_ret = read_audio_head(path, 16000, error_frame + 1000, &head);
+    free(head.data);
+    int ret = total == error_frame && bad == 0 && last == -1 && again == -1 && head_ret == -1 ? 0 : -1;
+    printf("decode error at frame %d, reads of %d: %lld frames (%d differ) in %d reads, then %d, %d; "
+           "read_audio_head %d: %s\n",
+           error_frame, block, total, bad, reads - 1, last, again, head_ret, ret == 0 ? "ok" : "fail");
+    return ret;
+}
+
+int main(int argc, char** argv)
+{
+    int seconds = argc > 1 ? atoi(argv[1]) : 30;
+    char mono_16k[64], stereo_44k[64], quad_8k[64];
+    snprintf(mono_16k, sizeof(mono_16k), "synth:%d:16000:1", seconds * 16000 + 17);
+    snprintf(stereo_44k, sizeof(stereo_44k), "synth:%d:44100:2", seconds * 44100 + 3);
+    snprintf(quad_8k, sizeof(quad_8k), "synth:%d:8000:4", seconds * 8000);
+
+    int ret = 0;
+    ret |= check_exact(mono_16k, 16000, 1);
+    ret |= check_exact(stereo_44k, 44100, 0);
+    ret |= check_exact(stereo_44k, 16000, 1);
+    ret |= check_exact(quad_8k, 16000, 1);
+    ret |= check_error(100000, 4096);
+    ret |= check_error(AUDIO_SOURCE_BLOCK * 3, 1000);
+    ret |= check_error(1, 160);
+    ret |= check_error(0, 160);
+    printf("%s\n", ret == 0 ? "PASS" : "FAIL");
+    return ret == 0 ? 0 : 1;
+}
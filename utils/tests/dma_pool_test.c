@@ -0,0 +1,257 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "dma_pool.h"
+
+// DMA-buf pool on the memfd fallback of a host without dma heap: image views, size classes,
+// reuse of released buffers, skipped syncs of clean buffers, the cache limit, threads,
+// and acquire/release of a 640x480 RGB888 buffer against a pool that caches nothing.
+//   dma_pool_test [iterations]
+
+// image_utils.c needs librga, same sizes as its get_image_size
+int get_image_size(image_buffer_t* image)
+{
+    switch (image->format) {
+    case IMAGE_FORMAT_GRAY8:
+        return image->width * image->height;
+    case IMAGE_FORMAT_RGB888:
+        return image->width * image->height * 3;
+    case IMAGE_FORMAT_RGBA8888:
+        return image->width * image->height * 4;
+    case IMAGE_FORMAT_YUV420SP_NV12:
+    case IMAGE_FORMAT_YUV420SP_NV21:
+        return image->width * image->height * 3 / 2;
+    default:
+        return 0;
+    }
+}
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// an image view on a pool buffer, syncs only when dirty, the same buffer back after release
+static int check_image_and_reuse(dma_pool_t* pool)
+{
+    int ret = 0;
+    dma_pool_stats_t before, after;
+    get_dma_pool_stats(pool, &before);
+    image_buffer_t image;
+    dma_buffer_t* buf = acquire_dma_image(pool, 640, 480, IMAGE_FORMAT_RGB888, &image);
+    if (buf == NULL) {
+        return -1;
+    }
+    ret |= image.size == 640 * 480 * 3 && buf->size >= (size_t)image.size && image.fd == buf->fd &&
+                   image.virt_addr == buf->virt_addr && !buf->dirty
+               ? 0
+               : -1;
+    ret |= acquire_dma_image(pool, 640, 480, IMAGE_FORMAT_YUV420SP_NV12 + 100, &image) == NULL ? 0 : -1;
+    memset(buf->virt_addr, 1, 640 * 480 * 3);
+    ret |= sync_dma_buffer_to_device(buf);
+    mark_dma_buffer_dirty(buf);
+    ret |= sync_dma_buffer_to_device(buf);
+    ret |= sync_dma_buffer_to_device(buf);
+    ret |= buf->dirty == 0 ? 0 : -1;
+    mark_dma_buffer_dirty(buf);
+    release_dma_buffer(buf);
+
+    // one row less is the same size class
+    dma_buffer_t* again = acquire_dma_image(pool, 640, 479, IMAGE_FORMAT_RGB888, &image);
+    ret |= again == buf && !again->dirty ? 0 : -1;
+    release_dma_buffer(again);
+    get_dma_pool_stats(pool, &after);
+    ret |= after.allocs - before.allocs == 1 && after.reuses - before.reuses == 1 && after.syncs - before.syncs == 1 &&
+                   after.skipped_syncs - before.skipped_syncs == 2 && after.in_use_bytes == before.in_use_bytes
+               ? 0
+               : -1;
+    printf("image view, reuse, dirty syncs: fd %d, %d syncs, %d skipped: %s\n", buf->fd, after.syncs - before.syncs,
+           after.skipped_syncs - before.skipped_syncs, ret == 0 ? "ok" : "fail");
+    return ret;
+}
+
+// the malloc'ed data moves into a pool buffer and is freed
+static int check_move(dma_pool_t* pool)
+{
+    image_buffer_t image;
+    memset(&image, 0, sizeof(image));
+    image.width = 16;
+    image.height = 16;
+    image.format = IMAGE_FORMAT_RGB888;
+    image.size = 16 * 16 * 3;
+    image.fd = -1;
+    image.virt_addr = (unsigned char*)malloc(image.size);
+    for (int i = 0; i < image.size; i++) {
+        image.virt_addr[i] = (unsigned char)i;
+    }
+    dma_buffer_t* buf = move_image_to_dma_buffer(pool, &image);
+    if (buf == NULL) {
+        free(image.virt_addr);
+        return -1;
+    }
+    int bad = 0;
+    for (int i = 0; i < image.size; i++) {
+        bad += image.virt_addr[i] != (unsigned char)i;
+    }
+    int ret = bad == 0 && image.virt_addr == buf->virt_addr && image.fd == buf->fd && !buf->dirty ? 0 : -1;
+    release_dma_buffer(buf);
+    printf("move_image_to_dma_buffer: %d bytes differ: %s\n", bad, ret == 0 ? "ok" : "fail");
+    return ret;
+}
+
+// page aligned, at least the request, at most a quarter more than the request rounded to pages
+static int check_size_classes(dma_pool_t* pool)
+{
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    const size_t sizes[] = {1, 4096, 4097, 100000, 640 * 480 * 3 / 2, 921600, 1 << 20, (1 << 20) + 1, 3000000, 8294400};
+    int ret = 0;
+    double max_waste = 0.0;
+    for (int i = 0; i < (int)(sizeof(sizes) / sizeof(sizes[0])); i++) {
+        dma_buffer_t* buf = acquire_dma_buffer(pool, sizes[i]);
+        if (buf == NULL) {
+            return -1;
+        }
+        size_t pages = (sizes[i] + page - 1) / page * page;
+        double waste = (double)(buf->size - pages) / pages;
+        if (buf->size < sizes[i] || buf->size % page != 0 || waste > 0.25) {
+            printf("%zu bytes: class %zu\n", sizes[i], buf->size);
+            ret = -1;
+        }
+        max_waste = waste > max_waste ? waste : max_waste;
+        release_dma_buffer(buf);
+    }
+    printf("size classes: at most %.1f%% over the page rounded request: %s\n", max_waste * 100.0,
+           ret == 0 ? "ok" : "fail");
+    return ret;
+}
+
+// released buffers beyond the limit are freed, the most recent are kept
+static int check_cache_limit(void)
+{
+    dma_pool_t* pool = create_dma_pool("/nonexistent_dma_heap", 8 << 20);
+    if (pool == NULL) {
+        return -1;
+    }
+    dma_buffer_t* bufs[3];
+    for (int i = 0; i < 3; i++) {
+        bufs[i] = acquire_dma_buffer(pool, 3 << 20);
+        if (bufs[i] == NULL) {
+            return -1;
+        }
+    }
+    for (int i = 0; i < 3; i++) {
+        release_dma_buffer(bufs[i]);
+    }
+    dma_pool_stats_t stats;
+    get_dma_pool_stats(pool, &stats);
+    int ret = stats.fallback == 1 && stats.cached_bytes == (size_t)(6 << 20) && stats.in_use_bytes == 0 ? 0 : -1;
+    // larger than the limit, never cached
+    dma_buffer_t* big = acquire_dma_buffer(pool, 9 << 20);
+    ret |= big != NULL ? 0 : -1;
+    release_dma_buffer(big);
+    get_dma_pool_stats(pool, &stats);
+    ret |= stats.cached_bytes == (size_t)(6 << 20) ? 0 : -1;
+    dma_buffer_t* recent = acquire_dma_buffer(pool, 3 << 20);
+    ret |= recent == bufs[2] ? 0 : -1;
+    release_dma_buffer(recent);
+    printf("8MB limit, 3x3MB released: %zu bytes cached: %s\n", stats.cached_bytes, ret == 0 ? "ok" : "fail");
+    destroy_dma_pool(pool);
+    return ret;
+}
+
+typedef struct {
+    dma_pool_t* pool;
+    int ret;
+} thread_arg_t;
+
+static void* acquire_release(void* arg)
+{
+    thread_arg_t* a = (thread_arg_t*)arg;
+    for (int i = 0; i < 500; i++) {
+        dma_buffer_t* buf = acquire_dma_buffer(a->pool, 65536 * (1 + i % 3));
+        if (buf == NULL) {
+            a->ret = -1;
+            continue;
+        }
+        ((unsigned char*)buf->virt_addr)[buf->size - 1] = 1;
+        mark_dma_buffer_dirty(buf);
+        if (sync_dma_buffer_to_device(buf) != 0) {
+            a->ret = -1;
+        }
+        release_dma_buffer(buf);
+    }
+    return NULL;
+}
+
+static int check_threads(dma_pool_t* pool)
+{
+    pthread_t threads[4];
+    thread_arg_t args[4];
+    for (int i = 0; i < 4; i++) {
+        args[i].pool = pool;
+        args[i].ret = 0;
+        pthread_create(&threads[i], NULL, acquire_release, &args[i]);
+    }
+    int ret = 0;
+    for (int i = 0; i < 4; i++) {
+        pthread_join(threads[i], NULL);
+        ret |= args[i].ret;
+    }
+    dma_pool_stats_t stats;
+    get_dma_pool_stats(pool, &stats);
+    ret |= stats.in_use_bytes == 0 ? 0 : -1;
+    printf("4 threads: %d allocs, %d reuses, %zu bytes in use: %s\n", stats.allocs, stats.reuses, stats.in_use_bytes,
+           ret == 0 ? "ok" : "fail");
+    return ret;
+}
+
+// per frame: get a buffer, touch it, give it back
+static double time_acquire_release(dma_pool_t* pool, int iterations)
+{
+    double t0 = now_ms();
+    for (int i = 0; i < iterations; i++) {
+        dma_buffer_t* buf = acquire_dma_buffer(pool, 640 * 480 * 3);
+        if (buf == NULL) {
+            return -1.0;
+        }
+        ((unsigned char*)buf->virt_addr)[0] = 1;
+        release_dma_buffer(buf);
+    }
+    return (now_ms() - t0) * 1000.0 / iterations;
+}
+
+int main(int argc, char** argv)
+{
+    int iterations = argc > 1 ? atoi(argv[1]) : 2000;
+    // a missing heap takes the memfd fallback on boards too
+    dma_pool_t* pool = create_dma_pool("/nonexistent_dma_heap", 0);
+    if (pool == NULL) {
+        return 1;
+    }
+    int ret = 0;
+    ret |= check_image_and_reuse(pool);
+    ret |= check_move(pool);
+    ret |= check_size_classes(pool);
+    ret |= check_cache_limit();
+    ret |= check_threads(pool);
+
+    dma_pool_t* no_cache = create_dma_pool("/nonexistent_dma_heap", 1);
+    double pool_us = time_acquire_release(pool, iterations);
+    double no_cache_us = time_acquire_release(no_cache, iterations);
+    printf("640x480 RGB888, %d frames: pool %.2f us, no cache %.2f us per acquire/release\n", iterations, pool_us,
+           no_cache_us);
+    ret |= pool_us >= 0.0 && no_cache_us >= 0.0 ? 0 : -1;
+    dma_pool_stats_t stats;
+    get_dma_pool_stats(no_cache, &stats);
+    ret |= stats.reuses == 0 ? 0 : -1;
+    destroy_dma_pool(no_cache);
+    destroy_dma_pool(pool);
+    printf("%s\n", ret == 0 ? "PASS" : "FAIL");
+    return ret == 0 ? 0 : 1;
+}
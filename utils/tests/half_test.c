@@ -0,0 +1,213 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "half_utils.h"
+
+// Exhaustive half <-> float check of the scalar functions and the array backend of this cpu:
+// all 65536 halves decoded and converted back, round to nearest even at every midpoint
+// between two halves, inf/nan/overflow/underflow, and the scaled array variants.
+//   half_test
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static uint32_t float_bits(float f)
+{
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    return u;
+}
+
+static float bits_float(uint32_t u)
+{
+    float f;
+    memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+// decode by the definition, quiet nan keeps its payload
+static float reference_half_to_float(uint16_t h)
+{
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    int exp = (h >> 10) & 0x1f;
+    uint32_t mant = h & 0x3ff;
+    if (exp == 0x1f) {
+        return bits_float(sign | 0x7f800000 | (mant << 13) | (mant != 0 ? 0x400000 : 0));
+    }
+    float value = exp == 0 ? ldexpf((float)mant, -24) : ldexpf((float)(mant | 0x400), exp - 25);
+    return sign ? -value : value;
+}
+
+static int is_half_nan(uint16_t h) { return (h & 0x7c00) == 0x7c00 && (h & 0x3ff) != 0; }
+
+// same half, or both nan of the same sign
+static int same_half(uint16_t a, uint16_t b)
+{
+    return a == b || (is_half_nan(a) && is_half_nan(b) && (a & 0x8000) == (b & 0x8000));
+}
+
+static int check_all_halves(void)
+{
+    static uint16_t halves[65536], back[65536];
+    static float values[65536];
+    for (int i = 0; i < 65536; i++) {
+        halves[i] = (uint16_t)i;
+    }
+    half_to_float_array(halves, values, 65536);
+    float_to_half_array(values, back, 65536);
+    int bad = 0;
+    for (int i = 0; i < 65536; i++) {
+        uint32_t ref = float_bits(reference_half_to_float((uint16_t)i));
+        int decoded = float_bits(half_to_float((uint16_t)i)) == ref && float_bits(values[i]) == ref;
+        int round_trip = same_half(float_to_half(values[i]), (uint16_t)i) && same_half(back[i], (uint16_t)i);
+        if ((!decoded || !round_trip) && bad++ < 5) {
+            printf("half %04x: float %08x (expected %08x), back %04x / %04x\n", i, float_bits(values[i]), ref,
+                   float_to_half(values[i]), back[i]);
+        }
+    }
+    printf("65536 halves: %d wrong decodes or round trips\n", bad);
+    return bad == 0 ? 0 : -1;
+}
+
+// between each two finite neighbours: the midpoint goes to the even one, one float ulp off it to the nearer
+static int check_rounding(void)
+{
+    static float inputs[3 * 2 * 0x7c00];
+    static uint16_t expected[3 * 2 * 0x7c00], scalar[3 * 2 * 0x7c00], array[3 * 2 * 0x7c00];
+    int n = 0;
+    for (int sign = 0; sign < 2; sign++) {
+        for (uint16_t lo = 0; lo < 0x7c00; lo++) {
+            uint16_t a = lo | (sign << 15);
+            uint16_t b = (lo + 1) | (sign << 15);
+            float fa = reference_half_to_float(a);
+            // above 65504 the next value is 65520, where rounding overflows to inf
+            float fb = lo + 1 == 0x7c00 ? (sign ? -65536.0f : 65536.0f) : reference_half_to_float(b);
+            float mid = (fa + fb) * 0.5f;
+            uint16_t even = (lo & 1) == 0 ? a : b;
+            inputs[n] = mid;
+            expected[n++] = even;
+            inputs[n] = nextafterf(mid, fa);
+            expected[n++] = a;
+            inputs[n] = nextafterf(mid, fb);
+            expected[n++] = b;
+        }
+    }
+    float_to_half_array(inputs, array, n);
+    int bad = 0;
+    for (int i = 0; i < n; i++) {
+        scalar[i] = float_to_half(inputs[i]);
+        if ((scalar[i] != expected[i] || array[i] != expected[i]) && bad++ < 5) {
+            printf("float %08x (%g): %04x / %04x, expected %04x\n", float_bits(inputs[i]), inputs[i], scalar[i],
+                   array[i], expected[i]);
+        }
+    }
+    printf("%d midpoints and neighbours: %d wrongly rounded\n", n, bad);
+    return bad == 0 ? 0 : -1;
+}
+
+static int check_specials(void)
+{
+    const struct {
+        float f;
+        uint16_t h;
+    } cases[] = {
+        {INFINITY, 0x7c00},     {-INFINITY, 0xfc00},  {1e10f, 0x7c00},         {-70000.0f, 0xfc00},
+        {65504.0f, 0x7bff},     {65519.0f, 0x7bff},   {65520.0f, 0x7c00},      {1e-10f, 0x0000},
+        {-1e-10f, 0x8000},      {0x1p-25f, 0x0000},   {0x1.000002p-25f, 0x0001}, {0x1.8p-24f, 0x0002},
+        {-0.0f, 0x8000},        {1.0f, 0x3c00},
+    };
+    int ret = 0;
+    for (int i = 0; i < (int)(sizeof(cases) / sizeof(cases[0])); i++) {
+        uint16_t scalar = float_to_half(cases[i].f);
+        uint16_t array;
+        float_to_half_array(&cases[i].f, &array, 1);
+        if (scalar != cases[i].h || array != cases[i].h) {
+            printf("%g: %04x / %04x, expected %04x\n", cases[i].f, scalar, array, cases[i].h);
+            ret = -1;
+        }
+    }
+    // nan stays nan, sign kept
+    float nans[2] = {NAN, -NAN};
+    uint16_t out[2];
+    float_to_half_array(nans, out, 2);
+    for (int i = 0; i < 2; i++) {
+        uint16_t scalar = float_to_half(nans[i]);
+        if (!is_half_nan(scalar) || !is_half_nan(out[i]) || (scalar & 0x8000) != (out[i] & 0x8000)) {
+            printf("nan: %04x / %04x\n", scalar, out[i]);
+            ret = -1;
+        }
+    }
+    printf("inf, nan, overflow, underflow: %s\n", ret == 0 ? "ok" : "fail");
+    return ret;
+}
+
+// scaled variants against the scalar functions, every length up to 67 for the vector tails
+static int check_scaled(void)
+{
+    float src[67], add[67], back[67], ref_back[67];
+    uint16_t out[67];
+    for (int i = 0; i < 67; i++) {
+        src[i] = i * 0.37f - 5.0f;
+        add[i] = i * 0.01f;
+    }
+    int bad = 0;
+    for (int n = 0; n <= 67; n++) {
+        float_to_half_array_scaled(src, 8.0f, add, out, n);
+        half_to_float_array_scaled(out, 0.5f, 1.0f, back, n);
+        for (int i = 0; i < n; i++) {
+            ref_back[i] = half_to_float(out[i]) * 0.5f + 1.0f;
+            bad += out[i] != float_to_half(src[i] * 8.0f + add[i]);
+            bad += float_bits(back[i]) != float_bits(ref_back[i]);
+        }
+        float_to_half_array_scaled(src, 2.0f, NULL, out, n);
+        for (int i = 0; i < n; i++) {
+            bad += out[i] != float_to_half(src[i] * 2.0f);
+        }
+    }
+    printf("scaled arrays, lengths 0-67: %d differ from the scalar functions\n", bad);
+    return bad == 0 ? 0 : -1;
+}
+
+static void time_arrays(void)
+{
+    const int n = 1 << 20;
+    float* f = (float*)malloc(n * sizeof(float));
+    uint16_t* h = (uint16_t*)malloc(n * sizeof(uint16_t));
+    for (int i = 0; i < n; i++) {
+        f[i] = (float)(i % 4096) * 0.01f - 20.0f;
+    }
+    double t0 = now_ms();
+    for (int i = 0; i < n; i++) {
+        h[i] = float_to_half(f[i]);
+    }
+    double t1 = now_ms();
+    float_to_half_array(f, h, n);
+    double t2 = now_ms();
+    half_to_float_array(h, f, n);
+    double t3 = now_ms();
+    printf("1M values: float_to_half loop %.3f ms, float_to_half_array %.3f ms, half_to_float_array %.3f ms\n",
+           t1 - t0, t2 - t1, t3 - t2);
+    free(h);
+    free(f);
+}
+
+int main(void)
+{
+    printf("backend: %s\n", get_half_convert_backend());
+    int ret = 0;
+    ret |= check_all_halves();
+    ret |= check_rounding();
+    ret |= check_specials();
+    ret |= check_scaled();
+    time_arrays();
+    printf("%s\n", ret == 0 ? "PASS" : "FAIL");
+    return ret == 0 ? 0 : 1;
+}
@@ -0,0 +1,289 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "layout_utils.h"
+
+// convert_layout against an element by element copy: randomized shapes, padding and thread
+// counts, then the time of every layout pair and element size, and of the demo call sites
+// next to the loops they used before.
+//   layout_bench [random cases]
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static const char* layout_name(tensor_layout_t layout)
+{
+    return layout == TENSOR_LAYOUT_NCHW ? "NCHW" : (layout == TENSOR_LAYOUT_NHWC ? "NHWC" : "NC1HWC2");
+}
+
+static size_t row_width(const tensor_layout_desc_t* d) { return d->w_stride > 0 ? d->w_stride : d->w; }
+static size_t plane_height(const tensor_layout_desc_t* d) { return d->h_stride > 0 ? d->h_stride : d->h; }
+
+// channels of one NHWC pixel or one NC1HWC2 block
+static size_t channel_block(const tensor_layout_desc_t* d)
+{
+    if (d->layout == TENSOR_LAYOUT_NHWC) {
+        return d->c_stride > 0 ? d->c_stride : d->c;
+    }
+    return d->layout == TENSOR_LAYOUT_NC1HWC2 ? d->c2 : 1;
+}
+
+static size_t element_offset(const tensor_layout_desc_t* d, int n, int c, int h, int w)
+{
+    size_t W = row_width(d), H = plane_height(d), B = channel_block(d);
+    switch (d->layout) {
+    case TENSOR_LAYOUT_NCHW:
+        return (((size_t)n * d->c + c) * H + h) * W + w;
+    case TENSOR_LAYOUT_NHWC:
+        return (((size_t)n * H + h) * W + w) * B + c;
+    default: {
+        size_t c1 = (d->c + B - 1) / B;
+        return ((((size_t)n * c1 + c / B) * H + h) * W + w) * B + c % B;
+    }
+    }
+}
+
+static size_t buffer_elems(const tensor_layout_desc_t* d)
+{
+    size_t B = channel_block(d);
+    size_t planes = d->layout == TENSOR_LAYOUT_NCHW ? (size_t)d->c : (d->c + B - 1) / B * B;
+    return (size_t)d->n * planes * plane_height(d) * row_width(d);
+}
+
+static void reference_convert(const uint8_t* src, const tensor_layout_desc_t* s, uint8_t* dst,
+                              const tensor_layout_desc_t* d, int elem_size)
+{
+    for (int n = 0; n < s->n; n++) {
+        for (int c = 0; c < s->c; c++) {
+            for (int h = 0; h < s->h; h++) {
+                for (int w = 0; w < s->w; w++) {
+                    memcpy(dst + element_offset(d, n, c, h, w) * elem_size,
+                           src + element_offset(s, n, c, h, w) * elem_size, elem_size);
+                }
+            }
+        }
+    }
+    // channel padding of the destination is zeroed
+    if (d->layout == TENSOR_LAYOUT_NCHW) {
+        return;
+    }
+    int padded = (int)((d->c + channel_block(d) - 1) / channel_block(d) * channel_block(d));
+    for (int n = 0; n < d->n; n++) {
+        for (int c = d->c; c < padded; c++) {
+            for (int h = 0; h < d->h; h++) {
+                for (int w = 0; w < d->w; w++) {
+                    size_t o = d->layout == TENSOR_LAYOUT_NHWC
+                                   ? (((size_t)n * plane_height(d) + h) * row_width(d) + w) * channel_block(d) + c
+                                   : element_offset(d, n, c, h, w);
+                    memset(dst + o * elem_size, 0, elem_size);
+                }
+            }
+        }
+    }
+}
+
+static void random_desc(tensor_layout_desc_t* d, int n, int c, int h, int w)
+{
+    const int c2s[5] = {4, 8, 16, 1, 3};
+    init_layout_desc(d, (tensor_layout_t)(rand() % 3), n, c, h, w, c2s[rand() % 5]);
+    if (rand() % 3 == 0) {
+        d->w_stride = w + rand() % 5;
+    }
+    if (rand() % 3 == 0) {
+        d->h_stride = h + rand() % 3;
+    }
+    if (d->layout == TENSOR_LAYOUT_NHWC && rand() % 3 == 0) {
+        d->c_stride = c + rand() % 4;
+    }
+}
+
+// every pair of layouts with random padding, element size and thread count, padding bytes untouched
+static int check_random(int cases)
+{
+    int fails = 0;
+    for (int k = 0; k < cases; k++) {
+        int n = 1 + rand() % 2, c = 1 + rand() % 40, h = 1 + rand() % 12, w = 1 + rand() % 50;
+        if (k % 50 == 0) {
+            // above the threading threshold
+            c = 64 + rand() % 200;
+            h = 20 + rand() % 40;
+            w = 20 + rand() % 80;
+        }
+        tensor_layout_desc_t s, d;
+        random_desc(&s, n, c, h, w);
+        random_desc(&d, n, c, h, w);
+        const int elem_sizes[3] = {1, 2, 4};
+        int elem_size = elem_sizes[rand() % 3];
+        size_t src_size = buffer_elems(&s) * elem_size;
+        size_t dst_size = buffer_elems(&d) * elem_size;
+        uint8_t* src = (uint8_t*)malloc(src_size);
+        uint8_t* dst = (uint8_t*)malloc(dst_size);
+        uint8_t* ref = (uint8_t*)malloc(dst_size);
+        for (size_t i = 0; i < src_size; i++) {
+            src[i] = (uint8_t)rand();
+        }
+        memset(dst, 0xAB, dst_size);
+        memset(ref, 0xAB, dst_size);
+        reference_convert(src, &s, ref, &d, elem_size);
+        int threads = rand() % 4;
+        if (convert_layout(src, &s, dst, &d, elem_size, threads) != 0 || memcmp(dst, ref, dst_size) != 0) {
+            if (fails++ < 5) {
+                printf("case %d: %s -> %s, %d byte, %dx%dx%dx%d, c2 %d/%d, %d threads differs\n", k,
+                       layout_name(s.layout), layout_name(d.layout), elem_size, n, c, h, w, s.c2, d.c2, threads);
+            }
+        }
+        free(src);
+        free(dst);
+        free(ref);
+    }
+    printf("%d random conversions, %d differ from the element copy\n", cases, fails);
+    return fails == 0 ? 0 : -1;
+}
+
+// time of the element copy, convert_layout on one thread and with its own thread count
+static int time_conversion(const char* name, const tensor_layout_desc_t* s, const tensor_layout_desc_t* d,
+                           int elem_size, void (*old_loop)(const void* src, void* dst, int c, int h, int w))
+{
+    size_t src_size = buffer_elems(s) * elem_size;
+    size_t dst_size = buffer_elems(d) * elem_size;
+    uint8_t* src = (uint8_t*)malloc(src_size);
+    uint8_t* dst = (uint8_t*)calloc(1, dst_size);
+    uint8_t* ref = (uint8_t*)calloc(1, dst_size);
+    for (size_t i = 0; i < src_size; i++) {
+        src[i] = (uint8_t)rand();
+    }
+    int reps = (int)(2e7 / (src_size + dst_size)) + 1;
+    double t0 = now_ms();
+    for (int r = 0; r < reps; r++) {
+        reference_convert(src, s, ref, d, elem_size);
+    }
+    double t_copy = (now_ms() - t0) / reps;
+    double t_old = 0.0;
+    if (old_loop != NULL) {
+        double t = now_ms();
+        for (int r = 0; r < reps; r++) {
+            old_loop(src, dst, s->c, s->h, s->w);
+        }
+        t_old = (now_ms() - t) / reps;
+    }
+    double t1 = now_ms();
+    for (int r = 0; r < reps; r++) {
+        convert_layout(src, s, dst, d, elem_size, 1);
+    }
+    double t2 = now_ms();
+    for (int r = 0; r < reps; r++) {
+        convert_layout(src, s, dst, d, elem_size, 0);
+    }
+    double t3 = now_ms();
+    int ret = memcmp(dst, ref, dst_size) == 0 ? 0 : -1;
+    printf("%-40s element copy %8.3f ms  ", name, t_copy);
+    if (old_loop != NULL) {
+        printf("replaced loop %7.3f ms  ", t_old);
+    }
+    printf("1 thread %7.3f ms  auto %7.3f ms%s\n", (t2 - t1) / reps, (t3 - t2) / reps, ret == 0 ? "" : "  DIFFERS");
+    free(src);
+    free(dst);
+    free(ref);
+    return ret;
+}
+
+// every layout pair and element size on a 1x64x80x80 tensor, c2 16 / 8 / 4 for 1 / 2 / 4 byte
+static int run_matrix(void)
+{
+    int ret = 0;
+    for (int elem_size = 1; elem_size <= 4; elem_size *= 2) {
+        for (int from = 0; from < 3; from++) {
+            for (int to = 0; to < 3; to++) {
+                tensor_layout_desc_t s, d;
+                init_layout_desc(&s, (tensor_layout_t)from, 1, 64, 80, 80, 16 / elem_size);
+                init_layout_desc(&d, (tensor_layout_t)to, 1, 64, 80, 80, 16 / elem_size);
+                char name[64];
+                snprintf(name, sizeof(name), "%d byte %s -> %s", elem_size, layout_name(s.layout),
+                         layout_name(d.layout));
+                ret |= time_conversion(name, &s, &d, elem_size, NULL);
+            }
+        }
+    }
+    return ret;
+}
+
+// the loops yolov8 zero-copy (NC1HWC2_i8_to_NCHW_i8) and mobilesam (rknn_nchw_2_nhwc) had
+static void old_nc1hwc2_i8_to_nchw(const void* src, void* dst, int c, int h, int w)
+{
+    const int c2 = 16;
+    int hw = h * w;
+    for (int k = 0; k < c; k++) {
+        const int8_t* s = (const int8_t*)src + (k / c2) * hw * c2;
+        int offset = k % c2;
+        for (int i = 0; i < hw; i++) {
+            ((int8_t*)dst)[k * hw + i] = s[c2 * i + offset];
+        }
+    }
+}
+
+static void old_nchw_to_nhwc_f32(const void* src, void* dst, int c, int h, int w)
+{
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            for (int k = 0; k < c; k++) {
+                memcpy((float*)dst + (y * w + x) * c + k, (const float*)src + k * h * w + y * w + x, sizeof(float));
+            }
+        }
+    }
+}
+
+typedef struct {
+    const char* name;
+    tensor_layout_t from, to;
+    int elem_size;
+    int c, h, w, c2;
+    int src_h_stride;
+    void (*old_loop)(const void* src, void* dst, int c, int h, int w);
+} call_site_t;
+
+static int run_call_sites(void)
+{
+    const call_site_t sites[] = {
+        {"yolov8 box 64x80x80 NC1HWC2 -> NCHW", TENSOR_LAYOUT_NC1HWC2, TENSOR_LAYOUT_NCHW, 1, 64, 80, 80, 16, 0,
+         old_nc1hwc2_i8_to_nchw},
+        {"yolov8 cls 80x80x80 NC1HWC2 -> NCHW", TENSOR_LAYOUT_NC1HWC2, TENSOR_LAYOUT_NCHW, 1, 80, 80, 80, 16, 0,
+         old_nc1hwc2_i8_to_nchw},
+        {"yolov8 cls 80x20x20 NC1HWC2 -> NCHW", TENSOR_LAYOUT_NC1HWC2, TENSOR_LAYOUT_NCHW, 1, 80, 20, 20, 16, 0,
+         old_nc1hwc2_i8_to_nchw},
+        {"mobilesam 256x64x64 f32 NCHW -> NHWC", TENSOR_LAYOUT_NCHW, TENSOR_LAYOUT_NHWC, 4, 256, 64, 64, 0, 0,
+         old_nchw_to_nhwc_f32},
+        {"deepface 3x224x224 f16 NCHW -> NC1HWC2", TENSOR_LAYOUT_NCHW, TENSOR_LAYOUT_NC1HWC2, 2, 3, 224, 224, 8, 0,
+         NULL},
+        {"deepface 512x7x7 f16 NC1HWC2 -> NCHW", TENSOR_LAYOUT_NC1HWC2, TENSOR_LAYOUT_NCHW, 2, 512, 7, 7, 8, 0, NULL},
+        {"lite_transformer kv 4x15x64 f32", TENSOR_LAYOUT_NCHW, TENSOR_LAYOUT_NHWC, 4, 4, 15, 64, 0, 16, NULL},
+    };
+    int ret = 0;
+    for (int i = 0; i < (int)(sizeof(sites) / sizeof(sites[0])); i++) {
+        const call_site_t* site = &sites[i];
+        tensor_layout_desc_t s, d;
+        init_layout_desc(&s, site->from, 1, site->c, site->h, site->w, site->c2);
+        init_layout_desc(&d, site->to, 1, site->c, site->h, site->w, site->c2);
+        s.h_stride = site->src_h_stride;
+        ret |= time_conversion(site->name, &s, &d, site->elem_size, site->old_loop);
+    }
+    return ret;
+}
+
+int main(int argc, char** argv)
+{
+    int cases = argc > 1 ? atoi(argv[1]) : 3000;
+    srand(1);
+    int ret = 0;
+    ret |= check_random(cases);
+    ret |= run_matrix();
+    ret |= run_call_sites();
+    printf("%s\n", ret == 0 ? "PASS" : "FAIL");
+    return ret == 0 ? 0 : 1;
+}
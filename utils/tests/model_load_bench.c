@@ -0,0 +1,159 @@
+// Startup time and resident memory of loading a model by read() copy vs map_model_file
+//
+// usage: model_load_bench [size_mb=64]
+// Each mode runs in a fresh child process with the file already in the page cache,
+// "touch" reads every page like rknn_init does. For mmap+crc the time includes waiting
+// for the background checksum in unmap_model_file, which rknn_init would normally hide.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "file_utils.h"
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static uint32_t crc32_bitwise(const unsigned char* data, size_t size)
+{
+    uint32_t crc = 0xffffffffu;
+    for (size_t i = 0; i < size; i++) {
+        crc ^= data[i];
+        for (int k = 0; k < 8; k++) {
+            crc = (crc >> 1) ^ (0xedb88320u & (0u - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+static long read_status_kb(const char* key)
+{
+    FILE* fp = fopen("/proc/self/status", "r");
+    if (fp == NULL) {
+        return -1;
+    }
+    char line[256];
+    long kb = -1;
+    size_t len = strlen(key);
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        if (strncmp(line, key, len) == 0 && line[len] == ':') {
+            kb = atol(line + len + 1);
+            break;
+        }
+    }
+    fclose(fp);
+    return kb;
+}
+
+static unsigned long touch_pages(const unsigned char* data, size_t size)
+{
+    unsigned long sum = 0;
+    for (size_t i = 0; i < size; i += 4096) {
+        sum += data[i];
+    }
+    return sum;
+}
+
+// 0: read copy; 1: mmap; 2: mmap with background crc check
+static int run_mode(const char* path, int mode)
+{
+    double start = now_ms();
+    unsigned long sum;
+    long anon_kb, file_kb;
+    if (mode == 0) {
+        char* data = NULL;
+        int size = read_data_from_file(path, &data);
+        if (size < 0) {
+            return -1;
+        }
+        sum = touch_pages((const unsigned char*)data, size);
+        anon_kb = read_status_kb("RssAnon");
+        file_kb = read_status_kb("RssFile");
+        free(data);
+    } else {
+        mapped_file_t file;
+        if (map_model_file(path, &file) != 0) {
+            return -1;
+        }
+        sum = touch_pages((const unsigned char*)file.data, file.size);
+        anon_kb = read_status_kb("RssAnon");
+        file_kb = read_status_kb("RssFile");
+        if (unmap_model_file(&file) != 0) {
+            printf("checksum mismatch\n");
+            return -1;
+        }
+    }
+    double elapsed = now_ms() - start;
+    static const char* names[] = {"read", "mmap", "mmap+crc"};
+    printf("%-10s %10.2f %12.1f %12.1f   (%lu)\n", names[mode], elapsed, anon_kb / 1024.0, file_kb / 1024.0, sum & 0xff);
+    fflush(stdout);
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    int size_mb = argc > 1 ? atoi(argv[1]) : 64;
+    if (size_mb <= 0) {
+        printf("usage: %s [size_mb]\n", argv[0]);
+        return -1;
+    }
+    size_t size = (size_t)size_mb << 20;
+    char path[] = "/tmp/model_load_bench_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        printf("mkstemp fail\n");
+        return -1;
+    }
+    unsigned char* data = (unsigned char*)malloc(size);
+    for (size_t i = 0; i < size; i++) {
+        data[i] = (unsigned char)(i * 2654435761u >> 13);
+    }
+    int ret = write(fd, data, size) == (ssize_t)size ? 0 : -1;
+    close(fd);
+    uint32_t crc = crc32_bitwise(data, size);
+    free(data);
+
+    char crc_path[64];
+    snprintf(crc_path, sizeof(crc_path), "%s.crc32", path);
+    printf("model %d MB, page cache warm\n", size_mb);
+    printf("%-10s %10s %12s %12s\n", "mode", "load ms", "RssAnon MB", "RssFile MB");
+    for (int mode = 0; mode < 3 && ret == 0; mode++) {
+        if (mode == 2) {
+            FILE* fp = fopen(crc_path, "w");
+            if (fp == NULL) {
+                ret = -1;
+                break;
+            }
+            fprintf(fp, "%08x\n", crc);
+            fclose(fp);
+        }
+        // first run of each mode only warms up
+        for (int run = 0; run < 2 && ret == 0; run++) {
+            fflush(stdout);
+            pid_t pid = fork();
+            if (pid == 0) {
+                if (run == 0) {
+                    freopen("/dev/null", "w", stdout);
+                }
+                _exit(run_mode(path, mode) == 0 ? 0 : 1);
+            }
+            int status = 0;
+            struct rusage usage;
+            if (pid < 0 || wait4(pid, &status, 0, &usage) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                ret = -1;
+            } else if (run == 1) {
+                printf("%-10s %10s peak rss %.1f MB\n", "", "", usage.ru_maxrss / 1024.0);
+            }
+        }
+    }
+    unlink(crc_path);
+    unlink(path);
+    return ret;
+}
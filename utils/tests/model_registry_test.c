@@ -0,0 +1,260 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "model_registry.h"
+
+// Context bookkeeping of the model registry against a recording stand-in for librknnrt:
+// which rknn_init / rknn_dup_context calls each flag leads to, reference counts, release,
+// and the footprint of N contexts. The stand-in reports a fixed model size: a context that
+// loads the weights allocates weights and internal memory, a dup or shared weight context only
+// internal memory. Real sizes need the board runtime.
+//   model_registry_test
+
+#define MAX_CALLS 64
+#define MAX_CONTEXTS 4096
+#define WEIGHT_SIZE (7 << 20)
+#define INTERNAL_SIZE (3 << 20)
+
+typedef struct {
+    int dup;                // 1: rknn_dup_context, 0: rknn_init
+    uint32_t flag;
+    int has_src;
+    rknn_context src;
+    rknn_context ctx;
+} init_call_t;
+
+static init_call_t g_calls[MAX_CALLS];
+static int g_num_calls = 0;
+static int g_live = 0;
+static rknn_context g_next = 1;
+// 1: the context loaded its own weights
+static unsigned char g_owns_weights[MAX_CONTEXTS];
+
+static void record(int dup, uint32_t flag, const rknn_context* src, rknn_context ctx)
+{
+    if (g_num_calls < MAX_CALLS) {
+        init_call_t* c = &g_calls[g_num_calls];
+        c->dup = dup;
+        c->flag = flag;
+        c->has_src = src != NULL;
+        c->src = src != NULL ? *src : 0;
+        c->ctx = ctx;
+    }
+    g_num_calls++;
+    g_live++;
+}
+
+int rknn_init(rknn_context* context, void* model, uint32_t size, uint32_t flag, rknn_init_extend* extend)
+{
+    *context = g_next++;
+    g_owns_weights[*context % MAX_CONTEXTS] = extend == NULL || !(flag & RKNN_FLAG_SHARE_WEIGHT_MEM);
+    record(0, flag, extend != NULL ? &extend->ctx : NULL, *context);
+    return 0;
+}
+
+int rknn_dup_context(rknn_context* context_in, rknn_context* context_out)
+{
+    *context_out = g_next++;
+    g_owns_weights[*context_out % MAX_CONTEXTS] = 0;
+    record(1, 0, context_in, *context_out);
+    return 0;
+}
+
+int rknn_destroy(rknn_context context)
+{
+    g_live--;
+    return 0;
+}
+
+int rknn_query(rknn_context context, rknn_query_cmd cmd, void* info, uint32_t size)
+{
+    memset(info, 0, size);
+    if (cmd == RKNN_QUERY_MEM_SIZE) {
+        rknn_mem_size* mem = (rknn_mem_size*)info;
+        mem->total_weight_size = WEIGHT_SIZE;
+        mem->total_internal_size = INTERNAL_SIZE;
+        mem->total_dma_allocated_size = INTERNAL_SIZE + (g_owns_weights[context % MAX_CONTEXTS] ? WEIGHT_SIZE : 0);
+    }
+    return 0;
+}
+
+static int write_model(const char* path)
+{
+    FILE* fp = fopen(path, "wb");
+    if (fp == NULL) {
+        printf("fopen %s fail!\n", path);
+        return -1;
+    }
+    fputs("RKNN", fp);
+    fclose(fp);
+    return 0;
+}
+
+// default flag: one init, every further context is a dup of it, the base is reused when idle
+static int check_dup_contexts(const char* path)
+{
+    int ret = 0;
+    int first = g_num_calls;
+    rknn_context ctx[4];
+    for (int i = 0; i < 4; i++) {
+        ret |= acquire_model_context(path, RKNN_FLAG_PRIOR_MEDIUM, &ctx[i]);
+    }
+    ret |= g_num_calls - first == 4 && !g_calls[first].dup && !g_calls[first].has_src &&
+                   g_calls[first].flag == RKNN_FLAG_PRIOR_MEDIUM
+               ? 0
+               : -1;
+    for (int i = 1; i < 4; i++) {
+        ret |= g_calls[first + i].dup && g_calls[first + i].src == ctx[0] ? 0 : -1;
+    }
+    model_footprint_t footprint;
+    ret |= get_model_footprint(ctx[2], &footprint) == 0 && footprint.instances == 4 && footprint.shared &&
+                   footprint.dma_size == WEIGHT_SIZE + 4 * INTERNAL_SIZE
+               ? 0
+               : -1;
+
+    ret |= release_model_context(ctx[0]);
+    rknn_context again;
+    ret |= acquire_model_context(path, RKNN_FLAG_PRIOR_MEDIUM, &again);
+    ret |= again == ctx[0] && g_num_calls - first == 4 ? 0 : -1;
+    int live = g_live;
+    for (int i = 1; i < 4; i++) {
+        ret |= release_model_context(ctx[i]);
+    }
+    ret |= g_live == live - 3 ? 0 : -1;
+    ret |= release_model_context(again);
+    ret |= g_live == live - 4 ? 0 : -1;
+    ret |= release_model_context(again) == -1 ? 0 : -1;
+    printf("rknn_dup_context instances: %s\n", ret == 0 ? "ok" : "fail");
+    return ret;
+}
+
+// RKNN_FLAG_SHARE_WEIGHT_MEM: the weight source is a plain init, the others share its weights
+static int check_shared_weights(const char* path)
+{
+    int ret = 0;
+    int first = g_num_calls;
+    const uint32_t flag = RKNN_FLAG_SHARE_WEIGHT_MEM | RKNN_FLAG_PRIOR_HIGH;
+    rknn_context ctx[3];
+    for (int i = 0; i < 3; i++) {
+        ret |= acquire_model_context(path, flag, &ctx[i]);
+    }
+    ret |= g_num_calls - first == 3 ? 0 : -1;
+    ret |= !g_calls[first].dup && !g_calls[first].has_src && g_calls[first].flag == (flag & ~RKNN_FLAG_SHARE_WEIGHT_MEM)
+               ? 0
+               : -1;
+    for (int i = 1; i < 3; i++) {
+        const init_call_t* c = &g_calls[first + i];
+        ret |= !c->dup && c->has_src && c->src == ctx[0] && c->flag == flag ? 0 : -1;
+    }
+
+    // the same file with another flag is a separate model, not the first caller's
+    rknn_context plain;
+    int before = g_num_calls;
+    ret |= acquire_model_context(path, 0, &plain);
+    ret |= g_num_calls - before == 1 && !g_calls[before].dup && !g_calls[before].has_src && g_calls[before].flag == 0
+               ? 0
+               : -1;
+    model_footprint_t footprint;
+    ret |= get_model_footprint(plain, &footprint) == 0 && footprint.instances == 1 ? 0 : -1;
+    ret |= get_model_footprint(ctx[1], &footprint) == 0 && footprint.instances == 3 ? 0 : -1;
+
+    ret |= release_model_context(plain);
+    for (int i = 0; i < 3; i++) {
+        ret |= release_model_context(ctx[i]);
+    }
+    printf("RKNN_FLAG_SHARE_WEIGHT_MEM instances and mixed flags: %s\n", ret == 0 ? "ok" : "fail");
+    return ret;
+}
+
+// N contexts by dup, by shared weight init and by private init: only the last loads the weights N times
+static int check_measure(const char* path, int instances)
+{
+    const struct {
+        const char* name;
+        uint32_t flag;
+        int shared;
+    } modes[] = {
+        {"rknn_dup_context", 0, 1},
+        {"RKNN_FLAG_SHARE_WEIGHT_MEM", RKNN_FLAG_SHARE_WEIGHT_MEM, 1},
+        {"private rknn_init", 0, 0},
+    };
+    const uint64_t expected[] = {
+        WEIGHT_SIZE + (uint64_t)instances * INTERNAL_SIZE,
+        WEIGHT_SIZE + (uint64_t)instances * INTERNAL_SIZE,
+        (uint64_t)instances * (WEIGHT_SIZE + INTERNAL_SIZE),
+    };
+    int ret = 0;
+    int live = g_live;
+    for (int m = 0; m < 3; m++) {
+        model_footprint_t footprint;
+        printf("%d contexts, %s:\n", instances, modes[m].name);
+        if (measure_model_footprint(path, instances, modes[m].flag, modes[m].shared, &footprint) != 0) {
+            ret = -1;
+            continue;
+        }
+        print_model_footprint(&footprint);
+        ret |= footprint.instances == instances && footprint.shared == modes[m].shared &&
+                       footprint.dma_size == expected[m]
+                   ? 0
+                   : -1;
+    }
+    // every measured context is gone again
+    ret |= g_live == live ? 0 : -1;
+    model_footprint_t none;
+    ret |= measure_model_footprint(path, 0, 0, 1, &none) == -1 && g_live == live ? 0 : -1;
+    printf("footprint of %d contexts: %s\n", instances, ret == 0 ? "ok" : "fail");
+    return ret;
+}
+
+typedef struct {
+    const char* path;
+    int ret;
+} thread_arg_t;
+
+static void* acquire_release(void* arg)
+{
+    thread_arg_t* a = (thread_arg_t*)arg;
+    for (int i = 0; i < 200; i++) {
+        rknn_context ctx;
+        if (acquire_model_context(a->path, 0, &ctx) != 0 || release_model_context(ctx) != 0) {
+            a->ret = -1;
+        }
+    }
+    return NULL;
+}
+
+int main(void)
+{
+    const char* path_a = "model_registry_test_a.rknn";
+    const char* path_b = "model_registry_test_b.rknn";
+    if (write_model(path_a) != 0 || write_model(path_b) != 0) {
+        return 1;
+    }
+    int ret = 0;
+    ret |= check_dup_contexts(path_a);
+    ret |= check_shared_weights(path_b);
+    ret |= check_measure(path_a, 4);
+
+    // contexts of several threads, all released at the end
+    pthread_t threads[4];
+    thread_arg_t args[4];
+    for (int i = 0; i < 4; i++) {
+        args[i].path = i % 2 ? path_a : path_b;
+        args[i].ret = 0;
+        pthread_create(&threads[i], NULL, acquire_release, &args[i]);
+    }
+    for (int i = 0; i < 4; i++) {
+        pthread_join(threads[i], NULL);
+        ret |= args[i].ret;
+    }
+    rknn_context ctx;
+    ret |= acquire_model_context("model_registry_test_missing.rknn", 0, &ctx) == -1 ? 0 : -1;
+    printf("threads: %d contexts live after release\n", g_live);
+    ret |= g_live == 0 ? 0 : -1;
+
+    remove(path_a);
+    remove(path_b);
+    printf("%s\n", ret == 0 ? "PASS" : "FAIL");
+    return ret == 0 ? 0 : 1;
+}
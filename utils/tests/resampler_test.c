@@ -0,0 +1,178 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "audio_utils.h"
+
+// Accuracy of the polyphase resampler: passband error and aliasing on pure tones,
+// streaming vs whole-buffer output, resample_audio and downmix_audio.
+//   resampler_test
+
+// passband tone error must stay below this, aliased tones above the output Nyquist too
+#define MAX_ERROR_DB (-80.0)
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static float* make_tone(int rate, double freq, int num_frames)
+{
+    float* x = (float*)malloc(num_frames * sizeof(float));
+    for (int i = 0; i < num_frames; i++) {
+        x[i] = (float)sin(2 * M_PI * freq * i / rate);
+    }
+    return x;
+}
+
+// chunk sizes cycle through chunks[] until the input is used up, 0 chunks: one call
+static int run_resampler(audio_resampler_t* resampler, const float* x, int num_frames, const int* chunks, int num_chunks,
+                         float** output)
+{
+    float* y = (float*)malloc(((long)audio_resampler_output_size(resampler, num_frames) +
+                               audio_resampler_output_size(resampler, 0)) * sizeof(float));
+    int m = 0;
+    if (num_chunks == 0) {
+        m = resample_chunk(resampler, x, num_frames, y);
+    } else {
+        for (int pos = 0, k = 0; pos < num_frames; k++) {
+            int c = chunks[k % num_chunks];
+            c = c < num_frames - pos ? c : num_frames - pos;
+            m += resample_chunk(resampler, x + pos, c, y + m);
+            pos += c;
+        }
+    }
+    m += resample_flush(resampler, y + m);
+    *output = y;
+    return m;
+}
+
+// error power of the tone relative to the tone, edges skipped
+static double tone_error_db(const float* y, int m, int rate, double freq)
+{
+    double err = 0.0, power = 0.0;
+    for (int i = rate / 10; i < m - rate / 10; i++) {
+        double ref = sin(2 * M_PI * freq * i / rate);
+        err += (y[i] - ref) * (y[i] - ref);
+        power += ref * ref;
+    }
+    return 10 * log10(err / power + 1e-30);
+}
+
+// power left of a tone the output cannot represent, relative to the input tone
+static double residual_db(const float* y, int m, int rate)
+{
+    double power = 0.0;
+    int count = 0;
+    for (int i = rate / 10; i < m - rate / 10; i++, count++) {
+        power += y[i] * y[i];
+    }
+    return 10 * log10(power / count / 0.5 + 1e-30);
+}
+
+static int check_rate_pair(int in_rate, int out_rate)
+{
+    const int chunks[5] = {1, 7, 333, 4097, 10};
+    int n = in_rate * 2;
+    int ret = 0;
+    audio_resampler_t resampler;
+    if (init_audio_resampler(&resampler, in_rate, out_rate) != 0) {
+        printf("init_audio_resampler %d -> %d fail\n", in_rate, out_rate);
+        return -1;
+    }
+
+    // tone at a quarter of the lower Nyquist
+    double freq = (in_rate < out_rate ? in_rate : out_rate) / 8.0;
+    float* x = make_tone(in_rate, freq, n);
+    float *whole, *chunked;
+    int m = run_resampler(&resampler, x, n, NULL, 0, &whole);
+    int mc = run_resampler(&resampler, x, n, chunks, 5, &chunked);
+    long long expected = ((long long)n * resampler.up + resampler.down - 1) / resampler.down;
+    double err_db = tone_error_db(whole, m, out_rate, freq);
+    int same = m == mc && memcmp(whole, chunked, m * sizeof(float)) == 0;
+    printf("%5d -> %5d: %d outputs (expected %lld), %.0f Hz error %.1f dB, chunked %s", in_rate, out_rate, m, expected,
+           freq, err_db, same ? "identical" : "DIFFERS");
+    ret |= m == expected && same && err_db < MAX_ERROR_DB ? 0 : -1;
+    free(chunked);
+    free(whole);
+    free(x);
+
+    // tone between the output and input Nyquist must be filtered out
+    if (in_rate > out_rate) {
+        double alias_freq = (out_rate / 2.0 + in_rate / 2.0) / 2.0;
+        alias_freq = alias_freq < out_rate / 2.0 + 1000 ? alias_freq : out_rate / 2.0 + 1000;
+        x = make_tone(in_rate, alias_freq, n);
+        m = run_resampler(&resampler, x, n, NULL, 0, &whole);
+        double alias_db = residual_db(whole, m, out_rate);
+        printf(", %.0f Hz alias %.1f dB", alias_freq, alias_db);
+        ret |= alias_db < MAX_ERROR_DB ? 0 : -1;
+        free(whole);
+        free(x);
+    }
+    printf("\n");
+    release_audio_resampler(&resampler);
+    return ret;
+}
+
+// resample_audio is the whole-buffer resampler and updates the buffer description
+static int check_resample_audio(void)
+{
+    int n = 48000 * 60;
+    float* x = make_tone(48000, 1000.0, n);
+    audio_resampler_t resampler;
+    init_audio_resampler(&resampler, 48000, 16000);
+    float* ref;
+    int m = run_resampler(&resampler, x, n, NULL, 0, &ref);
+    release_audio_resampler(&resampler);
+
+    audio_buffer_t audio = {x, n, 1, 48000};
+    double t0 = now_ms();
+    int status = resample_audio(&audio, 48000, 16000);
+    double t1 = now_ms();
+    int ret = status == 0 && audio.num_frames == m && audio.sample_rate == 16000 &&
+                      memcmp(audio.data, ref, m * sizeof(float)) == 0
+                  ? 0
+                  : -1;
+    printf("resample_audio 60 s 48000 -> 16000: %.1f ms, %s\n", t1 - t0, ret == 0 ? "ok" : "fail");
+    free(audio.data);
+    free(ref);
+
+    float stereo[4] = {1, 2, 3, 4};
+    audio_buffer_t two = {stereo, 2, 2, 16000};
+    ret |= resample_audio(&two, 16000, 8000) == -1 ? 0 : -1;
+    return ret;
+}
+
+static int check_downmix(void)
+{
+    float stereo[8] = {1, 3, 2, 4, 5, 7, -6, 8};
+    float three[6] = {3, 6, 9, 0, 0, 3};
+    float five[10] = {1, 2, 3, 4, 5, 5, 4, 3, 2, 1};
+    downmix_audio(stereo, 4, 2, stereo);
+    downmix_audio(three, 2, 3, three);
+    downmix_audio(five, 2, 5, five);
+    int ret = stereo[0] == 2 && stereo[1] == 3 && stereo[2] == 6 && stereo[3] == 1 && three[0] == 6 && three[1] == 1 &&
+                      five[0] == 3 && five[1] == 3
+                  ? 0
+                  : -1;
+    printf("downmix_audio 2/3/5 channels in place: %s\n", ret == 0 ? "ok" : "fail");
+    return ret;
+}
+
+int main(void)
+{
+    const int pairs[][2] = {{48000, 16000}, {44100, 16000}, {32000, 16000}, {22050, 16000},
+                            {11025, 16000}, {8000, 16000}, {16000, 48000}};
+    int ret = 0;
+    for (int i = 0; i < (int)(sizeof(pairs) / sizeof(pairs[0])); i++) {
+        ret |= check_rate_pair(pairs[i][0], pairs[i][1]);
+    }
+    ret |= check_resample_audio();
+    ret |= check_downmix();
+    printf("%s\n", ret == 0 ? "PASS" : "FAIL");
+    return ret == 0 ? 0 : 1;
+}
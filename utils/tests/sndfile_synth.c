@@ -0,0 +1,97 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sndfile.h"
+#include "sndfile_synth.h"
+
+typedef struct {
+    sf_count_t frames;
+    int channels;
+    sf_count_t error_frame; // -1: no error
+    sf_count_t pos;
+    int error;
+    synth_signal_t signal;
+} synth_file_t;
+
+static synth_signal_t g_signal = default_synth_signal;
+
+void set_synth_signal(synth_signal_t signal)
+{
+    g_signal = signal != NULL ? signal : default_synth_signal;
+}
+
+float default_synth_signal(long long frame, int channel)
+{
+    unsigned int h = (unsigned int)(frame * 2654435761u) ^ (unsigned int)(channel * 40503u);
+    h ^= h >> 15;
+    h *= 2246822519u;
+    h ^= h >> 13;
+    float noise = (float)(h & 0xffff) / 65536.0f - 0.5f;
+    return 0.5f * (float)sin(2 * M_PI * 440.0 * frame / 16000.0 + channel) + 0.1f * noise;
+}
+
+SNDFILE* sf_open(const char* path, int mode, SF_INFO* sfinfo)
+{
+    long long frames, error_frame = -1;
+    int rate, channels;
+    if (mode != SFM_READ ||
+        sscanf(path, "synth:%lld:%d:%d:%lld", &frames, &rate, &channels, &error_frame) < 3 || channels < 1) {
+        return NULL;
+    }
+    synth_file_t* file = (synth_file_t*)calloc(1, sizeof(synth_file_t));
+    file->frames = frames;
+    file->channels = channels;
+    file->error_frame = error_frame;
+    file->signal = g_signal;
+    memset(sfinfo, 0, sizeof(SF_INFO));
+    sfinfo->frames = frames;
+    sfinfo->samplerate = rate;
+    sfinfo->channels = channels;
+    sfinfo->format = SF_FORMAT_WAV | SF_FORMAT_FLOAT;
+    sfinfo->seekable = 1;
+    return (SNDFILE*)file;
+}
+
+int sf_close(SNDFILE* sndfile)
+{
+    free(sndfile);
+    return 0;
+}
+
+int sf_command(SNDFILE* sndfile, int command, void* data, int datasize)
+{
+    return 0;
+}
+
+int sf_error(SNDFILE* sndfile)
+{
+    return sndfile != NULL && ((synth_file_t*)sndfile)->error ? SF_ERR_MALFORMED_FILE : SF_ERR_NO_ERROR;
+}
+
+const char* sf_strerror(SNDFILE* sndfile)
+{
+    return "not a synth: path";
+}
+
+// frames up to the end or the error frame, then 0
+sf_count_t sf_readf_float(SNDFILE* sndfile, float* ptr, sf_count_t frames)
+{
+    synth_file_t* file = (synth_file_t*)sndfile;
+    sf_count_t end = file->error_frame >= 0 && file->error_frame < file->frames ? file->error_frame : file->frames;
+    sf_count_t n = end - file->pos < frames ? end - file->pos : frames;
+    for (sf_count_t i = 0; i < n; i++) {
+        for (int c = 0; c < file->channels; c++) {
+            ptr[i * file->channels + c] = file->signal(file->pos + i, c);
+        }
+    }
+    file->pos += n;
+    file->error = n == 0 && end < file->frames;
+    return n;
+}
+
+sf_count_t sf_writef_float(SNDFILE* sndfile, const float* ptr, sf_count_t frames)
+{
+    return 0;
+}
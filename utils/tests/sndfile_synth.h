@@ -0,0 +1,37 @@
+#ifndef _RKNN_MODEL_ZOO_SNDFILE_SYNTH_H_
+#define _RKNN_MODEL_ZOO_SNDFILE_SYNTH_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Stand-in libsndfile for host tests whose files are generated instead of read.
+// A path "synth:<frames>:<rate>:<channels>[:<error frame>]" opens a file of that many frames,
+// decoding stops with SF_ERR_MALFORMED_FILE at the error frame. Other paths fail to open.
+
+/**
+ * @brief Sample of a generated file
+ *
+ * @param frame [in] Frame index from the start of the file
+ * @param channel [in] Channel
+ * @return float Sample
+ */
+typedef float (*synth_signal_t)(long long frame, int channel);
+
+/**
+ * @brief Set the samples of the files opened from now on, NULL restores the default tone and noise
+ *
+ * @param signal [in] Signal
+ */
+void set_synth_signal(synth_signal_t signal);
+
+/**
+ * @brief Default sample, a 440 Hz tone at 16 kHz with noise, different on every channel
+ */
+float default_synth_signal(long long frame, int channel);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif // _RKNN_MODEL_ZOO_SNDFILE_SYNTH_H_
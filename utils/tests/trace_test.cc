@@ -0,0 +1,183 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "trace_utils.h"
+
+// Stage histograms and trace capture: every bucket up to the largest duration, percentiles of
+// a log-normal latency sample against the sorted sample, zones of several threads written as
+// Chrome trace JSON, and the cost of a zone with and without event capture.
+//   trace_test
+
+static double now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// one duration at a time: exact below 32ns, else the bucket middle, at most 1/32 off;
+// the neighbouring stage must stay empty up to the last bucket
+static int check_buckets()
+{
+    int bad = 0, n = 0;
+    for (int k = 0; k < 64; k++) {
+        uint64_t low = (uint64_t)1 << k;
+        uint64_t values[3] = {low, low + low / 3, low + (low - 1)};
+        for (int j = 0; j < 3; j++) {
+            uint64_t v = values[j];
+            trace_reset();
+            trace_record(TRACE_STAGE_RUN, "rknn_run", 0, v);
+            trace_stage_stats_t run, next;
+            trace_get_stage_stats(TRACE_STAGE_RUN, &run);
+            trace_get_stage_stats(TRACE_STAGE_OUTPUTS_GET, &next);
+            double expected = v / 1000.0;
+            double err = fabs(run.p50_us - expected) / expected;
+            if ((run.count != 1 || next.count != 0 || err > (v < 32 ? 0.0 : 1.0 / 32 + 1e-9)) && bad++ < 5) {
+                printf("%llu ns: count %llu, p50 %.3f us (relative error %.4f), next stage count %llu\n",
+                       (unsigned long long)v, (unsigned long long)run.count, run.p50_us, err,
+                       (unsigned long long)next.count);
+            }
+            n++;
+        }
+    }
+    trace_reset();
+    printf("%d durations from 1ns to 2^64-1ns: %d in the wrong bucket\n", n, bad);
+    return bad == 0 ? 0 : -1;
+}
+
+static int check_percentiles()
+{
+    std::mt19937_64 rng(1);
+    std::lognormal_distribution<double> latency(13.0, 1.0);   // median ~0.44ms
+    std::vector<uint64_t> values;
+    for (int i = 0; i < 200000; i++) {
+        uint64_t v = (uint64_t)latency(rng);
+        values.push_back(v);
+        trace_record(TRACE_STAGE_POSTPROCESS, "post_process", 1000, 1000 + v);
+    }
+    std::sort(values.begin(), values.end());
+    trace_stage_stats_t stats;
+    trace_get_stage_stats(TRACE_STAGE_POSTPROCESS, &stats);
+    const double quantiles[3] = {0.50, 0.90, 0.99};
+    const double measured[3] = {stats.p50_us, stats.p90_us, stats.p99_us};
+    int ret = stats.count == values.size() && stats.max_us == values.back() / 1000.0 ? 0 : -1;
+    for (int q = 0; q < 3; q++) {
+        double expected = values[(size_t)(quantiles[q] * values.size()) - 1] / 1000.0;
+        double err = fabs(measured[q] / expected - 1.0);
+        printf("p%.0f %.3f us, sorted sample %.3f us, relative error %.4f\n", quantiles[q] * 100, measured[q],
+               expected, err);
+        ret |= err <= 0.035 ? 0 : -1;
+    }
+    trace_reset();
+    return ret;
+}
+
+static void* run_zones(void* arg)
+{
+    long id = (long)arg;
+    for (int i = 0; i < 1000; i++) {
+        TRACE_ZONE(TRACE_STAGE_RUN, "rknn_run");
+        uint64_t begin = trace_now_ns();
+        while (trace_now_ns() - begin < 1000 * (uint64_t)(1 + id)) {
+        }
+    }
+    return NULL;
+}
+
+static int count_occurrences(const char* text, const char* pattern)
+{
+    int n = 0;
+    for (const char* p = strstr(text, pattern); p != NULL; p = strstr(p + 1, pattern)) {
+        n++;
+    }
+    return n;
+}
+
+// 4 threads x 1000 zones and one zone whose name needs escaping, all in the file
+static int check_threads_and_json()
+{
+    const char* path = "trace_test.json";
+    trace_set_event_capture(1);
+    pthread_t threads[4];
+    for (long i = 0; i < 4; i++) {
+        pthread_create(&threads[i], NULL, run_zones, (void*)i);
+    }
+    for (int i = 0; i < 4; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    {
+        TRACE_ZONE(TRACE_STAGE_NONE, "main \"quoted\"");
+    }
+    trace_set_event_capture(0);
+    trace_stage_stats_t stats;
+    trace_get_stage_stats(TRACE_STAGE_RUN, &stats);
+    trace_print_stats();
+    if (trace_write_json(path) != 0) {
+        return -1;
+    }
+
+    FILE* fp = fopen(path, "rb");
+    if (fp == NULL) {
+        printf("fopen %s fail!\n", path);
+        return -1;
+    }
+    std::vector<char> text(1 << 20);
+    size_t size = fread(&text[0], 1, text.size() - 1, fp);
+    fclose(fp);
+    text[size] = '\0';
+    int events = count_occurrences(&text[0], "\"ph\":\"X\"");
+    int run_events = count_occurrences(&text[0], "{\"name\":\"rknn_run\",\"cat\":\"run\"");
+    int quoted = count_occurrences(&text[0], "{\"name\":\"main \\\"quoted\\\"\",\"cat\":\"zone\"");
+    int ret = stats.count == 4000 && events == 4001 && run_events == 4000 && quoted == 1 &&
+                      strncmp(&text[0], "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", 39) == 0 &&
+                      strcmp(&text[size - 4], "\n]}\n") == 0
+                  ? 0
+                  : -1;
+    printf("4 threads: %llu run zones, %d events in %s (%zu bytes): %s\n", (unsigned long long)stats.count, events,
+           path, size, ret == 0 ? "ok" : "fail");
+    remove(path);
+    trace_reset();
+    return ret;
+}
+
+// empty zones, histogram only and with capture (within one thread buffer)
+static void time_zones()
+{
+    const int n = 1000000;
+    double t0 = now_ms();
+    for (int i = 0; i < n; i++) {
+        TRACE_ZONE(TRACE_STAGE_PREPROCESS, "convert_image");
+    }
+    double t1 = now_ms();
+    const int captured = 4000;
+    trace_set_event_capture(1);
+    double t2 = now_ms();
+    for (int i = 0; i < captured; i++) {
+        TRACE_ZONE(TRACE_STAGE_PREPROCESS, "convert_image");
+    }
+    double t3 = now_ms();
+    trace_set_event_capture(0);
+    trace_reset();
+    printf("zone cost: %.1f ns histogram only, %.1f ns with capture\n", (t1 - t0) * 1e6 / n,
+           (t3 - t2) * 1e6 / captured);
+}
+
+int main()
+{
+    int ret = 0;
+    ret |= check_buckets();
+    ret |= check_percentiles();
+    ret |= check_threads_and_json();
+    time_zones();
+    printf("%s\n", ret == 0 ? "PASS" : "FAIL");
+    return ret == 0 ? 0 : 1;
+}
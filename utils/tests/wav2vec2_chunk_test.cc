@@ -0,0 +1,303 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <string>
+#include <vector>
+
+#include "model_registry.h"
+#include "sndfile_synth.h"
+#include "wav2vec2.h"
+
+// Chunked wav2vec2 recognition with the model replaced by a frame decoder: audio of 1s to 1h
+// streamed from a generated file, chunks stitched with ctc_stitch must give the tokens of a
+// decode of the whole utterance, also where tokens lie across the middle of a chunk overlap.
+// The stand-in model is wrong near the chunk edges like a model without context and aligns
+// tokens differently from one chunk to the next.
+//   wav2vec2_chunk_test [max seconds]
+
+#define FRAME_STRIDE ((N_SAMPLES - CHUNK_OVERLAP * SAMPLE_RATE) / SAMPLES_PER_FRAME)
+#define EDGE_FRAMES 20
+
+static std::vector<int> g_labels; // frame ids of the whole utterance
+static int g_runs = 0;
+static int g_binds = 0;
+static int g_inputs_set = 0;
+static rknn_tensor_mem* g_input_mem = NULL;
+static float g_logits[OUTPUT_SIZE * VOCAB_NUM];
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+int acquire_model_context(const char* model_path, uint32_t flag, rknn_context* ctx)
+{
+    *ctx = 1;
+    return 0;
+}
+
+int release_model_context(rknn_context ctx)
+{
+    return 0;
+}
+
+int rknn_query(rknn_context context, rknn_query_cmd cmd, void* info, uint32_t size)
+{
+    if (cmd == RKNN_QUERY_IN_OUT_NUM) {
+        rknn_input_output_num* io_num = (rknn_input_output_num*)info;
+        io_num->n_input = 1;
+        io_num->n_output = 1;
+        return 0;
+    }
+    rknn_tensor_attr* attr = (rknn_tensor_attr*)info;
+    attr->type = RKNN_TENSOR_FLOAT16;
+    attr->n_dims = 2;
+    attr->dims[0] = 1;
+    if (cmd == RKNN_QUERY_INPUT_ATTR) {
+        attr->dims[1] = N_SAMPLES;
+        attr->n_elems = N_SAMPLES;
+    } else {
+        attr->n_dims = 3;
+        attr->dims[1] = OUTPUT_SIZE;
+        attr->dims[2] = VOCAB_NUM;
+        attr->n_elems = OUTPUT_SIZE * VOCAB_NUM;
+    }
+    attr->size = attr->n_elems * 2;
+    return 0;
+}
+
+rknn_tensor_mem* rknn_create_mem(rknn_context ctx, uint32_t size)
+{
+    rknn_tensor_mem* mem = (rknn_tensor_mem*)calloc(1, sizeof(rknn_tensor_mem));
+    mem->virt_addr = calloc(1, size);
+    mem->size = size;
+    return mem;
+}
+
+int rknn_destroy_mem(rknn_context ctx, rknn_tensor_mem* mem)
+{
+    g_input_mem = g_input_mem == mem ? NULL : g_input_mem;
+    free(mem->virt_addr);
+    free(mem);
+    return 0;
+}
+
+int rknn_set_io_mem(rknn_context ctx, rknn_tensor_mem* mem, rknn_tensor_attr* attr)
+{
+    if (attr->index != 0 || attr->type != RKNN_TENSOR_FLOAT32 || mem->size < N_SAMPLES * sizeof(float)) {
+        return -1;
+    }
+    g_input_mem = mem;
+    g_binds++;
+    return 0;
+}
+
+int rknn_inputs_set(rknn_context context, uint32_t n_inputs, rknn_input inputs[])
+{
+    g_inputs_set++;
+    return -1;
+}
+
+static int wrong_id(int id)
+{
+    return id == BLANK_ID ? 5 : id % (VOCAB_NUM - 1) + 1;
+}
+
+// id of a frame from the mean of its samples
+static int frame_id(const float* samples)
+{
+    float sum = 0;
+    for (int j = 0; j < SAMPLES_PER_FRAME; j++) {
+        sum += samples[j];
+    }
+    int id = (int)((sum / SAMPLES_PER_FRAME + 1.0f) * 0.5f * VOCAB_NUM);
+    return id < 0 ? 0 : (id >= VOCAB_NUM ? VOCAB_NUM - 1 : id);
+}
+
+// frame ids of the chunk, wrong near the edges that have audio beyond them; every other chunk
+// ends its tokens up to two frames later, the same tokens with other alignment
+int rknn_run(rknn_context context, rknn_run_extend* extend)
+{
+    if (g_input_mem == NULL) {
+        return -1;
+    }
+    const float* input = (const float*)g_input_mem->virt_addr;
+    long long chunk_start = (long long)g_runs * FRAME_STRIDE;
+    int ids[OUTPUT_SIZE];
+    for (int i = 0; i < OUTPUT_SIZE; i++) {
+        ids[i] = frame_id(&input[i * SAMPLES_PER_FRAME]);
+    }
+    for (int i = 0; g_runs % 2 == 1 && i + 2 < OUTPUT_SIZE; i++) {
+        if (ids[i] == BLANK_ID || ids[i + 1] != BLANK_ID || ids[i + 2] == ids[i]) {
+            continue;
+        }
+        // two frames later when two blanks follow, one otherwise, never into the next token
+        int late = ids[i + 2] == BLANK_ID && (i + 3 == OUTPUT_SIZE || ids[i + 3] != ids[i]) ? 2 : 1;
+        for (int j = 1; j <= late; j++) {
+            ids[i + j] = ids[i];
+        }
+        i += late;
+    }
+    memset(g_logits, 0, sizeof(g_logits));
+    for (int i = 0; i < OUTPUT_SIZE; i++) {
+        if ((g_runs > 0 && i < EDGE_FRAMES) ||
+            (i >= OUTPUT_SIZE - EDGE_FRAMES && chunk_start + OUTPUT_SIZE < (long long)g_labels.size())) {
+            ids[i] = wrong_id(ids[i]);
+        }
+        g_logits[i * VOCAB_NUM + ids[i]] = 1.0f;
+    }
+    g_runs++;
+    return 0;
+}
+
+int rknn_outputs_get(rknn_context context, uint32_t n_outputs, rknn_output outputs[], rknn_output_extend* extend)
+{
+    if (!outputs[0].is_prealloc || outputs[0].size < sizeof(g_logits)) {
+        return -1;
+    }
+    memcpy(outputs[0].buf, g_logits, sizeof(g_logits));
+    return 0;
+}
+
+int rknn_outputs_release(rknn_context context, uint32_t n_ouputs, rknn_output outputs[])
+{
+    return 0;
+}
+
+// a frame carries its id as the level of its samples
+static float label_signal(long long frame, int channel)
+{
+    int id = g_labels[frame / SAMPLES_PER_FRAME];
+    float noise = (float)((frame * 7919) % 101 - 50) / 50.0f * 0.2f / VOCAB_NUM;
+    return (id + 0.5f) / VOCAB_NUM * 2.0f - 1.0f + noise;
+}
+
+// tokens of 1-5 frames with 0-3 blanks between them; the middle of each chunk overlap is
+// - after an odd chunk: a blank just after a token, which the late chunk still holds
+// - else every other overlap: inside a token
+// - else: in an overlap without any blank
+static void make_labels(int num_frames)
+{
+    g_labels.assign(num_frames, BLANK_ID);
+    unsigned int seed = (unsigned int)num_frames;
+    for (int f = 0; f < num_frames;) {
+        seed = seed * 1103515245u + 12345u;
+        int token = 4 + (int)((seed >> 8) % (VOCAB_NUM - 4));
+        int len = 1 + (int)((seed >> 16) % 5);
+        int gap = (int)((seed >> 24) % 4);
+        for (int i = 0; i < len && f < num_frames; i++) {
+            g_labels[f++] = token;
+        }
+        f += gap;
+    }
+    for (int k = 1; (long long)k * FRAME_STRIDE < num_frames; k++) {
+        int begin = k * FRAME_STRIDE;
+        int end = begin + OUTPUT_SIZE - FRAME_STRIDE;
+        int middle = (begin + end) / 2;
+        int token = 4 + k % (VOCAB_NUM - 4);
+        for (int f = middle - 6; f <= middle + 6 && f < num_frames; f++) {
+            if (k % 2 == 1) {
+                g_labels[f] = f < middle - 3 || f > middle + 3 ? 5 : (f < middle - 1 ? token : BLANK_ID);
+            } else if (k % 4 == 2) {
+                g_labels[f] = f == middle - 6 || f == middle + 6 ? BLANK_ID : token;
+            }
+        }
+        for (int f = begin - 5; k % 4 == 0 && f < end + 5 && f < num_frames; f++) {
+            g_labels[f] = 5 + (f / 3) % 3;
+        }
+    }
+}
+
+static int run_length(long long num_samples, double* rtf)
+{
+    int num_frames = (int)((num_samples + SAMPLES_PER_FRAME - 1) / SAMPLES_PER_FRAME);
+    make_labels(num_frames);
+    // the whole utterance through the model at once, the last frame partly zero padding
+    std::vector<int> whole(num_frames);
+    std::vector<float> frame(SAMPLES_PER_FRAME);
+    for (int f = 0; f < num_frames; f++) {
+        for (int j = 0; j < SAMPLES_PER_FRAME; j++) {
+            long long i = (long long)f * SAMPLES_PER_FRAME + j;
+            frame[j] = i < num_samples ? label_signal(i, 0) : 0.0f;
+        }
+        whole[f] = frame_id(&frame[0]);
+    }
+    std::vector<std::string> expected;
+    ctc_decode(whole, expected);
+
+    char path[64];
+    snprintf(path, sizeof(path), "synth:%lld:%d:1", num_samples, SAMPLE_RATE);
+    set_synth_signal(label_signal);
+    audio_source_t source;
+    if (open_audio_source(path, SAMPLE_RATE, 1, &source) != 0) {
+        return -1;
+    }
+    rknn_app_context_t app_ctx;
+    memset(&app_ctx, 0, sizeof(app_ctx));
+    g_binds = 0;
+    g_inputs_set = 0;
+    if (init_wav2vec2_model("stub.rknn", &app_ctx) != 0) {
+        close_audio_source(&source);
+        return -1;
+    }
+    std::vector<std::string> text;
+    g_runs = 0;
+    double t0 = now_ms();
+    int ret = inference_wav2vec2_chunked(&app_ctx, &source, text);
+    double ms = now_ms() - t0;
+    close_audio_source(&source);
+    release_wav2vec2_model(&app_ctx);
+    set_synth_signal(NULL);
+
+    double seconds = (double)num_samples / SAMPLE_RATE;
+    *rtf = ms / 1000.0 / seconds;
+    int same = ret == 0 && text == expected;
+    printf("%8.2f s: %4d chunks, %6zu tokens %s, %d input binds, %d rknn_inputs_set, %.1f ms, RTF %.5f\n", seconds,
+           g_runs, text.size(), same ? "identical" : "DIFFERENT", g_binds, g_inputs_set, ms, *rtf);
+    return same && g_binds == 1 && g_inputs_set == 0 && g_input_mem == NULL ? 0 : -1;
+}
+
+// two chunks agreeing on a token over the middle of their overlap, without any common blank
+static int check_stitch_without_blank()
+{
+    std::vector<int> whole(OUTPUT_SIZE + FRAME_STRIDE, 7);
+    std::vector<int> ids(whole.begin(), whole.begin() + OUTPUT_SIZE);
+    ctc_stitch(ids, &whole[FRAME_STRIDE], FRAME_STRIDE, OUTPUT_SIZE);
+    std::vector<std::string> expected, text;
+    ctc_decode(whole, expected);
+    ctc_decode(ids, text);
+    int ret = ids.size() == whole.size() && text == expected ? 0 : -1;
+    printf("one token over the whole overlap: %zu frames, %zu tokens: %s\n", ids.size(), text.size(),
+           ret == 0 ? "ok" : "fail");
+    return ret;
+}
+
+int main(int argc, char** argv)
+{
+    int max_seconds = argc > 1 ? atoi(argv[1]) : 3600;
+    // shorter than a chunk, one and two chunks exactly, a frame more, longer audio
+    const long long lengths[] = {SAMPLE_RATE,
+                                 N_SAMPLES,
+                                 N_SAMPLES + SAMPLES_PER_FRAME,
+                                 N_SAMPLES + FRAME_STRIDE * SAMPLES_PER_FRAME,
+                                 60LL * SAMPLE_RATE + 123,
+                                 600LL * SAMPLE_RATE,
+                                 3600LL * SAMPLE_RATE};
+    int ret = check_stitch_without_blank();
+    double max_rtf = 0;
+    for (int i = 0; i < (int)(sizeof(lengths) / sizeof(lengths[0])); i++) {
+        if (lengths[i] > (long long)max_seconds * SAMPLE_RATE) {
+            break;
+        }
+        double rtf;
+        ret |= run_length(lengths[i], &rtf);
+        max_rtf = rtf > max_rtf ? rtf : max_rtf;
+    }
+    printf("model stubbed, largest RTF %.5f\n", max_rtf);
+    printf("%s\n", ret == 0 ? "PASS" : "FAIL");
+    return ret == 0 ? 0 : 1;
+}
@@ -0,0 +1,249 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <vector>
+
+#include "half_utils.h"
+#include "whisper.h"
+
+// Token picked by the whisper decoder from fp16 logits (argmax_logits_fp16) and from float logits
+// (argmax_logits) against a float argmax over the same values: random rows, ties, all negative,
+// +-inf, +-0, maxima on and around the suppressed tokens and the timestamps, short rows.
+//   whisper_argmax_test [rows]
+
+#define TIMESTAMP_BEGIN 50364
+
+static const int g_suppress[] = {50258, 50358, 50359, 50360, 50361, 50362, 50363};
+static const int g_n_suppress = sizeof(g_suppress) / sizeof(g_suppress[0]);
+
+static const uint16_t HALF_INF = 0x7c00;
+static const uint16_t HALF_NEG_INF = 0xfc00;
+static const uint16_t HALF_NEG_ZERO = 0x8000;
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static float rand_float(float lo, float hi)
+{
+    return lo + (hi - lo) * (float)rand() / (float)RAND_MAX;
+}
+
+static bool suppressed(int token, const int* suppress, int n_suppress)
+{
+    for (int s = 0; s < n_suppress; s++) {
+        if (suppress[s] == token) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// first token of [0, n) with the largest value, skipping the suppressed ones
+static int reference_argmax(const float* logits, int n, const int* suppress, int n_suppress)
+{
+    int index = -1;
+    for (int i = 0; i < n; i++) {
+        if (!suppressed(i, suppress, n_suppress) && (index < 0 || logits[i] > logits[index])) {
+            index = i;
+        }
+    }
+    return index;
+}
+
+// both argmax versions on one row of fp16 logits
+static int check_row(const char* name, const std::vector<uint16_t>& row, int n, const int* suppress, int n_suppress)
+{
+    std::vector<float> values(row.size());
+    half_to_float_array(&row[0], &values[0], (int)row.size());
+    int expected = reference_argmax(&values[0], n, suppress, n_suppress);
+    int fp16 = argmax_logits_fp16(&row[0], n, suppress, n_suppress);
+    int fp32 = argmax_logits(&values[0], n, suppress, n_suppress);
+    if (fp16 != expected || fp32 != expected) {
+        printf("%s, n %d: fp16 %d, float %d, expected %d\n", name, n, fp16, fp32, expected);
+        return -1;
+    }
+    return 0;
+}
+
+static std::vector<uint16_t> random_row(float lo, float hi)
+{
+    std::vector<uint16_t> row(VOCAB_NUM);
+    for (int i = 0; i < VOCAB_NUM; i++) {
+        row[i] = float_to_half(rand_float(lo, hi));
+    }
+    return row;
+}
+
+// random rows, mostly with the largest value written at a chosen place
+static int check_random(int rows)
+{
+    int ret = 0;
+    for (int r = 0; r < rows; r++) {
+        std::vector<uint16_t> row = random_row(-20, 10);
+        int at = rand() % VOCAB_NUM;
+        if (r % 4 != 0) {
+            row[at] = float_to_half(rand_float(10, 30));
+        }
+        ret |= check_row("random", row, TIMESTAMP_BEGIN, g_suppress, g_n_suppress);
+    }
+    printf("%d random rows: %s\n", rows, ret == 0 ? "ok" : "fail");
+    return ret;
+}
+
+// equal maxima, the first allowed one wins; in a suppressed token or a timestamp it never does
+static int check_ties()
+{
+    int ret = 0;
+    const int places[][3] = {{5, 6, 7}, {100, 50000, 50257}, {50258, 50259, 60}, {50363, 50364, 50300},
+                             {50364, 51000, 50257}, {0, 1, 2}, {7, 8, 9}, {8, 16, 24}};
+    for (int p = 0; p < (int)(sizeof(places) / sizeof(places[0])); p++) {
+        std::vector<uint16_t> row = random_row(-5, 5);
+        for (int k = 0; k < 3; k++) {
+            row[places[p][k]] = float_to_half(12.5f);
+        }
+        ret |= check_row("ties", row, TIMESTAMP_BEGIN, g_suppress, g_n_suppress);
+    }
+    // a whole row of one value
+    std::vector<uint16_t> flat(VOCAB_NUM, float_to_half(-3.0f));
+    ret |= check_row("flat", flat, TIMESTAMP_BEGIN, g_suppress, g_n_suppress);
+    // -0 before +0, equal as floats
+    std::vector<uint16_t> zeros = random_row(-5, -1);
+    zeros[300] = HALF_NEG_ZERO;
+    zeros[301] = 0;
+    zeros[40000] = 0;
+    ret |= check_row("+-0", zeros, TIMESTAMP_BEGIN, g_suppress, g_n_suppress);
+    zeros[300] = 0;
+    zeros[301] = HALF_NEG_ZERO;
+    ret |= check_row("+-0", zeros, TIMESTAMP_BEGIN, g_suppress, g_n_suppress);
+    printf("ties: %s\n", ret == 0 ? "ok" : "fail");
+    return ret;
+}
+
+static int check_negative()
+{
+    int ret = 0;
+    for (int r = 0; r < 8; r++) {
+        std::vector<uint16_t> row = random_row(-60000, -0.001f);
+        ret |= check_row("negative", row, TIMESTAMP_BEGIN, g_suppress, g_n_suppress);
+    }
+    std::vector<uint16_t> tiny = random_row(-1e-6f, -1e-7f); // subnormal fp16
+    ret |= check_row("negative subnormal", tiny, TIMESTAMP_BEGIN, g_suppress, g_n_suppress);
+    printf("negative rows: %s\n", ret == 0 ? "ok" : "fail");
+    return ret;
+}
+
+static int check_inf()
+{
+    int ret = 0;
+    std::vector<uint16_t> row = random_row(-10, 10);
+    // +inf in a suppressed token and a timestamp is never picked
+    row[50360] = HALF_INF;
+    row[50500] = HALF_INF;
+    ret |= check_row("+inf suppressed", row, TIMESTAMP_BEGIN, g_suppress, g_n_suppress);
+    row[1234] = HALF_INF;
+    row[4321] = HALF_INF;
+    ret |= check_row("+inf", row, TIMESTAMP_BEGIN, g_suppress, g_n_suppress);
+    std::vector<uint16_t> low(VOCAB_NUM, HALF_NEG_INF);
+    ret |= check_row("all -inf", low, TIMESTAMP_BEGIN, g_suppress, g_n_suppress);
+    low[50259] = float_to_half(-65504.0f);
+    ret |= check_row("-inf and the fp16 minimum", low, TIMESTAMP_BEGIN, g_suppress, g_n_suppress);
+    low[50259] = HALF_NEG_INF;
+    low[50262] = HALF_NEG_ZERO;
+    ret |= check_row("-inf and -0", low, TIMESTAMP_BEGIN, g_suppress, g_n_suppress);
+    printf("+-inf: %s\n", ret == 0 ? "ok" : "fail");
+    return ret;
+}
+
+// the largest value on each suppressed token, next to it and around n
+static int check_suppressed()
+{
+    int ret = 0;
+    std::vector<int> places;
+    for (int s = 0; s < g_n_suppress; s++) {
+        places.push_back(g_suppress[s] - 1);
+        places.push_back(g_suppress[s]);
+        places.push_back(g_suppress[s] + 1);
+    }
+    places.push_back(TIMESTAMP_BEGIN - 1);
+    places.push_back(TIMESTAMP_BEGIN);
+    places.push_back(VOCAB_NUM - 1);
+    for (size_t p = 0; p < places.size(); p++) {
+        std::vector<uint16_t> row = random_row(-10, 10);
+        row[places[p]] = float_to_half(50.0f);
+        ret |= check_row("suppressed", row, TIMESTAMP_BEGIN, g_suppress, g_n_suppress);
+    }
+    // everything suppressed: -1
+    const int all[] = {0, 1, 2, 3, 4};
+    std::vector<uint16_t> row = random_row(-10, 10);
+    ret |= check_row("all suppressed", row, 5, all, 5);
+    ret |= check_row("all suppressed", row, 3, all, 5);
+    ret |= check_row("empty", row, 0, all, 5);
+    // suppressed tokens at and past n
+    const int past[] = {2, 40, 41, 50000};
+    ret |= check_row("suppressed past n", row, 41, past, 4);
+    printf("%zu maxima around suppressed tokens and timestamps: %s\n", places.size(), ret == 0 ? "ok" : "fail");
+    return ret;
+}
+
+// every short row length, so both the vector loop and its tail are hit at every offset
+static int check_short(int rows)
+{
+    int ret = 0;
+    const int suppress[] = {3, 4, 17};
+    for (int r = 0; r < rows; r++) {
+        std::vector<uint16_t> row = random_row(-3, 3);
+        for (int i = 0; i < (int)row.size(); i++) {
+            row[i] = float_to_half(roundf(half_to_float(row[i]) * 2) / 2); // many ties
+        }
+        for (int n = 0; n <= 40; n++) {
+            ret |= check_row("short", row, n, suppress, 3);
+        }
+    }
+    printf("rows of 0 to 40 tokens: %s\n", ret == 0 ? "ok" : "fail");
+    return ret;
+}
+
+// one decode step: fp16 argmax against converting the row to float first
+static void time_argmax()
+{
+    std::vector<uint16_t> row = random_row(-20, 20);
+    std::vector<float> values(VOCAB_NUM);
+    const int loops = 200;
+    int sink = 0;
+    double t0 = now_ms();
+    for (int l = 0; l < loops; l++) {
+        sink += argmax_logits_fp16(&row[0], TIMESTAMP_BEGIN, g_suppress, g_n_suppress);
+    }
+    double t1 = now_ms();
+    for (int l = 0; l < loops; l++) {
+        half_to_float_array(&row[0], &values[0], VOCAB_NUM);
+        sink += argmax_logits(&values[0], TIMESTAMP_BEGIN, g_suppress, g_n_suppress);
+    }
+    double t2 = now_ms();
+    printf("%d tokens: fp16 argmax %.3f ms, float conversion + argmax %.3f ms (%d)\n", VOCAB_NUM, (t1 - t0) / loops,
+           (t2 - t1) / loops, sink % 2);
+}
+
+int main(int argc, char** argv)
+{
+    int rows = argc > 1 ? atoi(argv[1]) : 200;
+    srand(7);
+    int ret = 0;
+    ret |= check_random(rows);
+    ret |= check_ties();
+    ret |= check_negative();
+    ret |= check_inf();
+    ret |= check_suppressed();
+    ret |= check_short(rows / 10 + 1);
+    time_argmax();
+    printf("%s\n", ret == 0 ? "PASS" : "FAIL");
+    return ret == 0 ? 0 : 1;
+}
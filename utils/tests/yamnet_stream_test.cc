@@ -0,0 +1,157 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <vector>
+
+#include "yamnet_stream.h"
+
+// Streaming sound classifier of the yamnet demo with the model replaced by tone detectors:
+// the same clip pushed in blocks of different sizes must give identical events, at the
+// times the tones were placed, and the stream must keep up with real time.
+//   yamnet_stream_test [seconds]
+
+#define NUM_TONES 3
+
+static const float g_tone_hz[NUM_TONES] = {440.0f, 1000.0f, 2500.0f};
+// [start, end) seconds of each tone
+static const float g_tone_time[NUM_TONES][2] = {{4.0f, 16.0f}, {12.0f, 30.0f}, {40.0f, 52.0f}};
+
+static int g_windows = 0;
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// stands in for the model: class c scores the share of the window where tone c is present
+int run_yamnet_window(rknn_app_context_t* app_ctx, float* window, float* mean_scores)
+{
+    memset(mean_scores, 0, LABEL_NUM * sizeof(float));
+    const int block = SAMPLE_RATE / 10;
+    for (int b = 0; b + block <= N_SAMPLES; b += block) {
+        for (int c = 0; c < NUM_TONES; c++) {
+            // goertzel power of the tone in this block
+            float coeff = 2.0f * cosf(2.0f * (float)M_PI * g_tone_hz[c] / SAMPLE_RATE);
+            float s1 = 0, s2 = 0;
+            for (int i = 0; i < block; i++) {
+                float s = window[b + i] + coeff * s1 - s2;
+                s2 = s1;
+                s1 = s;
+            }
+            float power = (s1 * s1 + s2 * s2 - coeff * s1 * s2) / ((float)block * block / 4);
+            mean_scores[c] += power > 0.01f ? 1.0f : 0.0f;
+        }
+    }
+    for (int c = 0; c < NUM_TONES; c++) {
+        mean_scores[c] /= N_SAMPLES / block;
+    }
+    g_windows++;
+    return 0;
+}
+
+static std::vector<float> make_clip(int seconds)
+{
+    std::vector<float> pcm((size_t)seconds * SAMPLE_RATE);
+    unsigned int seed = 1;
+    for (size_t i = 0; i < pcm.size(); i++) {
+        float t = (float)i / SAMPLE_RATE;
+        float s = 0.02f * ((float)(seed = seed * 1103515245u + 12345u) / 4294967296.0f - 0.5f);
+        for (int c = 0; c < NUM_TONES; c++) {
+            if (t >= g_tone_time[c][0] && t < g_tone_time[c][1]) {
+                s += 0.3f * sinf(2.0f * (float)M_PI * g_tone_hz[c] * t);
+            }
+        }
+        pcm[i] = s;
+    }
+    return pcm;
+}
+
+static void collect_event(void* userdata, const sound_event_t* event)
+{
+    ((std::vector<sound_event_t>*)userdata)->push_back(*event);
+}
+
+static int run_stream(const std::vector<float>& pcm, int block, std::vector<sound_event_t>* events, double* ms)
+{
+    rknn_app_context_t app_ctx;
+    memset(&app_ctx, 0, sizeof(app_ctx));
+    sound_stream_t stream;
+    if (init_sound_stream(&stream, &app_ctx, NULL, collect_event, events) != 0) {
+        return -1;
+    }
+    double t0 = now_ms();
+    int ret = 0;
+    for (size_t pos = 0; pos < pcm.size() && ret == 0; pos += block) {
+        int n = pcm.size() - pos < (size_t)block ? (int)(pcm.size() - pos) : block;
+        ret = sound_stream_push(&stream, &pcm[pos], n);
+    }
+    if (ret == 0) {
+        ret = sound_stream_flush(&stream);
+    }
+    *ms = now_ms() - t0;
+    release_sound_stream(&stream);
+    return ret;
+}
+
+static int same_events(const std::vector<sound_event_t>& a, const std::vector<sound_event_t>& b)
+{
+    if (a.size() != b.size()) {
+        return 0;
+    }
+    for (size_t i = 0; i < a.size(); i++) {
+        if (memcmp(&a[i], &b[i], sizeof(sound_event_t)) != 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// each tone is one event, starting at most a window before it and ending at most a window after
+static int check_onsets(const std::vector<sound_event_t>& events)
+{
+    int ret = events.size() == NUM_TONES ? 0 : -1;
+    for (size_t i = 0; i < events.size(); i++) {
+        const sound_event_t* e = &events[i];
+        printf("class %d: %.2f - %.2f s, peak %.2f\n", e->index, e->start, e->end, e->peak);
+        if (e->index >= NUM_TONES || e->start < g_tone_time[e->index][0] - CHUNK_LENGTH ||
+            e->start > g_tone_time[e->index][0] + CHUNK_LENGTH || e->end < g_tone_time[e->index][1] ||
+            e->end > g_tone_time[e->index][1] + 2 * CHUNK_LENGTH || e->top[0] != e->index) {
+            ret = -1;
+        }
+    }
+    return ret;
+}
+
+int main(int argc, char** argv)
+{
+    int seconds = argc > 1 ? atoi(argv[1]) : 60;
+    std::vector<float> pcm = make_clip(seconds);
+
+    const int blocks[] = {1, 160, 1000, 4096, SAMPLE_RATE, N_SAMPLES + 7, (int)pcm.size()};
+    const int num_blocks = (int)(sizeof(blocks) / sizeof(blocks[0]));
+    std::vector<sound_event_t> reference;
+    int ret = 0;
+    for (int b = 0; b < num_blocks; b++) {
+        std::vector<sound_event_t> events;
+        double ms;
+        g_windows = 0;
+        if (run_stream(pcm, blocks[b], &events, &ms) != 0) {
+            return 1;
+        }
+        if (b == 0) {
+            reference = events;
+            ret |= check_onsets(events);
+        }
+        int same = same_events(events, reference);
+        ret |= same ? 0 : -1;
+        printf("block %7d samples: %d windows, %zu events %s, %.2f ms for %d s, RTF %.5f\n", blocks[b], g_windows,
+               events.size(), same ? "identical" : "DIFFERENT", ms, seconds, ms / 1000.0 / seconds);
+    }
+    printf("%s\n", ret == 0 ? "PASS" : "FAIL");
+    return ret == 0 ? 0 : 1;
+}
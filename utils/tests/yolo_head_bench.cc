@@ -0,0 +1,484 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <vector>
+
+#include "yolo_head.h"
+
+// decode_head per YOLO variant, element type and layout on a synthetic 640x640 output,
+// against a dequantize-then-decode loop in the shape of the per-demo post-processors.
+//   yolo_head_bench [repeat]
+
+using namespace yolo_head;
+
+#define NUM_CLASS 80
+#define BOX_THRESH 0.25f
+
+static const int g_grids[3] = {80, 40, 20};
+static const int g_strides[3] = {8, 16, 32};
+static const int g_anchors[3][6] = {{10, 13, 16, 30, 33, 23}, {30, 61, 62, 45, 59, 119}, {116, 90, 156, 198, 373, 326}};
+
+static double now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+struct detections {
+    std::vector<float> boxes;
+    std::vector<float> scores;
+    std::vector<int> class_ids;
+    void clear()
+    {
+        boxes.clear();
+        scores.clear();
+        class_ids.clear();
+    }
+};
+
+// one quantized branch output in every element type and layout
+struct branch_t {
+    int channels;
+    int grid_len;
+    int32_t zp;
+    float scale;
+    std::vector<int8_t> i8_nchw, i8_nhwc;
+    std::vector<uint8_t> u8_nchw;
+    std::vector<float> f32_nchw;
+
+    tensor_t<int8_t> tensor(const std::vector<int8_t>& data) const
+    {
+        tensor_t<int8_t> t = {data.data(), zp, scale};
+        return t;
+    }
+    tensor_t<uint8_t> tensor(const std::vector<uint8_t>& data) const
+    {
+        tensor_t<uint8_t> t = {data.data(), zp + 128, scale};
+        return t;
+    }
+    tensor_t<float> tensor(const std::vector<float>& data) const
+    {
+        tensor_t<float> t = {data.data(), 0, 1.0f};
+        return t;
+    }
+};
+
+// q(channel, cell) in [-128, 127], stored as int8 nchw and converted to the others
+static void finish_branch(branch_t* b)
+{
+    int n = b->channels * b->grid_len;
+    b->i8_nhwc.resize(n);
+    b->u8_nchw.resize(n);
+    b->f32_nchw.resize(n);
+    for (int c = 0; c < b->channels; c++) {
+        for (int idx = 0; idx < b->grid_len; idx++) {
+            int8_t q = b->i8_nchw[c * b->grid_len + idx];
+            b->i8_nhwc[idx * b->channels + c] = q;
+            b->u8_nchw[c * b->grid_len + idx] = (uint8_t)(q + 128);
+            b->f32_nchw[c * b->grid_len + idx] = ((float)q - (float)b->zp) * b->scale;
+        }
+    }
+}
+
+// scores mostly low, about 3% of the cells hot
+static int score_q(bool hot) { return hot ? rand() % 256 - 128 : rand() % 38 - 128; }
+
+static branch_t make_objectness_branch(int num_anchor, int grid_size)
+{
+    branch_t b;
+    b.channels = num_anchor * (5 + NUM_CLASS);
+    b.grid_len = grid_size * grid_size;
+    b.zp = -128;
+    b.scale = 1.0f / 255;
+    b.i8_nchw.resize(b.channels * b.grid_len);
+    for (int idx = 0; idx < b.grid_len; idx++) {
+        for (int a = 0; a < num_anchor; a++) {
+            bool hot = rand() % 100 < 3;
+            for (int k = 0; k < 5 + NUM_CLASS; k++) {
+                int q = k < 4 ? rand() % 256 - 128 : score_q(hot && (k == 4 || rand() % 10 == 0));
+                b.i8_nchw[(a * (5 + NUM_CLASS) + k) * b.grid_len + idx] = (int8_t)q;
+            }
+        }
+    }
+    finish_branch(&b);
+    return b;
+}
+
+struct distance_branch_t {
+    branch_t box, score, sum;
+};
+
+static distance_branch_t make_distance_branch(int dfl_len, int grid_size)
+{
+    distance_branch_t d;
+    int grid_len = grid_size * grid_size;
+    d.box.channels = 4 * dfl_len;
+    d.score.channels = NUM_CLASS;
+    d.sum.channels = 1;
+    d.box.zp = -20;
+    d.box.scale = dfl_len > 1 ? 0.08f : 0.05f;
+    d.score.zp = d.sum.zp = -128;
+    d.score.scale = 1.0f / 255;
+    d.sum.scale = 4.0f / 255;
+    branch_t* all[3] = {&d.box, &d.score, &d.sum};
+    for (int k = 0; k < 3; k++) {
+        all[k]->grid_len = grid_len;
+        all[k]->i8_nchw.resize(all[k]->channels * grid_len);
+    }
+    for (int idx = 0; idx < grid_len; idx++) {
+        bool hot = rand() % 100 < 3;
+        float sum = 0.0f;
+        for (int c = 0; c < NUM_CLASS; c++) {
+            int q = score_q(hot && rand() % 10 == 0);
+            d.score.i8_nchw[c * grid_len + idx] = (int8_t)q;
+            sum += (q - d.score.zp) * d.score.scale;
+        }
+        d.sum.i8_nchw[idx] = (int8_t)fminf(127.0f, sum / d.sum.scale + d.sum.zp);
+        for (int k = 0; k < 4 * dfl_len; k++) {
+            // plain distances stay positive
+            d.box.i8_nchw[k * grid_len + idx] = (int8_t)(dfl_len > 1 ? rand() % 256 - 128 : rand() % 80 - 20);
+        }
+    }
+    for (int k = 0; k < 3; k++) {
+        finish_branch(all[k]);
+    }
+    return d;
+}
+
+// ---------------------------------------------------------------- reference decoders
+
+template <typename T>
+struct ref_tensor_t {
+    const T* data;
+    int32_t zp;
+    float scale;
+    int cell_step;
+    int channel_step;
+
+    T at(int c, int idx) const { return data[idx * cell_step + c * channel_step]; }
+    float value(int c, int idx) const { return element_traits<T>::dequantize(at(c, idx), zp, scale); }
+};
+
+template <typename T>
+static ref_tensor_t<T> ref_tensor(tensor_t<T> t, int channels, int grid_len, bool nhwc)
+{
+    ref_tensor_t<T> r = {t.data, t.zp, t.scale, nhwc ? channels : 1, nhwc ? 1 : grid_len};
+    return r;
+}
+
+static void push(detections* d, float x, float y, float w, float h, float score, int class_id)
+{
+    d->boxes.push_back(x);
+    d->boxes.push_back(y);
+    d->boxes.push_back(w);
+    d->boxes.push_back(h);
+    d->scores.push_back(score);
+    d->class_ids.push_back(class_id);
+}
+
+// one objectness cell: filter on objectness, best class * objectness, then the box
+template <typename T>
+static void ref_objectness_cell(const ref_tensor_t<T>& t, const int* anchors, int a, int i, int j, int grid_w,
+                                int stride, T obj_thres, detections* d)
+{
+    const int base = a * (5 + NUM_CLASS);
+    const int idx = i * grid_w + j;
+    if (t.at(base + 4, idx) < obj_thres) {
+        return;
+    }
+    float max_prob = t.value(base + 5, idx);
+    int max_class_id = 0;
+    for (int c = 1; c < NUM_CLASS; c++) {
+        float prob = t.value(base + 5 + c, idx);
+        if (prob > max_prob) {
+            max_prob = prob;
+            max_class_id = c;
+        }
+    }
+    float score = max_prob * t.value(base + 4, idx);
+    if (score < BOX_THRESH) {
+        return;
+    }
+    float bx = t.value(base + 0, idx), by = t.value(base + 1, idx);
+    float bw = t.value(base + 2, idx), bh = t.value(base + 3, idx);
+    float w, h, x, y;
+    if (anchors != NULL) {
+        w = (bw * 2.0f) * (bw * 2.0f) * (float)anchors[a * 2];
+        h = (bh * 2.0f) * (bh * 2.0f) * (float)anchors[a * 2 + 1];
+        x = (bx * 2.0f - 0.5f + j) * (float)stride - w * 0.5f;
+        y = (by * 2.0f - 0.5f + i) * (float)stride - h * 0.5f;
+    } else {
+        w = expf(bw) * (float)stride;
+        h = expf(bh) * (float)stride;
+        x = (bx + j) * (float)stride - w * 0.5f;
+        y = (by + i) * (float)stride - h * 0.5f;
+    }
+    push(d, x, y, w, h, score, max_class_id);
+}
+
+// anchors NULL: yolox, cells in the order decode_head appends them
+template <typename T>
+static void ref_objectness(tensor_t<T> output, const int* anchors, int num_anchor, int grid_size, int stride,
+                           bool nhwc, detections* d)
+{
+    const int grid_len = grid_size * grid_size;
+    ref_tensor_t<T> t = ref_tensor(output, num_anchor * (5 + NUM_CLASS), grid_len, nhwc);
+    const T obj_thres = element_traits<T>::quantize(BOX_THRESH, output.zp, output.scale);
+    for (int outer = 0; outer < (nhwc ? grid_len : num_anchor); outer++) {
+        for (int inner = 0; inner < (nhwc ? num_anchor : grid_len); inner++) {
+            int idx = nhwc ? outer : inner;
+            int a = nhwc ? inner : outer;
+            ref_objectness_cell(t, anchors, a, idx / grid_size, idx % grid_size, grid_size, stride, obj_thres, d);
+        }
+    }
+}
+
+// dequantize the distribution, float softmax
+template <typename T>
+static float ref_distance(const ref_tensor_t<T>& box, int side, int idx, int dfl_len)
+{
+    if (dfl_len == 1) {
+        return box.value(side, idx);
+    }
+    float exp_t[64];
+    float exp_sum = 0.0f;
+    float acc_sum = 0.0f;
+    for (int k = 0; k < dfl_len; k++) {
+        exp_t[k] = expf(box.value(side * dfl_len + k, idx));
+        exp_sum += exp_t[k];
+    }
+    for (int k = 0; k < dfl_len; k++) {
+        acc_sum += exp_t[k] / exp_sum * k;
+    }
+    return acc_sum;
+}
+
+template <typename T>
+static void ref_distance_box(const ref_tensor_t<T>& box, int idx, int i, int j, int dfl_len, int stride, float xywh[4])
+{
+    float x1 = (-ref_distance(box, 0, idx, dfl_len) + j + 0.5f) * (float)stride;
+    float y1 = (-ref_distance(box, 1, idx, dfl_len) + i + 0.5f) * (float)stride;
+    float x2 = (ref_distance(box, 2, idx, dfl_len) + j + 0.5f) * (float)stride;
+    float y2 = (ref_distance(box, 3, idx, dfl_len) + i + 0.5f) * (float)stride;
+    xywh[0] = x1;
+    xywh[1] = y1;
+    xywh[2] = x2 - x1;
+    xywh[3] = y2 - y1;
+}
+
+template <typename T>
+static void ref_distance_head(tensor_t<T> box, tensor_t<T> score, tensor_t<T> score_sum, int dfl_len, bool multi_label,
+                              int grid_size, int stride, bool nhwc, detections* d)
+{
+    typedef element_traits<T> E;
+    const int grid_len = grid_size * grid_size;
+    ref_tensor_t<T> b = ref_tensor(box, 4 * dfl_len, grid_len, nhwc);
+    ref_tensor_t<T> s = ref_tensor(score, NUM_CLASS, grid_len, nhwc);
+    ref_tensor_t<T> sum = ref_tensor(score_sum, 1, grid_len, nhwc);
+    const T score_thres = E::quantize(BOX_THRESH, score.zp, score.scale);
+    const T sum_thres = E::quantize(BOX_THRESH, score_sum.zp, score_sum.scale);
+    for (int i = 0; i < grid_size; i++) {
+        for (int j = 0; j < grid_size; j++) {
+            int idx = i * grid_size + j;
+            if (score_sum.data != NULL && sum.at(0, idx) < sum_thres) {
+                continue;
+            }
+            float xywh[4];
+            if (multi_label) {
+                for (int c = 0; c < NUM_CLASS; c++) {
+                    if (s.at(c, idx) > score_thres) {
+                        ref_distance_box(b, idx, i, j, dfl_len, stride, xywh);
+                        push(d, xywh[0], xywh[1], xywh[2], xywh[3], s.value(c, idx), c);
+                    }
+                }
+                continue;
+            }
+            int max_class_id = 0;
+            for (int c = 1; c < NUM_CLASS; c++) {
+                if (s.at(c, idx) > s.at(max_class_id, idx)) {
+                    max_class_id = c;
+                }
+            }
+            if (s.at(max_class_id, idx) > score_thres) {
+                ref_distance_box(b, idx, i, j, dfl_len, stride, xywh);
+                push(d, xywh[0], xywh[1], xywh[2], xywh[3], s.value(max_class_id, idx), max_class_id);
+            }
+        }
+    }
+}
+
+// ---------------------------------------------------------------- runs
+
+// same boxes in the same order, scores and classes exact, coordinates within max_box_diff pixels
+static int compare(const detections& a, const detections& b, float max_box_diff, float* box_diff)
+{
+    *box_diff = 0.0f;
+    if (a.scores.size() != b.scores.size()) {
+        return -1;
+    }
+    for (size_t k = 0; k < a.boxes.size(); k++) {
+        *box_diff = fmaxf(*box_diff, fabsf(a.boxes[k] - b.boxes[k]));
+    }
+    for (size_t k = 0; k < a.scores.size(); k++) {
+        if (a.scores[k] != b.scores[k] || a.class_ids[k] != b.class_ids[k]) {
+            return -1;
+        }
+    }
+    return *box_diff <= max_box_diff ? 0 : -1;
+}
+
+// ref and head each decode all three branches into a detections, timed best of repeat interleaved rounds
+template <typename Ref, typename Head>
+static int run(const char* name, int repeat, float max_box_diff, Ref ref, Head head)
+{
+    detections a, b;
+    ref(&a);
+    head(&b);
+    float box_diff;
+    int ret = compare(a, b, max_box_diff, &box_diff);
+    double t_ref = 1e9, t_head = 1e9;
+    const int iters = 10;
+    for (int r = 0; r < repeat; r++) {
+        double t0 = now_ms();
+        for (int k = 0; k < iters; k++) {
+            a.clear();
+            ref(&a);
+        }
+        double t1 = now_ms();
+        for (int k = 0; k < iters; k++) {
+            b.clear();
+            head(&b);
+        }
+        double t2 = now_ms();
+        t_ref = fmin(t_ref, (t1 - t0) / iters);
+        t_head = fmin(t_head, (t2 - t1) / iters);
+    }
+    printf("%-28s %5zu boxes (reference %5zu)  max box diff %.1e  reference %7.3f ms  decode_head %7.3f ms  %5.2fx  %s\n",
+           name, b.scores.size(), a.scores.size(), box_diff, t_ref, t_head, t_ref / t_head, ret == 0 ? "ok" : "FAIL");
+    return ret;
+}
+
+template <typename Layout, typename T, typename Scheme>
+static int run_objectness(const char* name, int repeat, const branch_t* branches, const std::vector<T> branch_t::*data,
+                          const Scheme* schemes, const int (*anchors)[6], int num_anchor)
+{
+    const bool nhwc = !Layout::planar;
+    return run(
+        name, repeat, 0.0f,
+        [&](detections* d) {
+            for (int k = 0; k < 3; k++) {
+                ref_objectness(branches[k].tensor(branches[k].*data), anchors ? anchors[k] : NULL, num_anchor,
+                               g_grids[k], g_strides[k], nhwc, d);
+            }
+        },
+        [&](detections* d) {
+            for (int k = 0; k < 3; k++) {
+                grid_t grid = {g_grids[k], g_grids[k], g_strides[k]};
+                decode_head<NUM_CLASS, Layout>(schemes[k], branches[k].tensor(branches[k].*data), grid, BOX_THRESH,
+                                               d->boxes, d->scores, d->class_ids);
+            }
+        });
+}
+
+template <typename Layout, typename T, bool MULTI_LABEL>
+static int run_distance(const char* name, int repeat, const distance_branch_t* branches,
+                        const std::vector<T> branch_t::*data, int dfl_len, bool with_sum)
+{
+    const bool nhwc = !Layout::planar;
+    // table softmax against float softmax, in grid units times the largest stride
+    const float max_box_diff = dfl_len > 1 ? 32 * 2e-4f : 0.0f;
+    return run(
+        name, repeat, max_box_diff,
+        [&](detections* d) {
+            for (int k = 0; k < 3; k++) {
+                const distance_branch_t& br = branches[k];
+                tensor_t<T> sum = br.sum.tensor(br.sum.*data);
+                if (!with_sum) {
+                    sum.data = NULL;
+                }
+                ref_distance_head(br.box.tensor(br.box.*data), br.score.tensor(br.score.*data), sum, dfl_len,
+                                  MULTI_LABEL, g_grids[k], g_strides[k], nhwc, d);
+            }
+        },
+        [&](detections* d) {
+            for (int k = 0; k < 3; k++) {
+                const distance_branch_t& br = branches[k];
+                tensor_t<T> sum = br.sum.tensor(br.sum.*data);
+                if (!with_sum) {
+                    sum.data = NULL;
+                }
+                grid_t grid = {g_grids[k], g_grids[k], g_strides[k]};
+                decode_head<NUM_CLASS, Layout>(distance_scheme<MULTI_LABEL>(dfl_len), br.box.tensor(br.box.*data),
+                                               br.score.tensor(br.score.*data), sum, grid, BOX_THRESH, d->boxes,
+                                               d->scores, d->class_ids);
+            }
+        });
+}
+
+int main(int argc, char** argv)
+{
+    int repeat = argc > 1 ? atoi(argv[1]) : 20;
+    if (repeat <= 0) {
+        repeat = 1;
+    }
+    srand(7);
+    int ret = 0;
+
+    // yolov5 / yolov7: three anchors per cell
+    branch_t anchor_branches[3], free_branches[3];
+    for (int k = 0; k < 3; k++) {
+        anchor_branches[k] = make_objectness_branch(3, g_grids[k]);
+        free_branches[k] = make_objectness_branch(1, g_grids[k]);
+    }
+    const anchor_scheme<3> anchor_schemes[3] = {anchor_scheme<3>(g_anchors[0]), anchor_scheme<3>(g_anchors[1]),
+                                                anchor_scheme<3>(g_anchors[2])};
+    ret |= run_objectness<nchw_layout>("yolov5/7 i8 nchw", repeat, anchor_branches, &branch_t::i8_nchw,
+                                       anchor_schemes, g_anchors, 3);
+    ret |= run_objectness<nchw_layout>("yolov5/7 u8 nchw", repeat, anchor_branches, &branch_t::u8_nchw,
+                                       anchor_schemes, g_anchors, 3);
+    ret |= run_objectness<nchw_layout>("yolov5/7 fp32 nchw", repeat, anchor_branches, &branch_t::f32_nchw,
+                                       anchor_schemes, g_anchors, 3);
+    ret |= run_objectness<nhwc_layout>("yolov5/7 i8 nhwc", repeat, anchor_branches, &branch_t::i8_nhwc,
+                                       anchor_schemes, g_anchors, 3);
+
+    // yolox: anchor free, one prediction per cell
+    const anchor_free_scheme free_schemes[3];
+    ret |= run_objectness<nchw_layout>("yolox i8 nchw", repeat, free_branches, &branch_t::i8_nchw, free_schemes,
+                                       NULL, 1);
+    ret |= run_objectness<nchw_layout>("yolox fp32 nchw", repeat, free_branches, &branch_t::f32_nchw, free_schemes,
+                                       NULL, 1);
+    ret |= run_objectness<nhwc_layout>("yolox i8 nhwc", repeat, free_branches, &branch_t::i8_nhwc, free_schemes,
+                                       NULL, 1);
+
+    // yolov8/11, ppyoloe: 16 bin distributions; yolov6: plain distances; yolov10: multi-label
+    distance_branch_t dfl_branches[3], plain_branches[3];
+    for (int k = 0; k < 3; k++) {
+        dfl_branches[k] = make_distance_branch(16, g_grids[k]);
+        plain_branches[k] = make_distance_branch(1, g_grids[k]);
+    }
+    ret |= run_distance<nchw_layout, int8_t, false>("yolov8 i8 nchw", repeat, dfl_branches, &branch_t::i8_nchw, 16,
+                                                    true);
+    ret |= run_distance<nchw_layout, uint8_t, false>("yolov8 u8 nchw", repeat, dfl_branches, &branch_t::u8_nchw, 16,
+                                                     true);
+    ret |= run_distance<nchw_layout, float, false>("yolov8 fp32 nchw", repeat, dfl_branches, &branch_t::f32_nchw, 16,
+                                                   true);
+    ret |= run_distance<nhwc_layout, int8_t, false>("yolov8 i8 nhwc", repeat, dfl_branches, &branch_t::i8_nhwc, 16,
+                                                    true);
+    ret |= run_distance<nchw_layout, int8_t, false>("yolov8 i8 nchw no score sum", repeat, dfl_branches,
+                                                    &branch_t::i8_nchw, 16, false);
+    ret |= run_distance<nchw_layout, int8_t, false>("yolov6 i8 nchw", repeat, plain_branches, &branch_t::i8_nchw, 1,
+                                                    true);
+    ret |= run_distance<nchw_layout, float, false>("yolov6 fp32 nchw", repeat, plain_branches, &branch_t::f32_nchw, 1,
+                                                   true);
+    ret |= run_distance<nchw_layout, int8_t, true>("yolov10 i8 nchw", repeat, dfl_branches, &branch_t::i8_nchw, 16,
+                                                   true);
+    ret |= run_distance<nhwc_layout, int8_t, true>("yolov10 i8 nhwc", repeat, dfl_branches, &branch_t::i8_nhwc, 16,
+                                                   true);
+
+    printf("%s\n", ret == 0 ? "PASS" : "FAIL");
+    return ret == 0 ? 0 : 1;
+}
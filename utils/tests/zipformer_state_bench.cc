@@ -0,0 +1,281 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <vector>
+
+#include "half_utils.h"
+#include "zipformer.h"
+
+// Encoder state handling of the zipformer demo per chunk, built once as is and once with
+// ZIPFORMER_COPY_STATES: a stand-in runtime with the 35 cached states of the streaming
+// zipformer (fp16 native NHWC, int64 lengths) converts float inputs and outputs like librknnrt,
+// the stand-in model updates every state. The states after the last chunk must match a reference.
+//   zipformer_state_bench [chunks]
+
+#define NUM_TENSORS 36
+
+typedef struct {
+    int dims[4]; // NCHW, or the shape for fewer dims
+    int n_dims;
+    bool int64;
+} state_shape_t;
+
+static state_shape_t g_shapes[NUM_TENSORS];
+static rknn_tensor_mem* g_inputs[NUM_TENSORS];
+static rknn_tensor_attr g_input_attrs[NUM_TENSORS];
+static rknn_tensor_mem* g_outputs[NUM_TENSORS];
+static rknn_tensor_attr g_output_attrs[NUM_TENSORS];
+static std::vector<uint16_t> g_native_in, g_native_out;
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static void set_shape(int index, int n_dims, int d0, int d1, int d2, int d3, bool int64)
+{
+    state_shape_t* s = &g_shapes[index];
+    s->n_dims = n_dims;
+    s->dims[0] = d0;
+    s->dims[1] = d1;
+    s->dims[2] = d2;
+    s->dims[3] = d3;
+    s->int64 = int64;
+}
+
+// python/zipformer.py model_config, x first
+static void init_shapes()
+{
+    const int key[5] = {192, 96, 48, 24, 96};
+    set_shape(0, 3, 1, 103, 80, 0, false);
+    for (int k = 0; k < 5; k++) {
+        set_shape(1 + k, 2, 2, 1, 0, 0, true);
+        set_shape(6 + k, 3, 2, 1, 256, 0, false);
+        set_shape(11 + k, 4, 2, key[k], 1, 192, false);
+        set_shape(16 + k, 4, 2, key[k], 1, 96, false);
+        set_shape(21 + k, 4, 2, key[k], 1, 96, false);
+        set_shape(26 + k, 4, 2, 1, 256, 30, false);
+        set_shape(31 + k, 4, 2, 1, 256, 30, false);
+    }
+}
+
+static int num_elems(int index)
+{
+    int n = 1;
+    for (int i = 0; i < g_shapes[index].n_dims; i++) {
+        n *= g_shapes[index].dims[i];
+    }
+    return n;
+}
+
+int rknn_query(rknn_context context, rknn_query_cmd cmd, void* info, uint32_t size)
+{
+    if (cmd == RKNN_QUERY_IN_OUT_NUM) {
+        rknn_input_output_num* io_num = (rknn_input_output_num*)info;
+        io_num->n_input = NUM_TENSORS;
+        io_num->n_output = NUM_TENSORS;
+        return 0;
+    }
+    rknn_tensor_attr* attr = (rknn_tensor_attr*)info;
+    int index = attr->index;
+    const state_shape_t* s = &g_shapes[index];
+    bool input = cmd == RKNN_QUERY_INPUT_ATTR || cmd == RKNN_QUERY_NATIVE_INPUT_ATTR;
+    bool native = cmd == RKNN_QUERY_NATIVE_INPUT_ATTR || cmd == RKNN_QUERY_NATIVE_OUTPUT_ATTR;
+    memset(attr, 0, sizeof(rknn_tensor_attr));
+    attr->index = index;
+    snprintf(attr->name, sizeof(attr->name), "%s%d", input ? "in" : "out", index);
+    attr->n_dims = s->n_dims;
+    attr->n_elems = num_elems(index);
+    attr->type = s->int64 ? RKNN_TENSOR_INT64 : RKNN_TENSOR_FLOAT16;
+    attr->size = attr->n_elems * (s->int64 ? 8 : 2);
+    attr->size_with_stride = attr->size;
+    attr->fmt = RKNN_TENSOR_UNDEFINED;
+    memcpy(attr->dims, s->dims, sizeof(s->dims));
+    // 4-d tensors are NHWC natively and at normal inputs, NCHW at normal outputs
+    if (s->n_dims == 4 && (native || input)) {
+        attr->fmt = RKNN_TENSOR_NHWC;
+        attr->dims[1] = s->dims[2];
+        attr->dims[2] = s->dims[3];
+        attr->dims[3] = s->dims[1];
+    } else if (s->n_dims == 4) {
+        attr->fmt = RKNN_TENSOR_NCHW;
+    }
+    return 0;
+}
+
+rknn_tensor_mem* rknn_create_mem(rknn_context ctx, uint32_t size)
+{
+    rknn_tensor_mem* mem = (rknn_tensor_mem*)calloc(1, sizeof(rknn_tensor_mem));
+    mem->virt_addr = calloc(1, size);
+    mem->size = size;
+    return mem;
+}
+
+int rknn_destroy_mem(rknn_context ctx, rknn_tensor_mem* mem)
+{
+    free(mem->virt_addr);
+    free(mem);
+    return 0;
+}
+
+int rknn_set_io_mem(rknn_context ctx, rknn_tensor_mem* mem, rknn_tensor_attr* attr)
+{
+    if (attr->index >= NUM_TENSORS || mem->size < attr->n_elems * (attr->type == RKNN_TENSOR_FLOAT16 ? 2u : 4u)) {
+        return -1;
+    }
+    if (attr->name[0] == 'i') {
+        g_inputs[attr->index] = mem;
+        g_input_attrs[attr->index] = *attr;
+    } else {
+        g_outputs[attr->index] = mem;
+        g_output_attrs[attr->index] = *attr;
+    }
+    return 0;
+}
+
+// the model's update of element i of a state, in fp16
+static uint16_t next_state(uint16_t h, int i)
+{
+    return float_to_half(0.5f * half_to_float(h) + 1.0f + (i % 7) * 0.125f);
+}
+
+// float NCHW of the normal output from native NHWC
+static void nhwc_half_to_nchw_float(const uint16_t* src, float* dst, const int* nchw)
+{
+    int n = nchw[0], c = nchw[1], hw = nchw[2] * nchw[3];
+    for (int b = 0; b < n; b++) {
+        for (int p = 0; p < hw; p++) {
+            for (int k = 0; k < c; k++) {
+                dst[(b * c + k) * hw + p] = half_to_float(src[(b * hw + p) * c + k]);
+            }
+        }
+    }
+}
+
+int rknn_run(rknn_context context, rknn_run_extend* extend)
+{
+    for (int t = 1; t < NUM_TENSORS; t++) {
+        const rknn_tensor_attr* in_attr = &g_input_attrs[t];
+        const rknn_tensor_attr* out_attr = &g_output_attrs[t];
+        int n = num_elems(t);
+        if (g_shapes[t].int64) {
+            const int64_t* src = (const int64_t*)g_inputs[t]->virt_addr;
+            int64_t* dst = (int64_t*)g_outputs[t]->virt_addr;
+            for (int i = 0; i < n; i++) {
+                dst[i] = src[i] + 1;
+            }
+            continue;
+        }
+        // native input: as it is, float input: converted by the runtime
+        const uint16_t* src = (const uint16_t*)g_inputs[t]->virt_addr;
+        if (!in_attr->pass_through) {
+            float_to_half_array((const float*)g_inputs[t]->virt_addr, &g_native_in[0], n);
+            src = &g_native_in[0];
+        }
+        uint16_t* dst = out_attr->type == RKNN_TENSOR_FLOAT16 ? (uint16_t*)g_outputs[t]->virt_addr : &g_native_out[0];
+        for (int i = 0; i < n; i++) {
+            dst[i] = next_state(src[i], i);
+        }
+        if (out_attr->type == RKNN_TENSOR_FLOAT32) {
+            if (out_attr->fmt == RKNN_TENSOR_NCHW) {
+                nhwc_half_to_nchw_float(dst, (float*)g_outputs[t]->virt_addr, g_shapes[t].dims);
+            } else {
+                half_to_float_array(dst, (float*)g_outputs[t]->virt_addr, n);
+            }
+        }
+    }
+    return 0;
+}
+
+// every state after the chunks against the same updates on a plain array
+static int check_states(const rknn_encoder_io_t* io, int chunks)
+{
+    int bad = 0;
+    for (int s = 0; s < io->n_state; s++) {
+        int t = s + 1;
+        int n = num_elems(t);
+        const rknn_tensor_mem* mem = io->state_mems[2 * s + (io->state_copy[s] ? 0 : io->cur)];
+        const rknn_tensor_attr* attr = &io->state_in_attrs[s];
+        for (int i = 0; i < n; i++) {
+            if (g_shapes[t].int64) {
+                bad += ((const int64_t*)mem->virt_addr)[i] != chunks;
+                continue;
+            }
+            uint16_t expected = 0;
+            for (int c = 0; c < chunks; c++) {
+                expected = next_state(expected, i);
+            }
+            float v = attr->type == RKNN_TENSOR_FLOAT32 ? ((const float*)mem->virt_addr)[i]
+                                                         : half_to_float(((const uint16_t*)mem->virt_addr)[i]);
+            bad += v != half_to_float(expected);
+        }
+    }
+    return bad;
+}
+
+int main(int argc, char** argv)
+{
+    int chunks = argc > 1 ? atoi(argv[1]) : 100;
+    init_shapes();
+    long max_elems = 0, state_bytes = 0;
+    for (int t = 1; t < NUM_TENSORS; t++) {
+        max_elems = num_elems(t) > max_elems ? num_elems(t) : max_elems;
+        state_bytes += num_elems(t) * (g_shapes[t].int64 ? 8 : 2);
+    }
+    g_native_in.resize(max_elems);
+    g_native_out.resize(max_elems);
+
+    rknn_app_context_t app_ctx;
+    memset(&app_ctx, 0, sizeof(app_ctx));
+    app_ctx.rknn_ctx = 1;
+    app_ctx.io_num.n_input = NUM_TENSORS;
+    app_ctx.io_num.n_output = NUM_TENSORS;
+    app_ctx.input_attrs = (rknn_tensor_attr*)calloc(NUM_TENSORS, sizeof(rknn_tensor_attr));
+    app_ctx.output_attrs = (rknn_tensor_attr*)calloc(NUM_TENSORS, sizeof(rknn_tensor_attr));
+    for (int t = 0; t < NUM_TENSORS; t++) {
+        app_ctx.input_attrs[t].index = t;
+        app_ctx.output_attrs[t].index = t;
+        rknn_query(0, RKNN_QUERY_INPUT_ATTR, &app_ctx.input_attrs[t], sizeof(rknn_tensor_attr));
+        rknn_query(0, RKNN_QUERY_OUTPUT_ATTR, &app_ctx.output_attrs[t], sizeof(rknn_tensor_attr));
+    }
+
+    rknn_encoder_io_t io;
+    double t0 = now_ms();
+    if (build_encoder_io(&app_ctx, &io) != 0) {
+        return 1;
+    }
+    double t1 = now_ms();
+    int ret = 0;
+    double update_ms = 0;
+    for (int c = 0; c < chunks && ret == 0; c++) {
+        ret = rknn_run(app_ctx.rknn_ctx, NULL);
+        double t = now_ms();
+        ret |= update_encoder_states(&app_ctx, &io);
+        update_ms += now_ms() - t;
+    }
+    double t2 = now_ms();
+    int bad = ret == 0 ? check_states(&io, chunks) : -1;
+    int copied = 0;
+    for (int s = 0; s < io.n_state; s++) {
+        copied += io.state_copy[s];
+    }
+#ifdef ZIPFORMER_COPY_STATES
+    const char* mode = "ZIPFORMER_COPY_STATES";
+#else
+    const char* mode = "default";
+#endif
+    printf("%s: %d states (%.2f MB native), %d copied; build_encoder_io %.3f ms, %d chunks, %.3f ms per chunk "
+           "(update_encoder_states %.3f ms), %d state values wrong\n",
+           mode, io.n_state, state_bytes / 1048576.0, copied, t1 - t0, chunks, (t2 - t1) / chunks,
+           update_ms / chunks, bad);
+    release_encoder_io(&app_ctx, &io);
+    free(app_ctx.input_attrs);
+    free(app_ctx.output_attrs);
+    printf("%s\n", ret == 0 && bad == 0 ? "PASS" : "FAIL");
+    return ret == 0 && bad == 0 ? 0 : 1;
+}
@@ -0,0 +1,256 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "trace_utils.h"
+
+// 16 sub-buckets per power of two up to 2^64 ns, values below 32ns are exact
+#define TRACE_SUB_BITS 4
+#define TRACE_SUB_COUNT (1 << TRACE_SUB_BITS)
+#define TRACE_NUM_BUCKETS ((64 - TRACE_SUB_BITS + 1) * TRACE_SUB_COUNT)
+
+#define TRACE_EVENTS_PER_THREAD 4096
+
+typedef struct {
+    uint64_t sum_ns;
+    uint64_t max_ns;
+    uint64_t buckets[TRACE_NUM_BUCKETS];
+} trace_histogram_t;
+
+typedef struct {
+    const char* name;
+    int stage;
+    uint64_t begin_ns;
+    uint64_t end_ns;
+} trace_event_t;
+
+// written only by its thread; count is published with release so a reader sees whole events.
+// kept after the thread exits, its events are still exported
+typedef struct trace_thread {
+    int tid;
+    uint32_t count;
+    uint32_t dropped;
+    struct trace_thread* next;
+    trace_event_t events[TRACE_EVENTS_PER_THREAD];
+} trace_thread_t;
+
+static const char* g_stage_names[TRACE_STAGE_NUM] = {
+    "decode",
+    "preprocess",
+    "inputs_set",
+    "run",
+    "outputs_get",
+    "postprocess",
+};
+
+static trace_histogram_t g_histograms[TRACE_STAGE_NUM];
+static trace_thread_t* g_threads = NULL;
+static int g_capture = 0;
+static __thread trace_thread_t* t_thread = NULL;
+
+static int get_bucket_index(uint64_t v)
+{
+    if (v < 2 * TRACE_SUB_COUNT) {
+        return (int)v;
+    }
+    int shift = 63 - __builtin_clzll(v) - TRACE_SUB_BITS;
+    return (shift + 1) * TRACE_SUB_COUNT + (int)((v >> shift) - TRACE_SUB_COUNT);
+}
+
+// middle of the values falling into the bucket
+static double get_bucket_value(int index)
+{
+    if (index < 2 * TRACE_SUB_COUNT) {
+        return index;
+    }
+    int shift = index / TRACE_SUB_COUNT - 1;
+    uint64_t low = (uint64_t)(TRACE_SUB_COUNT + index % TRACE_SUB_COUNT) << shift;
+    return (double)low + (double)(((uint64_t)1 << shift) - 1) / 2;
+}
+
+static trace_thread_t* get_thread_buffer(void)
+{
+    if (t_thread != NULL) {
+        return t_thread;
+    }
+    trace_thread_t* thread = (trace_thread_t*)calloc(1, sizeof(trace_thread_t));
+    if (thread == NULL) {
+        return NULL;
+    }
+    thread->tid = (int)syscall(SYS_gettid);
+    thread->next = __atomic_load_n(&g_threads, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&g_threads, &thread->next, thread, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+    }
+    t_thread = thread;
+    return thread;
+}
+
+uint64_t trace_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+void trace_record(trace_stage_t stage, const char* name, uint64_t begin_ns, uint64_t end_ns)
+{
+    uint64_t duration = end_ns > begin_ns ? end_ns - begin_ns : 0;
+    if (stage >= 0 && stage < TRACE_STAGE_NUM) {
+        trace_histogram_t* hist = &g_histograms[stage];
+        __atomic_fetch_add(&hist->buckets[get_bucket_index(duration)], 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&hist->sum_ns, duration, __ATOMIC_RELAXED);
+        uint64_t max = __atomic_load_n(&hist->max_ns, __ATOMIC_RELAXED);
+        while (duration > max &&
+               !__atomic_compare_exchange_n(&hist->max_ns, &max, duration, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        }
+    }
+
+    if (!__atomic_load_n(&g_capture, __ATOMIC_RELAXED)) {
+        return;
+    }
+    trace_thread_t* thread = get_thread_buffer();
+    if (thread == NULL) {
+        return;
+    }
+    uint32_t count = thread->count;
+    if (count >= TRACE_EVENTS_PER_THREAD) {
+        thread->dropped++;
+        return;
+    }
+    trace_event_t* event = &thread->events[count];
+    event->name = name;
+    event->stage = stage;
+    event->begin_ns = begin_ns;
+    event->end_ns = end_ns;
+    __atomic_store_n(&thread->count, count + 1, __ATOMIC_RELEASE);
+}
+
+void trace_set_event_capture(int enable)
+{
+    __atomic_store_n(&g_capture, enable ? 1 : 0, __ATOMIC_RELAXED);
+}
+
+static void write_json_string(FILE* fp, const char* s)
+{
+    fputc('"', fp);
+    for (; s != NULL && *s != '\0'; s++) {
+        if (*s == '"' || *s == '\\') {
+            fputc('\\', fp);
+            fputc(*s, fp);
+        } else if ((unsigned char)*s < 0x20) {
+            fprintf(fp, "\\u%04x", (unsigned char)*s);
+        } else {
+            fputc(*s, fp);
+        }
+    }
+    fputc('"', fp);
+}
+
+int trace_write_json(const char* path)
+{
+    FILE* fp = fopen(path, "w");
+    if (fp == NULL) {
+        printf("fopen %s fail!\n", path);
+        return -1;
+    }
+    int pid = (int)getpid();
+    int num_events = 0;
+    uint32_t dropped = 0;
+    fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    trace_thread_t* thread = __atomic_load_n(&g_threads, __ATOMIC_ACQUIRE);
+    for (; thread != NULL; thread = thread->next) {
+        uint32_t count = __atomic_load_n(&thread->count, __ATOMIC_ACQUIRE);
+        dropped += thread->dropped;
+        for (uint32_t i = 0; i < count; i++) {
+            const trace_event_t* event = &thread->events[i];
+            fprintf(fp, "%s\n{\"name\":", num_events > 0 ? "," : "");
+            write_json_string(fp, event->name);
+            fprintf(fp, ",\"cat\":");
+            write_json_string(fp, get_trace_stage_name((trace_stage_t)event->stage));
+            fprintf(fp, ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d}",
+                    event->begin_ns / 1000.0, (event->end_ns - event->begin_ns) / 1000.0, pid, thread->tid);
+            num_events++;
+        }
+    }
+    fprintf(fp, "\n]}\n");
+    if (fclose(fp) != 0) {
+        printf("write %s fail!\n", path);
+        return -1;
+    }
+    if (dropped > 0) {
+        printf("trace: %u events dropped, thread buffers hold %d\n", dropped, TRACE_EVENTS_PER_THREAD);
+    }
+    printf("trace: %d events written to %s\n", num_events, path);
+    return 0;
+}
+
+int trace_get_stage_stats(trace_stage_t stage, trace_stage_stats_t* stats)
+{
+    if (stage < 0 || stage >= TRACE_STAGE_NUM) {
+        return -1;
+    }
+    const trace_histogram_t* hist = &g_histograms[stage];
+    memset(stats, 0, sizeof(trace_stage_stats_t));
+    // count from the buckets so the percentiles agree with it while zones finish
+    uint64_t total = 0;
+    for (int i = 0; i < TRACE_NUM_BUCKETS; i++) {
+        total += __atomic_load_n(&hist->buckets[i], __ATOMIC_RELAXED);
+    }
+    if (total == 0) {
+        return 0;
+    }
+    double max_us = __atomic_load_n(&hist->max_ns, __ATOMIC_RELAXED) / 1000.0;
+    stats->count = total;
+    stats->max_us = max_us;
+    stats->mean_us = __atomic_load_n(&hist->sum_ns, __ATOMIC_RELAXED) / 1000.0 / total;
+
+    const double quantiles[3] = {0.50, 0.90, 0.99};
+    double* values[3] = {&stats->p50_us, &stats->p90_us, &stats->p99_us};
+    uint64_t seen = 0;
+    int q = 0;
+    for (int i = 0; i < TRACE_NUM_BUCKETS && q < 3; i++) {
+        seen += __atomic_load_n(&hist->buckets[i], __ATOMIC_RELAXED);
+        while (q < 3 && seen >= (uint64_t)(quantiles[q] * total + 0.5)) {
+            double value = get_bucket_value(i) / 1000.0;
+            *values[q] = value < max_us ? value : max_us;
+            q++;
+        }
+    }
+    return 0;
+}
+
+void trace_print_stats(void)
+{
+    printf("%-12s %8s %10s %10s %10s %10s %10s (ms)\n", "stage", "count", "mean", "p50", "p90", "p99", "max");
+    for (int i = 0; i < TRACE_STAGE_NUM; i++) {
+        trace_stage_stats_t stats;
+        trace_get_stage_stats((trace_stage_t)i, &stats);
+        if (stats.count == 0) {
+            continue;
+        }
+        printf("%-12s %8llu %10.3f %10.3f %10.3f %10.3f %10.3f\n", g_stage_names[i], (unsigned long long)stats.count,
+               stats.mean_us / 1000, stats.p50_us / 1000, stats.p90_us / 1000, stats.p99_us / 1000,
+               stats.max_us / 1000);
+    }
+}
+
+void trace_reset(void)
+{
+    memset(g_histograms, 0, sizeof(g_histograms));
+    trace_thread_t* thread = __atomic_load_n(&g_threads, __ATOMIC_ACQUIRE);
+    for (; thread != NULL; thread = thread->next) {
+        __atomic_store_n(&thread->count, 0, __ATOMIC_RELEASE);
+        thread->dropped = 0;
+    }
+}
+
+const char* get_trace_stage_name(trace_stage_t stage)
+{
+    if (stage < 0 || stage >= TRACE_STAGE_NUM) {
+        return "zone";
+    }
+    return g_stage_names[stage];
+}
@@ -0,0 +1,157 @@
+#ifndef _RKNN_MODEL_ZOO_TRACE_UTILS_H_
+#define _RKNN_MODEL_ZOO_TRACE_UTILS_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+
+/**
+ * Per-stage tracing
+ *
+ * Each finished zone adds its duration to the latency histogram of its stage
+ * (log-linear buckets, 16 per power of two, so percentiles are within ~6%).
+ * When event capture is on, zones are also appended to a buffer owned by the
+ * calling thread, without locks, and can be written as Chrome trace JSON that
+ * chrome://tracing and ui.perfetto.dev open.
+ *
+ * Zones compile out with -DTRACE_DISABLED, TRACE_LOG compiles out in release
+ * builds (NDEBUG).
+ */
+
+typedef enum {
+    TRACE_STAGE_NONE = -1,          // event only, no histogram
+    TRACE_STAGE_DECODE = 0,
+    TRACE_STAGE_PREPROCESS,
+    TRACE_STAGE_INPUTS_SET,
+    TRACE_STAGE_RUN,
+    TRACE_STAGE_OUTPUTS_GET,
+    TRACE_STAGE_POSTPROCESS,
+    TRACE_STAGE_NUM
+} trace_stage_t;
+
+/**
+ * @brief Latency statistics of a stage, in microseconds
+ *
+ */
+typedef struct {
+    uint64_t count;
+    double mean_us;
+    double p50_us;
+    double p90_us;
+    double p99_us;
+    double max_us;
+} trace_stage_stats_t;
+
+/**
+ * @brief Monotonic clock
+ *
+ * @return uint64_t Nanoseconds
+ */
+uint64_t trace_now_ns(void);
+
+/**
+ * @brief Record a finished zone
+ *
+ * @param stage [in] Stage of the histogram, TRACE_STAGE_NONE: none
+ * @param name [in] Zone name, must outlive the trace (string literal)
+ * @param begin_ns [in] Begin from trace_now_ns
+ * @param end_ns [in] End from trace_now_ns
+ */
+void trace_record(trace_stage_t stage, const char* name, uint64_t begin_ns, uint64_t end_ns);
+
+/**
+ * @brief Start or stop capturing events for trace_write_json, histograms are always updated
+ *
+ * @param enable [in] 1: capture; 0: stop
+ */
+void trace_set_event_capture(int enable);
+
+/**
+ * @brief Write captured events as Chrome trace JSON
+ *
+ * @param path [in] Output path
+ * @return int 0: success; -1: error
+ */
+int trace_write_json(const char* path);
+
+/**
+ * @brief Get latency statistics of a stage
+ *
+ * @param stage [in] Stage
+ * @param stats [out] Statistics
+ * @return int 0: success; -1: invalid stage
+ */
+int trace_get_stage_stats(trace_stage_t stage, trace_stage_stats_t* stats);
+
+/**
+ * @brief Print count and p50/p90/p99/max of every stage that has samples
+ *
+ */
+void trace_print_stats(void);
+
+/**
+ * @brief Clear histograms and captured events, no zone may be running
+ *
+ */
+void trace_reset(void);
+
+/**
+ * @brief Name of a stage
+ *
+ * @param stage [in] Stage
+ * @return const char* e.g. "preprocess"
+ */
+const char* get_trace_stage_name(trace_stage_t stage);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#ifndef NDEBUG
+#define TRACE_LOG(...) printf(__VA_ARGS__)
+#else
+#define TRACE_LOG(...) do { } while (0)
+#endif
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+#ifndef TRACE_DISABLED
+// C: uint64_t begin = TRACE_BEGIN(); ... TRACE_END(stage, name, begin);
+#define TRACE_BEGIN() trace_now_ns()
+#define TRACE_END(stage, name, begin) trace_record((stage), (name), (begin), trace_now_ns())
+#else
+#define TRACE_BEGIN() ((uint64_t)0)
+#define TRACE_END(stage, name, begin) do { (void)(begin); } while (0)
+#endif
+
+#ifdef __cplusplus
+/**
+ * Scoped zone, recorded when it goes out of scope
+ */
+class TraceZone
+{
+public:
+    TraceZone(trace_stage_t stage, const char* name) : stage_(stage), name_(name), begin_(trace_now_ns()) {}
+    ~TraceZone() { trace_record(stage_, name_, begin_, trace_now_ns()); }
+
+private:
+    TraceZone(const TraceZone&);
+    TraceZone& operator=(const TraceZone&);
+
+    trace_stage_t stage_;
+    const char* name_;
+    uint64_t begin_;
+};
+
+#ifndef TRACE_DISABLED
+#define TRACE_ZONE(stage, name) TraceZone TRACE_CONCAT(trace_zone_, __LINE__)((stage), (name))
+#else
+#define TRACE_ZONE(stage, name)
+#endif
+#endif  // __cplusplus
+
+#endif // _RKNN_MODEL_ZOO_TRACE_UTILS_H_
@@ -0,0 +1,437 @@
+#ifndef _RKNN_MODEL_ZOO_YOLO_HEAD_H_
+#define _RKNN_MODEL_ZOO_YOLO_HEAD_H_
+
+/**
+ * YOLO detection head decoder, shared by the yolov5/6/7/8/10/11, yolox and ppyoloe demos.
+ *
+ * One template generates every variant, specialized at compile time on
+ * - element type: int8_t, uint8_t (RKNPU1) or float
+ * - tensor layout: nchw_layout or nhwc_layout (RV1106/RV1103)
+ * - box scheme: anchor_scheme<N> (yolov5/yolov7), anchor_free_scheme (yolox),
+ *   dfl_scheme / dfl_multi_label_scheme (yolov6/8/11, ppyoloe / yolov10)
+ * - class count
+ *
+ * Cells are filtered on raw quantized values, only the survivors are dequantized and decoded.
+ * Boxes are appended as (x, y, w, h) in model input pixels, with their score and class id.
+ */
+
+#include <stdint.h>
+#include <math.h>
+
+#include <vector>
+
+#include "dfl_utils.h"
+
+// longest box distribution the float decoder gathers before decoding
+#define YOLO_HEAD_MAX_DFL_LEN 32
+
+namespace yolo_head {
+
+/**
+ * @brief Output tensor, zp and scale are ignored for float
+ *
+ */
+template <typename T>
+struct tensor_t {
+    const T* data;
+    int32_t zp;
+    float scale;
+};
+
+/**
+ * @brief Output grid of one branch
+ *
+ */
+typedef struct {
+    int h;
+    int w;
+    int stride;     // model input pixels per cell
+} grid_t;
+
+// ---------------------------------------------------------------- element types
+
+template <typename T>
+struct element_traits;
+
+template <>
+struct element_traits<int8_t> {
+    static int8_t quantize(float f, int32_t zp, float scale)
+    {
+        float v = f / scale + zp;
+        return (int8_t)(int32_t)(v <= -128 ? -128 : (v >= 127 ? 127 : v));
+    }
+    static float dequantize(int8_t q, int32_t zp, float scale) { return ((float)q - (float)zp) * scale; }
+    static void init_dfl_table(dfl_exp_table_t* table, int32_t zp, float scale) { init_dfl_exp_table_i8(table, zp, scale); }
+    static void decode_dfl(const int8_t* p, int step, int dfl_len, const dfl_exp_table_t* table, float box[4])
+    {
+        dfl_decode_i8(p, step, dfl_len, table, box);
+    }
+};
+
+template <>
+struct element_traits<uint8_t> {
+    static uint8_t quantize(float f, int32_t zp, float scale)
+    {
+        float v = f / scale + zp;
+        return (uint8_t)(int32_t)(v <= 0 ? 0 : (v >= 255 ? 255 : v));
+    }
+    static float dequantize(uint8_t q, int32_t zp, float scale) { return ((float)q - (float)zp) * scale; }
+    static void init_dfl_table(dfl_exp_table_t* table, int32_t zp, float scale) { init_dfl_exp_table_u8(table, zp, scale); }
+    static void decode_dfl(const uint8_t* p, int step, int dfl_len, const dfl_exp_table_t* table, float box[4])
+    {
+        dfl_decode_u8(p, step, dfl_len, table, box);
+    }
+};
+
+template <>
+struct element_traits<float> {
+    static float quantize(float f, int32_t zp, float scale) { return f; }
+    static float dequantize(float q, int32_t zp, float scale) { return q; }
+    static void init_dfl_table(dfl_exp_table_t* table, int32_t zp, float scale) {}
+    static void decode_dfl(const float* p, int step, int dfl_len, const dfl_exp_table_t* table, float box[4])
+    {
+        // the float decoder reads every value twice (max, then exp), gather strided planes once
+        if (step != 1 && dfl_len <= YOLO_HEAD_MAX_DFL_LEN)
+        {
+            float values[4 * YOLO_HEAD_MAX_DFL_LEN];
+            for (int k = 0; k < 4 * dfl_len; k++)
+            {
+                values[k] = p[k * step];
+            }
+            dfl_decode_f32(values, 1, dfl_len, box);
+            return;
+        }
+        dfl_decode_f32(p, step, dfl_len, box);
+    }
+};
+
+// ---------------------------------------------------------------- layouts
+//
+// Channel c of grid cell idx (i * grid_w + j) is at cell(idx) + channel(c).
+// planar layouts are walked channel plane by channel plane, the others cell by cell.
+
+struct nchw_layout {
+    enum { planar = 1 };
+    int grid_len;
+    static nchw_layout make(int grid_len, int channels) { nchw_layout l = {grid_len}; return l; }
+    int cell(int idx) const { return idx; }
+    int channel(int c) const { return c * grid_len; }
+};
+
+struct nhwc_layout {
+    enum { planar = 0 };
+    int channels;
+    static nhwc_layout make(int grid_len, int channels) { nhwc_layout l = {channels}; return l; }
+    int cell(int idx) const { return idx * channels; }
+    int channel(int c) const { return c; }
+};
+
+// ---------------------------------------------------------------- box schemes
+
+/**
+ * @brief yolov5/yolov7: xy = (2v - 0.5 + grid) * stride, wh = (2v)^2 * anchor
+ *
+ * One output per branch holding NUM_ANCHOR blocks of (x, y, w, h, obj, classes...)
+ */
+template <int NUM_ANCHOR>
+struct anchor_scheme {
+    enum { num_anchor = NUM_ANCHOR };
+    const int* anchors;     // NUM_ANCHOR (w, h) pairs in input pixels
+    explicit anchor_scheme(const int* anchors) : anchors(anchors) {}
+
+    void decode(int a, const float v[4], int i, int j, int stride, float box[4]) const
+    {
+        float w = v[2] * 2.0f;
+        float h = v[3] * 2.0f;
+        w = w * w * (float)anchors[a * 2];
+        h = h * h * (float)anchors[a * 2 + 1];
+        box[0] = (v[0] * 2.0f - 0.5f + j) * (float)stride - w * 0.5f;
+        box[1] = (v[1] * 2.0f - 0.5f + i) * (float)stride - h * 0.5f;
+        box[2] = w;
+        box[3] = h;
+    }
+};
+
+/**
+ * @brief yolox: xy = (v + grid) * stride, wh = exp(v) * stride
+ *
+ * One output per branch holding (x, y, w, h, obj, classes...)
+ */
+struct anchor_free_scheme {
+    enum { num_anchor = 1 };
+
+    void decode(int a, const float v[4], int i, int j, int stride, float box[4]) const
+    {
+        float w = expf(v[2]) * (float)stride;
+        float h = expf(v[3]) * (float)stride;
+        box[0] = (v[0] + j) * (float)stride - w * 0.5f;
+        box[1] = (v[1] + i) * (float)stride - h * 0.5f;
+        box[2] = w;
+        box[3] = h;
+    }
+};
+
+/**
+ * @brief yolov6/8/10/11, ppyoloe: left, top, right, bottom distances from the cell center
+ *
+ * Box, class score and optional score sum outputs per branch. Each distance is a dfl_len
+ * long distribution decoded by dfl_utils, or the distance itself for dfl_len 1.
+ * MULTI_LABEL keeps every class above the threshold (yolov10, no NMS) instead of the best one.
+ */
+template <bool MULTI_LABEL>
+struct distance_scheme {
+    int dfl_len;
+    explicit distance_scheme(int dfl_len) : dfl_len(dfl_len) {}
+};
+
+typedef distance_scheme<false> dfl_scheme;
+typedef distance_scheme<true> dfl_multi_label_scheme;
+
+// ---------------------------------------------------------------- decoders
+
+static inline void push_box(const float box[4], float score, int class_id,
+                            std::vector<float>& boxes, std::vector<float>& scores, std::vector<int>& class_ids)
+{
+    boxes.push_back(box[0]);
+    boxes.push_back(box[1]);
+    boxes.push_back(box[2]);
+    boxes.push_back(box[3]);
+    scores.push_back(score);
+    class_ids.push_back(class_id);
+}
+
+// cell of an anchor or anchor-free head that passed the objectness filter,
+// score = best class * objectness as in the python demos
+template <int NUM_CLASS, typename T, typename Layout, typename Scheme>
+static inline int decode_objectness_cell(tensor_t<T> output, const Layout& layout, const Scheme& scheme,
+                                         int a, int i, int j, int idx, int stride, float threshold,
+                                         std::vector<float>& boxes, std::vector<float>& scores, std::vector<int>& class_ids)
+{
+    typedef element_traits<T> E;
+    const int base = a * (5 + NUM_CLASS);
+    const T* p = output.data + layout.cell(idx);
+
+    T max_prob = p[layout.channel(base + 5)];
+    int max_class_id = 0;
+    for (int c = 1; c < NUM_CLASS; c++)
+    {
+        // selects rather than branches, the class order is random
+        T prob = p[layout.channel(base + 5 + c)];
+        bool better = prob > max_prob;
+        max_class_id = better ? c : max_class_id;
+        max_prob = better ? prob : max_prob;
+    }
+    T obj = p[layout.channel(base + 4)];
+    float score = E::dequantize(max_prob, output.zp, output.scale) * E::dequantize(obj, output.zp, output.scale);
+    if (score < threshold)
+    {
+        return 0;
+    }
+
+    float v[4];
+    for (int k = 0; k < 4; k++)
+    {
+        v[k] = E::dequantize(p[layout.channel(base + k)], output.zp, output.scale);
+    }
+    float box[4];
+    scheme.decode(a, v, i, j, stride, box);
+    push_box(box, score, max_class_id, boxes, scores, class_ids);
+    return 1;
+}
+
+/**
+ * @brief Decode one branch of an anchor (yolov5/yolov7) or anchor-free (yolox) head
+ *
+ * @param scheme [in] anchor_scheme<N> or anchor_free_scheme
+ * @param output [in] Branch output, N * (5 + NUM_CLASS) channels
+ * @param grid [in] Branch grid
+ * @param threshold [in] Box threshold on class * objectness
+ * @param boxes [out] Appended x, y, w, h
+ * @param scores [out] Appended scores
+ * @param class_ids [out] Appended class ids
+ * @return int Number of boxes appended
+ */
+template <int NUM_CLASS, typename Layout, typename T, typename Scheme>
+int decode_head(const Scheme& scheme, tensor_t<T> output, grid_t grid, float threshold,
+                std::vector<float>& boxes, std::vector<float>& scores, std::vector<int>& class_ids)
+{
+    const int prop_size = 5 + NUM_CLASS;
+    const int grid_len = grid.h * grid.w;
+    const Layout layout = Layout::make(grid_len, Scheme::num_anchor * prop_size);
+    // every class probability is below 1, a cell below the threshold on objectness alone is dropped
+    const T obj_thres = element_traits<T>::quantize(threshold, output.zp, output.scale);
+    int count = 0;
+
+    // one flat loop over the cells keeps the filter tight, the grid position
+    // is only worked out for the few cells that pass it
+    if (Layout::planar)
+    {
+        for (int a = 0; a < Scheme::num_anchor; a++)
+        {
+            const T* obj = output.data + layout.channel(a * prop_size + 4);
+            for (int idx = 0; idx < grid_len; idx++)
+            {
+                if (obj[layout.cell(idx)] < obj_thres)
+                {
+                    continue;
+                }
+                count += decode_objectness_cell<NUM_CLASS>(output, layout, scheme, a, idx / grid.w, idx % grid.w, idx,
+                                                           grid.stride, threshold, boxes, scores, class_ids);
+            }
+        }
+    }
+    else
+    {
+        const T* p = output.data;
+        for (int idx = 0; idx < grid_len; idx++, p += layout.cell(1))
+        {
+            for (int a = 0; a < Scheme::num_anchor; a++)
+            {
+                if (p[layout.channel(a * prop_size + 4)] < obj_thres)
+                {
+                    continue;
+                }
+                count += decode_objectness_cell<NUM_CLASS>(output, layout, scheme, a, idx / grid.w, idx % grid.w, idx,
+                                                           grid.stride, threshold, boxes, scores, class_ids);
+            }
+        }
+    }
+    return count;
+}
+
+// distances of one cell in grid units
+template <typename T, typename Layout>
+static inline void decode_distances(tensor_t<T> box, const Layout& layout, int idx, int dfl_len,
+                                    const dfl_exp_table_t* table, float dist[4])
+{
+    typedef element_traits<T> E;
+    const T* p = box.data + layout.cell(idx);
+    if (dfl_len <= 1)
+    {
+        for (int k = 0; k < 4; k++)
+        {
+            dist[k] = E::dequantize(p[layout.channel(k)], box.zp, box.scale);
+        }
+    }
+    else
+    {
+        E::decode_dfl(p, layout.channel(1), dfl_len, table, dist);
+    }
+}
+
+static inline void distances_to_box(const float dist[4], int i, int j, int stride, float box[4])
+{
+    float x1 = (-dist[0] + j + 0.5f) * (float)stride;
+    float y1 = (-dist[1] + i + 0.5f) * (float)stride;
+    float x2 = (dist[2] + j + 0.5f) * (float)stride;
+    float y2 = (dist[3] + i + 0.5f) * (float)stride;
+    box[0] = x1;
+    box[1] = y1;
+    box[2] = x2 - x1;
+    box[3] = y2 - y1;
+}
+
+/**
+ * @brief Decode one branch of a distance head (yolov6/8/10/11, ppyoloe)
+ *
+ * @param scheme [in] dfl_scheme or dfl_multi_label_scheme
+ * @param box [in] Box output, 4 * dfl_len channels
+ * @param score [in] Class score output, NUM_CLASS channels
+ * @param score_sum [in] Score sum output, 1 channel, data NULL if the model has none
+ * @param grid [in] Branch grid
+ * @param threshold [in] Class score threshold
+ * @param boxes [out] Appended x, y, w, h
+ * @param scores [out] Appended scores
+ * @param class_ids [out] Appended class ids
+ * @return int Number of boxes appended
+ */
+template <int NUM_CLASS, typename Layout, typename T, bool MULTI_LABEL>
+int decode_head(const distance_scheme<MULTI_LABEL>& scheme, tensor_t<T> box, tensor_t<T> score,
+                tensor_t<T> score_sum, grid_t grid, float threshold,
+                std::vector<float>& boxes, std::vector<float>& scores, std::vector<int>& class_ids)
+{
+    typedef element_traits<T> E;
+    const int grid_len = grid.h * grid.w;
+    const int dfl_len = scheme.dfl_len;
+    const Layout box_layout = Layout::make(grid_len, 4 * dfl_len);
+    const Layout score_layout = Layout::make(grid_len, NUM_CLASS);
+    const Layout sum_layout = Layout::make(grid_len, 1);
+    const T score_thres = E::quantize(threshold, score.zp, score.scale);
+    const T sum_thres = E::quantize(threshold, score_sum.zp, score_sum.scale);
+
+    dfl_exp_table_t table;
+    if (dfl_len > 1)
+    {
+        E::init_dfl_table(&table, box.zp, box.scale);
+    }
+
+    int count = 0;
+    for (int i = 0; i < grid.h; i++)
+    {
+        for (int j = 0; j < grid.w; j++)
+        {
+            const int idx = i * grid.w + j;
+            // the score sum filters most cells with a single read
+            if (score_sum.data != NULL && score_sum.data[sum_layout.cell(idx)] < sum_thres)
+            {
+                continue;
+            }
+            const T* p = score.data + score_layout.cell(idx);
+            float dist[4];
+            float xywh[4];
+
+            if (MULTI_LABEL)
+            {
+                bool decoded = false;
+                for (int c = 0; c < NUM_CLASS; c++)
+                {
+                    T s = p[score_layout.channel(c)];
+                    if (s <= score_thres)
+                    {
+                        continue;
+                    }
+                    if (!decoded)
+                    {
+                        decode_distances(box, box_layout, idx, dfl_len, &table, dist);
+                        distances_to_box(dist, i, j, grid.stride, xywh);
+                        decoded = true;
+                    }
+                    push_box(xywh, E::dequantize(s, score.zp, score.scale), c, boxes, scores, class_ids);
+                    count++;
+                }
+                continue;
+            }
+
+            // first class above the threshold, a compare against a constant that
+            // most cells finish without a hit, then the running max from there
+            int max_class_id = 0;
+            while (max_class_id < NUM_CLASS && p[score_layout.channel(max_class_id)] <= score_thres)
+            {
+                max_class_id++;
+            }
+            if (max_class_id == NUM_CLASS)
+            {
+                continue;
+            }
+            T max_score = p[score_layout.channel(max_class_id)];
+            for (int c = max_class_id + 1; c < NUM_CLASS; c++)
+            {
+                T s = p[score_layout.channel(c)];
+                if (s > max_score)
+                {
+                    max_score = s;
+                    max_class_id = c;
+                }
+            }
+            decode_distances(box, box_layout, idx, dfl_len, &table, dist);
+            distances_to_box(dist, i, j, grid.stride, xywh);
+            push_box(xywh, E::dequantize(max_score, score.zp, score.scale), max_class_id, boxes, scores, class_ids);
+            count++;
+        }
+    }
+    return count;
+}
+
+}  // namespace yolo_head
+
+#endif // _RKNN_MODEL_ZOO_YOLO_HEAD_H_